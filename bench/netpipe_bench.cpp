@@ -0,0 +1,688 @@
+/// netpipe_bench - latency and throughput numbers for the transports and the RPC layers
+///
+/// Suites:
+///   pingpong    round trip of one message over TcpStream, IpcStream, ShmStream and UdpDatagram
+///   throughput  one-way stream of messages, acknowledged once at the end
+///   rpc         Remote<Unidirect> and Remote<Bidirect> echo calls at several concurrency levels
+///   streaming   StreamingRemote server stream under the default flow-control window
+///   codec       encode/decode of Remote V1 and V2 frames and FrameBuilder, in memory (no I/O)
+///
+/// Prints one JSON document on stdout (progress goes to stderr), so runs can be stored and diffed.
+/// Usage: netpipe_bench [--quick] [--max-size BYTES] [--filter TEXT] [--out FILE]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        bool quick = false;
+        dp::usize max_size = 64u << 20;
+        std::string filter;
+        std::string out;
+    };
+
+    struct Result {
+        std::string suite;
+        std::string target; // Transport or RPC layer
+        dp::usize size = 0;
+        dp::usize concurrency = 1;
+        dp::u64 operations = 0;
+        double seconds = 0;
+        netpipe::HistogramSnapshot latency_ns; // Empty for throughput runs
+        double delivered = 1.0;                // Fraction of messages that arrived (UDP)
+    };
+
+    std::vector<Result> results;
+    Options options;
+    dp::u32 run_counter = 0;
+
+    bool selected(const std::string &suite, const std::string &target) {
+        if (options.filter.empty()) {
+            return true;
+        }
+        return (suite + "/" + target).find(options.filter) != std::string::npos;
+    }
+
+    dp::u64 elapsed_ns(Clock::time_point start) {
+        return static_cast<dp::u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    /// Iterations for one size: enough to be stable, bounded by the bytes moved
+    dp::u64 iterations_for(dp::usize size, dp::u64 most) {
+        dp::u64 budget = options.quick ? (64ull << 20) : (1ull << 30);
+        dp::u64 n = budget / (size > 0 ? size : 1);
+        if (options.quick) {
+            most /= 10;
+        }
+        return n < 5 ? 5 : (n > most ? most : n);
+    }
+
+    std::vector<dp::usize> sizes_up_to(dp::usize limit) {
+        std::vector<dp::usize> out;
+        for (dp::usize size : {64u, 1024u, 16u << 10, 256u << 10, 1u << 20, 4u << 20, 16u << 20, 64u << 20}) {
+            dp::usize cap = options.quick ? (1u << 20) : options.max_size;
+            if (size <= limit && size <= cap) {
+                out.push_back(size);
+            }
+        }
+        return out;
+    }
+
+    void report(Result result) {
+        double us = result.latency_ns.count ? static_cast<double>(result.latency_ns.percentile(0.5)) / 1000.0 : 0;
+        std::fprintf(stderr, "%-10s %-18s size=%-9zu conc=%-3zu ops=%-8llu %10.0f ops/s", result.suite.c_str(),
+                     result.target.c_str(), result.size, result.concurrency,
+                     static_cast<unsigned long long>(result.operations), result.operations / result.seconds);
+        if (result.latency_ns.count) {
+            std::fprintf(stderr, "  p50=%.1fus", us);
+        }
+        std::fprintf(stderr, "\n");
+        results.push_back(std::move(result));
+    }
+
+    // ----------------------------------------------------------------------------------------------
+    // Stream transports
+    // ----------------------------------------------------------------------------------------------
+
+    /// A connected client/server pair of one stream transport
+    struct StreamPair {
+        std::unique_ptr<netpipe::Stream> listener;
+        std::unique_ptr<netpipe::Stream> client;
+        std::unique_ptr<netpipe::Stream> server;
+    };
+
+    using PairFactory = std::function<bool(StreamPair &, dp::usize max_message)>;
+
+    template <typename Listen, typename Connect>
+    bool connect_pair(StreamPair &pair, std::unique_ptr<netpipe::Stream> listener,
+                      std::unique_ptr<netpipe::Stream> client, Listen listen, Connect connect) {
+        if (!listen(*listener)) {
+            return false;
+        }
+        std::thread accept_thread([&]() {
+            auto res = listener->accept();
+            if (res.is_ok()) {
+                pair.server = std::move(res.value());
+            }
+        });
+        bool connected = connect(*client);
+        if (!connected) {
+            listener->close();
+        }
+        accept_thread.join();
+        pair.listener = std::move(listener);
+        pair.client = std::move(client);
+        return connected && pair.server;
+    }
+
+    bool tcp_pair(StreamPair &pair, dp::usize) {
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", static_cast<dp::u16>(27000 + run_counter++ % 2000)};
+        return connect_pair(
+            pair, std::make_unique<netpipe::TcpStream>(), std::make_unique<netpipe::TcpStream>(),
+            [&](netpipe::Stream &s) { return s.listen(endpoint).is_ok(); },
+            [&](netpipe::Stream &s) { return s.connect(endpoint).is_ok(); });
+    }
+
+    bool ipc_pair(StreamPair &pair, dp::usize) {
+        std::string path = "/tmp/netpipe_bench_" + std::to_string(::getpid()) + "_" + std::to_string(run_counter++);
+        ::unlink(path.c_str());
+        netpipe::IpcEndpoint endpoint{dp::String(path.c_str())};
+        return connect_pair(
+            pair, std::make_unique<netpipe::IpcStream>(), std::make_unique<netpipe::IpcStream>(),
+            [&](netpipe::Stream &s) { return static_cast<netpipe::IpcStream &>(s).listen_ipc(endpoint).is_ok(); },
+            [&](netpipe::Stream &s) { return static_cast<netpipe::IpcStream &>(s).connect_ipc(endpoint).is_ok(); });
+    }
+
+    bool shm_pair(StreamPair &pair, dp::usize max_message) {
+        std::string name = "netpipe_bench_" + std::to_string(::getpid()) + "_" + std::to_string(run_counter++);
+        // Room for a few messages in flight; the largest sizes get two
+        dp::usize capacity = max_message < (1u << 20) ? (4u << 20) : 2 * max_message;
+        netpipe::ShmEndpoint endpoint{dp::String(name.c_str()), capacity};
+        return connect_pair(
+            pair, std::make_unique<netpipe::ShmStream>(), std::make_unique<netpipe::ShmStream>(),
+            [&](netpipe::Stream &s) { return static_cast<netpipe::ShmStream &>(s).listen_shm(endpoint).is_ok(); },
+            [&](netpipe::Stream &s) { return static_cast<netpipe::ShmStream &>(s).connect_shm(endpoint).is_ok(); });
+    }
+
+    void close_pair(StreamPair &pair) {
+        if (pair.client) {
+            pair.client->close();
+        }
+        if (pair.server) {
+            pair.server->close();
+        }
+        if (pair.listener) {
+            pair.listener->close();
+        }
+    }
+
+    /// Echo every message until stop is set or the connection fails
+    void echo_loop(netpipe::Stream &stream, std::atomic<bool> &stop) {
+        stream.set_recv_timeout(100);
+        netpipe::Message msg;
+        while (!stop) {
+            auto res = stream.recv_into(msg);
+            if (res.is_err()) {
+                if (res.error().code == dp::Error::TIMEOUT) {
+                    continue;
+                }
+                return;
+            }
+            if (stream.send(msg).is_err()) {
+                return;
+            }
+        }
+    }
+
+    void stream_pingpong(const std::string &name, PairFactory factory) {
+        if (!selected("pingpong", name)) {
+            return;
+        }
+        for (dp::usize size : sizes_up_to(options.max_size)) {
+            StreamPair pair;
+            if (!factory(pair, size)) {
+                std::fprintf(stderr, "pingpong %s: could not connect for size %zu, skipped\n", name.c_str(), size);
+                close_pair(pair);
+                continue;
+            }
+            std::atomic<bool> stop{false};
+            std::thread peer([&]() { echo_loop(*pair.server, stop); });
+
+            netpipe::Message request(size, 0xA5);
+            netpipe::Message reply;
+            netpipe::LatencyHistogram histogram;
+            dp::u64 n = iterations_for(size, 20000);
+            for (int i = 0; i < 3; i++) { // Warm up buffers and caches
+                pair.client->send(request);
+                pair.client->recv_into(reply);
+            }
+            auto start = Clock::now();
+            dp::u64 done = 0;
+            for (; done < n; done++) {
+                auto sent = Clock::now();
+                if (pair.client->send(request).is_err() || pair.client->recv_into(reply).is_err()) {
+                    break;
+                }
+                histogram.record(elapsed_ns(sent));
+            }
+            double seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+
+            stop = true;
+            peer.join();
+            close_pair(pair);
+            report(Result{"pingpong", name, size, 1, done, seconds, histogram.snapshot(), 1.0});
+        }
+    }
+
+    void stream_throughput(const std::string &name, PairFactory factory) {
+        if (!selected("throughput", name)) {
+            return;
+        }
+        for (dp::usize size : sizes_up_to(options.max_size)) {
+            StreamPair pair;
+            if (!factory(pair, size)) {
+                std::fprintf(stderr, "throughput %s: could not connect for size %zu, skipped\n", name.c_str(), size);
+                close_pair(pair);
+                continue;
+            }
+            dp::u64 n = iterations_for(size, 200000);
+            std::thread peer([&]() {
+                netpipe::Message msg;
+                for (dp::u64 i = 0; i < n; i++) {
+                    if (pair.server->recv_into(msg).is_err()) {
+                        break;
+                    }
+                }
+                pair.server->send(netpipe::Message{1});
+            });
+
+            netpipe::Message payload(size, 0x5A);
+            netpipe::Message ack;
+            auto start = Clock::now();
+            dp::u64 sent = 0;
+            for (; sent < n; sent++) {
+                if (pair.client->send(payload).is_err()) {
+                    break;
+                }
+            }
+            pair.client->recv_into(ack);
+            double seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+
+            peer.join();
+            close_pair(pair);
+            report(Result{"throughput", name, size, 1, sent, seconds, {}, 1.0});
+        }
+    }
+
+    // ----------------------------------------------------------------------------------------------
+    // UDP
+    // ----------------------------------------------------------------------------------------------
+
+    constexpr dp::usize UDP_MAX_PAYLOAD = 1400;
+
+    void udp_pingpong() {
+        if (!selected("pingpong", "udp")) {
+            return;
+        }
+        for (dp::usize size : sizes_up_to(UDP_MAX_PAYLOAD)) {
+            netpipe::UdpEndpoint server_endpoint{"127.0.0.1", static_cast<dp::u16>(27000 + run_counter++ % 2000)};
+            netpipe::UdpEndpoint client_endpoint{"127.0.0.1", static_cast<dp::u16>(27000 + run_counter++ % 2000)};
+            netpipe::UdpDatagram server;
+            netpipe::UdpDatagram client;
+            if (server.bind(server_endpoint).is_err() || client.bind(client_endpoint).is_err()) {
+                std::fprintf(stderr, "pingpong udp: bind failed, skipped\n");
+                continue;
+            }
+            server.set_recv_timeout(100);
+            client.set_recv_timeout(200);
+
+            std::atomic<bool> stop{false};
+            std::thread peer([&]() {
+                netpipe::Message msg;
+                while (!stop) {
+                    auto from = server.recv_from_into(msg);
+                    if (from.is_ok()) {
+                        server.send_to(msg, from.value());
+                    }
+                }
+            });
+
+            netpipe::Message request(size, 0xA5);
+            netpipe::Message reply;
+            netpipe::LatencyHistogram histogram;
+            dp::u64 n = iterations_for(size, 20000);
+            dp::u64 lost = 0;
+            auto start = Clock::now();
+            for (dp::u64 i = 0; i < n; i++) {
+                auto sent = Clock::now();
+                if (client.send_to(request, server_endpoint).is_err() || client.recv_from_into(reply).is_err()) {
+                    lost++;
+                    continue;
+                }
+                histogram.record(elapsed_ns(sent));
+            }
+            double seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+
+            stop = true;
+            peer.join();
+            server.close();
+            client.close();
+            double delivered = static_cast<double>(n - lost) / static_cast<double>(n);
+            report(Result{"pingpong", "udp", size, 1, n - lost, seconds, histogram.snapshot(), delivered});
+        }
+    }
+
+    void udp_throughput() {
+        if (!selected("throughput", "udp")) {
+            return;
+        }
+        for (dp::usize size : sizes_up_to(UDP_MAX_PAYLOAD)) {
+            netpipe::UdpEndpoint server_endpoint{"127.0.0.1", static_cast<dp::u16>(27000 + run_counter++ % 2000)};
+            netpipe::UdpDatagram server;
+            netpipe::UdpDatagram client;
+            if (server.bind(server_endpoint).is_err()) {
+                std::fprintf(stderr, "throughput udp: bind failed, skipped\n");
+                continue;
+            }
+            server.set_recv_timeout(200);
+
+            dp::u64 n = iterations_for(size, 200000);
+            std::atomic<dp::u64> received{0};
+            Clock::time_point last_arrival = Clock::now();
+            std::thread peer([&]() {
+                netpipe::Message msg;
+                while (received < n && server.recv_from_into(msg).is_ok()) {
+                    received++;
+                    last_arrival = Clock::now();
+                }
+            });
+
+            netpipe::Message payload(size, 0x5A);
+            auto start = Clock::now();
+            for (dp::u64 i = 0; i < n; i++) {
+                client.send_to(payload, server_endpoint);
+            }
+            peer.join(); // Ends on the last datagram or 200 ms after the last one that made it
+            double seconds = std::chrono::duration<double>(last_arrival - start).count();
+
+            server.close();
+            client.close();
+            double delivered = static_cast<double>(received.load()) / static_cast<double>(n);
+            report(Result{"throughput", "udp", size, 1, received.load(), seconds, {}, delivered});
+        }
+    }
+
+    // ----------------------------------------------------------------------------------------------
+    // RPC layers
+    // ----------------------------------------------------------------------------------------------
+
+    netpipe::remote::Handler echo_handler() {
+        return [](const netpipe::Message &req) -> dp::Res<netpipe::Message> { return dp::result::ok(req); };
+    }
+
+    std::vector<dp::usize> rpc_sizes() { return {64, 1024, 64u << 10}; }
+
+    void rpc_unidirect() {
+        if (!selected("rpc", "unidirect")) {
+            return;
+        }
+        // One call at a time by design: the client side reads the reply on the calling thread
+        for (dp::usize size : rpc_sizes()) {
+            StreamPair pair;
+            if (!tcp_pair(pair, size)) {
+                close_pair(pair);
+                continue;
+            }
+            std::thread peer([&]() {
+                netpipe::Remote<netpipe::Unidirect> server(*pair.server);
+                server.register_method(1, echo_handler());
+                server.serve(); // Returns once the client closes
+            });
+
+            netpipe::Remote<netpipe::Unidirect> remote(*pair.client);
+            netpipe::Message request(size, 0x11);
+            netpipe::LatencyHistogram histogram;
+            dp::u64 n = iterations_for(size, 20000);
+            auto start = Clock::now();
+            dp::u64 done = 0;
+            for (; done < n; done++) {
+                auto sent = Clock::now();
+                if (remote.call(1, request, 5000).is_err()) {
+                    break;
+                }
+                histogram.record(elapsed_ns(sent));
+            }
+            double seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+
+            pair.client->close();
+            peer.join();
+            close_pair(pair);
+            report(Result{"rpc", "unidirect", size, 1, done, seconds, histogram.snapshot(), 1.0});
+        }
+    }
+
+    void rpc_bidirect() {
+        if (!selected("rpc", "bidirect")) {
+            return;
+        }
+        for (dp::usize size : rpc_sizes()) {
+            for (dp::usize concurrency : {1u, 4u, 16u}) {
+                StreamPair pair;
+                if (!tcp_pair(pair, size)) {
+                    close_pair(pair);
+                    continue;
+                }
+                netpipe::LatencyHistogram histogram;
+                std::atomic<dp::u64> done{0};
+                dp::u64 per_thread = iterations_for(size, 20000) / concurrency + 1;
+                double seconds = 0;
+                {
+                    netpipe::Remote<netpipe::Bidirect> server(*pair.server, 256);
+                    server.register_method(1, echo_handler());
+                    netpipe::Remote<netpipe::Bidirect> remote(*pair.client, 256);
+
+                    auto start = Clock::now();
+                    std::vector<std::thread> callers;
+                    for (dp::usize t = 0; t < concurrency; t++) {
+                        callers.emplace_back([&]() {
+                            netpipe::Message request(size, 0x22);
+                            for (dp::u64 i = 0; i < per_thread; i++) {
+                                auto sent = Clock::now();
+                                if (remote.call(1, request, 5000).is_err()) {
+                                    return;
+                                }
+                                histogram.record(elapsed_ns(sent));
+                                done++;
+                            }
+                        });
+                    }
+                    for (auto &caller : callers) {
+                        caller.join();
+                    }
+                    seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+                }
+                close_pair(pair);
+                report(Result{"rpc", "bidirect", size, concurrency, done.load(), seconds, histogram.snapshot(), 1.0});
+            }
+        }
+    }
+
+    /// Serves server streams on a Remote<Bidirect>: every request gets `chunks` chunks of `chunk_size` bytes,
+    /// sent only as fast as the client's credit grants allow
+    class StreamSource {
+      private:
+        netpipe::Remote<netpipe::Bidirect> &rpc_;
+        dp::usize chunk_size_;
+        dp::u64 chunks_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        dp::i64 chunk_credit_;
+        dp::i64 byte_credit_;
+        std::thread sender_;
+
+        void send_all(dp::u32 stream_id) {
+            using netpipe::remote::MessageType;
+            netpipe::Message chunk(chunk_size_, 0x33);
+            for (dp::u64 i = 0; i < chunks_; i++) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [&] {
+                        return chunk_credit_ > 0 && byte_credit_ >= static_cast<dp::i64>(chunk_size_);
+                    });
+                    chunk_credit_--;
+                    byte_credit_ -= static_cast<dp::i64>(chunk_size_);
+                }
+                rpc_.send_frame(stream_id, 0, chunk, MessageType::StreamData);
+            }
+            rpc_.send_frame(stream_id, 0, netpipe::Message{}, MessageType::StreamEnd);
+        }
+
+      public:
+        StreamSource(netpipe::Remote<netpipe::Bidirect> &rpc, dp::usize chunk_size, dp::u64 chunks)
+            : rpc_(rpc), chunk_size_(chunk_size), chunks_(chunks) {
+            netpipe::StreamWindow window;
+            chunk_credit_ = window.chunks;
+            byte_credit_ = window.bytes;
+            rpc_.set_stream_sink([this](netpipe::remote::DecodedMessageV2 &frame) {
+                using netpipe::remote::MessageType;
+                if (frame.type == MessageType::Request) {
+                    sender_ = std::thread([this, id = frame.request_id]() { send_all(id); });
+                } else if (frame.type == MessageType::StreamCredit && frame.payload.size() >= 8) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    chunk_credit_ += netpipe::decode_u32_be(frame.payload.data());
+                    byte_credit_ += netpipe::decode_u32_be(frame.payload.data() + 4);
+                    cv_.notify_all();
+                }
+            });
+        }
+
+        ~StreamSource() {
+            rpc_.set_stream_sink(nullptr);
+            if (sender_.joinable()) {
+                sender_.join();
+            }
+        }
+    };
+
+    void rpc_streaming() {
+        if (!selected("streaming", "server_stream")) {
+            return;
+        }
+        dp::u64 total = options.quick ? (16ull << 20) : (256ull << 20);
+        for (dp::usize chunk_size : {4096u, 64u << 10, 256u << 10}) {
+            StreamPair pair;
+            if (!tcp_pair(pair, chunk_size)) {
+                close_pair(pair);
+                continue;
+            }
+            dp::u64 chunks = total / chunk_size;
+            dp::u64 received = 0;
+            double seconds = 0;
+            {
+                netpipe::Remote<netpipe::Bidirect> server(*pair.server);
+                StreamSource source(server, chunk_size, chunks);
+                netpipe::StreamingRemote streaming(*pair.client);
+
+                auto start = Clock::now();
+                auto res = streaming.server_stream(
+                    1, netpipe::Message{}, [&](const netpipe::Message &) { received++; }, 60000);
+                seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+                if (res.is_err()) {
+                    std::fprintf(stderr, "streaming: %s\n", res.error().message.c_str());
+                }
+            }
+            close_pair(pair);
+            report(Result{"streaming", "server_stream", chunk_size, 1, received, seconds, {}, 1.0});
+        }
+    }
+
+    // ----------------------------------------------------------------------------------------------
+    // Codecs
+    // ----------------------------------------------------------------------------------------------
+
+    volatile dp::usize codec_sink = 0; // Keeps the compiler from dropping the work being timed
+
+    /// Time n runs of op on one payload size; the ops are too short to time one by one
+    void codec_case(const std::string &target, dp::usize size, const std::function<dp::usize()> &op) {
+        if (!selected("codec", target)) {
+            return;
+        }
+        dp::u64 n = iterations_for(size, 2000000);
+        auto start = Clock::now();
+        for (dp::u64 i = 0; i < n; i++) {
+            codec_sink = codec_sink + op();
+        }
+        double seconds = static_cast<double>(elapsed_ns(start)) / 1e9;
+        report(Result{"codec", target, size, 1, n, seconds, {}, 1.0});
+    }
+
+    void codecs() {
+        using netpipe::remote::MessageType;
+        for (dp::usize size : sizes_up_to(1u << 20)) {
+            netpipe::Message payload(size, 0x5a);
+            auto v1 = netpipe::remote::encode_remote_message(1, payload);
+            auto v2 = netpipe::remote::encode_remote_message_v2(1, 2, payload);
+            netpipe::FrameBuilder builder(size);
+
+            codec_case("v1_encode", size, [&] { return netpipe::remote::encode_remote_message(1, payload).size(); });
+            codec_case("v1_decode", size,
+                       [&] { return netpipe::remote::decode_remote_message(v1).value().payload.size(); });
+            codec_case("v2_encode", size,
+                       [&] { return netpipe::remote::encode_remote_message_v2(1, 2, payload).size(); });
+            codec_case("v2_decode", size,
+                       [&] { return netpipe::remote::decode_remote_message_v2(v2).value().payload.size(); });
+            codec_case("v2_decode_view", size,
+                       [&] { return netpipe::remote::decode_remote_message_v2_view(v2).value().payload.size(); });
+            codec_case("frame_builder", size, [&] {
+                builder.reset();
+                builder.append(payload);
+                return builder.finish(1, 2, MessageType::Request).size();
+            });
+        }
+    }
+
+    // ----------------------------------------------------------------------------------------------
+    // Output
+    // ----------------------------------------------------------------------------------------------
+
+    void write_json(std::FILE *out) {
+        std::fprintf(out, "{\n  \"library_version\": \"%s\",\n", netpipe::remote::get_version_string().c_str());
+        std::fprintf(out, "  \"timestamp\": %lld,\n  \"quick\": %s,\n", static_cast<long long>(std::time(nullptr)),
+                     options.quick ? "true" : "false");
+        std::fprintf(out, "  \"hardware_threads\": %u,\n  \"results\": [", std::thread::hardware_concurrency());
+        for (dp::usize i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            double bytes = static_cast<double>(r.size) * static_cast<double>(r.operations);
+            if (r.suite == "pingpong" || r.suite == "rpc") {
+                bytes *= 2; // Request and reply
+            }
+            std::fprintf(out,
+                         "%s\n    {\"suite\": \"%s\", \"target\": \"%s\", \"size\": %zu, \"concurrency\": %zu, "
+                         "\"operations\": %llu, \"seconds\": %.6f, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.2f, "
+                         "\"delivered\": %.4f",
+                         i == 0 ? "" : ",", r.suite.c_str(), r.target.c_str(), r.size, r.concurrency,
+                         static_cast<unsigned long long>(r.operations), r.seconds,
+                         r.seconds > 0 ? r.operations / r.seconds : 0.0,
+                         r.seconds > 0 ? bytes / r.seconds / (1024.0 * 1024.0) : 0.0, r.delivered);
+            if (r.latency_ns.count) {
+                std::fprintf(out,
+                             ", \"latency_us\": {\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"p999\": %.2f, "
+                             "\"max\": %.2f}",
+                             r.latency_ns.percentile(0.5) / 1000.0, r.latency_ns.percentile(0.9) / 1000.0,
+                             r.latency_ns.percentile(0.99) / 1000.0, r.latency_ns.percentile(0.999) / 1000.0,
+                             r.latency_ns.max / 1000.0);
+            }
+            std::fprintf(out, "}");
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+
+    bool parse_args(int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--quick") {
+                options.quick = true;
+            } else if (arg == "--max-size" && i + 1 < argc) {
+                options.max_size = std::strtoull(argv[++i], nullptr, 10);
+            } else if (arg == "--filter" && i + 1 < argc) {
+                options.filter = argv[++i];
+            } else if (arg == "--out" && i + 1 < argc) {
+                options.out = argv[++i];
+            } else {
+                std::fprintf(stderr, "usage: %s [--quick] [--max-size BYTES] [--filter TEXT] [--out FILE]\n",
+                             argv[0]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (!parse_args(argc, argv)) {
+        return 2;
+    }
+
+    stream_pingpong("tcp", tcp_pair);
+    stream_pingpong("ipc", ipc_pair);
+    stream_pingpong("shm", shm_pair);
+    udp_pingpong();
+
+    stream_throughput("tcp", tcp_pair);
+    stream_throughput("ipc", ipc_pair);
+    stream_throughput("shm", shm_pair);
+    udp_throughput();
+
+    rpc_unidirect();
+    rpc_bidirect();
+    rpc_streaming();
+
+    codecs();
+
+    std::FILE *out = options.out.empty() ? stdout : std::fopen(options.out.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", options.out.c_str());
+        return 1;
+    }
+    write_json(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+/// Compare TcpStream (blocking read/write) with UringStream (io_uring) over loopback
+/// Each size runs a ping-pong against an echo peer of the same stream type
+
+#include <chrono>
+#include <echo/echo.hpp>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+template <typename MakeStream>
+static void run(const char *name, dp::u16 port, dp::usize size, int iterations, MakeStream make_stream) {
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", port};
+    auto listener = make_stream();
+    if (listener->listen(endpoint).is_err()) {
+        echo::error("listen failed on port ", port);
+        return;
+    }
+
+    std::thread echo_thread([&]() {
+        auto accept_res = listener->accept();
+        if (accept_res.is_err()) {
+            return;
+        }
+        auto peer = std::move(accept_res.value());
+        netpipe::Message msg;
+        while (peer->recv_into(msg).is_ok()) {
+            if (peer->send(msg).is_err()) {
+                break;
+            }
+        }
+    });
+
+    auto client = make_stream();
+    if (client->connect(endpoint).is_err()) {
+        echo::error("connect failed on port ", port);
+        listener->close();
+        echo_thread.join();
+        return;
+    }
+
+    netpipe::Message request(size, 0xAB);
+    netpipe::Message reply;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        if (client->send(request).is_err() || client->recv_into(reply).is_err()) {
+            echo::error(name, ": round trip ", i, " failed");
+            break;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double mb = static_cast<double>(size) * iterations * 2 / (1024.0 * 1024.0);
+    echo::info(name, " size=", size, " B: ", static_cast<int>(iterations / seconds), " round trips/s, ",
+               static_cast<int>(mb / seconds), " MB/s, ", seconds * 1e6 / iterations, " us/rt");
+
+    client->close();
+    echo_thread.join();
+    listener->close();
+}
+
+int main() {
+    if (!netpipe::UringStream::is_supported()) {
+        echo::error("io_uring with provided buffer rings is not available on this kernel");
+        return 1;
+    }
+
+    const dp::usize sizes[] = {64, 1024, 16 * 1024, 256 * 1024, 1024 * 1024};
+    dp::u16 port = 25001;
+
+    echo::info("=== TcpStream vs UringStream (loopback ping-pong) ===");
+    for (dp::usize size : sizes) {
+        int iterations = size >= 256 * 1024 ? 500 : 20000;
+
+        run("TcpStream  ", port++, size, iterations, []() { return std::make_unique<netpipe::TcpStream>(); });
+        run("UringStream", port++, size, iterations, []() { return std::make_unique<netpipe::UringStream>(); });
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <datapod/datapod.hpp>
+#include <echo/echo.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace netpipe {
+
+    // Byte budget for received messages that are still in flight, shared by every stream and Remote using it
+    // Receives reserve a message's length before allocating its buffer. With the budget spent they wait up to
+    // wait_ms() and then report a timeout with the message still unread. TCP and IPC leave it in the kernel
+    // socket buffer and SHM leaves it in the ring, so a sender that keeps going blocks: that is the back pressure.
+    // Above reject_at() Remotes no longer queue requests; they answer them with an error right away, so callers
+    // fail fast instead of piling more work on a full process. One process-wide instance (global()) is what
+    // streams use by default; with no limit set it costs one atomic load per receive.
+    class MemoryBudget {
+      public:
+        static constexpr dp::u32 DEFAULT_WAIT_MS = 100;
+
+        // limit_bytes 0 = unlimited
+        explicit MemoryBudget(dp::u64 limit_bytes = 0) : limit_(limit_bytes) {}
+
+        MemoryBudget(const MemoryBudget &) = delete;
+        MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+        // The budget streams and Remotes count against unless given another one
+        static MemoryBudget &global() {
+            static MemoryBudget budget;
+            return budget;
+        }
+
+        // Cap in-flight received bytes at limit_bytes (0 = unlimited); requests arriving while reject_at_bytes
+        // or more are in use are turned away (0 = wait only, never reject). Bytes already held stay counted.
+        void set_limit(dp::u64 limit_bytes, dp::u64 reject_at_bytes = 0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                limit_.store(limit_bytes, std::memory_order_release);
+                reject_at_.store(reject_at_bytes, std::memory_order_release);
+            }
+            cv_.notify_all(); // A higher limit may admit what is waiting
+        }
+
+        // How long a receive waits for budget before it reports a timeout and leaves the message unread
+        void set_wait_ms(dp::u32 wait_ms) { wait_ms_.store(wait_ms, std::memory_order_relaxed); }
+
+        dp::u64 limit() const { return limit_.load(std::memory_order_acquire); }
+        dp::u64 reject_at() const { return reject_at_.load(std::memory_order_acquire); }
+        dp::u32 wait_ms() const { return wait_ms_.load(std::memory_order_relaxed); }
+        bool enabled() const { return limit() != 0; }
+
+        // Take bytes if they fit right now
+        bool try_reserve(dp::u64 bytes) {
+            dp::u64 cap = limit();
+            dp::u64 used = in_use_.load(std::memory_order_relaxed);
+            do {
+                if (cap != 0 && used + bytes > cap && used != 0) {
+                    return false;
+                }
+            } while (!in_use_.compare_exchange_weak(used, used + bytes, std::memory_order_acq_rel));
+            note_peak(used + bytes);
+            return true;
+        }
+
+        // Take bytes, waiting up to timeout_ms for other messages to be released
+        // A message larger than the whole limit is admitted on its own once nothing else is held, so the
+        // budget bounds memory without making any valid message impossible to receive.
+        dp::Res<void> reserve(dp::u64 bytes, dp::u32 timeout_ms) {
+            if (try_reserve(bytes)) {
+                return dp::result::ok();
+            }
+            waits_.fetch_add(1, std::memory_order_relaxed);
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiters_++;
+            bool admitted =
+                cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return try_reserve(bytes); });
+            waiters_--;
+            if (!admitted) {
+                return dp::result::err(dp::Error::timeout("memory budget exhausted"));
+            }
+            return dp::result::ok();
+        }
+
+        // Give back bytes taken by try_reserve() or reserve()
+        void release(dp::u64 bytes) {
+            in_use_.fetch_sub(bytes, std::memory_order_acq_rel);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (waiters_ > 0) {
+                cv_.notify_all();
+            }
+        }
+
+        // Whether new requests should be answered with an error instead of being queued (see reject_at())
+        bool rejecting() const {
+            dp::u64 threshold = reject_at();
+            return threshold != 0 && in_use_.load(std::memory_order_acquire) >= threshold;
+        }
+
+        // Count a request turned away because of rejecting()
+        void note_rejection() { rejections_.fetch_add(1, std::memory_order_relaxed); }
+
+        dp::u64 in_use() const { return in_use_.load(std::memory_order_acquire); }
+        dp::u64 peak() const { return peak_.load(std::memory_order_relaxed); }
+        dp::u64 waits() const { return waits_.load(std::memory_order_relaxed); }
+        dp::u64 rejections() const { return rejections_.load(std::memory_order_relaxed); }
+
+      private:
+        void note_peak(dp::u64 used) {
+            dp::u64 seen = peak_.load(std::memory_order_relaxed);
+            while (used > seen && !peak_.compare_exchange_weak(seen, used, std::memory_order_relaxed)) {
+            }
+        }
+
+        std::atomic<dp::u64> limit_;
+        std::atomic<dp::u64> reject_at_{0};
+        std::atomic<dp::u32> wait_ms_{DEFAULT_WAIT_MS};
+        std::atomic<dp::u64> in_use_{0};
+        std::atomic<dp::u64> peak_{0};
+        std::atomic<dp::u64> waits_{0};
+        std::atomic<dp::u64> rejections_{0};
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        dp::u32 waiters_ = 0; // Guarded by mutex_
+    };
+
+    // Frames a receiver lets through without reserving budget, decided from their first bytes (up to
+    // BUDGET_PEEK_SIZE, fewer for a shorter frame). Protocols exempt replies and control frames this way: a handler
+    // that holds budget while it waits for the reply to a nested call must not be the reason that reply stays unread.
+    using BudgetExemption = bool (*)(const dp::u8 *frame, dp::usize size);
+    constexpr dp::usize BUDGET_PEEK_SIZE = 4;
+
+    // Bytes held against a MemoryBudget, given back when the lease is destroyed
+    // Move-only; an empty lease (no budget) is what streams hand out when they have none.
+    class BudgetLease {
+      public:
+        BudgetLease() = default;
+        BudgetLease(MemoryBudget *budget, dp::u64 bytes) : budget_(budget), bytes_(bytes) {}
+        ~BudgetLease() { release(); }
+
+        BudgetLease(BudgetLease &&other) noexcept : budget_(other.budget_), bytes_(other.bytes_) {
+            other.budget_ = nullptr;
+            other.bytes_ = 0;
+        }
+        BudgetLease &operator=(BudgetLease &&other) noexcept {
+            if (this != &other) {
+                release();
+                budget_ = other.budget_;
+                bytes_ = other.bytes_;
+                other.budget_ = nullptr;
+                other.bytes_ = 0;
+            }
+            return *this;
+        }
+        BudgetLease(const BudgetLease &) = delete;
+        BudgetLease &operator=(const BudgetLease &) = delete;
+
+        void release() {
+            if (budget_) {
+                budget_->release(bytes_);
+                budget_ = nullptr;
+                bytes_ = 0;
+            }
+        }
+
+        // Hold other's bytes as well (pieces of one message); bytes counted against another budget give way
+        void absorb(BudgetLease &&other) {
+            if (!budget_) {
+                *this = std::move(other);
+                return;
+            }
+            if (other.budget_ == budget_) {
+                bytes_ += other.bytes_;
+                other.budget_ = nullptr;
+                other.bytes_ = 0;
+            }
+            other.release();
+        }
+
+        MemoryBudget *budget() const { return budget_; }
+        dp::u64 bytes() const { return bytes_; }
+
+      private:
+        MemoryBudget *budget_ = nullptr;
+        dp::u64 bytes_ = 0;
+    };
+
+} // namespace netpipe
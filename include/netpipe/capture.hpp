@@ -0,0 +1,778 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <netpipe/datagram.hpp>
+#include <netpipe/stream.hpp>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace netpipe {
+
+    // Capture segment file - append-only, written and read through mmap, host byte order
+    //   [CaptureSegmentHeader:64]
+    //   [CaptureRecordHeader:16][payload:N][pad to 8] ...
+    //   [CaptureIndexEntry:16] x index_count            - written by close() / when the segment rolls over
+    //   [CaptureTrailer:40]
+    // A segment without a trailer (writer still running, or killed) is read by scanning records until the
+    // first one without the record marker; it just has no index.
+    // Segments of one capture are path, path.1, path.2, ... (see capture_segment_path)
+
+    enum class CaptureDirection : dp::u8 {
+        Tx = 0, // Sent by the recorded side
+        Rx = 1, // Received by the recorded side
+    };
+
+    struct CaptureSegmentHeader {
+        char magic[8];       // "NPCAPSEG"
+        dp::u32 version;     // CAPTURE_VERSION
+        dp::u32 header_size; // Offset of the first record
+        dp::u64 start_ns;    // Wall clock when the segment was opened
+        dp::u32 segment;     // Position in the capture, from 0
+        dp::u8 reserved[36];
+    };
+
+    struct CaptureRecordHeader {
+        dp::u64 timestamp_ns; // Wall clock, nanoseconds since the epoch
+        dp::u32 length;       // Payload bytes
+        dp::u16 channel;      // Which recorded connection (RecordingStream::channel)
+        dp::u8 direction;     // CaptureDirection
+        dp::u8 marker;        // CAPTURE_RECORD_MARKER; zero where the writer has not been yet
+    };
+
+    struct CaptureIndexEntry {
+        dp::u64 timestamp_ns;
+        dp::u64 offset; // Of a record header
+    };
+
+    struct CaptureTrailer {
+        dp::u64 index_offset;
+        dp::u64 index_count;
+        dp::u64 record_count;
+        dp::u64 end_ns; // Timestamp of the last record
+        char magic[8];  // "NPCAPIDX"
+    };
+
+    static_assert(sizeof(CaptureSegmentHeader) == 64, "segment header layout");
+    static_assert(sizeof(CaptureRecordHeader) == 16, "record header layout");
+    static_assert(sizeof(CaptureIndexEntry) == 16, "index entry layout");
+    static_assert(sizeof(CaptureTrailer) == 40, "trailer layout");
+
+    inline constexpr dp::u32 CAPTURE_VERSION = 1;
+    inline constexpr dp::u8 CAPTURE_RECORD_MARKER = 0xC5;
+    inline constexpr char CAPTURE_SEGMENT_MAGIC[8] = {'N', 'P', 'C', 'A', 'P', 'S', 'E', 'G'};
+    inline constexpr char CAPTURE_INDEX_MAGIC[8] = {'N', 'P', 'C', 'A', 'P', 'I', 'D', 'X'};
+
+    inline dp::String capture_segment_path(const dp::String &path, dp::u32 segment) {
+        if (segment == 0) {
+            return path;
+        }
+        return path + "." + dp::String(std::to_string(segment).c_str());
+    }
+
+    inline dp::u64 capture_now_ns() {
+        return static_cast<dp::u64>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+                .count());
+    }
+
+    inline constexpr dp::usize capture_record_size(dp::usize length) {
+        return (sizeof(CaptureRecordHeader) + length + 7) & ~static_cast<dp::usize>(7);
+    }
+
+    struct CaptureOptions {
+        dp::usize segment_size = 256 * 1024 * 1024; // Roll over to the next segment beyond this
+        dp::usize grow_size = 4 * 1024 * 1024;      // The mapping grows by this much at a time
+        dp::u32 index_interval = 256;               // Records between index entries
+    };
+
+    // Appends records to a capture; any number of threads and RecordingStreams may share one writer
+    // Records are copied straight into the mapped file, so recording costs a memcpy and a mutex per message.
+    class CaptureWriter {
+      private:
+        dp::String path_;
+        CaptureOptions options_;
+        dp::i32 fd_ = -1;
+        dp::u8 *map_ = nullptr;
+        dp::usize capacity_ = 0;
+        dp::usize offset_ = 0;
+        dp::u32 segment_ = 0;
+        dp::u64 segment_records_ = 0;
+        dp::u64 last_ns_ = 0;
+        dp::Vector<CaptureIndexEntry> index_;
+        dp::u64 records_ = 0;
+        dp::u64 bytes_ = 0;
+        std::atomic<dp::u16> next_channel_{0};
+        std::mutex mutex_;
+
+        dp::Res<void> map(dp::usize capacity) {
+            if (map_) {
+                ::munmap(map_, capacity_);
+                map_ = nullptr;
+            }
+            if (::ftruncate(fd_, static_cast<off_t>(capacity)) < 0) {
+                echo::error("capture ftruncate failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("failed to grow capture segment"));
+            }
+            void *ptr = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (ptr == MAP_FAILED) {
+                echo::error("capture mmap failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("failed to map capture segment"));
+            }
+            map_ = static_cast<dp::u8 *>(ptr);
+            capacity_ = capacity;
+            return dp::result::ok();
+        }
+
+        dp::Res<void> open_segment(dp::u32 segment) {
+            auto path = capture_segment_path(path_, segment);
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd_ < 0) {
+                echo::error("capture open failed: ", path.c_str(), ": ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("failed to create capture segment"));
+            }
+            auto res = map(options_.grow_size > 4096 ? options_.grow_size : 4096);
+            if (res.is_err()) {
+                ::close(fd_);
+                fd_ = -1;
+                return res;
+            }
+
+            CaptureSegmentHeader header = {};
+            std::memcpy(header.magic, CAPTURE_SEGMENT_MAGIC, sizeof(header.magic));
+            header.version = CAPTURE_VERSION;
+            header.header_size = sizeof(CaptureSegmentHeader);
+            header.start_ns = capture_now_ns();
+            header.segment = segment;
+            std::memcpy(map_, &header, sizeof(header));
+
+            segment_ = segment;
+            offset_ = sizeof(CaptureSegmentHeader);
+            segment_records_ = 0;
+            index_.clear();
+            echo::debug("capture segment ", path.c_str(), " opened");
+            return dp::result::ok();
+        }
+
+        // Unmap, cut the file at the last record and append the index and trailer
+        void finish_segment() {
+            if (fd_ < 0) {
+                return;
+            }
+            ::munmap(map_, capacity_);
+            map_ = nullptr;
+            capacity_ = 0;
+            if (::ftruncate(fd_, static_cast<off_t>(offset_)) < 0 ||
+                ::lseek(fd_, static_cast<off_t>(offset_), SEEK_SET) < 0) {
+                echo::warn("capture truncate failed: ", strerror(errno));
+            }
+
+            CaptureTrailer trailer = {};
+            trailer.index_offset = offset_;
+            trailer.index_count = index_.size();
+            trailer.record_count = segment_records_;
+            trailer.end_ns = last_ns_;
+            std::memcpy(trailer.magic, CAPTURE_INDEX_MAGIC, sizeof(trailer.magic));
+            bool ok = write_exact(fd_, reinterpret_cast<const dp::u8 *>(index_.data()),
+                                  index_.size() * sizeof(CaptureIndexEntry))
+                          .is_ok() &&
+                      write_exact(fd_, reinterpret_cast<const dp::u8 *>(&trailer), sizeof(trailer)).is_ok();
+            if (!ok) {
+                echo::warn("capture index write failed; the segment will be scanned instead");
+            }
+            ::close(fd_);
+            fd_ = -1;
+        }
+
+      public:
+        CaptureWriter() = default;
+
+        ~CaptureWriter() { close(); }
+
+        CaptureWriter(const CaptureWriter &) = delete;
+        CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+        // Start a capture at path, replacing an existing segment 0; later segments are path.1, path.2, ...
+        dp::Res<void> open(const dp::String &path, const CaptureOptions &options = {}) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fd_ >= 0) {
+                return dp::result::err(dp::Error::invalid_argument("capture already open"));
+            }
+            path_ = path;
+            options_ = options;
+            if (options_.index_interval == 0) {
+                options_.index_interval = 1;
+            }
+            records_ = 0;
+            bytes_ = 0;
+            return open_segment(0);
+        }
+
+        // Append one message given as a list of buffers (gathered as they are copied in)
+        dp::Res<void> append_iov(CaptureDirection direction, dp::u16 channel, std::span<const iovec> parts) {
+            dp::usize length = 0;
+            for (const auto &part : parts) {
+                length += part.iov_len;
+            }
+            if (length > 0xFFFFFFFFu) {
+                return dp::result::err(dp::Error::invalid_argument("message too large to capture"));
+            }
+            dp::usize size = capture_record_size(length);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fd_ < 0) {
+                return dp::result::err(dp::Error::invalid_argument("capture not open"));
+            }
+            if (offset_ + size > options_.segment_size && segment_records_ > 0) {
+                finish_segment();
+                auto res = open_segment(segment_ + 1);
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            if (offset_ + size > capacity_) {
+                dp::usize capacity = capacity_ + options_.grow_size;
+                if (capacity < offset_ + size) {
+                    capacity = offset_ + size;
+                }
+                auto res = map(capacity);
+                if (res.is_err()) {
+                    ::close(fd_);
+                    fd_ = -1;
+                    return res;
+                }
+            }
+
+            dp::u64 now = capture_now_ns();
+            if (segment_records_ % options_.index_interval == 0) {
+                index_.push_back(CaptureIndexEntry{now, offset_});
+            }
+            dp::u8 *record = map_ + offset_;
+            dp::usize at = sizeof(CaptureRecordHeader);
+            for (const auto &part : parts) {
+                if (part.iov_len > 0) {
+                    std::memcpy(record + at, part.iov_base, part.iov_len);
+                    at += part.iov_len;
+                }
+            }
+            // The marker goes in last, so a scanning reader never sees a record before its payload
+            CaptureRecordHeader header{now, static_cast<dp::u32>(length), channel, static_cast<dp::u8>(direction), 0};
+            std::memcpy(record, &header, sizeof(header));
+            std::atomic_thread_fence(std::memory_order_release);
+            record[offsetof(CaptureRecordHeader, marker)] = CAPTURE_RECORD_MARKER;
+
+            offset_ += size;
+            segment_records_++;
+            records_++;
+            bytes_ += length;
+            last_ns_ = now;
+            return dp::result::ok();
+        }
+
+        dp::Res<void> append(CaptureDirection direction, dp::u16 channel, std::span<const dp::u8> payload) {
+            iovec part{const_cast<dp::u8 *>(payload.data()), payload.size()};
+            return append_iov(direction, channel, std::span<const iovec>(&part, 1));
+        }
+
+        // Schedule the mapped records for writeback (the kernel writes them eventually regardless)
+        dp::Res<void> flush() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!map_) {
+                return dp::result::ok();
+            }
+            if (::msync(map_, offset_, MS_ASYNC) < 0) {
+                return dp::result::err(dp::Error::io_error("msync failed"));
+            }
+            return dp::result::ok();
+        }
+
+        // Finish the current segment with its index
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finish_segment();
+        }
+
+        // Channel numbers for RecordingStreams sharing this writer
+        dp::u16 allocate_channel() { return next_channel_.fetch_add(1, std::memory_order_relaxed); }
+
+        bool is_open() const { return fd_ >= 0; }
+        dp::u64 record_count() const { return records_; }
+        dp::u64 bytes_recorded() const { return bytes_; }
+        dp::u32 segment_count() const { return fd_ >= 0 || records_ > 0 ? segment_ + 1 : 0; }
+    };
+
+    // One captured message; payload points into the reader's mapping and lives as long as the reader
+    struct CaptureRecord {
+        dp::u64 timestamp_ns;
+        CaptureDirection direction;
+        dp::u16 channel;
+        std::span<const dp::u8> payload;
+    };
+
+    // Reads one capture segment through a read-only mapping - records are never copied
+    class CaptureReader {
+      private:
+        dp::i32 fd_ = -1;
+        const dp::u8 *map_ = nullptr;
+        dp::usize size_ = 0;
+        dp::usize records_begin_ = 0;
+        dp::usize records_end_ = 0;
+        dp::usize cursor_ = 0;
+        const CaptureIndexEntry *index_ = nullptr;
+        dp::usize index_count_ = 0;
+        dp::u64 record_count_ = 0;
+        dp::u64 start_ns_ = 0;
+        dp::u32 segment_ = 0;
+
+        // Record at offset, or false past the end / at the first slot the writer has not filled
+        bool record_at(dp::usize offset, CaptureRecordHeader &header) const {
+            if (offset + sizeof(CaptureRecordHeader) > records_end_) {
+                return false;
+            }
+            std::memcpy(&header, map_ + offset, sizeof(header));
+            return header.marker == CAPTURE_RECORD_MARKER &&
+                   offset + sizeof(CaptureRecordHeader) + header.length <= records_end_;
+        }
+
+      public:
+        CaptureReader() = default;
+
+        ~CaptureReader() { close(); }
+
+        CaptureReader(const CaptureReader &) = delete;
+        CaptureReader &operator=(const CaptureReader &) = delete;
+
+        dp::Res<void> open(const dp::String &path) {
+            close();
+            fd_ = ::open(path.c_str(), O_RDONLY);
+            if (fd_ < 0) {
+                return dp::result::err(dp::Error::not_found("capture segment not found"));
+            }
+            struct stat st = {};
+            if (::fstat(fd_, &st) < 0 || static_cast<dp::usize>(st.st_size) < sizeof(CaptureSegmentHeader)) {
+                close();
+                return dp::result::err(dp::Error::invalid_argument("not a capture segment"));
+            }
+            size_ = static_cast<dp::usize>(st.st_size);
+            void *ptr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+            if (ptr == MAP_FAILED) {
+                echo::error("capture mmap failed: ", strerror(errno));
+                close();
+                return dp::result::err(dp::Error::io_error("failed to map capture segment"));
+            }
+            map_ = static_cast<const dp::u8 *>(ptr);
+
+            CaptureSegmentHeader header;
+            std::memcpy(&header, map_, sizeof(header));
+            if (std::memcmp(header.magic, CAPTURE_SEGMENT_MAGIC, sizeof(header.magic)) != 0 ||
+                header.version != CAPTURE_VERSION || header.header_size < sizeof(header) ||
+                header.header_size > size_) {
+                close();
+                return dp::result::err(dp::Error::invalid_argument("not a capture segment"));
+            }
+            start_ns_ = header.start_ns;
+            segment_ = header.segment;
+            records_begin_ = header.header_size;
+            records_end_ = size_;
+
+            CaptureTrailer trailer = {};
+            if (size_ >= records_begin_ + sizeof(trailer)) {
+                std::memcpy(&trailer, map_ + size_ - sizeof(trailer), sizeof(trailer));
+            }
+            bool indexed = std::memcmp(trailer.magic, CAPTURE_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+                           trailer.index_offset >= records_begin_ &&
+                           trailer.index_offset + trailer.index_count * sizeof(CaptureIndexEntry) + sizeof(trailer) ==
+                               size_;
+            if (indexed) {
+                records_end_ = trailer.index_offset;
+                index_ = reinterpret_cast<const CaptureIndexEntry *>(map_ + trailer.index_offset);
+                index_count_ = trailer.index_count;
+                record_count_ = trailer.record_count;
+            } else {
+                // Unfinished segment: count what the writer has completed so far
+                CaptureRecordHeader record;
+                dp::usize offset = records_begin_;
+                while (record_at(offset, record)) {
+                    record_count_++;
+                    offset += capture_record_size(record.length);
+                }
+                records_end_ = offset < size_ ? offset : size_;
+            }
+            cursor_ = records_begin_;
+            return dp::result::ok();
+        }
+
+        // Next record, or not_found at the end of the segment
+        dp::Res<CaptureRecord> next() {
+            CaptureRecordHeader header;
+            if (!map_ || !record_at(cursor_, header)) {
+                return dp::result::err(dp::Error::not_found("end of capture segment"));
+            }
+            CaptureRecord record{header.timestamp_ns, static_cast<CaptureDirection>(header.direction), header.channel,
+                                 std::span<const dp::u8>(map_ + cursor_ + sizeof(header), header.length)};
+            cursor_ += capture_record_size(header.length);
+            return dp::result::ok(record);
+        }
+
+        // Position on the first record at or after timestamp_ns, starting from the nearest index entry
+        void seek(dp::u64 timestamp_ns) {
+            cursor_ = records_begin_;
+            dp::usize lo = 0;
+            dp::usize hi = index_count_;
+            while (lo < hi) {
+                dp::usize mid = (lo + hi) / 2;
+                if (index_[mid].timestamp_ns <= timestamp_ns) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo > 0) {
+                cursor_ = index_[lo - 1].offset;
+            }
+            CaptureRecordHeader header;
+            while (record_at(cursor_, header) && header.timestamp_ns < timestamp_ns) {
+                cursor_ += capture_record_size(header.length);
+            }
+        }
+
+        void rewind() { cursor_ = records_begin_; }
+
+        void close() {
+            if (map_) {
+                ::munmap(const_cast<dp::u8 *>(map_), size_);
+                map_ = nullptr;
+            }
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+            size_ = records_begin_ = records_end_ = cursor_ = 0;
+            index_ = nullptr;
+            index_count_ = 0;
+            record_count_ = 0;
+        }
+
+        bool is_open() const { return map_ != nullptr; }
+        bool indexed() const { return index_ != nullptr; }
+        dp::u64 record_count() const { return record_count_; }
+        dp::u64 start_ns() const { return start_ns_; }
+        dp::u32 segment() const { return segment_; }
+    };
+
+    // Stream decorator that records every message sent and received through it
+    // The wrapped stream does the I/O; a message is recorded after it was sent or received successfully.
+    // Streams returned by accept() are wrapped as well, each on a channel of its own.
+    class RecordingStream : public Stream {
+      private:
+        Stream *inner_;
+        std::unique_ptr<Stream> owned_;
+        CaptureWriter &writer_;
+        dp::u16 channel_;
+
+        void record(CaptureDirection direction, std::span<const iovec> parts) {
+            if (writer_.append_iov(direction, channel_, parts).is_err()) {
+                echo::warn("RecordingStream: capture append failed");
+            }
+        }
+
+        void record(CaptureDirection direction, const Message &msg) {
+            iovec part{const_cast<dp::u8 *>(msg.data()), msg.size()};
+            record(direction, std::span<const iovec>(&part, 1));
+        }
+
+      public:
+        // inner must outlive this stream
+        RecordingStream(Stream &inner, CaptureWriter &writer)
+            : inner_(&inner), writer_(writer), channel_(writer.allocate_channel()) {}
+
+        RecordingStream(std::unique_ptr<Stream> inner, CaptureWriter &writer)
+            : inner_(inner.get()), owned_(std::move(inner)), writer_(writer), channel_(writer.allocate_channel()) {}
+
+        dp::Res<void> connect(const TcpEndpoint &endpoint) override { return inner_->connect(endpoint); }
+
+        dp::Res<void> listen(const TcpEndpoint &endpoint) override { return inner_->listen(endpoint); }
+
+        dp::Res<std::unique_ptr<Stream>> accept() override {
+            auto res = inner_->accept();
+            if (res.is_err()) {
+                return res;
+            }
+            return dp::result::ok(std::unique_ptr<Stream>(new RecordingStream(std::move(res.value()), writer_)));
+        }
+
+        dp::Res<void> send(const Message &msg) override {
+            auto res = inner_->send(msg);
+            if (res.is_ok()) {
+                record(CaptureDirection::Tx, msg);
+            }
+            return res;
+        }
+
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
+            auto res = inner_->send_iov(parts);
+            if (res.is_ok()) {
+                record(CaptureDirection::Tx, parts);
+            }
+            return res;
+        }
+
+        dp::Res<void> send_batch(std::span<const std::span<const iovec>> frames) override {
+            auto res = inner_->send_batch(frames);
+            if (res.is_ok()) {
+                for (const auto &parts : frames) {
+                    record(CaptureDirection::Tx, parts);
+                }
+            }
+            return res;
+        }
+
+        dp::Res<Message> recv() override {
+            auto res = inner_->recv();
+            if (res.is_ok()) {
+                record(CaptureDirection::Rx, res.value());
+            }
+            return res;
+        }
+
+        dp::Res<void> recv_into(Message &msg) override {
+            auto res = inner_->recv_into(msg);
+            if (res.is_ok()) {
+                record(CaptureDirection::Rx, msg);
+            }
+            return res;
+        }
+
+        dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) override {
+            auto res = inner_->recv_split(prefix, prefix_len, rest);
+            if (res.is_ok()) {
+                iovec parts[2] = {{prefix, res.value()}, {rest.data(), rest.size()}};
+                record(CaptureDirection::Rx, std::span<const iovec>(parts, 2));
+            }
+            return res;
+        }
+
+        bool has_pending_input() const override { return inner_->has_pending_input(); }
+
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override { return inner_->set_recv_timeout(timeout_ms); }
+
+        void close() override { inner_->close(); }
+
+        bool is_connected() const override { return inner_->is_connected(); }
+
+        dp::i32 native_handle() const override { return inner_->native_handle(); }
+
+        dp::u16 channel() const { return channel_; }
+    };
+
+    // Datagram decorator that records payloads sent and received through it (peers are not recorded)
+    class RecordingDatagram : public Datagram {
+      private:
+        Datagram &inner_;
+        CaptureWriter &writer_;
+        dp::u16 channel_;
+
+        void record(CaptureDirection direction, const Message &msg) {
+            if (writer_.append(direction, channel_, std::span<const dp::u8>(msg.data(), msg.size())).is_err()) {
+                echo::warn("RecordingDatagram: capture append failed");
+            }
+        }
+
+      public:
+        RecordingDatagram(Datagram &inner, CaptureWriter &writer)
+            : inner_(inner), writer_(writer), channel_(writer.allocate_channel()) {}
+
+        dp::Res<void> bind(const UdpEndpoint &endpoint) override { return inner_.bind(endpoint); }
+
+        dp::Res<void> send_to(const Message &msg, const UdpEndpoint &dest) override {
+            auto res = inner_.send_to(msg, dest);
+            if (res.is_ok()) {
+                record(CaptureDirection::Tx, msg);
+            }
+            return res;
+        }
+
+        dp::Res<void> broadcast(const Message &msg) override {
+            auto res = inner_.broadcast(msg);
+            if (res.is_ok()) {
+                record(CaptureDirection::Tx, msg);
+            }
+            return res;
+        }
+
+        dp::Res<dp::Pair<Message, UdpEndpoint>> recv_from() override {
+            auto res = inner_.recv_from();
+            if (res.is_ok()) {
+                record(CaptureDirection::Rx, res.value().first);
+            }
+            return res;
+        }
+
+        dp::Res<UdpEndpoint> recv_from_into(Message &msg) override {
+            auto res = inner_.recv_from_into(msg);
+            if (res.is_ok()) {
+                record(CaptureDirection::Rx, msg);
+            }
+            return res;
+        }
+
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override { return inner_.set_recv_timeout(timeout_ms); }
+
+        void close() override { inner_.close(); }
+
+        dp::u16 channel() const { return channel_; }
+    };
+
+    struct ReplayOptions {
+        double speed = 1.0;                                // 1 = original pacing, 2 = twice as fast, 0 = max rate
+        CaptureDirection direction = CaptureDirection::Tx; // Which side's messages to send again
+        dp::i32 channel = -1;                              // Only this recorded channel, or -1 for all
+        dp::u64 from_ns = 0;                               // Skip records before this timestamp
+        dp::u32 settle_ms = 1000;                          // Stream replay: wait this long for missing responses
+    };
+
+    struct ReplayStats {
+        dp::u64 messages = 0;
+        dp::u64 bytes = 0;
+        dp::u64 responses = 0;  // Messages the target sent back while the replay ran (Stream replay only)
+        dp::u64 elapsed_ns = 0; // First send to last send
+        dp::u64 max_lag_ns = 0; // Worst delay behind the recorded schedule
+    };
+
+    // Sends a capture (every segment, in order) into a Stream or Datagram at the recorded pace or flat out
+    // Point a capture of a Remote client's traffic at a server and the server sees the same requests again:
+    // the replayer drains whatever comes back on a second thread so the server never blocks on its sends.
+    class CaptureReplayer {
+      private:
+        dp::String path_;
+
+        template <typename Send> dp::Res<ReplayStats> run(const ReplayOptions &options, Send &&send) {
+            ReplayStats stats;
+            bool have_first = false;
+            dp::u64 first_ns = 0;
+            auto wall_start = std::chrono::steady_clock::now();
+            auto last_send = wall_start;
+
+            CaptureReader reader;
+            for (dp::u32 segment = 0;; segment++) {
+                auto res = reader.open(capture_segment_path(path_, segment));
+                if (res.is_err()) {
+                    if (segment == 0) {
+                        return dp::result::err(res.error());
+                    }
+                    break;
+                }
+                if (options.from_ns > 0) {
+                    reader.seek(options.from_ns);
+                }
+                while (true) {
+                    auto record = reader.next();
+                    if (record.is_err()) {
+                        break;
+                    }
+                    const auto &rec = record.value();
+                    if (rec.direction != options.direction ||
+                        (options.channel >= 0 && rec.channel != static_cast<dp::u16>(options.channel))) {
+                        continue;
+                    }
+                    if (!have_first) {
+                        have_first = true;
+                        first_ns = rec.timestamp_ns;
+                        wall_start = std::chrono::steady_clock::now();
+                    }
+                    if (options.speed > 0) {
+                        dp::u64 offset = rec.timestamp_ns > first_ns ? rec.timestamp_ns - first_ns : 0;
+                        auto due = wall_start + std::chrono::nanoseconds(static_cast<dp::i64>(offset / options.speed));
+                        auto now = std::chrono::steady_clock::now();
+                        if (now < due) {
+                            std::this_thread::sleep_until(due);
+                        } else {
+                            auto lag = static_cast<dp::u64>(
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count());
+                            stats.max_lag_ns = lag > stats.max_lag_ns ? lag : stats.max_lag_ns;
+                        }
+                    }
+                    auto sent = send(rec.payload);
+                    if (sent.is_err()) {
+                        return dp::result::err(sent.error());
+                    }
+                    last_send = std::chrono::steady_clock::now();
+                    stats.messages++;
+                    stats.bytes += rec.payload.size();
+                }
+            }
+            if (have_first) {
+                stats.elapsed_ns = static_cast<dp::u64>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(last_send - wall_start).count());
+            }
+            return dp::result::ok(stats);
+        }
+
+      public:
+        explicit CaptureReplayer(const dp::String &path) : path_(path) {}
+
+        // Replay into a connected stream, counting what comes back
+        // Returns once everything is sent and either one response per message arrived or settle_ms passed quietly
+        dp::Res<ReplayStats> replay(Stream &target, const ReplayOptions &options = {}) {
+            std::atomic<dp::u64> responses{0};
+            std::atomic<bool> stop{false};
+            target.set_recv_timeout(50);
+            std::thread drain([&]() {
+                Message msg;
+                while (!stop.load(std::memory_order_acquire)) {
+                    auto res = target.recv_into(msg);
+                    if (res.is_ok()) {
+                        responses.fetch_add(1, std::memory_order_relaxed);
+                    } else if (res.error().code != dp::Error::TIMEOUT) {
+                        break;
+                    }
+                }
+            });
+
+            auto result = run(options, [&](std::span<const dp::u8> payload) {
+                iovec part{const_cast<dp::u8 *>(payload.data()), payload.size()};
+                return target.send_iov(std::span<const iovec>(&part, 1));
+            });
+
+            if (result.is_ok()) {
+                dp::u64 expected = result.value().messages;
+                dp::u64 seen = responses.load();
+                auto quiet_since = std::chrono::steady_clock::now();
+                while (seen < expected &&
+                       std::chrono::steady_clock::now() - quiet_since < std::chrono::milliseconds(options.settle_ms)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    if (responses.load() != seen) {
+                        seen = responses.load();
+                        quiet_since = std::chrono::steady_clock::now();
+                    }
+                }
+            }
+            stop.store(true, std::memory_order_release);
+            drain.join();
+            target.set_recv_timeout(0);
+            if (result.is_ok()) {
+                result.value().responses = responses.load();
+            }
+            return result;
+        }
+
+        // Replay into a datagram, every message to dest
+        dp::Res<ReplayStats> replay(Datagram &target, const UdpEndpoint &dest, const ReplayOptions &options = {}) {
+            Message msg;
+            return run(options, [&](std::span<const dp::u8> payload) {
+                msg.assign(payload.begin(), payload.end());
+                return target.send_to(msg, dest);
+            });
+        }
+    };
+
+} // namespace netpipe
@@ -2,9 +2,23 @@
 
 #include <datapod/datapod.hpp>
 #include <echo/echo.hpp>
+#include <netpipe/budget.hpp>
+#include <netpipe/stats.hpp>
+#include <netpipe/trace.hpp>
 
 #include <cerrno>
 #include <cstring>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <new>
+#include <optional>
+#include <poll.h>
+#include <span>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace netpipe {
@@ -14,7 +28,6 @@ namespace netpipe {
 
     // Big-endian encoding for length-prefix framing
     inline dp::Array<dp::u8, 4> encode_u32_be(dp::u32 value) {
-        echo::trace("encode_u32_be: value=", value);
         dp::Array<dp::u8, 4> bytes;
         bytes[0] = static_cast<dp::u8>((value >> 24) & 0xFF);
         bytes[1] = static_cast<dp::u8>((value >> 16) & 0xFF);
@@ -27,7 +40,6 @@ namespace netpipe {
     inline dp::u32 decode_u32_be(const dp::u8 *bytes) {
         dp::u32 value = (static_cast<dp::u32>(bytes[0]) << 24) | (static_cast<dp::u32>(bytes[1]) << 16) |
                         (static_cast<dp::u32>(bytes[2]) << 8) | static_cast<dp::u32>(bytes[3]);
-        echo::trace("decode_u32_be: value=", value);
         return value;
     }
 
@@ -37,50 +49,60 @@ namespace netpipe {
         buffer.insert(buffer.end(), bytes.begin(), bytes.end());
     }
 
-    // Helper to read exactly n bytes from a file descriptor
-    // Returns dp::Res<void> - ok if all bytes read, error otherwise
+    // Map errno from a failed read to the shared error categories
     // ERROR CATEGORIZATION:
     // - timeout: EAGAIN/EWOULDBLOCK (expected, recoverable)
-    // - not_found: connection closed (ECONNRESET, EPIPE, EOF)
+    // - not_found: connection closed (ECONNRESET, EPIPE, EBADF, ENOTCONN)
     // - io_error: other I/O errors (unexpected, may be recoverable)
-    inline dp::Res<void> read_exact(dp::i32 fd, dp::u8 *buffer, dp::usize count) {
+    inline dp::Error read_error_from_errno(dp::i32 fd, dp::usize wanted, dp::usize got) {
+        // EAGAIN/EWOULDBLOCK: Timeout - expected behavior with SO_RCVTIMEO
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            echo::trace("read timeout (fd=", fd, ", wanted=", wanted, ", got=", got, ")");
+            return dp::Error::timeout("read timeout");
+        }
+
+        // Connection closed errors - fatal, not recoverable
+        if (errno == ECONNRESET) {
+            echo::trace("read failed: connection reset by peer (fd=", fd, ")");
+            return dp::Error::not_found("connection reset by peer");
+        }
+        if (errno == EPIPE) {
+            echo::trace("read failed: broken pipe (fd=", fd, ")");
+            return dp::Error::not_found("broken pipe");
+        }
+        if (errno == EBADF) {
+            echo::trace("read failed: bad file descriptor (fd=", fd, ")");
+            return dp::Error::not_found("bad file descriptor");
+        }
+        if (errno == ENOTCONN) {
+            echo::trace("read failed: socket not connected (fd=", fd, ")");
+            return dp::Error::not_found("socket not connected");
+        }
+
+        // Other I/O errors - log errno for debugging
+        echo::trace("read failed: ", strerror(errno), " (errno=", errno, ", fd=", fd, ")");
+        return dp::Error::io_error(dp::String("read error: ") + strerror(errno));
+    }
+
+    // Helper to read exactly n bytes from a file descriptor
+    // Returns dp::Res<void> - ok if all bytes read, error otherwise
+    // Errors are categorized by read_error_from_errno(); EOF is not_found
+    // counters (optional) sees every read(2), and which of them came back short
+    inline dp::Res<void> read_exact(dp::i32 fd, dp::u8 *buffer, dp::usize count,
+                                    TransportCounters *counters = nullptr) {
         dp::usize total_read = 0;
         while (total_read < count) {
             dp::isize n = ::read(fd, buffer + total_read, count - total_read);
+            if (counters) {
+                counters->on_recv_call(n > 0 && total_read + static_cast<dp::usize>(n) < count);
+            }
             if (n < 0) {
                 // EINTR: Interrupted by signal - retry transparently
                 if (errno == EINTR) {
                     echo::trace("read interrupted by signal, retrying");
                     continue;
                 }
-
-                // EAGAIN/EWOULDBLOCK: Timeout - expected behavior with SO_RCVTIMEO
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    echo::trace("read timeout (fd=", fd, ", wanted=", count, ", got=", total_read, ")");
-                    return dp::result::err(dp::Error::timeout("read timeout"));
-                }
-
-                // Connection closed errors - fatal, not recoverable
-                if (errno == ECONNRESET) {
-                    echo::trace("read failed: connection reset by peer (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("connection reset by peer"));
-                }
-                if (errno == EPIPE) {
-                    echo::trace("read failed: broken pipe (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("broken pipe"));
-                }
-                if (errno == EBADF) {
-                    echo::trace("read failed: bad file descriptor (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("bad file descriptor"));
-                }
-                if (errno == ENOTCONN) {
-                    echo::trace("read failed: socket not connected (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("socket not connected"));
-                }
-
-                // Other I/O errors - log errno for debugging
-                echo::trace("read failed: ", strerror(errno), " (errno=", errno, ", fd=", fd, ")");
-                return dp::result::err(dp::Error::io_error(dp::String("read error: ") + strerror(errno)));
+                return dp::result::err(read_error_from_errno(fd, count, total_read));
             }
 
             // n == 0: EOF - connection closed gracefully
@@ -90,60 +112,870 @@ namespace netpipe {
             }
 
             total_read += static_cast<dp::usize>(n);
-            echo::trace("read ", n, " bytes, total=", total_read, "/", count, " (fd=", fd, ")");
+            NETPIPE_TRACE(IoRead, static_cast<dp::u32>(fd), 0, static_cast<dp::u64>(n));
         }
         return dp::result::ok();
     }
 
+    // Map errno from a failed write/writev to the shared error categories
+    // ERROR CATEGORIZATION:
+    // - not_found: connection closed (ECONNRESET, EPIPE, EBADF, ENOTCONN)
+    // - io_error: would block or other I/O errors (unexpected, may be recoverable)
+    inline dp::Error write_error_from_errno(dp::i32 fd, dp::usize wanted, dp::usize written) {
+        // Connection closed errors - fatal, not recoverable
+        if (errno == ECONNRESET) {
+            echo::trace("write failed: connection reset by peer (fd=", fd, ")");
+            return dp::Error::not_found("connection reset by peer");
+        }
+        if (errno == EPIPE) {
+            echo::trace("write failed: broken pipe (fd=", fd, ")");
+            return dp::Error::not_found("broken pipe");
+        }
+        if (errno == EBADF) {
+            echo::trace("write failed: bad file descriptor (fd=", fd, ")");
+            return dp::Error::not_found("bad file descriptor");
+        }
+        if (errno == ENOTCONN) {
+            echo::trace("write failed: socket not connected (fd=", fd, ")");
+            return dp::Error::not_found("socket not connected");
+        }
+
+        // Buffer full errors - may be recoverable with retry
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            echo::trace("write would block (fd=", fd, ", wanted=", wanted, ", wrote=", written, ")");
+            return dp::Error::io_error("write would block");
+        }
+
+        // Other I/O errors - log errno for debugging
+        echo::trace("write failed: ", strerror(errno), " (errno=", errno, ", fd=", fd, ")");
+        return dp::Error::io_error(dp::String("write error: ") + strerror(errno));
+    }
+
     // Helper to write exactly n bytes to a file descriptor
     // Returns dp::Res<void> - ok if all bytes written, error otherwise
-    // ERROR CATEGORIZATION:
-    // - not_found: connection closed (ECONNRESET, EPIPE, EBADF)
-    // - io_error: other I/O errors (unexpected, may be recoverable)
-    inline dp::Res<void> write_exact(dp::i32 fd, const dp::u8 *buffer, dp::usize count) {
+    // Errors are categorized by write_error_from_errno(); counters (optional) sees every write(2)
+    inline dp::Res<void> write_exact(dp::i32 fd, const dp::u8 *buffer, dp::usize count,
+                                     TransportCounters *counters = nullptr) {
         dp::usize total_written = 0;
         while (total_written < count) {
             dp::isize n = ::write(fd, buffer + total_written, count - total_written);
+            if (counters) {
+                counters->on_send_call(n > 0 && total_written + static_cast<dp::usize>(n) < count);
+            }
             if (n < 0) {
                 // EINTR: Interrupted by signal - retry transparently
                 if (errno == EINTR) {
                     echo::trace("write interrupted by signal, retrying");
                     continue;
                 }
+                return dp::result::err(write_error_from_errno(fd, count, total_written));
+            }
 
-                // Connection closed errors - fatal, not recoverable
-                if (errno == ECONNRESET) {
-                    echo::trace("write failed: connection reset by peer (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("connection reset by peer"));
-                }
-                if (errno == EPIPE) {
-                    echo::trace("write failed: broken pipe (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("broken pipe"));
+            total_written += static_cast<dp::usize>(n);
+            NETPIPE_TRACE(IoWrite, static_cast<dp::u32>(fd), 0, static_cast<dp::u64>(n));
+        }
+        return dp::result::ok();
+    }
+
+    // Helper to write a scatter/gather list completely with writev
+    // The iovec array is consumed in place: entries are advanced past bytes already written
+    // Returns dp::Res<void> - ok if all bytes written, error otherwise; counters (optional) sees every writev(2)
+    inline dp::Res<void> writev_exact(dp::i32 fd, iovec *iov, dp::i32 iovcnt, TransportCounters *counters = nullptr) {
+        dp::usize count = 0;
+        for (dp::i32 i = 0; i < iovcnt; i++) {
+            count += iov[i].iov_len;
+        }
+
+        dp::usize total_written = 0;
+        while (iovcnt > 0) {
+            // Skip entries that are already fully written (or empty)
+            if (iov->iov_len == 0) {
+                iov++;
+                iovcnt--;
+                continue;
+            }
+
+            dp::isize n = ::writev(fd, iov, iovcnt);
+            if (counters) {
+                counters->on_send_call(n > 0 && total_written + static_cast<dp::usize>(n) < count);
+            }
+            if (n < 0) {
+                // EINTR: Interrupted by signal - retry transparently
+                if (errno == EINTR) {
+                    echo::trace("writev interrupted by signal, retrying");
+                    continue;
                 }
-                if (errno == EBADF) {
-                    echo::trace("write failed: bad file descriptor (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("bad file descriptor"));
+                return dp::result::err(write_error_from_errno(fd, count, total_written));
+            }
+
+            total_written += static_cast<dp::usize>(n);
+            NETPIPE_TRACE(IoWrite, static_cast<dp::u32>(fd), 0, static_cast<dp::u64>(n));
+
+            // Advance past the bytes the kernel accepted (short writes split an entry)
+            dp::usize remaining = static_cast<dp::usize>(n);
+            while (iovcnt > 0 && remaining >= iov->iov_len) {
+                remaining -= iov->iov_len;
+                iov++;
+                iovcnt--;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = static_cast<dp::u8 *>(iov->iov_base) + remaining;
+                iov->iov_len -= remaining;
+            }
+        }
+        return dp::result::ok();
+    }
+
+    // Message bytes of a send_batch() argument, without the length prefixes
+    inline dp::u64 frames_size(std::span<const std::span<const iovec>> frames) {
+        dp::u64 total = 0;
+        for (const auto &parts : frames) {
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
+        }
+        return total;
+    }
+
+    // Frame several messages with one length prefix each and write them with as few writev calls as possible
+    // Each entry of frames is the part list of one message; prefixes live on the stack in fixed-size rounds
+    inline dp::Res<void> writev_frames(dp::i32 fd, std::span<const std::span<const iovec>> frames,
+                                       TransportCounters *counters = nullptr) {
+        constexpr dp::usize ROUND_IOVS = 256; // Well below IOV_MAX (1024)
+        iovec iov[ROUND_IOVS];
+        dp::Array<dp::u8, 4> prefixes[ROUND_IOVS / 2];
+
+        dp::usize frame = 0;
+        while (frame < frames.size()) {
+            dp::usize iovcnt = 0;
+            dp::usize prefix_count = 0;
+            while (frame < frames.size() && iovcnt + 1 + frames[frame].size() <= ROUND_IOVS) {
+                dp::usize total = 0;
+                for (const auto &part : frames[frame]) {
+                    total += part.iov_len;
                 }
-                if (errno == ENOTCONN) {
-                    echo::trace("write failed: socket not connected (fd=", fd, ")");
-                    return dp::result::err(dp::Error::not_found("socket not connected"));
+                prefixes[prefix_count] = encode_u32_be(static_cast<dp::u32>(total));
+                iov[iovcnt++] = {prefixes[prefix_count].data(), 4};
+                prefix_count++;
+                for (const auto &part : frames[frame]) {
+                    iov[iovcnt++] = part;
                 }
+                frame++;
+            }
+            if (iovcnt == 0) {
+                echo::error("frame has too many parts for one writev: ", frames[frame].size());
+                return dp::result::err(dp::Error::invalid_argument("too many parts in frame"));
+            }
+
+            auto res = writev_exact(fd, iov, static_cast<dp::i32>(iovcnt), counters);
+            if (res.is_err()) {
+                return res;
+            }
+        }
+        return dp::result::ok();
+    }
 
-                // Buffer full errors - may be recoverable with retry
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    echo::trace("write would block (fd=", fd, ", wanted=", count, ", wrote=", total_written, ")");
-                    return dp::result::err(dp::Error::io_error("write would block"));
+    // Move count bytes from in_fd to out_fd with splice(2); one of the two must be a pipe
+    // Errors are categorized like reads (EOF on in_fd is not_found); moved_out (optional) gets the bytes moved
+    inline dp::Res<void> splice_direct(dp::i32 in_fd, dp::i32 out_fd, dp::u64 count, dp::u64 *moved_out = nullptr) {
+        dp::u64 moved = 0;
+        auto report = [&]() {
+            if (moved_out) {
+                *moved_out = moved;
+            }
+        };
+        while (moved < count) {
+            dp::u64 left = count - moved;
+            dp::isize n = ::splice(in_fd, nullptr, out_fd, nullptr, static_cast<dp::usize>(left),
+                                   SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
                 }
+                report();
+                return dp::result::err(read_error_from_errno(in_fd, count, moved));
+            }
+            if (n == 0) {
+                echo::trace("splice source closed (fd=", in_fd, ", wanted=", count, ", got=", moved, ")");
+                report();
+                return dp::result::err(dp::Error::not_found("connection closed by peer"));
+            }
+            moved += static_cast<dp::u64>(n);
+        }
+        report();
+        return dp::result::ok();
+    }
+
+    // Pipe size splice_exact() asks for when it needs a pipe of its own
+    constexpr dp::usize SPLICE_PIPE_SIZE = 1024 * 1024;
+
+    // Move count bytes between any two splice-capable fds (sockets, regular files, pipes) inside the kernel
+    // When neither end is a pipe the data goes through a temporary one, SPLICE_PIPE_SIZE bytes at a time
+    // out_fd must not be opened with O_APPEND, which splice(2) refuses
+    // moved_out (optional) gets the bytes that reached out_fd; a timeout on in_fd leaves nothing in between, so
+    // the caller can resume from there. A timeout on out_fd would strand bytes in the pipe and is an I/O error.
+    inline dp::Res<void> splice_exact(dp::i32 in_fd, dp::i32 out_fd, dp::u64 count, dp::u64 *moved_out = nullptr) {
+        struct stat in_st = {}, out_st = {};
+        bool in_pipe = ::fstat(in_fd, &in_st) == 0 && S_ISFIFO(in_st.st_mode);
+        bool out_pipe = ::fstat(out_fd, &out_st) == 0 && S_ISFIFO(out_st.st_mode);
+        if (in_pipe || out_pipe) {
+            return splice_direct(in_fd, out_fd, count, moved_out);
+        }
+
+        dp::i32 pipe_fds[2];
+        if (::pipe2(pipe_fds, O_CLOEXEC) < 0) {
+            echo::error("pipe2 failed: ", strerror(errno));
+            return dp::result::err(dp::Error::io_error("pipe creation failed"));
+        }
+        // Best effort - the default 64KB pipe only costs more splice calls
+        dp::isize pipe_size = ::fcntl(pipe_fds[1], F_SETPIPE_SZ, static_cast<dp::i32>(SPLICE_PIPE_SIZE));
+        dp::u64 step = pipe_size > 0 ? static_cast<dp::u64>(pipe_size) : 64 * 1024;
 
-                // Other I/O errors - log errno for debugging
-                echo::trace("write failed: ", strerror(errno), " (errno=", errno, ", fd=", fd, ")");
-                return dp::result::err(dp::Error::io_error(dp::String("write error: ") + strerror(errno)));
+        // Drain after every splice: socket data can fill the pipe's slots well before its byte size
+        dp::Res<void> res = dp::result::ok();
+        dp::u64 moved = 0;
+        while (moved < count && res.is_ok()) {
+            dp::u64 chunk = count - moved < step ? count - moved : step;
+            dp::isize n = ::splice(in_fd, nullptr, pipe_fds[1], nullptr, static_cast<dp::usize>(chunk),
+                                   SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n < 0 && errno == EINTR) {
+                continue;
             }
+            if (n < 0) {
+                res = dp::result::err(read_error_from_errno(in_fd, count, moved));
+            } else if (n == 0) {
+                echo::trace("splice source closed (fd=", in_fd, ", wanted=", count, ", got=", moved, ")");
+                res = dp::result::err(dp::Error::not_found("connection closed by peer"));
+            } else {
+                dp::u64 drained = 0;
+                res = splice_direct(pipe_fds[0], out_fd, static_cast<dp::u64>(n), &drained);
+                moved += drained;
+                if (res.is_err() && res.error().code == dp::Error::TIMEOUT) {
+                    res = dp::result::err(dp::Error::io_error("splice output timed out"));
+                }
+            }
+        }
+        ::close(pipe_fds[0]);
+        ::close(pipe_fds[1]);
+        if (moved_out) {
+            *moved_out = moved;
+        }
+        return res;
+    }
 
-            total_written += static_cast<dp::usize>(n);
-            echo::trace("wrote ", n, " bytes, total=", total_written, "/", count, " (fd=", fd, ")");
+    // Whether fd has bytes to read right now (or has hit EOF, which a read will report)
+    // POLLERR alone does not count: TCP raises it for the MSG_ZEROCOPY notifications on its error queue
+    inline bool fd_readable(dp::i32 fd) {
+        pollfd pfd{fd, POLLIN, 0};
+        return ::poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+    }
+
+    // Hint to the CPU that the caller is spin-waiting (no-op where there is no such instruction)
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // SO_BUSY_POLL: a blocking read on fd polls the device queue for up to usec before it sleeps
+    // Trades CPU for the wakeup latency of an interrupt; raising it above net.core.busy_read needs CAP_NET_ADMIN
+    inline dp::Res<void> set_busy_poll(dp::i32 fd, dp::u32 usec) {
+        int value = static_cast<int>(usec);
+        if (::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) < 0) {
+            echo::warn("setsockopt SO_BUSY_POLL failed: ", strerror(errno));
+            return dp::result::err(dp::Error::io_error(dp::String("failed to set busy poll: ") + strerror(errno)));
         }
         return dp::result::ok();
     }
 
+    // Map a memfd that arrived in a descriptor frame read-only, after checking the sender sealed it
+    // Without F_SEAL_SHRINK the sender could truncate the file under the mapping and fault the reader
+    // Returns nullptr when the descriptor is unusable; the caller still owns (and closes) memfd
+    inline const dp::u8 *map_descriptor(dp::i32 memfd, dp::u64 length) {
+        dp::i32 seals = ::fcntl(memfd, F_GET_SEALS);
+        if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE)) {
+            echo::error("descriptor frame memfd is not sealed");
+            return nullptr;
+        }
+        struct stat st = {};
+        if (::fstat(memfd, &st) < 0 || static_cast<dp::u64>(st.st_size) < length || length == 0) {
+            echo::error("descriptor frame memfd is shorter than its frame: ", length, " bytes");
+            return nullptr;
+        }
+        void *map = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, memfd, 0);
+        if (map == MAP_FAILED) {
+            echo::error("mmap of descriptor frame failed: ", strerror(errno));
+            return nullptr;
+        }
+        return static_cast<const dp::u8 *>(map);
+    }
+
+    // Buffered reader for 4-byte big-endian length-prefixed frames on a stream fd
+    // One read(2) fills the buffer and several small frames are then parsed from it
+    // Frames larger than the buffer are read straight into their destination Message
+    // Capacity 0 disables buffering (one read_exact for the prefix, one for the payload)
+    // A timeout while a buffered frame is incomplete keeps the partial bytes for the next call
+    //
+    // With descriptors enabled (Unix sockets) reads go through recvmsg and SCM_RIGHTS fds are queued in
+    // arrival order. A frame whose prefix is DESCRIPTOR_FRAME carries an 8-byte big-endian payload length;
+    // the payload itself is the next queued fd, a sealed memfd that is mapped instead of read.
+    //
+    // Frame lengths are reserved against a MemoryBudget (MemoryBudget::global() unless set_budget() says otherwise)
+    // before their buffer is allocated. The reservation stays with the reader until take_lease() hands it to the
+    // caller, or the next frame is read. When the budget is spent the read returns a timeout after
+    // MemoryBudget::wait_ms() and the frame stays buffered (unbuffered readers keep the consumed length prefix and
+    // resume from it). Descriptor frames are the sender's pages and are not counted, and neither are frames the
+    // set_exemption() callback lets through after seeing their first BUDGET_PEEK_SIZE bytes.
+    class FrameReader {
+      public:
+        static constexpr dp::usize DEFAULT_CAPACITY = 64 * 1024;
+        static constexpr dp::u32 DESCRIPTOR_FRAME = 0xFFFFFFFF; // Above any valid length prefix
+        static constexpr dp::usize DESCRIPTOR_FRAME_SIZE = 12;
+
+        explicit FrameReader(dp::usize capacity = DEFAULT_CAPACITY)
+            : capacity_(capacity), start_(0), end_(0), descriptors_(false) {}
+
+        // Receive SCM_RIGHTS descriptors and resolve descriptor frames (only meaningful on AF_UNIX)
+        void set_descriptors(bool enabled) { descriptors_ = enabled; }
+
+        // Count frames against budget instead of the global one; nullptr turns accounting off
+        void set_budget(MemoryBudget *budget) {
+            lease_.release();
+            budget_ = budget;
+        }
+
+        MemoryBudget *budget() const { return budget_; }
+
+        // Frames exempt() accepts are not counted; nullptr counts every frame
+        void set_exemption(BudgetExemption exempt) { exempt_ = exempt; }
+
+        // Reservation for the frame read last; empty when none was made or it was already taken
+        BudgetLease take_lease() { return std::move(lease_); }
+
+        // Count reads (and frames that needed more than one) into counters; nullptr stops counting
+        void set_counters(TransportCounters *counters) { counters_ = counters; }
+
+        dp::usize capacity() const { return capacity_; }
+
+        // Bytes received from the fd but not yet returned as a frame
+        dp::usize buffered() const { return end_ - start_; }
+
+        // Change the buffer size; refused while bytes are buffered since they would be lost
+        dp::Res<void> set_capacity(dp::usize capacity) {
+            if (buffered() > 0 || pending_length_ || fd_frame_left_ > 0) {
+                echo::error("cannot resize frame buffer with ", buffered(), " bytes pending");
+                return dp::result::err(dp::Error::invalid_argument("frame buffer not empty"));
+            }
+            capacity_ = capacity;
+            reset();
+            return dp::result::ok();
+        }
+
+        // Drop buffered bytes and queued descriptors and release the buffer (connection closed)
+        void reset() {
+            lease_.release();
+            pending_length_.reset();
+            fd_frame_left_ = 0;
+            peek_size_ = 0;
+            buffer_ = dp::Vector<dp::u8>();
+            start_ = 0;
+            end_ = 0;
+            for (dp::i32 fd : fds_) {
+                ::close(fd);
+            }
+            fds_.clear();
+        }
+
+        // Read one frame, rejecting lengths above max_length
+        dp::Res<Message> read_frame(dp::i32 fd, dp::u64 max_length) {
+            Message msg;
+            auto res = read_frame_into(fd, max_length, msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        // Read one frame into msg, reusing its capacity (no allocation once it is large enough)
+        // msg contents are unspecified on error
+        dp::Res<void> read_frame_into(dp::i32 fd, dp::u64 max_length, Message &msg) {
+            auto res = read_frame_split(fd, max_length, nullptr, 0, msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok();
+        }
+
+        // Read one frame and write its payload to out_fd instead of a Message (see splice_exact)
+        // Bytes already in the buffer are written out first; the rest never enters userspace
+        // A timeout part way through the payload keeps its place: call again with the same out_fd to finish the
+        // frame (other reads are refused until then). Returns the payload length once the frame is complete.
+        dp::Res<dp::u64> read_frame_to_fd(dp::i32 fd, dp::u64 max_length, dp::i32 out_fd) {
+            if (fd_frame_left_ > 0) {
+                return finish_frame_to_fd(fd, out_fd);
+            }
+            dp::Array<dp::u8, 4> length_bytes;
+            auto res = capacity_ >= 4 ? fill(fd, 4) : read_all(fd, length_bytes.data(), 4);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            if (capacity_ >= 4) {
+                std::memcpy(length_bytes.data(), buffer_.data() + start_, 4);
+                consume(4);
+            }
+
+            dp::u32 length = decode_u32_be(length_bytes.data());
+            if (length > max_length) {
+                echo::error("received message too large: ", length, " bytes (max: ", max_length, ")");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+
+            fd_frame_length_ = length;
+            fd_frame_left_ = length;
+            return finish_frame_to_fd(fd, out_fd);
+        }
+
+        // Read one frame split in two: its first prefix_len bytes into prefix, the remainder into rest
+        // Returns the number of bytes written to prefix - less than prefix_len only for a shorter frame
+        // Lets a protocol header and its payload land in separate buffers with a single copy each
+        dp::Res<dp::usize> read_frame_split(dp::i32 fd, dp::u64 max_length, dp::u8 *prefix, dp::usize prefix_len,
+                                            Message &rest) {
+            return read_frame_impl(fd, max_length, prefix, prefix_len, rest, nullptr, nullptr);
+        }
+
+        // Read one frame into msg, except that a descriptor frame is handed over unmapped
+        // memfd is -1 for an ordinary frame; otherwise the caller owns memfd and length is its payload size
+        dp::Res<void> read_frame_or_descriptor(dp::i32 fd, dp::u64 max_length, Message &msg, dp::i32 &memfd,
+                                               dp::u64 &length) {
+            memfd = -1;
+            length = 0;
+            auto res = read_frame_impl(fd, max_length, nullptr, 0, msg, &memfd, &length);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok();
+        }
+
+      private:
+        dp::Vector<dp::u8> buffer_;
+        dp::usize capacity_;
+        dp::usize start_; // First unconsumed byte
+        dp::usize end_;   // One past the last received byte
+        bool descriptors_;
+        std::deque<dp::i32> fds_; // Received with SCM_RIGHTS, not yet claimed by a descriptor frame
+        MemoryBudget *budget_ = &MemoryBudget::global();
+        BudgetLease lease_; // Reservation for the frame read last
+        TransportCounters *counters_ = nullptr;
+        BudgetExemption exempt_ = nullptr;
+        std::optional<dp::u32> pending_length_; // Unbuffered prefix consumed before the budget admitted its frame
+        dp::Array<dp::u8, BUDGET_PEEK_SIZE> peek_;  // Unbuffered frame bytes read ahead for exempt_
+        dp::usize peek_size_ = 0;
+        dp::usize peek_used_ = 0;
+        dp::u64 fd_frame_length_ = 0; // Frame read_frame_to_fd() is part way through
+        dp::u64 fd_frame_left_ = 0;   // Its payload bytes not yet written out
+
+        // Write the rest of the current read_frame_to_fd() payload: buffered bytes first, then spliced
+        dp::Res<dp::u64> finish_frame_to_fd(dp::i32 fd, dp::i32 out_fd) {
+            dp::usize have = buffered() < fd_frame_left_ ? buffered() : static_cast<dp::usize>(fd_frame_left_);
+            if (have > 0) {
+                auto res = write_exact(out_fd, buffer_.data() + start_, have);
+                if (res.is_err()) {
+                    // How much of it landed is unknown, so the frame cannot be resumed
+                    return dp::result::err(dp::Error::io_error(dp::String("write to fd failed: ") +
+                                                               res.error().message.c_str()));
+                }
+                consume(have);
+                fd_frame_left_ -= have;
+            }
+            if (fd_frame_left_ > 0) {
+                dp::u64 moved = 0;
+                auto res = splice_exact(fd, out_fd, fd_frame_left_, &moved);
+                fd_frame_left_ -= moved;
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+            }
+            echo::trace("recv wrote ", fd_frame_length_, " bytes to fd=", out_fd);
+            return dp::result::ok(fd_frame_length_);
+        }
+
+        // Whether frames have to be peeked at before they are admitted
+        bool peeking() const { return exempt_ && budget_ && budget_->enabled(); }
+
+        // Reserve length bytes for the next frame, giving back the last frame's reservation first
+        // head holds the frame's first bytes when peeking(); exempt frames reserve nothing
+        // Gives up with a timeout after the budget's wait_ms() so the caller can check for shutdown and retry
+        dp::Res<void> admit(dp::u64 length, const dp::u8 *head = nullptr, dp::usize head_size = 0) {
+            lease_.release();
+            if (!budget_ || !budget_->enabled()) {
+                return dp::result::ok();
+            }
+            if (exempt_ && head && exempt_(head, head_size)) {
+                return dp::result::ok();
+            }
+            auto res = budget_->reserve(length, budget_->wait_ms());
+            if (res.is_ok()) {
+                lease_ = BudgetLease(budget_, length);
+                return res;
+            }
+            echo::trace("recv of ", length, " bytes waiting for memory budget");
+            return res;
+        }
+
+        dp::Res<dp::usize> read_frame_impl(dp::i32 fd, dp::u64 max_length, dp::u8 *prefix, dp::usize prefix_len,
+                                           Message &rest, dp::i32 *memfd_out, dp::u64 *length_out) {
+            if (fd_frame_left_ > 0) {
+                echo::error("frame still being written to fd: ", fd_frame_left_, " bytes left");
+                return dp::result::err(dp::Error::invalid_argument("read_frame_to_fd has a frame in progress"));
+            }
+            if (capacity_ < 4 + prefix_len || capacity_ < 4 + BUDGET_PEEK_SIZE ||
+                (descriptors_ && capacity_ < DESCRIPTOR_FRAME_SIZE)) {
+                return read_frame_direct(fd, max_length, prefix, prefix_len, rest, memfd_out, length_out);
+            }
+
+            auto res = fill(fd, 4);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+
+            dp::u32 length = decode_u32_be(buffer_.data() + start_);
+            echo::trace("recv expecting ", length, " bytes (", buffered(), " buffered)");
+
+            if (length == DESCRIPTOR_FRAME && descriptors_) {
+                res = fill(fd, DESCRIPTOR_FRAME_SIZE);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                const dp::u8 *body = buffer_.data() + start_ + 4;
+                dp::u64 payload = (static_cast<dp::u64>(decode_u32_be(body)) << 32) | decode_u32_be(body + 4);
+                consume(DESCRIPTOR_FRAME_SIZE);
+                return take_descriptor(payload, max_length, prefix, prefix_len, rest, memfd_out, length_out);
+            }
+
+            if (length > max_length) {
+                echo::error("received message too large: ", length, " bytes (max: ", max_length, ")");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+            dp::usize peek = peeking() ? (length < BUDGET_PEEK_SIZE ? length : BUDGET_PEEK_SIZE) : 0;
+            if (peek > 0) {
+                res = fill(fd, 4 + peek);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+            }
+            // Nothing consumed yet, so a timeout leaves the frame for the next call
+            res = admit(length, peek > 0 ? buffer_.data() + start_ + 4 : nullptr, peek);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+
+            dp::usize frame_size = 4 + static_cast<dp::usize>(length);
+
+            // Small frame: complete it in the buffer, then copy out once
+            if (frame_size <= capacity_) {
+                res = fill(fd, frame_size);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+
+                const dp::u8 *body = buffer_.data() + start_ + 4;
+                dp::usize head = length < prefix_len ? length : prefix_len;
+                auto alloc_res = allocate(rest, length - head);
+                if (alloc_res.is_err()) {
+                    return dp::result::err(alloc_res.error());
+                }
+                if (head > 0) {
+                    std::memcpy(prefix, body, head);
+                }
+                if (length > head) {
+                    std::memcpy(rest.data(), body + head, length - head);
+                }
+                consume(frame_size);
+                return dp::result::ok(head);
+            }
+
+            // Large frame (longer than prefix_len since capacity_ >= 4 + prefix_len)
+            // Complete the prefix in the buffer, take the rest that is buffered, read the remainder directly
+            res = fill(fd, 4 + prefix_len);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+
+            dp::usize rest_len = length - prefix_len;
+            auto alloc_res = allocate(rest, rest_len);
+            if (alloc_res.is_err()) {
+                return dp::result::err(alloc_res.error());
+            }
+
+            const dp::u8 *body = buffer_.data() + start_ + 4;
+            if (prefix_len > 0) {
+                std::memcpy(prefix, body, prefix_len);
+            }
+            dp::usize have = buffered() - 4 - prefix_len;
+            std::memcpy(rest.data(), body + prefix_len, have);
+            consume(buffered());
+
+            res = read_all(fd, rest.data() + have, rest_len - have);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(prefix_len);
+        }
+
+        // Resolve a descriptor frame: pop its memfd and either hand it out or copy the payload like a frame
+        dp::Res<dp::usize> take_descriptor(dp::u64 length, dp::u64 max_length, dp::u8 *prefix, dp::usize prefix_len,
+                                           Message &rest, dp::i32 *memfd_out, dp::u64 *length_out) {
+            if (fds_.empty()) {
+                echo::error("descriptor frame arrived without a descriptor");
+                return dp::result::err(dp::Error::io_error("descriptor frame without descriptor"));
+            }
+            dp::i32 memfd = fds_.front();
+            fds_.pop_front();
+
+            if (length > max_length) {
+                ::close(memfd);
+                echo::error("received message too large: ", length, " bytes (max: ", max_length, ")");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+            echo::trace("recv descriptor frame of ", length, " bytes, fd=", memfd);
+
+            if (memfd_out) {
+                *memfd_out = memfd;
+                *length_out = length;
+                return dp::result::ok(dp::usize(0));
+            }
+
+            const dp::u8 *map = map_descriptor(memfd, length);
+            ::close(memfd);
+            if (!map) {
+                return dp::result::err(dp::Error::io_error("invalid descriptor frame"));
+            }
+
+            dp::usize head = length < prefix_len ? static_cast<dp::usize>(length) : prefix_len;
+            auto alloc_res = allocate(rest, static_cast<dp::usize>(length) - head);
+            if (alloc_res.is_ok()) {
+                if (head > 0) {
+                    std::memcpy(prefix, map, head);
+                }
+                std::memcpy(rest.data(), map + head, rest.size());
+            }
+            ::munmap(const_cast<dp::u8 *>(map), length);
+            if (alloc_res.is_err()) {
+                return dp::result::err(alloc_res.error());
+            }
+            return dp::result::ok(head);
+        }
+
+        // read(2), or recvmsg collecting SCM_RIGHTS descriptors when they are enabled
+        // The kernel hands out the fds of a message with the first read that touches its bytes
+        dp::isize read_some(dp::i32 fd, dp::u8 *buffer, dp::usize count) {
+            if (!descriptors_) {
+                return ::read(fd, buffer, count);
+            }
+
+            iovec iov{buffer, count};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(dp::i32) * 4)];
+            msghdr hdr = {};
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = control;
+            hdr.msg_controllen = sizeof(control);
+
+            dp::isize n = ::recvmsg(fd, &hdr, MSG_CMSG_CLOEXEC);
+            if (n < 0) {
+                return n;
+            }
+            for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                    continue;
+                }
+                dp::usize count_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(dp::i32);
+                for (dp::usize i = 0; i < count_fds; i++) {
+                    dp::i32 received;
+                    std::memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(dp::i32), sizeof(received));
+                    fds_.push_back(received);
+                }
+            }
+            if (hdr.msg_flags & MSG_CTRUNC) {
+                echo::warn("descriptors dropped: control buffer too small");
+            }
+            return n;
+        }
+
+        // read_exact through read_some, so descriptors are not lost on unbuffered reads
+        dp::Res<void> read_all(dp::i32 fd, dp::u8 *buffer, dp::usize count) {
+            if (!descriptors_) {
+                return read_exact(fd, buffer, count, counters_);
+            }
+            dp::usize total_read = 0;
+            while (total_read < count) {
+                dp::isize n = read_some(fd, buffer + total_read, count - total_read);
+                if (counters_) {
+                    counters_->on_recv_call(n > 0 && total_read + static_cast<dp::usize>(n) < count);
+                }
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return dp::result::err(read_error_from_errno(fd, count, total_read));
+                }
+                if (n == 0) {
+                    echo::trace("connection closed by peer (fd=", fd, ", wanted=", count, ", got=", total_read, ")");
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+                total_read += static_cast<dp::usize>(n);
+            }
+            return dp::result::ok();
+        }
+
+        // Read until at least needed bytes are buffered (needed <= capacity_)
+        // Each read(2) asks for all free space, so one call usually covers many frames
+        dp::Res<void> fill(dp::i32 fd, dp::usize needed) {
+            if (buffer_.size() != capacity_) {
+                buffer_.resize(capacity_);
+            }
+
+            // Slide the pending bytes to the front if the frame would not fit behind them
+            if (capacity_ - start_ < needed) {
+                std::memmove(buffer_.data(), buffer_.data() + start_, buffered());
+                end_ -= start_;
+                start_ = 0;
+            }
+
+            while (buffered() < needed) {
+                dp::isize n = read_some(fd, buffer_.data() + end_, capacity_ - end_);
+                if (counters_) {
+                    counters_->on_recv_call(n > 0 && buffered() + static_cast<dp::usize>(n) < needed);
+                }
+                if (n < 0) {
+                    // EINTR: Interrupted by signal - retry transparently
+                    if (errno == EINTR) {
+                        echo::trace("read interrupted by signal, retrying");
+                        continue;
+                    }
+                    return dp::result::err(read_error_from_errno(fd, needed, buffered()));
+                }
+
+                // n == 0: EOF - connection closed gracefully
+                if (n == 0) {
+                    echo::trace("connection closed by peer (fd=", fd, ", wanted=", needed, ", got=", buffered(), ")");
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+
+                end_ += static_cast<dp::usize>(n);
+                NETPIPE_TRACE(IoRead, static_cast<dp::u32>(fd), 0, static_cast<dp::u64>(n));
+            }
+            return dp::result::ok();
+        }
+
+        void consume(dp::usize count) {
+            start_ += count;
+            if (start_ == end_) {
+                start_ = 0;
+                end_ = 0;
+            }
+        }
+
+        // Allocate message buffer with exception handling
+        static dp::Res<void> allocate(Message &msg, dp::usize length) {
+            try {
+                msg.resize(length);
+            } catch (const std::bad_alloc &e) {
+                echo::error("failed to allocate message buffer: ", length, " bytes - ", e.what());
+                return dp::result::err(dp::Error::io_error("memory allocation failed"));
+            } catch (const std::exception &e) {
+                echo::error("unexpected error allocating message buffer: ", e.what());
+                return dp::result::err(dp::Error::io_error("allocation error"));
+            }
+            return dp::result::ok();
+        }
+
+        // Unbuffered path: read_exact for the length prefix, the split prefix and the remainder
+        dp::Res<dp::usize> read_frame_direct(dp::i32 fd, dp::u64 max_length, dp::u8 *prefix, dp::usize prefix_len,
+                                             Message &rest, dp::i32 *memfd_out, dp::u64 *length_out) {
+            dp::u32 length;
+            dp::Res<void> res = dp::result::ok();
+            if (pending_length_) {
+                length = *pending_length_;
+                pending_length_.reset();
+            } else {
+                dp::Array<dp::u8, 4> length_bytes;
+                res = read_all(fd, length_bytes.data(), 4);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                length = decode_u32_be(length_bytes.data());
+                peek_size_ = 0;
+                peek_used_ = 0;
+            }
+            echo::trace("recv expecting ", length, " bytes");
+
+            if (length == DESCRIPTOR_FRAME && descriptors_) {
+                dp::Array<dp::u8, 8> body;
+                res = read_all(fd, body.data(), 8);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                dp::u64 payload = (static_cast<dp::u64>(decode_u32_be(body.data())) << 32) |
+                                  decode_u32_be(body.data() + 4);
+                return take_descriptor(payload, max_length, prefix, prefix_len, rest, memfd_out, length_out);
+            }
+
+            // Validate message size before allocating
+            if (length > max_length) {
+                echo::error("received message too large: ", length, " bytes (max: ", max_length, ")");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+            dp::usize peek = peeking() ? (length < BUDGET_PEEK_SIZE ? length : BUDGET_PEEK_SIZE) : 0;
+            if (peek > peek_size_) {
+                res = read_all(fd, peek_.data() + peek_size_, peek - peek_size_);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                peek_size_ = peek;
+            }
+            res = admit(length, peek_size_ > 0 ? peek_.data() : nullptr, peek_size_);
+            if (res.is_err()) {
+                pending_length_ = length; // The prefix is gone; the next call resumes with this frame
+                return dp::result::err(res.error());
+            }
+
+            dp::usize head = length < prefix_len ? length : prefix_len;
+            if (head > 0) {
+                res = read_peeked(fd, prefix, head);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+            }
+
+            auto alloc_res = allocate(rest, length - head);
+            if (alloc_res.is_err()) {
+                return dp::result::err(alloc_res.error());
+            }
+            if (length > head) {
+                res = read_peeked(fd, rest.data(), length - head);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+            }
+            return dp::result::ok(head);
+        }
+
+        // read_all that hands out the unbuffered bytes read ahead for the exemption check first
+        dp::Res<void> read_peeked(dp::i32 fd, dp::u8 *buffer, dp::usize count) {
+            dp::usize taken = peek_size_ - peek_used_;
+            taken = taken < count ? taken : count;
+            if (taken > 0) {
+                std::memcpy(buffer, peek_.data() + peek_used_, taken);
+                peek_used_ += taken;
+            }
+            if (count == taken) {
+                return dp::result::ok();
+            }
+            return read_all(fd, buffer + taken, count - taken);
+        }
+    };
+
 } // namespace netpipe
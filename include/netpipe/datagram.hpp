@@ -1,6 +1,7 @@
 #pragma once
 
 #include <netpipe/endpoint.hpp>
+#include <netpipe/stats.hpp>
 
 namespace netpipe {
 
@@ -29,8 +30,44 @@ namespace netpipe {
         // Returns the message and the source endpoint
         virtual dp::Res<dp::Pair<Message, UdpEndpoint>> recv_from() = 0;
 
+        // Receive a message into a caller-owned buffer, reusing its capacity
+        // Returns the source endpoint
+        // Default moves the result of recv_from(); transports override it to fill msg in place
+        virtual dp::Res<UdpEndpoint> recv_from_into(Message &msg) {
+            auto res = recv_from();
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            msg = std::move(res.value().first);
+            return dp::result::ok(res.value().second);
+        }
+
+        // Bound how long recv_from() blocks before failing with a timeout (0 = block forever)
+        // Default reports it unsupported for transports that cannot time out
+        virtual dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) {
+            (void)timeout_ms;
+            return dp::result::err(dp::Error::invalid_argument("recv timeout not supported"));
+        }
+
         // Close and release resources
         virtual void close() = 0;
+
+        // Count this socket's datagrams and list it in StatsRegistry::global() under label (see TransportStats)
+        // Off by default; enable before the socket is used from several threads
+        void enable_stats(const dp::String &label = "") {
+            if (!counters_) {
+                counters_ = StatsRegistry::global().open(label);
+            }
+        }
+
+        bool stats_enabled() const { return counters_ != nullptr; }
+
+        // Current counters (all zero while stats are off)
+        TransportStats stats() const { return counters_ ? counters_->snapshot() : TransportStats{}; }
+
+      protected:
+        // Null while stats are off
+        std::shared_ptr<TransportCounters> counters_;
     };
 
 } // namespace netpipe
@@ -2,7 +2,17 @@
 
 #include <netpipe/datagram.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <arpa/inet.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -10,14 +20,74 @@ namespace netpipe {
 
     // LoRa datagram implementation using melodi firmware over serial
     // Long-range mesh networking with IPv6 addressing
+    // A reader thread owns the serial input: it matches firmware replies to commands in the order they were
+    // written and queues received messages for recv_from(), so an incoming message can never be mistaken for
+    // an ACK. A writer thread keeps up to send_window commands outstanding instead of one round trip per
+    // frame; send_to() and broadcast() return once the frame is queued, and NACKs surface from flush().
+    // Replies carry no sequence number, so a lost one would shift every later reply onto the wrong command:
+    // when the oldest command goes unanswered for the reply timeout, every outstanding command fails as a
+    // NACK and replies are ignored for RESYNC_MS before the writer continues.
     class LoraDatagram : public Datagram {
       private:
+        using Clock = std::chrono::steady_clock;
+
+        // Reply slot of a written command; replies arrive in command order
+        struct Completion {
+            bool done = false;
+            bool ok = false;
+            bool timed_out = false; // No reply within the reply timeout
+        };
+
+        // Written command waiting for its reply
+        struct Outstanding {
+            std::shared_ptr<Completion> completion;
+            Clock::time_point deadline;
+        };
+
+        struct Command {
+            dp::Vector<dp::u8> bytes; // Command byte and payload, as written to the serial port
+            std::shared_ptr<Completion> completion;
+        };
+
+        // Small messages to one destination waiting to share a radio frame
+        struct Batch {
+            dp::Array<dp::u8, 16> dest;
+            Message frame; // AGGREGATE_MAGIC, then [len:1][message] per message
+            dp::usize count;
+            Clock::time_point started;
+        };
+
         dp::i32 fd_;
         bool bound_;
         dp::String serial_port_;
         dp::String local_ipv6_;
         dp::u8 repeat_count_;
 
+        std::thread reader_;
+        std::thread writer_;
+        std::atomic<bool> running_;
+        std::mutex mutex_; // Guards everything below
+        std::condition_variable tx_cv_; // Writer: a command was queued, a reply freed a slot, or a batch aged
+        std::condition_variable done_cv_; // A reply arrived or a queue drained
+        std::condition_variable rx_cv_;
+        std::deque<Command> tx_queue_;
+        std::deque<Outstanding> unacked_; // Written, reply outstanding, oldest first
+        std::deque<Batch> batches_;
+        std::deque<dp::Pair<Message, UdpEndpoint>> rx_queue_;
+        dp::usize send_window_;
+        bool aggregate_;
+        dp::u32 linger_ms_;
+        dp::u32 recv_timeout_ms_;
+        dp::u32 reply_timeout_ms_;
+        Clock::time_point resync_until_; // Replies before this belong to expired commands and are dropped
+        bool drop_input_;                // The reader discards the reply it was part way through
+        dp::u64 failed_; // NACK/ERROR replies to frames not yet reported by flush()
+
+        // Read without mutex_ by the getters
+        std::atomic<dp::u64> nacks_;
+        std::atomic<dp::u64> frames_sent_;
+        std::atomic<dp::u64> messages_sent_;
+
         // Melodi protocol commands
         static constexpr dp::u8 CMD_SEND_MESSAGE = 0x01;
         static constexpr dp::u8 CMD_GET_STATUS = 0x03;
@@ -39,8 +109,17 @@ namespace netpipe {
         // Response header
         static constexpr dp::u8 RESP_HEADER[4] = {0xAA, 0xBB, 0xCC, 0xDD};
 
+        // RESP_MESSAGE body: [is_broadcast:1][src_ipv6:16][len_hi][len_lo][payload]
+        static constexpr dp::usize MESSAGE_PREFIX = 1 + 16 + 2;
+
+      public:
         static constexpr dp::usize MAX_LORA_SIZE = 128; // Fragment limit
+        static constexpr dp::u8 AGGREGATE_MAGIC = 0xA7; // First byte of a frame carrying several messages
+        static constexpr dp::usize DEFAULT_SEND_WINDOW = 4;
+        static constexpr dp::u32 DEFAULT_REPLY_TIMEOUT_MS = 2000;
+        static constexpr dp::u32 RESYNC_MS = 200; // Late replies ignored after a reply timeout
 
+      private:
         // Open and configure serial port
         dp::Res<void> open_serial(const dp::String &port) {
             echo::trace("serial open ", port.c_str());
@@ -74,7 +153,7 @@ namespace netpipe {
 
             // Raw mode
             tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-            tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+            tty.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL | INLCR);
             tty.c_oflag &= ~OPOST;
 
             // Apply settings
@@ -89,87 +168,348 @@ namespace netpipe {
             return dp::result::ok();
         }
 
-        // Send command to melodi
-        dp::Res<void> send_command(dp::u8 cmd, const dp::Vector<dp::u8> &payload) {
-            echo::trace("send cmd=0x", std::hex, static_cast<int>(cmd), " len=", payload.size());
-
-            dp::Vector<dp::u8> buffer;
-            buffer.push_back(cmd);
-            buffer.insert(buffer.end(), payload.begin(), payload.end());
+        // Queue a command for the writer; caller holds mutex_
+        std::shared_ptr<Completion> enqueue_locked(dp::u8 cmd, const dp::u8 *payload, dp::usize length) {
+            echo::trace("queue cmd=0x", std::hex, static_cast<int>(cmd), std::dec, " len=", length);
+            Command command;
+            command.bytes.reserve(1 + length);
+            command.bytes.push_back(cmd);
+            command.bytes.insert(command.bytes.end(), payload, payload + length);
+            command.completion = std::make_shared<Completion>();
+            auto completion = command.completion;
+            tx_queue_.push_back(std::move(command));
+            tx_cv_.notify_one();
+            return completion;
+        }
 
-            auto res = write_exact(fd_, buffer.data(), buffer.size());
-            if (res.is_err()) {
-                echo::error("send command failed");
-                return res;
+        // Send a command and wait for its own reply (configuration commands)
+        dp::Res<void> command(dp::u8 cmd, const dp::Vector<dp::u8> &payload) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!running_) {
+                return dp::result::err(dp::Error::invalid_argument("not bound"));
+            }
+            auto completion = enqueue_locked(cmd, payload.data(), payload.size());
+            // Up to a send window of frames may be written ahead of it, each with its own reply timeout
+            auto timeout = std::chrono::milliseconds(reply_timeout_ms_) * static_cast<dp::i64>(send_window_ + 1);
+            if (!done_cv_.wait_for(lock, timeout, [&] { return completion->done; })) {
+                for (auto it = tx_queue_.begin(); it != tx_queue_.end(); ++it) {
+                    if (it->completion == completion) {
+                        tx_queue_.erase(it); // Not written yet: it must not reach the firmware after we gave up
+                        break;
+                    }
+                }
+                completion->timed_out = true;
+            }
+            if (completion->timed_out) {
+                echo::error("melodi did not answer command 0x", std::hex, static_cast<int>(cmd));
+                return dp::result::err(dp::Error::timeout("melodi reply timeout"));
+            }
+            if (!completion->ok) {
+                echo::error("melodi rejected command 0x", std::hex, static_cast<int>(cmd));
+                return dp::result::err(dp::Error::io_error("melodi NACK"));
             }
-
             return dp::result::ok();
         }
 
-        // Read response from melodi
-        dp::Res<dp::Vector<dp::u8>> read_response() {
-            // Read header (4 bytes)
-            dp::Array<dp::u8, 4> header;
-            auto res = read_exact(fd_, header.data(), 4);
-            if (res.is_err()) {
-                echo::error("read response header failed");
-                return dp::result::err(res.error());
-            }
+        // CMD_SEND_MESSAGE for one radio frame; caller holds mutex_
+        void queue_frame_locked(const dp::Array<dp::u8, 16> &dest, const dp::u8 *data, dp::usize length) {
+            dp::Vector<dp::u8> payload;
+            payload.reserve(3 + 16 + length);
+            payload.push_back(static_cast<dp::u8>(length >> 8));     // len_hi
+            payload.push_back(static_cast<dp::u8>(length & 0xFF));   // len_lo
+            payload.push_back(repeat_count_);                        // repeat count
+            payload.insert(payload.end(), dest.begin(), dest.end()); // dest IPv6 (16 bytes)
+            payload.insert(payload.end(), data, data + length);      // payload
+            (void)enqueue_locked(CMD_SEND_MESSAGE, payload.data(), payload.size());
+            frames_sent_++;
+        }
 
-            // Verify header
-            if (header[0] != RESP_HEADER[0] || header[1] != RESP_HEADER[1] || header[2] != RESP_HEADER[2] ||
-                header[3] != RESP_HEADER[3]) {
-                echo::error("invalid response header");
-                return dp::result::err(dp::Error::io_error("invalid response header"));
+        // A batch of one goes out bare; the envelope is only paid for when it saves a frame
+        void flush_batch_locked(Batch &batch) {
+            if (batch.count == 1 && batch.frame.size() > 2 && batch.frame[2] != AGGREGATE_MAGIC) {
+                queue_frame_locked(batch.dest, batch.frame.data() + 2, batch.frame.size() - 2);
+            } else {
+                queue_frame_locked(batch.dest, batch.frame.data(), batch.frame.size());
             }
+        }
 
-            // Read response type
-            dp::u8 resp_type;
-            res = read_exact(fd_, &resp_type, 1);
-            if (res.is_err()) {
-                echo::error("read response type failed");
-                return dp::result::err(res.error());
+        // Shared body of send_to and broadcast
+        dp::Res<void> send_frame(const Message &msg, const dp::Array<dp::u8, 16> &dest) {
+            if (msg.size() > MAX_LORA_SIZE) {
+                echo::warn("message too large for LoRa: ", msg.size());
+                return dp::result::err(dp::Error::invalid_argument(dp::String("message too large: ") +
+                                                                   std::to_string(msg.size()).c_str()));
             }
 
-            echo::trace("recv response type=0x", std::hex, static_cast<int>(resp_type));
-
-            // Handle different response types
-            if (resp_type == RESP_NACK) {
-                echo::error("melodi NACK received");
-                return dp::result::err(dp::Error::io_error("melodi NACK"));
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!running_) {
+                echo::error("send called but not bound");
+                return dp::result::err(dp::Error::invalid_argument("not bound"));
             }
+            // Backpressure: at most one window of frames waits behind the ones on the wire
+            done_cv_.wait(lock, [&] { return !running_ || tx_queue_.size() < send_window_; });
+            if (!running_) {
+                return dp::result::err(dp::Error::io_error("closed"));
+            }
+            messages_sent_++;
+
+            if (!aggregate_ || msg.size() + 2 > MAX_LORA_SIZE) {
+                if (aggregate_ && !msg.empty() && msg[0] == AGGREGATE_MAGIC) {
+                    return dp::result::err(dp::Error::invalid_argument("message too large to aggregate"));
+                }
+                queue_frame_locked(dest, msg.data(), msg.size());
+                return dp::result::ok();
+            }
+
+            for (auto it = batches_.begin(); it != batches_.end(); ++it) {
+                if (it->dest != dest) {
+                    continue;
+                }
+                if (it->frame.size() + 1 + msg.size() <= MAX_LORA_SIZE) {
+                    it->frame.push_back(static_cast<dp::u8>(msg.size()));
+                    it->frame.insert(it->frame.end(), msg.begin(), msg.end());
+                    it->count++;
+                    return dp::result::ok();
+                }
+                flush_batch_locked(*it); // Full: send it and start a new one below
+                batches_.erase(it);
+                break;
+            }
+            Batch batch{dest, Message(), 1, Clock::now()};
+            batch.frame.reserve(MAX_LORA_SIZE);
+            batch.frame.push_back(AGGREGATE_MAGIC);
+            batch.frame.push_back(static_cast<dp::u8>(msg.size()));
+            batch.frame.insert(batch.frame.end(), msg.begin(), msg.end());
+            batches_.push_back(std::move(batch));
+            tx_cv_.notify_one(); // Arms the linger deadline
+            return dp::result::ok();
+        }
 
-            if (resp_type == RESP_ERROR) {
-                echo::error("melodi ERROR received");
-                return dp::result::err(dp::Error::io_error("melodi ERROR"));
+        void writer_loop() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_) {
+                auto now = Clock::now();
+                auto linger = std::chrono::milliseconds(linger_ms_);
+                while (!batches_.empty() && now - batches_.front().started >= linger) {
+                    flush_batch_locked(batches_.front());
+                    batches_.pop_front();
+                }
+
+                if (!unacked_.empty() && now >= unacked_.front().deadline) {
+                    expire_locked(now);
+                    continue;
+                }
+
+                if (!tx_queue_.empty() && unacked_.size() < send_window_ && now >= resync_until_) {
+                    Command command = std::move(tx_queue_.front());
+                    tx_queue_.pop_front();
+                    // Before the write: the reply may beat us back
+                    unacked_.push_back({command.completion, now + std::chrono::milliseconds(reply_timeout_ms_)});
+                    done_cv_.notify_all();
+                    lock.unlock();
+                    auto res = write_exact(fd_, command.bytes.data(), command.bytes.size());
+                    lock.lock();
+                    if (res.is_err()) {
+                        echo::error("serial write failed");
+                        for (auto it = unacked_.begin(); it != unacked_.end(); ++it) {
+                            if (it->completion == command.completion) {
+                                unacked_.erase(it);
+                                break;
+                            }
+                        }
+                        command.completion->done = true;
+                        failed_++;
+                        done_cv_.notify_all();
+                    }
+                    continue;
+                }
+
+                // Sleep until the next batch ages, the oldest reply is overdue or a resync ends
+                auto wake = Clock::time_point::max();
+                if (!batches_.empty()) {
+                    wake = batches_.front().started + linger;
+                }
+                if (!unacked_.empty() && unacked_.front().deadline < wake) {
+                    wake = unacked_.front().deadline;
+                }
+                if (!tx_queue_.empty() && now < resync_until_ && resync_until_ < wake) {
+                    wake = resync_until_;
+                }
+                if (wake == Clock::time_point::max()) {
+                    tx_cv_.wait(lock);
+                } else {
+                    tx_cv_.wait_until(lock, wake);
+                }
             }
+        }
 
-            // For ACK, return empty
-            if (resp_type == RESP_ACK) {
-                return dp::result::ok(dp::Vector<dp::u8>());
-            }
+        // The oldest command went unanswered: fail the whole window, since which reply belongs to which
+        // command is no longer known, and drop replies that still trickle in for RESYNC_MS. Caller holds mutex_
+        void expire_locked(Clock::time_point now) {
+            echo::warn("melodi reply timeout, failing ", unacked_.size(), " outstanding commands");
+            for (auto &entry : unacked_) {
+                entry.completion->done = true;
+                entry.completion->timed_out = true;
+                nacks_++;
+                failed_++;
+            }
+            unacked_.clear();
+            resync_until_ = now + std::chrono::milliseconds(RESYNC_MS);
+            drop_input_ = true;
+            done_cv_.notify_all();
+        }
+
+        // Caller holds mutex_
+        void complete_locked(bool ok) {
+            if (Clock::now() < resync_until_) {
+                echo::debug("dropping late melodi reply");
+                return;
+            }
+            if (unacked_.empty()) {
+                echo::warn("melodi reply without an outstanding command");
+                return;
+            }
+            auto completion = unacked_.front().completion;
+            unacked_.pop_front();
+            completion->done = true;
+            completion->ok = ok;
+            if (!ok) {
+                nacks_++;
+                failed_++;
+            }
+            tx_cv_.notify_one();
+            done_cv_.notify_all();
+        }
+
+        // Caller holds mutex_; payload is one radio frame
+        void deliver_locked(const dp::u8 *src_ipv6, bool is_broadcast, const dp::u8 *payload, dp::usize length) {
+            char text[INET6_ADDRSTRLEN] = {};
+            ::inet_ntop(AF_INET6, src_ipv6, text, sizeof(text));
+            UdpEndpoint src{dp::String(text), 0};
+            echo::debug("received ", length, " bytes from ", text, is_broadcast ? " (broadcast)" : "");
+
+            if (!aggregate_ || length == 0 || payload[0] != AGGREGATE_MAGIC) {
+                rx_queue_.emplace_back(Message(payload, payload + length), src);
+                rx_cv_.notify_one();
+                return;
+            }
+            dp::usize pos = 1;
+            while (pos < length) {
+                dp::usize size = payload[pos];
+                if (pos + 1 + size > length) {
+                    echo::warn("truncated aggregated LoRa frame");
+                    break;
+                }
+                rx_queue_.emplace_back(Message(payload + pos + 1, payload + pos + 1 + size), src);
+                pos += 1 + size;
+            }
+            rx_cv_.notify_all();
+        }
+
+        // Append what was read to buffer and consume every complete response in it; bytes before a header are
+        // line noise and skipped
+        void parse_responses(dp::Vector<dp::u8> &buffer, const dp::u8 *data, dp::usize length) {
+            dp::usize pos = 0;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (drop_input_) {
+                // A reply split across reads may belong to an expired command; resync on the next header
+                buffer.clear();
+                drop_input_ = false;
+            }
+            buffer.insert(buffer.end(), data, data + length);
+            while (true) {
+                while (pos + 4 <= buffer.size() &&
+                       !(buffer[pos] == RESP_HEADER[0] && buffer[pos + 1] == RESP_HEADER[1] &&
+                         buffer[pos + 2] == RESP_HEADER[2] && buffer[pos + 3] == RESP_HEADER[3])) {
+                    pos++;
+                }
+                if (pos + 5 > buffer.size()) {
+                    break;
+                }
+                dp::u8 type = buffer[pos + 4];
+                echo::trace("recv response type=0x", std::hex, static_cast<int>(type));
+                if (type == RESP_ACK || type == RESP_STATUS) {
+                    complete_locked(true);
+                    pos += 5;
+                } else if (type == RESP_NACK || type == RESP_ERROR) {
+                    echo::warn("melodi ", type == RESP_NACK ? "NACK" : "ERROR", " received");
+                    complete_locked(false);
+                    pos += 5;
+                } else if (type == RESP_MESSAGE) {
+                    if (pos + 5 + MESSAGE_PREFIX > buffer.size()) {
+                        break;
+                    }
+                    const dp::u8 *body = buffer.data() + pos + 5;
+                    dp::usize length = (static_cast<dp::usize>(body[17]) << 8) | body[18];
+                    if (length > MAX_LORA_SIZE) {
+                        echo::warn("oversized LoRa message length ", length, ", resyncing");
+                        pos += 4;
+                        continue;
+                    }
+                    if (pos + 5 + MESSAGE_PREFIX + length > buffer.size()) {
+                        break;
+                    }
+                    deliver_locked(body + 1, body[0] != 0, body + MESSAGE_PREFIX, length);
+                    pos += 5 + MESSAGE_PREFIX + length;
+                } else {
+                    echo::warn("unknown melodi response 0x", std::hex, static_cast<int>(type), ", resyncing");
+                    pos += 4;
+                }
+            }
+            buffer.erase(buffer.begin(), buffer.begin() + static_cast<dp::isize>(pos));
+        }
 
-            // For MESSAGE or STATUS, read the rest
-            // This is simplified - full implementation would parse the specific format
-            dp::Vector<dp::u8> data;
-            data.push_back(resp_type);
-            return dp::result::ok(std::move(data));
+        void reader_loop() {
+            dp::Vector<dp::u8> buffer;
+            dp::u8 chunk[256];
+            while (running_) {
+                struct pollfd pfd = {fd_, POLLIN, 0};
+                if (::poll(&pfd, 1, 100) <= 0) {
+                    continue; // Bounded wait so close() is noticed
+                }
+                dp::isize n = ::read(fd_, chunk, sizeof(chunk));
+                if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                    continue;
+                }
+                if (n <= 0) {
+                    echo::error("serial read failed: ", n == 0 ? "closed" : strerror(errno));
+                    break;
+                }
+                parse_responses(buffer, chunk, static_cast<dp::usize>(n));
+            }
+
+            // No more replies can arrive: fail whatever is still waiting for one
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            while (!unacked_.empty()) {
+                unacked_.front().completion->done = true;
+                unacked_.pop_front();
+            }
+            for (auto &command : tx_queue_) {
+                command.completion->done = true;
+            }
+            tx_queue_.clear();
+            tx_cv_.notify_all();
+            done_cv_.notify_all();
+            rx_cv_.notify_all();
         }
 
         // Parse IPv6 string to 16 bytes
         dp::Res<dp::Array<dp::u8, 16>> parse_ipv6(const dp::String &ipv6_str) {
             dp::Array<dp::u8, 16> bytes = {};
-
-            // Simplified IPv6 parsing - in production use inet_pton
-            // For now, just fill with zeros and mark as placeholder
-            echo::warn("IPv6 parsing not fully implemented, using placeholder");
-
+            if (::inet_pton(AF_INET6, ipv6_str.c_str(), bytes.data()) != 1) {
+                echo::error("invalid IPv6 address: ", ipv6_str.c_str());
+                return dp::result::err(dp::Error::invalid_argument("invalid IPv6 address"));
+            }
             return dp::result::ok(bytes);
         }
 
       public:
         explicit LoraDatagram(const dp::String &serial_port)
-            : fd_(-1), bound_(false), serial_port_(serial_port), repeat_count_(1) {
+            : fd_(-1), bound_(false), serial_port_(serial_port), repeat_count_(1), running_(false),
+              send_window_(DEFAULT_SEND_WINDOW), aggregate_(false), linger_ms_(20), recv_timeout_ms_(0),
+              reply_timeout_ms_(DEFAULT_REPLY_TIMEOUT_MS), drop_input_(false), failed_(0), nacks_(0), frames_sent_(0),
+              messages_sent_(0) {
             echo::trace("LoraDatagram constructed for ", serial_port.c_str());
         }
 
@@ -190,37 +530,34 @@ namespace netpipe {
         dp::Res<void> bind_lora(const LoraEndpoint &endpoint) {
             echo::trace("binding to ", endpoint.to_string());
 
+            auto ipv6_bytes_res = parse_ipv6(endpoint.ipv6);
+            if (ipv6_bytes_res.is_err()) {
+                return dp::result::err(ipv6_bytes_res.error());
+            }
+
             // Open serial port
             auto res = open_serial(serial_port_);
             if (res.is_err()) {
                 return res;
             }
+            running_ = true;
+            reader_ = std::thread([this]() { reader_loop(); });
+            writer_ = std::thread([this]() { writer_loop(); });
 
             // Set local IPv6 address
             local_ipv6_ = endpoint.ipv6;
 
-            // Send SET_CONFIG command for IPv6
-            auto ipv6_bytes_res = parse_ipv6(endpoint.ipv6);
-            if (ipv6_bytes_res.is_err()) {
-                return dp::result::err(ipv6_bytes_res.error());
-            }
-
             dp::Vector<dp::u8> config_payload;
             config_payload.push_back(CONFIG_IPV6_ADDRESS);
             auto ipv6_bytes = ipv6_bytes_res.value();
             config_payload.insert(config_payload.end(), ipv6_bytes.begin(), ipv6_bytes.end());
 
-            res = send_command(CMD_SET_CONFIG, config_payload);
+            res = command(CMD_SET_CONFIG, config_payload);
             if (res.is_err()) {
+                close();
                 return res;
             }
 
-            // Wait for ACK
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
-            }
-
             bound_ = true;
             echo::debug("LoraDatagram bound to ", endpoint.ipv6.c_str());
             echo::info("LoraDatagram connected to ", serial_port_.c_str());
@@ -228,20 +565,8 @@ namespace netpipe {
             return dp::result::ok();
         }
 
-        // Send message to specific IPv6 address
+        // Queue a message to a specific IPv6 address; returns without waiting for the firmware's ACK
         dp::Res<void> send_to(const Message &msg, const UdpEndpoint &dest) override {
-            if (!bound_) {
-                echo::error("send_to called but not bound");
-                return dp::result::err(dp::Error::invalid_argument("not bound"));
-            }
-
-            // Check message size
-            if (msg.size() > MAX_LORA_SIZE) {
-                echo::warn("message too large for LoRa: ", msg.size());
-                return dp::result::err(dp::Error::invalid_argument(dp::String("message too large: ") +
-                                                                   std::to_string(msg.size()).c_str()));
-            }
-
             echo::trace("sendto ", dest.host.c_str(), " len=", msg.size());
 
             // Parse destination IPv6
@@ -249,118 +574,132 @@ namespace netpipe {
             if (ipv6_bytes_res.is_err()) {
                 return dp::result::err(ipv6_bytes_res.error());
             }
-            auto dest_ipv6 = ipv6_bytes_res.value();
-
-            // Build CMD_SEND_MESSAGE payload
-            dp::Vector<dp::u8> payload;
-            dp::u16 len = static_cast<dp::u16>(msg.size());
-            payload.push_back(static_cast<dp::u8>(len >> 8));                  // len_hi
-            payload.push_back(static_cast<dp::u8>(len & 0xFF));                // len_lo
-            payload.push_back(repeat_count_);                                  // repeat count
-            payload.insert(payload.end(), dest_ipv6.begin(), dest_ipv6.end()); // dest IPv6 (16 bytes)
-            payload.insert(payload.end(), msg.begin(), msg.end());             // payload
-
-            auto res = send_command(CMD_SEND_MESSAGE, payload);
-            if (res.is_err()) {
-                return res;
-            }
-
-            // Wait for ACK
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
-            }
-
-            echo::debug("sent ", msg.size(), " bytes to ", dest.host.c_str());
-            return dp::result::ok();
+            return send_frame(msg, ipv6_bytes_res.value());
         }
 
         // Broadcast message to all mesh nodes
         dp::Res<void> broadcast(const Message &msg) override {
-            if (!bound_) {
-                echo::error("broadcast called but not bound");
-                return dp::result::err(dp::Error::invalid_argument("not bound"));
-            }
-
-            // Check message size
-            if (msg.size() > MAX_LORA_SIZE) {
-                echo::warn("message too large for LoRa: ", msg.size());
-                return dp::result::err(dp::Error::invalid_argument(dp::String("message too large: ") +
-                                                                   std::to_string(msg.size()).c_str()));
-            }
-
             echo::trace("broadcasting len=", msg.size());
 
             // Use all-zeros IPv6 for broadcast (or specific broadcast address)
             dp::Array<dp::u8, 16> broadcast_ipv6 = {};
-
-            // Build CMD_SEND_MESSAGE payload
-            dp::Vector<dp::u8> payload;
-            dp::u16 len = static_cast<dp::u16>(msg.size());
-            payload.push_back(static_cast<dp::u8>(len >> 8));                            // len_hi
-            payload.push_back(static_cast<dp::u8>(len & 0xFF));                          // len_lo
-            payload.push_back(repeat_count_);                                            // repeat count
-            payload.insert(payload.end(), broadcast_ipv6.begin(), broadcast_ipv6.end()); // broadcast IPv6
-            payload.insert(payload.end(), msg.begin(), msg.end());                       // payload
-
-            auto res = send_command(CMD_SEND_MESSAGE, payload);
-            if (res.is_err()) {
-                return res;
-            }
-
-            // Wait for ACK
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
-            }
-
-            echo::debug("broadcast ", msg.size(), " bytes");
-            return dp::result::ok();
+            return send_frame(msg, broadcast_ipv6);
         }
 
         // Receive message from mesh
+        // The source port is always 0 - LoRa has no ports
         dp::Res<dp::Pair<Message, UdpEndpoint>> recv_from() override {
+            echo::trace("recv_from waiting for message");
+
+            std::unique_lock<std::mutex> lock(mutex_);
             if (!bound_) {
                 echo::error("recv_from called but not bound");
                 return dp::result::err(dp::Error::invalid_argument("not bound"));
             }
-
-            echo::trace("recv_from waiting for message");
-
-            // Read response (should be RESP_MESSAGE)
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
+            auto ready = [&] { return !rx_queue_.empty() || !running_; };
+            if (recv_timeout_ms_ == 0) {
+                rx_cv_.wait(lock, ready);
+            } else if (!rx_cv_.wait_for(lock, std::chrono::milliseconds(recv_timeout_ms_), ready)) {
+                return dp::result::err(dp::Error::timeout("recv timeout"));
             }
-
-            auto resp_data = resp_res.value();
-            if (resp_data.empty() || resp_data[0] != RESP_MESSAGE) {
-                echo::error("expected RESP_MESSAGE");
-                return dp::result::err(dp::Error::io_error("unexpected response type"));
+            if (rx_queue_.empty()) {
+                return dp::result::err(dp::Error::io_error("serial port closed"));
             }
+            auto message = std::move(rx_queue_.front());
+            rx_queue_.pop_front();
+            return dp::result::ok(std::move(message));
+        }
 
-            // Parse RESP_MESSAGE format: [is_broadcast][src_ipv6:16][len_hi][len_lo][payload]
-            // This is simplified - full implementation would parse properly
-            echo::warn("recv_from not fully implemented - returning placeholder");
+        // Bound how long recv_from() waits (0 = forever)
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            recv_timeout_ms_ = timeout_ms;
+            return dp::result::ok();
+        }
+
+        // Commands written ahead of their replies; 1 restores the old one-frame-at-a-time behaviour
+        // Keep it within what the firmware can buffer - melodi queues a handful of frames
+        void set_send_window(dp::usize commands) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            send_window_ = commands == 0 ? 1 : commands;
+            tx_cv_.notify_one();
+        }
 
-            Message msg;
-            UdpEndpoint src{"::1", 0}; // Placeholder
+        // How long the firmware gets to answer a written command before it fails (see the class comment)
+        void set_reply_timeout(dp::u32 timeout_ms) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reply_timeout_ms_ = timeout_ms == 0 ? 1 : timeout_ms;
+        }
+
+        // Pack messages to the same destination into one radio frame of up to MAX_LORA_SIZE bytes
+        // A batch goes out when the next message does not fit, after linger_ms, or on flush()
+        // Both ends must enable it: a receiver with aggregation unpacks frames that start with AGGREGATE_MAGIC
+        void set_aggregation(bool enable, dp::u32 linger_ms = 20) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            aggregate_ = enable;
+            linger_ms_ = linger_ms;
+            tx_cv_.notify_one();
+        }
 
-            echo::debug("received message from LoRa mesh");
-            return dp::result::ok(dp::Pair<Message, UdpEndpoint>(std::move(msg), src));
+        // Send pending batches now and wait until the firmware has replied to every frame
+        // Returns an io_error if any frame was NACKed since the last flush
+        dp::Res<void> flush(dp::u32 timeout_ms = 5000) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!batches_.empty()) {
+                flush_batch_locked(batches_.front());
+                batches_.pop_front();
+            }
+            bool drained = done_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+                return !running_ || (tx_queue_.empty() && unacked_.empty());
+            });
+            if (!drained) {
+                return dp::result::err(dp::Error::timeout("flush timeout"));
+            }
+            dp::u64 failed = failed_;
+            failed_ = 0;
+            if (failed > 0) {
+                echo::warn(failed, " LoRa frames were rejected");
+                return dp::result::err(dp::Error::io_error("melodi NACK"));
+            }
+            if (!running_) {
+                return dp::result::err(dp::Error::io_error("serial port closed"));
+            }
+            return dp::result::ok();
         }
 
         // Close serial port
+        // Frames still queued are dropped; call flush() first to deliver them
         void close() override {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+                tx_cv_.notify_all();
+                done_cv_.notify_all();
+                rx_cv_.notify_all();
+            }
+            if (writer_.joinable()) {
+                writer_.join();
+            }
+            if (reader_.joinable()) {
+                reader_.join();
+            }
             if (fd_ >= 0) {
                 echo::trace("closing serial fd=", fd_);
                 ::close(fd_);
                 fd_ = -1;
                 bound_ = false;
+                batches_.clear();
                 echo::debug("LoraDatagram closed");
             }
         }
 
+        // Radio frames queued so far, and the messages they carried (more than frames with aggregation)
+        dp::u64 frames_sent() const { return frames_sent_; }
+        dp::u64 messages_sent() const { return messages_sent_; }
+
+        // Commands the firmware answered with NACK or ERROR, or left unanswered past the reply timeout
+        dp::u64 nack_count() const { return nacks_; }
+
         // LoRa-specific configuration methods
 
         dp::Res<void> set_tx_power(dp::u8 power_dbm) {
@@ -373,16 +712,11 @@ namespace netpipe {
             payload.push_back(CONFIG_TX_POWER);
             payload.push_back(power_dbm);
 
-            auto res = send_command(CMD_SET_CONFIG, payload);
+            auto res = command(CMD_SET_CONFIG, payload);
             if (res.is_err()) {
                 return res;
             }
 
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
-            }
-
             echo::debug("tx_power set to ", static_cast<int>(power_dbm), " dBm");
             return dp::result::ok();
         }
@@ -395,16 +729,11 @@ namespace netpipe {
             payload.push_back(static_cast<dp::u8>((freq_hz >> 8) & 0xFF));
             payload.push_back(static_cast<dp::u8>(freq_hz & 0xFF));
 
-            auto res = send_command(CMD_SET_CONFIG, payload);
+            auto res = command(CMD_SET_CONFIG, payload);
             if (res.is_err()) {
                 return res;
             }
 
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
-            }
-
             echo::debug("frequency set to ", freq_hz, " Hz");
             return dp::result::ok();
         }
@@ -419,16 +748,11 @@ namespace netpipe {
             payload.push_back(CONFIG_HOP_LIMIT);
             payload.push_back(hops);
 
-            auto res = send_command(CMD_SET_CONFIG, payload);
+            auto res = command(CMD_SET_CONFIG, payload);
             if (res.is_err()) {
                 return res;
             }
 
-            auto resp_res = read_response();
-            if (resp_res.is_err()) {
-                return dp::result::err(resp_res.error());
-            }
-
             echo::debug("hop_limit set to ", static_cast<int>(hops));
             return dp::result::ok();
         }
@@ -437,6 +761,7 @@ namespace netpipe {
             if (count < 1) {
                 count = 1;
             }
+            std::lock_guard<std::mutex> lock(mutex_);
             repeat_count_ = count;
             echo::debug("repeat_count set to ", static_cast<int>(count));
             return dp::result::ok();
@@ -1,28 +1,215 @@
 #pragma once
 
 #include <netpipe/datagram.hpp>
+#include <netpipe/resolver.hpp>
+
+#include <span>
 
 #include <arpa/inet.h>
+#include <net/if.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+// Segmentation offload and multicast socket options (linux/udp.h, linux/in6.h) - older libc headers lack them
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#ifndef IPV6_MULTICAST_ALL
+#define IPV6_MULTICAST_ALL 29
+#endif
+
 namespace netpipe {
 
+    // Resolved IPv4 address of a UDP peer
+    // Obtained once via UdpDatagram::resolve() and reused for every send - no getaddrinfo per packet
+    // Also carries batch receive sources in raw form; to_endpoint() formats the string only when asked
+    struct UdpAddress {
+        struct sockaddr_in addr = {};
+
+        inline UdpEndpoint to_endpoint() const {
+            char ip[INET_ADDRSTRLEN];
+            ::inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+            return UdpEndpoint{dp::String(ip), ntohs(addr.sin_port)};
+        }
+    };
+
     // UDP datagram implementation using BSD sockets
     // Unreliable, unordered, connectionless transport
     // Message boundaries preserved - no framing needed
     class UdpDatagram : public Datagram {
       private:
         dp::i32 fd_;
+        dp::i32 family_; // AF_INET, or AF_INET6 for a socket made by bind_group/send_to_group with an IPv6 group
         bool bound_;
         UdpEndpoint local_endpoint_;
+        bool gso_available_; // Cleared once the kernel rejects UDP_SEGMENT; send_segmented then uses sendmmsg
+        bool reuse_port_;    // bind() sets SO_REUSEPORT
+
+        // Multicast send options last applied to the socket, so send_to_group only calls setsockopt on a change
+        bool multicast_configured_;
+        dp::u8 multicast_ttl_;
+        bool multicast_loopback_;
+        dp::String multicast_interface_;
+
+        // Create the socket on first send if bind() has not already done so
+        // family AF_UNSPEC takes the socket as it is, or makes an IPv4 one
+        dp::Res<void> ensure_socket(dp::i32 family = AF_UNSPEC) {
+            if (fd_ >= 0) {
+                if (family != AF_UNSPEC && family != family_) {
+                    echo::error("udp socket is ", family_ == AF_INET6 ? "IPv6" : "IPv4", ", address is not");
+                    return dp::result::err(dp::Error::invalid_argument("address family mismatch"));
+                }
+                return dp::result::ok();
+            }
+            family = family == AF_UNSPEC ? AF_INET : family;
+            fd_ = ::socket(family, SOCK_DGRAM, 0);
+            if (fd_ < 0) {
+                echo::error("socket creation failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            family_ = family;
+            echo::trace("udp socket created fd=", fd_);
+            return dp::result::ok();
+        }
+
+        // Group address of a MulticastEndpoint; invalid_argument unless it is a numeric multicast address
+        static dp::Res<ResolvedAddress> parse_group(const MulticastEndpoint &group) {
+            auto address = Resolver::parse_numeric(group.group, group.port);
+            if (address.is_err()) {
+                echo::error("multicast group must be a numeric address: ", group.group.c_str());
+                return dp::result::err(address.error());
+            }
+            const auto &addr = address.value().addr;
+            bool multicast = addr.ss_family == AF_INET6
+                                 ? IN6_IS_ADDR_MULTICAST(&reinterpret_cast<const sockaddr_in6 *>(&addr)->sin6_addr)
+                                 : IN_MULTICAST(ntohl(reinterpret_cast<const sockaddr_in *>(&addr)->sin_addr.s_addr));
+            if (!multicast) {
+                echo::error("not a multicast address: ", group.group.c_str());
+                return dp::result::err(dp::Error::invalid_argument("not a multicast address"));
+            }
+            return address;
+        }
+
+        // IPv4 interfaces may be named by a local address; otherwise the name must exist (0 = let routing pick)
+        static dp::Res<dp::u32> interface_index(const dp::String &name, struct in_addr *local = nullptr) {
+            if (name.empty()) {
+                return dp::result::ok(dp::u32(0));
+            }
+            if (local != nullptr && ::inet_pton(AF_INET, name.c_str(), local) == 1) {
+                return dp::result::ok(dp::u32(0));
+            }
+            dp::u32 index = ::if_nametoindex(name.c_str());
+            if (index == 0) {
+                echo::error("unknown interface: ", name.c_str());
+                return dp::result::err(dp::Error::not_found("unknown interface"));
+            }
+            return dp::result::ok(index);
+        }
+
+        // IP_ADD_MEMBERSHIP / IPV6_JOIN_GROUP and their leave counterparts
+        dp::Res<void> membership(const MulticastEndpoint &group, bool join) {
+            auto address = parse_group(group);
+            if (address.is_err()) {
+                return dp::result::err(address.error());
+            }
+            auto sock_res = ensure_socket(address.value().family());
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+
+            dp::i32 ret;
+            if (family_ == AF_INET6) {
+                auto index = interface_index(group.interface_name);
+                if (index.is_err()) {
+                    return dp::result::err(index.error());
+                }
+                struct ipv6_mreq mreq = {};
+                mreq.ipv6mr_multiaddr = reinterpret_cast<const sockaddr_in6 *>(&address.value().addr)->sin6_addr;
+                mreq.ipv6mr_interface = index.value();
+                ret = ::setsockopt(fd_, IPPROTO_IPV6, join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP, &mreq, sizeof(mreq));
+            } else {
+                struct ip_mreqn mreq = {};
+                auto index = interface_index(group.interface_name, &mreq.imr_address);
+                if (index.is_err()) {
+                    return dp::result::err(index.error());
+                }
+                mreq.imr_multiaddr = reinterpret_cast<const sockaddr_in *>(&address.value().addr)->sin_addr;
+                mreq.imr_ifindex = static_cast<dp::i32>(index.value());
+                ret = ::setsockopt(fd_, IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+            }
+            if (ret < 0) {
+                echo::error(join ? "joining " : "leaving ", group.to_string(), " failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            echo::debug(join ? "joined multicast group " : "left multicast group ", group.to_string());
+            return dp::result::ok();
+        }
+
+        // One sendmmsg pass over up to MAX_BATCH iovecs, each its own datagram to dest
+        // Retries short sends; returns how many went out (error only if none did)
+        dp::Res<dp::usize> send_mmsg(struct iovec *iov, dp::usize count, const UdpAddress &dest) {
+            struct mmsghdr headers[MAX_BATCH];
+            for (dp::usize i = 0; i < count; ++i) {
+                headers[i] = {};
+                headers[i].msg_hdr.msg_name = const_cast<struct sockaddr_in *>(&dest.addr);
+                headers[i].msg_hdr.msg_namelen = sizeof(dest.addr);
+                headers[i].msg_hdr.msg_iov = &iov[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+            }
 
-        static constexpr dp::usize MAX_UDP_SIZE = 1400; // Safe size to avoid fragmentation
+            dp::usize sent = 0;
+            while (sent < count) {
+                dp::i32 n = ::sendmmsg(fd_, headers + sent, static_cast<unsigned int>(count - sent), 0);
+                if (counters_) {
+                    counters_->on_send_call();
+                }
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    echo::error("sendmmsg failed: ", strerror(errno));
+                    if (sent == 0) {
+                        return dp::result::err(dp::Error::io_error("io error"));
+                    }
+                    break;
+                }
+                sent += static_cast<dp::usize>(n);
+            }
+            if (counters_) {
+                dp::u64 bytes = 0;
+                for (dp::usize i = 0; i < sent; ++i) {
+                    bytes += iov[i].iov_len;
+                }
+                counters_->on_send_batch(sent, bytes);
+            }
+            return dp::result::ok(sent);
+        }
 
       public:
-        UdpDatagram() : fd_(-1), bound_(false) { echo::trace("UdpDatagram constructed"); }
+        static constexpr dp::usize MAX_UDP_SIZE = 1400; // Largest send_to(); safe size to avoid fragmentation
+
+        // Datagrams handed to one sendmmsg/recvmmsg call - larger batches are split
+        static constexpr dp::usize MAX_BATCH = 64;
+
+        // Limits for one segmented send / coalesced receive (IPv4 payload limit, kernel UDP_MAX_SEGMENTS)
+        static constexpr dp::usize MAX_SEGMENTED_SIZE = 65507;
+        static constexpr dp::usize MAX_SEGMENTS = 64;
+
+        UdpDatagram()
+            : fd_(-1), family_(AF_INET), bound_(false), gso_available_(true), reuse_port_(false),
+              multicast_configured_(false), multicast_ttl_(1), multicast_loopback_(true) {
+            echo::trace("UdpDatagram constructed");
+        }
 
         ~UdpDatagram() override {
             if (fd_ >= 0) {
@@ -40,6 +227,7 @@ namespace netpipe {
                 echo::error("socket creation failed: ", strerror(errno));
                 return dp::result::err(dp::Error::io_error("io error"));
             }
+            family_ = AF_INET;
             echo::trace("udp socket created fd=", fd_);
 
             // Set SO_REUSEADDR
@@ -47,6 +235,12 @@ namespace netpipe {
             if (::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
                 echo::warn("setsockopt SO_REUSEADDR failed: ", strerror(errno));
             }
+            if (reuse_port_ && ::setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+                ::close(fd_);
+                fd_ = -1;
+                echo::error("setsockopt SO_REUSEPORT failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
 
             // Bind to address
             struct sockaddr_in addr = {};
@@ -79,16 +273,36 @@ namespace netpipe {
             return dp::result::ok();
         }
 
+        // Resolve a destination once for repeated sends
+        // Names go through the shared Resolver cache, so send_to(msg, endpoint) no longer costs a lookup each time
+        static dp::Res<UdpAddress> resolve(const UdpEndpoint &dest) {
+            auto addresses = Resolver::instance().resolve(dest.host, dest.port, AF_INET, SOCK_DGRAM);
+            if (addresses.is_err()) {
+                echo::error("resolving ", dest.to_string(), " failed");
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+
+            UdpAddress resolved;
+            std::memcpy(&resolved.addr, &addresses.value()[0].addr, sizeof(resolved.addr));
+            return dp::result::ok(resolved);
+        }
+
         // Send a message to a specific destination
         dp::Res<void> send_to(const Message &msg, const UdpEndpoint &dest) override {
-            if (fd_ < 0) {
-                // Create socket if not already created
-                fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
-                if (fd_ < 0) {
-                    echo::error("socket creation failed: ", strerror(errno));
-                    return dp::result::err(dp::Error::io_error("io error"));
-                }
-                echo::trace("udp socket created fd=", fd_);
+            echo::trace("sendto ", dest.to_string(), " len=", msg.size());
+
+            auto resolved = resolve(dest);
+            if (resolved.is_err()) {
+                return dp::result::err(resolved.error());
+            }
+            return send_to(msg, resolved.value());
+        }
+
+        // Send a message to an already resolved destination
+        dp::Res<void> send_to(const Message &msg, const UdpAddress &dest) {
+            auto sock_res = ensure_socket(AF_INET);
+            if (sock_res.is_err()) {
+                return sock_res;
             }
 
             // Check message size
@@ -98,44 +312,220 @@ namespace netpipe {
                                                                    std::to_string(msg.size()).c_str()));
             }
 
-            echo::trace("sendto ", dest.to_string(), " len=", msg.size());
+            // Send
+            dp::isize n = ::sendto(fd_, msg.data(), msg.size(), 0, (const struct sockaddr *)&dest.addr,
+                                   sizeof(dest.addr));
+            if (counters_) {
+                counters_->on_send_call();
+            }
+            if (n < 0) {
+                echo::error("sendto failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            if (counters_) {
+                counters_->on_send(msg.size());
+            }
+
+            echo::debug("sent ", n, " bytes");
+            return dp::result::ok();
+        }
+
+        // Send several messages to one destination, up to MAX_BATCH per sendmmsg syscall
+        // Returns how many were sent; an error is returned only if none of them could be
+        dp::Res<dp::usize> send_batch(std::span<const Message> msgs, const UdpAddress &dest) {
+            auto sock_res = ensure_socket(AF_INET);
+            if (sock_res.is_err()) {
+                return dp::result::err(sock_res.error());
+            }
+
+            // Reject the whole batch up front rather than stopping halfway through it
+            for (const auto &msg : msgs) {
+                if (msg.size() > MAX_UDP_SIZE) {
+                    echo::warn("message too large: ", msg.size(), " > ", MAX_UDP_SIZE);
+                    return dp::result::err(dp::Error::invalid_argument(dp::String("message too large: ") +
+                                                                       std::to_string(msg.size()).c_str()));
+                }
+            }
+
+            struct iovec iov[MAX_BATCH];
+            dp::usize sent = 0;
+
+            while (sent < msgs.size()) {
+                dp::usize count = msgs.size() - sent < MAX_BATCH ? msgs.size() - sent : MAX_BATCH;
+                for (dp::usize i = 0; i < count; ++i) {
+                    const Message &msg = msgs[sent + i];
+                    iov[i].iov_base = const_cast<dp::u8 *>(msg.data());
+                    iov[i].iov_len = msg.size();
+                }
+
+                auto res = send_mmsg(iov, count, dest);
+                if (res.is_err()) {
+                    if (sent == 0) {
+                        return res;
+                    }
+                    break;
+                }
+                sent += res.value();
+                if (res.value() < count) {
+                    break;
+                }
+            }
+
+            echo::debug("sent batch of ", sent, " datagrams");
+            return dp::result::ok(sent);
+        }
+
+        // Send buffer as consecutive segment_size datagrams (the last may be shorter) in one syscall
+        // Uses UDP_SEGMENT (GSO) so the kernel splits the buffer; falls back to sendmmsg if unsupported
+        // The receiver sees ordinary datagrams - no change to the message format
+        dp::Res<void> send_segmented(const Message &buffer, dp::u16 segment_size, const UdpAddress &dest) {
+            auto sock_res = ensure_socket(AF_INET);
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
 
-            // Resolve hostname
-            struct addrinfo hints = {};
-            hints.ai_family = AF_INET;
-            hints.ai_socktype = SOCK_DGRAM;
+            if (segment_size == 0 || segment_size > MAX_UDP_SIZE) {
+                echo::error("invalid segment size: ", segment_size);
+                return dp::result::err(dp::Error::invalid_argument("invalid segment size"));
+            }
+            dp::usize segments = (buffer.size() + segment_size - 1) / segment_size;
+            if (buffer.size() > MAX_SEGMENTED_SIZE || segments > MAX_SEGMENTS) {
+                echo::warn("segmented buffer too large: ", buffer.size(), " bytes in ", segments, " segments");
+                return dp::result::err(dp::Error::invalid_argument(dp::String("segmented buffer too large: ") +
+                                                                   std::to_string(buffer.size()).c_str()));
+            }
+            if (segments <= 1) {
+                return send_to(buffer, dest);
+            }
+
+            if (gso_available_) {
+                struct iovec iov = {const_cast<dp::u8 *>(buffer.data()), buffer.size()};
+                char control[CMSG_SPACE(sizeof(dp::u16))] = {};
+
+                struct msghdr hdr = {};
+                hdr.msg_name = const_cast<struct sockaddr_in *>(&dest.addr);
+                hdr.msg_namelen = sizeof(dest.addr);
+                hdr.msg_iov = &iov;
+                hdr.msg_iovlen = 1;
+                hdr.msg_control = control;
+                hdr.msg_controllen = sizeof(control);
+
+                struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(dp::u16));
+                std::memcpy(CMSG_DATA(cm), &segment_size, sizeof(segment_size));
+
+                dp::isize n;
+                do {
+                    n = ::sendmsg(fd_, &hdr, 0);
+                    if (counters_) {
+                        counters_->on_send_call();
+                    }
+                } while (n < 0 && errno == EINTR);
+                if (n >= 0) {
+                    if (counters_) {
+                        counters_->on_send_batch(segments, buffer.size());
+                    }
+                    echo::debug("sent ", n, " bytes as ", segments, " segments of ", segment_size);
+                    return dp::result::ok();
+                }
+
+                // EIO: device cannot checksum offload; ENOPROTOOPT/EINVAL: kernel without UDP GSO
+                if (errno != EIO && errno != ENOPROTOOPT && errno != EINVAL && errno != EOPNOTSUPP) {
+                    echo::error("sendmsg UDP_SEGMENT failed: ", strerror(errno));
+                    return dp::result::err(dp::Error::io_error("io error"));
+                }
+                echo::warn("UDP_SEGMENT unavailable (", strerror(errno), "), falling back to sendmmsg");
+                gso_available_ = false;
+            }
 
-            struct addrinfo *result = nullptr;
-            dp::String port_str(std::to_string(dest.port).c_str());
-            dp::i32 ret = ::getaddrinfo(dest.host.c_str(), port_str.c_str(), &hints, &result);
-            if (ret != 0) {
-                echo::error("getaddrinfo failed: ", gai_strerror(ret));
+            struct iovec iov[MAX_SEGMENTS];
+            for (dp::usize i = 0; i < segments; ++i) {
+                dp::usize offset = i * segment_size;
+                dp::usize len = buffer.size() - offset < segment_size ? buffer.size() - offset : segment_size;
+                iov[i].iov_base = const_cast<dp::u8 *>(buffer.data() + offset);
+                iov[i].iov_len = len;
+            }
+            auto res = send_mmsg(iov, segments, dest);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            if (res.value() < segments) {
+                echo::error("segmented send incomplete: ", res.value(), " of ", segments);
                 return dp::result::err(dp::Error::io_error("io error"));
             }
+            return dp::result::ok();
+        }
 
-            // Send
-            dp::isize n = ::sendto(fd_, msg.data(), msg.size(), 0, result->ai_addr, result->ai_addrlen);
-            ::freeaddrinfo(result);
+        // Whether send_segmented() still uses UDP_SEGMENT (false after the kernel rejected it)
+        bool gso_available() const { return gso_available_; }
 
-            if (n < 0) {
-                echo::error("sendto failed: ", strerror(errno));
+        // Socket descriptor for readiness polling, or -1 before bind()/the first send
+        dp::i32 native_handle() const { return fd_; }
+
+        // Share the port with other SO_REUSEPORT sockets of this user; the kernel spreads datagrams among them
+        // by flow hash (see UdpReceiverGroup). Takes effect at the next bind()
+        void set_reuse_port(bool enable) { reuse_port_ = enable; }
+
+        // Port the socket is bound to - the one the kernel picked when bind() was given port 0
+        dp::u16 local_port() const {
+            struct sockaddr_storage addr = {};
+            socklen_t length = sizeof(addr);
+            if (fd_ < 0 || ::getsockname(fd_, reinterpret_cast<struct sockaddr *>(&addr), &length) < 0) {
+                return 0;
+            }
+            return addr.ss_family == AF_INET6 ? ntohs(reinterpret_cast<struct sockaddr_in6 *>(&addr)->sin6_port)
+                                              : ntohs(reinterpret_cast<struct sockaddr_in *>(&addr)->sin_port);
+        }
+
+        // Enable or disable UDP_GRO: the kernel may then coalesce same-size datagrams from one peer
+        // A GRO socket must be read with recv_coalesced() - plain recv_from() would truncate coalesced payloads
+        dp::Res<void> set_gro(bool enable) {
+            auto sock_res = ensure_socket();
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+            dp::i32 opt = enable ? 1 : 0;
+            if (::setsockopt(fd_, SOL_UDP, UDP_GRO, &opt, sizeof(opt)) < 0) {
+                echo::error("setsockopt UDP_GRO failed: ", strerror(errno));
                 return dp::result::err(dp::Error::io_error("io error"));
             }
+            echo::debug("UDP_GRO ", enable ? "enabled" : "disabled");
+            return dp::result::ok();
+        }
 
-            echo::debug("sent ", n, " bytes to ", dest.to_string());
+        // Bound how long recv_from()/recv_from_into() block; they then fail with a timeout (0 = block forever)
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
+            auto sock_res = ensure_socket();
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+            struct timeval tv;
+            tv.tv_sec = timeout_ms / 1000;
+            tv.tv_usec = (timeout_ms % 1000) * 1000;
+            if (::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+                echo::error("setsockopt SO_RCVTIMEO failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            echo::trace("udp recv timeout set to ", timeout_ms, "ms");
             return dp::result::ok();
         }
 
+        // Busy-poll the device queue for up to usec in recv before sleeping (SO_BUSY_POLL, see TcpStream)
+        dp::Res<void> set_busy_poll(dp::u32 usec) {
+            auto sock_res = ensure_socket();
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+            return netpipe::set_busy_poll(fd_, usec);
+        }
+
         // Broadcast a message
         dp::Res<void> broadcast(const Message &msg) override {
-            if (fd_ < 0) {
-                // Create socket if not already created
-                fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
-                if (fd_ < 0) {
-                    echo::error("socket creation failed: ", strerror(errno));
-                    return dp::result::err(dp::Error::io_error("io error"));
-                }
-                echo::trace("udp socket created fd=", fd_);
+            auto sock_res = ensure_socket(AF_INET);
+            if (sock_res.is_err()) {
+                return sock_res;
             }
 
             // Enable broadcast
@@ -162,17 +552,227 @@ namespace netpipe {
             addr.sin_addr.s_addr = INADDR_BROADCAST;
 
             dp::isize n = ::sendto(fd_, msg.data(), msg.size(), 0, (struct sockaddr *)&addr, sizeof(addr));
+            if (counters_) {
+                counters_->on_send_call();
+            }
             if (n < 0) {
                 echo::error("broadcast sendto failed: ", strerror(errno));
                 return dp::result::err(dp::Error::io_error("io error"));
             }
+            if (counters_) {
+                counters_->on_send(msg.size());
+            }
 
             echo::debug("broadcast ", n, " bytes");
             return dp::result::ok();
         }
 
+        // Bind to group.port on every address and join group - the receive side of a multicast group
+        // Only hosts that joined get the datagrams, unlike broadcast, and routers carry them across subnets
+        // An IPv6 group makes an IPv6 socket; read it with recv_from()/recv_from_into() (recv_batch is IPv4 only)
+        dp::Res<void> bind_group(const MulticastEndpoint &group) {
+            echo::trace("binding to multicast group ", group.to_string());
+            if (fd_ >= 0) {
+                return dp::result::err(dp::Error::invalid_argument("socket already open"));
+            }
+            auto address = parse_group(group);
+            if (address.is_err()) {
+                return dp::result::err(address.error());
+            }
+            auto sock_res = ensure_socket(address.value().family());
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+
+            // Several receivers on one host may join the same group and port
+            dp::i32 opt = 1;
+            if (::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+                echo::warn("setsockopt SO_REUSEADDR failed: ", strerror(errno));
+            }
+
+            // Linux delivers a group to every socket on its port once any socket joined it - only take our own
+            opt = 0;
+            if (family_ == AF_INET6) {
+                (void)::setsockopt(fd_, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &opt, sizeof(opt)); // Linux 4.20+
+            } else if (::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_ALL, &opt, sizeof(opt)) < 0) {
+                echo::warn("setsockopt IP_MULTICAST_ALL failed: ", strerror(errno));
+            }
+
+            // Bound to the wildcard address so unicast to the port still arrives; the group filters the rest
+            struct sockaddr_storage addr = {};
+            socklen_t length;
+            if (family_ == AF_INET6) {
+                auto *in6 = reinterpret_cast<struct sockaddr_in6 *>(&addr);
+                in6->sin6_family = AF_INET6;
+                in6->sin6_port = htons(group.port);
+                in6->sin6_addr = in6addr_any;
+                length = sizeof(struct sockaddr_in6);
+            } else {
+                auto *in4 = reinterpret_cast<struct sockaddr_in *>(&addr);
+                in4->sin_family = AF_INET;
+                in4->sin_port = htons(group.port);
+                in4->sin_addr.s_addr = INADDR_ANY;
+                length = sizeof(struct sockaddr_in);
+            }
+            if (::bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), length) < 0) {
+                echo::error("bind failed: ", strerror(errno));
+                close();
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            bound_ = true;
+            local_endpoint_ = UdpEndpoint{family_ == AF_INET6 ? "::" : "0.0.0.0", group.port};
+
+            auto join_res = join_group(group);
+            if (join_res.is_err()) {
+                close();
+                return join_res;
+            }
+            echo::info("UdpDatagram joined ", group.to_string());
+            return dp::result::ok();
+        }
+
+        // Join another group on this socket; datagrams for it arrive if they target the bound port
+        dp::Res<void> join_group(const MulticastEndpoint &group) { return membership(group, true); }
+
+        // Stop receiving a group; the kernel also leaves every group when the socket closes
+        dp::Res<void> leave_group(const MulticastEndpoint &group) { return membership(group, false); }
+
+        // Router hops multicast sends may take (IP_MULTICAST_TTL / IPV6_MULTICAST_HOPS)
+        dp::Res<void> set_multicast_ttl(dp::u8 ttl) {
+            auto sock_res = ensure_socket();
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+            dp::i32 value = ttl;
+            dp::i32 ret = family_ == AF_INET6
+                              ? ::setsockopt(fd_, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &value, sizeof(value))
+                              : ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &value, sizeof(value));
+            if (ret < 0) {
+                echo::error("setting multicast ttl failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            multicast_ttl_ = ttl;
+            return dp::result::ok();
+        }
+
+        // Whether our own multicast sends are delivered to members on this host (on by default in the kernel)
+        dp::Res<void> set_multicast_loopback(bool enable) {
+            auto sock_res = ensure_socket();
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+            dp::i32 ret;
+            if (family_ == AF_INET6) {
+                dp::u32 value = enable ? 1 : 0;
+                ret = ::setsockopt(fd_, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &value, sizeof(value));
+            } else {
+                dp::u8 value = enable ? 1 : 0;
+                ret = ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &value, sizeof(value));
+            }
+            if (ret < 0) {
+                echo::error("setting multicast loopback failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            multicast_loopback_ = enable;
+            return dp::result::ok();
+        }
+
+        // Interface multicast sends leave by: a name, or for IPv4 a local address; empty resets to routing
+        dp::Res<void> set_multicast_interface(const dp::String &name) {
+            auto sock_res = ensure_socket();
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+            dp::i32 ret;
+            if (family_ == AF_INET6) {
+                auto index = interface_index(name);
+                if (index.is_err()) {
+                    return dp::result::err(index.error());
+                }
+                dp::u32 value = index.value();
+                ret = ::setsockopt(fd_, IPPROTO_IPV6, IPV6_MULTICAST_IF, &value, sizeof(value));
+            } else {
+                struct ip_mreqn mreq = {};
+                auto index = interface_index(name, &mreq.imr_address);
+                if (index.is_err()) {
+                    return dp::result::err(index.error());
+                }
+                mreq.imr_ifindex = static_cast<dp::i32>(index.value());
+                ret = ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof(mreq));
+            }
+            if (ret < 0) {
+                echo::error("setting multicast interface failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            multicast_interface_ = name;
+            return dp::result::ok();
+        }
+
+        // One send reaches every member of group; its ttl, loopback and interface are applied first
+        // Options are only set when they differ from the previous send, so steady fan-out is one syscall
+        dp::Res<void> send_to_group(const Message &msg, const MulticastEndpoint &group) {
+            if (msg.size() > MAX_UDP_SIZE) {
+                echo::warn("message too large: ", msg.size(), " > ", MAX_UDP_SIZE);
+                return dp::result::err(dp::Error::invalid_argument(dp::String("message too large: ") +
+                                                                   std::to_string(msg.size()).c_str()));
+            }
+            auto address = parse_group(group);
+            if (address.is_err()) {
+                return dp::result::err(address.error());
+            }
+            auto sock_res = ensure_socket(address.value().family());
+            if (sock_res.is_err()) {
+                return sock_res;
+            }
+
+            if (!multicast_configured_ || group.ttl != multicast_ttl_) {
+                auto res = set_multicast_ttl(group.ttl);
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            if (!multicast_configured_ || group.loopback != multicast_loopback_) {
+                auto res = set_multicast_loopback(group.loopback);
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            if (!multicast_configured_ || group.interface_name != multicast_interface_) {
+                auto res = set_multicast_interface(group.interface_name);
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            multicast_configured_ = true;
+
+            dp::isize n = ::sendto(fd_, msg.data(), msg.size(), 0, address.value().sockaddr_ptr(),
+                                   address.value().length);
+            if (counters_) {
+                counters_->on_send_call();
+            }
+            if (n < 0) {
+                echo::error("multicast sendto ", group.to_string(), " failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            if (counters_) {
+                counters_->on_send(msg.size());
+            }
+            echo::debug("sent ", n, " bytes to group ", group.to_string());
+            return dp::result::ok();
+        }
+
         // Receive a message
         dp::Res<dp::Pair<Message, UdpEndpoint>> recv_from() override {
+            Message msg;
+            auto res = recv_from_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(dp::Pair<Message, UdpEndpoint>(std::move(msg), res.value()));
+        }
+
+        // Receive into a caller-owned buffer, reusing its capacity
+        dp::Res<UdpEndpoint> recv_from_into(Message &msg) override {
             if (!bound_) {
                 echo::error("recv_from called but not bound");
                 return dp::result::err(dp::Error::invalid_argument("not bound"));
@@ -180,12 +780,19 @@ namespace netpipe {
 
             echo::trace("recv_from waiting for message");
 
-            // Receive
-            Message msg(MAX_UDP_SIZE);
-            struct sockaddr_in src_addr = {};
+            // Receive (resize only allocates the first time a buffer is used)
+            msg.resize(MAX_UDP_SIZE);
+            struct sockaddr_storage src_addr = {}; // IPv4, or IPv6 on a bind_group socket
             socklen_t src_len = sizeof(src_addr);
 
             dp::isize n = ::recvfrom(fd_, msg.data(), msg.size(), 0, (struct sockaddr *)&src_addr, &src_len);
+            if (counters_) {
+                counters_->on_recv_call();
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                echo::trace("recvfrom timed out");
+                return dp::result::err(dp::Error::timeout("recv timeout"));
+            }
             if (n < 0) {
                 echo::error("recvfrom failed: ", strerror(errno));
                 return dp::result::err(dp::Error::io_error("io error"));
@@ -193,18 +800,144 @@ namespace netpipe {
 
             // Resize message to actual received size
             msg.resize(static_cast<dp::usize>(n));
+            if (counters_) {
+                counters_->on_recv(msg.size());
+            }
 
             // Get source address
-            char src_ip[INET_ADDRSTRLEN];
-            ::inet_ntop(AF_INET, &src_addr.sin_addr, src_ip, sizeof(src_ip));
-            dp::u16 src_port = ntohs(src_addr.sin_port);
+            char src_ip[INET6_ADDRSTRLEN];
+            dp::u16 src_port;
+            if (src_addr.ss_family == AF_INET6) {
+                const auto *in6 = reinterpret_cast<const struct sockaddr_in6 *>(&src_addr);
+                ::inet_ntop(AF_INET6, &in6->sin6_addr, src_ip, sizeof(src_ip));
+                src_port = ntohs(in6->sin6_port);
+            } else {
+                const auto *in4 = reinterpret_cast<const struct sockaddr_in *>(&src_addr);
+                ::inet_ntop(AF_INET, &in4->sin_addr, src_ip, sizeof(src_ip));
+                src_port = ntohs(in4->sin_port);
+            }
 
             UdpEndpoint src_endpoint{dp::String(src_ip), src_port};
 
             echo::trace("recvfrom got ", n, " bytes from ", src_endpoint.to_string());
             echo::debug("received ", n, " bytes from ", src_endpoint.to_string());
 
-            return dp::result::ok(dp::Pair<Message, UdpEndpoint>(std::move(msg), src_endpoint));
+            return dp::result::ok(src_endpoint);
+        }
+
+        // Receive up to min(msgs.size(), MAX_BATCH) datagrams with one recvmmsg syscall
+        // Blocks for the first datagram, then takes whatever else is already queued
+        // Each message is resized to the datagram length; sources (if given) must be at least as long as msgs
+        // Returns how many messages were filled
+        dp::Res<dp::usize> recv_batch(std::span<Message> msgs, std::span<UdpAddress> sources = {}) {
+            if (!bound_) {
+                echo::error("recv_batch called but not bound");
+                return dp::result::err(dp::Error::invalid_argument("not bound"));
+            }
+            if (!sources.empty() && sources.size() < msgs.size()) {
+                echo::error("recv_batch sources shorter than msgs: ", sources.size(), " < ", msgs.size());
+                return dp::result::err(dp::Error::invalid_argument("sources too short"));
+            }
+
+            dp::usize count = msgs.size() < MAX_BATCH ? msgs.size() : MAX_BATCH;
+            if (count == 0) {
+                return dp::result::ok(dp::usize(0));
+            }
+
+            struct mmsghdr headers[MAX_BATCH];
+            struct iovec iov[MAX_BATCH];
+            struct sockaddr_in addrs[MAX_BATCH];
+            for (dp::usize i = 0; i < count; ++i) {
+                msgs[i].resize(MAX_UDP_SIZE);
+                iov[i].iov_base = msgs[i].data();
+                iov[i].iov_len = msgs[i].size();
+                headers[i] = {};
+                headers[i].msg_hdr.msg_name = sources.empty() ? &addrs[i] : &sources[i].addr;
+                headers[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+                headers[i].msg_hdr.msg_iov = &iov[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            echo::trace("recv_batch waiting for up to ", count, " datagrams");
+
+            dp::i32 n;
+            do {
+                n = ::recvmmsg(fd_, headers, static_cast<unsigned int>(count), MSG_WAITFORONE, nullptr);
+                if (counters_) {
+                    counters_->on_recv_call();
+                }
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) {
+                echo::error("recvmmsg failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+
+            dp::u64 bytes = 0;
+            for (dp::i32 i = 0; i < n; ++i) {
+                msgs[i].resize(headers[i].msg_len);
+                bytes += headers[i].msg_len;
+            }
+            if (counters_) {
+                counters_->on_recv_batch(static_cast<dp::u64>(n), bytes);
+            }
+
+            echo::debug("received batch of ", n, " datagrams");
+            return dp::result::ok(static_cast<dp::usize>(n));
+        }
+
+        // Receive one possibly coalesced payload (see set_gro) into buffer
+        // Returns the segment size: buffer holds consecutive datagrams of that length, the last may be shorter
+        // Without coalescing the whole buffer is one datagram and its length is returned
+        dp::Res<dp::usize> recv_coalesced(Message &buffer, UdpAddress *source = nullptr) {
+            if (!bound_) {
+                echo::error("recv_coalesced called but not bound");
+                return dp::result::err(dp::Error::invalid_argument("not bound"));
+            }
+
+            buffer.resize(MAX_SEGMENTED_SIZE);
+            struct iovec iov = {buffer.data(), buffer.size()};
+            struct sockaddr_in src_addr = {};
+            char control[CMSG_SPACE(sizeof(dp::i32))] = {};
+
+            struct msghdr hdr = {};
+            hdr.msg_name = &src_addr;
+            hdr.msg_namelen = sizeof(src_addr);
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = control;
+            hdr.msg_controllen = sizeof(control);
+
+            dp::isize n;
+            do {
+                n = ::recvmsg(fd_, &hdr, 0);
+                if (counters_) {
+                    counters_->on_recv_call();
+                }
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) {
+                echo::error("recvmsg failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            buffer.resize(static_cast<dp::usize>(n));
+
+            dp::usize segment_size = static_cast<dp::usize>(n);
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr); cm != nullptr; cm = CMSG_NXTHDR(&hdr, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    dp::i32 gso_size = 0;
+                    std::memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+                    segment_size = static_cast<dp::usize>(gso_size);
+                }
+            }
+            if (source != nullptr) {
+                source->addr = src_addr;
+            }
+            if (counters_) {
+                dp::u64 datagrams = segment_size > 0 ? (static_cast<dp::u64>(n) + segment_size - 1) / segment_size : 1;
+                counters_->on_recv_batch(datagrams, static_cast<dp::u64>(n));
+            }
+
+            echo::debug("received ", n, " bytes, segment size ", segment_size);
+            return dp::result::ok(segment_size);
         }
 
         // Close the socket
@@ -214,6 +947,7 @@ namespace netpipe {
                 ::close(fd_);
                 fd_ = -1;
                 bound_ = false;
+                multicast_configured_ = false;
                 echo::debug("UdpDatagram closed");
             }
         }
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <netpipe/datagram/udp.hpp>
+#include <netpipe/remote/executor.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <linux/filter.h>
+#include <poll.h>
+#include <pthread.h>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+namespace netpipe {
+
+    // Which shard of a UdpReceiverGroup the kernel hands a datagram to
+    enum class UdpSteering : dp::u8 {
+        FlowHash = 0, // Kernel default: hash of the 4-tuple, so one sender always lands on one shard
+        Cpu = 1,      // BPF program: the shard pinned to the CPU that took the packet in, so a flow is read on
+                      // the core its RSS queue interrupts (CPUs outside the group: that CPU modulo shards)
+    };
+
+    struct UdpReceiverOptions {
+        dp::usize shards = 0;     // 0 = one per usable CPU
+        bool pin_threads = true;  // Shard i runs on the i-th usable CPU
+        dp::i32 numa_node = -1;   // Take the CPUs from this NUMA node only (-1 = any)
+        UdpSteering steering = UdpSteering::FlowHash;
+        dp::usize batch = 32;     // Datagrams per recvmmsg, up to UdpDatagram::MAX_BATCH
+    };
+
+    // One UDP port read by N threads, each with its own SO_REUSEPORT socket
+    // A single socket is drained by one thread however many cores there are; with N sockets on the port the
+    // kernel queues each datagram on one of them, so shards never share a queue or a lock and ingest scales
+    // with the threads. The handler runs on the shard's thread with the shard index - state indexed by shard
+    // needs no synchronisation. The message and source are only valid during the call.
+    class UdpReceiverGroup {
+      public:
+        using Handler = std::function<void(dp::usize shard, const Message &msg, const UdpAddress &source)>;
+
+      private:
+        struct Shard {
+            UdpDatagram socket;
+            std::thread thread;
+            std::atomic<dp::u64> packets{0};
+        };
+
+        dp::Vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<bool> running_;
+        dp::u16 port_;
+
+        // Classic BPF for the reuseport group: a compare per CPU of cpus (shard i runs on cpus[i % size]) returns
+        // its first shard; any other CPU falls through to the receiving CPU modulo the number of sockets
+        dp::Res<void> attach_cpu_steering(const std::vector<dp::i32> &cpus) {
+            std::vector<struct sock_filter> code;
+            code.push_back({BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<dp::u32>(SKF_AD_OFF + SKF_AD_CPU)});
+            dp::usize mapped = std::min(cpus.size(), shards_.size());
+            for (dp::usize i = 0; i < mapped; i++) {
+                code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<dp::u32>(cpus[i])});
+                code.push_back({BPF_RET | BPF_K, 0, 0, static_cast<dp::u32>(i)});
+            }
+            code.push_back({BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<dp::u32>(shards_.size())});
+            code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+            if (code.size() > BPF_MAXINSNS) {
+                echo::error("too many CPUs for the steering program: ", cpus.size());
+                return dp::result::err(dp::Error::invalid_argument("too many CPUs"));
+            }
+            struct sock_fprog program = {static_cast<unsigned short>(code.size()), code.data()};
+            if (::setsockopt(shards_[0]->socket.native_handle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                             sizeof(program)) < 0) {
+                echo::error("SO_ATTACH_REUSEPORT_CBPF failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            return dp::result::ok();
+        }
+
+        // cpu is where the shard runs (-1 = unpinned); pinned here so even the first recvmmsg is on that core
+        void shard_loop(Shard &shard, dp::usize index, dp::i32 cpu, dp::usize batch, const Handler &handler) {
+            if (cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                dp::i32 rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+                if (rc != 0) {
+                    echo::warn("failed to pin udp shard ", index, ": ", strerror(rc));
+                }
+            }
+            dp::Vector<Message> packets(batch);
+            dp::Vector<UdpAddress> sources(batch);
+            while (running_.load(std::memory_order_acquire)) {
+                struct pollfd pfd = {shard.socket.native_handle(), POLLIN, 0};
+                if (::poll(&pfd, 1, 100) <= 0) {
+                    continue; // Bounded wait so stop() is noticed
+                }
+                auto res = shard.socket.recv_batch(std::span<Message>(packets.data(), packets.size()),
+                                                   std::span<UdpAddress>(sources.data(), sources.size()));
+                if (res.is_err()) {
+                    continue;
+                }
+                for (dp::usize i = 0; i < res.value(); i++) {
+                    handler(index, packets[i], sources[i]);
+                }
+                shard.packets.fetch_add(res.value(), std::memory_order_relaxed);
+            }
+        }
+
+      public:
+        UdpReceiverGroup() : running_(false), port_(0) {}
+        ~UdpReceiverGroup() { stop(); }
+
+        UdpReceiverGroup(const UdpReceiverGroup &) = delete;
+        UdpReceiverGroup &operator=(const UdpReceiverGroup &) = delete;
+
+        // Bind every shard to endpoint and start their threads
+        // Port 0 binds the first shard to an ephemeral port and the others to the same one (see port())
+        dp::Res<void> start(const UdpEndpoint &endpoint, Handler handler, const UdpReceiverOptions &options = {}) {
+            if (running_) {
+                return dp::result::err(dp::Error::invalid_argument("already started"));
+            }
+            auto cpus = remote::usable_cpus(options.numa_node);
+            dp::usize count = options.shards != 0 ? options.shards : (cpus.empty() ? 1 : cpus.size());
+            dp::usize batch = options.batch == 0 ? 1 : std::min(options.batch, UdpDatagram::MAX_BATCH);
+
+            shards_.clear();
+            UdpEndpoint bind_to = endpoint;
+            for (dp::usize i = 0; i < count; i++) {
+                auto shard = std::make_unique<Shard>();
+                shard->socket.set_reuse_port(true);
+                auto res = shard->socket.bind(bind_to);
+                if (res.is_err()) {
+                    shards_.clear();
+                    return res;
+                }
+                bind_to.port = shard->socket.local_port();
+                shards_.push_back(std::move(shard));
+            }
+            port_ = bind_to.port;
+
+            if (options.steering == UdpSteering::Cpu) {
+                auto res = attach_cpu_steering(cpus);
+                if (res.is_err()) {
+                    shards_.clear();
+                    return res;
+                }
+            }
+
+            running_ = true;
+            auto shared = std::make_shared<Handler>(std::move(handler));
+            for (dp::usize i = 0; i < count; i++) {
+                Shard &shard = *shards_[i];
+                dp::i32 cpu = options.pin_threads && !cpus.empty() ? cpus[i % cpus.size()] : -1;
+                shard.thread = std::thread([this, &shard, i, cpu, batch, shared]() {
+                    shard_loop(shard, i, cpu, batch, *shared);
+                });
+            }
+            echo::info("UdpReceiverGroup listening on ", endpoint.host.c_str(), ":", port_, " with ", count,
+                       " shards");
+            return dp::result::ok();
+        }
+
+        // Join the shard threads and close the sockets; datagrams queued but not yet read are dropped
+        // Packet counts stay readable until the next start()
+        void stop() {
+            if (!running_.exchange(false)) {
+                return;
+            }
+            for (auto &shard : shards_) {
+                if (shard->thread.joinable()) {
+                    shard->thread.join();
+                }
+                shard->socket.close();
+            }
+            echo::debug("UdpReceiverGroup stopped");
+        }
+
+        bool is_running() const { return running_; }
+
+        dp::usize shard_count() const { return shards_.size(); }
+
+        // Bound port, shared by all shards
+        dp::u16 port() const { return port_; }
+
+        // Datagrams handled by one shard so far
+        dp::u64 packets(dp::usize shard) const { return shards_[shard]->packets.load(std::memory_order_relaxed); }
+
+        dp::u64 total_packets() const {
+            dp::u64 total = 0;
+            for (const auto &shard : shards_) {
+                total += shard->packets.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+    };
+
+} // namespace netpipe
@@ -20,6 +20,21 @@ namespace netpipe {
         inline dp::String to_string() const { return host + ":" + dp::String(std::to_string(port).c_str()); }
     };
 
+    // Multicast group - IPv4 (224.0.0.0/4) or IPv6 (ff00::/8) group address and port
+    // Used both to join a group (UdpDatagram::bind_group) and to send to it (UdpDatagram::send_to_group)
+    struct MulticastEndpoint {
+        dp::String group; // Group address like 239.1.2.3 or ff15::42
+        dp::u16 port;
+        dp::String interface_name = {}; // Interface to join/send on ("eth0", or a local IPv4 address); empty = routing
+        dp::u8 ttl = 1;                 // Hop limit of sent datagrams; 1 keeps them on the local subnet
+        bool loopback = true;           // Also deliver our own sends to members on this host
+
+        inline dp::String to_string() const {
+            dp::String out = group + ":" + dp::String(std::to_string(port).c_str());
+            return interface_name.empty() ? out : out + "%" + interface_name;
+        }
+    };
+
     // IPC endpoint - Unix domain socket path
     struct IpcEndpoint {
         dp::String path; // Filesystem path like /tmp/myapp.sock
@@ -27,16 +42,73 @@ namespace netpipe {
         inline dp::String to_string() const { return path; }
     };
 
+    // How a shared memory stream waits for data (recv) or for ring space (send)
+    enum class ShmWaitStrategy : dp::u8 {
+        BusySpin,      // Spin on the ring cursors - lowest latency, burns a core while idle
+        SpinThenFutex, // Bounded adaptive spin, then park on a futex in the shared header
+        Sleep,         // Exponential sleep backoff - lowest CPU, highest wakeup jitter
+    };
+
+    // Paging and placement of the regions a shared memory endpoint maps
+    // All of these are hints: when the kernel refuses one (no THP for shmem, RLIMIT_MEMLOCK, no such node)
+    // the region still works and a warning is logged
+    struct ShmRegionOptions {
+        bool huge_pages = false; // Round rings up to 2MB, align their mapping and request THP (MADV_HUGEPAGE)
+        bool prefault = false;   // Fault every page in while mapping, so the first message takes no page faults
+        bool lock = false;       // mlock the mapping so it is never paged out
+        dp::i32 numa_node = -1;  // Bind the region's pages to this NUMA node (-1 = kernel default)
+    };
+
     // Shared memory endpoint - name and size
     struct ShmEndpoint {
         dp::String name; // Shared memory region name
         dp::usize size;  // Ring buffer size in bytes
+        ShmWaitStrategy wait = ShmWaitStrategy::SpinThenFutex;
+        ShmRegionOptions region = {}; // Applied by the side that maps: listener on accept, client on connect
 
         inline dp::String to_string() const {
             return name + " (size=" + dp::String(std::to_string(size).c_str()) + ")";
         }
     };
 
+    // Pub/sub topic - a name plus the paths a publisher offers it on (see Publisher/Subscriber)
+    // A publisher serves every path enabled here; a subscriber takes the cheapest one it can reach, in this order
+    struct TopicEndpoint {
+        dp::String name;                  // Topic name; also names the shared memory ring
+        bool shm = true;                  // Same-host broadcast ring
+        dp::usize shm_size = 1024 * 1024; // Ring size in bytes (publisher only)
+        MulticastEndpoint multicast = {}; // LAN fan-out; an empty group disables it
+        TcpEndpoint tcp = {};             // One TCP connection per subscriber; an empty host disables it
+
+        inline dp::String to_string() const {
+            dp::String out = name;
+            if (shm) {
+                out += " shm";
+            }
+            if (!multicast.group.empty()) {
+                out += " udp://" + multicast.to_string();
+            }
+            if (!tcp.host.empty()) {
+                out += " tcp://" + tcp.to_string();
+            }
+            return out;
+        }
+    };
+
+    // Locality-negotiated endpoint - a TCP address plus the service name its local transports are derived from
+    // Written as auto://host:port/service (see connect_auto/listen_auto); IPC uses /tmp/netpipe_<service>.sock
+    // and shared memory the channel netpipe_<service>. Without a service name the port is used.
+    struct AutoEndpoint {
+        TcpEndpoint tcp;
+        dp::String service;
+
+        inline dp::String ipc_path() const { return "/tmp/netpipe_" + service + ".sock"; }
+
+        inline dp::String shm_name() const { return "netpipe_" + service; }
+
+        inline dp::String to_string() const { return "auto://" + tcp.to_string() + "/" + service; }
+    };
+
     // LoRa endpoint - IPv6 address (melodi uses IPv6 mesh)
     struct LoraEndpoint {
         dp::String ipv6; // IPv6 address like 2001:db8::42
@@ -5,36 +5,89 @@
 //                         Datagram (unreliable, connectionless)
 
 // Core types and utilities
+#include <netpipe/budget.hpp>
+#include <netpipe/capture.hpp>
 #include <netpipe/common.hpp>
 #include <netpipe/endpoint.hpp>
+#include <netpipe/pubsub.hpp>
+#include <netpipe/reactor.hpp>
+#include <netpipe/resolver.hpp>
+#include <netpipe/stats.hpp>
+#include <netpipe/timer.hpp>
+#include <netpipe/trace.hpp>
+#include <netpipe/tunnel.hpp>
 
 // Base classes
 #include <netpipe/datagram.hpp>
 #include <netpipe/stream.hpp>
 
 // Stream implementations
+#include <netpipe/stream/auto.hpp>
+#include <netpipe/stream/datagram_stream.hpp>
 #include <netpipe/stream/ipc.hpp>
+#include <netpipe/stream/reliable_udp.hpp>
 #include <netpipe/stream/shm.hpp>
+#include <netpipe/stream/shm_topic.hpp>
 #include <netpipe/stream/tcp.hpp>
+#include <netpipe/stream/uring.hpp>
+#ifdef NETPIPE_RDMA
+#include <netpipe/stream/rdma.hpp> // Needs libibverbs
+#endif
 
 // Datagram implementations
 #include <netpipe/datagram/lora.hpp>
 #include <netpipe/datagram/udp.hpp>
+#include <netpipe/datagram/udp_group.hpp>
 
 // Higher-level protocols
 #include <netpipe/remote/async.hpp>
+#include <netpipe/remote/cache.hpp>
+#include <netpipe/remote/compact.hpp>
+#include <netpipe/remote/compression.hpp>
+#include <netpipe/remote/deadline.hpp>
+#include <netpipe/remote/executor.hpp>
+#include <netpipe/remote/frame.hpp>
+#include <netpipe/remote/lanes.hpp>
+#include <netpipe/remote/latency.hpp>
 #include <netpipe/remote/metrics.hpp>
+#include <netpipe/remote/pending.hpp>
+#include <netpipe/remote/pool.hpp>
 #include <netpipe/remote/remote.hpp>
 #include <netpipe/remote/serialization.hpp>
+#include <netpipe/remote/server.hpp>
 #include <netpipe/remote/streaming.hpp>
+#include <netpipe/remote/task.hpp>
+#include <netpipe/remote/writer.hpp>
 
 // All types are in the netpipe:: namespace
 // Available types:
 //   - netpipe::Message (dp::Vector<dp::u8>)
 //   - netpipe::TcpEndpoint, UdpEndpoint, IpcEndpoint, ShmEndpoint, LoraEndpoint
 //   - netpipe::Stream (base class)
-//   - netpipe::TcpStream, IpcStream, ShmStream
+//   - netpipe::TcpStream, IpcStream, ShmStream, UringStream
+//   - netpipe::RdmaStream - RC queue pairs over InfiniBand/RoCE (NETPIPE_RDMA builds)
+//   - netpipe::ReliableUdpStream - Acked, per-channel ordered messages over UDP
+//   - netpipe::DatagramStream - Stream over a bound Datagram and one peer (Remote over LoRa/UDP)
+//   - netpipe::connect_auto, listen_auto / AutoListener - One address, upgraded to SHM or IPC on the same host
+//   - netpipe::ShmPublisher, ShmSubscriber - One-writer broadcast topic in shared memory
 //   - netpipe::Datagram (base class)
 //   - netpipe::UdpDatagram, LoraDatagram
+//   - netpipe::UdpReceiverGroup - SO_REUSEPORT shards reading one UDP port on N threads
+//   - netpipe::Publisher<T>, Subscriber<T> - Topics over SHM, UDP multicast or per-subscriber TCP
 //   - netpipe::Remote<Unidirect> - Simple client-server RPC
 //   - netpipe::Remote<Bidirect> - Bidirectional peer-to-peer RPC with concurrency
+//   - netpipe::CaptureWriter, CaptureReader, RecordingStream, CaptureReplayer - Traffic capture and replay
+//   - netpipe::trace - NETPIPE_TRACE events in per-thread rings, exported as Chrome trace JSON
+//   - netpipe::Tunnel, TapDevice - Batched L2 (Ethernet) tunnel between TAP queues and any Stream
+//   - netpipe::MemoryBudget, BudgetLease - Process-wide cap on received bytes in flight, with fast rejection
+//   - netpipe::TransportStats, StatsRegistry - Opt-in per-connection transport counters and TCP_INFO
+//   - netpipe::Reactor - epoll event loop for many fds on one thread
+//   - netpipe::Resolver - Cached getaddrinfo shared by TcpStream and UdpDatagram
+//   - netpipe::TimerWheel, TimerService - Hierarchical timer wheel for deadlines and keepalives
+//   - netpipe::remote::CompactStream - Negotiated compact Remote headers for constrained links
+//   - netpipe::remote::RemoteServer - Remote server for many connections on one event loop
+//   - netpipe::remote::Task<T> - Coroutine returned by call_async()
+//   - netpipe::remote::FrameWriter - Flat-combining writer that coalesces concurrent sends into one writev
+//   - netpipe::remote::FrameBuilder - One-buffer V2 frame with prefix headroom that serializers append into
+//   - netpipe::remote::ResponseCache - Byte-bounded LRU/TTL cache of idempotent methods' encoded responses
+//   - netpipe::remote::LowLatencyOptions - Spinning receiver, SO_BUSY_POLL, CPU pinning and inline handlers
@@ -0,0 +1,531 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <netpipe/datagram/udp.hpp>
+#include <netpipe/remote/serialization.hpp>
+#include <netpipe/stream/shm_topic.hpp>
+#include <netpipe/stream/tcp.hpp>
+#include <poll.h>
+#include <thread>
+#include <type_traits>
+
+namespace netpipe {
+
+    // How a topic queue treats a reader that falls behind - it loses data, the publisher never waits
+    enum class TopicPolicy : dp::u8 {
+        LatestValue = 0, // Only the newest message is kept: state topics such as a pose
+        KeepLast = 1,    // The newest depth messages are kept, older ones dropped: event streams
+    };
+
+    struct TopicQos {
+        TopicPolicy policy = TopicPolicy::KeepLast;
+        dp::usize depth = 16; // KeepLast queue length, both per TCP subscriber and in every Subscriber
+    };
+
+    // Path a subscriber receives a topic on
+    enum class TopicTransport : dp::u8 {
+        None = 0,
+        Shm = 1,       // Publisher's shared memory ring on this host
+        Multicast = 2, // UDP multicast group
+        Tcp = 3,       // Own TCP connection to the publisher
+    };
+
+    // Every record of a topic, on every path: [topic_id:4][sequence:8][payload]
+    // topic_id (FNV-1a of the name) keeps other traffic on a shared multicast group out; sequence counts
+    // publishes from 0 so subscribers can tell how many messages they missed.
+    constexpr dp::usize TOPIC_HEADER_SIZE = 12;
+
+    inline dp::u32 topic_id(const dp::String &name) {
+        dp::u32 hash = 2166136261u;
+        for (char c : name) {
+            hash = (hash ^ static_cast<dp::u8>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    // Untyped publishing side of a topic; Publisher<T> adds serialization
+    // publish() writes the record once into the SHM ring, once to the multicast group and once into a shared
+    // history for the TCP subscribers, so its cost does not grow with the audience. Each TCP subscriber has a
+    // sender thread following its own cursor through that history: one that falls behind skips ahead under the
+    // topic's policy instead of stalling the publisher or the other subscribers.
+    class TopicPublisher {
+      private:
+        struct Peer {
+            std::unique_ptr<Stream> stream;
+            std::thread thread;
+            std::atomic<bool> done{false};
+        };
+
+        TopicEndpoint endpoint_;
+        TopicQos qos_;
+        dp::u32 topic_id_;
+        ShmPublisher shm_;
+        UdpDatagram udp_;
+        TcpStream listener_;
+        bool use_shm_;
+        bool use_multicast_;
+        bool use_tcp_;
+
+        std::atomic<bool> running_;
+        std::thread accept_thread_;
+        std::mutex mutex_; // Guards everything below
+        std::condition_variable cv_;
+        std::deque<std::shared_ptr<const Message>> history_; // Newest records for TCP subscribers
+        dp::u64 next_sequence_;
+        std::deque<std::unique_ptr<Peer>> peers_;
+        dp::u64 dropped_; // Records TCP subscribers skipped
+
+        void peer_loop(Peer &peer, dp::u64 cursor) {
+            while (running_) {
+                std::shared_ptr<const Message> record;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait_for(lock, std::chrono::milliseconds(100),
+                                 [&] { return !running_ || cursor < next_sequence_; });
+                    if (!running_ || cursor >= next_sequence_) {
+                        continue;
+                    }
+                    dp::u64 oldest = next_sequence_ - history_.size();
+                    dp::u64 target = qos_.policy == TopicPolicy::LatestValue ? next_sequence_ - 1 : oldest;
+                    if (cursor < target) {
+                        dropped_ += target - cursor;
+                        cursor = target;
+                    }
+                    record = history_[cursor - oldest];
+                    cursor++;
+                }
+                if (peer.stream->send(*record).is_err()) {
+                    echo::debug("topic subscriber went away");
+                    break;
+                }
+            }
+            peer.done = true;
+        }
+
+        // Caller holds mutex_
+        void reap_locked() {
+            for (auto it = peers_.begin(); it != peers_.end();) {
+                if ((*it)->done) {
+                    (*it)->thread.join();
+                    (*it)->stream->close();
+                    it = peers_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void accept_loop() {
+            while (running_) {
+                struct pollfd pfd = {listener_.native_handle(), POLLIN, 0};
+                if (::poll(&pfd, 1, 100) <= 0) {
+                    continue; // Bounded wait so close() is noticed
+                }
+                auto res = listener_.accept();
+                if (res.is_err()) {
+                    continue;
+                }
+                auto peer = std::make_unique<Peer>();
+                peer->stream = std::move(res.value());
+                Peer &ref = *peer;
+                std::lock_guard<std::mutex> lock(mutex_);
+                reap_locked();
+                dp::u64 cursor = next_sequence_; // Like every path: messages published from now on
+                peer->thread = std::thread([this, &ref, cursor]() { peer_loop(ref, cursor); });
+                peers_.push_back(std::move(peer));
+                echo::debug("topic ", endpoint_.name.c_str(), " has a new tcp subscriber");
+            }
+        }
+
+      public:
+        TopicPublisher()
+            : endpoint_{}, topic_id_(0), use_shm_(false), use_multicast_(false), use_tcp_(false), running_(false),
+              next_sequence_(0), dropped_(0) {}
+        ~TopicPublisher() { close(); }
+
+        TopicPublisher(const TopicPublisher &) = delete;
+        TopicPublisher &operator=(const TopicPublisher &) = delete;
+
+        // Start serving the topic on every path endpoint enables
+        dp::Res<void> open(const TopicEndpoint &endpoint, const TopicQos &qos = {}) {
+            if (running_) {
+                return dp::result::err(dp::Error::invalid_argument("topic already open"));
+            }
+            endpoint_ = endpoint;
+            qos_ = qos;
+            qos_.depth = qos.depth == 0 ? 1 : qos.depth;
+            topic_id_ = topic_id(endpoint.name);
+            use_shm_ = endpoint.shm;
+            use_multicast_ = !endpoint.multicast.group.empty();
+            use_tcp_ = !endpoint.tcp.host.empty();
+            if (!use_shm_ && !use_multicast_ && !use_tcp_) {
+                return dp::result::err(dp::Error::invalid_argument("topic has no transport"));
+            }
+
+            if (use_shm_) {
+                auto res = shm_.create(ShmEndpoint{endpoint.name, endpoint.shm_size});
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            if (use_tcp_) {
+                auto res = listener_.listen(endpoint.tcp);
+                if (res.is_err()) {
+                    shm_.close();
+                    return res;
+                }
+            }
+            next_sequence_ = 0;
+            running_ = true;
+            if (use_tcp_) {
+                accept_thread_ = std::thread([this]() { accept_loop(); });
+            }
+            echo::info("TopicPublisher serving ", endpoint.to_string());
+            return dp::result::ok();
+        }
+
+        // Publish a record whose first TOPIC_HEADER_SIZE bytes are reserved for the header
+        // Fails before sending anywhere if the record is too big for one of the enabled paths
+        dp::Res<void> publish_record(Message &&record) {
+            if (record.size() < TOPIC_HEADER_SIZE) {
+                return dp::result::err(dp::Error::invalid_argument("record has no header space"));
+            }
+            if (use_multicast_ && record.size() > UdpDatagram::MAX_UDP_SIZE) {
+                echo::warn("topic message too large for multicast: ", record.size());
+                return dp::result::err(dp::Error::invalid_argument("message too large for multicast"));
+            }
+            if (use_shm_ && record.size() > shm_.max_message_size()) {
+                return dp::result::err(dp::Error::invalid_argument("message exceeds topic ring size"));
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return dp::result::err(dp::Error::not_found("topic not open"));
+            }
+            auto id = encode_u32_be(topic_id_);
+            std::memcpy(record.data(), id.data(), 4);
+            auto high = encode_u32_be(static_cast<dp::u32>(next_sequence_ >> 32));
+            auto low = encode_u32_be(static_cast<dp::u32>(next_sequence_));
+            std::memcpy(record.data() + 4, high.data(), 4);
+            std::memcpy(record.data() + 8, low.data(), 4);
+            next_sequence_++;
+
+            dp::Res<void> result = dp::result::ok();
+            if (use_shm_) {
+                auto res = shm_.publish(record);
+                if (res.is_err()) {
+                    result = res;
+                }
+            }
+            if (use_multicast_) {
+                auto res = udp_.send_to_group(record, endpoint_.multicast);
+                if (res.is_err()) {
+                    result = res;
+                }
+            }
+            if (use_tcp_) {
+                history_.push_back(std::make_shared<const Message>(std::move(record)));
+                if (history_.size() > qos_.depth) {
+                    history_.pop_front();
+                }
+                cv_.notify_all();
+            }
+            return result;
+        }
+
+        dp::Res<void> publish(const Message &payload) {
+            Message record(TOPIC_HEADER_SIZE + payload.size());
+            if (!payload.empty()) {
+                std::memcpy(record.data() + TOPIC_HEADER_SIZE, payload.data(), payload.size());
+            }
+            return publish_record(std::move(record));
+        }
+
+        // Stop serving: TCP subscribers are disconnected, the SHM ring is unlinked
+        void close() {
+            if (!running_.exchange(false)) {
+                return;
+            }
+            cv_.notify_all();
+            if (accept_thread_.joinable()) {
+                accept_thread_.join();
+            }
+            for (auto &peer : peers_) {
+                peer->stream->close(); // Unblocks a sender stuck on a slow subscriber
+                if (peer->thread.joinable()) {
+                    peer->thread.join();
+                }
+            }
+            peers_.clear();
+            history_.clear();
+            listener_.close();
+            udp_.close();
+            shm_.close();
+            echo::debug("TopicPublisher closed ", endpoint_.name.c_str());
+        }
+
+        bool is_open() const { return running_; }
+
+        dp::u64 published_count() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return next_sequence_;
+        }
+
+        // Connected TCP subscribers
+        dp::usize subscriber_count() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            dp::usize count = 0;
+            for (const auto &peer : peers_) {
+                count += peer->done ? 0 : 1;
+            }
+            return count;
+        }
+
+        // Records TCP subscribers skipped because they fell behind
+        dp::u64 dropped_count() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return dropped_;
+        }
+    };
+
+    // Untyped receiving side of a topic; Subscriber<T> adds deserialization
+    // A reader thread drains the chosen path into a local queue bounded by the topic policy, so a consumer that
+    // stops calling recv() loses the oldest messages rather than backing up the transport.
+    class TopicSubscriber {
+      private:
+        TopicTransport transport_;
+        dp::u32 topic_id_;
+        TopicQos qos_;
+        ShmSubscriber shm_;
+        UdpDatagram udp_;
+        TcpStream tcp_;
+
+        std::atomic<bool> running_;
+        std::thread reader_;
+        std::mutex mutex_; // Guards everything below
+        std::condition_variable cv_;
+        std::deque<Message> queue_; // Payloads, header stripped
+        bool closed_;               // Path failed; recv() reports it once the queue is empty
+        bool synced_;
+        dp::u64 expected_; // Sequence the next record should carry
+        dp::u64 missed_;   // Never arrived (lapped in the ring, lost on the network, skipped by the publisher)
+        dp::u64 dropped_;  // Arrived but pushed out of the local queue
+
+        dp::Res<void> read_record(Message &record) {
+            switch (transport_) {
+            case TopicTransport::Shm:
+                return shm_.recv_into(record);
+            case TopicTransport::Multicast: {
+                auto res = udp_.recv_from_into(record);
+                return res.is_err() ? dp::Res<void>(dp::result::err(res.error())) : dp::Res<void>(dp::result::ok());
+            }
+            case TopicTransport::Tcp:
+                return tcp_.recv_into(record);
+            default:
+                return dp::result::err(dp::Error::invalid_argument("not subscribed"));
+            }
+        }
+
+        // Caller holds mutex_
+        void enqueue_locked(const Message &record) {
+            dp::u64 sequence = (static_cast<dp::u64>(decode_u32_be(record.data() + 4)) << 32) |
+                               decode_u32_be(record.data() + 8);
+            if (synced_ && sequence > expected_) {
+                missed_ += sequence - expected_;
+            }
+            expected_ = sequence + 1; // A publisher that restarted at 0 simply resyncs
+            synced_ = true;
+
+            dp::usize depth = qos_.policy == TopicPolicy::LatestValue ? 1 : qos_.depth;
+            while (queue_.size() >= depth) {
+                queue_.pop_front();
+                dropped_++;
+            }
+            queue_.emplace_back(record.begin() + TOPIC_HEADER_SIZE, record.end());
+            cv_.notify_one();
+        }
+
+        void reader_loop() {
+            Message record;
+            while (running_) {
+                auto res = read_record(record);
+                if (res.is_err()) {
+                    if (res.error().code == dp::Error::TIMEOUT) {
+                        continue;
+                    }
+                    echo::debug("topic subscription ended: ", res.error().message.c_str());
+                    break;
+                }
+                if (record.size() < TOPIC_HEADER_SIZE || decode_u32_be(record.data()) != topic_id_) {
+                    continue; // Another topic sharing the group, or not a topic record
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                enqueue_locked(record);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            cv_.notify_all();
+        }
+
+      public:
+        TopicSubscriber()
+            : transport_(TopicTransport::None), topic_id_(0), running_(false), closed_(true), synced_(false),
+              expected_(0), missed_(0), dropped_(0) {}
+        ~TopicSubscriber() { close(); }
+
+        TopicSubscriber(const TopicSubscriber &) = delete;
+        TopicSubscriber &operator=(const TopicSubscriber &) = delete;
+
+        // Subscribe on the cheapest path endpoint offers that is reachable from here
+        // The SHM ring only exists on the publisher's host, so attaching to it doubles as the locality test
+        dp::Res<void> open(const TopicEndpoint &endpoint, const TopicQos &qos = {}) {
+            if (running_) {
+                return dp::result::err(dp::Error::invalid_argument("already subscribed"));
+            }
+            qos_ = qos;
+            qos_.depth = qos.depth == 0 ? 1 : qos.depth;
+            topic_id_ = topic_id(endpoint.name);
+            transport_ = TopicTransport::None;
+
+            if (endpoint.shm && shm_.attach(ShmEndpoint{endpoint.name, 0}).is_ok()) {
+                shm_.set_recv_timeout(100);
+                transport_ = TopicTransport::Shm;
+            } else if (!endpoint.multicast.group.empty() && udp_.bind_group(endpoint.multicast).is_ok()) {
+                udp_.set_recv_timeout(100);
+                transport_ = TopicTransport::Multicast;
+            } else if (!endpoint.tcp.host.empty() && tcp_.connect(endpoint.tcp).is_ok()) {
+                tcp_.set_recv_timeout(100);
+                transport_ = TopicTransport::Tcp;
+            } else {
+                echo::error("no path to topic ", endpoint.to_string());
+                return dp::result::err(dp::Error::not_found("topic not reachable"));
+            }
+
+            closed_ = false;
+            synced_ = false;
+            running_ = true;
+            reader_ = std::thread([this]() { reader_loop(); });
+            echo::info("TopicSubscriber ", endpoint.name.c_str(), " via ", static_cast<int>(transport_));
+            return dp::result::ok();
+        }
+
+        // Next queued payload; timeout_ms 0 waits forever
+        dp::Res<void> recv_into(Message &payload, dp::u32 timeout_ms = 0) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready = [&] { return !queue_.empty() || closed_; };
+            if (timeout_ms == 0) {
+                cv_.wait(lock, ready);
+            } else if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+                return dp::result::err(dp::Error::timeout("recv timeout"));
+            }
+            if (queue_.empty()) {
+                return dp::result::err(dp::Error::io_error("subscription closed"));
+            }
+            payload = std::move(queue_.front());
+            queue_.pop_front();
+            return dp::result::ok();
+        }
+
+        dp::Res<Message> recv(dp::u32 timeout_ms = 0) {
+            Message payload;
+            auto res = recv_into(payload, timeout_ms);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(payload));
+        }
+
+        void close() {
+            running_ = false;
+            if (reader_.joinable()) {
+                reader_.join();
+            }
+            shm_.close();
+            udp_.close();
+            tcp_.close();
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            queue_.clear();
+            cv_.notify_all();
+        }
+
+        TopicTransport transport() const { return transport_; }
+
+        // Messages that never reached this subscriber
+        dp::u64 missed_count() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return missed_;
+        }
+
+        // Messages that reached it but were dropped by the queue policy before recv()
+        dp::u64 dropped_count() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return dropped_;
+        }
+    };
+
+    // Typed publisher: values go through Serializer<T>; a Message is published as is
+    template <typename T> class Publisher {
+      private:
+        TopicPublisher topic_;
+
+      public:
+        dp::Res<void> open(const TopicEndpoint &endpoint, const TopicQos &qos = {}) {
+            return topic_.open(endpoint, qos);
+        }
+
+        dp::Res<void> publish(const T &value) {
+            if constexpr (std::is_same_v<T, Message>) {
+                return topic_.publish(value);
+            } else {
+                Message body = Serializer<T>::serialize(value);
+                Message record(TOPIC_HEADER_SIZE + body.size());
+                if (!body.empty()) {
+                    std::memcpy(record.data() + TOPIC_HEADER_SIZE, body.data(), body.size());
+                }
+                return topic_.publish_record(std::move(record));
+            }
+        }
+
+        void close() { topic_.close(); }
+
+        TopicPublisher &raw() { return topic_; }
+    };
+
+    // Typed subscriber, the counterpart of Publisher<T>
+    template <typename T> class Subscriber {
+      private:
+        TopicSubscriber topic_;
+        Message payload_;
+
+      public:
+        dp::Res<void> open(const TopicEndpoint &endpoint, const TopicQos &qos = {}) {
+            return topic_.open(endpoint, qos);
+        }
+
+        // Next value; timeout_ms 0 waits forever
+        dp::Res<T> recv(dp::u32 timeout_ms = 0) {
+            auto res = topic_.recv_into(payload_, timeout_ms);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            if constexpr (std::is_same_v<T, Message>) {
+                return dp::result::ok(std::move(payload_));
+            } else {
+                return Serializer<T>::deserialize(payload_);
+            }
+        }
+
+        void close() { topic_.close(); }
+
+        TopicTransport transport() const { return topic_.transport(); }
+
+        TopicSubscriber &raw() { return topic_; }
+    };
+
+} // namespace netpipe
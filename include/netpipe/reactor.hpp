@@ -0,0 +1,264 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netpipe/common.hpp>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace netpipe {
+
+    // Readiness callback - receives the epoll event mask (EPOLLIN, EPOLLOUT, EPOLLHUP, EPOLLERR)
+    using ReadyHandler = std::function<void(dp::u32 events)>;
+
+    // Switch an fd between blocking and non-blocking mode
+    inline dp::Res<void> set_nonblocking(dp::i32 fd, bool enable) {
+        dp::i32 flags = ::fcntl(fd, F_GETFL, 0);
+        if (flags < 0) {
+            echo::error("fcntl F_GETFL failed: ", strerror(errno));
+            return dp::result::err(dp::Error::io_error("io error"));
+        }
+        flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        if (::fcntl(fd, F_SETFL, flags) < 0) {
+            echo::error("fcntl F_SETFL failed: ", strerror(errno));
+            return dp::result::err(dp::Error::io_error("io error"));
+        }
+        return dp::result::ok();
+    }
+
+    // Single-threaded epoll event loop
+    // Any number of fds are watched level-triggered and their callbacks run on the loop thread
+    // add/modify/remove belong to the loop thread (or to setup before run()); post() and stop() are thread-safe
+    class Reactor {
+      private:
+        struct Watch {
+            dp::u32 generation;
+            ReadyHandler handler;
+        };
+
+        dp::i32 epoll_fd_;
+        dp::i32 wake_fd_;
+        std::map<dp::i32, std::shared_ptr<Watch>> watches_;
+        dp::u32 next_generation_; // Tags events so a stale event for a closed-and-reused fd is dropped
+
+        std::mutex posted_mutex_;
+        std::vector<std::function<void()>> posted_;
+        std::atomic<bool> running_;
+        std::atomic<bool> stop_requested_; // Set by stop(); consumed when run() returns
+
+        static constexpr dp::u32 WAKE_GENERATION = 0;
+
+        static dp::u64 make_token(dp::i32 fd, dp::u32 generation) {
+            return (static_cast<dp::u64>(generation) << 32) | static_cast<dp::u32>(fd);
+        }
+
+        // Run everything queued by post() since the last pass
+        void run_posted() {
+            std::vector<std::function<void()>> tasks;
+            {
+                std::lock_guard<std::mutex> lock(posted_mutex_);
+                tasks.swap(posted_);
+            }
+            for (auto &task : tasks) {
+                task();
+            }
+        }
+
+        void wake() {
+            dp::u64 one = 1;
+            if (::write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+                echo::warn("reactor wake failed: ", strerror(errno));
+            }
+        }
+
+      public:
+        // Events collected per epoll_wait
+        static constexpr dp::usize MAX_EVENTS = 256;
+
+        Reactor() : epoll_fd_(-1), wake_fd_(-1), next_generation_(WAKE_GENERATION + 1), running_(false),
+                    stop_requested_(false) {
+            epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd_ < 0) {
+                echo::error("epoll_create1 failed: ", strerror(errno));
+                return;
+            }
+
+            wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd_ < 0) {
+                echo::error("eventfd failed: ", strerror(errno));
+                ::close(epoll_fd_);
+                epoll_fd_ = -1;
+                return;
+            }
+
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u64 = make_token(wake_fd_, WAKE_GENERATION);
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+            echo::trace("Reactor constructed epoll_fd=", epoll_fd_);
+        }
+
+        ~Reactor() {
+            if (wake_fd_ >= 0) {
+                ::close(wake_fd_);
+            }
+            if (epoll_fd_ >= 0) {
+                ::close(epoll_fd_);
+            }
+        }
+
+        Reactor(const Reactor &) = delete;
+        Reactor &operator=(const Reactor &) = delete;
+
+        // Whether the epoll instance was created
+        bool is_valid() const { return epoll_fd_ >= 0; }
+
+        // Start watching fd for events; handler runs on the loop thread each time fd is ready
+        dp::Res<void> add(dp::i32 fd, dp::u32 events, ReadyHandler handler) {
+            if (epoll_fd_ < 0) {
+                return dp::result::err(dp::Error::io_error("reactor not initialized"));
+            }
+            if (watches_.find(fd) != watches_.end()) {
+                echo::error("fd already watched: ", fd);
+                return dp::result::err(dp::Error::invalid_argument("fd already watched"));
+            }
+
+            auto watch = std::make_shared<Watch>(Watch{next_generation_++, std::move(handler)});
+            if (next_generation_ == WAKE_GENERATION) {
+                next_generation_++;
+            }
+
+            struct epoll_event ev = {};
+            ev.events = events;
+            ev.data.u64 = make_token(fd, watch->generation);
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                echo::error("epoll_ctl ADD failed for fd=", fd, ": ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+
+            watches_[fd] = std::move(watch);
+            echo::trace("reactor watching fd=", fd);
+            return dp::result::ok();
+        }
+
+        // Change the event mask of a watched fd
+        dp::Res<void> modify(dp::i32 fd, dp::u32 events) {
+            auto it = watches_.find(fd);
+            if (it == watches_.end()) {
+                return dp::result::err(dp::Error::not_found("fd not watched"));
+            }
+
+            struct epoll_event ev = {};
+            ev.events = events;
+            ev.data.u64 = make_token(fd, it->second->generation);
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+                echo::error("epoll_ctl MOD failed for fd=", fd, ": ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            return dp::result::ok();
+        }
+
+        // Stop watching fd - call before closing it; safe from inside the fd's own handler
+        void remove(dp::i32 fd) {
+            auto it = watches_.find(fd);
+            if (it == watches_.end()) {
+                return;
+            }
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            watches_.erase(it);
+            echo::trace("reactor stopped watching fd=", fd);
+        }
+
+        // Number of fds being watched
+        dp::usize watch_count() const { return watches_.size(); }
+
+        // Queue a task for the loop thread and wake it (thread-safe)
+        void post(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(posted_mutex_);
+                posted_.push_back(std::move(task));
+            }
+            wake();
+        }
+
+        // Wait up to timeout_ms (-1 blocks) and dispatch whatever became ready
+        // Returns the number of fd callbacks invoked
+        dp::Res<dp::usize> run_once(dp::i32 timeout_ms) {
+            if (epoll_fd_ < 0) {
+                return dp::result::err(dp::Error::io_error("reactor not initialized"));
+            }
+
+            run_posted();
+
+            struct epoll_event events[MAX_EVENTS];
+            dp::i32 n = ::epoll_wait(epoll_fd_, events, static_cast<dp::i32>(MAX_EVENTS), timeout_ms);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    return dp::result::ok(dp::usize(0));
+                }
+                echo::error("epoll_wait failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+
+            dp::usize dispatched = 0;
+            for (dp::i32 i = 0; i < n; ++i) {
+                dp::i32 fd = static_cast<dp::i32>(events[i].data.u64 & 0xFFFFFFFFu);
+                dp::u32 generation = static_cast<dp::u32>(events[i].data.u64 >> 32);
+
+                if (generation == WAKE_GENERATION) {
+                    dp::u64 count;
+                    while (::read(wake_fd_, &count, sizeof(count)) > 0) {
+                    }
+                    continue;
+                }
+
+                // An earlier callback in this batch may have removed (and even reused) the fd
+                auto it = watches_.find(fd);
+                if (it == watches_.end() || it->second->generation != generation) {
+                    continue;
+                }
+                auto watch = it->second; // Keeps the handler alive if it removes itself
+                watch->handler(events[i].events);
+                dispatched++;
+            }
+
+            run_posted();
+            return dp::result::ok(dispatched);
+        }
+
+        // Dispatch events until stop() is called
+        // A stop() issued before run() starts makes it return immediately
+        dp::Res<void> run() {
+            running_ = true;
+            echo::debug("reactor loop started");
+            dp::Res<void> result = dp::result::ok();
+            while (!stop_requested_) {
+                auto res = run_once(-1);
+                if (res.is_err()) {
+                    result = dp::result::err(res.error());
+                    break;
+                }
+            }
+            stop_requested_ = false;
+            running_ = false;
+            echo::debug("reactor loop stopped");
+            return result;
+        }
+
+        // Make run() return after the current pass (thread-safe)
+        void stop() {
+            stop_requested_ = true;
+            wake();
+        }
+
+        bool is_running() const { return running_; }
+    };
+
+} // namespace netpipe
@@ -1,53 +1,49 @@
 #pragma once
 
 #include <atomic>
-#include <condition_variable>
-#include <map>
-#include <mutex>
+#include <netpipe/remote/compression.hpp>
+#include <netpipe/remote/deadline.hpp>
+#include <netpipe/remote/executor.hpp>
+#include <netpipe/remote/latency.hpp>
 #include <netpipe/remote/metrics.hpp>
+#include <netpipe/remote/pending.hpp>
 #include <netpipe/remote/protocol.hpp>
 #include <netpipe/stream.hpp>
+#include <optional>
 #include <thread>
 
 namespace netpipe {
     namespace remote {
 
-        /// Pending request state
-        struct PendingRequest {
-            dp::u32 request_id;
-            std::mutex mutex;
-            std::condition_variable cv;
-            bool completed;
-            bool cancelled;
-            dp::Res<Message> result;
-
-            PendingRequest(dp::u32 id)
-                : request_id(id), completed(false), cancelled(false),
-                  result(dp::result::err(dp::Error::timeout("timeout"))) {}
-        };
-
         /// Remote with concurrent request support
         /// Allows multiple in-flight requests with out-of-order responses
         /// Thread-safe for concurrent calls from multiple threads
         class RemoteAsync {
           private:
             Stream &stream_;
-            std::atomic<dp::u32> next_request_id_;
-            std::map<dp::u32, std::shared_ptr<PendingRequest>> pending_requests_;
-            mutable std::mutex pending_mutex_;
+            PendingTable pending_;
             std::thread receiver_thread_;
             std::atomic<bool> running_;
-            dp::usize max_concurrent_requests_;
             RemoteMetrics metrics_;
             bool enable_metrics_;
+            PayloadCompressor compressor_;
+            std::atomic<dp::u32> spin_us_{0}; // Receiver spin budget (set_low_latency)
 
             /// Receiver thread function - processes incoming responses
             void receiver_loop() {
                 echo::debug("remote async receiver thread started");
 
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+
                 while (running_) {
-                    // Receive response
-                    auto recv_res = stream_.recv();
+                    dp::u32 spin_us = spin_us_.load(std::memory_order_relaxed);
+                    if (spin_us > 0) {
+                        spin_for_input(stream_, spin_us, running_);
+                    }
+
+                    // Receive response - payload arrives in the buffer handed to the waiting caller
+                    Message payload;
+                    auto recv_res = stream_.recv_split(header.data(), header.size(), payload);
                     if (recv_res.is_err()) {
                         // Timeout is expected - just continue to check running_ flag
                         if (recv_res.error().code == dp::Error::TIMEOUT) {
@@ -60,46 +56,34 @@ namespace netpipe {
                     }
 
                     // Decode response
-                    auto decode_res = decode_remote_message_v2(recv_res.value());
+                    auto decode_res = decode_remote_message_v2(header.data(), recv_res.value(), std::move(payload));
                     if (decode_res.is_err()) {
                         echo::error("remote async decode failed");
                         continue;
                     }
 
-                    auto decoded = decode_res.value();
+                    auto decoded = std::move(decode_res.value());
                     dp::u32 request_id = decoded.request_id;
 
                     echo::trace("remote async received response id=", request_id);
 
-                    // Find pending request
-                    std::shared_ptr<PendingRequest> pending;
-                    {
-                        std::lock_guard<std::mutex> lock(pending_mutex_);
-                        auto it = pending_requests_.find(request_id);
-                        if (it != pending_requests_.end()) {
-                            pending = it->second;
-                            pending_requests_.erase(it);
-                        }
+                    // Hand the result to the waiting caller
+                    bool matched;
+                    auto inflate_res = decompress_payload(decoded.flags, decoded.payload);
+                    if (inflate_res.is_err()) {
+                        matched = pending_.complete(request_id, dp::result::err(inflate_res.error()));
+                    } else if (decoded.type == MessageType::Error) {
+                        dp::String error_msg(reinterpret_cast<const char *>(decoded.payload.data()),
+                                             decoded.payload.size());
+                        matched =
+                            pending_.complete(request_id, dp::result::err(dp::Error::io_error(error_msg.c_str())));
+                    } else {
+                        matched = pending_.complete(request_id, dp::result::ok(std::move(decoded.payload)));
                     }
 
-                    if (!pending) {
+                    if (!matched) {
                         echo::warn("received response for unknown request_id: ", request_id);
-                        continue;
                     }
-
-                    // Set result
-                    {
-                        std::lock_guard<std::mutex> lock(pending->mutex);
-                        if (decoded.type == MessageType::Error) {
-                            dp::String error_msg(reinterpret_cast<const char *>(decoded.payload.data()),
-                                                 decoded.payload.size());
-                            pending->result = dp::result::err(dp::Error::io_error(error_msg.c_str()));
-                        } else {
-                            pending->result = dp::result::ok(std::move(decoded.payload));
-                        }
-                        pending->completed = true;
-                    }
-                    pending->cv.notify_one();
                 }
 
                 echo::debug("remote async receiver thread stopped");
@@ -107,8 +91,7 @@ namespace netpipe {
 
           public:
             explicit RemoteAsync(Stream &stream, dp::usize max_concurrent = 100, bool enable_metrics = false)
-                : stream_(stream), next_request_id_(0), running_(true), max_concurrent_requests_(max_concurrent),
-                  enable_metrics_(enable_metrics) {
+                : stream_(stream), pending_(max_concurrent), running_(true), enable_metrics_(enable_metrics) {
                 echo::trace("RemoteAsync constructed, max_concurrent=", max_concurrent, " metrics=", enable_metrics);
                 // Set receive timeout to allow receiver thread to check running_ flag
                 stream_.set_recv_timeout(100); // 100ms timeout
@@ -120,16 +103,7 @@ namespace netpipe {
                 running_ = false;
 
                 // Wake up all pending requests
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    for (auto &pair : pending_requests_) {
-                        std::lock_guard<std::mutex> req_lock(pair.second->mutex);
-                        pair.second->result = dp::result::err(dp::Error::io_error("RemoteAsync destroyed"));
-                        pair.second->completed = true;
-                        pair.second->cv.notify_one();
-                    }
-                    pending_requests_.clear();
-                }
+                pending_.fail_all("RemoteAsync destroyed");
 
                 // Close stream to unblock receiver thread
                 stream_.close();
@@ -144,44 +118,38 @@ namespace netpipe {
             /// Thread-safe - can be called from multiple threads
             dp::Res<Message> call(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000) {
                 // Start metrics tracking if enabled
-                std::unique_ptr<MetricsTracker> tracker;
+                std::optional<MetricsTracker> tracker;
                 if (enable_metrics_) {
-                    tracker = std::make_unique<MetricsTracker>(metrics_, request.size());
+                    tracker.emplace(metrics_, request.size(), method_id);
                 }
 
-                // Check concurrent request limit
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    if (pending_requests_.size() >= max_concurrent_requests_) {
-                        echo::error("max concurrent requests reached: ", max_concurrent_requests_);
-                        if (tracker)
-                            tracker->failure();
-                        return dp::result::err(dp::Error::io_error("max concurrent requests reached"));
-                    }
+                // Inside a handler, never wait past the deadline of the request being served
+                dp::u32 budget = DeadlineScope::clamp(timeout_ms);
+                if (budget == 0 && timeout_ms != 0) {
+                    if (tracker)
+                        tracker->timeout();
+                    return dp::result::err(dp::Error::timeout("deadline exceeded"));
                 }
+                timeout_ms = budget;
 
-                // Generate request ID (thread-safe)
-                dp::u32 request_id = next_request_id_.fetch_add(1);
-                echo::trace("remote async call id=", request_id, " method=", method_id);
-
-                // Create pending request
-                auto pending = std::make_shared<PendingRequest>(request_id);
-
-                // Register pending request
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    pending_requests_[request_id] = pending;
+                // Claim a pending slot (also enforces the concurrency limit)
+                auto slot = pending_.acquire();
+                if (slot.is_err()) {
+                    echo::error("max concurrent requests reached: ", pending_.limit());
+                    if (tracker)
+                        tracker->failure();
+                    return dp::result::err(slot.error());
                 }
+                dp::u32 request_id = slot.value();
+                echo::trace("remote async call id=", request_id, " method=", method_id);
 
-                // Encode and send request
-                Message remote_request = encode_remote_message_v2(request_id, method_id, request, MessageType::Request);
-                auto send_res = stream_.send(remote_request);
+                // Send request (header and payload as separate buffers)
+                dp::u16 flags = MessageFlags::None;
+                const Message &wire = compressor_.apply(request, flags);
+                auto send_res =
+                    send_remote_message_v2(stream_, request_id, method_id, wire, MessageType::Request, flags);
                 if (send_res.is_err()) {
-                    // Remove from pending
-                    {
-                        std::lock_guard<std::mutex> lock(pending_mutex_);
-                        pending_requests_.erase(request_id);
-                    }
+                    pending_.release(request_id);
                     echo::error("remote async send failed");
                     if (tracker)
                         tracker->failure();
@@ -189,47 +157,115 @@ namespace netpipe {
                 }
 
                 // Wait for response with timeout
-                {
-                    std::unique_lock<std::mutex> lock(pending->mutex);
-                    auto timeout = std::chrono::milliseconds(timeout_ms);
-                    if (!pending->cv.wait_for(lock, timeout, [&] { return pending->completed; })) {
-                        // Timeout - remove from pending
-                        {
-                            std::lock_guard<std::mutex> plock(pending_mutex_);
-                            pending_requests_.erase(request_id);
-                        }
-                        echo::error("remote async call timeout id=", request_id);
-                        if (tracker)
-                            tracker->timeout();
-                        return dp::result::err(dp::Error::timeout("call timeout"));
-                    }
+                auto result = pending_.wait(request_id, timeout_ms);
+                if (result.is_err() && result.error().code == dp::Error::TIMEOUT) {
+                    echo::error("remote async call timeout id=", request_id);
+                    if (tracker)
+                        tracker->timeout();
+                    return result;
                 }
 
                 echo::trace("remote async call completed id=", request_id);
 
                 // Track success/failure
                 if (tracker) {
-                    if (pending->result.is_ok()) {
-                        tracker->success(pending->result.value().size());
+                    if (result.is_ok()) {
+                        tracker->success(result.value().size());
                     } else {
                         tracker->failure();
                     }
                 }
 
-                return pending->result;
+                return result;
             }
 
-            /// Get number of pending requests
-            dp::usize pending_count() const {
-                std::lock_guard<std::mutex> lock(pending_mutex_);
-                return pending_requests_.size();
+            /// Coroutine form of call(): `co_await remote.call_async(...)`, or `.get()` from plain code
+            /// No thread blocks while the call is in flight. The receiver thread resumes the coroutine when the
+            /// response arrives, so code after the co_await runs there and must not block on this Remote.
+            /// A timeout resumes it from the shared TimerService thread instead.
+            /// request is only read before the first suspension.
+            Task<dp::Res<Message>> call_async(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000) {
+                std::optional<MetricsTracker> tracker;
+                if (enable_metrics_) {
+                    tracker.emplace(metrics_, request.size(), method_id);
+                }
+
+                dp::u32 budget = DeadlineScope::clamp(timeout_ms); // Read before the first suspension
+                if (budget == 0 && timeout_ms != 0) {
+                    if (tracker)
+                        tracker->timeout();
+                    co_return dp::result::err(dp::Error::timeout("deadline exceeded"));
+                }
+                timeout_ms = budget;
+
+                auto slot = pending_.acquire();
+                if (slot.is_err()) {
+                    if (tracker)
+                        tracker->failure();
+                    co_return dp::result::err(slot.error());
+                }
+                dp::u32 request_id = slot.value();
+                echo::trace("remote async call_async id=", request_id, " method=", method_id);
+
+                dp::u16 flags = MessageFlags::None;
+                const Message &wire = compressor_.apply(request, flags);
+                auto send_res =
+                    send_remote_message_v2(stream_, request_id, method_id, wire, MessageType::Request, flags);
+                if (send_res.is_err()) {
+                    pending_.release(request_id);
+                    echo::error("remote async send failed");
+                    if (tracker)
+                        tracker->failure();
+                    co_return dp::result::err(send_res.error());
+                }
+                auto result = co_await pending_.wait_async(request_id, timeout_ms);
+                if (tracker) {
+                    if (result.is_ok()) {
+                        tracker->success(result.value().size());
+                    } else if (result.error().code == dp::Error::TIMEOUT) {
+                        tracker->timeout();
+                    } else {
+                        tracker->failure();
+                    }
+                }
+                co_return result;
             }
 
+            /// Get number of pending requests
+            dp::usize pending_count() const { return pending_.in_flight(); }
+
             /// Get maximum concurrent requests
-            dp::usize max_concurrent() const { return max_concurrent_requests_; }
+            dp::usize max_concurrent() const { return pending_.limit(); }
 
             /// Set maximum concurrent requests
-            void set_max_concurrent(dp::usize max) { max_concurrent_requests_ = max; }
+            /// The slot table is sized at construction, so this can lower the limit but not raise it past that
+            void set_max_concurrent(dp::usize max) { pending_.set_limit(max); }
+
+            /// Compress requests of at least threshold bytes with codec (nullptr turns it off); set before calling
+            void set_compression(std::shared_ptr<const Codec> codec,
+                                 dp::usize threshold = DEFAULT_COMPRESSION_THRESHOLD) {
+                compressor_ = PayloadCompressor(std::move(codec), threshold);
+            }
+
+            /// Spin the receiver, busy poll the socket and pin the receiver thread (see LowLatencyOptions)
+            /// RemoteAsync runs no handlers, so handler_cpus and inline_handlers are ignored. Returns the first
+            /// setting that could not be applied; the others still are.
+            dp::Res<void> set_low_latency(const LowLatencyOptions &options) {
+                dp::Res<void> result = dp::result::ok();
+                spin_us_.store(options.spin_us, std::memory_order_relaxed);
+                if (options.busy_poll_us > 0) {
+                    dp::i32 fd = stream_.native_handle();
+                    result = fd < 0 ? dp::result::err(dp::Error::invalid_argument("stream has no socket to busy poll"))
+                                    : set_busy_poll(fd, options.busy_poll_us);
+                }
+                if (options.receiver_cpu >= 0) {
+                    auto pinned = pin_thread(receiver_thread_.native_handle(), options.receiver_cpu);
+                    if (pinned.is_err() && result.is_ok()) {
+                        result = std::move(pinned);
+                    }
+                }
+                return result;
+            }
 
             /// Get metrics (if enabled)
             const RemoteMetrics &get_metrics() const { return metrics_; }
@@ -246,33 +282,12 @@ namespace netpipe {
             bool cancel(dp::u32 request_id) {
                 echo::trace("remote async cancel request id=", request_id);
 
-                // Find and mark pending request as cancelled
-                std::shared_ptr<PendingRequest> pending;
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    auto it = pending_requests_.find(request_id);
-                    if (it == pending_requests_.end()) {
-                        echo::warn("cancel: request_id not found: ", request_id);
-                        return false; // Request not found (already completed or never existed)
-                    }
-                    pending = it->second;
-                }
-
-                // Try to mark as cancelled
-                {
-                    std::lock_guard<std::mutex> lock(pending->mutex);
-                    if (pending->completed) {
-                        echo::trace("cancel: request already completed id=", request_id);
-                        return false; // Already completed
-                    }
-                    pending->cancelled = true;
-                    pending->result = dp::result::err(dp::Error::io_error("request cancelled"));
-                    pending->completed = true;
+                // Complete the waiting call with an error - fails if already completed or never existed
+                if (!pending_.complete(request_id, dp::result::err(dp::Error::io_error("request cancelled")))) {
+                    echo::warn("cancel: request_id not waiting: ", request_id);
+                    return false;
                 }
 
-                // Notify waiting thread
-                pending->cv.notify_one();
-
                 // Send cancellation message to server (best effort)
                 Message cancel_msg = encode_remote_message_v2(request_id, 0, Message(), MessageType::Cancel);
                 auto send_res = stream_.send(cancel_msg);
@@ -280,12 +295,6 @@ namespace netpipe {
                     echo::warn("cancel: failed to send cancel message id=", request_id);
                 }
 
-                // Remove from pending
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    pending_requests_.erase(request_id);
-                }
-
                 echo::trace("remote async cancelled request id=", request_id);
                 return true;
             }
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <netpipe/remote/protocol.hpp>
+#include <unordered_map>
+
+namespace netpipe {
+    namespace remote {
+
+        /// A stored answer: the response payload exactly as it went on the wire, with its flags
+        struct CachedResponse {
+            Message payload; // Already compressed when the flags say so
+            dp::u16 flags;   // MessageFlags::Compressed or None
+        };
+
+        /// Server-side cache of successful responses for idempotent methods
+        /// Entries are keyed by method id and a hash of the request payload (the request bytes are kept too, so a
+        /// hash collision is a miss, never a wrong answer). The cache is bounded by bytes and evicts the least
+        /// recently used entry first; an entry also expires ttl_ms after it was stored. A hit hands out the
+        /// encoded response payload - after compression - so the handler, the executor queue and the codec are
+        /// all skipped; only the frame header is written again, since it carries the caller's request id.
+        /// Requests are keyed as they arrived, so callers only cache requests that came uncompressed.
+        /// Thread-safe: lookups come from receiver threads, stores from handler threads.
+        class ResponseCache {
+          public:
+            static constexpr dp::usize DEFAULT_CAPACITY = 16 * 1024 * 1024;
+            /// Bookkeeping charged per entry on top of its request and response bytes
+            static constexpr dp::usize ENTRY_OVERHEAD = 96;
+
+            explicit ResponseCache(dp::usize capacity_bytes = DEFAULT_CAPACITY) : capacity_(capacity_bytes) {}
+
+            ResponseCache(const ResponseCache &) = delete;
+            ResponseCache &operator=(const ResponseCache &) = delete;
+
+            /// Cache the responses of method_id; ttl_ms 0 keeps them until evicted or invalidated
+            /// Only for methods whose answer depends on nothing but the request
+            void enable(dp::u32 method_id, dp::u32 ttl_ms = 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ttls_[method_id] = ttl_ms;
+                methods_.store(ttls_.size(), std::memory_order_release);
+            }
+
+            /// Stop caching method_id and drop what is stored for it
+            void disable(dp::u32 method_id) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ttls_.erase(method_id);
+                methods_.store(ttls_.size(), std::memory_order_release);
+                generation_.fetch_add(1, std::memory_order_release);
+                drop_method(method_id);
+            }
+
+            /// Whether responses of method_id are cached
+            bool enabled(dp::u32 method_id) const {
+                if (methods_.load(std::memory_order_acquire) == 0) {
+                    return false; // Common case: no cached methods, no lock
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                return ttls_.count(method_id) != 0;
+            }
+
+            /// Stored response for this request, or nullptr
+            std::shared_ptr<const CachedResponse> lookup(dp::u32 method_id, const Message &request) {
+                if (methods_.load(std::memory_order_acquire) == 0) {
+                    return nullptr;
+                }
+                Key key{method_id, hash(request)};
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = index_.find(key);
+                if (it == index_.end()) {
+                    if (ttls_.count(method_id)) {
+                        misses_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    return nullptr;
+                }
+                Entry &entry = *it->second;
+                if (entry.request != request) {
+                    misses_.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                if (Clock::now() >= entry.expires) {
+                    erase(it->second);
+                    misses_.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                lru_.splice(lru_.begin(), lru_, it->second);
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return entry.response;
+            }
+
+            /// Invalidation count; read it before running the handler and hand it to store()
+            dp::u64 generation() const { return generation_.load(std::memory_order_acquire); }
+
+            /// Keep response (the wire payload, with its flags) as the answer to request
+            /// Ignored when method_id is not cached, the entry alone would exceed the capacity, or an invalidation
+            /// happened since generation was read - the handler may have seen the data from before it.
+            void store(dp::u32 method_id, const Message &request, const Message &response, dp::u16 response_flags,
+                       dp::u64 generation) {
+                if (methods_.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+                Key key{method_id, hash(request)};
+                dp::usize bytes = request.size() + response.size() + ENTRY_OVERHEAD;
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto ttl = ttls_.find(method_id);
+                if (ttl == ttls_.end() || bytes > capacity_ || generation != generation_.load()) {
+                    return;
+                }
+                auto existing = index_.find(key);
+                if (existing != index_.end()) {
+                    erase(existing->second); // Newer answer, or a colliding request that takes the slot over
+                }
+
+                Entry entry;
+                entry.key = key;
+                entry.request = request;
+                entry.response = std::make_shared<const CachedResponse>(
+                    CachedResponse{response, static_cast<dp::u16>(response_flags & MessageFlags::Compressed)});
+                entry.bytes = bytes;
+                entry.expires = ttl->second == 0 ? Clock::time_point::max()
+                                                 : Clock::now() + std::chrono::milliseconds(ttl->second);
+                lru_.push_front(std::move(entry));
+                index_[key] = lru_.begin();
+                bytes_ += bytes;
+                evict_to(capacity_);
+            }
+
+            /// Drop every stored response of method_id; returns how many there were
+            dp::usize invalidate(dp::u32 method_id) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                generation_.fetch_add(1, std::memory_order_release);
+                return drop_method(method_id);
+            }
+
+            /// Drop the stored response to one request; false when there was none
+            bool invalidate(dp::u32 method_id, const Message &request) {
+                Key key{method_id, hash(request)};
+                std::lock_guard<std::mutex> lock(mutex_);
+                generation_.fetch_add(1, std::memory_order_release);
+                auto it = index_.find(key);
+                if (it == index_.end() || it->second->request != request) {
+                    return false;
+                }
+                erase(it->second);
+                return true;
+            }
+
+            /// Drop every stored response (the cached methods stay cached)
+            void clear() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                generation_.fetch_add(1, std::memory_order_release);
+                lru_.clear();
+                index_.clear();
+                bytes_ = 0;
+            }
+
+            /// Change the byte bound, evicting down to it right away
+            void set_capacity(dp::usize capacity_bytes) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                capacity_ = capacity_bytes;
+                evict_to(capacity_);
+            }
+
+            dp::usize capacity() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return capacity_;
+            }
+
+            /// Bytes charged for the stored entries (see ENTRY_OVERHEAD)
+            dp::usize bytes() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return bytes_;
+            }
+
+            dp::usize size() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return lru_.size();
+            }
+
+            dp::u64 hits() const { return hits_.load(std::memory_order_relaxed); }
+            dp::u64 misses() const { return misses_.load(std::memory_order_relaxed); }
+            dp::u64 evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+          private:
+            using Clock = std::chrono::steady_clock;
+
+            struct Key {
+                dp::u32 method_id;
+                dp::u64 hash;
+                bool operator==(const Key &other) const { return method_id == other.method_id && hash == other.hash; }
+            };
+
+            struct KeyHash {
+                dp::usize operator()(const Key &key) const {
+                    return static_cast<dp::usize>(key.hash ^ (key.method_id * 0x9e3779b97f4a7c15ull));
+                }
+            };
+
+            struct Entry {
+                Key key;
+                Message request;
+                std::shared_ptr<const CachedResponse> response;
+                dp::usize bytes = 0;
+                Clock::time_point expires;
+            };
+
+            using Lru = std::list<Entry>; // Most recently used first
+
+            // 64-bit FNV-1a over 8-byte words: a few cycles per word, fine next to running a handler
+            static dp::u64 hash(const Message &request) {
+                dp::u64 h = 14695981039346656037ull;
+                const dp::u8 *data = request.data();
+                dp::usize size = request.size();
+                dp::usize i = 0;
+                for (; i + 8 <= size; i += 8) {
+                    dp::u64 word;
+                    std::memcpy(&word, data + i, 8);
+                    h = (h ^ word) * 1099511628211ull;
+                }
+                for (; i < size; i++) {
+                    h = (h ^ data[i]) * 1099511628211ull;
+                }
+                return h ^ size;
+            }
+
+            // Callers hold mutex_
+            void erase(Lru::iterator it) {
+                bytes_ -= it->bytes;
+                index_.erase(it->key);
+                lru_.erase(it);
+            }
+
+            void evict_to(dp::usize limit) {
+                while (bytes_ > limit && !lru_.empty()) {
+                    erase(std::prev(lru_.end()));
+                    evictions_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            dp::usize drop_method(dp::u32 method_id) {
+                dp::usize dropped = 0;
+                for (auto it = lru_.begin(); it != lru_.end();) {
+                    auto next = std::next(it);
+                    if (it->key.method_id == method_id) {
+                        erase(it);
+                        dropped++;
+                    }
+                    it = next;
+                }
+                return dropped;
+            }
+
+            mutable std::mutex mutex_;
+            dp::usize capacity_;
+            dp::usize bytes_ = 0;
+            Lru lru_;
+            std::unordered_map<Key, Lru::iterator, KeyHash> index_;
+            std::unordered_map<dp::u32, dp::u32> ttls_; // Cached methods and their ttl_ms
+            std::atomic<dp::usize> methods_{0};         // ttls_.size(), read without the lock
+            std::atomic<dp::u64> generation_{0};        // Bumped by every invalidation
+
+            std::atomic<dp::u64> hits_{0};
+            std::atomic<dp::u64> misses_{0};
+            std::atomic<dp::u64> evictions_{0};
+        };
+
+    } // namespace remote
+} // namespace netpipe
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <netpipe/common.hpp>
 
 namespace netpipe {
@@ -15,5 +17,61 @@ namespace netpipe {
         /// Takes a request message and returns a response message (cannot return errors)
         using LegacyHandler = std::function<Message(const Message &)>;
 
+        /// Scheduling class of a request: picks the handler queue, the send order and what is shed first
+        /// Normal is what every call gets unless the method or the call says otherwise.
+        enum class Priority : dp::u8 {
+            Low = 0,     // Bulk work: first to be rejected when the handler queue fills
+            Normal = 1,  // Default
+            High = 2,    // Control traffic (heartbeats): runs ahead of Normal work
+            Critical = 3 // Emergency stop and the like: admitted while anything below it would be shed
+        };
+
+        constexpr dp::usize PRIORITY_LEVELS = 4;
+
+        /// Mutex handed out in arrival order (ticket lock), highest priority class first
+        /// Guards a connection's writer when several kinds of traffic share it: a thread sending a long run of
+        /// stream chunks cannot keep re-taking the lock ahead of an RPC that is already waiting, as std::mutex
+        /// allows. Within a class waiters are served in arrival order; a waiting higher class goes before any
+        /// lower one, so lower classes only wait out the message being written, never a queue of them.
+        /// Meets BasicLockable, so std::lock_guard works with it (lock() takes the Normal class).
+        class FairMutex {
+          public:
+            void lock() { lock(Priority::Normal); }
+
+            void lock(Priority priority) {
+                dp::usize level = static_cast<dp::usize>(priority);
+                std::unique_lock<std::mutex> lock(mutex_);
+                dp::u64 ticket = next_ticket_[level]++;
+                cv_.wait(lock, [&] { return !held_ && now_serving_[level] == ticket && !waiting_above(level); });
+                held_ = true;
+                now_serving_[level]++;
+            }
+
+            void unlock() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    held_ = false;
+                }
+                cv_.notify_all();
+            }
+
+          private:
+            // A class has waiters while it handed out more tickets than it has served
+            bool waiting_above(dp::usize level) const {
+                for (dp::usize above = level + 1; above < PRIORITY_LEVELS; above++) {
+                    if (next_ticket_[above] != now_serving_[above]) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool held_ = false;
+            dp::u64 next_ticket_[PRIORITY_LEVELS] = {};
+            dp::u64 now_serving_[PRIORITY_LEVELS] = {};
+        };
+
     } // namespace remote
 } // namespace netpipe
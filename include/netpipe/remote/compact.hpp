@@ -0,0 +1,482 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <netpipe/remote/protocol.hpp>
+#include <netpipe/stream.hpp>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Compact wire profile (PROTOCOL_VERSION_COMPACT) for links where every byte costs airtime
+        /// Carries the same fields as a V2 header in 2-14 bytes instead of 16:
+        ///   [marker:1][flags:varint]?[request_id:varint | id_delta:zigzag varint][method_id:varint]?[payload:N]
+        /// marker = CompactBits::Marker | the bits below | type (low nibble). The version is implied and the length
+        /// is the rest of the message, which works because every Stream keeps message boundaries.
+        /// Varints are LEB128: 7 bits per byte, least significant group first.
+        namespace CompactBits {
+            constexpr dp::u8 Marker = 0x80;      // Set on every compact frame; V2 frames start with 0x02
+            constexpr dp::u8 IdDelta = 0x40;     // request_id is a zigzag difference to the previous frame's
+            constexpr dp::u8 SameMethod = 0x20;  // method_id equals the previous frame's and is omitted
+            constexpr dp::u8 HasFlags = 0x10;    // V2 flags follow as a varint (omitted when zero)
+            constexpr dp::u8 TypeMask = 0x0F;
+            constexpr dp::u8 ControlType = 0x0F; // Not a Remote message: a profile hello, see CompactStream
+        } // namespace CompactBits
+
+        /// Largest compact header: marker, flags (3 bytes for 16 bits), request_id and method_id (5 bytes each)
+        constexpr dp::usize COMPACT_HEADER_MAX = 1 + 3 + 5 + 5;
+
+        /// Hello announcing the compact profile: [Marker | ControlType][version][is_reply]
+        constexpr dp::usize COMPACT_HELLO_SIZE = 3;
+
+        /// Header fields a compact frame carries
+        struct CompactHeader {
+            MessageType type;
+            dp::u16 flags;
+            dp::u32 request_id;
+            dp::u32 method_id;
+        };
+
+        /// Previous header in one direction, the base for delta compression
+        /// Sender and receiver must see the same frames in the same order - only use deltas on a reliable,
+        /// ordered stream. Over a lossy link one lost frame shifts every id after it.
+        struct CompactDelta {
+            dp::u32 request_id = 0;
+            dp::u32 method_id = 0;
+            bool valid = false;
+        };
+
+        inline dp::usize write_varint(dp::u8 *out, dp::u32 value) {
+            dp::usize n = 0;
+            while (value >= 0x80) {
+                out[n++] = static_cast<dp::u8>(value | 0x80);
+                value >>= 7;
+            }
+            out[n++] = static_cast<dp::u8>(value);
+            return n;
+        }
+
+        inline dp::usize varint_size(dp::u32 value) {
+            dp::usize n = 1;
+            while (value >= 0x80) {
+                value >>= 7;
+                n++;
+            }
+            return n;
+        }
+
+        /// Read a varint from [p, end); advances p, false when truncated or longer than 32 bits
+        inline bool read_varint(const dp::u8 *&p, const dp::u8 *end, dp::u32 &value) {
+            value = 0;
+            for (dp::u32 shift = 0; shift < 35; shift += 7) {
+                if (p >= end) {
+                    return false;
+                }
+                dp::u8 byte = *p++;
+                value |= static_cast<dp::u32>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Encode a compact header into out (COMPACT_HEADER_MAX bytes); returns its size
+        /// @param delta Previous header in this direction; nullptr encodes every field in full
+        inline dp::usize encode_compact_header(const CompactHeader &header, dp::u8 *out, CompactDelta *delta) {
+            dp::u8 marker = CompactBits::Marker | (static_cast<dp::u8>(header.type) & CompactBits::TypeMask);
+            dp::usize n = 1;
+            if (header.flags != MessageFlags::None) {
+                marker |= CompactBits::HasFlags;
+                n += write_varint(out + n, header.flags);
+            }
+
+            dp::u32 id_delta = 0;
+            bool use_delta = false;
+            if (delta && delta->valid) {
+                auto diff = static_cast<dp::i32>(header.request_id - delta->request_id);
+                id_delta = (static_cast<dp::u32>(diff) << 1) ^ static_cast<dp::u32>(diff >> 31);
+                use_delta = varint_size(id_delta) < varint_size(header.request_id);
+            }
+            if (use_delta) {
+                marker |= CompactBits::IdDelta;
+                n += write_varint(out + n, id_delta);
+            } else {
+                n += write_varint(out + n, header.request_id);
+            }
+
+            if (delta && delta->valid && delta->method_id == header.method_id) {
+                marker |= CompactBits::SameMethod;
+            } else {
+                n += write_varint(out + n, header.method_id);
+            }
+
+            if (delta) {
+                *delta = CompactDelta{header.request_id, header.method_id, true};
+            }
+            out[0] = marker;
+            return n;
+        }
+
+        /// Decode the compact header at the start of a frame of length bytes; returns the header size
+        /// @param delta Previous header received in this direction, updated to this one
+        inline dp::Res<dp::usize> decode_compact_header(const dp::u8 *data, dp::usize length, CompactHeader &out,
+                                                        CompactDelta &delta) {
+            if (length < 2 || !(data[0] & CompactBits::Marker)) {
+                return dp::result::err(dp::Error::invalid_argument("not a compact frame"));
+            }
+            dp::u8 marker = data[0];
+            if ((marker & CompactBits::TypeMask) == CompactBits::ControlType) {
+                return dp::result::err(dp::Error::invalid_argument("compact control frame"));
+            }
+            if ((marker & (CompactBits::IdDelta | CompactBits::SameMethod)) && !delta.valid) {
+                echo::error("compact frame refers to a previous header that was never received");
+                return dp::result::err(dp::Error::invalid_argument("compact delta without base"));
+            }
+
+            const dp::u8 *p = data + 1;
+            const dp::u8 *end = data + length;
+            dp::u32 value = 0;
+            out.type = static_cast<MessageType>(marker & CompactBits::TypeMask);
+            out.flags = MessageFlags::None;
+            if (marker & CompactBits::HasFlags) {
+                if (!read_varint(p, end, value) || value > 0xFFFF) {
+                    return dp::result::err(dp::Error::invalid_argument("compact flags truncated"));
+                }
+                out.flags = static_cast<dp::u16>(value);
+            }
+            if (!read_varint(p, end, value)) {
+                return dp::result::err(dp::Error::invalid_argument("compact request id truncated"));
+            }
+            if (marker & CompactBits::IdDelta) {
+                auto diff = static_cast<dp::i32>((value >> 1) ^ (0u - (value & 1)));
+                out.request_id = delta.request_id + static_cast<dp::u32>(diff);
+            } else {
+                out.request_id = value;
+            }
+            if (marker & CompactBits::SameMethod) {
+                out.method_id = delta.method_id;
+            } else if (!read_varint(p, end, out.method_id)) {
+                return dp::result::err(dp::Error::invalid_argument("compact method id truncated"));
+            }
+
+            delta = CompactDelta{out.request_id, out.method_id, true};
+            return dp::result::ok(static_cast<dp::usize>(p - data));
+        }
+
+        struct CompactOptions {
+            bool delta = false;                // Delta-compress ids against the previous frame (ordered streams only)
+            dp::u32 hello_interval_ms = 250;   // negotiate() repeats its hello this often until answered
+        };
+
+        /// Stream decorator that speaks the compact profile to a peer that agreed to it, V2 to anyone else
+        /// Put it between Remote and a constrained transport (a DatagramStream over LoraDatagram, a serial link)
+        /// on both ends and call negotiate() before handing it to Remote. Outgoing V2 frames are re-encoded once
+        /// the peer's hello has arrived; incoming frames are accepted in either encoding and always handed up as
+        /// V2, so Remote itself is unchanged. A peer without CompactStream drops the hello as an undecodable
+        /// frame and keeps receiving plain V2.
+        class CompactStream : public Stream {
+          private:
+            std::unique_ptr<Stream> owned_;
+            Stream *inner_;
+            CompactOptions options_;
+            std::atomic<bool> peer_compact_; // Peer announced the profile: send compact
+            std::atomic<dp::u32> recv_timeout_ms_;
+            std::atomic<dp::u64> header_bytes_saved_;
+
+            std::mutex send_mutex_; // Every write to inner_; compact frames go out in the order their deltas were taken
+            CompactDelta tx_delta_;
+            dp::Vector<iovec> tx_parts_;
+
+            std::mutex recv_mutex_;
+            CompactDelta rx_delta_;
+            std::deque<Message> stash_; // Frames that arrived while negotiate() waited for the hello
+            std::atomic<dp::usize> stashed_{0}; // stash_.size(), for has_pending_input() without recv_mutex_
+            Message raw_;
+
+            dp::Res<void> send_hello(bool reply) {
+                dp::u8 hello[COMPACT_HELLO_SIZE] = {CompactBits::Marker | CompactBits::ControlType,
+                                                    PROTOCOL_VERSION_COMPACT, static_cast<dp::u8>(reply ? 1 : 0)};
+                Message frame(hello, hello + COMPACT_HELLO_SIZE);
+                std::lock_guard<std::mutex> lock(send_mutex_);
+                return inner_->send(frame);
+            }
+
+            static bool is_hello(const Message &msg) {
+                return msg.size() == COMPACT_HELLO_SIZE && msg[0] == (CompactBits::Marker | CompactBits::ControlType);
+            }
+
+            // A hello from the peer turns compact sending on; one that is not itself a reply gets answered
+            void handle_hello(const Message &msg) {
+                if (msg[1] != PROTOCOL_VERSION_COMPACT) {
+                    echo::warn("peer offered compact profile version ", static_cast<int>(msg[1]), ", staying on V2");
+                    return;
+                }
+                if (!peer_compact_.exchange(true)) {
+                    echo::debug("peer speaks the compact profile");
+                }
+                if (msg[2] == 0) {
+                    auto res = send_hello(true);
+                    if (res.is_err()) {
+                        echo::warn("compact hello reply failed");
+                    }
+                }
+            }
+
+            // Next data frame from the peer, hellos consumed; caller holds recv_mutex_
+            dp::Res<void> next_frame(Message &msg) {
+                while (true) {
+                    if (!stash_.empty()) {
+                        msg = std::move(stash_.front());
+                        stash_.pop_front();
+                        stashed_.store(stash_.size(), std::memory_order_release);
+                    } else {
+                        auto res = inner_->recv_into(msg);
+                        if (res.is_err()) {
+                            return res;
+                        }
+                    }
+                    if (is_hello(msg)) {
+                        handle_hello(msg);
+                        continue;
+                    }
+                    return dp::result::ok();
+                }
+            }
+
+            static bool is_compact(const Message &msg) { return !msg.empty() && (msg[0] & CompactBits::Marker); }
+
+            // Rebuild the V2 header of a received compact frame; returns the offset of its payload in raw
+            // false when it does not decode - the frame is dropped, as Remote drops bad V2 frames
+            bool expand_header(const Message &raw, dp::Array<dp::u8, V2_HEADER_SIZE> &header, dp::usize &offset) {
+                CompactHeader fields{};
+                auto res = decode_compact_header(raw.data(), raw.size(), fields, rx_delta_);
+                if (res.is_err()) {
+                    echo::warn("dropping undecodable compact frame: ", res.error().message.c_str());
+                    return false;
+                }
+                offset = res.value();
+                header = encode_remote_header_v2(fields.request_id, fields.method_id,
+                                                 static_cast<dp::u32>(raw.size() - offset), fields.type, fields.flags);
+                return true;
+            }
+
+            // Re-encode a V2 frame given as parts (parts[0] holds the whole header); caller holds send_mutex_
+            dp::Res<void> send_compact_locked(std::span<const iovec> parts) {
+                DecodedMessageView view{};
+                auto header_res = decode_remote_header_v2(static_cast<const dp::u8 *>(parts[0].iov_base),
+                                                          parts[0].iov_len, view);
+                if (header_res.is_err() || static_cast<dp::u8>(view.type) >= CompactBits::ControlType) {
+                    return inner_->send_iov(parts);
+                }
+
+                dp::u8 compact[COMPACT_HEADER_MAX];
+                CompactHeader fields{view.type, view.flags, view.request_id, view.method_id};
+                dp::usize size = encode_compact_header(fields, compact, options_.delta ? &tx_delta_ : nullptr);
+                header_bytes_saved_.fetch_add(V2_HEADER_SIZE - size, std::memory_order_relaxed);
+
+                tx_parts_.clear();
+                tx_parts_.push_back({compact, size});
+                if (parts[0].iov_len > V2_HEADER_SIZE) {
+                    tx_parts_.push_back({static_cast<dp::u8 *>(parts[0].iov_base) + V2_HEADER_SIZE,
+                                         parts[0].iov_len - V2_HEADER_SIZE});
+                }
+                for (dp::usize i = 1; i < parts.size(); i++) {
+                    tx_parts_.push_back(parts[i]);
+                }
+                return inner_->send_iov(std::span<const iovec>(tx_parts_.data(), tx_parts_.size()));
+            }
+
+          public:
+            /// Wrap a stream owned elsewhere; it must outlive this one
+            explicit CompactStream(Stream &inner, CompactOptions options = {})
+                : inner_(&inner), options_(options), peer_compact_(false), recv_timeout_ms_(0),
+                  header_bytes_saved_(0) {}
+
+            /// Wrap and own a stream, e.g. one returned by accept()
+            explicit CompactStream(std::unique_ptr<Stream> inner, CompactOptions options = {})
+                : owned_(std::move(inner)), inner_(owned_.get()), options_(options), peer_compact_(false),
+                  recv_timeout_ms_(0), header_bytes_saved_(0) {}
+
+            /// Offer the compact profile and wait up to timeout_ms for the peer's hello
+            /// Returns true once the peer agreed; false means it did not answer and frames stay V2 - a hello that
+            /// arrives later still switches the profile on. Call before a Remote starts receiving on this stream.
+            dp::Res<bool> negotiate(dp::u32 timeout_ms = 1000) {
+                std::lock_guard<std::mutex> lock(recv_mutex_);
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+                dp::u32 interval = options_.hello_interval_ms == 0 ? timeout_ms : options_.hello_interval_ms;
+                Message msg;
+                while (!peer_compact_) {
+                    auto now = std::chrono::steady_clock::now();
+                    if (now >= deadline) {
+                        break;
+                    }
+                    auto res = send_hello(false);
+                    if (res.is_err()) {
+                        inner_->set_recv_timeout(recv_timeout_ms_);
+                        return dp::result::err(res.error());
+                    }
+                    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+                    auto wait = static_cast<dp::u32>(left < interval ? left : interval);
+                    auto wait_until = now + std::chrono::milliseconds(wait);
+                    inner_->set_recv_timeout(wait == 0 ? 1 : wait);
+                    while (!peer_compact_ && std::chrono::steady_clock::now() < wait_until) {
+                        auto recv_res = inner_->recv_into(msg);
+                        if (recv_res.is_err()) {
+                            if (recv_res.error().code == dp::Error::TIMEOUT) {
+                                break;
+                            }
+                            inner_->set_recv_timeout(recv_timeout_ms_);
+                            return dp::result::err(recv_res.error());
+                        }
+                        if (is_hello(msg)) {
+                            handle_hello(msg);
+                        } else {
+                            stash_.push_back(std::move(msg)); // Peer is already talking; keep it for recv()
+                            stashed_.store(stash_.size(), std::memory_order_release);
+                            msg = Message();
+                        }
+                    }
+                }
+                inner_->set_recv_timeout(recv_timeout_ms_);
+                if (!peer_compact_) {
+                    echo::info("peer did not answer the compact profile hello, using V2");
+                }
+                return dp::result::ok(peer_compact_.load());
+            }
+
+            /// Whether outgoing frames currently use the compact profile
+            bool compact_active() const { return peer_compact_.load(std::memory_order_acquire); }
+
+            /// Header bytes not sent thanks to the compact profile
+            dp::u64 header_bytes_saved() const { return header_bytes_saved_.load(std::memory_order_relaxed); }
+
+            Stream &inner() { return *inner_; }
+
+            dp::Res<void> connect(const TcpEndpoint &endpoint) override { return inner_->connect(endpoint); }
+
+            dp::Res<void> listen(const TcpEndpoint &endpoint) override { return inner_->listen(endpoint); }
+
+            /// Accepted connections get their own CompactStream with the same options
+            dp::Res<std::unique_ptr<Stream>> accept() override {
+                auto res = inner_->accept();
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                std::unique_ptr<Stream> wrapped = std::make_unique<CompactStream>(std::move(res.value()), options_);
+                return dp::result::ok(std::move(wrapped));
+            }
+
+            dp::Res<void> send(const Message &msg) override {
+                std::lock_guard<std::mutex> lock(send_mutex_);
+                if (!compact_active() || msg.size() < V2_HEADER_SIZE) {
+                    return inner_->send(msg);
+                }
+                iovec part = {const_cast<dp::u8 *>(msg.data()), msg.size()};
+                return send_compact_locked(std::span<const iovec>(&part, 1));
+            }
+
+            dp::Res<void> send_iov(std::span<const iovec> parts) override {
+                if (compact_active() && !parts.empty() && parts[0].iov_len < V2_HEADER_SIZE) {
+                    return Stream::send_iov(parts); // Header split across parts: gather, then send()
+                }
+                std::lock_guard<std::mutex> lock(send_mutex_);
+                if (!compact_active() || parts.empty()) {
+                    return inner_->send_iov(parts);
+                }
+                return send_compact_locked(parts);
+            }
+
+            dp::Res<Message> recv() override {
+                Message msg;
+                auto res = recv_into(msg);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                return dp::result::ok(std::move(msg));
+            }
+
+            dp::Res<void> recv_into(Message &msg) override {
+                std::lock_guard<std::mutex> lock(recv_mutex_);
+                while (true) {
+                    auto res = next_frame(raw_);
+                    if (res.is_err()) {
+                        return res;
+                    }
+                    if (!is_compact(raw_)) {
+                        msg.assign(raw_.begin(), raw_.end()); // V2 from the peer
+                        return dp::result::ok();
+                    }
+                    dp::Array<dp::u8, V2_HEADER_SIZE> header;
+                    dp::usize offset = 0;
+                    if (!expand_header(raw_, header, offset)) {
+                        continue;
+                    }
+                    msg.resize(V2_HEADER_SIZE + raw_.size() - offset);
+                    std::memcpy(msg.data(), header.data(), V2_HEADER_SIZE);
+                    if (raw_.size() > offset) {
+                        std::memcpy(msg.data() + V2_HEADER_SIZE, raw_.data() + offset, raw_.size() - offset);
+                    }
+                    return dp::result::ok();
+                }
+            }
+
+            dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) override {
+                std::lock_guard<std::mutex> lock(recv_mutex_);
+                while (true) {
+                    auto res = next_frame(raw_);
+                    if (res.is_err()) {
+                        return dp::result::err(res.error());
+                    }
+                    if (!is_compact(raw_)) {
+                        // V2 from the peer: split as the inner stream would
+                        dp::usize head = raw_.size() < prefix_len ? raw_.size() : prefix_len;
+                        if (head > 0) {
+                            std::memcpy(prefix, raw_.data(), head);
+                        }
+                        rest.assign(raw_.begin() + static_cast<dp::isize>(head), raw_.end());
+                        return dp::result::ok(head);
+                    }
+                    dp::Array<dp::u8, V2_HEADER_SIZE> header;
+                    dp::usize offset = 0;
+                    if (!expand_header(raw_, header, offset)) {
+                        continue;
+                    }
+                    // The expanded message is header + raw_[offset..]; split it at prefix_len
+                    dp::usize total = V2_HEADER_SIZE + raw_.size() - offset;
+                    dp::usize head = total < prefix_len ? total : prefix_len;
+                    dp::usize from_header = head < V2_HEADER_SIZE ? head : V2_HEADER_SIZE;
+                    std::memcpy(prefix, header.data(), from_header);
+                    if (head > from_header) {
+                        std::memcpy(prefix + from_header, raw_.data() + offset, head - from_header);
+                    }
+                    if (from_header < V2_HEADER_SIZE) {
+                        rest.assign(header.begin() + static_cast<dp::isize>(from_header), header.end());
+                        rest.insert(rest.end(), raw_.begin() + static_cast<dp::isize>(offset), raw_.end());
+                    } else {
+                        rest.assign(raw_.begin() + static_cast<dp::isize>(offset + head - from_header), raw_.end());
+                    }
+                    return dp::result::ok(head);
+                }
+            }
+
+            // Not under recv_mutex_: a recv() blocked on inner_ holds it
+            bool has_pending_input() const override {
+                return stashed_.load(std::memory_order_acquire) > 0 || inner_->has_pending_input();
+            }
+
+            dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
+                recv_timeout_ms_ = timeout_ms;
+                return inner_->set_recv_timeout(timeout_ms);
+            }
+
+            void close() override { inner_->close(); }
+
+            bool is_connected() const override { return inner_->is_connected(); }
+        };
+
+    } // namespace remote
+} // namespace netpipe
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netpipe/budget.hpp>
+#include <netpipe/common.hpp>
+#include <netpipe/remote/protocol.hpp>
+#include <new>
+#include <utility>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Codec ids carried in the first byte of a compressed payload
+        namespace CodecId {
+            constexpr dp::u8 LZ4 = 1;  // Built in (Lz4Codec)
+            constexpr dp::u8 ZSTD = 2; // Reserved for an application-provided zstd adapter
+        } // namespace CodecId
+
+        /// Compressed payload layout (MessageFlags::Compressed): [codec:1][original_length:4][data:N]
+        constexpr dp::usize COMPRESSED_PREFIX_SIZE = 5;
+
+        /// Payloads below this size go out uncompressed unless a Remote is told otherwise
+        constexpr dp::usize DEFAULT_COMPRESSION_THRESHOLD = 1024;
+
+        /// Payload compression algorithm
+        /// Both directions must be safe to call from several threads at once - keep per-call state on the
+        /// stack or in thread_local contexts, so no message pays for an allocation or a lock.
+        class Codec {
+          public:
+            virtual ~Codec() = default;
+
+            /// Id written on the wire; the receiver looks it up with find_codec()
+            virtual dp::u8 id() const = 0;
+
+            /// Worst-case output size for length input bytes
+            virtual dp::usize max_compressed_size(dp::usize length) const = 0;
+
+            /// Compress length bytes into dst (capacity bytes); returns the compressed size
+            virtual dp::Res<dp::usize> compress(const dp::u8 *src, dp::usize length, dp::u8 *dst,
+                                                dp::usize capacity) const = 0;
+
+            /// Decompress into exactly original bytes at dst
+            virtual dp::Res<void> decompress(const dp::u8 *src, dp::usize length, dp::u8 *dst,
+                                             dp::usize original) const = 0;
+        };
+
+        /// LZ4 block format, greedy single-pass matcher - same stream liblz4's LZ4_decompress_safe reads
+        /// The 16 KB hash table lives on the stack, so compressing never allocates and needs no shared state
+        class Lz4Codec : public Codec {
+          private:
+            static constexpr dp::usize MIN_MATCH = 4;
+            static constexpr dp::usize LAST_LITERALS = 5; // Format rule: the block ends with >= 5 literals
+            static constexpr dp::usize MF_LIMIT = 12;     // ...and no match starts in the last 12 bytes
+            static constexpr dp::usize MAX_OFFSET = 65535;
+            static constexpr dp::u32 HASH_BITS = 12;
+
+            static dp::u32 read32(const dp::u8 *p) {
+                dp::u32 v;
+                std::memcpy(&v, p, 4);
+                return v;
+            }
+            static dp::u32 hash(dp::u32 sequence) { return (sequence * 2654435761u) >> (32 - HASH_BITS); }
+
+            // A length field past its 4-bit nibble continues in 255-valued bytes
+            static dp::u8 *write_length(dp::u8 *op, dp::usize length) {
+                while (length >= 255) {
+                    *op++ = 255;
+                    length -= 255;
+                }
+                *op++ = static_cast<dp::u8>(length);
+                return op;
+            }
+
+            static bool read_length(const dp::u8 *&ip, const dp::u8 *iend, dp::usize &length) {
+                dp::u8 byte;
+                do {
+                    if (ip >= iend) {
+                        return false;
+                    }
+                    byte = *ip++;
+                    length += byte;
+                } while (byte == 255);
+                return true;
+            }
+
+            // Literals then (unless last) a match; false when dst is too small
+            static bool emit(dp::u8 *&op, dp::u8 *oend, const dp::u8 *literals, dp::usize literal_length,
+                             dp::usize offset, dp::usize match_length, bool last) {
+                dp::usize needed = 1 + literal_length / 255 + 1 + literal_length;
+                if (!last) {
+                    needed += 2 + match_length / 255 + 1;
+                }
+                if (static_cast<dp::usize>(oend - op) < needed) {
+                    return false;
+                }
+                dp::u8 *token = op++;
+                if (literal_length >= 15) {
+                    *token = 15 << 4;
+                    op = write_length(op, literal_length - 15);
+                } else {
+                    *token = static_cast<dp::u8>(literal_length << 4);
+                }
+                std::memcpy(op, literals, literal_length);
+                op += literal_length;
+                if (last) {
+                    return true;
+                }
+                *op++ = static_cast<dp::u8>(offset & 0xFF);
+                *op++ = static_cast<dp::u8>(offset >> 8);
+                dp::usize code = match_length - MIN_MATCH;
+                if (code >= 15) {
+                    *token |= 15;
+                    op = write_length(op, code - 15);
+                } else {
+                    *token |= static_cast<dp::u8>(code);
+                }
+                return true;
+            }
+
+          public:
+            dp::u8 id() const override { return CodecId::LZ4; }
+
+            dp::usize max_compressed_size(dp::usize length) const override { return length + length / 255 + 16; }
+
+            dp::Res<dp::usize> compress(const dp::u8 *src, dp::usize length, dp::u8 *dst,
+                                        dp::usize capacity) const override {
+                dp::u32 table[1u << HASH_BITS] = {};
+                const dp::u8 *ip = src;
+                const dp::u8 *anchor = src;
+                const dp::u8 *end = src + length;
+                dp::u8 *op = dst;
+                dp::u8 *oend = dst + capacity;
+
+                if (length > MF_LIMIT) {
+                    const dp::u8 *mf_limit = end - MF_LIMIT;
+                    const dp::u8 *match_limit = end - LAST_LITERALS;
+                    while (ip < mf_limit) {
+                        dp::u32 sequence = read32(ip);
+                        dp::u32 h = hash(sequence);
+                        const dp::u8 *ref = src + table[h];
+                        table[h] = static_cast<dp::u32>(ip - src);
+                        if (ref >= ip || static_cast<dp::usize>(ip - ref) > MAX_OFFSET || read32(ref) != sequence) {
+                            ip++;
+                            continue;
+                        }
+
+                        // Grow the match backwards into pending literals, then forwards
+                        while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                            ip--;
+                            ref--;
+                        }
+                        const dp::u8 *match_end = ip + MIN_MATCH;
+                        const dp::u8 *ref_end = ref + MIN_MATCH;
+                        while (match_end < match_limit && *match_end == *ref_end) {
+                            match_end++;
+                            ref_end++;
+                        }
+
+                        if (!emit(op, oend, anchor, static_cast<dp::usize>(ip - anchor),
+                                  static_cast<dp::usize>(ip - ref), static_cast<dp::usize>(match_end - ip), false)) {
+                            return dp::result::err(dp::Error::invalid_argument("lz4 output buffer too small"));
+                        }
+                        ip = match_end;
+                        anchor = ip;
+                    }
+                }
+
+                if (!emit(op, oend, anchor, static_cast<dp::usize>(end - anchor), 0, 0, true)) {
+                    return dp::result::err(dp::Error::invalid_argument("lz4 output buffer too small"));
+                }
+                return dp::result::ok(static_cast<dp::usize>(op - dst));
+            }
+
+            dp::Res<void> decompress(const dp::u8 *src, dp::usize length, dp::u8 *dst,
+                                     dp::usize original) const override {
+                const dp::u8 *ip = src;
+                const dp::u8 *iend = src + length;
+                dp::u8 *op = dst;
+                dp::u8 *oend = dst + original;
+                auto corrupt = []() { return dp::result::err(dp::Error::invalid_argument("corrupt lz4 block")); };
+
+                while (ip < iend) {
+                    dp::u8 token = *ip++;
+                    dp::usize literal_length = token >> 4;
+                    if (literal_length == 15 && !read_length(ip, iend, literal_length)) {
+                        return corrupt();
+                    }
+                    if (literal_length > static_cast<dp::usize>(iend - ip) ||
+                        literal_length > static_cast<dp::usize>(oend - op)) {
+                        return corrupt();
+                    }
+                    std::memcpy(op, ip, literal_length);
+                    ip += literal_length;
+                    op += literal_length;
+                    if (ip == iend) {
+                        break; // Last sequence has no match
+                    }
+
+                    if (iend - ip < 2) {
+                        return corrupt();
+                    }
+                    dp::usize offset = static_cast<dp::usize>(ip[0]) | (static_cast<dp::usize>(ip[1]) << 8);
+                    ip += 2;
+                    if (offset == 0 || offset > static_cast<dp::usize>(op - dst)) {
+                        return corrupt();
+                    }
+                    dp::usize match_length = token & 15;
+                    if (match_length == 15 && !read_length(ip, iend, match_length)) {
+                        return corrupt();
+                    }
+                    match_length += MIN_MATCH;
+                    if (match_length > static_cast<dp::usize>(oend - op)) {
+                        return corrupt();
+                    }
+                    // Byte-wise: a match may overlap the bytes it produces (offset < length repeats a run)
+                    const dp::u8 *ref = op - offset;
+                    for (dp::usize i = 0; i < match_length; i++) {
+                        op[i] = ref[i];
+                    }
+                    op += match_length;
+                }
+
+                if (op != oend) {
+                    return corrupt();
+                }
+                return dp::result::ok();
+            }
+        };
+
+        namespace detail {
+            struct CodecRegistry {
+                std::mutex mutex;
+                std::map<dp::u8, std::shared_ptr<const Codec>> codecs;
+
+                CodecRegistry() { codecs[CodecId::LZ4] = std::make_shared<Lz4Codec>(); }
+            };
+
+            inline CodecRegistry &codec_registry() {
+                static CodecRegistry registry;
+                return registry;
+            }
+
+            /// Per-thread output buffer for compressed payloads; reused so steady-state sends do not allocate
+            inline Message &compression_scratch() {
+                static thread_local Message scratch;
+                return scratch;
+            }
+        } // namespace detail
+
+        /// Make a codec available for decoding by its id (e.g. a zstd adapter); replaces any previous one
+        inline void register_codec(std::shared_ptr<const Codec> codec) {
+            auto &registry = detail::codec_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.codecs[codec->id()] = std::move(codec);
+        }
+
+        /// Codec registered under id, or nullptr
+        inline std::shared_ptr<const Codec> find_codec(dp::u8 id) {
+            auto &registry = detail::codec_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.codecs.find(id);
+            return it == registry.codecs.end() ? nullptr : it->second;
+        }
+
+        /// Outgoing compression settings of a Remote: which codec, and from what payload size on
+        class PayloadCompressor {
+          public:
+            PayloadCompressor() = default;
+            PayloadCompressor(std::shared_ptr<const Codec> codec, dp::usize threshold)
+                : codec_(std::move(codec)), threshold_(threshold) {}
+
+            bool enabled() const { return codec_ != nullptr; }
+            dp::usize threshold() const { return threshold_; }
+
+            /// Payload to put on the wire: compressed into scratch (adding MessageFlags::Compressed to flags)
+            /// when it is at least threshold bytes and actually shrinks, otherwise payload itself
+            const Message &apply(const Message &payload, dp::u16 &flags, Message &scratch) const {
+                if (!codec_ || payload.size() < threshold_ || payload.size() > MAX_MESSAGE_SIZE) {
+                    return payload;
+                }
+                dp::usize bound = COMPRESSED_PREFIX_SIZE + codec_->max_compressed_size(payload.size());
+                if (scratch.size() < bound) {
+                    scratch.resize(bound); // Grows once to the largest payload seen on this thread
+                }
+                auto res = codec_->compress(payload.data(), payload.size(), scratch.data() + COMPRESSED_PREFIX_SIZE,
+                                            bound - COMPRESSED_PREFIX_SIZE);
+                if (res.is_err() || COMPRESSED_PREFIX_SIZE + res.value() >= payload.size()) {
+                    return payload; // Incompressible - not worth the receiver's time
+                }
+                scratch[0] = codec_->id();
+                auto original = encode_u32_be(static_cast<dp::u32>(payload.size()));
+                std::memcpy(scratch.data() + 1, original.data(), 4);
+                scratch.resize(COMPRESSED_PREFIX_SIZE + res.value());
+                flags |= MessageFlags::Compressed;
+                return scratch;
+            }
+
+            /// apply() with the calling thread's scratch buffer - the result is valid until this thread's next call
+            const Message &apply(const Message &payload, dp::u16 &flags) const {
+                return apply(payload, flags, detail::compression_scratch());
+            }
+
+          private:
+            std::shared_ptr<const Codec> codec_;
+            dp::usize threshold_ = 0;
+        };
+
+        /// Most a payload may claim to grow when inflated; LZ4 cannot pass 255:1, so a larger claim is a forged
+        /// original length (a decompression bomb) rather than data
+        constexpr dp::u64 MAX_COMPRESSION_RATIO = 1024;
+
+        /// Undo compression of a received payload in place (no-op without MessageFlags::Compressed)
+        /// The result is built in spare and swapped in, so a caller that keeps spare around reuses both buffers
+        /// The original length comes from the peer: it is checked against MAX_MESSAGE_SIZE and
+        /// MAX_COMPRESSION_RATIO, then reserved in budget (when given and enabled) before spare grows, and lease
+        /// holds that reservation for as long as the caller keeps the inflated payload.
+        inline dp::Res<void> decompress_payload(dp::u16 &flags, Message &payload, Message &spare, MemoryBudget *budget,
+                                                BudgetLease &lease) {
+            if (!(flags & MessageFlags::Compressed)) {
+                return dp::result::ok();
+            }
+            if (payload.size() < COMPRESSED_PREFIX_SIZE) {
+                return dp::result::err(dp::Error::invalid_argument("compressed payload truncated"));
+            }
+            auto codec = find_codec(payload[0]);
+            if (!codec) {
+                echo::error("no codec registered for id ", static_cast<int>(payload[0]));
+                return dp::result::err(dp::Error::invalid_argument("unknown compression codec"));
+            }
+            dp::u32 original = decode_u32_be(payload.data() + 1);
+            if (original > MAX_MESSAGE_SIZE) {
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+            dp::u64 compressed = payload.size() - COMPRESSED_PREFIX_SIZE;
+            if (original > compressed * MAX_COMPRESSION_RATIO) {
+                echo::error("compressed payload of ", compressed, " bytes claims ", original, " bytes inflated");
+                return dp::result::err(dp::Error::invalid_argument("compression ratio out of range"));
+            }
+            if (budget && budget->enabled() && original > 0) {
+                auto reserve_res = budget->reserve(original, budget->wait_ms());
+                if (reserve_res.is_err()) {
+                    return reserve_res;
+                }
+                lease = BudgetLease(budget, original);
+            }
+
+            try {
+                spare.resize(original);
+            } catch (const std::bad_alloc &) {
+                echo::error("failed to allocate ", original, " bytes to inflate a payload");
+                lease.release();
+                return dp::result::err(dp::Error::invalid_argument("memory allocation failed"));
+            }
+            auto res = codec->decompress(payload.data() + COMPRESSED_PREFIX_SIZE, static_cast<dp::usize>(compressed),
+                                         spare.data(), original);
+            if (res.is_err()) {
+                lease.release();
+                return res;
+            }
+            std::swap(payload, spare);
+            flags &= static_cast<dp::u16>(~MessageFlags::Compressed);
+            return dp::result::ok();
+        }
+
+        inline dp::Res<void> decompress_payload(dp::u16 &flags, Message &payload, Message &spare) {
+            BudgetLease uncounted;
+            return decompress_payload(flags, payload, spare, nullptr, uncounted);
+        }
+
+        inline dp::Res<void> decompress_payload(dp::u16 &flags, Message &payload) {
+            Message spare;
+            return decompress_payload(flags, payload, spare);
+        }
+
+    } // namespace remote
+} // namespace netpipe
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <netpipe/common.hpp>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Deadline of the request whose handler runs on this thread
+        /// Servers open one around each handler; calls the handler makes inherit what is left of it, so a
+        /// nested call never keeps running after the caller waiting on it has given up.
+        class DeadlineScope {
+          public:
+            using Clock = std::chrono::steady_clock;
+
+            explicit DeadlineScope(Clock::time_point deadline) : previous_(slot()) { slot() = deadline; }
+            ~DeadlineScope() { slot() = previous_; }
+
+            DeadlineScope(const DeadlineScope &) = delete;
+            DeadlineScope &operator=(const DeadlineScope &) = delete;
+
+            /// Deadline in effect on this thread; Clock::time_point::max() when there is none
+            static Clock::time_point current() { return slot(); }
+
+            /// Clamp a call timeout to the time left on this thread's deadline
+            /// Returns 0 when the deadline has already passed (and timeout_ms was not 0)
+            static dp::u32 clamp(dp::u32 timeout_ms) {
+                Clock::time_point deadline = slot();
+                if (deadline == Clock::time_point::max()) {
+                    return timeout_ms;
+                }
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                if (left <= 0) {
+                    return 0;
+                }
+                return static_cast<dp::u64>(left) < timeout_ms ? static_cast<dp::u32>(left) : timeout_ms;
+            }
+
+            /// Local deadline for a request that just arrived with budget_ms left; 0 means no deadline
+            static Clock::time_point from_budget(dp::u32 budget_ms) {
+                if (budget_ms == 0) {
+                    return Clock::time_point::max();
+                }
+                return Clock::now() + std::chrono::milliseconds(budget_ms);
+            }
+
+            static bool expired(Clock::time_point deadline) {
+                return deadline != Clock::time_point::max() && Clock::now() >= deadline;
+            }
+
+          private:
+            static Clock::time_point &slot() {
+                static thread_local Clock::time_point deadline = Clock::time_point::max();
+                return deadline;
+            }
+
+            Clock::time_point previous_;
+        };
+
+    } // namespace remote
+} // namespace netpipe
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <netpipe/common.hpp>
+#include <netpipe/remote/common.hpp>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Where Remote runs request handlers
+        /// One executor can be shared by many Remote instances (pass it as a std::shared_ptr)
+        class Executor {
+          public:
+            virtual ~Executor() = default;
+
+            /// Queue a task; returns false if the executor is full or shut down
+            virtual bool submit(std::function<void()> task) = 0;
+
+            /// Queue a task of a priority class; executors without classes treat every task alike
+            virtual bool submit(std::function<void()> task, Priority priority) {
+                (void)priority;
+                return submit(std::move(task));
+            }
+
+            /// Tasks currently running
+            virtual dp::usize active_count() const = 0;
+
+            /// Tasks waiting for a thread
+            virtual dp::usize queued_count() const = 0;
+
+            /// Run everything already queued, then stop the threads
+            virtual void shutdown() = 0;
+        };
+
+        /// Queued tasks at which a class is turned away, for an executor sized for max_queue
+        /// Low is shed at half the queue and Normal at max_queue, as before classes existed; High and Critical
+        /// get headroom past it, so a queue full of bulk work still takes an emergency stop.
+        inline dp::usize admission_limit(dp::usize max_queue, Priority priority) {
+            switch (priority) {
+            case Priority::Low:
+                return max_queue / 2;
+            case Priority::Normal:
+                return max_queue;
+            case Priority::High:
+                return max_queue + (max_queue / 8 > 0 ? max_queue / 8 : 1);
+            case Priority::Critical:
+                return max_queue + (max_queue / 4 > 1 ? max_queue / 4 : 2);
+            }
+            return max_queue;
+        }
+
+        /// Simple thread pool for handler execution
+        /// Fixed-size pool with one FIFO per priority class; workers take from the highest non-empty one
+        class ThreadPool : public Executor {
+          private:
+            std::vector<std::thread> workers_;
+            std::queue<std::function<void()>> tasks_[PRIORITY_LEVELS];
+            dp::usize queued_; // Across every class, guarded by queue_mutex_
+            mutable std::mutex queue_mutex_;
+            std::condition_variable condition_;
+            std::atomic<bool> stop_;
+            std::atomic<dp::usize> active_tasks_;
+            dp::usize max_queue_size_;
+
+          public:
+            explicit ThreadPool(dp::usize num_threads = 10, dp::usize max_queue_size = 1000)
+                : queued_(0), stop_(false), active_tasks_(0), max_queue_size_(max_queue_size) {
+                echo::trace("ThreadPool created with ", num_threads, " threads, max_queue=", max_queue_size);
+
+                for (dp::usize i = 0; i < num_threads; ++i) {
+                    workers_.emplace_back([this] {
+                        while (true) {
+                            std::function<void()> task;
+                            {
+                                std::unique_lock<std::mutex> lock(queue_mutex_);
+                                condition_.wait(lock, [this] { return stop_ || queued_ > 0; });
+
+                                if (stop_ && queued_ == 0) {
+                                    return;
+                                }
+
+                                for (dp::usize level = PRIORITY_LEVELS; level-- > 0;) {
+                                    if (!tasks_[level].empty()) {
+                                        task = std::move(tasks_[level].front());
+                                        tasks_[level].pop();
+                                        queued_--;
+                                        break;
+                                    }
+                                }
+                            }
+
+                            if (task) {
+                                active_tasks_++;
+                                task();
+                                active_tasks_--;
+                            }
+                        }
+                    });
+                }
+            }
+
+            ~ThreadPool() override { shutdown(); }
+
+            /// Submit a task to the pool
+            /// Returns false if queue is full
+            bool submit(std::function<void()> task) override { return submit(std::move(task), Priority::Normal); }
+
+            /// Submit a task of a priority class
+            /// Returns false once the queue holds admission_limit() tasks for this class
+            bool submit(std::function<void()> task, Priority priority) override {
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex_);
+                    if (queued_ >= admission_limit(max_queue_size_, priority)) {
+                        echo::warn("ThreadPool queue full (", queued_, "/", max_queue_size_, ") for priority ",
+                                   static_cast<int>(priority));
+                        return false;
+                    }
+                    tasks_[static_cast<dp::usize>(priority)].push(std::move(task));
+                    queued_++;
+                }
+                condition_.notify_one();
+                return true;
+            }
+
+            /// Get number of active tasks
+            dp::usize active_count() const override { return active_tasks_.load(); }
+
+            /// Get number of queued tasks
+            dp::usize queued_count() const override {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                return queued_;
+            }
+
+            /// Shutdown the pool and wait for all tasks to complete
+            void shutdown() override {
+                if (stop_) {
+                    return;
+                }
+
+                echo::trace("ThreadPool shutting down, active=", active_tasks_.load(), " queued=", queued_count());
+                stop_ = true;
+                condition_.notify_all();
+
+                for (auto &worker : workers_) {
+                    if (worker.joinable()) {
+                        worker.join();
+                    }
+                }
+                echo::trace("ThreadPool shutdown complete");
+            }
+        };
+
+        /// Placement options for WorkStealingExecutor
+        struct ExecutorOptions {
+            dp::usize threads = 10;
+            dp::usize max_queue = 1000;
+            bool pin_threads = false;  ///< Pin worker i to the i-th usable CPU
+            dp::i32 numa_node = -1;    ///< Restrict workers to this node's CPUs (-1 = any node)
+            std::vector<dp::i32> cpus; ///< Pin worker i to cpus[i % size]; takes precedence over the two above
+        };
+
+        /// Pin a thread to one CPU
+        inline dp::Res<void> pin_thread(pthread_t thread, dp::i32 cpu) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                return dp::result::err(dp::Error::invalid_argument("cpu out of range"));
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            dp::i32 rc = ::pthread_setaffinity_np(thread, sizeof(set), &set);
+            if (rc != 0) {
+                echo::warn("failed to pin thread to cpu ", cpu, ": ", strerror(rc));
+                return dp::result::err(dp::Error::io_error(dp::String("failed to pin thread: ") + strerror(rc)));
+            }
+            return dp::result::ok();
+        }
+
+        /// CPUs this process may run on, optionally limited to one NUMA node
+        /// The node's CPU list is read from sysfs, so no libnuma is needed
+        inline std::vector<dp::i32> usable_cpus(dp::i32 numa_node = -1) {
+            std::vector<dp::i32> cpus;
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+                return cpus;
+            }
+
+            std::vector<bool> on_node;
+            if (numa_node >= 0) {
+                std::ifstream file("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist");
+                std::string list;
+                if (!std::getline(file, list)) {
+                    echo::warn("NUMA node ", numa_node, " not found, using all CPUs");
+                } else {
+                    // Format: "0-3,8-11"
+                    on_node.assign(CPU_SETSIZE, false);
+                    dp::usize pos = 0;
+                    while (pos < list.size()) {
+                        dp::usize comma = list.find(',', pos);
+                        dp::usize end = comma == std::string::npos ? list.size() : comma;
+                        std::string range = list.substr(pos, end - pos);
+                        dp::usize dash = range.find('-');
+                        dp::i32 first = std::atoi(range.c_str());
+                        dp::i32 last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                        for (dp::i32 cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+                            on_node[static_cast<dp::usize>(cpu)] = true;
+                        }
+                        if (comma == std::string::npos) {
+                            break;
+                        }
+                        pos = comma + 1;
+                    }
+                }
+            }
+
+            for (dp::i32 cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &allowed) && (on_node.empty() || on_node[static_cast<dp::usize>(cpu)])) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        /// Handler executor with one deque per worker
+        /// External submits (e.g. a receiver thread) are spread round-robin over the workers and tasks
+        /// submitted from a worker stay on that worker's deque. An idle worker steals from the others
+        /// before it sleeps, so no single queue lock is shared by the submitter and every worker.
+        /// Each worker keeps a deque per priority class and both owner and thieves drain the highest class first.
+        class WorkStealingExecutor : public Executor {
+          private:
+            struct Worker {
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks[PRIORITY_LEVELS];
+                std::thread thread;
+            };
+
+            std::vector<std::unique_ptr<Worker>> workers_;
+            std::atomic<bool> stop_;
+            std::atomic<dp::usize> active_;
+            std::atomic<dp::usize> queued_;
+            dp::usize max_queue_;
+            std::atomic<dp::usize> next_; // Round-robin target for external submits
+
+            // Idle workers park here; submit only touches it when someone is asleep
+            std::mutex sleep_mutex_;
+            std::condition_variable wake_;
+            std::atomic<dp::usize> sleepers_;
+
+            // Which worker (if any) of which executor the current thread is
+            static inline thread_local const WorkStealingExecutor *current_ = nullptr;
+            static inline thread_local dp::usize current_index_ = 0;
+
+            static constexpr int SPINS_BEFORE_SLEEP = 64;
+
+            // Own tasks are taken oldest first; thieves take the newest, the one the owner reaches last
+            bool take(dp::usize index, std::function<void()> &task) {
+                {
+                    Worker &own = *workers_[index];
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    for (dp::usize level = PRIORITY_LEVELS; level-- > 0;) {
+                        if (!own.tasks[level].empty()) {
+                            task = std::move(own.tasks[level].front());
+                            own.tasks[level].pop_front();
+                            return true;
+                        }
+                    }
+                }
+                for (dp::usize offset = 1; offset < workers_.size(); offset++) {
+                    Worker &victim = *workers_[(index + offset) % workers_.size()];
+                    std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+                    if (!lock.owns_lock()) {
+                        continue;
+                    }
+                    for (dp::usize level = PRIORITY_LEVELS; level-- > 0;) {
+                        if (!victim.tasks[level].empty()) {
+                            task = std::move(victim.tasks[level].back());
+                            victim.tasks[level].pop_back();
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            void worker_loop(dp::usize index) {
+                current_ = this;
+                current_index_ = index;
+
+                int idle_spins = 0;
+                while (true) {
+                    std::function<void()> task;
+                    if (take(index, task)) {
+                        queued_.fetch_sub(1);
+                        active_++;
+                        task();
+                        active_--;
+                        idle_spins = 0;
+                        continue;
+                    }
+
+                    if (stop_ && queued_.load() == 0) {
+                        return;
+                    }
+                    if (++idle_spins < SPINS_BEFORE_SLEEP) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    // Announce the sleep before checking for work, so a racing submit sees it
+                    sleepers_.fetch_add(1);
+                    {
+                        std::unique_lock<std::mutex> lock(sleep_mutex_);
+                        wake_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+                    }
+                    sleepers_.fetch_sub(1);
+                    idle_spins = 0;
+                }
+            }
+
+          public:
+            explicit WorkStealingExecutor(const ExecutorOptions &options)
+                : stop_(false), active_(0), queued_(0), max_queue_(options.max_queue), next_(0), sleepers_(0) {
+                dp::usize count = options.threads == 0 ? 1 : options.threads;
+                std::vector<dp::i32> cpus = options.cpus;
+                bool pin_each = options.pin_threads || !cpus.empty();
+                if (cpus.empty() && (options.pin_threads || options.numa_node >= 0)) {
+                    cpus = usable_cpus(options.numa_node);
+                }
+                echo::trace("WorkStealingExecutor created with ", count, " threads, max_queue=", options.max_queue,
+                            " cpus=", cpus.size());
+
+                for (dp::usize i = 0; i < count; i++) {
+                    workers_.push_back(std::make_unique<Worker>());
+                }
+                for (dp::usize i = 0; i < count; i++) {
+                    workers_[i]->thread = std::thread(&WorkStealingExecutor::worker_loop, this, i);
+                    if (!cpus.empty()) {
+                        if (pin_each) {
+                            pin_thread(workers_[i]->thread.native_handle(), cpus[i % cpus.size()]);
+                        } else {
+                            // NUMA placement without pinning: any CPU of the node
+                            cpu_set_t set;
+                            CPU_ZERO(&set);
+                            for (dp::i32 cpu : cpus) {
+                                CPU_SET(cpu, &set);
+                            }
+                            ::pthread_setaffinity_np(workers_[i]->thread.native_handle(), sizeof(set), &set);
+                        }
+                    }
+                }
+            }
+
+            explicit WorkStealingExecutor(dp::usize threads = 10, dp::usize max_queue = 1000)
+                : WorkStealingExecutor(ExecutorOptions{threads, max_queue, false, -1, {}}) {}
+
+            ~WorkStealingExecutor() override { shutdown(); }
+
+            WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+            WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+            bool submit(std::function<void()> task) override { return submit(std::move(task), Priority::Normal); }
+
+            bool submit(std::function<void()> task, Priority priority) override {
+                if (stop_) {
+                    return false;
+                }
+                if (queued_.fetch_add(1) >= admission_limit(max_queue_, priority)) {
+                    queued_.fetch_sub(1);
+                    echo::warn("WorkStealingExecutor queue full (", max_queue_, ") for priority ",
+                               static_cast<int>(priority));
+                    return false;
+                }
+
+                dp::usize index = current_ == this ? current_index_ : next_.fetch_add(1) % workers_.size();
+                {
+                    Worker &worker = *workers_[index];
+                    std::lock_guard<std::mutex> lock(worker.mutex);
+                    worker.tasks[static_cast<dp::usize>(priority)].push_back(std::move(task));
+                }
+
+                if (sleepers_.load() > 0) {
+                    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+                    wake_.notify_one();
+                }
+                return true;
+            }
+
+            dp::usize active_count() const override { return active_.load(); }
+            dp::usize queued_count() const override { return queued_.load(); }
+            dp::usize thread_count() const { return workers_.size(); }
+
+            /// Pin worker i of the running executor to cpus[i % size]
+            dp::Res<void> set_affinity(const std::vector<dp::i32> &cpus) {
+                if (cpus.empty()) {
+                    return dp::result::err(dp::Error::invalid_argument("no cpus given"));
+                }
+                for (dp::usize i = 0; i < workers_.size(); i++) {
+                    auto res = pin_thread(workers_[i]->thread.native_handle(), cpus[i % cpus.size()]);
+                    if (res.is_err()) {
+                        return res;
+                    }
+                }
+                return dp::result::ok();
+            }
+
+            void shutdown() override {
+                if (stop_.exchange(true)) {
+                    return;
+                }
+                echo::trace("WorkStealingExecutor shutting down, active=", active_.load(), " queued=", queued_.load());
+                {
+                    std::lock_guard<std::mutex> lock(sleep_mutex_);
+                }
+                wake_.notify_all();
+
+                for (auto &worker : workers_) {
+                    if (worker->thread.joinable()) {
+                        worker->thread.join();
+                    }
+                }
+                echo::trace("WorkStealingExecutor shutdown complete");
+            }
+        };
+
+    } // namespace remote
+
+    using Executor = remote::Executor;
+    using Priority = remote::Priority;
+    using WorkStealingExecutor = remote::WorkStealingExecutor;
+
+} // namespace netpipe
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstring>
+#include <netpipe/remote/protocol.hpp>
+#include <netpipe/remote/serialization.hpp>
+#include <netpipe/stream.hpp>
+#include <span>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Builds one V2 frame in a single buffer: stream prefix, V2 header, payload and trailer back to back
+        /// Headroom for the transport prefix and the header is laid down first, the payload is appended behind it
+        /// (serializers write straight into the buffer), and finish() stores the header fields at their fixed
+        /// offsets once the length is known. send() hands prefix and frame to the stream as one contiguous write.
+        /// reset() keeps the allocation, so a builder reused per call stops allocating after the first frame.
+        class FrameBuilder {
+          public:
+            /// Bytes in front of the payload: transport prefix, then the V2 header
+            static constexpr dp::usize HEADROOM = STREAM_PREFIX_SIZE + V2_HEADER_SIZE;
+
+            /// @param payload_capacity Payload bytes to reserve up front (a deadline trailer is allowed for)
+            explicit FrameBuilder(dp::usize payload_capacity = 0) { reset(payload_capacity); }
+
+            /// Start a new frame; the buffer keeps its capacity and grows to payload_capacity if needed
+            void reset(dp::usize payload_capacity = 0) {
+                buffer_.reserve(HEADROOM + payload_capacity + DEADLINE_TRAILER_SIZE);
+                buffer_.resize(HEADROOM);
+                finished_ = false;
+            }
+
+            FrameBuilder &append(const dp::u8 *data, dp::usize length) {
+                reopen();
+                if (length > 0) {
+                    dp::usize start = buffer_.size();
+                    buffer_.resize(start + length);
+                    std::memcpy(buffer_.data() + start, data, length);
+                }
+                return *this;
+            }
+
+            FrameBuilder &append(const Message &bytes) { return append(bytes.data(), bytes.size()); }
+
+            /// Append value in the Serializer wire layout, written in place
+            template <typename T> FrameBuilder &append_value(const T &value) {
+                reopen();
+                wire::append(value, buffer_);
+                return *this;
+            }
+
+            /// Whole buffer, headroom included, for writers that append on their own (e.g. wire::append)
+            /// Only bytes past HEADROOM belong to the payload.
+            Message &buffer() {
+                reopen();
+                return buffer_;
+            }
+
+            dp::usize payload_size() const { return buffer_.size() - HEADROOM - (finished_ ? trailer_ : 0); }
+
+            /// Store the header (and deadline trailer) and return the encoded V2 frame, without the prefix
+            /// @param deadline_ms Non-zero appends a deadline trailer with this budget
+            std::span<const dp::u8> finish(dp::u32 request_id, dp::u32 method_id,
+                                           MessageType type = MessageType::Request,
+                                           dp::u16 flags = MessageFlags::None, dp::u32 deadline_ms = 0) {
+                reopen(); // Finished again with other header fields
+                trailer_ = deadline_ms != 0 ? DEADLINE_TRAILER_SIZE : 0;
+                if (trailer_) {
+                    flags |= MessageFlags::Deadline;
+                    auto budget = encode_u32_be(deadline_ms);
+                    buffer_.insert(buffer_.end(), budget.begin(), budget.end());
+                }
+                write_remote_header_v2(buffer_.data() + STREAM_PREFIX_SIZE, request_id, method_id,
+                                       static_cast<dp::u32>(buffer_.size() - HEADROOM), type, flags);
+                finished_ = true;
+                return frame();
+            }
+
+            /// Encoded V2 frame of the last finish()
+            std::span<const dp::u8> frame() const {
+                return std::span<const dp::u8>(buffer_.data() + STREAM_PREFIX_SIZE,
+                                               buffer_.size() - STREAM_PREFIX_SIZE);
+            }
+
+            /// finish() and send the frame as one message; streams with a length prefix write it into the headroom
+            dp::Res<void> send(Stream &stream, dp::u32 request_id, dp::u32 method_id,
+                               MessageType type = MessageType::Request, dp::u16 flags = MessageFlags::None,
+                               dp::u32 deadline_ms = 0) {
+                finish(request_id, method_id, type, flags, deadline_ms);
+                return stream.send_prefixed(buffer_.data(), buffer_.size());
+            }
+
+          private:
+            // Take the trailer of the last finish() off again before the payload changes
+            void reopen() {
+                if (finished_) {
+                    buffer_.resize(buffer_.size() - trailer_);
+                    finished_ = false;
+                }
+            }
+
+            Message buffer_;
+            dp::usize trailer_ = 0;
+            bool finished_ = false;
+        };
+
+    } // namespace remote
+
+    using FrameBuilder = remote::FrameBuilder;
+
+} // namespace netpipe
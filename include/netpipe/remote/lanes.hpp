@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <netpipe/remote/executor.hpp>
+#include <netpipe/remote/remote.hpp>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Which kind of lane a RemoteLanes call travels on
+        enum class LaneClass : dp::u8 {
+            Auto = 0,    ///< Decided by request size (LaneConfig::bulk_threshold)
+            Control = 1, ///< Latency-sensitive: never queued behind bulk payloads
+            Bulk = 2,    ///< Large transfers
+        };
+
+        struct LaneConfig {
+            /// Auto calls whose request is at least this many bytes use a bulk lane
+            dp::usize bulk_threshold = 64 * 1024;
+            /// Lanes [0, control_lanes) carry control calls, the rest bulk calls
+            /// With no lane left for bulk, bulk calls share the control lanes
+            dp::usize control_lanes = 1;
+            /// Per-lane limits and options, as for Remote<Bidirect>
+            dp::usize max_concurrent = 100;
+            bool enable_metrics = false;
+            dp::u32 handler_timeout_ms = 30000;
+            dp::usize max_incoming = 100;
+        };
+
+        /// One logical Remote<Bidirect> striped over several connections to the same peer
+        /// Each lane is a full Remote<Bidirect> with its own send lock, receiver thread and request table, so a
+        /// 100 MB request on a bulk lane delays neither the writes nor the reads of calls on a control lane.
+        /// Request ids stay per lane: they only have to be unique on their own connection, and a shared
+        /// counter would bring back the cross-lane contention that lanes exist to avoid.
+        /// Both peers build their RemoteLanes over the connections in the same order; a request is answered
+        /// on the lane it arrived on. Handlers of all lanes run on one shared executor.
+        class RemoteLanes {
+          private:
+            LaneConfig config_;
+            std::shared_ptr<Executor> executor_;
+            bool owns_executor_;
+            dp::Vector<std::unique_ptr<Remote<Bidirect>>> lanes_;
+            std::atomic<dp::usize> next_control_{0};
+            std::atomic<dp::usize> next_bulk_{0};
+
+            dp::usize control_count() const {
+                dp::usize control = config_.control_lanes == 0 ? 1 : config_.control_lanes;
+                return control < lanes_.size() ? control : lanes_.size();
+            }
+
+            static Task<dp::Res<Message>> no_lanes() {
+                co_return dp::result::err(dp::Error::invalid_argument("RemoteLanes has no lanes"));
+            }
+
+            template <typename Fn> dp::Res<void> each_lane(Fn &&fn) {
+                for (auto &lane : lanes_) {
+                    auto res = fn(*lane);
+                    if (res.is_err()) {
+                        return res;
+                    }
+                }
+                return dp::result::ok();
+            }
+
+          public:
+            /// @param streams Connected streams, one per lane (at least one); they must outlive this object
+            /// @param executor Where incoming requests of every lane run; nullptr creates one for these lanes
+            /// Built with no streams, every call fails with INVALID_ARGUMENT; create() refuses that up front
+            explicit RemoteLanes(const dp::Vector<Stream *> &streams, LaneConfig config = {},
+                                 std::shared_ptr<Executor> executor = nullptr)
+                : config_(config), executor_(std::move(executor)), owns_executor_(false) {
+                if (!executor_) {
+                    executor_ = std::make_shared<WorkStealingExecutor>();
+                    owns_executor_ = true;
+                }
+                if (streams.empty()) {
+                    echo::error("RemoteLanes constructed without streams");
+                }
+                for (Stream *stream : streams) {
+                    lanes_.push_back(std::make_unique<Remote<Bidirect>>(*stream, executor_, config_.max_concurrent,
+                                                                        config_.enable_metrics, 100,
+                                                                        config_.handler_timeout_ms,
+                                                                        config_.max_incoming));
+                }
+                echo::debug("RemoteLanes constructed, lanes=", lanes_.size(), " control=", control_count(),
+                            " bulk_threshold=", config_.bulk_threshold);
+            }
+
+            /// As the constructor, but fails on an empty or null stream list instead of building dead lanes
+            static dp::Res<std::unique_ptr<RemoteLanes>> create(const dp::Vector<Stream *> &streams,
+                                                                LaneConfig config = {},
+                                                                std::shared_ptr<Executor> executor = nullptr) {
+                if (streams.empty()) {
+                    return dp::result::err(dp::Error::invalid_argument("RemoteLanes needs at least one stream"));
+                }
+                for (Stream *stream : streams) {
+                    if (!stream) {
+                        return dp::result::err(dp::Error::invalid_argument("RemoteLanes stream is null"));
+                    }
+                }
+                return dp::result::ok(std::make_unique<RemoteLanes>(streams, config, std::move(executor)));
+            }
+
+            ~RemoteLanes() {
+                lanes_.clear(); // Each lane waits for its own handlers before the executor goes
+                if (owns_executor_) {
+                    executor_->shutdown();
+                }
+            }
+
+            RemoteLanes(const RemoteLanes &) = delete;
+            RemoteLanes &operator=(const RemoteLanes &) = delete;
+
+            dp::usize lane_count() const { return lanes_.size(); }
+
+            /// Direct access to one lane (metrics, cancel, streaming sinks)
+            Remote<Bidirect> &lane(dp::usize index) { return *lanes_[index]; }
+
+            /// Lane index the next call of this size and class goes to (0 when there are no lanes)
+            /// Control and bulk lanes are each used round-robin
+            dp::usize route(dp::usize request_size, LaneClass lane_class = LaneClass::Auto) {
+                if (lanes_.empty()) {
+                    return 0;
+                }
+                if (lane_class == LaneClass::Auto) {
+                    lane_class = request_size >= config_.bulk_threshold ? LaneClass::Bulk : LaneClass::Control;
+                }
+                dp::usize control = control_count();
+                dp::usize bulk = lanes_.size() - control;
+                if (lane_class == LaneClass::Bulk && bulk > 0) {
+                    return control + next_bulk_.fetch_add(1, std::memory_order_relaxed) % bulk;
+                }
+                return next_control_.fetch_add(1, std::memory_order_relaxed) % control;
+            }
+
+            /// Call a method on the peer over the lane chosen by route()
+            dp::Res<Message> call(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000,
+                                  LaneClass lane_class = LaneClass::Auto) {
+                if (lanes_.empty()) {
+                    return dp::result::err(dp::Error::invalid_argument("RemoteLanes has no lanes"));
+                }
+                return lanes_[route(request.size(), lane_class)]->call(method_id, request, timeout_ms);
+            }
+
+            /// Coroutine form of call(); see Remote<Bidirect>::call_async
+            Task<dp::Res<Message>> call_async(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000,
+                                              LaneClass lane_class = LaneClass::Auto) {
+                if (lanes_.empty()) {
+                    return no_lanes();
+                }
+                return lanes_[route(request.size(), lane_class)]->call_async(method_id, request, timeout_ms);
+            }
+
+            /// Register a handler on every lane - the peer may send the request on any of them
+            /// All or nothing: when one lane refuses, the lanes already done are unregistered again
+            dp::Res<void> register_method(dp::u32 method_id, Handler handler) {
+                for (dp::usize i = 0; i < lanes_.size(); i++) {
+                    auto res = lanes_[i]->register_method(method_id, handler);
+                    if (res.is_err()) {
+                        while (i-- > 0) {
+                            lanes_[i]->unregister_method(method_id);
+                        }
+                        return res;
+                    }
+                }
+                return dp::result::ok();
+            }
+
+            dp::Res<void> unregister_method(dp::u32 method_id) {
+                return each_lane([&](Remote<Bidirect> &lane) { return lane.unregister_method(method_id); });
+            }
+
+            template <typename Table> void register_static_methods() {
+                for (auto &lane : lanes_) {
+                    lane->register_static_methods<Table>();
+                }
+            }
+
+            void set_default_handler(Handler handler) {
+                for (auto &lane : lanes_) {
+                    lane->set_default_handler(handler);
+                }
+            }
+
+            void set_compression(std::shared_ptr<const Codec> codec,
+                                 dp::usize threshold = DEFAULT_COMPRESSION_THRESHOLD) {
+                for (auto &lane : lanes_) {
+                    lane->set_compression(codec, threshold);
+                }
+            }
+
+            void set_deadline_propagation(bool enable) {
+                for (auto &lane : lanes_) {
+                    lane->set_deadline_propagation(enable);
+                }
+            }
+        };
+
+    } // namespace remote
+
+    using LaneClass = remote::LaneClass;
+    using LaneConfig = remote::LaneConfig;
+    using RemoteLanes = remote::RemoteLanes;
+
+} // namespace netpipe
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <netpipe/common.hpp>
+#include <netpipe/stream.hpp>
+#include <vector>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Receiver configuration for latency-bound traffic such as a 1 kHz control loop
+        /// The receiver stops sleeping in recv between messages: it polls the stream for input and only falls back
+        /// to the blocking recv when nothing arrived for spin_us. That costs a core per connection and saves the
+        /// wakeup and context switch on every message.
+        struct LowLatencyOptions {
+            dp::u32 spin_us = 1000;            ///< Poll for input this long before blocking in recv (0 = never)
+            dp::u32 busy_poll_us = 50;         ///< SO_BUSY_POLL on the stream's socket (0 = leave it)
+            dp::i32 receiver_cpu = -1;         ///< Pin the receiver thread to this CPU (-1 = leave it)
+            std::vector<dp::i32> handler_cpus; ///< Pin the Remote's own handler workers (empty = leave them)
+            bool inline_handlers = false;      ///< Run handlers on the receiver thread, no pool hop
+        };
+
+        /// Poll stream until it has input, running turns false or spin_us passes; true when input is pending
+        /// Streams that never report pending input (Stream::has_pending_input) just spend the budget.
+        inline bool spin_for_input(const Stream &stream, dp::u32 spin_us, const std::atomic<bool> &running) {
+            if (stream.has_pending_input()) {
+                return true;
+            }
+            auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(spin_us);
+            while (running.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 16; i++) {
+                    cpu_relax();
+                }
+                if (stream.has_pending_input()) {
+                    return true;
+                }
+                if (std::chrono::steady_clock::now() >= until) {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+    } // namespace remote
+
+    using LowLatencyOptions = remote::LowLatencyOptions;
+
+} // namespace netpipe
@@ -4,34 +4,316 @@
 #include <chrono>
 #include <datapod/datapod.hpp>
 #include <mutex>
+#include <utility>
 
 namespace netpipe {
     namespace remote {
 
+        /// Log-linear bucket layout shared by LatencyHistogram and HistogramSnapshot
+        /// Values below 16 get exact buckets; above that every power of two is split into 16 linear
+        /// sub-buckets, so a reported value is within 1/16 (6.25%) of the recorded one. Values from 2^40 us
+        /// (about 12 days) up land in the last bucket.
+        struct HistogramLayout {
+            static constexpr dp::u32 SUB_BITS = 4;
+            static constexpr dp::u32 SUB_BUCKETS = 1u << SUB_BITS;
+            static constexpr dp::u32 MAX_BITS = 40;
+            static constexpr dp::u64 MAX_VALUE = (dp::u64{1} << MAX_BITS) - 1;
+            static constexpr dp::usize BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+            static dp::usize index_of(dp::u64 value) {
+                if (value > MAX_VALUE) {
+                    value = MAX_VALUE;
+                }
+                if (value < SUB_BUCKETS) {
+                    return static_cast<dp::usize>(value);
+                }
+                dp::u32 exp = 63 - static_cast<dp::u32>(__builtin_clzll(value)); // >= SUB_BITS
+                dp::u32 shift = exp - SUB_BITS;
+                return (shift + 1) * SUB_BUCKETS + static_cast<dp::usize>((value >> shift) & (SUB_BUCKETS - 1));
+            }
+
+            /// Largest value that maps to bucket index
+            static dp::u64 upper_bound(dp::usize index) {
+                if (index < SUB_BUCKETS) {
+                    return index;
+                }
+                dp::u32 shift = static_cast<dp::u32>(index / SUB_BUCKETS) - 1;
+                dp::u64 lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+                return lower + (dp::u64{1} << shift) - 1;
+            }
+        };
+
+        /// Plain copy of a LatencyHistogram - cheap to query, merge and pass around
+        struct HistogramSnapshot {
+            dp::Array<dp::u64, HistogramLayout::BUCKETS> buckets{};
+            dp::u64 count = 0;
+            dp::u64 max = 0;
+
+            /// Add another snapshot's samples (e.g. to combine methods or Remotes)
+            void merge(const HistogramSnapshot &other) {
+                for (dp::usize i = 0; i < HistogramLayout::BUCKETS; i++) {
+                    buckets[i] += other.buckets[i];
+                }
+                count += other.count;
+                max = other.max > max ? other.max : max;
+            }
+
+            /// Value at quantile q (0.0 to 1.0), e.g. 0.99 for p99; 0 when empty
+            /// Reported as the top of the bucket holding that sample, never above the largest recorded value
+            dp::u64 percentile(double q) const {
+                if (count == 0) {
+                    return 0;
+                }
+                q = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+                dp::u64 rank = static_cast<dp::u64>(q * static_cast<double>(count) + 0.999999);
+                rank = rank == 0 ? 1 : rank;
+                dp::u64 seen = 0;
+                for (dp::usize i = 0; i < HistogramLayout::BUCKETS; i++) {
+                    seen += buckets[i];
+                    if (seen >= rank) {
+                        dp::u64 value = HistogramLayout::upper_bound(i);
+                        return value < max ? value : max;
+                    }
+                }
+                return max;
+            }
+        };
+
+        /// Fixed-memory latency histogram, safe to record into from any number of threads
+        /// record() is two relaxed increments plus a max update, no locks and no allocation
+        class LatencyHistogram {
+          private:
+            dp::Array<std::atomic<dp::u64>, HistogramLayout::BUCKETS> buckets_{};
+            std::atomic<dp::u64> count_{0};
+            std::atomic<dp::u64> max_{0};
+
+          public:
+            void record(dp::u64 value_us) {
+                buckets_[HistogramLayout::index_of(value_us)].fetch_add(1, std::memory_order_relaxed);
+                count_.fetch_add(1, std::memory_order_relaxed);
+                dp::u64 max = max_.load(std::memory_order_relaxed);
+                while (value_us > max && !max_.compare_exchange_weak(max, value_us, std::memory_order_relaxed)) {
+                    // Retry if another thread raised max
+                }
+            }
+
+            dp::u64 count() const { return count_.load(std::memory_order_relaxed); }
+
+            /// Value at quantile q (0.0 to 1.0) over everything recorded so far
+            dp::u64 percentile(double q) const { return snapshot().percentile(q); }
+
+            /// Copy of the current counts; concurrent records may be partially included
+            HistogramSnapshot snapshot() const {
+                HistogramSnapshot out;
+                for (dp::usize i = 0; i < HistogramLayout::BUCKETS; i++) {
+                    out.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+                    out.count += out.buckets[i];
+                }
+                out.max = max_.load(std::memory_order_relaxed);
+                return out;
+            }
+
+            /// Fold a snapshot's samples into this histogram
+            void merge(const HistogramSnapshot &other) {
+                for (dp::usize i = 0; i < HistogramLayout::BUCKETS; i++) {
+                    if (other.buckets[i] != 0) {
+                        buckets_[i].fetch_add(other.buckets[i], std::memory_order_relaxed);
+                    }
+                }
+                count_.fetch_add(other.count, std::memory_order_relaxed);
+                dp::u64 max = max_.load(std::memory_order_relaxed);
+                while (other.max > max && !max_.compare_exchange_weak(max, other.max, std::memory_order_relaxed)) {
+                    // Retry if another thread raised max
+                }
+            }
+
+            void reset() {
+                for (auto &bucket : buckets_) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+                count_.store(0, std::memory_order_relaxed);
+                max_.store(0, std::memory_order_relaxed);
+            }
+        };
+
+        /// Latency and handler-time histograms of one method_id
+        struct MethodLatency {
+            dp::u32 method_id = 0;
+            LatencyHistogram latency;
+            LatencyHistogram handler_time;
+        };
+
+        /// Per-method_id histograms in a fixed open-addressed table
+        /// Slots are claimed with a CAS and their histograms allocated on first use, so memory follows the
+        /// number of methods actually called. Methods beyond MAX_METHODS are only counted in the totals.
+        class MethodLatencyTable {
+          public:
+            static constexpr dp::usize MAX_METHODS = 128;
+
+          private:
+            dp::Array<std::atomic<MethodLatency *>, MAX_METHODS> slots_{};
+
+            static dp::usize home(dp::u32 method_id) { return (method_id * 2654435761u) % MAX_METHODS; }
+
+            MethodLatency *slot_for(dp::u32 method_id) {
+                dp::usize start = home(method_id);
+                for (dp::usize probe = 0; probe < MAX_METHODS; probe++) {
+                    auto &slot = slots_[(start + probe) % MAX_METHODS];
+                    MethodLatency *entry = slot.load(std::memory_order_acquire);
+                    if (!entry) {
+                        auto *fresh = new MethodLatency();
+                        fresh->method_id = method_id;
+                        if (slot.compare_exchange_strong(entry, fresh, std::memory_order_acq_rel)) {
+                            return fresh;
+                        }
+                        delete fresh; // Lost the race; entry now holds the winner
+                    }
+                    if (entry->method_id == method_id) {
+                        return entry;
+                    }
+                }
+                return nullptr;
+            }
+
+          public:
+            MethodLatencyTable() = default;
+            MethodLatencyTable(const MethodLatencyTable &) = delete;
+            MethodLatencyTable &operator=(const MethodLatencyTable &) = delete;
+
+            ~MethodLatencyTable() {
+                for (auto &slot : slots_) {
+                    delete slot.load(std::memory_order_relaxed);
+                }
+            }
+
+            void record_latency(dp::u32 method_id, dp::u64 value_us) {
+                if (MethodLatency *entry = slot_for(method_id)) {
+                    entry->latency.record(value_us);
+                }
+            }
+
+            void record_handler_time(dp::u32 method_id, dp::u64 value_us) {
+                if (MethodLatency *entry = slot_for(method_id)) {
+                    entry->handler_time.record(value_us);
+                }
+            }
+
+            /// Histograms of method_id, or nullptr when it has not been recorded
+            const MethodLatency *find(dp::u32 method_id) const {
+                dp::usize start = home(method_id);
+                for (dp::usize probe = 0; probe < MAX_METHODS; probe++) {
+                    const MethodLatency *entry = slots_[(start + probe) % MAX_METHODS].load(std::memory_order_acquire);
+                    if (!entry) {
+                        return nullptr;
+                    }
+                    if (entry->method_id == method_id) {
+                        return entry;
+                    }
+                }
+                return nullptr;
+            }
+
+            /// Visit every recorded method: fn(const MethodLatency &)
+            template <typename Fn> void for_each(Fn &&fn) const {
+                for (const auto &slot : slots_) {
+                    if (const MethodLatency *entry = slot.load(std::memory_order_acquire)) {
+                        fn(*entry);
+                    }
+                }
+            }
+
+            /// Zero the histograms; slots stay assigned so concurrent recorders never see freed memory
+            void reset() {
+                for (auto &slot : slots_) {
+                    if (MethodLatency *entry = slot.load(std::memory_order_acquire)) {
+                        entry->latency.reset();
+                        entry->handler_time.reset();
+                    }
+                }
+            }
+        };
+
+        /// Counter split across cache-line-sized shards so threads adding to it do not contend
+        /// Each thread sticks to one shard (assigned round-robin on its first add); load() sums the shards, so
+        /// reads are slower than a plain atomic and writes are as cheap as an uncontended one.
+        class ShardedCounter {
+          public:
+            static constexpr dp::usize SHARDS = 16;
+
+          private:
+            struct alignas(64) Shard {
+                std::atomic<dp::u64> value{0};
+            };
+            Shard shards_[SHARDS];
+
+            static dp::usize shard_index() {
+                static std::atomic<dp::usize> next{0};
+                static thread_local dp::usize index = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+                return index;
+            }
+
+          public:
+            ShardedCounter() = default;
+            ShardedCounter(const ShardedCounter &) = delete;
+            ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+            void fetch_add(dp::u64 n) { shards_[shard_index()].value.fetch_add(n, std::memory_order_relaxed); }
+
+            /// Shards may wrap individually; the sum is still exact modulo 2^64
+            void fetch_sub(dp::u64 n) { shards_[shard_index()].value.fetch_sub(n, std::memory_order_relaxed); }
+
+            dp::u64 load() const {
+                dp::u64 total = 0;
+                for (const auto &shard : shards_) {
+                    total += shard.value.load(std::memory_order_relaxed);
+                }
+                return total;
+            }
+
+            operator dp::u64() const { return load(); }
+
+            /// Set the total (used by reset); not atomic with respect to concurrent adds
+            ShardedCounter &operator=(dp::u64 value) {
+                for (auto &shard : shards_) {
+                    shard.value.store(0, std::memory_order_relaxed);
+                }
+                shards_[0].value.store(value, std::memory_order_relaxed);
+                return *this;
+            }
+        };
+
         /// Metrics for Remote RPC operations
+        /// Counters are sharded, so keeping metrics on costs no cross-core traffic on the call path; the
+        /// in-flight gauge needs a global value and has a cache line to itself
         struct RemoteMetrics {
             // Request counts
-            std::atomic<dp::u64> total_requests{0};
-            std::atomic<dp::u64> successful_requests{0};
-            std::atomic<dp::u64> failed_requests{0};
-            std::atomic<dp::u64> timeout_requests{0};
+            ShardedCounter total_requests;
+            ShardedCounter successful_requests;
+            ShardedCounter failed_requests;
+            ShardedCounter timeout_requests;
 
             // In-flight tracking
-            std::atomic<dp::u64> in_flight_requests{0};
+            alignas(64) std::atomic<dp::u64> in_flight_requests{0};
             std::atomic<dp::u64> peak_in_flight_requests{0};
 
             // Latency tracking (microseconds)
-            std::atomic<dp::u64> total_latency_us{0};
-            std::atomic<dp::u64> min_latency_us{UINT64_MAX};
+            // min/max are only written when a call sets a new extreme, so their line stays shared otherwise
+            ShardedCounter total_latency_us;
+            alignas(64) std::atomic<dp::u64> min_latency_us{UINT64_MAX};
             std::atomic<dp::u64> max_latency_us{0};
 
             // Message size tracking (bytes)
-            std::atomic<dp::u64> total_request_bytes{0};
-            std::atomic<dp::u64> total_response_bytes{0};
+            ShardedCounter total_request_bytes;
+            ShardedCounter total_response_bytes;
 
             // Handler execution time (microseconds)
-            std::atomic<dp::u64> total_handler_time_us{0};
-            std::atomic<dp::u64> handler_invocations{0};
+            ShardedCounter total_handler_time_us;
+            ShardedCounter handler_invocations;
+
+            // Latency distributions (microseconds): successful calls and handler runs, overall and per method_id
+            LatencyHistogram latency_histogram;
+            LatencyHistogram handler_histogram;
+            MethodLatencyTable per_method;
 
             /// Reset all metrics to zero
             inline void reset() {
@@ -48,6 +330,21 @@ namespace netpipe {
                 total_response_bytes = 0;
                 total_handler_time_us = 0;
                 handler_invocations = 0;
+                latency_histogram.reset();
+                handler_histogram.reset();
+                per_method.reset();
+            }
+
+            /// Latency of successful calls at quantile q (0.0 to 1.0), e.g. latency_percentile_us(0.99)
+            inline dp::u64 latency_percentile_us(double q) const { return latency_histogram.percentile(q); }
+
+            /// Handler execution time at quantile q (0.0 to 1.0)
+            inline dp::u64 handler_percentile_us(double q) const { return handler_histogram.percentile(q); }
+
+            /// Latency of successful calls to method_id at quantile q; 0 when none were recorded
+            inline dp::u64 method_latency_percentile_us(dp::u32 method_id, double q) const {
+                const MethodLatency *entry = per_method.find(method_id);
+                return entry ? entry->latency.percentile(q) : 0;
             }
 
             /// Get average latency in microseconds
@@ -113,12 +410,16 @@ namespace netpipe {
             RemoteMetrics &metrics_;
             std::chrono::steady_clock::time_point start_time_;
             dp::usize request_size_;
+            dp::u32 method_id_;
             bool completed_;
 
           public:
-            explicit MetricsTracker(RemoteMetrics &metrics, dp::usize request_size)
+            /// Method ids other than NO_METHOD also get a per-method latency histogram
+            static constexpr dp::u32 NO_METHOD = UINT32_MAX;
+
+            explicit MetricsTracker(RemoteMetrics &metrics, dp::usize request_size, dp::u32 method_id = NO_METHOD)
                 : metrics_(metrics), start_time_(std::chrono::steady_clock::now()), request_size_(request_size),
-                  completed_(false) {
+                  method_id_(method_id), completed_(false) {
                 metrics_.total_requests.fetch_add(1);
                 metrics_.total_request_bytes.fetch_add(request_size);
 
@@ -149,6 +450,10 @@ namespace netpipe {
                 metrics_.successful_requests.fetch_add(1);
                 metrics_.total_response_bytes.fetch_add(response_size);
                 metrics_.total_latency_us.fetch_add(latency_us);
+                metrics_.latency_histogram.record(latency_us);
+                if (method_id_ != NO_METHOD) {
+                    metrics_.per_method.record_latency(method_id_, latency_us);
+                }
 
                 // Update min latency
                 dp::u64 min = metrics_.min_latency_us.load();
@@ -192,10 +497,11 @@ namespace netpipe {
           private:
             RemoteMetrics &metrics_;
             std::chrono::steady_clock::time_point start_time_;
+            dp::u32 method_id_;
 
           public:
-            explicit HandlerMetricsTracker(RemoteMetrics &metrics)
-                : metrics_(metrics), start_time_(std::chrono::steady_clock::now()) {}
+            explicit HandlerMetricsTracker(RemoteMetrics &metrics, dp::u32 method_id = MetricsTracker::NO_METHOD)
+                : metrics_(metrics), start_time_(std::chrono::steady_clock::now()), method_id_(method_id) {}
 
             ~HandlerMetricsTracker() {
                 auto end_time = std::chrono::steady_clock::now();
@@ -204,11 +510,18 @@ namespace netpipe {
 
                 metrics_.total_handler_time_us.fetch_add(duration_us);
                 metrics_.handler_invocations.fetch_add(1);
+                metrics_.handler_histogram.record(duration_us);
+                if (method_id_ != MetricsTracker::NO_METHOD) {
+                    metrics_.per_method.record_handler_time(method_id_, duration_us);
+                }
             }
         };
 
     } // namespace remote
 
+    using LatencyHistogram = remote::LatencyHistogram;
+    using HistogramSnapshot = remote::HistogramSnapshot;
+    using ShardedCounter = remote::ShardedCounter;
     using RemoteMetrics = remote::RemoteMetrics;
     using MetricsTracker = remote::MetricsTracker;
     using HandlerMetricsTracker = remote::HandlerMetricsTracker;
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <netpipe/common.hpp>
+#include <netpipe/remote/task.hpp>
+#include <netpipe/timer.hpp>
+#include <thread>
+#include <utility>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Fixed-capacity table of outgoing calls waiting for a response
+        /// Request ids carry their slot: id = (generation << index_bits) | slot, so a response finds its
+        /// waiter with one array index and one CAS - no map, no table-wide lock, no allocation per call.
+        /// A late response for a timed-out call carries an old generation and matches nothing.
+        ///
+        /// Each slot moves FREE -> WAITING -> COMPLETING -> DONE -> FREE; state and id share one atomic
+        /// word so a completer can never claim a slot that was recycled under it.
+        /// The per-slot mutex only backs the condition variable between one caller and one completer.
+        ///
+        /// A coroutine caller parks its handle in the slot instead (WAITING -> ARMED, see wait_async); the
+        /// completer resumes it inline, and a TimerService timer turns a passed deadline into a timeout.
+        class PendingTable {
+          private:
+            enum Phase : dp::u32 { FREE = 0, WAITING = 1, COMPLETING = 2, DONE = 3, ARMED = 4 };
+
+            struct Slot {
+                std::atomic<dp::u64> word{0}; // (request_id << 32) | phase
+                dp::u32 generation = 0;       // Owned by whoever holds the slot
+                dp::Res<Message> result = dp::result::err(dp::Error::timeout("timeout"));
+                std::mutex mutex;
+                std::condition_variable cv;
+                std::coroutine_handle<> waiter; // Set before the slot turns ARMED
+                TimerId timer = 0;              // Timeout of an ARMED slot
+            };
+
+            static constexpr dp::u64 pack(dp::u32 id, Phase phase) { return (static_cast<dp::u64>(id) << 32) | phase; }
+            static constexpr Phase phase_of(dp::u64 word) { return static_cast<Phase>(word & 0xFFFFFFFFu); }
+            static constexpr dp::u32 id_of(dp::u64 word) { return static_cast<dp::u32>(word >> 32); }
+
+            std::unique_ptr<Slot[]> slots_;
+            dp::u32 capacity_;
+            dp::u32 index_bits_;
+            std::atomic<dp::usize> limit_;
+            std::atomic<dp::usize> in_flight_;
+            std::atomic<dp::u32> cursor_; // Where the next acquire starts probing
+            TimerService &timers_;
+
+            Slot &slot_for(dp::u32 request_id) const { return slots_[request_id & (capacity_ - 1)]; }
+
+            // Move a WAITING or ARMED slot to DONE with result; fails if the id is stale or someone else won
+            // An ARMED caller is resumed on this thread, after which the slot belongs to it again
+            bool finish(dp::u32 request_id, dp::Res<Message> &&result) {
+                Slot &slot = slot_for(request_id);
+                dp::u64 expected = pack(request_id, WAITING);
+                if (!slot.word.compare_exchange_strong(expected, pack(request_id, COMPLETING),
+                                                       std::memory_order_acquire, std::memory_order_relaxed)) {
+                    if (expected != pack(request_id, ARMED) ||
+                        !slot.word.compare_exchange_strong(expected, pack(request_id, COMPLETING),
+                                                           std::memory_order_acquire, std::memory_order_relaxed)) {
+                        return false;
+                    }
+                    slot.result = std::move(result);
+                    std::coroutine_handle<> waiter = std::exchange(slot.waiter, nullptr);
+                    slot.word.store(pack(request_id, DONE), std::memory_order_release);
+                    waiter.resume(); // Do not touch slot after this - the caller frees it
+                    return true;
+                }
+                slot.result = std::move(result);
+                slot.word.store(pack(request_id, DONE), std::memory_order_release);
+
+                // Taking the mutex orders the notify after the waiter's predicate check
+                { std::lock_guard<std::mutex> lock(slot.mutex); }
+                slot.cv.notify_one();
+                return true;
+            }
+
+            // Take a still-WAITING slot back from completers; returns true if a result was delivered instead
+            bool settle(Slot &slot, dp::u32 request_id) {
+                dp::u64 expected = pack(request_id, WAITING);
+                if (slot.word.compare_exchange_strong(expected, pack(request_id, COMPLETING),
+                                                      std::memory_order_acquire)) {
+                    return false;
+                }
+                // A completer owns the slot - it is at most a move away from DONE
+                while (phase_of(slot.word.load(std::memory_order_acquire)) != DONE) {
+                    std::this_thread::yield();
+                }
+                return true;
+            }
+
+            // Park a coroutine on a WAITING slot; false when a result already arrived (then do not suspend)
+            bool arm(dp::u32 request_id, std::coroutine_handle<> waiter, dp::u32 timeout_ms) {
+                Slot &slot = slot_for(request_id);
+                slot.waiter = waiter;
+                // Fires at most once and only finishes this id, so firing before the CAS below is harmless
+                slot.timer = timers_.schedule(timeout_ms, [this, request_id]() {
+                    finish(request_id, dp::result::err(dp::Error::timeout("call timeout")));
+                });
+                dp::u64 expected = pack(request_id, WAITING);
+                if (slot.word.compare_exchange_strong(expected, pack(request_id, ARMED), std::memory_order_acq_rel)) {
+                    return true;
+                }
+                timers_.cancel(std::exchange(slot.timer, 0));
+                slot.waiter = nullptr;
+                while (phase_of(slot.word.load(std::memory_order_acquire)) != DONE) {
+                    std::this_thread::yield();
+                }
+                return false;
+            }
+
+            // Move the result out of a DONE slot and free it
+            dp::Res<Message> take(dp::u32 request_id) {
+                Slot &slot = slot_for(request_id);
+                timers_.cancel(std::exchange(slot.timer, 0)); // Waits out a timeout callback that lost the race
+                dp::Res<Message> result = std::move(slot.result);
+                free_slot(slot, request_id);
+                return result;
+            }
+
+            void free_slot(Slot &slot, dp::u32 request_id) {
+                slot.result = dp::result::err(dp::Error::timeout("call timeout"));
+                slot.word.store(pack(request_id, FREE), std::memory_order_release);
+                in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+            }
+
+          public:
+            /// @param max_in_flight Limit on concurrent calls; capacity is the next power of two
+            /// @param timers Times out coroutine waiters (wait_async); blocking wait() sleeps on its own
+            explicit PendingTable(dp::usize max_in_flight, TimerService &timers = TimerService::shared())
+                : capacity_(1), index_bits_(0), in_flight_(0), cursor_(0), timers_(timers) {
+                dp::usize wanted = max_in_flight == 0 ? 1 : max_in_flight;
+                while (capacity_ < wanted && index_bits_ < 16) {
+                    capacity_ <<= 1;
+                    index_bits_++;
+                }
+                limit_.store(wanted < capacity_ ? wanted : capacity_, std::memory_order_relaxed);
+                slots_ = std::make_unique<Slot[]>(capacity_);
+            }
+
+            PendingTable(const PendingTable &) = delete;
+            PendingTable &operator=(const PendingTable &) = delete;
+
+            /// Claim a slot for a new call; returns the request id to put on the wire
+            dp::Res<dp::u32> acquire() {
+                dp::usize limit = limit_.load(std::memory_order_relaxed);
+                if (in_flight_.fetch_add(1, std::memory_order_acq_rel) >= limit) {
+                    in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+                    return dp::result::err(dp::Error::io_error("max concurrent requests reached"));
+                }
+
+                // in_flight_ <= capacity_ guarantees a free slot; probing spreads callers across the array
+                dp::u32 start = cursor_.fetch_add(1, std::memory_order_relaxed);
+                for (dp::u32 probe = 0;; probe++) {
+                    Slot &slot = slots_[(start + probe) & (capacity_ - 1)];
+                    dp::u64 word = slot.word.load(std::memory_order_relaxed);
+                    if (phase_of(word) != FREE) {
+                        continue;
+                    }
+                    dp::u32 index = (start + probe) & (capacity_ - 1);
+                    dp::u64 claimed = pack(id_of(word), COMPLETING); // Reserve before the id is known
+                    if (!slot.word.compare_exchange_weak(word, claimed, std::memory_order_acquire,
+                                                         std::memory_order_relaxed)) {
+                        continue;
+                    }
+                    dp::u32 request_id = (slot.generation++ << index_bits_) | index;
+                    slot.word.store(pack(request_id, WAITING), std::memory_order_release);
+                    return dp::result::ok(request_id);
+                }
+            }
+
+            /// Block until request_id completes or timeout_ms passes, then free the slot
+            /// A response racing the timeout still wins if it claimed the slot first
+            dp::Res<Message> wait(dp::u32 request_id, dp::u32 timeout_ms) {
+                Slot &slot = slot_for(request_id);
+                {
+                    std::unique_lock<std::mutex> lock(slot.mutex);
+                    slot.cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+                        return phase_of(slot.word.load(std::memory_order_acquire)) == DONE;
+                    });
+                }
+
+                if (!settle(slot, request_id)) {
+                    free_slot(slot, request_id);
+                    return dp::result::err(dp::Error::timeout("call timeout"));
+                }
+                dp::Res<Message> result = std::move(slot.result);
+                free_slot(slot, request_id);
+                return result;
+            }
+
+            /// Awaiter returned by wait_async()
+            class WaitAwaiter {
+              public:
+                WaitAwaiter(PendingTable &table, dp::u32 request_id, dp::u32 timeout_ms)
+                    : table_(table), request_id_(request_id), timeout_ms_(timeout_ms) {}
+
+                bool await_ready() const {
+                    dp::u64 word = table_.slot_for(request_id_).word.load(std::memory_order_acquire);
+                    return phase_of(word) == DONE;
+                }
+                bool await_suspend(std::coroutine_handle<> awaiting) {
+                    return table_.arm(request_id_, awaiting, timeout_ms_);
+                }
+                dp::Res<Message> await_resume() { return table_.take(request_id_); }
+
+              private:
+                PendingTable &table_;
+                dp::u32 request_id_;
+                dp::u32 timeout_ms_;
+            };
+
+            /// co_await form of wait(): suspends without holding a thread
+            /// The coroutine resumes on whichever thread completes the call (the receiver loop, or the timer
+            /// thread for a timeout), so it should hand blocking work elsewhere.
+            WaitAwaiter wait_async(dp::u32 request_id, dp::u32 timeout_ms) {
+                return WaitAwaiter(*this, request_id, timeout_ms);
+            }
+
+            /// Give up on a call without waiting (e.g. its send failed) and free the slot
+            void release(dp::u32 request_id) {
+                Slot &slot = slot_for(request_id);
+                settle(slot, request_id);
+                free_slot(slot, request_id);
+            }
+
+            /// Deliver a response; false when no call with this id is waiting
+            bool complete(dp::u32 request_id, dp::Res<Message> result) { return finish(request_id, std::move(result)); }
+
+            /// Fail every waiting call with message (shutdown)
+            void fail_all(const char *message) {
+                for (dp::u32 i = 0; i < capacity_; i++) {
+                    dp::u64 word = slots_[i].word.load(std::memory_order_acquire);
+                    if (phase_of(word) == WAITING || phase_of(word) == ARMED) {
+                        finish(id_of(word), dp::result::err(dp::Error::io_error(message)));
+                    }
+                }
+            }
+
+            dp::usize in_flight() const { return in_flight_.load(std::memory_order_acquire); }
+            dp::usize capacity() const { return capacity_; }
+            dp::usize limit() const { return limit_.load(std::memory_order_relaxed); }
+
+            /// Change the concurrency limit; clamped to the capacity fixed at construction
+            void set_limit(dp::usize limit) {
+                limit_.store(limit < capacity_ ? limit : capacity_, std::memory_order_relaxed);
+            }
+        };
+
+    } // namespace remote
+} // namespace netpipe
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <netpipe/remote/executor.hpp>
+#include <netpipe/remote/remote.hpp>
+#include <netpipe/stream/ipc.hpp>
+#include <netpipe/stream/tcp.hpp>
+#include <thread>
+#include <variant>
+
+namespace netpipe {
+    namespace remote {
+
+        /// How RemotePool picks the connection for a call
+        enum class BalancePolicy : dp::u8 {
+            LeastOutstanding = 0, ///< Scan every connection, take the one with the fewest calls in flight
+            PowerOfTwo = 1,       ///< Compare two random connections - O(1), and no herd on one idle member
+        };
+
+        /// A server a RemotePool keeps a connection to
+        using PoolEndpoint = std::variant<TcpEndpoint, IpcEndpoint>;
+
+        struct PoolConfig {
+            BalancePolicy policy = BalancePolicy::PowerOfTwo;
+            /// How often the background thread retries endpoints that are not connected
+            dp::u32 reconnect_interval_ms = 500;
+            /// Per-connection limits and options, as for Remote<Bidirect>
+            dp::usize max_concurrent = 100;
+            bool enable_metrics = false;
+        };
+
+        /// Client connections to a set of equivalent servers, with calls spread across them
+        /// Every endpoint gets one warm Remote<Bidirect>. A connection whose stream reports disconnected is
+        /// dropped, and a background thread dials it again every reconnect_interval_ms. Calls already running
+        /// keep their connection alive until they return. A failed call is not retried on another server:
+        /// only the caller knows whether the method is safe to run twice.
+        class RemotePool {
+          private:
+            /// One established connection; destroyed by whoever drops the last reference
+            struct Connection {
+                std::unique_ptr<Stream> stream;
+                std::unique_ptr<Remote<Bidirect>> remote;
+
+                ~Connection() {
+                    remote.reset(); // Joins the receiver before the stream goes
+                    if (stream) {
+                        stream->close();
+                    }
+                }
+            };
+
+            struct Member {
+                PoolEndpoint endpoint;
+                std::mutex mutex; // Guards connection
+                std::shared_ptr<Connection> connection;
+                std::atomic<bool> connected{false};
+                std::atomic<dp::usize> outstanding{0};
+                std::atomic<dp::u64> calls{0};
+            };
+
+            PoolConfig config_;
+            std::shared_ptr<Executor> executor_;
+            bool owns_executor_;
+            dp::Vector<std::unique_ptr<Member>> members_;
+            std::atomic<dp::usize> next_{0};
+
+            std::thread reconnect_thread_;
+            std::mutex reconnect_mutex_;
+            std::condition_variable reconnect_cv_;
+            bool stopping_;
+
+            std::shared_ptr<Connection> dial(const PoolEndpoint &endpoint) {
+                auto connection = std::make_shared<Connection>();
+                dp::Res<void> res = dp::result::ok();
+                if (const auto *tcp = std::get_if<TcpEndpoint>(&endpoint)) {
+                    auto stream = std::make_unique<TcpStream>();
+                    res = stream->connect(*tcp);
+                    connection->stream = std::move(stream);
+                } else {
+                    auto stream = std::make_unique<IpcStream>();
+                    res = stream->connect_ipc(std::get<IpcEndpoint>(endpoint));
+                    connection->stream = std::move(stream);
+                }
+                if (res.is_err()) {
+                    return nullptr;
+                }
+                connection->remote = std::make_unique<Remote<Bidirect>>(*connection->stream, executor_,
+                                                                        config_.max_concurrent,
+                                                                        config_.enable_metrics);
+                return connection;
+            }
+
+            /// Dial member if it has no usable connection; true when it has one afterwards
+            bool refresh(Member &member) {
+                std::shared_ptr<Connection> stale;
+                {
+                    std::lock_guard<std::mutex> lock(member.mutex);
+                    if (member.connection && member.connection->stream->is_connected()) {
+                        return true;
+                    }
+                    stale = std::move(member.connection); // Released outside the lock, after in-flight calls
+                    member.connected = false;
+                }
+                stale.reset();
+
+                auto fresh = dial(member.endpoint);
+                if (!fresh) {
+                    return false;
+                }
+                std::lock_guard<std::mutex> lock(member.mutex);
+                member.connection = std::move(fresh);
+                member.connected = true;
+                echo::debug("remote pool connected to ",
+                            std::visit([](const auto &endpoint) { return endpoint.to_string(); }, member.endpoint)
+                                .c_str());
+                return true;
+            }
+
+            void reconnect_loop() {
+                std::unique_lock<std::mutex> lock(reconnect_mutex_);
+                while (!stopping_) {
+                    reconnect_cv_.wait_for(lock, std::chrono::milliseconds(config_.reconnect_interval_ms));
+                    if (stopping_) {
+                        break;
+                    }
+                    lock.unlock();
+                    for (auto &member : members_) {
+                        refresh(*member);
+                    }
+                    lock.lock();
+                }
+            }
+
+            static dp::u64 random() {
+                static thread_local dp::u64 state =
+                    0x9E3779B97F4A7C15ULL ^ reinterpret_cast<std::uintptr_t>(&state); // Distinct per thread
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                return state;
+            }
+
+            /// Connected member chosen by the policy, or nullptr when none is connected
+            Member *pick() {
+                dp::usize count = members_.size();
+                if (config_.policy == BalancePolicy::PowerOfTwo && count > 1) {
+                    dp::u64 r = random();
+                    Member *a = members_[r % count].get();
+                    Member *b = members_[(r % count + 1 + (r >> 32) % (count - 1)) % count].get();
+                    if (a->connected && b->connected) {
+                        return b->outstanding.load(std::memory_order_relaxed) <
+                                       a->outstanding.load(std::memory_order_relaxed)
+                                   ? b
+                                   : a;
+                    }
+                    // Fewer than two candidates were up - fall back to the full scan
+                }
+
+                // Start the scan at a rotating member so ties do not all land on the first one
+                dp::usize start = next_.fetch_add(1, std::memory_order_relaxed);
+                Member *best = nullptr;
+                dp::usize best_outstanding = 0;
+                for (dp::usize i = 0; i < count; i++) {
+                    Member *member = members_[(start + i) % count].get();
+                    if (!member->connected) {
+                        continue;
+                    }
+                    dp::usize outstanding = member->outstanding.load(std::memory_order_relaxed);
+                    if (!best || outstanding < best_outstanding) {
+                        best = member;
+                        best_outstanding = outstanding;
+                    }
+                }
+                return best;
+            }
+
+          public:
+            /// Connects to every endpoint before returning; the ones that are down are retried in the background
+            /// @param executor Where requests the servers send back run; nullptr creates one for this pool
+            explicit RemotePool(const dp::Vector<PoolEndpoint> &endpoints, PoolConfig config = {},
+                                std::shared_ptr<Executor> executor = nullptr)
+                : config_(config), executor_(std::move(executor)), owns_executor_(false), stopping_(false) {
+                if (!executor_) {
+                    executor_ = std::make_shared<WorkStealingExecutor>(2);
+                    owns_executor_ = true;
+                }
+                for (const auto &endpoint : endpoints) {
+                    auto member = std::make_unique<Member>();
+                    member->endpoint = endpoint;
+                    members_.push_back(std::move(member));
+                }
+                for (auto &member : members_) {
+                    refresh(*member);
+                }
+                reconnect_thread_ = std::thread([this]() { reconnect_loop(); });
+                echo::debug("RemotePool constructed, endpoints=", members_.size(), " connected=", connected_count());
+            }
+
+            /// Must not run while calls are in flight
+            ~RemotePool() {
+                {
+                    std::lock_guard<std::mutex> lock(reconnect_mutex_);
+                    stopping_ = true;
+                }
+                reconnect_cv_.notify_all();
+                if (reconnect_thread_.joinable()) {
+                    reconnect_thread_.join();
+                }
+                members_.clear();
+                if (owns_executor_) {
+                    executor_->shutdown();
+                }
+            }
+
+            RemotePool(const RemotePool &) = delete;
+            RemotePool &operator=(const RemotePool &) = delete;
+
+            /// Call a method on one of the servers
+            /// @return The server's response, or an io_error when no endpoint is connected
+            dp::Res<Message> call(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000) {
+                Member *member = pick();
+                std::shared_ptr<Connection> connection;
+                if (member) {
+                    std::lock_guard<std::mutex> lock(member->mutex);
+                    connection = member->connection;
+                }
+                if (!connection) {
+                    echo::warn("remote pool has no connected endpoint");
+                    return dp::result::err(dp::Error::io_error("no connected endpoint"));
+                }
+
+                member->outstanding.fetch_add(1, std::memory_order_relaxed);
+                auto res = connection->remote->call(method_id, request, timeout_ms);
+                member->outstanding.fetch_sub(1, std::memory_order_relaxed);
+                member->calls.fetch_add(1, std::memory_order_relaxed);
+
+                // Stop routing here at once; the reconnect thread replaces the connection
+                if (!connection->stream->is_connected()) {
+                    member->connected = false;
+                }
+                return res;
+            }
+
+            /// Wake the reconnect thread now instead of at its next interval
+            void reconnect_now() { reconnect_cv_.notify_all(); }
+
+            dp::usize endpoint_count() const { return members_.size(); }
+
+            /// Endpoints that currently have a live connection
+            dp::usize connected_count() const {
+                dp::usize count = 0;
+                for (const auto &member : members_) {
+                    count += member->connected ? 1 : 0;
+                }
+                return count;
+            }
+
+            bool is_connected(dp::usize index) const { return members_[index]->connected; }
+
+            /// Calls in flight on endpoint index
+            dp::usize outstanding(dp::usize index) const { return members_[index]->outstanding.load(); }
+
+            /// Calls that have completed on endpoint index, successful or not
+            dp::u64 call_count(dp::usize index) const { return members_[index]->calls.load(); }
+        };
+
+    } // namespace remote
+
+    using BalancePolicy = remote::BalancePolicy;
+    using PoolConfig = remote::PoolConfig;
+    using PoolEndpoint = remote::PoolEndpoint;
+    using RemotePool = remote::RemotePool;
+
+} // namespace netpipe
@@ -1,15 +1,29 @@
 #pragma once
 
 #include <netpipe/common.hpp>
+#include <netpipe/remote/common.hpp>
 #include <netpipe/remote/version.hpp>
+#include <netpipe/stream.hpp>
 
 namespace netpipe {
     namespace remote {
 
+        /// Size of the fixed V2 header that precedes every payload
+        constexpr dp::usize V2_HEADER_SIZE = 16;
+
         /// Maximum message size (2GB by default)
         /// Messages exceeding this size will be rejected to prevent memory exhaustion
         constexpr dp::u64 MAX_MESSAGE_SIZE = 2ULL * 1024 * 1024 * 1024; // 2GB
 
+        /// Piece size when Remote<Bidirect>::set_fragmentation() is given no explicit size
+        constexpr dp::usize DEFAULT_FRAGMENT_SIZE = 256 * 1024;
+        /// Default reassembly limits per connection (Remote<Bidirect>::set_reassembly_limits)
+        constexpr dp::usize DEFAULT_MAX_PARTIAL_MESSAGES = 64;
+        constexpr dp::u64 DEFAULT_MAX_PARTIAL_BYTES = 256ULL * 1024 * 1024;
+        constexpr dp::u32 DEFAULT_PARTIAL_EXPIRY_MS = 30000;
+        /// Dropped fragmented messages remembered so their remaining pieces are skipped
+        constexpr dp::usize MAX_DROPPED_PARTIALS = 1024;
+
         /// Message types
         enum class MessageType : dp::u8 {
             Request = 0,      // Client request
@@ -19,41 +33,61 @@ namespace netpipe {
             StreamData = 4,   // Streaming data chunk
             StreamEnd = 5,    // End of stream
             StreamError = 6,  // Stream error
-            Cancel = 7        // Cancel in-flight request
+            Cancel = 7,       // Cancel in-flight request
+            StreamCredit = 8  // Flow-control grant for a stream: [chunks:4][bytes:4]
         };
 
         /// Message flags (bitfield)
         namespace MessageFlags {
             constexpr dp::u16 None = 0x0000;
-            constexpr dp::u16 Compressed = 0x0001;  // Payload is compressed
-            constexpr dp::u16 Streaming = 0x0002;   // Part of a stream
-            constexpr dp::u16 RequiresAck = 0x0004; // Requires acknowledgment
-            constexpr dp::u16 Final = 0x0008;       // Final message in sequence
+            constexpr dp::u16 Compressed = 0x0001;   // Payload is compressed
+            constexpr dp::u16 Streaming = 0x0002;    // Part of a stream
+            constexpr dp::u16 RequiresAck = 0x0004;  // Requires acknowledgment
+            constexpr dp::u16 Final = 0x0008;        // Final message in sequence
+            constexpr dp::u16 Deadline = 0x0010;     // Payload is followed by a deadline trailer
+            constexpr dp::u16 Fragment = 0x0020;     // One piece of a larger message; the piece with Final ends it
+            constexpr dp::u16 PriorityMask = 0x00C0; // Caller's priority class, see priority_flags()
+            constexpr dp::u16 Batch = 0x0100;        // StreamData payload is several chunks, [length:4][chunk]...
         } // namespace MessageFlags
 
+        /// Priority bits for a request of the given class
+        /// Normal leaves the bits clear, so the receiver falls back to the priority registered for the method and
+        /// peers that predate priorities keep sending and reading clean headers. Codes: 1 Low, 2 High, 3 Critical.
+        inline dp::u16 priority_flags(Priority priority) {
+            constexpr dp::u16 codes[PRIORITY_LEVELS] = {1, 0, 2, 3};
+            return static_cast<dp::u16>(codes[static_cast<dp::usize>(priority)] << 6);
+        }
+
+        /// Priority carried by flags, or fallback when they carry none
+        inline Priority flags_priority(dp::u16 flags, Priority fallback) {
+            constexpr Priority classes[4] = {Priority::Normal, Priority::Low, Priority::High, Priority::Critical};
+            dp::u16 code = (flags & MessageFlags::PriorityMask) >> 6;
+            return code == 0 ? fallback : classes[code];
+        }
+
+        /// Size of the optional deadline trailer: [budget_ms:4], the time the caller still waits when it sends
+        /// A relative budget needs no clock agreement between peers; the receiver restarts it on arrival.
+        /// Gated by MessageFlags::Deadline and counted in the header length, so it costs nothing when unused.
+        constexpr dp::usize DEADLINE_TRAILER_SIZE = 4;
+
         /// Wire protocol definitions for Remote RPC
         /// V1 Format: [request_id:4][is_error:1][length:4][payload:N]
         /// V2 Format: [version:1][type:1][flags:2][request_id:4][method_id:4][length:4][payload:N]
+        ///            [deadline_ms:4] follows the payload when flags has MessageFlags::Deadline
         /// All multi-byte integers are big-endian
 
         /// Encode Remote message: [request_id:4][is_error:1][length:4][payload:N]
         inline Message encode_remote_message(dp::u32 request_id, const Message &payload, bool is_error = false) {
-            Message msg;
-
-            // Encode request_id (4 bytes big-endian)
+            // Sized once, header fields stored at their offsets
+            Message msg(9 + payload.size());
             auto id_bytes = encode_u32_be(request_id);
-            msg.insert(msg.end(), id_bytes.begin(), id_bytes.end());
-
-            // Encode is_error flag (1 byte)
-            msg.push_back(is_error ? 1 : 0);
-
-            // Encode payload length (4 bytes big-endian)
             auto len_bytes = encode_u32_be(static_cast<dp::u32>(payload.size()));
-            msg.insert(msg.end(), len_bytes.begin(), len_bytes.end());
-
-            // Append payload
-            msg.insert(msg.end(), payload.begin(), payload.end());
-
+            std::memcpy(msg.data(), id_bytes.data(), 4);
+            msg[4] = is_error ? 1 : 0;
+            std::memcpy(msg.data() + 5, len_bytes.data(), 4);
+            if (!payload.empty()) {
+                std::memcpy(msg.data() + 9, payload.data(), payload.size());
+            }
             return msg;
         }
 
@@ -122,70 +156,177 @@ namespace netpipe {
             dp::u32 request_id;
             dp::u32 method_id;
             Message payload;
+            dp::u32 deadline_ms = 0; // Caller's remaining budget, 0 when the message carries none
         };
 
-        /// Encode V2 Remote message: [version:1][type:1][flags:2][request_id:4][method_id:4][length:4][payload:N]
-        inline Message encode_remote_message_v2(dp::u32 request_id, dp::u32 method_id, const Message &payload,
-                                                MessageType type = MessageType::Request,
-                                                dp::u16 flags = MessageFlags::None) {
-            Message msg;
-
-            // Encode version (1 byte)
-            msg.push_back(PROTOCOL_VERSION_2);
-
-            // Encode type (1 byte)
-            msg.push_back(static_cast<dp::u8>(type));
+        /// Write the V2 header for a payload of the given length into the V2_HEADER_SIZE bytes at out
+        /// [version:1][type:1][flags:2][request_id:4][method_id:4][length:4]
+        inline void write_remote_header_v2(dp::u8 *out, dp::u32 request_id, dp::u32 method_id,
+                                           dp::u32 payload_length, MessageType type = MessageType::Request,
+                                           dp::u16 flags = MessageFlags::None) {
+            // Encode version and type (1 byte each)
+            out[0] = PROTOCOL_VERSION_2;
+            out[1] = static_cast<dp::u8>(type);
 
             // Encode flags (2 bytes big-endian)
-            msg.push_back(static_cast<dp::u8>((flags >> 8) & 0xFF));
-            msg.push_back(static_cast<dp::u8>(flags & 0xFF));
+            out[2] = static_cast<dp::u8>((flags >> 8) & 0xFF);
+            out[3] = static_cast<dp::u8>(flags & 0xFF);
 
-            // Encode request_id (4 bytes big-endian)
+            // Encode request_id, method_id and payload length (4 bytes big-endian each)
             auto id_bytes = encode_u32_be(request_id);
-            msg.insert(msg.end(), id_bytes.begin(), id_bytes.end());
-
-            // Encode method_id (4 bytes big-endian)
             auto method_bytes = encode_u32_be(method_id);
-            msg.insert(msg.end(), method_bytes.begin(), method_bytes.end());
+            auto len_bytes = encode_u32_be(payload_length);
+            std::memcpy(out + 4, id_bytes.data(), 4);
+            std::memcpy(out + 8, method_bytes.data(), 4);
+            std::memcpy(out + 12, len_bytes.data(), 4);
+        }
 
-            // Encode payload length (4 bytes big-endian)
-            auto len_bytes = encode_u32_be(static_cast<dp::u32>(payload.size()));
-            msg.insert(msg.end(), len_bytes.begin(), len_bytes.end());
+        /// BudgetExemption for V2 streams: replies and control frames are read even with the budget spent, so a
+        /// handler that holds budget and waits on a nested call still gets its answer. Requests, notifications and
+        /// stream data wait for budget as before.
+        inline bool budget_exempt_v2(const dp::u8 *frame, dp::usize size) {
+            if (size < 2 || frame[0] != PROTOCOL_VERSION_2) {
+                return false;
+            }
+            switch (static_cast<MessageType>(frame[1])) {
+            case MessageType::Response:
+            case MessageType::Error:
+            case MessageType::Cancel:
+            case MessageType::StreamCredit:
+            case MessageType::StreamError:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        /// Encode only the V2 header for a payload of the given length
+        inline dp::Array<dp::u8, V2_HEADER_SIZE> encode_remote_header_v2(dp::u32 request_id, dp::u32 method_id,
+                                                                         dp::u32 payload_length,
+                                                                         MessageType type = MessageType::Request,
+                                                                         dp::u16 flags = MessageFlags::None) {
+            dp::Array<dp::u8, V2_HEADER_SIZE> header;
+            write_remote_header_v2(header.data(), request_id, method_id, payload_length, type, flags);
+            return header;
+        }
+
+        /// Encode V2 Remote message: [version:1][type:1][flags:2][request_id:4][method_id:4][length:4][payload:N]
+        /// @param deadline_ms Non-zero appends a deadline trailer with this budget
+        inline Message encode_remote_message_v2(dp::u32 request_id, dp::u32 method_id, const Message &payload,
+                                                MessageType type = MessageType::Request,
+                                                dp::u16 flags = MessageFlags::None, dp::u32 deadline_ms = 0) {
+            dp::usize trailer = deadline_ms != 0 ? DEADLINE_TRAILER_SIZE : 0;
+            if (trailer) {
+                flags |= MessageFlags::Deadline;
+            }
 
-            // Append payload
-            msg.insert(msg.end(), payload.begin(), payload.end());
+            // Single allocation for header + payload
+            Message msg(V2_HEADER_SIZE + payload.size() + trailer);
+            write_remote_header_v2(msg.data(), request_id, method_id, static_cast<dp::u32>(payload.size() + trailer),
+                                   type, flags);
+            if (!payload.empty()) {
+                std::memcpy(msg.data() + V2_HEADER_SIZE, payload.data(), payload.size());
+            }
+            if (trailer) {
+                auto budget = encode_u32_be(deadline_ms);
+                std::memcpy(msg.data() + V2_HEADER_SIZE + payload.size(), budget.data(), trailer);
+            }
 
             return msg;
         }
 
-        /// Decode V2 Remote message: extract all fields
-        inline dp::Res<DecodedMessageV2> decode_remote_message_v2(const Message &msg) {
-            if (msg.size() < 16) {
-                echo::error("remote v2 message too short: ", msg.size());
+        /// Send a V2 frame whose payload is length bytes at data, header and payload as separate buffers
+        /// Streams that support scatter/gather write both without copying the payload
+        /// @param deadline_ms Non-zero appends a deadline trailer with this budget
+        inline dp::Res<void> send_remote_frame_v2(Stream &stream, dp::u32 request_id, dp::u32 method_id,
+                                                  const dp::u8 *data, dp::usize length, MessageType type,
+                                                  dp::u16 flags = MessageFlags::None, dp::u32 deadline_ms = 0) {
+            dp::usize trailer = deadline_ms != 0 ? DEADLINE_TRAILER_SIZE : 0;
+            if (trailer) {
+                flags |= MessageFlags::Deadline;
+            }
+            auto header =
+                encode_remote_header_v2(request_id, method_id, static_cast<dp::u32>(length + trailer), type, flags);
+            auto budget = encode_u32_be(deadline_ms);
+
+            iovec parts[3];
+            dp::usize count = 0;
+            parts[count++] = {header.data(), V2_HEADER_SIZE};
+            if (length > 0) {
+                parts[count++] = {const_cast<dp::u8 *>(data), length};
+            }
+            if (trailer) {
+                parts[count++] = {budget.data(), trailer};
+            }
+            return stream.send_iov(std::span<const iovec>(parts, count));
+        }
+
+        /// Send a V2 Remote message with header and payload as separate buffers
+        /// @param deadline_ms Non-zero appends a deadline trailer with this budget
+        inline dp::Res<void> send_remote_message_v2(Stream &stream, dp::u32 request_id, dp::u32 method_id,
+                                                    const Message &payload, MessageType type = MessageType::Request,
+                                                    dp::u16 flags = MessageFlags::None, dp::u32 deadline_ms = 0) {
+            return send_remote_frame_v2(stream, request_id, method_id, payload.data(), payload.size(), type, flags,
+                                        deadline_ms);
+        }
+
+        /// V2 message decoded in place: header fields plus a view of the payload
+        /// Does not own the payload - valid only while the buffer it was decoded from is alive and unchanged
+        struct DecodedMessageView {
+            dp::u8 version;
+            MessageType type;
+            dp::u16 flags;
+            dp::u32 request_id;
+            dp::u32 method_id;
+            std::span<const dp::u8> payload;
+            dp::u32 deadline_ms = 0;
+        };
+
+        /// Split the deadline trailer off a received payload of length bytes (see MessageFlags::Deadline)
+        /// Returns the payload length without it and stores the budget in deadline_ms (0 when absent)
+        inline dp::Res<dp::u32> take_deadline_trailer(dp::u16 flags, const dp::u8 *payload, dp::u32 length,
+                                                      dp::u32 &deadline_ms) {
+            deadline_ms = 0;
+            if (!(flags & MessageFlags::Deadline)) {
+                return dp::result::ok(length);
+            }
+            if (length < DEADLINE_TRAILER_SIZE) {
+                echo::error("remote v2 deadline trailer truncated: ", length);
+                return dp::result::err(dp::Error::invalid_argument("deadline trailer truncated"));
+            }
+            length -= DEADLINE_TRAILER_SIZE;
+            deadline_ms = decode_u32_be(payload + length);
+            return dp::result::ok(length);
+        }
+
+        /// Decode and validate a V2 header (header_len bytes available at header)
+        /// Fills the header fields of out and returns the payload length announced by the header
+        inline dp::Res<dp::u32> decode_remote_header_v2(const dp::u8 *header, dp::usize header_len,
+                                                        DecodedMessageView &out) {
+            if (header_len < V2_HEADER_SIZE) {
+                echo::error("remote v2 message too short: ", header_len);
                 return dp::result::err(dp::Error::invalid_argument("message too short"));
             }
 
             // Decode version
-            dp::u8 version = msg[0];
-            if (version != PROTOCOL_VERSION_2) {
-                echo::error("unsupported protocol version: ", static_cast<int>(version));
+            out.version = header[0];
+            if (out.version != PROTOCOL_VERSION_2) {
+                echo::error("unsupported protocol version: ", static_cast<int>(out.version));
                 return dp::result::err(dp::Error::invalid_argument("unsupported protocol version"));
             }
 
             // Decode type
-            MessageType type = static_cast<MessageType>(msg[1]);
+            out.type = static_cast<MessageType>(header[1]);
 
             // Decode flags (2 bytes big-endian)
-            dp::u16 flags = (static_cast<dp::u16>(msg[2]) << 8) | static_cast<dp::u16>(msg[3]);
-
-            // Decode request_id
-            dp::u32 request_id = decode_u32_be(msg.data() + 4);
+            out.flags = (static_cast<dp::u16>(header[2]) << 8) | static_cast<dp::u16>(header[3]);
 
-            // Decode method_id
-            dp::u32 method_id = decode_u32_be(msg.data() + 8);
+            // Decode request_id and method_id
+            out.request_id = decode_u32_be(header + 4);
+            out.method_id = decode_u32_be(header + 8);
 
             // Decode payload length
-            dp::u32 payload_length = decode_u32_be(msg.data() + 12);
+            dp::u32 payload_length = decode_u32_be(header + 12);
 
             // Validate payload length against maximum
             if (payload_length > MAX_MESSAGE_SIZE) {
@@ -193,16 +334,92 @@ namespace netpipe {
                 return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
             }
 
+            return dp::result::ok(payload_length);
+        }
+
+        /// Decode V2 Remote message without copying: payload is a span into msg
+        inline dp::Res<DecodedMessageView> decode_remote_message_v2_view(const Message &msg) {
+            DecodedMessageView view{};
+            auto header_res = decode_remote_header_v2(msg.data(), msg.size(), view);
+            if (header_res.is_err()) {
+                return dp::result::err(header_res.error());
+            }
+            dp::u32 payload_length = header_res.value();
+
             // Verify message size
-            if (msg.size() != 16 + payload_length) {
-                echo::error("remote v2 message size mismatch: expected ", 16 + payload_length, " got ", msg.size());
+            if (msg.size() != V2_HEADER_SIZE + payload_length) {
+                echo::error("remote v2 message size mismatch: expected ", V2_HEADER_SIZE + payload_length, " got ",
+                            msg.size());
                 return dp::result::err(dp::Error::invalid_argument("message size mismatch"));
             }
 
+            auto body_res =
+                take_deadline_trailer(view.flags, msg.data() + V2_HEADER_SIZE, payload_length, view.deadline_ms);
+            if (body_res.is_err()) {
+                return dp::result::err(body_res.error());
+            }
+            view.payload = std::span<const dp::u8>(msg.data() + V2_HEADER_SIZE, body_res.value());
+            return dp::result::ok(view);
+        }
+
+        /// Decode V2 Remote message into an existing result, reusing its payload capacity
+        /// Lets a receive loop decode every message without allocating once warmed up
+        inline dp::Res<void> decode_remote_message_v2_into(const Message &msg, DecodedMessageV2 &out) {
+            auto view_res = decode_remote_message_v2_view(msg);
+            if (view_res.is_err()) {
+                return dp::result::err(view_res.error());
+            }
+            const auto &view = view_res.value();
+
+            out.version = view.version;
+            out.type = view.type;
+            out.flags = view.flags;
+            out.request_id = view.request_id;
+            out.method_id = view.method_id;
+            out.deadline_ms = view.deadline_ms;
+
             // Extract payload
-            Message payload(msg.begin() + 16, msg.end());
+            out.payload.assign(view.payload.begin(), view.payload.end());
+            return dp::result::ok();
+        }
+
+        /// Decode V2 Remote message: extract all fields
+        inline dp::Res<DecodedMessageV2> decode_remote_message_v2(const Message &msg) {
+            DecodedMessageV2 decoded{};
+            auto res = decode_remote_message_v2_into(msg, decoded);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(decoded));
+        }
+
+        /// Decode V2 Remote message received as separate header and payload (see Stream::recv_split)
+        /// The payload buffer is moved into the result, so it is never copied after leaving the transport
+        inline dp::Res<DecodedMessageV2> decode_remote_message_v2(const dp::u8 *header, dp::usize header_len,
+                                                                  Message payload) {
+            DecodedMessageView view{};
+            auto header_res = decode_remote_header_v2(header, header_len, view);
+            if (header_res.is_err()) {
+                return dp::result::err(header_res.error());
+            }
+
+            // Verify message size
+            if (payload.size() != header_res.value()) {
+                echo::error("remote v2 message size mismatch: expected ", header_res.value(), " payload bytes got ",
+                            payload.size());
+                return dp::result::err(dp::Error::invalid_argument("message size mismatch"));
+            }
+
+            dp::u32 deadline_ms = 0;
+            auto body_res = take_deadline_trailer(view.flags, payload.data(), static_cast<dp::u32>(payload.size()),
+                                                  deadline_ms);
+            if (body_res.is_err()) {
+                return dp::result::err(body_res.error());
+            }
+            payload.resize(body_res.value()); // Dropping the trailer never reallocates
 
-            DecodedMessageV2 decoded{version, type, flags, request_id, method_id, std::move(payload)};
+            DecodedMessageV2 decoded{view.version,    view.type,          view.flags, view.request_id,
+                                     view.method_id, std::move(payload), deadline_ms};
             return dp::result::ok(std::move(decoded));
         }
 
@@ -225,7 +442,7 @@ namespace netpipe {
                 if (v1_res.is_err()) {
                     return dp::result::err(v1_res.error());
                 }
-                auto v1_decoded = v1_res.value();
+                auto v1_decoded = std::move(v1_res.value());
 
                 // Convert V1 to V2 format
                 MessageType type = v1_decoded.is_error ? MessageType::Error : MessageType::Response;
@@ -1,52 +1,193 @@
 #pragma once
 
-#include <map>
+#include <memory>
+#include <netpipe/remote/cache.hpp>
 #include <netpipe/remote/common.hpp>
+#include <optional>
+#include <unordered_map>
 
 namespace netpipe {
     namespace remote {
 
+        /// A method bound at compile time for StaticRegistry
+        /// Fn is a function or captureless lambda taking const Message & and returning dp::Res<Message>
+        template <dp::u32 Id, auto Fn> struct Method {
+            static constexpr dp::u32 id = Id;
+            static dp::Res<Message> call(const Message &request) { return Fn(request); }
+        };
+
+        /// Method table fixed at compile time: no std::function, no lookup structure
+        /// dispatch() is a chain of constant comparisons the compiler folds into a switch with every handler
+        /// inlined. Mount it into a MethodRegistry (register_static_methods on the Remotes) to serve it.
+        template <typename... Methods> struct StaticRegistry {
+          private:
+            static constexpr bool unique_ids() {
+                constexpr dp::u32 ids[] = {Methods::id..., 0};
+                for (dp::usize i = 0; i < sizeof...(Methods); i++) {
+                    for (dp::usize j = i + 1; j < sizeof...(Methods); j++) {
+                        if (ids[i] == ids[j]) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            }
+            static_assert(unique_ids(), "StaticRegistry method ids must be unique");
+
+          public:
+            static constexpr dp::usize size = sizeof...(Methods);
+
+            static constexpr bool contains(dp::u32 method_id) { return ((method_id == Methods::id) || ...); }
+
+            /// Result of the method's handler, or nullopt when no method has this id
+            static std::optional<dp::Res<Message>> dispatch(dp::u32 method_id, const Message &request) {
+                std::optional<dp::Res<Message>> out;
+                ((method_id == Methods::id ? (out.emplace(Methods::call(request)), true) : false) || ...);
+                return out;
+            }
+        };
+
         /// Method registry for routing RPC calls to different handlers
-        /// Maps method_id to handler functions
+        /// Ids below DENSE_METHODS sit in a flat table indexed by id, larger ones in a hash map; lookups hand out
+        /// a pointer to the stored handler instead of copying the std::function
         class MethodRegistry {
+          public:
+            static constexpr dp::u32 DENSE_METHODS = 256;
+
           private:
-            std::map<dp::u32, Handler> handlers_;
+            using StaticDispatch = std::optional<dp::Res<Message>> (*)(dp::u32, const Message &);
+            using StaticContains = bool (*)(dp::u32);
+
+            // Allocated on first use and never resized, so pointers from find() survive later registrations
+            std::unique_ptr<Handler[]> dense_;
+            std::unordered_map<dp::u32, Handler> sparse_;
+            dp::usize count_;
             Handler default_handler_;
             bool has_default_;
 
+            // Priority class per method id, split dense/sparse like the handlers; absent means Normal
+            std::unique_ptr<Priority[]> dense_priorities_;
+            std::unordered_map<dp::u32, Priority> sparse_priorities_;
+
+            // Responses of the methods marked with set_cached()
+            ResponseCache cache_;
+
+            // Mounted StaticRegistry, consulted before the dynamic tables
+            StaticDispatch static_dispatch_;
+            StaticContains static_contains_;
+            dp::usize static_count_;
+
+            Handler *slot(dp::u32 method_id) {
+                if (method_id < DENSE_METHODS) {
+                    return dense_ && dense_[method_id] ? &dense_[method_id] : nullptr;
+                }
+                auto it = sparse_.find(method_id);
+                return it == sparse_.end() ? nullptr : &it->second;
+            }
+            const Handler *slot(dp::u32 method_id) const { return const_cast<MethodRegistry *>(this)->slot(method_id); }
+
           public:
-            MethodRegistry() : has_default_(false) { echo::trace("MethodRegistry constructed"); }
+            MethodRegistry()
+                : count_(0), has_default_(false), static_dispatch_(nullptr), static_contains_(nullptr),
+                  static_count_(0) {
+                echo::trace("MethodRegistry constructed");
+            }
 
             /// Register a handler for a specific method_id
             /// @param method_id The method identifier
             /// @param handler The handler function
             /// @return Error if method_id already registered
             dp::Res<void> register_method(dp::u32 method_id, Handler handler) {
-                if (handlers_.find(method_id) != handlers_.end()) {
+                if (has_method(method_id)) {
                     echo::error("method_id already registered: ", method_id);
                     return dp::result::err(dp::Error::invalid_argument("method_id already registered"));
                 }
 
-                handlers_[method_id] = handler;
+                if (method_id < DENSE_METHODS) {
+                    if (!dense_) {
+                        dense_ = std::make_unique<Handler[]>(DENSE_METHODS);
+                    }
+                    dense_[method_id] = std::move(handler);
+                } else {
+                    sparse_[method_id] = std::move(handler);
+                }
+                count_++;
                 echo::debug("registered method_id: ", method_id);
                 return dp::result::ok();
             }
 
             /// Unregister a handler for a specific method_id
+            /// Must not race with a dispatch of the same method_id
             /// @param method_id The method identifier
             /// @return Error if method_id not found
             dp::Res<void> unregister_method(dp::u32 method_id) {
-                auto it = handlers_.find(method_id);
-                if (it == handlers_.end()) {
+                if (!slot(method_id)) {
                     echo::error("method_id not found: ", method_id);
                     return dp::result::err(dp::Error::not_found("method_id not found"));
                 }
 
-                handlers_.erase(it);
+                if (method_id < DENSE_METHODS) {
+                    dense_[method_id] = nullptr;
+                } else {
+                    sparse_.erase(method_id);
+                }
+                count_--;
                 echo::debug("unregistered method_id: ", method_id);
                 return dp::result::ok();
             }
 
+            /// Priority class for method_id, whether or not a handler is registered for it
+            /// Decides where incoming requests queue and what outgoing calls to the method carry by default.
+            /// Set before serving, like the handlers.
+            void set_priority(dp::u32 method_id, Priority priority) {
+                if (method_id < DENSE_METHODS) {
+                    if (!dense_priorities_) {
+                        dense_priorities_ = std::make_unique<Priority[]>(DENSE_METHODS);
+                        for (dp::u32 i = 0; i < DENSE_METHODS; i++) {
+                            dense_priorities_[i] = Priority::Normal;
+                        }
+                    }
+                    dense_priorities_[method_id] = priority;
+                } else if (priority == Priority::Normal) {
+                    sparse_priorities_.erase(method_id);
+                } else {
+                    sparse_priorities_[method_id] = priority;
+                }
+                echo::debug("method_id ", method_id, " priority ", static_cast<int>(priority));
+            }
+
+            /// Priority class of method_id (Normal unless set_priority() said otherwise)
+            Priority priority(dp::u32 method_id) const {
+                if (method_id < DENSE_METHODS) {
+                    return dense_priorities_ ? dense_priorities_[method_id] : Priority::Normal;
+                }
+                auto it = sparse_priorities_.find(method_id);
+                return it == sparse_priorities_.end() ? Priority::Normal : it->second;
+            }
+
+            /// Answer repeated requests to method_id from the response cache instead of running its handler
+            /// Only for idempotent methods (a lookup or a read of state that invalidate_cached() keeps honest).
+            /// ttl_ms 0 keeps an answer until it is evicted or invalidated; errors are never cached.
+            void set_cached(dp::u32 method_id, dp::u32 ttl_ms = 0) { cache_.enable(method_id, ttl_ms); }
+
+            /// Stop caching method_id and forget its stored answers
+            void clear_cached(dp::u32 method_id) { cache_.disable(method_id); }
+
+            /// Forget the stored answers of method_id, e.g. after the data behind it changed
+            dp::usize invalidate_cached(dp::u32 method_id) { return cache_.invalidate(method_id); }
+
+            /// The response cache, for lookups on the request path, capacity and statistics
+            ResponseCache &cache() { return cache_; }
+            const ResponseCache &cache() const { return cache_; }
+
+            /// Serve the methods of a StaticRegistry; they take precedence over registered handlers
+            template <typename Table> void mount() {
+                static_dispatch_ = &Table::dispatch;
+                static_contains_ = &Table::contains;
+                static_count_ = Table::size;
+                echo::debug("mounted ", Table::size, " static methods");
+            }
+
             /// Set a default handler for unknown method_ids
             /// @param handler The default handler function
             void set_default_handler(Handler handler) {
@@ -61,13 +202,44 @@ namespace netpipe {
                 echo::debug("cleared default handler");
             }
 
+            /// Handler that serves method_id (falling back to the default handler), or nullptr
+            /// Does not see mounted static methods - use dispatch() to run a request
+            const Handler *find(dp::u32 method_id) const {
+                if (const Handler *handler = slot(method_id)) {
+                    return handler;
+                }
+                return has_default_ ? &default_handler_ : nullptr;
+            }
+
+            /// Whether dispatch() would run a handler for method_id
+            bool resolves(dp::u32 method_id) const {
+                return (static_contains_ && static_contains_(method_id)) || find(method_id);
+            }
+
+            /// Run the handler for method_id: static methods first, then registered ones, then the default
+            /// @return The handler's result, or nullopt when nothing serves method_id
+            std::optional<dp::Res<Message>> dispatch(dp::u32 method_id, const Message &request) const {
+                if (static_dispatch_) {
+                    auto result = static_dispatch_(method_id, request);
+                    if (result) {
+                        return result;
+                    }
+                }
+                const Handler *handler = find(method_id);
+                if (!handler) {
+                    echo::error("no handler for method_id: ", method_id);
+                    return std::nullopt;
+                }
+                return (*handler)(request);
+            }
+
             /// Get handler for a method_id
+            /// Copies the std::function; request paths use dispatch() instead
             /// @param method_id The method identifier
             /// @return Handler if found, error otherwise
             dp::Res<Handler> get_handler(dp::u32 method_id) const {
-                auto it = handlers_.find(method_id);
-                if (it != handlers_.end()) {
-                    return dp::result::ok(it->second);
+                if (const Handler *handler = slot(method_id)) {
+                    return dp::result::ok(*handler);
                 }
 
                 if (has_default_) {
@@ -82,15 +254,25 @@ namespace netpipe {
             /// Check if a method_id is registered
             /// @param method_id The method identifier
             /// @return true if registered, false otherwise
-            bool has_method(dp::u32 method_id) const { return handlers_.find(method_id) != handlers_.end(); }
+            bool has_method(dp::u32 method_id) const {
+                return slot(method_id) != nullptr || (static_contains_ && static_contains_(method_id));
+            }
 
             /// Get number of registered methods
-            /// @return Number of registered methods (excluding default)
-            dp::usize method_count() const { return handlers_.size(); }
+            /// @return Number of registered methods, static ones included (excluding default)
+            dp::usize method_count() const { return count_ + static_count_; }
 
-            /// Clear all registered methods
+            /// Clear all registered methods, and unmount a mounted StaticRegistry
             void clear() {
-                handlers_.clear();
+                dense_.reset();
+                sparse_.clear();
+                dense_priorities_.reset();
+                sparse_priorities_.clear();
+                cache_.clear();
+                count_ = 0;
+                static_dispatch_ = nullptr;
+                static_contains_ = nullptr;
+                static_count_ = 0;
                 echo::debug("cleared all methods");
             }
         };
@@ -1,111 +1,32 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstring>
 #include <functional>
 #include <mutex>
 #include <netpipe/remote/async.hpp>
+#include <netpipe/remote/compression.hpp>
+#include <netpipe/remote/deadline.hpp>
+#include <netpipe/remote/executor.hpp>
+#include <netpipe/remote/latency.hpp>
 #include <netpipe/remote/metrics.hpp>
+#include <netpipe/remote/pending.hpp>
 #include <netpipe/remote/protocol.hpp>
 #include <netpipe/remote/registry.hpp>
+#include <netpipe/remote/writer.hpp>
 #include <netpipe/stream.hpp>
-#include <queue>
+#include <netpipe/timer.hpp>
+#include <optional>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace netpipe {
     namespace remote {
 
-        /// Simple thread pool for handler execution
-        /// Fixed-size pool with task queue
-        class ThreadPool {
-          private:
-            std::vector<std::thread> workers_;
-            std::queue<std::function<void()>> tasks_;
-            mutable std::mutex queue_mutex_;
-            std::condition_variable condition_;
-            std::atomic<bool> stop_;
-            std::atomic<dp::usize> active_tasks_;
-            dp::usize max_queue_size_;
-
-          public:
-            explicit ThreadPool(dp::usize num_threads = 10, dp::usize max_queue_size = 1000)
-                : stop_(false), active_tasks_(0), max_queue_size_(max_queue_size) {
-                echo::trace("ThreadPool created with ", num_threads, " threads, max_queue=", max_queue_size);
-
-                for (dp::usize i = 0; i < num_threads; ++i) {
-                    workers_.emplace_back([this] {
-                        while (true) {
-                            std::function<void()> task;
-                            {
-                                std::unique_lock<std::mutex> lock(queue_mutex_);
-                                condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
-
-                                if (stop_ && tasks_.empty()) {
-                                    return;
-                                }
-
-                                if (!tasks_.empty()) {
-                                    task = std::move(tasks_.front());
-                                    tasks_.pop();
-                                }
-                            }
-
-                            if (task) {
-                                active_tasks_++;
-                                task();
-                                active_tasks_--;
-                            }
-                        }
-                    });
-                }
-            }
-
-            ~ThreadPool() { shutdown(); }
-
-            /// Submit a task to the pool
-            /// Returns false if queue is full
-            bool submit(std::function<void()> task) {
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
-                    if (tasks_.size() >= max_queue_size_) {
-                        echo::warn("ThreadPool queue full (", tasks_.size(), "/", max_queue_size_, ")");
-                        return false;
-                    }
-                    tasks_.push(std::move(task));
-                }
-                condition_.notify_one();
-                return true;
-            }
-
-            /// Get number of active tasks
-            dp::usize active_count() const { return active_tasks_.load(); }
-
-            /// Get number of queued tasks
-            dp::usize queued_count() const {
-                std::unique_lock<std::mutex> lock(queue_mutex_);
-                return tasks_.size();
-            }
-
-            /// Shutdown the pool and wait for all tasks to complete
-            void shutdown() {
-                if (stop_) {
-                    return;
-                }
-
-                echo::trace("ThreadPool shutting down, active=", active_tasks_.load(), " queued=", tasks_.size());
-                stop_ = true;
-                condition_.notify_all();
-
-                for (auto &worker : workers_) {
-                    if (worker.joinable()) {
-                        worker.join();
-                    }
-                }
-                echo::trace("ThreadPool shutdown complete");
-            }
-        };
-
         /// Remote mode tags
         struct Unidirect {};
         struct Bidirect {};
@@ -113,23 +34,80 @@ namespace netpipe {
         /// Remote RPC - template specializations for different modes
         template <typename Mode> class Remote;
 
+        /// One call of a pipelined batch (see Remote<Unidirect>::call_batch)
+        struct BatchRequest {
+            dp::u32 method_id;
+            Message payload;
+        };
+
         /// Remote RPC - Unidirectional mode (client-only or server-only)
-        /// Simple synchronous request-response
+        /// Synchronous request-response; call_batch() pipelines several calls into one round trip
         template <> class Remote<Unidirect> {
           private:
+            /// A response serve() has produced but not written yet
+            struct OutgoingResponse {
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+                Message payload;
+                std::shared_ptr<const CachedResponse> cached; // Sent instead of payload on a cache hit, uncopied
+            };
+
             Stream &stream_;
             dp::u32 next_request_id_;
             MethodRegistry registry_;
+            Message recv_buffer_;      // Reused by serve() so steady-state requests do not allocate
+            DecodedMessageV2 request_; // Reused by serve() for decoding requests
+            PayloadCompressor compressor_;
+            Message inflate_buffer_; // Swapped with request_.payload when a request arrives compressed
+
+            // serve() read-ahead: responses held while more requests are already waiting, then written together
+            std::vector<OutgoingResponse> outbox_;
+            std::vector<iovec> batch_iov_;
+            std::vector<std::span<const iovec>> batch_frames_;
+
+            /// Write every queued response with one send_batch
+            dp::Res<void> flush_responses() {
+                if (outbox_.empty()) {
+                    return dp::result::ok();
+                }
+                batch_iov_.resize(outbox_.size() * 2);
+                batch_frames_.clear();
+                for (dp::usize i = 0; i < outbox_.size(); i++) {
+                    auto &response = outbox_[i];
+                    const Message &payload = response.cached ? response.cached->payload : response.payload;
+                    batch_iov_[2 * i] = {response.header.data(), V2_HEADER_SIZE};
+                    batch_iov_[2 * i + 1] = {const_cast<dp::u8 *>(payload.data()), payload.size()};
+                    batch_frames_.emplace_back(&batch_iov_[2 * i], payload.empty() ? 1 : 2);
+                }
+
+                auto res = stream_.send_batch(batch_frames_);
+                echo::trace("remote serve flushed ", outbox_.size(), " responses");
+                outbox_.clear();
+                return res;
+            }
 
           public:
-            explicit Remote(Stream &stream) : stream_(stream), next_request_id_(0) {
+            /// Most calls call_batch() puts on the wire before reading their responses
+            static constexpr dp::usize PIPELINE_WINDOW = 64;
+            /// Request bytes per window - keeps both directions inside the socket buffers
+            static constexpr dp::usize PIPELINE_WINDOW_BYTES = 256 * 1024;
+            /// Most responses serve() holds back while reading ahead
+            static constexpr dp::usize MAX_COALESCED_RESPONSES = 64;
+
+            explicit Remote(Stream &stream) : stream_(stream), next_request_id_(0), request_{} {
                 echo::trace("Remote<Unidirect> constructed");
             }
 
             /// Client side: send request and wait for response
             dp::Res<Message> call(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000) {
+                dp::u32 budget = DeadlineScope::clamp(timeout_ms);
+                if (budget == 0 && timeout_ms != 0) {
+                    return dp::result::err(dp::Error::timeout("deadline exceeded"));
+                }
+                timeout_ms = budget;
+
                 dp::u32 request_id = next_request_id_++;
                 echo::trace("remote call id=", request_id, " method=", method_id, " len=", request.size());
+                NETPIPE_TRACE(CallBegin, request_id, method_id, request.size());
 
                 // Set receive timeout
                 auto timeout_res = stream_.set_recv_timeout(timeout_ms);
@@ -137,31 +115,37 @@ namespace netpipe {
                     echo::warn("failed to set recv timeout: ", timeout_res.error().message.c_str());
                 }
 
-                // Encode request
-                Message remote_request = encode_remote_message_v2(request_id, method_id, request, MessageType::Request);
-
-                // Send request
-                auto send_res = stream_.send(remote_request);
+                // Send request (header and payload as separate buffers)
+                dp::u16 flags = MessageFlags::None;
+                const Message &wire = compressor_.apply(request, flags);
+                NETPIPE_TRACE(SendBegin, request_id, method_id, wire.size());
+                auto send_res =
+                    send_remote_message_v2(stream_, request_id, method_id, wire, MessageType::Request, flags);
+                NETPIPE_TRACE(SendEnd, request_id, method_id, wire.size());
                 if (send_res.is_err()) {
                     echo::error("remote send failed");
+                    NETPIPE_TRACE(CallEnd, request_id, method_id, 0);
                     return dp::result::err(send_res.error());
                 }
 
-                // Receive response
-                auto recv_res = stream_.recv();
+                // Receive response - header split off so the payload buffer can be returned as is
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+                Message payload;
+                auto recv_res = stream_.recv_split(header.data(), header.size(), payload);
+                NETPIPE_TRACE(CallEnd, request_id, method_id, recv_res.is_ok() ? payload.size() : 0);
                 if (recv_res.is_err()) {
                     echo::error("remote recv failed");
                     return dp::result::err(recv_res.error());
                 }
 
                 // Decode response
-                auto decode_res = decode_remote_message_v2(recv_res.value());
+                auto decode_res = decode_remote_message_v2(header.data(), recv_res.value(), std::move(payload));
                 if (decode_res.is_err()) {
                     echo::error("remote decode failed");
                     return dp::result::err(decode_res.error());
                 }
 
-                auto decoded = decode_res.value();
+                auto decoded = std::move(decode_res.value());
 
                 // Verify request_id matches
                 if (decoded.request_id != request_id) {
@@ -169,6 +153,12 @@ namespace netpipe {
                     return dp::result::err(dp::Error::invalid_argument("request_id mismatch"));
                 }
 
+                auto inflate_res = decompress_payload(decoded.flags, decoded.payload);
+                if (inflate_res.is_err()) {
+                    echo::error("remote response decompression failed");
+                    return dp::result::err(inflate_res.error());
+                }
+
                 // Check if response is an error
                 if (decoded.type == MessageType::Error) {
                     echo::error("remote call returned error");
@@ -181,6 +171,126 @@ namespace netpipe {
                 return dp::result::ok(std::move(decoded.payload));
             }
 
+            /// Client side: pipelined calls - requests go out in windows and responses come back in order
+            /// A window of up to PIPELINE_WINDOW calls (PIPELINE_WINDOW_BYTES of payload) costs one round trip
+            /// Returns one result per request; the outer error means the connection failed mid-batch
+            dp::Res<dp::Vector<dp::Res<Message>>> call_batch(std::span<const BatchRequest> requests,
+                                                             dp::u32 timeout_ms = 5000) {
+                echo::trace("remote call_batch count=", requests.size());
+                dp::Vector<dp::Res<Message>> results;
+
+                // Like call(), bounded by this thread's deadline; under one, every read gets only what is left of
+                // it, so the batch as a whole cannot outlive it
+                bool scoped = DeadlineScope::current() != DeadlineScope::Clock::time_point::max();
+                auto arm_timeout = [&]() -> bool {
+                    dp::u32 budget = DeadlineScope::clamp(timeout_ms);
+                    if (budget == 0 && timeout_ms != 0) {
+                        return false;
+                    }
+                    auto timeout_res = stream_.set_recv_timeout(budget);
+                    if (timeout_res.is_err()) {
+                        echo::warn("failed to set recv timeout: ", timeout_res.error().message.c_str());
+                    }
+                    return true;
+                };
+                if (!arm_timeout()) {
+                    return dp::result::err(dp::Error::timeout("deadline exceeded"));
+                }
+
+                std::vector<dp::Array<dp::u8, V2_HEADER_SIZE>> headers;
+                std::vector<iovec> iov;
+                std::vector<std::span<const iovec>> frames;
+                std::vector<Message> packed; // Compressed request payloads, reused across windows
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+
+                dp::usize next = 0;
+                while (next < requests.size()) {
+                    // Cut the next window; an oversized request still goes alone
+                    dp::usize start = next;
+                    dp::usize bytes = 0;
+                    while (next < requests.size() && next - start < PIPELINE_WINDOW &&
+                           (next == start || bytes + requests[next].payload.size() <= PIPELINE_WINDOW_BYTES)) {
+                        bytes += requests[next].payload.size();
+                        next++;
+                    }
+                    dp::usize count = next - start;
+                    dp::u32 first_id = next_request_id_;
+                    next_request_id_ += static_cast<dp::u32>(count);
+
+                    headers.resize(count);
+                    iov.resize(count * 2);
+                    packed.resize(count);
+                    frames.clear();
+                    for (dp::usize i = 0; i < count; i++) {
+                        const auto &request = requests[start + i];
+                        dp::u16 flags = MessageFlags::None;
+                        const Message &wire = compressor_.apply(request.payload, flags, packed[i]);
+                        headers[i] = encode_remote_header_v2(first_id + static_cast<dp::u32>(i), request.method_id,
+                                                             static_cast<dp::u32>(wire.size()), MessageType::Request,
+                                                             flags);
+                        iov[2 * i] = {headers[i].data(), V2_HEADER_SIZE};
+                        iov[2 * i + 1] = {const_cast<dp::u8 *>(wire.data()), wire.size()};
+                        frames.emplace_back(&iov[2 * i], wire.empty() ? 1 : 2);
+                    }
+
+                    auto send_res = stream_.send_batch(frames);
+                    if (send_res.is_err()) {
+                        echo::error("remote call_batch send failed");
+                        return dp::result::err(send_res.error());
+                    }
+
+                    // Responses arrive in request order
+                    for (dp::usize i = 0; i < count; i++) {
+                        if (scoped && (start > 0 || i > 0) && !arm_timeout()) {
+                            echo::error("remote call_batch deadline exceeded");
+                            return dp::result::err(dp::Error::timeout("deadline exceeded"));
+                        }
+                        Message payload;
+                        auto recv_res = stream_.recv_split(header.data(), header.size(), payload);
+                        if (recv_res.is_err()) {
+                            echo::error("remote call_batch recv failed");
+                            return dp::result::err(recv_res.error());
+                        }
+                        auto decode_res =
+                            decode_remote_message_v2(header.data(), recv_res.value(), std::move(payload));
+                        if (decode_res.is_err()) {
+                            return dp::result::err(decode_res.error());
+                        }
+
+                        auto decoded = std::move(decode_res.value());
+                        dp::u32 expected = first_id + static_cast<dp::u32>(i);
+                        if (decoded.request_id != expected) {
+                            echo::error("remote request_id mismatch: expected ", expected, " got ",
+                                        decoded.request_id);
+                            return dp::result::err(dp::Error::invalid_argument("request_id mismatch"));
+                        }
+
+                        auto inflate_res = decompress_payload(decoded.flags, decoded.payload);
+                        if (inflate_res.is_err()) {
+                            results.push_back(dp::result::err(inflate_res.error()));
+                            continue;
+                        }
+
+                        if (decoded.type == MessageType::Error) {
+                            dp::String error_msg(reinterpret_cast<const char *>(decoded.payload.data()),
+                                                 decoded.payload.size());
+                            results.push_back(dp::result::err(dp::Error::io_error(error_msg.c_str())));
+                        } else {
+                            results.push_back(dp::result::ok(std::move(decoded.payload)));
+                        }
+                    }
+                }
+
+                return dp::result::ok(std::move(results));
+            }
+
+            /// Compress outgoing payloads of at least threshold bytes with codec (nullptr turns it off)
+            /// Compressed messages are always accepted, so only the sending side needs this
+            void set_compression(std::shared_ptr<const Codec> codec,
+                                 dp::usize threshold = DEFAULT_COMPRESSION_THRESHOLD) {
+                compressor_ = PayloadCompressor(std::move(codec), threshold);
+            }
+
             /// Register a handler for a specific method_id
             dp::Res<void> register_method(dp::u32 method_id, Handler handler) {
                 return registry_.register_method(method_id, handler);
@@ -192,63 +302,128 @@ namespace netpipe {
             /// Set default handler for unknown methods
             void set_default_handler(Handler handler) { registry_.set_default_handler(handler); }
 
+            /// Serve the methods of a StaticRegistry - inlined handlers, no std::function on the request path
+            /// Mount before serving; static ids win over register_method() ones
+            template <typename Table> void register_static_methods() { registry_.mount<Table>(); }
+
             /// Clear default handler
             void clear_default_handler() { registry_.clear_default_handler(); }
 
+            /// Answer repeated requests to an idempotent method from the response cache (see ResponseCache)
+            void set_method_cached(dp::u32 method_id, dp::u32 ttl_ms = 0) { registry_.set_cached(method_id, ttl_ms); }
+
+            /// Forget the cached answers of method_id
+            dp::usize invalidate_cached(dp::u32 method_id) { return registry_.invalidate_cached(method_id); }
+
+            /// Response cache: capacity, per-request invalidation and hit/miss counters
+            ResponseCache &response_cache() { return registry_.cache(); }
+
             /// Server side: serve requests using registered handlers
+            /// Requests are handled in order; while more are already waiting the responses are held back
+            /// and written together, so a pipelined batch is answered with few writes
             dp::Res<void> serve() {
                 echo::info("remote serve started");
 
                 while (true) {
                     // Receive request
-                    auto recv_res = stream_.recv();
+                    auto recv_res = stream_.recv_into(recv_buffer_);
                     if (recv_res.is_err()) {
                         echo::error("remote serve recv failed");
+                        flush_responses();
                         return dp::result::err(recv_res.error());
                     }
 
-                    // Decode request
-                    auto decode_res = decode_remote_message_v2(recv_res.value());
+                    // Decode request (reuses the payload buffer of the previous request)
+                    auto decode_res = decode_remote_message_v2_into(recv_buffer_, request_);
                     if (decode_res.is_err()) {
                         echo::error("remote serve decode failed");
+                        flush_responses();
                         return dp::result::err(decode_res.error());
                     }
 
-                    auto decoded = decode_res.value();
+                    const auto &decoded = request_;
                     echo::trace("remote serve handling request id=", decoded.request_id, " method=", decoded.method_id);
 
-                    // Get handler for method_id
-                    auto handler_res = registry_.get_handler(decoded.method_id);
-                    Message remote_response;
+                    Message response_payload;
+                    MessageType response_type = MessageType::Response;
+
+                    // Repeated request to a cached method: the stored wire payload goes out as it is, without a copy
+                    bool cacheable = !(decoded.flags & MessageFlags::Compressed) &&
+                                     registry_.cache().enabled(decoded.method_id);
+                    if (cacheable) {
+                        if (auto cached = registry_.cache().lookup(decoded.method_id, decoded.payload)) {
+                            outbox_.push_back({encode_remote_header_v2(decoded.request_id, decoded.method_id,
+                                                                       static_cast<dp::u32>(cached->payload.size()),
+                                                                       MessageType::Response, cached->flags),
+                                               Message(), std::move(cached)});
+                            if (outbox_.size() < MAX_COALESCED_RESPONSES && stream_.has_pending_input()) {
+                                continue;
+                            }
+                            auto send_res = flush_responses();
+                            if (send_res.is_err()) {
+                                echo::error("remote serve send failed");
+                                return dp::result::err(send_res.error());
+                            }
+                            continue;
+                        }
+                    }
+                    dp::u64 cache_generation = registry_.cache().generation();
+                    BudgetLease inflated; // Held until the handler has run
+                    auto inflate_res = decompress_payload(request_.flags, request_.payload, inflate_buffer_,
+                                                          stream_.memory_budget(), inflated);
+
+                    // Run the handler for method_id (nullopt when there is none)
+                    std::optional<dp::Res<Message>> result;
+                    if (inflate_res.is_ok()) {
+                        NETPIPE_TRACE(HandlerBegin, decoded.request_id, decoded.method_id, decoded.payload.size());
+                        result = registry_.dispatch(decoded.method_id, decoded.payload);
+                        NETPIPE_TRACE(HandlerEnd, decoded.request_id, decoded.method_id,
+                                      result && result->is_ok() ? result->value().size() : 0);
+                    }
 
-                    if (handler_res.is_err()) {
+                    if (inflate_res.is_err()) {
+                        echo::warn("request decompression failed: ", inflate_res.error().message.c_str());
+                        response_payload.assign(inflate_res.error().message.begin(), inflate_res.error().message.end());
+                        response_type = MessageType::Error;
+                    } else if (!result) {
                         // No handler found - send error response
                         echo::warn("no handler for method_id: ", decoded.method_id);
                         dp::String error_msg = dp::String("No handler for method_id: ") +
                                                dp::String(std::to_string(decoded.method_id).c_str());
-                        Message error_payload(error_msg.begin(), error_msg.end());
-                        remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id, error_payload,
-                                                                   MessageType::Error);
+                        response_payload.assign(error_msg.begin(), error_msg.end());
+                        response_type = MessageType::Error;
+                    } else if (result->is_err()) {
+                        // Handler returned error
+                        echo::warn("handler returned error: ", result->error().message.c_str());
+                        response_payload.assign(result->error().message.begin(), result->error().message.end());
+                        response_type = MessageType::Error;
                     } else {
-                        // Call handler
-                        auto handler = handler_res.value();
-                        auto result = handler(decoded.payload);
-
-                        if (result.is_err()) {
-                            // Handler returned error
-                            echo::warn("handler returned error: ", result.error().message.c_str());
-                            Message error_payload(result.error().message.begin(), result.error().message.end());
-                            remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id,
-                                                                       error_payload, MessageType::Error);
-                        } else {
-                            // Handler succeeded
-                            remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id,
-                                                                       result.value(), MessageType::Response);
+                        // Handler succeeded
+                        response_payload = std::move(result->value());
+                    }
+
+                    // Queue the response; write the queue once no further request is waiting
+                    dp::u16 response_flags = MessageFlags::None;
+                    if (compressor_.enabled()) {
+                        Message packed;
+                        compressor_.apply(response_payload, response_flags, packed);
+                        if (response_flags & MessageFlags::Compressed) {
+                            response_payload = std::move(packed);
                         }
                     }
+                    if (cacheable && response_type == MessageType::Response) {
+                        registry_.cache().store(decoded.method_id, decoded.payload, response_payload, response_flags,
+                                                cache_generation);
+                    }
+                    outbox_.push_back({encode_remote_header_v2(decoded.request_id, decoded.method_id,
+                                                               static_cast<dp::u32>(response_payload.size()),
+                                                               response_type, response_flags),
+                                       std::move(response_payload), nullptr});
+                    if (outbox_.size() < MAX_COALESCED_RESPONSES && stream_.has_pending_input()) {
+                        continue;
+                    }
 
-                    // Send response
-                    auto send_res = stream_.send(remote_response);
+                    auto send_res = flush_responses();
                     if (send_res.is_err()) {
                         echo::error("remote serve send failed");
                         return dp::result::err(send_res.error());
@@ -281,15 +456,25 @@ namespace netpipe {
         template <> class Remote<Bidirect> {
           private:
             Stream &stream_;
-            std::atomic<dp::u32> next_request_id_;
             MethodRegistry registry_;
 
-            // Request tracking for outgoing calls
-            std::map<dp::u32, std::shared_ptr<PendingRequest>> pending_requests_;
-            mutable std::mutex pending_mutex_;
+            // Outgoing calls waiting for responses; request ids are allocated by the table
+            PendingTable pending_;
 
-            // Mutex to protect stream send operations (recv is only in receiver thread)
-            mutable std::mutex send_mutex_;
+            // Serialises stream send operations (recv is only in receiver thread); FIFO so RPCs and any attached
+            // StreamingRemote take turns
+            mutable FairMutex send_mutex_;
+
+            // Every whole frame goes out through here, coalesced with other threads' frames; fragmented
+            // sends take send_mutex_ directly, piece by piece
+            FrameWriter writer_{stream_, send_mutex_};
+
+            // Decides which of handle_request, handle_cancel and handler_timed_out answers a request
+            std::mutex reply_mutex_;
+
+            // Receives stream frames when a StreamingRemote shares this connection (see set_stream_sink)
+            std::function<void(DecodedMessageV2 &)> stream_sink_;
+            std::mutex stream_sink_mutex_;
 
             std::thread receiver_thread_;
             std::atomic<bool> running_;
@@ -300,102 +485,238 @@ namespace netpipe {
             RemoteMetrics server_metrics_;                 // Metrics for incoming requests
             bool enable_metrics_;
 
-            // Thread pool for handler execution
-            std::unique_ptr<ThreadPool> handler_pool_;
+            // Executor for handler execution - owned, or shared with other Remote instances
+            std::shared_ptr<Executor> handler_pool_;
+            bool owns_pool_;
+            std::atomic<dp::usize> submitted_handlers_; // Our tasks still queued or running on handler_pool_
 
             // Handler lifecycle tracking
             std::map<dp::u32, std::shared_ptr<HandlerInfo>> active_handlers_;
             mutable std::mutex handlers_mutex_;
 
-            // Handler timeout watchdog
-            std::thread watchdog_thread_;
+            // Handler deadlines - one timer per running handler instead of a polling watchdog thread
+            TimerService &timers_;
             dp::u32 handler_timeout_ms_;
-            std::atomic<bool> watchdog_running_;
-
-            /// Watchdog thread - monitors handler execution time and cancels timed-out handlers
-            void watchdog_loop() {
-                echo::debug("remote bidirect watchdog thread started, timeout=", handler_timeout_ms_, "ms");
-
-                while (watchdog_running_) {
-                    // Check every 1 second
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
 
-                    if (!watchdog_running_) {
-                        break;
+            // Caller deadlines on the wire (MessageFlags::Deadline); off by default for older peers
+            std::atomic<bool> propagate_deadlines_{false};
+            std::atomic<dp::u64> expired_requests_{0};
+            std::atomic<dp::u64> shed_requests_{0}; // Turned away by a full handler queue
+
+            // Low-latency mode (set_low_latency): receiver spin budget and handlers on the receiver thread
+            std::atomic<dp::u32> spin_us_{0};
+            std::atomic<bool> inline_handlers_{false};
+
+            PayloadCompressor compressor_; // Outgoing only; incoming compressed payloads are always inflated
+
+            // Outgoing payloads above this size go out as MessageFlags::Fragment pieces (0 = never)
+            std::atomic<dp::usize> fragment_size_{0};
+            /// A fragmented message being collected, with the budget its pieces were received under
+            struct PartialMessage {
+                Message data;
+                BudgetLease lease;
+                std::chrono::steady_clock::time_point updated; // Last piece; stale partials expire
+            };
+            // Receiver thread only: pieces of fragmented messages, by (type, request_id)
+            std::unordered_map<dp::u64, PartialMessage> partial_messages_;
+            dp::u64 partial_bytes_ = 0;
+            // Receiver thread only: messages given up on, whose remaining pieces are skipped up to the Final one
+            std::unordered_map<dp::u64, std::chrono::steady_clock::time_point> dropped_partials_;
+            std::chrono::steady_clock::time_point partials_swept_{};
+            // Reassembly limits (set_reassembly_limits)
+            std::atomic<dp::usize> max_partial_messages_{DEFAULT_MAX_PARTIAL_MESSAGES};
+            std::atomic<dp::u64> max_partial_bytes_{DEFAULT_MAX_PARTIAL_BYTES};
+            std::atomic<dp::u32> partial_expiry_ms_{DEFAULT_PARTIAL_EXPIRY_MS};
+
+            /// Send a whole message
+            /// Up to fragment_size_ it is one frame through writer_, which batches it with concurrent sends.
+            /// Above that the payload goes out piece by piece, taking send_mutex_ for each piece: FairMutex serves
+            /// waiters in arrival order, so fragments of concurrent large messages alternate and a small call waits
+            /// for at most one piece. flags and the deadline trailer ride on the last one; the lock is taken in the
+            /// priority class flags carry, so higher classes cut in between pieces.
+            dp::Res<void> send_message(dp::u32 id, dp::u32 method_id, const Message &payload, MessageType type,
+                                       dp::u16 flags, dp::u32 deadline_ms = 0) {
+                dp::usize piece = fragment_size_.load(std::memory_order_relaxed);
+                if (piece == 0 || payload.size() <= piece) {
+                    return writer_.write(id, method_id, payload.data(), payload.size(), type, flags, deadline_ms);
+                }
+                Priority priority = flags_priority(flags, Priority::Normal);
+                for (dp::usize offset = 0; offset < payload.size(); offset += piece) {
+                    auto lock = lock_send(priority);
+                    dp::usize length = payload.size() - offset < piece ? payload.size() - offset : piece;
+                    bool last = offset + length == payload.size();
+                    dp::u16 piece_flags = last ? (flags | MessageFlags::Fragment | MessageFlags::Final)
+                                               : MessageFlags::Fragment;
+                    NETPIPE_TRACE(SendBegin, id, method_id, length);
+                    auto res = send_remote_frame_v2(stream_, id, method_id, payload.data() + offset, length, type,
+                                                    piece_flags, last ? deadline_ms : 0);
+                    NETPIPE_TRACE(SendEnd, id, method_id, length);
+                    lock.unlock();
+                    if (res.is_err()) {
+                        return res; // The peer drops the partial message with the connection
                     }
+                }
+                return dp::result::ok();
+            }
 
-                    // Skip if timeout is disabled (0 means no timeout)
-                    if (handler_timeout_ms_ == 0) {
-                        continue;
-                    }
+            /// Take send_mutex_ in a priority class
+            std::unique_lock<FairMutex> lock_send(Priority priority) {
+                send_mutex_.lock(priority);
+                return std::unique_lock<FairMutex>(send_mutex_, std::adopt_lock);
+            }
 
-                    auto now = std::chrono::steady_clock::now();
-                    std::vector<std::shared_ptr<HandlerInfo>> timed_out_handlers;
+            /// Class an incoming request is scheduled in: the caller's, else the one registered for the method
+            Priority request_priority(const DecodedMessageV2 &decoded) const {
+                return flags_priority(decoded.flags, registry_.priority(decoded.method_id));
+            }
 
-                    // Find handlers that have exceeded timeout
-                    {
-                        std::lock_guard<std::mutex> lock(handlers_mutex_);
-                        for (auto &pair : active_handlers_) {
-                            auto &handler_info = pair.second;
-                            if (!handler_info->completed && !handler_info->cancelled) {
-                                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                                    now - handler_info->start_time)
-                                                    .count();
-                                if (duration > handler_timeout_ms_) {
-                                    echo::warn("handler timeout detected id=", handler_info->request_id,
-                                               " method=", handler_info->method_id, " duration=", duration, "ms");
-                                    timed_out_handlers.push_back(handler_info);
-                                }
-                            }
-                        }
+            /// Collect one fragment; true once decoded holds the reassembled message
+            /// The piece's lease joins the partial message, so the bytes stay counted until the whole message has
+            /// been handled; the completed message hands them back in lease. A message over the reassembly limits
+            /// is dropped (a request is answered with an error) and its later pieces are skipped.
+            bool reassemble(DecodedMessageV2 &decoded, BudgetLease &lease) {
+                dp::u64 key = (static_cast<dp::u64>(decoded.type) << 32) | decoded.request_id;
+                bool last = decoded.flags & MessageFlags::Final;
+                auto now = std::chrono::steady_clock::now();
+                expire_partials(now);
+
+                auto dropped = dropped_partials_.find(key);
+                if (dropped != dropped_partials_.end()) {
+                    if (last) {
+                        dropped_partials_.erase(dropped);
                     }
+                    return false;
+                }
 
-                    // Cancel timed-out handlers and send error responses
-                    for (auto &handler_info : timed_out_handlers) {
-                        // Mark as cancelled (cooperative cancellation)
-                        handler_info->cancelled = true;
+                auto it = partial_messages_.find(key);
+                if (it == partial_messages_.end()) {
+                    if (partial_messages_.size() >= max_partial_messages_.load(std::memory_order_relaxed)) {
+                        drop_partial(key, decoded, last, "too many fragmented messages");
+                        return false;
+                    }
+                    it = partial_messages_.emplace(key, PartialMessage{}).first;
+                }
+                PartialMessage &partial = it->second;
+                dp::usize piece = decoded.payload.size();
+                if (partial.data.size() + piece > MAX_MESSAGE_SIZE ||
+                    partial_bytes_ + piece > max_partial_bytes_.load(std::memory_order_relaxed)) {
+                    drop_partial(key, decoded, last, "fragmented message too large");
+                    return false;
+                }
+                partial.data.insert(partial.data.end(), decoded.payload.begin(), decoded.payload.end());
+                partial.lease.absorb(std::move(lease));
+                partial.updated = now;
+                partial_bytes_ += piece;
+                if (!last) {
+                    return false;
+                }
+                partial_bytes_ -= partial.data.size();
+                decoded.payload = std::move(partial.data);
+                decoded.flags &= static_cast<dp::u16>(~(MessageFlags::Fragment | MessageFlags::Final));
+                lease = std::move(partial.lease);
+                partial_messages_.erase(it);
+                return true;
+            }
 
-                        // Send timeout error response
-                        dp::String error_msg = dp::String("Handler timeout after ") +
-                                               dp::String(std::to_string(handler_timeout_ms_).c_str()) +
-                                               dp::String("ms");
-                        Message error_payload(error_msg.begin(), error_msg.end());
-                        Message remote_response = encode_remote_message_v2(
-                            handler_info->request_id, handler_info->method_id, error_payload, MessageType::Error);
+            /// Give up on a fragmented message and skip the rest of its pieces
+            void drop_partial(dp::u64 key, const DecodedMessageV2 &decoded, bool last, const char *reason) {
+                auto it = partial_messages_.find(key);
+                if (it != partial_messages_.end()) {
+                    partial_bytes_ -= it->second.data.size();
+                    partial_messages_.erase(it);
+                }
+                if (!last) {
+                    // Bounded like the partials themselves; the oldest entry makes room
+                    if (dropped_partials_.size() >= MAX_DROPPED_PARTIALS) {
+                        auto oldest =
+                            std::min_element(dropped_partials_.begin(), dropped_partials_.end(),
+                                             [](const auto &a, const auto &b) { return a.second < b.second; });
+                        dropped_partials_.erase(oldest);
+                    }
+                    dropped_partials_[key] = std::chrono::steady_clock::now();
+                }
+                echo::warn(reason, ", dropping id=", decoded.request_id);
+                if (decoded.type == MessageType::Request) {
+                    Message error_payload(reason, reason + std::strlen(reason));
+                    send_message(decoded.request_id, decoded.method_id, error_payload, MessageType::Error,
+                                 MessageFlags::None);
+                }
+            }
 
-                        // Send error response (protect with mutex)
-                        {
-                            std::lock_guard<std::mutex> lock(send_mutex_);
-                            auto send_res = stream_.send(remote_response);
-                            if (send_res.is_err()) {
-                                echo::warn("watchdog: failed to send timeout error id=", handler_info->request_id);
-                            } else {
-                                echo::trace("watchdog: sent timeout error id=", handler_info->request_id);
-                            }
-                        }
+            /// Forget partial and dropped messages whose pieces stopped arriving; runs at most once a second
+            void expire_partials(std::chrono::steady_clock::time_point now) {
+                if (now - partials_swept_ < std::chrono::seconds(1)) {
+                    return;
+                }
+                partials_swept_ = now;
+                auto expiry = std::chrono::milliseconds(partial_expiry_ms_.load(std::memory_order_relaxed));
+                for (auto it = partial_messages_.begin(); it != partial_messages_.end();) {
+                    if (now - it->second.updated < expiry) {
+                        ++it;
+                        continue;
+                    }
+                    echo::warn("fragmented message expired, dropping id=", static_cast<dp::u32>(it->first));
+                    partial_bytes_ -= it->second.data.size();
+                    dropped_partials_[it->first] = now; // Pieces still on their way are skipped, not collected
+                    it = partial_messages_.erase(it);
+                }
+                std::erase_if(dropped_partials_, [&](const auto &entry) { return now - entry.second >= expiry; });
+            }
 
-                        // Mark as completed and remove from tracking
-                        handler_info->completed = true;
-                        {
-                            std::lock_guard<std::mutex> lock(handlers_mutex_);
-                            active_handlers_.erase(handler_info->request_id);
-                        }
+            /// Handler deadline passed: answer the caller with a timeout error and flag the handler cancelled
+            /// Runs on the timer thread; the handler's own ScopedTimer keeps this from outliving the Remote
+            void handler_timed_out(HandlerInfo &handler_info) {
+                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                                      handler_info.start_time)
+                                    .count();
+                dp::String error_msg = dp::String("Handler timeout after ") +
+                                       dp::String(std::to_string(handler_timeout_ms_).c_str()) + dp::String("ms");
+                Message error_payload(error_msg.begin(), error_msg.end());
+                {
+                    // Same check-then-mark as handle_cancel, so only one response ever goes out
+                    std::lock_guard<std::mutex> lock(reply_mutex_);
+                    if (handler_info.completed || handler_info.cancelled) {
+                        return;
                     }
+                    echo::warn("handler timeout detected id=", handler_info.request_id,
+                               " method=", handler_info.method_id, " duration=", duration, "ms");
+                    handler_info.cancelled = true; // Cooperative cancellation
+                }
+                auto send_res = send_message(handler_info.request_id, handler_info.method_id, error_payload,
+                                             MessageType::Error, MessageFlags::None);
+                if (send_res.is_err()) {
+                    echo::warn("handler timeout: failed to send error id=", handler_info.request_id);
+                } else {
+                    echo::trace("handler timeout: sent error id=", handler_info.request_id);
                 }
 
-                echo::debug("remote bidirect watchdog thread stopped");
+                handler_info.completed = true;
+                std::lock_guard<std::mutex> lock(handlers_mutex_);
+                active_handlers_.erase(handler_info.request_id);
             }
 
             /// Receiver thread - handles both responses (for our calls) and requests (from peer)
             void receiver_loop() {
                 echo::debug("remote bidirect receiver thread started");
 
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+
                 while (running_) {
-                    // Receive message
-                    auto recv_res = stream_.recv();
+                    // Low-latency mode: poll for the next message instead of sleeping in recv
+                    dp::u32 spin_us = spin_us_.load(std::memory_order_relaxed);
+                    if (spin_us > 0) {
+                        spin_for_input(stream_, spin_us, running_);
+                    }
+
+                    // Receive message - the payload gets its own buffer, which moves through dispatch untouched
+                    Message payload;
+                    auto recv_res = stream_.recv_split(header.data(), header.size(), payload);
                     if (recv_res.is_err()) {
                         // Timeout is expected - just continue to check running_ flag
                         if (recv_res.error().code == dp::Error::TIMEOUT) {
+                            if (!partial_messages_.empty() || !dropped_partials_.empty()) {
+                                expire_partials(std::chrono::steady_clock::now());
+                            }
                             continue;
                         }
                         // Connection closed or other error - exit gracefully
@@ -404,30 +725,80 @@ namespace netpipe {
                         }
                         break;
                     }
+                    // Bytes of this message stay counted against the memory budget until it has been handled
+                    BudgetLease lease = stream_.take_lease();
 
                     // Decode message
-                    auto decode_res = decode_remote_message_v2(recv_res.value());
+                    auto decode_res = decode_remote_message_v2(header.data(), recv_res.value(), std::move(payload));
                     if (decode_res.is_err()) {
                         echo::warn("remote bidirect decode failed");
                         continue;
                     }
 
-                    auto decoded = decode_res.value();
+                    auto decoded = std::move(decode_res.value());
+                    NETPIPE_TRACE(Recv, decoded.request_id, decoded.method_id, decoded.payload.size());
+                    if ((decoded.flags & MessageFlags::Fragment) && !reassemble(decoded, lease)) {
+                        continue;
+                    }
+
+                    if (is_stream_frame(decoded)) {
+                        std::lock_guard<std::mutex> lock(stream_sink_mutex_);
+                        if (stream_sink_) {
+                            stream_sink_(decoded);
+                            continue;
+                        }
+                    }
 
                     // Determine message type
                     if (decoded.type == MessageType::Request) {
                         // Incoming request - submit to thread pool to avoid blocking receiver
-                        bool submitted = handler_pool_->submit([this, decoded]() { handle_request(decoded); });
+                        dp::u32 request_id = decoded.request_id;
+                        dp::u32 method_id = decoded.method_id;
+                        Priority priority = request_priority(decoded);
+                        if (serve_cached(decoded, priority)) {
+                            continue;
+                        }
+                        if (lease.budget() && lease.budget()->rejecting()) {
+                            // Past the reject watermark: answer now rather than queue more work on a full process
+                            lease.budget()->note_rejection();
+                            lease.release();
+                            Message error_payload;
+                            dp::String error_msg = "memory budget exhausted";
+                            error_payload.assign(error_msg.begin(), error_msg.end());
+                            send_message(request_id, method_id, error_payload, MessageType::Error,
+                                         priority_flags(priority));
+                            continue;
+                        }
+                        auto deadline = DeadlineScope::from_budget(decoded.deadline_ms);
+                        if (inline_handlers_.load(std::memory_order_relaxed)) {
+                            // No pool hop; the next message waits until this handler returns
+                            run_request(deadline, decoded);
+                            continue;
+                        }
+                        submitted_handlers_.fetch_add(1);
+                        dp::u64 queued_ns = NETPIPE_TRACE_NOW();
+                        // Executor tasks must be copyable, so the lease rides along in a shared_ptr
+                        auto held = std::make_shared<BudgetLease>(std::move(lease));
+                        auto task = [this, deadline, queued_ns, held, decoded = std::move(decoded)]() mutable {
+                            NETPIPE_TRACE(QueueWait, decoded.request_id, decoded.method_id,
+                                          NETPIPE_TRACE_NOW() - queued_ns);
+                            run_request(deadline, decoded);
+                            held->release();
+                            submitted_handlers_.fetch_sub(1, std::memory_order_release); // Last touch of this
+                        };
+                        // Lower classes are turned away first (see admission_limit)
+                        bool submitted = handler_pool_->submit(std::move(task), priority);
                         if (!submitted) {
-                            echo::warn("handler pool queue full, rejecting request id=", decoded.request_id);
+                            submitted_handlers_.fetch_sub(1);
+                            shed_requests_.fetch_add(1, std::memory_order_relaxed);
+                            echo::warn("handler pool queue full, rejecting request id=", request_id,
+                                       " priority=", static_cast<int>(priority));
                             // Send error response - handler pool is overloaded
                             Message error_payload;
                             dp::String error_msg = "Handler pool overloaded";
                             error_payload.assign(error_msg.begin(), error_msg.end());
-                            Message remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id,
-                                                                               error_payload, MessageType::Error);
-                            std::lock_guard<std::mutex> lock(send_mutex_);
-                            stream_.send(remote_response);
+                            send_message(request_id, method_id, error_payload, MessageType::Error,
+                                         priority_flags(priority));
                         }
                     } else if (decoded.type == MessageType::Cancel) {
                         // Cancellation request - handle it
@@ -441,9 +812,55 @@ namespace netpipe {
                 echo::debug("remote bidirect receiver thread stopped");
             }
 
+            /// Answer a request from the response cache, right here on the receiver; false on a miss
+            bool serve_cached(const DecodedMessageV2 &decoded, Priority priority) {
+                if (decoded.flags & MessageFlags::Compressed) {
+                    return false;
+                }
+                auto cached = registry_.cache().lookup(decoded.method_id, decoded.payload);
+                if (!cached) {
+                    return false;
+                }
+                echo::trace("remote bidirect answering id=", decoded.request_id, " from the response cache");
+                auto res = send_message(decoded.request_id, decoded.method_id, cached->payload, MessageType::Response,
+                                        cached->flags | priority_flags(priority));
+                if (res.is_err()) {
+                    echo::warn("failed to send cached response id=", decoded.request_id);
+                }
+                return true;
+            }
+
+            /// Run one incoming request under the caller's deadline
+            void run_request(DeadlineScope::Clock::time_point deadline, DecodedMessageV2 &decoded) {
+                // The caller gave up while this sat in the queue - its answer would be discarded
+                if (DeadlineScope::expired(deadline)) {
+                    echo::debug("remote bidirect dropping expired request id=", decoded.request_id);
+                    expired_requests_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                DeadlineScope scope(deadline); // Nested calls inherit the caller's deadline
+                handle_request(decoded);
+            }
+
+            /// Stream traffic, including the Request that opens a stream
+            static bool is_stream_frame(const DecodedMessageV2 &decoded) {
+                switch (decoded.type) {
+                case MessageType::StreamData:
+                case MessageType::StreamEnd:
+                case MessageType::StreamError:
+                case MessageType::StreamCredit:
+                    return true;
+                case MessageType::Request:
+                    return (decoded.flags & MessageFlags::Streaming) != 0;
+                default:
+                    return false;
+                }
+            }
+
             /// Handle incoming request from peer
-            void handle_request(const DecodedMessageV2 &decoded) {
+            void handle_request(DecodedMessageV2 &decoded) {
                 echo::trace("remote bidirect handling request id=", decoded.request_id, " method=", decoded.method_id);
+                Priority priority = request_priority(decoded);
 
                 // Check incoming request limit
                 dp::usize current_count = active_incoming_count_.fetch_add(1);
@@ -457,11 +874,8 @@ namespace netpipe {
                                            dp::String(std::to_string(max_incoming_requests_).c_str()) +
                                            dp::String(") reached");
                     Message error_payload(error_msg.begin(), error_msg.end());
-                    Message remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id,
-                                                                       error_payload, MessageType::Error);
-
-                    std::lock_guard<std::mutex> lock(send_mutex_);
-                    auto send_res = stream_.send(remote_response);
+                    auto send_res = send_message(decoded.request_id, decoded.method_id, error_payload,
+                                                 MessageType::Error, priority_flags(priority));
                     if (send_res.is_err()) {
                         echo::warn("failed to send overload error response id=", decoded.request_id);
                     }
@@ -475,39 +889,69 @@ namespace netpipe {
                     active_handlers_[decoded.request_id] = handler_info;
                 }
 
+                // Handler deadline; cancelled on every return path below
+                TimerId deadline_id = 0;
+                if (handler_timeout_ms_ > 0) {
+                    deadline_id = timers_.schedule(handler_timeout_ms_,
+                                                   [this, handler_info]() { handler_timed_out(*handler_info); });
+                }
+                ScopedTimer deadline(timers_, deadline_id);
+
+                // Inflated here on the handler thread so large compressed requests never stall the receiver
+                Message spare;
+                BudgetLease inflated; // The inflated payload stays counted until the handler returns
+                auto inflate_res =
+                    decompress_payload(decoded.flags, decoded.payload, spare, stream_.memory_budget(), inflated);
+
                 // Start metrics tracking if enabled
-                std::unique_ptr<MetricsTracker> tracker;
-                std::unique_ptr<HandlerMetricsTracker> handler_tracker;
+                std::optional<MetricsTracker> tracker;
+                std::optional<HandlerMetricsTracker> handler_tracker;
                 if (enable_metrics_) {
-                    tracker = std::make_unique<MetricsTracker>(server_metrics_, decoded.payload.size());
+                    tracker.emplace(server_metrics_, decoded.payload.size(), decoded.method_id);
                 }
 
-                // Get handler for method_id
-                auto handler_res = registry_.get_handler(decoded.method_id);
-                Message remote_response;
-
-                if (handler_res.is_err()) {
+                // Is there a handler for method_id (flat table lookup, nothing copied)
+                bool has_handler = registry_.resolves(decoded.method_id);
+                // Cached answers are keyed by the request as it arrived, so compressed requests are not cached
+                bool cacheable =
+                    !(decoded.flags & MessageFlags::Compressed) && registry_.cache().enabled(decoded.method_id);
+                dp::u64 cache_generation = registry_.cache().generation();
+                Message response_payload;
+                MessageType response_type = MessageType::Response;
+
+                if (inflate_res.is_err()) {
+                    echo::warn("request decompression failed: ", inflate_res.error().message.c_str());
+                    response_payload.assign(inflate_res.error().message.begin(), inflate_res.error().message.end());
+                    response_type = MessageType::Error;
+                    if (tracker)
+                        tracker->failure();
+                } else if (!has_handler) {
                     // No handler found - send error response
                     echo::warn("no handler for method_id: ", decoded.method_id);
                     dp::String error_msg = dp::String("No handler for method_id: ") +
                                            dp::String(std::to_string(decoded.method_id).c_str());
-                    Message error_payload(error_msg.begin(), error_msg.end());
-                    remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id, error_payload,
-                                                               MessageType::Error);
+                    response_payload.assign(error_msg.begin(), error_msg.end());
+                    response_type = MessageType::Error;
                     if (tracker)
                         tracker->failure();
                 } else {
-                    // Call handler
-                    auto handler = handler_res.value();
-
                     // Track handler execution time
                     if (enable_metrics_) {
-                        handler_tracker = std::make_unique<HandlerMetricsTracker>(server_metrics_);
+                        handler_tracker.emplace(server_metrics_, decoded.method_id);
                     }
 
-                    auto result = handler(decoded.payload);
+                    // Call handler
+                    NETPIPE_TRACE(HandlerBegin, decoded.request_id, decoded.method_id, decoded.payload.size());
+                    auto dispatched = registry_.dispatch(decoded.method_id, decoded.payload);
+                    if (!dispatched) {
+                        dispatched.emplace(dp::result::err(dp::Error::not_found("method unregistered")));
+                    }
+                    auto &result = *dispatched;
+                    NETPIPE_TRACE(HandlerEnd, decoded.request_id, decoded.method_id,
+                                  result.is_ok() ? result.value().size() : 0);
+                    handler_tracker.reset(); // Handler time ends here, not after the response is sent
 
-                    // Check if handler was cancelled (by peer cancel or watchdog)
+                    // Check if handler was cancelled (by peer cancel or handler timeout)
                     if (handler_info->cancelled) {
                         echo::warn("handler was cancelled id=", decoded.request_id);
                         // Canceller already sent error response, just cleanup
@@ -523,17 +967,15 @@ namespace netpipe {
                     if (result.is_err()) {
                         // Handler returned error
                         echo::warn("handler returned error: ", result.error().message.c_str());
-                        Message error_payload(result.error().message.begin(), result.error().message.end());
-                        remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id, error_payload,
-                                                                   MessageType::Error);
+                        response_payload.assign(result.error().message.begin(), result.error().message.end());
+                        response_type = MessageType::Error;
                         if (tracker)
                             tracker->failure();
                     } else {
                         // Handler succeeded
-                        remote_response = encode_remote_message_v2(decoded.request_id, decoded.method_id,
-                                                                   result.value(), MessageType::Response);
                         if (tracker)
                             tracker->success(result.value().size());
+                        response_payload = std::move(result.value());
                     }
                 }
 
@@ -549,10 +991,17 @@ namespace netpipe {
                     return;
                 }
 
-                // Atomically check cancelled and send response (using send_mutex)
+                // Compress before sending - the scratch buffer belongs to this thread
+                dp::u16 response_flags = priority_flags(priority); // Later fragments keep the request's class
+                const Message &wire = compressor_.apply(response_payload, response_flags);
+                if (cacheable && response_type == MessageType::Response) {
+                    registry_.cache().store(decoded.method_id, decoded.payload, wire, response_flags, cache_generation);
+                }
+
+                // Atomically check cancelled and claim the response (using reply_mutex)
                 // This prevents race with handle_cancel sending duplicate response
                 {
-                    std::lock_guard<std::mutex> lock(send_mutex_);
+                    std::lock_guard<std::mutex> lock(reply_mutex_);
 
                     // Check if cancelled while we were encoding response
                     if (handler_info->cancelled) {
@@ -569,22 +1018,23 @@ namespace netpipe {
 
                     // Mark completed before sending to prevent cancel from sending
                     handler_info->completed = true;
+                }
 
-                    auto send_res = stream_.send(remote_response);
-                    if (send_res.is_err()) {
-                        echo::trace("remote bidirect send response failed: ", send_res.error().message.c_str());
-                        {
-                            std::lock_guard<std::mutex> lock(handlers_mutex_);
-                            active_handlers_.erase(decoded.request_id);
-                        }
-                        active_incoming_count_.fetch_sub(1);
-                        return;
+                auto send_res =
+                    send_message(decoded.request_id, decoded.method_id, wire, response_type, response_flags);
+                if (send_res.is_err()) {
+                    echo::trace("remote bidirect send response failed: ", send_res.error().message.c_str());
+                    {
+                        std::lock_guard<std::mutex> lock(handlers_mutex_);
+                        active_handlers_.erase(decoded.request_id);
                     }
+                    active_incoming_count_.fetch_sub(1);
+                    return;
                 }
 
                 echo::trace("remote bidirect sent response id=", decoded.request_id);
 
-                // Remove from tracking (completed already set inside send_mutex)
+                // Remove from tracking (completed already set inside reply_mutex)
                 {
                     std::lock_guard<std::mutex> lock(handlers_mutex_);
                     active_handlers_.erase(decoded.request_id);
@@ -602,39 +1052,25 @@ namespace netpipe {
             }
 
             /// Handle response to our outgoing call
-            void handle_response(const DecodedMessageV2 &decoded) {
+            void handle_response(DecodedMessageV2 &decoded) {
                 dp::u32 request_id = decoded.request_id;
                 echo::trace("remote bidirect received response id=", request_id);
 
-                // Find pending request
-                std::shared_ptr<PendingRequest> pending;
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    auto it = pending_requests_.find(request_id);
-                    if (it != pending_requests_.end()) {
-                        pending = it->second;
-                        pending_requests_.erase(it);
-                    }
+                bool matched;
+                auto inflate_res = decompress_payload(decoded.flags, decoded.payload);
+                if (inflate_res.is_err()) {
+                    matched = pending_.complete(request_id, dp::result::err(inflate_res.error()));
+                } else if (decoded.type == MessageType::Error) {
+                    dp::String error_msg(reinterpret_cast<const char *>(decoded.payload.data()),
+                                         decoded.payload.size());
+                    matched = pending_.complete(request_id, dp::result::err(dp::Error::io_error(error_msg.c_str())));
+                } else {
+                    matched = pending_.complete(request_id, dp::result::ok(std::move(decoded.payload)));
                 }
 
-                if (!pending) {
+                if (!matched) {
                     echo::warn("received response for unknown request_id: ", request_id);
-                    return;
-                }
-
-                // Set result
-                {
-                    std::lock_guard<std::mutex> lock(pending->mutex);
-                    if (decoded.type == MessageType::Error) {
-                        dp::String error_msg(reinterpret_cast<const char *>(decoded.payload.data()),
-                                             decoded.payload.size());
-                        pending->result = dp::result::err(dp::Error::io_error(error_msg.c_str()));
-                    } else {
-                        pending->result = dp::result::ok(std::move(decoded.payload));
-                    }
-                    pending->completed = true;
                 }
-                pending->cv.notify_one();
             }
 
             /// Handle cancellation request from peer
@@ -667,13 +1103,11 @@ namespace netpipe {
                 // Prepare error response
                 dp::String error_msg = "Request cancelled by peer";
                 Message error_payload(error_msg.begin(), error_msg.end());
-                Message remote_response =
-                    encode_remote_message_v2(request_id, handler_info->method_id, error_payload, MessageType::Error);
 
-                // Atomically check completed and send cancellation response (using send_mutex)
+                // Atomically check completed and claim the cancellation response (using reply_mutex)
                 // This coordinates with handle_request to prevent duplicate responses
                 {
-                    std::lock_guard<std::mutex> lock(send_mutex_);
+                    std::lock_guard<std::mutex> lock(reply_mutex_);
 
                     // Check if already completed (response already sent by handle_request)
                     if (handler_info->completed) {
@@ -681,7 +1115,7 @@ namespace netpipe {
                         return;
                     }
 
-                    // Check if already cancelled (by watchdog or another cancel)
+                    // Check if already cancelled (by handler timeout or another cancel)
                     if (handler_info->cancelled) {
                         echo::trace("cancel: handler already cancelled id=", request_id);
                         return;
@@ -691,13 +1125,14 @@ namespace netpipe {
                     handler_info->cancelled = true;
                     echo::debug("cancel: marked handler as cancelled id=", request_id,
                                 " method=", handler_info->method_id);
+                }
 
-                    auto send_res = stream_.send(remote_response);
-                    if (send_res.is_err()) {
-                        echo::warn("cancel: failed to send cancellation response id=", request_id);
-                    } else {
-                        echo::trace("cancel: sent cancellation response id=", request_id);
-                    }
+                auto send_res = send_message(request_id, handler_info->method_id, error_payload, MessageType::Error,
+                                             MessageFlags::None);
+                if (send_res.is_err()) {
+                    echo::warn("cancel: failed to send cancellation response id=", request_id);
+                } else {
+                    echo::trace("cancel: sent cancellation response id=", request_id);
                 }
 
                 // Note: Don't do cleanup here (mark completed, remove from tracking, decrement counter).
@@ -705,6 +1140,20 @@ namespace netpipe {
                 // This avoids double-decrementing active_incoming_count_.
             }
 
+            // Budget to put on the wire for a call waiting timeout_ms; 0 sends no deadline
+            dp::u32 wire_deadline(dp::u32 timeout_ms) const {
+                return propagate_deadlines_.load(std::memory_order_relaxed) ? timeout_ms : 0;
+            }
+
+            void start(dp::u32 recv_timeout_ms) {
+                // Set receive timeout to allow receiver thread to check running_ flag
+                // Configurable timeout allows tuning for different use cases
+                stream_.set_recv_timeout(recv_timeout_ms);
+                // Replies are read even when our handlers hold the whole budget (see budget_exempt_v2)
+                stream_.set_budget_exemption(&budget_exempt_v2);
+                receiver_thread_ = std::thread(&Remote::receiver_loop, this);
+            }
+
           public:
             /// Constructor for bidirectional RPC
             /// @param stream The underlying stream for communication
@@ -724,44 +1173,43 @@ namespace netpipe {
                             dp::u32 recv_timeout_ms = 100, dp::usize handler_threads = 10,
                             dp::usize max_handler_queue = 1000, dp::u32 handler_timeout_ms = 30000,
                             dp::usize max_incoming = 100)
-                : stream_(stream), next_request_id_(0), running_(true), max_concurrent_requests_(max_concurrent),
+                : stream_(stream), pending_(max_concurrent), running_(true), max_concurrent_requests_(max_concurrent),
                   max_incoming_requests_(max_incoming), active_incoming_count_(0), enable_metrics_(enable_metrics),
-                  handler_timeout_ms_(handler_timeout_ms), watchdog_running_(true) {
+                  handler_pool_(std::make_shared<WorkStealingExecutor>(handler_threads, max_handler_queue)),
+                  owns_pool_(true), submitted_handlers_(0), timers_(TimerService::shared()),
+                  handler_timeout_ms_(handler_timeout_ms) {
                 echo::trace("Remote<Bidirect> constructed, max_concurrent=", max_concurrent,
                             " max_incoming=", max_incoming, " metrics=", enable_metrics,
                             " recv_timeout=", recv_timeout_ms, "ms", " handler_threads=", handler_threads,
                             " max_queue=", max_handler_queue, " handler_timeout=", handler_timeout_ms, "ms");
+                start(recv_timeout_ms);
+            }
 
-                // Create thread pool for handler execution
-                handler_pool_ = std::make_unique<ThreadPool>(handler_threads, max_handler_queue);
-
-                // Start watchdog thread if timeout is enabled
-                if (handler_timeout_ms_ > 0) {
-                    watchdog_thread_ = std::thread(&Remote::watchdog_loop, this);
+            /// Constructor running handlers on an existing executor
+            /// The executor can be shared by many Remote instances; it is not shut down by this Remote
+            /// @param executor Where incoming requests run; nullptr falls back to a private WorkStealingExecutor
+            explicit Remote(Stream &stream, std::shared_ptr<Executor> executor, dp::usize max_concurrent = 100,
+                            bool enable_metrics = false, dp::u32 recv_timeout_ms = 100,
+                            dp::u32 handler_timeout_ms = 30000, dp::usize max_incoming = 100)
+                : stream_(stream), pending_(max_concurrent), running_(true), max_concurrent_requests_(max_concurrent),
+                  max_incoming_requests_(max_incoming), active_incoming_count_(0), enable_metrics_(enable_metrics),
+                  handler_pool_(std::move(executor)), owns_pool_(false), submitted_handlers_(0),
+                  timers_(TimerService::shared()), handler_timeout_ms_(handler_timeout_ms) {
+                if (!handler_pool_) {
+                    handler_pool_ = std::make_shared<WorkStealingExecutor>();
+                    owns_pool_ = true;
                 }
-
-                // Set receive timeout to allow receiver thread to check running_ flag
-                // Configurable timeout allows tuning for different use cases
-                stream_.set_recv_timeout(recv_timeout_ms);
-                receiver_thread_ = std::thread(&Remote::receiver_loop, this);
+                echo::trace("Remote<Bidirect> constructed on shared executor, max_concurrent=", max_concurrent,
+                            " max_incoming=", max_incoming, " handler_timeout=", handler_timeout_ms, "ms");
+                start(recv_timeout_ms);
             }
 
             ~Remote() {
                 echo::trace("Remote<Bidirect> shutting down");
                 running_ = false;
-                watchdog_running_ = false;
 
                 // Wake up all pending requests
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    for (auto &pair : pending_requests_) {
-                        std::lock_guard<std::mutex> req_lock(pair.second->mutex);
-                        pair.second->result = dp::result::err(dp::Error::io_error("Remote destroyed"));
-                        pair.second->completed = true;
-                        pair.second->cv.notify_one();
-                    }
-                    pending_requests_.clear();
-                }
+                pending_.fail_all("Remote destroyed");
 
                 // DON'T close stream - let the owner close it
                 // The receiver thread will exit when running_ = false and recv() times out
@@ -769,15 +1217,15 @@ namespace netpipe {
                 if (receiver_thread_.joinable()) {
                     receiver_thread_.join();
                 }
+                stream_.set_budget_exemption(nullptr);
 
-                // Stop watchdog thread
-                if (watchdog_thread_.joinable()) {
-                    watchdog_thread_.join();
-                }
-
-                // Shutdown thread pool and wait for all handlers to complete
-                if (handler_pool_) {
+                // Wait for all our handlers to complete - a shared executor keeps running for its other users
+                if (owns_pool_) {
                     handler_pool_->shutdown();
+                } else {
+                    while (submitted_handlers_.load(std::memory_order_acquire) > 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
                 }
 
                 echo::trace("Remote<Bidirect> destroyed");
@@ -788,103 +1236,184 @@ namespace netpipe {
                 return registry_.register_method(method_id, handler);
             }
 
+            /// Register a handler whose requests are scheduled in a priority class (see set_method_priority)
+            dp::Res<void> register_method(dp::u32 method_id, Handler handler, Priority priority) {
+                auto res = registry_.register_method(method_id, handler);
+                if (res.is_ok()) {
+                    registry_.set_priority(method_id, priority);
+                }
+                return res;
+            }
+
+            /// Priority class of a method, on both sides of the connection
+            /// Incoming requests for it queue, are shed and answered in this class unless the caller sent its
+            /// own; call() without an explicit priority sends it. Set before serving.
+            void set_method_priority(dp::u32 method_id, Priority priority) {
+                registry_.set_priority(method_id, priority);
+            }
+
+            /// Priority class of a method (Normal unless set)
+            Priority method_priority(dp::u32 method_id) const { return registry_.priority(method_id); }
+
+            /// Answer repeated requests to an idempotent method from the response cache (see ResponseCache)
+            /// A hit is answered on the receiver thread: no handler runs and nothing waits on the handler pool.
+            /// Call invalidate_cached() when the data behind the method changes.
+            void set_method_cached(dp::u32 method_id, dp::u32 ttl_ms = 0) { registry_.set_cached(method_id, ttl_ms); }
+
+            /// Forget the cached answers of method_id
+            dp::usize invalidate_cached(dp::u32 method_id) { return registry_.invalidate_cached(method_id); }
+
+            /// Response cache: capacity, per-request invalidation and hit/miss counters
+            ResponseCache &response_cache() { return registry_.cache(); }
+
             /// Unregister a handler
             dp::Res<void> unregister_method(dp::u32 method_id) { return registry_.unregister_method(method_id); }
 
             /// Set default handler for unknown methods
             void set_default_handler(Handler handler) { registry_.set_default_handler(handler); }
 
+            /// Serve the methods of a StaticRegistry - inlined handlers, no std::function on the request path
+            /// Mount before serving; static ids win over register_method() ones
+            template <typename Table> void register_static_methods() { registry_.mount<Table>(); }
+
             /// Clear default handler
             void clear_default_handler() { registry_.clear_default_handler(); }
 
-            /// Call a method on the peer (client side)
+            /// Call a method on the peer (client side), in the method's priority class
             /// Thread-safe - can be called from multiple threads
             dp::Res<Message> call(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000) {
+                return call(method_id, request, timeout_ms, registry_.priority(method_id));
+            }
+
+            /// Call a method in an explicit priority class
+            /// The class orders this request on our writer and on the peer's handler queue, and decides how
+            /// early the peer sheds it under load. Normal defers to the class the peer registered for the method.
+            dp::Res<Message> call(dp::u32 method_id, const Message &request, dp::u32 timeout_ms, Priority priority) {
                 // Start metrics tracking if enabled
-                std::unique_ptr<MetricsTracker> tracker;
+                std::optional<MetricsTracker> tracker;
                 if (enable_metrics_) {
-                    tracker = std::make_unique<MetricsTracker>(client_metrics_, request.size());
+                    tracker.emplace(client_metrics_, request.size(), method_id);
                 }
 
-                // Check concurrent request limit
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    if (pending_requests_.size() >= max_concurrent_requests_) {
-                        echo::error("max concurrent requests reached: ", max_concurrent_requests_);
-                        if (tracker)
-                            tracker->failure();
-                        return dp::result::err(dp::Error::io_error("max concurrent requests reached"));
-                    }
+                // Inside a handler, never wait past the deadline of the request being served
+                dp::u32 budget = DeadlineScope::clamp(timeout_ms);
+                if (budget == 0 && timeout_ms != 0) {
+                    if (tracker)
+                        tracker->timeout();
+                    return dp::result::err(dp::Error::timeout("deadline exceeded"));
                 }
+                timeout_ms = budget;
 
-                // Generate request ID (thread-safe)
-                dp::u32 request_id = next_request_id_.fetch_add(1);
+                // Claim a pending slot - fails when max_concurrent calls are already in flight
+                auto slot = pending_.acquire();
+                if (slot.is_err()) {
+                    echo::error("max concurrent requests reached: ", max_concurrent_requests_);
+                    if (tracker)
+                        tracker->failure();
+                    return dp::result::err(slot.error());
+                }
+                dp::u32 request_id = slot.value();
                 echo::trace("remote bidirect call id=", request_id, " method=", method_id);
+                NETPIPE_TRACE(CallBegin, request_id, method_id, request.size());
 
-                // Create pending request
-                auto pending = std::make_shared<PendingRequest>(request_id);
+                // Send request without copying the payload (protect with mutex)
+                dp::u16 flags = priority_flags(priority);
+                const Message &wire = compressor_.apply(request, flags); // Per-thread scratch, untouched until sent
+                auto send_res =
+                    send_message(request_id, method_id, wire, MessageType::Request, flags, wire_deadline(timeout_ms));
+                if (send_res.is_err()) {
+                    pending_.release(request_id);
+                    echo::error("remote bidirect send failed");
+                    NETPIPE_TRACE(CallEnd, request_id, method_id, 0);
+                    if (tracker)
+                        tracker->failure();
+                    return dp::result::err(send_res.error());
+                }
 
-                // Register pending request
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    pending_requests_[request_id] = pending;
+                // Wait for response with timeout; the slot is free again when this returns
+                auto result = pending_.wait(request_id, timeout_ms);
+                NETPIPE_TRACE(CallEnd, request_id, method_id, result.is_ok() ? result.value().size() : 0);
+                if (result.is_err() && result.error().code == dp::Error::TIMEOUT) {
+                    echo::error("remote bidirect call timeout id=", request_id);
+                    if (tracker)
+                        tracker->timeout();
+                    return result;
                 }
 
-                // Encode and send request (protect with mutex)
-                Message remote_request = encode_remote_message_v2(request_id, method_id, request, MessageType::Request);
-                {
-                    std::lock_guard<std::mutex> lock(send_mutex_);
-                    auto send_res = stream_.send(remote_request);
+                echo::trace("remote bidirect call completed id=", request_id);
 
-                    if (send_res.is_err()) {
-                        // Remove from pending
-                        {
-                            std::lock_guard<std::mutex> lock(pending_mutex_);
-                            pending_requests_.erase(request_id);
-                        }
-                        echo::error("remote bidirect send failed");
-                        if (tracker)
-                            tracker->failure();
-                        return dp::result::err(send_res.error());
+                // Track success/failure
+                if (tracker) {
+                    if (result.is_ok()) {
+                        tracker->success(result.value().size());
+                    } else {
+                        tracker->failure();
                     }
                 }
 
-                // Wait for response with timeout
-                {
-                    std::unique_lock<std::mutex> lock(pending->mutex);
-                    auto timeout = std::chrono::milliseconds(timeout_ms);
-                    if (!pending->cv.wait_for(lock, timeout, [&] { return pending->completed; })) {
-                        // Timeout - remove from pending
-                        {
-                            std::lock_guard<std::mutex> plock(pending_mutex_);
-                            pending_requests_.erase(request_id);
-                        }
-                        echo::error("remote bidirect call timeout id=", request_id);
-                        if (tracker)
-                            tracker->timeout();
-                        return dp::result::err(dp::Error::timeout("call timeout"));
-                    }
+                return result;
+            }
+
+            /// Coroutine form of call(): `co_await remote.call_async(...)`, or `.get()` from plain code
+            /// No thread blocks while the call is in flight. The receiver thread resumes the coroutine when the
+            /// response arrives, so code after the co_await runs there and must not block on this Remote.
+            /// A timeout resumes it from the shared TimerService thread instead.
+            /// request is only read before the first suspension.
+            Task<dp::Res<Message>> call_async(dp::u32 method_id, const Message &request, dp::u32 timeout_ms = 5000) {
+                return call_async(method_id, request, timeout_ms, registry_.priority(method_id));
+            }
+
+            /// call_async() in an explicit priority class, as for call()
+            Task<dp::Res<Message>> call_async(dp::u32 method_id, const Message &request, dp::u32 timeout_ms,
+                                              Priority priority) {
+                std::optional<MetricsTracker> tracker;
+                if (enable_metrics_) {
+                    tracker.emplace(client_metrics_, request.size(), method_id);
                 }
 
-                echo::trace("remote bidirect call completed id=", request_id);
+                dp::u32 budget = DeadlineScope::clamp(timeout_ms); // Read before the first suspension
+                if (budget == 0 && timeout_ms != 0) {
+                    if (tracker)
+                        tracker->timeout();
+                    co_return dp::result::err(dp::Error::timeout("deadline exceeded"));
+                }
+                timeout_ms = budget;
 
-                // Track success/failure
+                auto slot = pending_.acquire();
+                if (slot.is_err()) {
+                    if (tracker)
+                        tracker->failure();
+                    co_return dp::result::err(slot.error());
+                }
+                dp::u32 request_id = slot.value();
+                echo::trace("remote bidirect call_async id=", request_id, " method=", method_id);
+
+                dp::u16 flags = priority_flags(priority);
+                const Message &wire = compressor_.apply(request, flags); // Per-thread scratch, untouched until sent
+                auto send_res =
+                    send_message(request_id, method_id, wire, MessageType::Request, flags, wire_deadline(timeout_ms));
+                if (send_res.is_err()) {
+                    pending_.release(request_id);
+                    echo::error("remote bidirect send failed");
+                    if (tracker)
+                        tracker->failure();
+                    co_return dp::result::err(send_res.error());
+                }
+                auto result = co_await pending_.wait_async(request_id, timeout_ms);
                 if (tracker) {
-                    if (pending->result.is_ok()) {
-                        tracker->success(pending->result.value().size());
+                    if (result.is_ok()) {
+                        tracker->success(result.value().size());
+                    } else if (result.error().code == dp::Error::TIMEOUT) {
+                        tracker->timeout();
                     } else {
                         tracker->failure();
                     }
                 }
-
-                return pending->result;
+                co_return result;
             }
 
             /// Get number of pending outgoing requests
-            dp::usize pending_count() const {
-                std::lock_guard<std::mutex> lock(pending_mutex_);
-                return pending_requests_.size();
-            }
+            dp::usize pending_count() const { return pending_.in_flight(); }
 
             /// Get number of active handlers (incoming requests being processed)
             dp::usize active_handler_count() const {
@@ -896,6 +1425,7 @@ namespace netpipe {
             dp::usize active_incoming_count() const { return active_incoming_count_.load(); }
 
             /// Get number of active tasks in thread pool
+            /// With a shared executor this counts every user's tasks
             dp::usize active_pool_tasks() const { return handler_pool_ ? handler_pool_->active_count() : 0; }
 
             /// Get number of queued tasks in thread pool
@@ -919,51 +1449,113 @@ namespace netpipe {
             /// Check if metrics are enabled
             bool metrics_enabled() const { return enable_metrics_; }
 
-            /// Cancel an in-flight request
-            bool cancel(dp::u32 request_id) {
-                echo::trace("remote bidirect cancel request id=", request_id);
-
-                // Find and mark pending request as cancelled
-                std::shared_ptr<PendingRequest> pending;
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    auto it = pending_requests_.find(request_id);
-                    if (it == pending_requests_.end()) {
-                        echo::warn("cancel: request_id not found: ", request_id);
-                        return false;
+            /// Send each call's timeout with the request so the peer can drop it once we stopped waiting
+            /// Both peers must run a version that knows MessageFlags::Deadline; older ones misread the trailer
+            void set_deadline_propagation(bool enable) { propagate_deadlines_.store(enable); }
+            bool deadline_propagation() const { return propagate_deadlines_.load(); }
+
+            /// Incoming requests dropped because their caller's deadline passed before a handler thread was free
+            dp::u64 expired_request_count() const { return expired_requests_.load(std::memory_order_relaxed); }
+
+            /// Requests answered "Handler pool overloaded" because their class was already full
+            dp::u64 shed_request_count() const { return shed_requests_.load(std::memory_order_relaxed); }
+
+            /// Trade CPU for latency on this connection (see LowLatencyOptions)
+            /// Busy poll needs a socket stream and may need CAP_NET_ADMIN above net.core.busy_poll; pinning the
+            /// handler workers needs the Remote's own WorkStealingExecutor. Everything that can be applied is applied
+            /// before the first failure is returned.
+            /// With inline_handlers the receiver runs each request itself: a handler must be short, its calls to
+            /// this same Remote can never see their response, and handler_timeout does not preempt it.
+            dp::Res<void> set_low_latency(const LowLatencyOptions &options) {
+                dp::Res<void> result = dp::result::ok();
+                auto keep_first = [&](dp::Res<void> res) {
+                    if (res.is_err() && result.is_ok()) {
+                        result = std::move(res);
+                    }
+                };
+
+                spin_us_.store(options.spin_us, std::memory_order_relaxed);
+                inline_handlers_.store(options.inline_handlers, std::memory_order_relaxed);
+                if (options.busy_poll_us > 0) {
+                    dp::i32 fd = stream_.native_handle();
+                    if (fd < 0) {
+                        keep_first(dp::result::err(dp::Error::invalid_argument("stream has no socket to busy poll")));
+                    } else {
+                        keep_first(set_busy_poll(fd, options.busy_poll_us));
                     }
-                    pending = it->second;
                 }
-
-                // Try to mark as cancelled
-                {
-                    std::lock_guard<std::mutex> lock(pending->mutex);
-                    if (pending->completed) {
-                        echo::trace("cancel: request already completed id=", request_id);
-                        return false;
+                if (options.receiver_cpu >= 0) {
+                    keep_first(pin_thread(receiver_thread_.native_handle(), options.receiver_cpu));
+                }
+                if (!options.handler_cpus.empty()) {
+                    auto *pool = dynamic_cast<WorkStealingExecutor *>(handler_pool_.get());
+                    if (!owns_pool_ || !pool) {
+                        keep_first(dp::result::err(dp::Error::invalid_argument("handler executor is shared")));
+                    } else {
+                        keep_first(pool->set_affinity(options.handler_cpus));
                     }
-                    pending->cancelled = true;
-                    pending->result = dp::result::err(dp::Error::io_error("request cancelled"));
-                    pending->completed = true;
                 }
+                return result;
+            }
 
-                // Notify waiting thread
-                pending->cv.notify_one();
+            /// Compress requests and responses of at least threshold bytes with codec (nullptr turns it off)
+            /// Configure before traffic starts; the peer inflates them whatever its own setting is
+            void set_compression(std::shared_ptr<const Codec> codec,
+                                 dp::usize threshold = DEFAULT_COMPRESSION_THRESHOLD) {
+                compressor_ = PayloadCompressor(std::move(codec), threshold);
+            }
 
-                // Send cancellation message to peer (best effort)
-                Message cancel_msg = encode_remote_message_v2(request_id, 0, Message(), MessageType::Cancel);
-                {
-                    std::lock_guard<std::mutex> lock(send_mutex_);
-                    auto send_res = stream_.send(cancel_msg);
-                    if (send_res.is_err()) {
-                        echo::warn("cancel: failed to send cancel message id=", request_id);
-                    }
+            /// Split outgoing requests and responses larger than fragment_size bytes into pieces (0 turns it off)
+            /// Pieces of concurrent large messages interleave with each other and with small calls instead of
+            /// one large frame holding the connection. The peer must be a version that reassembles
+            /// MessageFlags::Fragment; receiving fragments always works.
+            void set_fragmentation(dp::usize fragment_size = DEFAULT_FRAGMENT_SIZE) {
+                fragment_size_.store(fragment_size, std::memory_order_relaxed);
+            }
+            dp::usize fragment_size() const { return fragment_size_.load(std::memory_order_relaxed); }
+
+            /// Bound what the peer's fragmented messages may hold here: at most max_messages collected at once and
+            /// max_bytes in all, each dropped when no piece arrives for expiry_ms. A message over a limit is
+            /// dropped (requests are answered with an error) and its remaining pieces are skipped.
+            void set_reassembly_limits(dp::usize max_messages, dp::u64 max_bytes,
+                                       dp::u32 expiry_ms = DEFAULT_PARTIAL_EXPIRY_MS) {
+                max_partial_messages_.store(max_messages, std::memory_order_relaxed);
+                max_partial_bytes_.store(max_bytes, std::memory_order_relaxed);
+                partial_expiry_ms_.store(expiry_ms, std::memory_order_relaxed);
+            }
+
+            /// Hand stream frames (StreamData/End/Error/Credit, and Requests flagged Streaming) to sink on the
+            /// receiver thread instead of treating them as RPC traffic; nullptr restores the default
+            /// Clearing waits for a sink call in progress, so its owner may be destroyed right after.
+            void set_stream_sink(std::function<void(DecodedMessageV2 &)> sink) {
+                std::lock_guard<std::mutex> lock(stream_sink_mutex_);
+                stream_sink_ = std::move(sink);
+            }
+
+            /// Write one V2 frame on this connection, coalesced with RPC traffic
+            dp::Res<void> send_frame(dp::u32 id, dp::u32 method_id, const Message &payload, MessageType type,
+                                     dp::u16 flags = MessageFlags::None) {
+                return writer_.write(id, method_id, payload.data(), payload.size(), type, flags);
+            }
+
+            /// Frames written and send_batch calls made for them; the ratio is how many frames each write carries
+            dp::u64 frames_sent() const { return writer_.frames_written(); }
+            dp::u64 frame_batches_sent() const { return writer_.batches_written(); }
+
+            /// Cancel an in-flight request
+            bool cancel(dp::u32 request_id) {
+                echo::trace("remote bidirect cancel request id=", request_id);
+
+                // Complete the waiting call with an error; fails if it already finished or never existed
+                if (!pending_.complete(request_id, dp::result::err(dp::Error::io_error("request cancelled")))) {
+                    echo::warn("cancel: request_id not waiting: ", request_id);
+                    return false;
                 }
 
-                // Remove from pending
-                {
-                    std::lock_guard<std::mutex> lock(pending_mutex_);
-                    pending_requests_.erase(request_id);
+                // Send cancellation message to peer (best effort)
+                auto send_res = writer_.write(request_id, 0, nullptr, 0, MessageType::Cancel);
+                if (send_res.is_err()) {
+                    echo::warn("cancel: failed to send cancel message id=", request_id);
                 }
 
                 echo::trace("remote bidirect cancelled request id=", request_id);
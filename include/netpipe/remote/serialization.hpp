@@ -1,18 +1,284 @@
 #pragma once
 
+#include <array>
+#include <cstring>
 #include <netpipe/remote/common.hpp>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <variant>
 
 namespace netpipe {
     namespace remote {
 
+        /// Binary layout for compound types, used by Serializer for anything without its own specialization
+        /// - structs exposing `auto members() { return std::tie(a, b, ...); }` (the datapod convention): fields
+        ///   in order; members() must only tie fields, it is also called on values being serialized
+        /// - dp::String / std::string / std::string_view: [length:4][bytes]
+        /// - contiguous sequences (dp::Vector, std::vector, Message): [count:4][elements], bulk-copied when
+        ///   the element type is trivially copyable
+        /// - std::optional: [present:1][value], std::variant: [index:1][alternative], bool: 1 byte
+        /// - other trivially copyable types (scalars, enums, dp::Array of scalars): raw host-order bytes, like
+        ///   TrivialSerializer
+        /// Deserializing std::string_view or std::span<const dp::u8> fields points them into the received
+        /// buffer instead of copying, so such a value is only valid while that buffer is.
+        namespace wire {
+
+            template <typename T, typename = void> struct has_members : std::false_type {};
+            template <typename T>
+            struct has_members<T, std::void_t<decltype(std::declval<T &>().members())>> : std::true_type {};
+
+            template <typename T> struct is_optional : std::false_type {};
+            template <typename U> struct is_optional<std::optional<U>> : std::true_type {};
+
+            template <typename T> struct is_variant : std::false_type {};
+            template <typename... Us> struct is_variant<std::variant<Us...>> : std::true_type {};
+
+            template <typename T>
+            constexpr bool is_string_v = std::is_same_v<T, dp::String> || std::is_same_v<T, std::string>;
+
+            template <typename T>
+            constexpr bool is_view_v =
+                std::is_same_v<T, std::string_view> || std::is_same_v<T, std::span<const dp::u8>>;
+
+            template <typename T, typename = void> struct is_sequence : std::false_type {};
+            template <typename T>
+            struct is_sequence<T, std::void_t<typename T::value_type, decltype(std::declval<T &>().data()),
+                                              decltype(std::declval<T &>().resize(dp::usize{}))>>
+                : std::bool_constant<!is_string_v<T>> {};
+
+            template <typename T> constexpr bool is_raw_v = std::is_trivially_copyable_v<T> && !has_members<T>::value;
+
+            /// Cursor over received bytes; every read is bounds-checked
+            struct Reader {
+                const dp::u8 *pos;
+                const dp::u8 *end;
+
+                dp::usize remaining() const { return static_cast<dp::usize>(end - pos); }
+
+                bool take(void *dst, dp::usize n) {
+                    if (remaining() < n) {
+                        return false;
+                    }
+                    std::memcpy(dst, pos, n);
+                    pos += n;
+                    return true;
+                }
+
+                bool length(dp::u32 &n) { return take(&n, 4); }
+            };
+
+            template <typename T> dp::usize size_of(const T &value);
+            template <typename T> void write(const T &value, dp::u8 *&out);
+            template <typename T> bool read(Reader &in, T &value);
+
+            template <typename T> auto fields_of(const T &value) { return const_cast<T &>(value).members(); }
+
+            template <typename T> dp::usize size_of(const T &value) {
+                if constexpr (has_members<T>::value) {
+                    return std::apply([](const auto &...f) { return (dp::usize{0} + ... + size_of(f)); },
+                                      fields_of(value));
+                } else if constexpr (is_string_v<T> || is_view_v<T>) {
+                    return 4 + value.size();
+                } else if constexpr (is_optional<T>::value) {
+                    return 1 + (value ? size_of(*value) : 0);
+                } else if constexpr (is_variant<T>::value) {
+                    return 1 + std::visit([](const auto &alt) { return size_of(alt); }, value);
+                } else if constexpr (is_sequence<T>::value) {
+                    using E = typename T::value_type;
+                    if constexpr (is_raw_v<E>) {
+                        return 4 + value.size() * sizeof(E);
+                    } else {
+                        dp::usize total = 4;
+                        for (const auto &e : value) {
+                            total += size_of(e);
+                        }
+                        return total;
+                    }
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    return 1;
+                } else {
+                    static_assert(is_raw_v<T>, "type needs members(), a Serializer specialization, or to be "
+                                               "trivially copyable");
+                    return sizeof(T);
+                }
+            }
+
+            inline void put(const void *src, dp::usize n, dp::u8 *&out) {
+                if (n > 0) {
+                    std::memcpy(out, src, n);
+                    out += n;
+                }
+            }
+
+            inline void put_length(dp::usize n, dp::u8 *&out) {
+                dp::u32 length = static_cast<dp::u32>(n);
+                put(&length, 4, out);
+            }
+
+            template <typename T> void write(const T &value, dp::u8 *&out) {
+                if constexpr (has_members<T>::value) {
+                    std::apply([&out](const auto &...f) { (write(f, out), ...); }, fields_of(value));
+                } else if constexpr (is_string_v<T> || is_view_v<T>) {
+                    put_length(value.size(), out);
+                    put(value.data(), value.size(), out);
+                } else if constexpr (is_optional<T>::value) {
+                    *out++ = value ? 1 : 0;
+                    if (value) {
+                        write(*value, out);
+                    }
+                } else if constexpr (is_variant<T>::value) {
+                    *out++ = static_cast<dp::u8>(value.index());
+                    std::visit([&out](const auto &alt) { write(alt, out); }, value);
+                } else if constexpr (is_sequence<T>::value) {
+                    using E = typename T::value_type;
+                    put_length(value.size(), out);
+                    if constexpr (is_raw_v<E>) {
+                        put(value.data(), value.size() * sizeof(E), out);
+                    } else {
+                        for (const auto &e : value) {
+                            write(e, out);
+                        }
+                    }
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    *out++ = value ? 1 : 0;
+                } else {
+                    put(&value, sizeof(T), out);
+                }
+            }
+
+            template <typename V, dp::usize I = 0> bool read_alternative(Reader &in, dp::usize index, V &value) {
+                if constexpr (I < std::variant_size_v<V>) {
+                    if (index == I) {
+                        std::variant_alternative_t<I, V> alt{};
+                        if (!read(in, alt)) {
+                            return false;
+                        }
+                        value.template emplace<I>(std::move(alt));
+                        return true;
+                    }
+                    return read_alternative<V, I + 1>(in, index, value);
+                } else {
+                    return false;
+                }
+            }
+
+            template <typename T> bool read(Reader &in, T &value) {
+                if constexpr (has_members<T>::value) {
+                    return std::apply([&in](auto &...f) { return (read(in, f) && ...); }, value.members());
+                } else if constexpr (is_view_v<T>) {
+                    dp::u32 n;
+                    if (!in.length(n) || in.remaining() < n) {
+                        return false;
+                    }
+                    using C = typename T::value_type;
+                    value = T(reinterpret_cast<const C *>(in.pos), n); // Zero-copy: points into the buffer
+                    in.pos += n;
+                    return true;
+                } else if constexpr (is_string_v<T>) {
+                    dp::u32 n;
+                    if (!in.length(n) || in.remaining() < n) {
+                        return false;
+                    }
+                    value = T(reinterpret_cast<const char *>(in.pos), n);
+                    in.pos += n;
+                    return true;
+                } else if constexpr (is_optional<T>::value) {
+                    dp::u8 present;
+                    if (!in.take(&present, 1)) {
+                        return false;
+                    }
+                    if (!present) {
+                        value.reset();
+                        return true;
+                    }
+                    value.emplace();
+                    return read(in, *value);
+                } else if constexpr (is_variant<T>::value) {
+                    dp::u8 index;
+                    return in.take(&index, 1) && read_alternative(in, index, value);
+                } else if constexpr (is_sequence<T>::value) {
+                    using E = typename T::value_type;
+                    dp::u32 n;
+                    if (!in.length(n)) {
+                        return false;
+                    }
+                    if constexpr (is_raw_v<E>) {
+                        if (in.remaining() / sizeof(E) < n) {
+                            return false;
+                        }
+                        value.resize(n);
+                        return in.take(value.data(), static_cast<dp::usize>(n) * sizeof(E));
+                    } else {
+                        if (in.remaining() < n) {
+                            return false; // Every element takes at least a byte - reject absurd counts early
+                        }
+                        value.resize(n);
+                        for (auto &e : value) {
+                            if (!read(in, e)) {
+                                return false;
+                            }
+                        }
+                        return true;
+                    }
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    dp::u8 b;
+                    if (!in.take(&b, 1)) {
+                        return false;
+                    }
+                    value = b != 0;
+                    return true;
+                } else {
+                    return in.take(&value, sizeof(T));
+                }
+            }
+
+            /// Append value to out: one resize to the exact size, then written in place
+            template <typename T> void append(const T &value, Message &out) {
+                dp::usize start = out.size();
+                out.resize(start + size_of(value));
+                dp::u8 *pos = out.data() + start;
+                write(value, pos);
+            }
+
+            /// Decode a value that spans exactly [data, data + size)
+            template <typename T> dp::Res<T> decode(const dp::u8 *data, dp::usize size) {
+                Reader in{data, data + size};
+                T value{};
+                if (!read(in, value)) {
+                    echo::error("deserialize failed: truncated or malformed input");
+                    return dp::result::err(dp::Error::invalid_argument("truncated or malformed input"));
+                }
+                if (in.remaining() != 0) {
+                    echo::error("deserialize left ", in.remaining(), " trailing bytes");
+                    return dp::result::err(dp::Error::invalid_argument("trailing bytes after value"));
+                }
+                return dp::result::ok(std::move(value));
+            }
+
+        } // namespace wire
+
         /// Serializer interface - convert type T to/from Message
+        /// The primary template uses the wire layout above; scalars and strings have specializations below
         template <typename T> struct Serializer {
             /// Serialize value to Message
-            static Message serialize(const T &value);
+            static Message serialize(const T &value) {
+                Message out;
+                wire::append(value, out);
+                return out;
+            }
 
             /// Deserialize Message to value
-            static dp::Res<T> deserialize(const Message &msg);
+            static dp::Res<T> deserialize(const Message &msg) { return wire::decode<T>(msg.data(), msg.size()); }
+
+            /// Deserialize from a received view (e.g. a DecodedMessageView payload) without copying it first
+            static dp::Res<T> deserialize(std::span<const dp::u8> bytes) {
+                return wire::decode<T>(bytes.data(), bytes.size());
+            }
         };
 
         /// Default serializer for trivially copyable types (POD types)
@@ -0,0 +1,873 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netpipe/reactor.hpp>
+#include <netpipe/remote/compression.hpp>
+#include <netpipe/remote/deadline.hpp>
+#include <netpipe/remote/executor.hpp>
+#include <netpipe/remote/protocol.hpp>
+#include <netpipe/remote/registry.hpp>
+#include <netpipe/remote/remote.hpp>
+#include <netpipe/stream.hpp>
+#include <new>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Remote RPC server for many connections on one event loop
+        /// One epoll thread accepts, reads and frames every connection; handlers share one executor
+        /// Wire-compatible with Remote<Unidirect>/Remote<Bidirect> clients over TcpStream, IpcStream or ShmStream
+        /// Streams without a pollable fd (ShmStream, UringStream) cannot join the epoll set: each of their listeners
+        /// gets an accept thread and each of their connections a receive thread, feeding the same handler pool.
+        class RemoteServer {
+          private:
+            /// Per-connection state - read side owned by the loop thread, write side guarded by out_mutex
+            struct Connection {
+                std::unique_ptr<Stream> stream;
+                dp::i32 fd;
+                TransportCounters *counters = nullptr; // The stream's stats; the loop counts its fd reads and writes
+
+                Message inbox;           // Raw bytes read from the socket
+                dp::usize inbox_start;   // First unparsed byte
+                dp::usize inbox_end;     // One past the last received byte
+                BudgetLease inbox_lease; // Budget of the frame the inbox grew past INBOX_SIZE for
+                dp::u64 discard = 0;     // Bytes of a frame turned away unread that are still to come
+
+                std::mutex out_mutex;
+                Message outbox;          // Response bytes the socket has not accepted yet
+                dp::usize outbox_start;  // First unsent byte
+                bool write_armed;        // EPOLLOUT requested for the pending outbox
+                bool closed;
+            };
+
+            /// Accept or receive loop of a listener or connection without a pollable fd (fd == -1)
+            /// Blocks in accept()/recv() with a short timeout so stop() is noticed; the thread starts with start()
+            struct Poller {
+                std::unique_ptr<Stream> listener;  // Accept loop when set
+                std::shared_ptr<Connection> conn;  // Receive loop otherwise
+                std::thread thread;
+                std::atomic<bool> done{false};     // Loop has returned; the thread can be joined
+                bool serving = false;              // conn holds a connection slot (its thread, or stop() after join)
+            };
+
+            Reactor reactor_;
+            MethodRegistry registry_;
+            std::unique_ptr<Executor> pool_;
+            std::vector<std::unique_ptr<Stream>> listeners_;        // Loop thread only
+            std::map<dp::i32, std::shared_ptr<Connection>> connections_; // Loop thread only
+            std::atomic<dp::usize> connection_count_;
+            std::atomic<dp::u64> expired_requests_; // Dropped because their caller's deadline passed in the queue
+            PayloadCompressor compressor_;          // Responses; set before start()
+            MemoryBudget *budget_ = &MemoryBudget::global(); // Request payloads queued or being handled
+            dp::usize max_connections_ = 0;                 // 0 = unlimited; set before start()
+            dp::u32 max_frame_size_ = MAX_MESSAGE_SIZE + V2_HEADER_SIZE; // Larger length prefixes close
+            std::atomic<dp::u64> refused_connections_{0};   // Closed at once because the limit was reached
+            std::thread loop_thread_;
+
+            std::mutex pollers_mutex_;
+            std::vector<std::unique_ptr<Poller>> pollers_; // Guarded by pollers_mutex_
+            bool started_ = false;                         // Guarded by pollers_mutex_
+            std::atomic<bool> stopping_{false};
+
+            /// Initial per-connection read buffer; grows to fit larger frames
+            static constexpr dp::usize INBOX_SIZE = 64 * 1024;
+
+            /// Accept/receive timeout of poller threads - bounds how long stop() waits for them
+            static constexpr dp::u32 POLL_INTERVAL_MS = 100;
+
+            /// Send without SIGPIPE - a vanished client must not take the server down
+            static dp::isize send_nosignal(dp::i32 fd, iovec *iov, dp::usize iovcnt) {
+                struct msghdr hdr = {};
+                hdr.msg_iov = iov;
+                hdr.msg_iovlen = iovcnt;
+                dp::isize n;
+                do {
+                    n = ::sendmsg(fd, &hdr, MSG_NOSIGNAL);
+                } while (n < 0 && errno == EINTR);
+                return n;
+            }
+
+            void watch_listener(std::unique_ptr<Stream> listener) {
+                dp::i32 fd = listener->native_handle();
+                Stream *raw = listener.get();
+                auto res = reactor_.add(fd, EPOLLIN, [this, raw](dp::u32) {
+                    auto accept_res = raw->accept();
+                    if (accept_res.is_err()) {
+                        echo::warn("remote server accept failed: ", accept_res.error().message.c_str());
+                        return;
+                    }
+                    watch_connection(std::move(accept_res.value()));
+                });
+                if (res.is_err()) {
+                    echo::error("remote server could not watch listener fd=", fd);
+                    return;
+                }
+                listeners_.push_back(std::move(listener));
+            }
+
+            /// Take a connection slot, or count a refusal when max_connections_ are already open
+            bool claim_connection() {
+                dp::usize open = connection_count_.load();
+                do {
+                    if (max_connections_ != 0 && open >= max_connections_) {
+                        refused_connections_.fetch_add(1, std::memory_order_relaxed);
+                        echo::warn("remote server at its limit of ", max_connections_, " connections, refusing one");
+                        return false;
+                    }
+                } while (!connection_count_.compare_exchange_weak(open, open + 1));
+                return true;
+            }
+
+            void watch_connection(std::unique_ptr<Stream> stream) {
+                dp::i32 fd = stream->native_handle();
+                if (!claim_connection()) {
+                    stream->close();
+                    return;
+                }
+                if (set_nonblocking(fd, true).is_err()) {
+                    stream->close();
+                    connection_count_--;
+                    return;
+                }
+
+                auto conn = std::make_shared<Connection>();
+                conn->stream = std::move(stream);
+                conn->fd = fd;
+                conn->counters = conn->stream->stats_counters();
+                conn->inbox.resize(INBOX_SIZE);
+                conn->inbox_start = 0;
+                conn->inbox_end = 0;
+                conn->outbox_start = 0;
+                conn->write_armed = false;
+                conn->closed = false;
+
+                auto res = reactor_.add(fd, EPOLLIN, [this, conn](dp::u32 events) { on_ready(conn, events); });
+                if (res.is_err()) {
+                    conn->stream->close();
+                    connection_count_--;
+                    return;
+                }
+                connections_[fd] = conn;
+                echo::debug("remote server connection added fd=", fd, " total=", connection_count_.load());
+            }
+
+            void close_connection(const std::shared_ptr<Connection> &conn) {
+                reactor_.remove(conn->fd);
+                {
+                    std::lock_guard<std::mutex> lock(conn->out_mutex);
+                    conn->closed = true;
+                    conn->stream->close();
+                }
+                if (connections_.erase(conn->fd) > 0) {
+                    connection_count_--;
+                }
+                echo::debug("remote server connection closed fd=", conn->fd, " total=", connection_count_.load());
+            }
+
+            void on_ready(const std::shared_ptr<Connection> &conn, dp::u32 events) {
+                if (events & EPOLLOUT) {
+                    std::lock_guard<std::mutex> lock(conn->out_mutex);
+                    if (!flush_locked(*conn)) {
+                        conn->closed = true;
+                    } else if (conn->outbox_start == conn->outbox.size()) {
+                        conn->write_armed = false;
+                        reactor_.modify(conn->fd, EPOLLIN);
+                    }
+                }
+
+                if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    if (!read_available(conn)) {
+                        close_connection(conn);
+                        return;
+                    }
+                }
+
+                bool broken;
+                {
+                    std::lock_guard<std::mutex> lock(conn->out_mutex);
+                    broken = conn->closed;
+                }
+                if (broken) {
+                    close_connection(conn);
+                }
+            }
+
+            /// One read per readiness event (level-triggered, so busy connections cannot starve the rest)
+            /// Returns false once the connection is finished - EOF, error or a malformed frame
+            bool read_available(const std::shared_ptr<Connection> &conn) {
+                // Make room at the back, compacting consumed bytes first
+                if (conn->inbox_end == conn->inbox.size()) {
+                    if (conn->inbox_start == 0) {
+                        if (!grow_inbox(*conn, conn->inbox.size() * 2)) {
+                            return false;
+                        }
+                    } else {
+                        std::memmove(conn->inbox.data(), conn->inbox.data() + conn->inbox_start,
+                                     conn->inbox_end - conn->inbox_start);
+                        conn->inbox_end -= conn->inbox_start;
+                        conn->inbox_start = 0;
+                    }
+                }
+
+                dp::isize n;
+                do {
+                    n = ::read(conn->fd, conn->inbox.data() + conn->inbox_end, conn->inbox.size() - conn->inbox_end);
+                } while (n < 0 && errno == EINTR);
+                if (n <= 0 && conn->counters) {
+                    conn->counters->on_recv_call();
+                }
+                if (n == 0) {
+                    echo::trace("remote server peer closed fd=", conn->fd);
+                    return false;
+                }
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        return true;
+                    }
+                    echo::trace("remote server read failed fd=", conn->fd, ": ", strerror(errno));
+                    return false;
+                }
+                conn->inbox_end += static_cast<dp::usize>(n);
+
+                // The rest of a frame turned away for lack of budget is dropped as it arrives
+                if (conn->discard > 0) {
+                    dp::usize buffered = conn->inbox_end - conn->inbox_start;
+                    dp::usize drop = conn->discard < buffered ? static_cast<dp::usize>(conn->discard) : buffered;
+                    conn->inbox_start += drop;
+                    conn->discard -= drop;
+                }
+                if (conn->counters) {
+                    // Partial, as for the stream's own reads, when the frame at the front is still incomplete
+                    dp::usize buffered = conn->inbox_end - conn->inbox_start;
+                    bool partial = conn->discard > 0 || buffered < 4 ||
+                                   buffered < 4 + decode_u32_be(conn->inbox.data() + conn->inbox_start);
+                    conn->counters->on_recv_call(partial);
+                }
+
+                // Dispatch every complete frame
+                bool big_pending = false;
+                while (conn->inbox_end - conn->inbox_start >= 4) {
+                    const dp::u8 *frame = conn->inbox.data() + conn->inbox_start;
+                    dp::u32 length = decode_u32_be(frame);
+                    if (length > max_frame_size_) {
+                        echo::error("remote server frame too large: ", length, " bytes (max: ", max_frame_size_,
+                                    ") on fd=", conn->fd);
+                        return false;
+                    }
+                    dp::usize buffered = conn->inbox_end - conn->inbox_start;
+                    dp::usize needed = 4 + static_cast<dp::usize>(length);
+                    if (buffered < needed) {
+                        big_pending = needed > INBOX_SIZE;
+                        if (big_pending && budget_->enabled() && !conn->inbox_lease.budget()) {
+                            // Growing the inbox is the allocation: the frame is charged before it is buffered
+                            if (buffered < 4 + V2_HEADER_SIZE) {
+                                break; // Its header decides how to answer a refusal
+                            }
+                            if (budget_->rejecting() || !budget_->try_reserve(length)) {
+                                if (!turn_away(conn, frame + 4, length)) {
+                                    return false;
+                                }
+                                conn->discard = needed - buffered;
+                                conn->inbox_start = conn->inbox_end;
+                                big_pending = false;
+                                break;
+                            }
+                            conn->inbox_lease = BudgetLease(budget_, length);
+                        }
+                        // Grow once so the rest of this frame fits without further reallocation
+                        if (needed > conn->inbox.size() && !grow_inbox(*conn, needed + conn->inbox_start)) {
+                            return false;
+                        }
+                        break;
+                    }
+
+                    if (conn->counters) {
+                        conn->counters->on_recv(length);
+                    }
+                    if (!dispatch_frame(conn, frame + 4, length, std::move(conn->inbox_lease))) {
+                        return false;
+                    }
+                    conn->inbox_start += needed;
+                }
+                if (conn->inbox_start == conn->inbox_end) {
+                    conn->inbox_start = 0;
+                    conn->inbox_end = 0;
+                }
+                // Give back an inbox grown for a large frame once it is dispatched
+                if (!big_pending && conn->inbox.size() > INBOX_SIZE) {
+                    dp::usize pending = conn->inbox_end - conn->inbox_start;
+                    Message inbox;
+                    if (!grow_inbox(*conn, INBOX_SIZE, inbox)) {
+                        return false;
+                    }
+                    std::memcpy(inbox.data(), conn->inbox.data() + conn->inbox_start, pending);
+                    conn->inbox = std::move(inbox);
+                    conn->inbox_start = 0;
+                    conn->inbox_end = pending;
+                }
+                return true;
+            }
+
+            /// Resize a connection's inbox (or its replacement); false, which drops the connection, when the memory
+            /// is not there
+            static bool grow_inbox(Connection &conn, dp::usize size) { return grow_inbox(conn, size, conn.inbox); }
+
+            static bool grow_inbox(const Connection &conn, dp::usize size, Message &inbox) {
+                try {
+                    inbox.resize(size);
+                } catch (const std::bad_alloc &) {
+                    echo::error("remote server cannot grow inbox of fd=", conn.fd, " to ", size, " bytes");
+                    return false;
+                }
+                return true;
+            }
+
+            /// Answer a frame that does not fit the budget without reading its payload
+            /// Returns false for a malformed header
+            bool turn_away(const std::shared_ptr<Connection> &conn, const dp::u8 *data, dp::u32 length) {
+                DecodedMessageView header{};
+                auto header_res = decode_remote_header_v2(data, length, header);
+                if (header_res.is_err() || header_res.value() != length - V2_HEADER_SIZE) {
+                    echo::error("remote server received malformed frame on fd=", conn->fd);
+                    return false;
+                }
+                if (header.type == MessageType::Request) {
+                    reject_over_budget(conn, header.request_id, header.method_id);
+                }
+                return true;
+            }
+
+            void reject_over_budget(const std::shared_ptr<Connection> &conn, dp::u32 request_id, dp::u32 method_id) {
+                budget_->note_rejection();
+                echo::debug("remote server rejecting request id=", request_id, ", memory budget exhausted");
+                dp::String error_msg = "memory budget exhausted";
+                Message error_payload;
+                error_payload.assign(error_msg.begin(), error_msg.end());
+                queue_response(conn, request_id, method_id, error_payload, MessageType::Error);
+            }
+
+            /// Serve a stream without a pollable fd from its own receive thread
+            dp::Res<void> serve_unpolled(std::unique_ptr<Stream> stream) {
+                if (stream->set_recv_timeout(POLL_INTERVAL_MS).is_err()) {
+                    echo::error("remote server connection cannot time out its receives");
+                    stream->close();
+                    return dp::result::err(dp::Error::invalid_argument("stream has no receive timeout"));
+                }
+                auto conn = std::make_shared<Connection>();
+                conn->stream = std::move(stream);
+                conn->fd = -1;
+                conn->inbox_start = 0;
+                conn->inbox_end = 0;
+                conn->outbox_start = 0;
+                conn->write_armed = false;
+                conn->closed = false;
+
+                auto poller = std::make_unique<Poller>();
+                poller->conn = std::move(conn);
+                add_poller(std::move(poller));
+                return dp::result::ok();
+            }
+
+            /// Keep a poller, starting its thread right away once the server runs
+            void add_poller(std::unique_ptr<Poller> poller) {
+                std::lock_guard<std::mutex> lock(pollers_mutex_);
+                // Join the loops of connections that have finished since the last one was added
+                std::erase_if(pollers_, [](const std::unique_ptr<Poller> &old) {
+                    if (!old->done.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                    if (old->thread.joinable()) {
+                        old->thread.join();
+                    }
+                    return true;
+                });
+                if (started_ && !stopping_.load()) {
+                    launch_locked(*poller);
+                }
+                pollers_.push_back(std::move(poller));
+            }
+
+            /// Start the thread of a poller; caller holds pollers_mutex_
+            void launch_locked(Poller &poller) {
+                Poller *raw = &poller;
+                if (raw->listener) {
+                    raw->thread = std::thread([this, raw]() { accept_loop(*raw); });
+                } else {
+                    raw->thread = std::thread([this, raw]() { receive_loop(*raw); });
+                }
+            }
+
+            void accept_loop(Poller &poller) {
+                while (!stopping_.load(std::memory_order_acquire)) {
+                    auto accept_res = poller.listener->accept();
+                    if (accept_res.is_err()) {
+                        if (accept_res.error().code != dp::Error::TIMEOUT) {
+                            echo::warn("remote server accept failed: ", accept_res.error().message.c_str());
+                            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+                        }
+                        continue;
+                    }
+                    auto &stream = accept_res.value();
+                    if (stream->native_handle() >= 0) {
+                        auto shared = std::make_shared<std::unique_ptr<Stream>>(std::move(stream));
+                        reactor_.post([this, shared]() { watch_connection(std::move(*shared)); });
+                    } else {
+                        (void)serve_unpolled(std::move(stream));
+                    }
+                }
+                poller.done.store(true, std::memory_order_release);
+            }
+
+            /// Receive and dispatch the frames of one connection until it fails or the server stops
+            void receive_loop(Poller &poller) {
+                auto &conn = poller.conn;
+                poller.serving = claim_connection();
+                if (!poller.serving) {
+                    std::lock_guard<std::mutex> lock(conn->out_mutex);
+                    conn->closed = true;
+                    conn->stream->close();
+                    poller.done.store(true, std::memory_order_release);
+                    return;
+                }
+                echo::debug("remote server connection added without fd, total=", connection_count_.load());
+
+                Message frame;
+                while (!stopping_.load(std::memory_order_acquire)) {
+                    {
+                        std::lock_guard<std::mutex> lock(conn->out_mutex);
+                        if (conn->closed) { // A response could not be written
+                            break;
+                        }
+                    }
+                    auto recv_res = conn->stream->recv_into(frame);
+                    if (recv_res.is_err()) {
+                        if (recv_res.error().code == dp::Error::TIMEOUT) {
+                            continue;
+                        }
+                        echo::trace("remote server receive failed: ", recv_res.error().message.c_str());
+                        break;
+                    }
+                    // The stream charged the frame already; the same reservation then covers handling it
+                    BudgetLease charged = conn->stream->take_lease();
+                    if (charged.budget() != budget_) {
+                        charged.release();
+                    }
+                    if (frame.size() > max_frame_size_) {
+                        echo::error("remote server frame too large: ", frame.size(), " bytes (max: ",
+                                    max_frame_size_, ")");
+                        break;
+                    }
+                    if (!dispatch_frame(conn, frame.data(), static_cast<dp::u32>(frame.size()), std::move(charged))) {
+                        break;
+                    }
+                }
+                // On stop() the connection stays open until the queued handlers have answered
+                if (!stopping_.load(std::memory_order_acquire)) {
+                    release_unpolled(poller);
+                }
+                poller.done.store(true, std::memory_order_release);
+            }
+
+            /// Close a poller's connection and give back its slot
+            void release_unpolled(Poller &poller) {
+                if (!poller.serving) {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(poller.conn->out_mutex);
+                    poller.conn->closed = true;
+                    poller.conn->stream->close();
+                }
+                poller.serving = false;
+                connection_count_--;
+                echo::debug("remote server connection without fd closed, total=", connection_count_.load());
+            }
+
+            /// charged is the frame's reservation when it was made while reading it (see read_available)
+            bool dispatch_frame(const std::shared_ptr<Connection> &conn, const dp::u8 *data, dp::u32 length,
+                                BudgetLease charged = {}) {
+                DecodedMessageView header{};
+                auto header_res = decode_remote_header_v2(data, length, header);
+                if (header_res.is_err() || header_res.value() != length - V2_HEADER_SIZE) {
+                    echo::error("remote server received malformed frame on fd=", conn->fd);
+                    return false;
+                }
+                if (header.type != MessageType::Request) {
+                    echo::warn("remote server ignoring message type ", static_cast<int>(header.type));
+                    return true;
+                }
+
+                dp::u32 deadline_ms;
+                auto body_res =
+                    take_deadline_trailer(header.flags, data + V2_HEADER_SIZE, header_res.value(), deadline_ms);
+                if (body_res.is_err()) {
+                    return false;
+                }
+                auto deadline = DeadlineScope::from_budget(deadline_ms);
+
+                dp::u32 request_id = header.request_id;
+                dp::u32 method_id = header.method_id;
+                dp::u16 flags = header.flags;
+                // Over budget: turned away here on the loop thread, before the payload is copied or any pool
+                // thread is spent on it
+                auto held = std::make_shared<BudgetLease>(std::move(charged));
+                if (budget_->enabled() && !held->budget()) {
+                    if (budget_->rejecting() || !budget_->try_reserve(body_res.value())) {
+                        reject_over_budget(conn, request_id, method_id);
+                        return true;
+                    }
+                    *held = BudgetLease(budget_, body_res.value());
+                }
+                Message payload;
+                payload.assign(data + V2_HEADER_SIZE, data + V2_HEADER_SIZE + body_res.value());
+                if (!(flags & MessageFlags::Compressed)) {
+                    // Cached answer: written from the reactor thread, the pool never sees the request
+                    if (auto cached = registry_.cache().lookup(method_id, payload)) {
+                        queue_response(conn, request_id, method_id, cached->payload, MessageType::Response,
+                                       cached->flags);
+                        return true;
+                    }
+                }
+                bool submitted = pool_->submit([this, conn, request_id, method_id, flags, deadline, held,
+                                                payload = std::move(payload)]() mutable {
+                        // Nobody waits for the answer any more - skip the work instead of delaying the queue
+                        if (DeadlineScope::expired(deadline)) {
+                            echo::debug("remote server dropping expired request id=", request_id);
+                            expired_requests_.fetch_add(1, std::memory_order_relaxed);
+                            return;
+                        }
+                        DeadlineScope scope(deadline);
+                        handle_request(conn, request_id, method_id, flags, payload);
+                        held->release();
+                    });
+                if (!submitted) {
+                    echo::warn("handler pool queue full, rejecting request id=", request_id);
+                    dp::String error_msg = "Handler pool overloaded";
+                    Message error_payload;
+                    error_payload.assign(error_msg.begin(), error_msg.end());
+                    queue_response(conn, request_id, method_id, error_payload, MessageType::Error);
+                }
+                return true;
+            }
+
+            /// Runs on a pool thread
+            void handle_request(const std::shared_ptr<Connection> &conn, dp::u32 request_id, dp::u32 method_id,
+                                dp::u16 flags, Message &payload) {
+                echo::trace("remote server handling request id=", request_id, " method=", method_id);
+
+                Message response_payload;
+                MessageType response_type = MessageType::Response;
+
+                bool cacheable = !(flags & MessageFlags::Compressed) && registry_.cache().enabled(method_id);
+                dp::u64 cache_generation = registry_.cache().generation();
+                Message spare;
+                BudgetLease inflated; // Counted until the response is queued
+                auto inflate_res = decompress_payload(flags, payload, spare, budget_, inflated);
+                std::optional<dp::Res<Message>> result;
+                if (inflate_res.is_ok()) {
+                    result = registry_.dispatch(method_id, payload);
+                }
+                if (inflate_res.is_err()) {
+                    echo::warn("request decompression failed: ", inflate_res.error().message.c_str());
+                    response_payload.assign(inflate_res.error().message.begin(), inflate_res.error().message.end());
+                    response_type = MessageType::Error;
+                } else if (!result) {
+                    echo::warn("no handler for method_id: ", method_id);
+                    dp::String error_msg =
+                        dp::String("No handler for method_id: ") + dp::String(std::to_string(method_id).c_str());
+                    response_payload.assign(error_msg.begin(), error_msg.end());
+                    response_type = MessageType::Error;
+                } else if (result->is_err()) {
+                    echo::warn("handler returned error: ", result->error().message.c_str());
+                    response_payload.assign(result->error().message.begin(), result->error().message.end());
+                    response_type = MessageType::Error;
+                } else {
+                    response_payload = std::move(result->value());
+                }
+
+                dp::u16 response_flags = MessageFlags::None;
+                const Message &wire = compressor_.apply(response_payload, response_flags);
+                if (cacheable && response_type == MessageType::Response) {
+                    registry_.cache().store(method_id, payload, wire, response_flags, cache_generation);
+                }
+                queue_response(conn, request_id, method_id, wire, response_type, response_flags);
+            }
+
+            /// Write a framed response, straight from the caller's buffers when nothing is queued ahead of it
+            /// Whatever the socket does not take is copied into the outbox and flushed on EPOLLOUT
+            void queue_response(const std::shared_ptr<Connection> &conn, dp::u32 request_id, dp::u32 method_id,
+                                const Message &payload, MessageType type, dp::u16 flags = MessageFlags::None) {
+                auto header =
+                    encode_remote_header_v2(request_id, method_id, static_cast<dp::u32>(payload.size()), type, flags);
+                auto prefix = encode_u32_be(static_cast<dp::u32>(V2_HEADER_SIZE + payload.size()));
+
+                iovec iov[3] = {{prefix.data(), prefix.size()},
+                                {header.data(), header.size()},
+                                {const_cast<dp::u8 *>(payload.data()), payload.size()}};
+                dp::usize total = prefix.size() + header.size() + payload.size();
+
+                std::lock_guard<std::mutex> lock(conn->out_mutex);
+                if (conn->closed) {
+                    return;
+                }
+                if (conn->fd < 0) {
+                    // No fd to write to: the stream frames the response itself, pool threads take turns
+                    auto send_res = conn->stream->send_iov(std::span<const iovec>(iov + 1, payload.empty() ? 1 : 2));
+                    if (send_res.is_err()) {
+                        echo::trace("remote server send failed: ", send_res.error().message.c_str());
+                        conn->closed = true;
+                    }
+                    return;
+                }
+
+                dp::usize written = 0;
+                if (conn->outbox_start == conn->outbox.size()) {
+                    dp::isize n = send_nosignal(conn->fd, iov, payload.empty() ? 2 : 3);
+                    if (conn->counters) {
+                        conn->counters->on_send_call(n >= 0 && static_cast<dp::usize>(n) < total);
+                    }
+                    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                        echo::trace("remote server send failed fd=", conn->fd, ": ", strerror(errno));
+                        conn->closed = true;
+                        reactor_.post([this, conn]() { close_connection(conn); });
+                        return;
+                    }
+                    written = n > 0 ? static_cast<dp::usize>(n) : 0;
+                }
+                // Counted as sent here, whether the socket took it all or the outbox keeps the rest
+                if (conn->counters) {
+                    conn->counters->on_send(total - prefix.size());
+                }
+                if (written == total) {
+                    return;
+                }
+
+                // Queue the unsent tail
+                for (const auto &part : iov) {
+                    if (written >= part.iov_len) {
+                        written -= part.iov_len;
+                        continue;
+                    }
+                    const dp::u8 *base = static_cast<const dp::u8 *>(part.iov_base) + written;
+                    conn->outbox.insert(conn->outbox.end(), base, base + (part.iov_len - written));
+                    written = 0;
+                }
+
+                if (!conn->write_armed) {
+                    conn->write_armed = true;
+                    reactor_.post([this, conn]() {
+                        auto it = connections_.find(conn->fd);
+                        if (it != connections_.end() && it->second == conn) {
+                            reactor_.modify(conn->fd, EPOLLIN | EPOLLOUT);
+                        }
+                    });
+                }
+            }
+
+            /// Push the outbox into the socket; caller holds out_mutex. False on a write error
+            bool flush_locked(Connection &conn) {
+                while (conn.outbox_start < conn.outbox.size()) {
+                    iovec iov = {conn.outbox.data() + conn.outbox_start, conn.outbox.size() - conn.outbox_start};
+                    dp::isize n = send_nosignal(conn.fd, &iov, 1);
+                    if (conn.counters) {
+                        conn.counters->on_send_call(n >= 0 && static_cast<dp::usize>(n) < iov.iov_len);
+                    }
+                    if (n < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                            return true;
+                        }
+                        echo::trace("remote server flush failed fd=", conn.fd, ": ", strerror(errno));
+                        return false;
+                    }
+                    conn.outbox_start += static_cast<dp::usize>(n);
+                }
+                conn.outbox.clear();
+                conn.outbox_start = 0;
+                return true;
+            }
+
+          public:
+            /// @param handler_threads Pool threads shared by every connection
+            /// @param max_queue Requests allowed to wait for a pool thread before callers get "overloaded" errors
+            explicit RemoteServer(dp::usize handler_threads = 4, dp::usize max_queue = 1000)
+                : pool_(std::make_unique<WorkStealingExecutor>(handler_threads, max_queue)), connection_count_(0),
+                  expired_requests_(0) {
+                echo::trace("RemoteServer constructed with ", handler_threads, " handler threads");
+            }
+
+            ~RemoteServer() { stop(); }
+
+            RemoteServer(const RemoteServer &) = delete;
+            RemoteServer &operator=(const RemoteServer &) = delete;
+
+            /// Register a handler for a specific method_id (before start())
+            dp::Res<void> register_method(dp::u32 method_id, Handler handler) {
+                return registry_.register_method(method_id, handler);
+            }
+
+            /// Set default handler for unknown methods (before start())
+            void set_default_handler(Handler handler) { registry_.set_default_handler(handler); }
+
+            /// Serve the methods of a StaticRegistry (before start()); they win over register_method() ids
+            template <typename Table> void register_static_methods() { registry_.mount<Table>(); }
+
+            /// Answer repeated requests to an idempotent method from the response cache (before start())
+            /// Hits are written by the event loop without queueing on the handler pool (see ResponseCache)
+            void set_method_cached(dp::u32 method_id, dp::u32 ttl_ms = 0) { registry_.set_cached(method_id, ttl_ms); }
+
+            /// Forget the cached answers of method_id; safe while serving
+            dp::usize invalidate_cached(dp::u32 method_id) { return registry_.invalidate_cached(method_id); }
+
+            /// Response cache: capacity, per-request invalidation and hit/miss counters
+            ResponseCache &response_cache() { return registry_.cache(); }
+
+            /// Compress responses of at least threshold bytes with codec (before start()); requests are inflated
+            /// whenever a client sends them compressed
+            void set_compression(std::shared_ptr<const Codec> codec,
+                                 dp::usize threshold = DEFAULT_COMPRESSION_THRESHOLD) {
+                compressor_ = PayloadCompressor(std::move(codec), threshold);
+            }
+
+            /// Count request payloads against budget instead of MemoryBudget::global() (before start())
+            /// Requests that do not fit, or arrive past its reject watermark, are answered with an error at once.
+            void set_memory_budget(MemoryBudget &budget) { budget_ = &budget; }
+
+            /// Refuse connections beyond max open ones (0 = unlimited, the default; before start())
+            /// Refused connections are closed as soon as they are accepted, before anything is read from them.
+            void set_max_connections(dp::usize max) { max_connections_ = max; }
+
+            /// Close connections that announce a frame (V2 header included) above bytes (before start())
+            /// Defaults to the protocol maximum; lower it so no single client can make the loop thread buffer more.
+            void set_max_frame_size(dp::u32 bytes) { max_frame_size_ = bytes; }
+
+            /// Accept connections from a listening TcpStream/IpcStream on the event loop, or from a listening
+            /// ShmStream on an accept thread of its own
+            dp::Res<void> add_listener(std::unique_ptr<Stream> listener) {
+                if (!listener) {
+                    return dp::result::err(dp::Error::invalid_argument("no listener"));
+                }
+                if (listener->native_handle() < 0) {
+                    if (listener->set_recv_timeout(POLL_INTERVAL_MS).is_err()) {
+                        echo::error("remote server listener cannot time out its accepts");
+                        return dp::result::err(dp::Error::invalid_argument("listener has no accept timeout"));
+                    }
+                    auto poller = std::make_unique<Poller>();
+                    poller->listener = std::move(listener);
+                    add_poller(std::move(poller));
+                    return dp::result::ok();
+                }
+                auto shared = std::make_shared<std::unique_ptr<Stream>>(std::move(listener));
+                reactor_.post([this, shared]() { watch_listener(std::move(*shared)); });
+                return dp::result::ok();
+            }
+
+            /// Serve an already connected stream (must not have been read from yet)
+            /// Streams without a pollable fd (ShmStream) get a receive thread of their own.
+            dp::Res<void> add_connection(std::unique_ptr<Stream> stream) {
+                if (!stream || !stream->is_connected()) {
+                    echo::error("remote server connection is not connected");
+                    return dp::result::err(dp::Error::invalid_argument("stream not connected"));
+                }
+                if (stream->native_handle() < 0) {
+                    return serve_unpolled(std::move(stream));
+                }
+                auto shared = std::make_shared<std::unique_ptr<Stream>>(std::move(stream));
+                reactor_.post([this, shared]() { watch_connection(std::move(*shared)); });
+                return dp::result::ok();
+            }
+
+            /// Run the event loop on a background thread
+            dp::Res<void> start() {
+                if (!reactor_.is_valid()) {
+                    return dp::result::err(dp::Error::io_error("reactor not initialized"));
+                }
+                if (loop_thread_.joinable()) {
+                    return dp::result::err(dp::Error::invalid_argument("already started"));
+                }
+                loop_thread_ = std::thread([this]() { reactor_.run(); });
+                {
+                    std::lock_guard<std::mutex> lock(pollers_mutex_);
+                    started_ = true;
+                    for (auto &poller : pollers_) {
+                        launch_locked(*poller);
+                    }
+                }
+                echo::info("remote server started");
+                return dp::result::ok();
+            }
+
+            /// Stop the loop, finish queued handlers and close every connection and listener
+            void stop() {
+                stopping_.store(true, std::memory_order_release);
+                reactor_.stop();
+                if (loop_thread_.joinable()) {
+                    loop_thread_.join();
+                }
+                // Accept threads may still add pollers while being joined, so take one thread at a time
+                while (true) {
+                    std::thread poller_thread;
+                    {
+                        std::lock_guard<std::mutex> lock(pollers_mutex_);
+                        for (auto &poller : pollers_) {
+                            if (poller->thread.joinable()) {
+                                poller_thread = std::move(poller->thread);
+                                break;
+                            }
+                        }
+                    }
+                    if (!poller_thread.joinable()) {
+                        break;
+                    }
+                    poller_thread.join();
+                }
+                if (pool_) {
+                    pool_->shutdown();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(pollers_mutex_);
+                    for (auto &poller : pollers_) {
+                        if (poller->listener) {
+                            poller->listener->close();
+                        } else {
+                            release_unpolled(*poller);
+                        }
+                    }
+                    pollers_.clear();
+                }
+
+                while (!connections_.empty()) {
+                    close_connection(connections_.begin()->second);
+                }
+                for (auto &listener : listeners_) {
+                    reactor_.remove(listener->native_handle());
+                    listener->close();
+                }
+                listeners_.clear();
+            }
+
+            /// Open client connections, with or without an fd
+            /// An SHM client is noticed gone when it closes, or within a second of its process dying.
+            dp::usize connection_count() const { return connection_count_.load(); }
+
+            /// Connections closed unserved because max_connections were already open
+            dp::u64 refused_connection_count() const { return refused_connections_.load(std::memory_order_relaxed); }
+
+            /// Requests dropped unanswered because they carried a deadline that passed while they were queued
+            dp::u64 expired_request_count() const { return expired_requests_.load(std::memory_order_relaxed); }
+
+            /// Get number of registered methods
+            dp::usize method_count() const { return registry_.method_count(); }
+        };
+
+    } // namespace remote
+} // namespace netpipe
@@ -6,9 +6,12 @@
 #include <map>
 #include <mutex>
 #include <netpipe/remote/protocol.hpp>
+#include <netpipe/remote/remote.hpp>
 #include <netpipe/stream.hpp>
+#include <optional>
 #include <queue>
 #include <thread>
+#include <utility>
 
 namespace netpipe {
     namespace remote {
@@ -16,6 +19,44 @@ namespace netpipe {
         /// Stream callback - called for each chunk received
         using StreamCallback = std::function<void(const Message &chunk)>;
 
+        /// Chunk producer for client_stream - fill chunk (handed over empty) and return true while more may follow
+        /// Return false with the last chunk in it, or with it left empty when the end is only known afterwards
+        /// (the upload then ends with an empty Final chunk); an error aborts the upload
+        using ChunkProducer = std::function<dp::Res<bool>(Message &chunk)>;
+
+        /// Per-stream flow-control window, the same on both peers
+        /// Each side starts with this much credit towards the other and may not send StreamData beyond it;
+        /// the receiver hands credit back with StreamCredit messages as the application consumes chunks.
+        /// A chunk bigger than bytes still goes out once the sender has its whole byte window back.
+        struct StreamWindow {
+            dp::u32 chunks = 64;          // Unacknowledged chunks in flight; 0 turns flow control off
+            dp::u32 bytes = 1024 * 1024;  // Unacknowledged payload bytes in flight; 0 counts chunks only
+
+            bool enabled() const { return chunks != 0; }
+
+            /// Whether credit of chunk_credit/byte_credit covers a chunk of size bytes
+            bool allows(dp::i64 chunk_credit, dp::i64 byte_credit, dp::usize size) const {
+                if (!enabled()) {
+                    return true;
+                }
+                if (chunk_credit <= 0) {
+                    return false;
+                }
+                return bytes == 0 || byte_credit >= static_cast<dp::i64>(size) || byte_credit == bytes;
+            }
+        };
+
+        /// Coalescing of small outgoing chunks, off by default (peers must understand MessageFlags::Batch)
+        /// Chunks of one stream are packed into a single StreamData frame until it holds max_bytes, a Final chunk
+        /// is added, or the first chunk in it has waited linger_us. Every chunk still takes its own credit, and
+        /// the receiver unpacks the frame before callbacks or recv_chunk() see anything.
+        struct ChunkBatching {
+            dp::u32 max_bytes = 0;    // Payload bytes per batched frame; 0 turns batching off
+            dp::u32 linger_us = 1000; // Longest a chunk waits for company; 0 = only size and Final flush
+
+            bool enabled() const { return max_bytes != 0; }
+        };
+
         /// Stream state
         struct StreamState {
             dp::u32 stream_id;
@@ -27,25 +68,148 @@ namespace netpipe {
             dp::String error_message;
             StreamCallback callback;
 
-            StreamState(dp::u32 id) : stream_id(id), completed(false), error(false) {}
+            // Flow control: credit left for our StreamData, and the peer's credit towards us as we track it
+            dp::i64 send_chunks;
+            dp::i64 send_bytes;
+            dp::i64 recv_chunks;
+            dp::i64 recv_bytes;
+            dp::u32 consumed_chunks; // Taken by the application but not yet granted back
+            dp::u64 consumed_bytes;
+
+            // Batched frames are sent outside the batch lock, in the order of tickets drawn under it
+            std::mutex order_mutex;
+            std::condition_variable order_cv;
+            dp::u64 next_ticket; // Guarded by StreamingRemote's batch_mutex_
+            dp::u64 serving;
+
+            StreamState(dp::u32 id, StreamWindow window = {})
+                : stream_id(id), completed(false), error(false), send_chunks(window.chunks),
+                  send_bytes(window.bytes), recv_chunks(window.chunks), recv_bytes(window.bytes), consumed_chunks(0),
+                  consumed_bytes(0), next_ticket(0), serving(0) {}
         };
 
         /// Streaming Remote - supports client, server, and bidirectional streaming
         class StreamingRemote {
           private:
-            Stream &stream_;
+            Stream *stream_;           // Own connection, or nullptr when sharing rpc_'s
+            Remote<Bidirect> *rpc_;    // Connection owner when multiplexed with RPC traffic
             std::atomic<dp::u32> next_stream_id_;
             std::map<dp::u32, std::shared_ptr<StreamState>> active_streams_;
             mutable std::mutex streams_mutex_;
             std::thread receiver_thread_;
             std::atomic<bool> running_;
+            StreamWindow window_;
+            FairMutex send_mutex_; // Credit grants go out from the receiver thread alongside callers' chunks
+
+            // Chunk coalescing: one open batch per stream, taken out under batch_mutex_ and sent after it is
+            // released, each stream's frames in ticket order (see send_in_turn)
+            struct PendingBatch {
+                std::shared_ptr<StreamState> stream;
+                dp::u32 method_id = 0;
+                Message payload; // [length:4][chunk]...
+                dp::u32 chunks = 0;
+                std::chrono::steady_clock::time_point started;
+            };
+            /// A closed batch on its way out
+            struct ClosedBatch {
+                std::shared_ptr<StreamState> stream;
+                dp::u64 ticket = 0;
+                dp::u32 method_id = 0;
+                Message payload;
+                dp::u16 flags = 0;
+            };
+            ChunkBatching batching_;
+            std::map<dp::u32, PendingBatch> batches_;
+            std::mutex batch_mutex_;
+            std::condition_variable batch_cv_;
+            std::thread flush_thread_;
+
+            /// Every frame leaves through here - our stream, or the shared Remote<Bidirect> writer
+            dp::Res<void> send_frame(dp::u32 stream_id, dp::u32 method_id, const Message &payload, MessageType type,
+                                     dp::u16 flags = MessageFlags::None) {
+                if (rpc_) {
+                    return rpc_->send_frame(stream_id, method_id, payload, type, flags);
+                }
+                std::lock_guard<FairMutex> lock(send_mutex_);
+                return send_remote_message_v2(*stream_, stream_id, method_id, payload, type, flags);
+            }
+
+            /// Count a chunk the application has taken; returns the credit to grant back, or {0, 0} while it
+            /// is still below half a window (batching keeps grants to a couple per window). Caller holds mutex.
+            std::pair<dp::u32, dp::u32> consume(StreamState &stream, dp::usize size) {
+                if (!window_.enabled()) {
+                    return {0, 0};
+                }
+                stream.consumed_chunks++;
+                stream.consumed_bytes += size;
+                if (stream.consumed_chunks * 2 < window_.chunks &&
+                    (window_.bytes == 0 || stream.consumed_bytes * 2 < window_.bytes)) {
+                    return {0, 0};
+                }
+                std::pair<dp::u32, dp::u32> grant{stream.consumed_chunks, static_cast<dp::u32>(stream.consumed_bytes)};
+                stream.recv_chunks += grant.first;
+                stream.recv_bytes += grant.second;
+                stream.consumed_chunks = 0;
+                stream.consumed_bytes = 0;
+                return grant;
+            }
+
+            void send_credit(dp::u32 stream_id, std::pair<dp::u32, dp::u32> grant) {
+                if (grant.first == 0) {
+                    return;
+                }
+                auto chunks = encode_u32_be(grant.first);
+                auto bytes = encode_u32_be(grant.second);
+                Message payload(chunks.begin(), chunks.end());
+                payload.insert(payload.end(), bytes.begin(), bytes.end());
+                auto send_res = send_frame(stream_id, 0, payload, MessageType::StreamCredit, MessageFlags::Streaming);
+                if (send_res.is_err()) {
+                    echo::warn("stream credit send failed id=", stream_id);
+                }
+            }
+
+            /// Block until the window admits a chunk of size bytes (at most timeout_ms, 0 = do not wait)
+            /// and take that credit
+            /// Chunks still in our own open batch hold credit the peer cannot return, so that batch goes out first
+            dp::Res<void> reserve_credit(StreamState &stream, dp::usize size, dp::u32 timeout_ms) {
+                std::unique_lock<std::mutex> lock(stream.mutex);
+                auto has_credit = [&] { return window_.allows(stream.send_chunks, stream.send_bytes, size); };
+                if (!stream.completed && !has_credit() && batching_.enabled()) {
+                    lock.unlock();
+                    auto flush_res = flush_stream(stream.stream_id);
+                    if (flush_res.is_err()) {
+                        return flush_res;
+                    }
+                    lock.lock();
+                }
+                if (!stream.cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                        [&] { return stream.completed || has_credit(); })) {
+                    return dp::result::err(dp::Error::timeout("stream credit exhausted"));
+                }
+                if (!has_credit()) {
+                    return dp::result::err(dp::Error::io_error("stream closed"));
+                }
+                stream.send_chunks--;
+                stream.send_bytes -= static_cast<dp::i64>(size);
+                return dp::result::ok();
+            }
+
+            std::shared_ptr<StreamState> find_stream(dp::u32 stream_id) const {
+                std::lock_guard<std::mutex> lock(streams_mutex_);
+                auto it = active_streams_.find(stream_id);
+                return it == active_streams_.end() ? nullptr : it->second;
+            }
 
             /// Receiver thread - processes incoming stream messages
             void receiver_loop() {
                 echo::debug("streaming remote receiver thread started");
 
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+
                 while (running_) {
-                    auto recv_res = stream_.recv();
+                    // Fresh payload buffer per message: chunks are queued by move, not copied
+                    Message payload;
+                    auto recv_res = stream_->recv_split(header.data(), header.size(), payload);
                     if (recv_res.is_err()) {
                         // Timeout is expected
                         if (recv_res.error().code == dp::Error::TIMEOUT) {
@@ -57,72 +221,361 @@ namespace netpipe {
                         break;
                     }
 
-                    auto decode_res = decode_remote_message_v2(recv_res.value());
+                    auto decode_res = decode_remote_message_v2(header.data(), recv_res.value(), std::move(payload));
                     if (decode_res.is_err()) {
                         echo::error("streaming remote decode failed");
                         continue;
                     }
 
-                    auto decoded = decode_res.value();
+                    auto decoded = std::move(decode_res.value());
                     handle_stream_message(decoded);
                 }
 
                 echo::debug("streaming remote receiver thread stopped");
             }
 
-            /// Handle incoming stream message
-            void handle_stream_message(const DecodedMessageV2 &decoded) {
-                dp::u32 stream_id = decoded.request_id; // Using request_id as stream_id
+            void fail_stream(StreamState &stream, const char *reason) {
+                stream.error = true;
+                stream.error_message = reason;
+                stream.completed = true;
+                stream.cv.notify_all();
+            }
 
-                // Find stream
-                std::shared_ptr<StreamState> stream;
+            /// Take one data chunk - only as much as the credit we granted, so the queue stays bounded
+            /// Adds any credit to hand back to grant; false when the peer overran its window. Caller holds mutex.
+            bool accept_chunk(StreamState &stream, Message &&chunk, std::pair<dp::u32, dp::u32> &grant) {
+                dp::usize size = chunk.size();
+                if (!window_.allows(stream.recv_chunks, stream.recv_bytes, size)) {
+                    echo::error("stream ", stream.stream_id, " peer sent past its flow-control window");
+                    fail_stream(stream, "stream flow control violated");
+                    return false;
+                }
+                stream.recv_chunks--;
+                stream.recv_bytes -= static_cast<dp::i64>(size);
+
+                if (stream.callback) {
+                    stream.callback(chunk);
+                    auto more = consume(stream, size);
+                    grant.first += more.first;
+                    grant.second += more.second;
+                } else {
+                    stream.chunks.push(std::move(chunk)); // Credit returns when recv_chunk() takes it
+                }
+                return true;
+            }
+
+            /// Send a data chunk whose credit is already taken, through the stream's batch when batching is on
+            dp::Res<void> send_data(const std::shared_ptr<StreamState> &stream, dp::u32 method_id, const Message &chunk,
+                                    bool is_final) {
+                dp::u32 stream_id = stream->stream_id;
+                dp::u16 flags = MessageFlags::Streaming;
+                if (is_final) {
+                    flags |= MessageFlags::Final;
+                }
+                if (!batching_.enabled()) {
+                    return send_frame(stream_id, method_id, chunk, MessageType::StreamData, flags);
+                }
+
+                std::optional<ClosedBatch> full;   // The open batch chunk does not fit into
+                std::optional<ClosedBatch> closed; // The batch chunk completes
+                bool direct = false;               // chunk goes out as a frame of its own
+                dp::u64 ticket = 0;
                 {
-                    std::lock_guard<std::mutex> lock(streams_mutex_);
-                    auto it = active_streams_.find(stream_id);
-                    if (it != active_streams_.end()) {
-                        stream = it->second;
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    auto it = batches_.find(stream_id);
+                    if (it != batches_.end() && it->second.payload.size() + 4 + chunk.size() > batching_.max_bytes) {
+                        full = close_batch(it, MessageFlags::None);
+                        it = batches_.end();
+                    }
+                    if (it == batches_.end() && (is_final || chunk.size() + 4 > batching_.max_bytes)) {
+                        direct = true; // Nothing to join
+                    } else {
+                        if (it == batches_.end()) {
+                            it = batches_.emplace(stream_id, PendingBatch{}).first;
+                            it->second.stream = stream;
+                            it->second.method_id = method_id;
+                            it->second.started = std::chrono::steady_clock::now();
+                            it->second.payload.reserve(batching_.max_bytes);
+                            batch_cv_.notify_one();
+                        }
+                        auto length = encode_u32_be(static_cast<dp::u32>(chunk.size()));
+                        it->second.payload.insert(it->second.payload.end(), length.begin(), length.end());
+                        it->second.payload.insert(it->second.payload.end(), chunk.begin(), chunk.end());
+                        it->second.chunks++;
+                        if (is_final || it->second.payload.size() + 4 >= batching_.max_bytes) {
+                            closed = close_batch(it, is_final ? MessageFlags::Final : MessageFlags::None);
+                        }
+                    }
+                    if (!full && !closed && !direct) {
+                        return dp::result::ok(); // Waits in its batch
+                    }
+                    ticket = stream->next_ticket++;
+                }
+
+                return send_in_turn(*stream, ticket, [&]() -> dp::Res<void> {
+                    if (full) {
+                        auto res = send_frame(stream_id, full->method_id, full->payload, MessageType::StreamData,
+                                              full->flags);
+                        if (res.is_err()) {
+                            return res;
+                        }
+                    }
+                    if (closed) {
+                        return send_frame(stream_id, closed->method_id, closed->payload, MessageType::StreamData,
+                                          closed->flags);
+                    }
+                    if (direct) {
+                        return send_frame(stream_id, method_id, chunk, MessageType::StreamData, flags);
+                    }
+                    return dp::result::ok();
+                });
+            }
+
+            /// Take one open batch out of batches_; a batch of one becomes a plain frame. Caller holds batch_mutex_
+            /// and draws the batch's ticket.
+            ClosedBatch close_batch(std::map<dp::u32, PendingBatch>::iterator it, dp::u16 extra_flags) {
+                ClosedBatch batch;
+                batch.stream = std::move(it->second.stream);
+                batch.method_id = it->second.method_id;
+                batch.payload = std::move(it->second.payload);
+                batch.flags = MessageFlags::Streaming | extra_flags;
+                if (it->second.chunks == 1) {
+                    batch.payload.erase(batch.payload.begin(), batch.payload.begin() + 4);
+                } else {
+                    batch.flags |= MessageFlags::Batch;
+                }
+                batches_.erase(it);
+                return batch;
+            }
+
+            /// Same as close_batch, with the ticket drawn
+            ClosedBatch close_ticketed(std::map<dp::u32, PendingBatch>::iterator it) {
+                ClosedBatch batch = close_batch(it, MessageFlags::None);
+                batch.ticket = batch.stream->next_ticket++;
+                return batch;
+            }
+
+            /// Run send once every frame of the stream ticketed before ticket has left
+            template <typename Send> dp::Res<void> send_in_turn(StreamState &stream, dp::u64 ticket, Send send) {
+                {
+                    std::unique_lock<std::mutex> lock(stream.order_mutex);
+                    stream.order_cv.wait(lock, [&] { return stream.serving == ticket; });
+                }
+                auto res = send();
+                {
+                    std::lock_guard<std::mutex> lock(stream.order_mutex);
+                    stream.serving++;
+                }
+                stream.order_cv.notify_all();
+                return res;
+            }
+
+            /// Send a closed batch in its turn; one without flags only waits for the frames ticketed before it
+            dp::Res<void> send_closed(ClosedBatch &batch) {
+                dp::u32 stream_id = batch.stream->stream_id;
+                return send_in_turn(*batch.stream, batch.ticket, [&]() -> dp::Res<void> {
+                    if (batch.flags == 0) {
+                        return dp::result::ok();
+                    }
+                    return send_frame(stream_id, batch.method_id, batch.payload, MessageType::StreamData, batch.flags);
+                });
+            }
+
+            /// Send whatever is batched for stream_id, returning once every earlier frame of the stream is out
+            dp::Res<void> flush_stream(dp::u32 stream_id) {
+                auto stream = find_stream(stream_id);
+                ClosedBatch batch;
+                {
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    auto it = batches_.find(stream_id);
+                    if (it != batches_.end()) {
+                        batch = close_ticketed(it);
+                    } else if (stream && batching_.enabled()) {
+                        batch.stream = stream;
+                        batch.ticket = stream->next_ticket++;
+                    } else {
+                        return dp::result::ok();
+                    }
+                }
+                return send_closed(batch);
+            }
+
+            /// Flush thread - sends batches whose first chunk has waited linger_us
+            void flush_loop() {
+                auto linger = std::chrono::microseconds(batching_.linger_us);
+                dp::Vector<ClosedBatch> due_batches;
+                std::unique_lock<std::mutex> lock(batch_mutex_);
+                while (running_) {
+                    if (batches_.empty()) {
+                        batch_cv_.wait(lock, [&] { return !running_ || !batches_.empty(); });
+                        continue;
+                    }
+                    auto now = std::chrono::steady_clock::now();
+                    auto next_due = std::chrono::steady_clock::time_point::max();
+                    for (auto it = batches_.begin(); it != batches_.end();) {
+                        auto due = it->second.started + linger;
+                        auto next = std::next(it);
+                        if (due <= now) {
+                            due_batches.push_back(close_ticketed(it));
+                        } else if (due < next_due) {
+                            next_due = due;
+                        }
+                        it = next;
+                    }
+                    if (!due_batches.empty()) {
+                        lock.unlock();
+                        for (auto &batch : due_batches) {
+                            if (send_closed(batch).is_err()) {
+                                echo::warn("stream chunk batch send failed");
+                            }
+                        }
+                        due_batches.clear();
+                        lock.lock();
+                        continue; // Batches opened meanwhile are due later
+                    }
+                    if (next_due != std::chrono::steady_clock::time_point::max()) {
+                        batch_cv_.wait_until(lock, next_due);
                     }
                 }
+            }
+
+            /// Handle incoming stream message
+            void handle_stream_message(DecodedMessageV2 &decoded) {
+                dp::u32 stream_id = decoded.request_id; // Using request_id as stream_id
 
+                // Find stream
+                std::shared_ptr<StreamState> stream = find_stream(stream_id);
                 if (!stream) {
                     echo::warn("received stream message for unknown stream_id: ", stream_id);
                     return;
                 }
 
-                std::lock_guard<std::mutex> lock(stream->mutex);
+                std::unique_lock<std::mutex> lock(stream->mutex);
 
                 if (decoded.type == MessageType::StreamData) {
-                    // Data chunk
-                    if (stream->callback) {
-                        stream->callback(decoded.payload);
-                    } else {
-                        stream->chunks.push(decoded.payload);
+                    std::pair<dp::u32, dp::u32> grant{0, 0};
+                    if (decoded.flags & MessageFlags::Batch) {
+                        // Unpacked here, so callbacks and recv_chunk() see the chunks one by one
+                        const dp::u8 *data = decoded.payload.data();
+                        dp::usize size = decoded.payload.size();
+                        dp::usize offset = 0;
+                        while (offset < size) {
+                            if (size - offset < 4 || decode_u32_be(data + offset) > size - offset - 4) {
+                                echo::error("stream ", stream_id, " malformed chunk batch");
+                                fail_stream(*stream, "malformed chunk batch");
+                                return;
+                            }
+                            dp::usize length = decode_u32_be(data + offset);
+                            Message chunk(data + offset + 4, data + offset + 4 + length);
+                            offset += 4 + length;
+                            if (!accept_chunk(*stream, std::move(chunk), grant)) {
+                                return;
+                            }
+                        }
+                    } else if (!accept_chunk(*stream, std::move(decoded.payload), grant)) {
+                        return;
+                    }
+                    stream->cv.notify_all();
+                    lock.unlock();
+                    send_credit(stream_id, grant);
+                } else if (decoded.type == MessageType::StreamCredit) {
+                    if (decoded.payload.size() < 8) {
+                        echo::warn("malformed stream credit for stream_id: ", stream_id);
+                        return;
                     }
-                    stream->cv.notify_one();
+                    stream->send_chunks += decode_u32_be(decoded.payload.data());
+                    stream->send_bytes += decode_u32_be(decoded.payload.data() + 4);
+                    stream->cv.notify_all();
                 } else if (decoded.type == MessageType::StreamEnd) {
                     // Stream completed
                     stream->completed = true;
-                    stream->cv.notify_one();
+                    stream->cv.notify_all();
                 } else if (decoded.type == MessageType::StreamError) {
                     // Stream error
                     stream->error = true;
                     stream->error_message =
                         dp::String(reinterpret_cast<const char *>(decoded.payload.data()), decoded.payload.size());
                     stream->completed = true;
-                    stream->cv.notify_one();
+                    stream->cv.notify_all();
                 }
             }
 
+            std::shared_ptr<StreamState> open_stream(dp::u32 stream_id) {
+                auto stream_state = std::make_shared<StreamState>(stream_id, window_);
+                std::lock_guard<std::mutex> lock(streams_mutex_);
+                active_streams_[stream_id] = stream_state;
+                return stream_state;
+            }
+
+            /// Stream state for an upload; the response is the first chunk back, later ones are consumed and dropped
+            std::shared_ptr<StreamState> open_client_stream(dp::u32 stream_id,
+                                                            std::shared_ptr<std::optional<Message>> response) {
+                auto stream_state = open_stream(stream_id);
+                std::lock_guard<std::mutex> lock(stream_state->mutex);
+                stream_state->callback = [response](const Message &chunk) {
+                    if (!*response) {
+                        *response = chunk;
+                    }
+                };
+                return stream_state;
+            }
+
+            /// Wait for the answer to an upload whose chunks have all gone out, then retire the stream
+            dp::Res<Message> await_client_stream(dp::u32 stream_id, StreamState &stream_state,
+                                                 std::optional<Message> &response, dp::u32 timeout_ms) {
+                std::unique_lock<std::mutex> lock(stream_state.mutex);
+                bool done = stream_state.cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                                     [&] { return stream_state.completed; });
+                dp::Res<Message> result = dp::result::ok(Message());
+                if (!done) {
+                    result = dp::result::err(dp::Error::timeout("client stream timeout"));
+                } else if (stream_state.error) {
+                    result = dp::result::err(dp::Error::io_error(stream_state.error_message.c_str()));
+                } else if (response) {
+                    result = dp::result::ok(std::move(*response));
+                }
+                lock.unlock();
+
+                std::lock_guard<std::mutex> slock(streams_mutex_);
+                active_streams_.erase(stream_id);
+                return result;
+            }
+
           public:
-            explicit StreamingRemote(Stream &stream) : stream_(stream), next_stream_id_(0), running_(true) {
+            /// @param window Flow-control window per stream; both peers must use the same one
+            explicit StreamingRemote(Stream &stream, StreamWindow window = {})
+                : stream_(&stream), rpc_(nullptr), next_stream_id_(0), running_(true), window_(window) {
                 echo::trace("StreamingRemote constructed");
-                stream_.set_recv_timeout(100); // 100ms timeout
+                stream_->set_recv_timeout(100); // 100ms timeout
                 receiver_thread_ = std::thread(&StreamingRemote::receiver_loop, this);
             }
 
+            /// Streams multiplexed on rpc's connection: no second socket or receiver thread
+            /// rpc's receiver hands over stream frames and chunks queue fairly with its calls and responses.
+            /// rpc must outlive this object (see Session for a pair that is torn down in the right order).
+            explicit StreamingRemote(Remote<Bidirect> &rpc, StreamWindow window = {})
+                : stream_(nullptr), rpc_(&rpc), next_stream_id_(0), running_(true), window_(window) {
+                echo::trace("StreamingRemote constructed on a shared Remote<Bidirect>");
+                rpc_->set_stream_sink([this](DecodedMessageV2 &decoded) { handle_stream_message(decoded); });
+            }
+
             ~StreamingRemote() {
                 echo::trace("StreamingRemote shutting down");
-                running_ = false;
+                dp::Vector<ClosedBatch> left;
+                {
+                    std::lock_guard<std::mutex> lock(batch_mutex_);
+                    running_ = false;
+                    while (!batches_.empty()) {
+                        left.push_back(close_ticketed(batches_.begin()));
+                    }
+                }
+                batch_cv_.notify_all();
+                for (auto &batch : left) {
+                    (void)send_closed(batch);
+                }
+                if (flush_thread_.joinable()) {
+                    flush_thread_.join();
+                }
 
                 // Complete all active streams
                 {
@@ -132,12 +585,16 @@ namespace netpipe {
                         pair.second->error = true;
                         pair.second->error_message = "StreamingRemote destroyed";
                         pair.second->completed = true;
-                        pair.second->cv.notify_one();
+                        pair.second->cv.notify_all();
                     }
                     active_streams_.clear();
                 }
 
-                stream_.close();
+                if (rpc_) {
+                    rpc_->set_stream_sink(nullptr); // Waits out a frame being handled right now
+                } else {
+                    stream_->close();
+                }
 
                 if (receiver_thread_.joinable()) {
                     receiver_thread_.join();
@@ -145,31 +602,43 @@ namespace netpipe {
                 echo::trace("StreamingRemote destroyed");
             }
 
+            /// Coalesce small outgoing chunks into batched frames (see ChunkBatching); call once, before the first
+            /// stream. The peer must be a StreamingRemote that knows MessageFlags::Batch.
+            dp::Res<void> set_chunk_batching(ChunkBatching batching) {
+                if (batching_.enabled() || active_stream_count() != 0) {
+                    return dp::result::err(dp::Error::invalid_argument("chunk batching is set before any stream"));
+                }
+                if (batching.enabled() && batching.max_bytes < 8) {
+                    return dp::result::err(dp::Error::invalid_argument("batch max_bytes is too small"));
+                }
+                batching_ = batching;
+                if (batching_.enabled() && batching_.linger_us != 0) {
+                    flush_thread_ = std::thread(&StreamingRemote::flush_loop, this);
+                }
+                return dp::result::ok();
+            }
+
             /// Client streaming: send multiple chunks, receive one response
-            /// Returns the final response
+            /// Returns the final response; each chunk waits up to timeout_ms for flow-control credit
             dp::Res<Message> client_stream(dp::u32 method_id, const dp::Vector<Message> &chunks,
                                            dp::u32 timeout_ms = 5000) {
                 dp::u32 stream_id = next_stream_id_.fetch_add(1);
                 echo::trace("client_stream id=", stream_id, " method=", method_id, " chunks=", chunks.size());
 
-                // Create stream state
-                auto stream_state = std::make_shared<StreamState>(stream_id);
-                {
-                    std::lock_guard<std::mutex> lock(streams_mutex_);
-                    active_streams_[stream_id] = stream_state;
-                }
+                auto response = std::make_shared<std::optional<Message>>();
+                auto stream_state = open_client_stream(stream_id, response);
 
                 // Send all chunks
                 for (dp::usize i = 0; i < chunks.size(); i++) {
                     bool is_final = (i == chunks.size() - 1);
-                    dp::u16 flags = MessageFlags::Streaming;
-                    if (is_final) {
-                        flags |= MessageFlags::Final;
+                    auto credit_res = reserve_credit(*stream_state, chunks[i].size(), timeout_ms);
+                    if (credit_res.is_err()) {
+                        (void)flush_stream(stream_id);
+                        std::lock_guard<std::mutex> lock(streams_mutex_);
+                        active_streams_.erase(stream_id);
+                        return dp::result::err(credit_res.error());
                     }
-
-                    Message msg =
-                        encode_remote_message_v2(stream_id, method_id, chunks[i], MessageType::StreamData, flags);
-                    auto send_res = stream_.send(msg);
+                    auto send_res = send_data(stream_state, method_id, chunks[i], is_final);
                     if (send_res.is_err()) {
                         std::lock_guard<std::mutex> lock(streams_mutex_);
                         active_streams_.erase(stream_id);
@@ -177,32 +646,54 @@ namespace netpipe {
                     }
                 }
 
-                // Wait for response (StreamEnd with final data)
-                {
-                    std::unique_lock<std::mutex> lock(stream_state->mutex);
-                    auto timeout = std::chrono::milliseconds(timeout_ms);
-                    if (!stream_state->cv.wait_for(lock, timeout, [&] { return stream_state->completed; })) {
-                        std::lock_guard<std::mutex> slock(streams_mutex_);
-                        active_streams_.erase(stream_id);
-                        return dp::result::err(dp::Error::timeout("client stream timeout"));
-                    }
+                return await_client_stream(stream_id, *stream_state, *response, timeout_ms);
+            }
 
-                    if (stream_state->error) {
-                        std::lock_guard<std::mutex> slock(streams_mutex_);
-                        active_streams_.erase(stream_id);
-                        return dp::result::err(dp::Error::io_error(stream_state->error_message.c_str()));
+            /// Client streaming from a producer: each chunk goes out as soon as it is produced and credit allows,
+            /// and only then is the next one asked for, so an upload of any size holds one chunk buffer (reused).
+            /// The chunk that comes with a false return is sent with Final, even when empty; an empty upload is
+            /// one empty Final chunk. The producer runs on this thread; an error from it sends StreamError to the
+            /// peer and is returned as is.
+            dp::Res<Message> client_stream(dp::u32 method_id, const ChunkProducer &producer,
+                                           dp::u32 timeout_ms = 5000) {
+                dp::u32 stream_id = next_stream_id_.fetch_add(1);
+                echo::trace("client_stream id=", stream_id, " method=", method_id, " from producer");
+
+                auto response = std::make_shared<std::optional<Message>>();
+                auto stream_state = open_client_stream(stream_id, response);
+                auto abort = [&](const dp::Error &error, bool tell_peer) -> dp::Res<Message> {
+                    (void)flush_stream(stream_id);
+                    if (tell_peer) {
+                        Message reason(error.message.begin(), error.message.end());
+                        (void)send_frame(stream_id, method_id, reason, MessageType::StreamError,
+                                         MessageFlags::Streaming);
                     }
-
-                    // Get final response
-                    Message response;
-                    if (!stream_state->chunks.empty()) {
-                        response = stream_state->chunks.front();
+                    std::lock_guard<std::mutex> lock(streams_mutex_);
+                    active_streams_.erase(stream_id);
+                    return dp::result::err(error);
+                };
+
+                Message chunk;
+                bool last = false;
+                while (!last) {
+                    chunk.clear(); // Keeps the capacity of an earlier chunk
+                    auto more = producer(chunk);
+                    if (more.is_err()) {
+                        return abort(more.error(), true);
                     }
+                    last = !more.value();
 
-                    std::lock_guard<std::mutex> slock(streams_mutex_);
-                    active_streams_.erase(stream_id);
-                    return dp::result::ok(response);
+                    auto credit_res = reserve_credit(*stream_state, chunk.size(), timeout_ms);
+                    if (credit_res.is_err()) {
+                        return abort(credit_res.error(), false);
+                    }
+                    auto send_res = send_data(stream_state, method_id, chunk, last);
+                    if (send_res.is_err()) {
+                        return abort(send_res.error(), false);
+                    }
                 }
+
+                return await_client_stream(stream_id, *stream_state, *response, timeout_ms);
             }
 
             /// Server streaming: send one request, receive multiple chunks
@@ -213,17 +704,12 @@ namespace netpipe {
                 echo::trace("server_stream id=", stream_id, " method=", method_id);
 
                 // Create stream state with callback
-                auto stream_state = std::make_shared<StreamState>(stream_id);
+                auto stream_state = open_stream(stream_id);
                 stream_state->callback = callback;
-                {
-                    std::lock_guard<std::mutex> lock(streams_mutex_);
-                    active_streams_[stream_id] = stream_state;
-                }
 
                 // Send request
-                Message msg = encode_remote_message_v2(stream_id, method_id, request, MessageType::Request,
-                                                       MessageFlags::Streaming | MessageFlags::RequiresAck);
-                auto send_res = stream_.send(msg);
+                auto send_res = send_frame(stream_id, method_id, request, MessageType::Request,
+                                           MessageFlags::Streaming | MessageFlags::RequiresAck);
                 if (send_res.is_err()) {
                     std::lock_guard<std::mutex> lock(streams_mutex_);
                     active_streams_.erase(stream_id);
@@ -253,23 +739,19 @@ namespace netpipe {
             }
 
             /// Bidirectional streaming: send and receive multiple chunks
-            /// Returns stream_id for sending chunks and receiving via callback
-            dp::Res<dp::u32> bidirectional_stream(dp::u32 method_id, StreamCallback callback) {
+            /// Returns stream_id for sending chunks; incoming chunks go to callback, or without one are queued
+            /// for recv_chunk() - at most one window of them, since credit only returns as they are taken
+            dp::Res<dp::u32> bidirectional_stream(dp::u32 method_id, StreamCallback callback = nullptr) {
                 dp::u32 stream_id = next_stream_id_.fetch_add(1);
                 echo::trace("bidirectional_stream id=", stream_id, " method=", method_id);
 
                 // Create stream state with callback
-                auto stream_state = std::make_shared<StreamState>(stream_id);
+                auto stream_state = open_stream(stream_id);
                 stream_state->callback = callback;
-                {
-                    std::lock_guard<std::mutex> lock(streams_mutex_);
-                    active_streams_[stream_id] = stream_state;
-                }
 
                 // Send initial request to start stream
-                Message msg = encode_remote_message_v2(stream_id, method_id, Message(), MessageType::Request,
-                                                       MessageFlags::Streaming);
-                auto send_res = stream_.send(msg);
+                auto send_res =
+                    send_frame(stream_id, method_id, Message(), MessageType::Request, MessageFlags::Streaming);
                 if (send_res.is_err()) {
                     std::lock_guard<std::mutex> lock(streams_mutex_);
                     active_streams_.erase(stream_id);
@@ -280,20 +762,58 @@ namespace netpipe {
             }
 
             /// Send a chunk on a bidirectional stream
-            dp::Res<void> send_chunk(dp::u32 stream_id, const Message &chunk, bool is_final = false) {
-                dp::u16 flags = MessageFlags::Streaming;
-                if (is_final) {
-                    flags |= MessageFlags::Final;
+            /// Waits up to timeout_ms for the peer to grant credit; with 0 it returns a timeout error right away
+            /// when the window is full (would-block)
+            dp::Res<void> send_chunk(dp::u32 stream_id, const Message &chunk, bool is_final = false,
+                                     dp::u32 timeout_ms = 5000) {
+                auto stream_state = find_stream(stream_id);
+                if (!stream_state) {
+                    return dp::result::err(dp::Error::not_found("unknown stream"));
+                }
+                auto credit_res = reserve_credit(*stream_state, chunk.size(), timeout_ms);
+                if (credit_res.is_err()) {
+                    return credit_res;
+                }
+                return send_data(stream_state, 0, chunk, is_final);
+            }
+
+            /// Send the chunks batched for stream_id right away instead of waiting out the linger time
+            dp::Res<void> flush(dp::u32 stream_id) { return flush_stream(stream_id); }
+
+            /// Take the next queued chunk of a bidirectional stream opened without a callback
+            /// Returns not_found once the peer ended the stream and every chunk has been taken
+            dp::Res<Message> recv_chunk(dp::u32 stream_id, dp::u32 timeout_ms = 5000) {
+                auto stream_state = find_stream(stream_id);
+                if (!stream_state) {
+                    return dp::result::err(dp::Error::not_found("unknown stream"));
+                }
+
+                std::unique_lock<std::mutex> lock(stream_state->mutex);
+                auto ready = [&] { return !stream_state->chunks.empty() || stream_state->completed; };
+                if (!stream_state->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+                    return dp::result::err(dp::Error::timeout("stream recv timeout"));
+                }
+                if (stream_state->chunks.empty()) {
+                    if (stream_state->error) {
+                        return dp::result::err(dp::Error::io_error(stream_state->error_message.c_str()));
+                    }
+                    return dp::result::err(dp::Error::not_found("end of stream"));
                 }
 
-                Message msg = encode_remote_message_v2(stream_id, 0, chunk, MessageType::StreamData, flags);
-                return stream_.send(msg);
+                Message chunk = std::move(stream_state->chunks.front());
+                stream_state->chunks.pop();
+                auto grant = consume(*stream_state, chunk.size());
+                lock.unlock();
+                send_credit(stream_id, grant);
+                return dp::result::ok(std::move(chunk));
             }
 
             /// End a bidirectional stream
             dp::Res<void> end_stream(dp::u32 stream_id) {
-                Message msg = encode_remote_message_v2(stream_id, 0, Message(), MessageType::StreamEnd);
-                auto send_res = stream_.send(msg);
+                auto send_res = flush_stream(stream_id);
+                if (send_res.is_ok()) {
+                    send_res = send_frame(stream_id, 0, Message(), MessageType::StreamEnd);
+                }
 
                 // Remove from active streams
                 {
@@ -311,9 +831,30 @@ namespace netpipe {
             }
         };
 
+        /// RPC and streams over one connection: a Remote<Bidirect> with a StreamingRemote attached to it
+        /// One socket, one receiver thread; members are declared so the streams detach before RPC stops.
+        class Session {
+          public:
+            explicit Session(Stream &stream, StreamWindow window = {}) : rpc_(stream), streams_(rpc_, window) {}
+
+            Session(const Session &) = delete;
+            Session &operator=(const Session &) = delete;
+
+            Remote<Bidirect> &rpc() { return rpc_; }
+            StreamingRemote &streams() { return streams_; }
+
+          private:
+            Remote<Bidirect> rpc_;
+            StreamingRemote streams_;
+        };
+
     } // namespace remote
 
     using StreamingRemote = remote::StreamingRemote;
     using StreamCallback = remote::StreamCallback;
+    using ChunkProducer = remote::ChunkProducer;
+    using StreamWindow = remote::StreamWindow;
+    using ChunkBatching = remote::ChunkBatching;
+    using Session = remote::Session;
 
 } // namespace netpipe
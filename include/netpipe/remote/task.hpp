@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Eagerly started coroutine producing one T (e.g. the result of Remote::call_async)
+        /// The body runs on the calling thread until its first suspension; whoever completes the awaited
+        /// operation then resumes it. Consume it with co_await (from another coroutine) or get() (blocking).
+        /// Destroying an unfinished Task detaches it - the coroutine still runs to completion and frees itself.
+        template <typename T> class Task {
+          public:
+            struct promise_type {
+                // 0 = running, 1 = finished, 2 = detached, anything else = address of the awaiting coroutine
+                std::atomic<std::uintptr_t> state{0};
+                std::optional<T> value;
+
+                static constexpr std::uintptr_t RUNNING = 0;
+                static constexpr std::uintptr_t FINISHED = 1;
+                static constexpr std::uintptr_t DETACHED = 2;
+
+                Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+
+                struct FinalAwaiter {
+                    bool await_ready() noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                        promise_type &promise = h.promise();
+                        std::uintptr_t previous = promise.state.exchange(FINISHED, std::memory_order_acq_rel);
+                        promise.state.notify_all();
+                        if (previous == DETACHED) {
+                            h.destroy(); // Nobody holds the Task any more
+                            return std::noop_coroutine();
+                        }
+                        if (previous != RUNNING) {
+                            return std::coroutine_handle<>::from_address(reinterpret_cast<void *>(previous));
+                        }
+                        return std::noop_coroutine();
+                    }
+
+                    void await_resume() noexcept {}
+                };
+
+                FinalAwaiter final_suspend() noexcept { return {}; }
+
+                template <typename U> void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+
+                void unhandled_exception() noexcept { std::terminate(); }
+            };
+
+            Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+            Task &operator=(Task &&other) noexcept {
+                if (this != &other) {
+                    release();
+                    handle_ = std::exchange(other.handle_, nullptr);
+                }
+                return *this;
+            }
+
+            Task(const Task &) = delete;
+            Task &operator=(const Task &) = delete;
+
+            ~Task() { release(); }
+
+            /// Whether the result is available
+            bool is_ready() const {
+                return handle_ && handle_.promise().state.load(std::memory_order_acquire) == promise_type::FINISHED;
+            }
+
+            /// Block the calling thread until the coroutine finishes, then take its result
+            T get() {
+                auto &state = handle_.promise().state;
+                std::uintptr_t current = state.load(std::memory_order_acquire);
+                while (current != promise_type::FINISHED) {
+                    state.wait(current, std::memory_order_acquire);
+                    current = state.load(std::memory_order_acquire);
+                }
+                return std::move(*handle_.promise().value);
+            }
+
+            // Awaiting a Task suspends until it finishes; a finished Task continues immediately
+            bool await_ready() const { return is_ready(); }
+
+            bool await_suspend(std::coroutine_handle<> awaiting) {
+                std::uintptr_t expected = promise_type::RUNNING;
+                return handle_.promise().state.compare_exchange_strong(
+                    expected, reinterpret_cast<std::uintptr_t>(awaiting.address()), std::memory_order_acq_rel);
+            }
+
+            T await_resume() { return std::move(*handle_.promise().value); }
+
+          private:
+            explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+            void release() {
+                if (!handle_) {
+                    return;
+                }
+                std::uintptr_t expected = promise_type::RUNNING;
+                if (!handle_.promise().state.compare_exchange_strong(expected, promise_type::DETACHED,
+                                                                     std::memory_order_acq_rel)) {
+                    handle_.destroy(); // Finished - the frame waits at final_suspend for us
+                }
+                handle_ = nullptr;
+            }
+
+            std::coroutine_handle<promise_type> handle_;
+        };
+
+    } // namespace remote
+} // namespace netpipe
@@ -20,6 +20,13 @@ namespace netpipe {
         /// Features: Version field, message types, flags, method routing, streaming
         constexpr dp::u8 PROTOCOL_VERSION_2 = 2;
 
+        /// Version 3: Compact profile of V2 for constrained links (LoRa, serial tunnels)
+        /// Format: [marker:1][flags:varint]?[request_id:varint][method_id:varint]?[payload:N]
+        /// Total header: 2-14 bytes, usually 3; version implied, length taken from the message boundary
+        /// Features: Same fields as V2, optional id delta compression; only sent after the peer's hello
+        ///           announced this version (see remote/compact.hpp), so V2-only peers never see it
+        constexpr dp::u8 PROTOCOL_VERSION_COMPACT = 3;
+
         /// Current protocol version (what we use by default)
         constexpr dp::u8 PROTOCOL_VERSION_CURRENT = PROTOCOL_VERSION_2;
 
@@ -44,7 +51,8 @@ namespace netpipe {
 
         /// Check if a protocol version is supported
         inline bool is_protocol_supported(dp::u8 version) {
-            return version == PROTOCOL_VERSION_1 || version == PROTOCOL_VERSION_2;
+            return version == PROTOCOL_VERSION_1 || version == PROTOCOL_VERSION_2 ||
+                   version == PROTOCOL_VERSION_COMPACT;
         }
 
         /// Get protocol version name
@@ -54,6 +62,8 @@ namespace netpipe {
                 return "V1 (Basic)";
             case PROTOCOL_VERSION_2:
                 return "V2 (Streaming)";
+            case PROTOCOL_VERSION_COMPACT:
+                return "V3 (Compact)";
             default:
                 return "Unknown";
             }
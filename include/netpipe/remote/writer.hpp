@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <netpipe/remote/common.hpp>
+#include <netpipe/remote/protocol.hpp>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace netpipe {
+    namespace remote {
+
+        /// Writer for a connection shared by many sending threads (flat combining)
+        /// A sender queues its frame on a lock-free list. Whichever sender finds no writer active becomes the
+        /// writer: it takes every frame queued so far and puts them on the wire with one send_batch, highest
+        /// priority class first, while the other senders sleep until their frame is out. N concurrent sends cost
+        /// one acquisition of the connection's FairMutex and one writev instead of N of each; a lone sender
+        /// writes its own frame straight away. Payloads are not copied - every sender waits for its result, so
+        /// its buffer outlives the write.
+        class FrameWriter {
+          public:
+            /// Frames per send_batch; writev_frames splits further to stay under IOV_MAX
+            static constexpr dp::usize MAX_BATCH = 64;
+            /// Batches one writer puts out before handing the role to a waiting sender
+            static constexpr dp::usize MAX_ROUNDS = 8;
+
+            /// mutex is the connection's lock, still taken by senders that bypass the writer (fragmented sends)
+            FrameWriter(Stream &stream, FairMutex &mutex) : stream_(stream), mutex_(mutex) {}
+
+            FrameWriter(const FrameWriter &) = delete;
+            FrameWriter &operator=(const FrameWriter &) = delete;
+
+            /// Write one V2 frame, alone or coalesced with frames of other threads
+            /// Returns once the frame is on the wire (or the batch carrying it failed); data is only read until then
+            dp::Res<void> write(dp::u32 request_id, dp::u32 method_id, const dp::u8 *data, dp::usize length,
+                                MessageType type, dp::u16 flags = MessageFlags::None, dp::u32 deadline_ms = 0) {
+                Frame frame;
+                dp::usize trailer = deadline_ms != 0 ? DEADLINE_TRAILER_SIZE : 0;
+                if (trailer) {
+                    flags |= MessageFlags::Deadline;
+                    frame.trailer = encode_u32_be(deadline_ms);
+                }
+                frame.header = encode_remote_header_v2(request_id, method_id, static_cast<dp::u32>(length + trailer),
+                                                       type, flags);
+                frame.trailer_length = trailer;
+                frame.data = data;
+                frame.length = length;
+                frame.priority = flags_priority(flags, Priority::Normal);
+                frame.request_id = request_id;
+                frame.method_id = method_id;
+                frame.queued_ns = NETPIPE_TRACE_NOW();
+
+                Frame *head = head_.load(std::memory_order_relaxed);
+                do {
+                    frame.next = head;
+                } while (!head_.compare_exchange_weak(head, &frame, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+
+                while (!frame.done.load(std::memory_order_acquire)) {
+                    bool idle = !writing_.load(std::memory_order_relaxed);
+                    if (idle && !writing_.exchange(true, std::memory_order_acquire)) {
+                        combine();
+                        continue;
+                    }
+                    // Woken when our frame is out, or when the writer left with frames still queued
+                    std::unique_lock<std::mutex> lock(done_mutex_);
+                    done_.wait(lock, [&] {
+                        return frame.done.load(std::memory_order_acquire) || !writing_.load(std::memory_order_relaxed);
+                    });
+                }
+                return frame.result;
+            }
+
+            /// Frames written so far
+            dp::u64 frames_written() const { return frames_written_.load(std::memory_order_relaxed); }
+
+            /// send_batch calls so far; frames_written() / batches_written() is the coalescing factor
+            dp::u64 batches_written() const { return batches_written_.load(std::memory_order_relaxed); }
+
+          private:
+            // Lives on the sender's stack until done is set; the writer never touches it after that
+            struct Frame {
+                Frame *next = nullptr;
+                dp::Array<dp::u8, V2_HEADER_SIZE> header;
+                dp::Array<dp::u8, DEADLINE_TRAILER_SIZE> trailer;
+                dp::usize trailer_length = 0;
+                const dp::u8 *data = nullptr;
+                dp::usize length = 0;
+                Priority priority = Priority::Normal;
+                dp::u32 request_id = 0;
+                dp::u32 method_id = 0;
+                dp::u64 queued_ns = 0;
+                std::atomic<bool> done{false};
+                dp::Res<void> result = dp::result::ok();
+            };
+
+            // Called with writing_ set; clears it on the way out
+            void combine() {
+                for (dp::usize round = 0; round < MAX_ROUNDS; round++) {
+                    Frame *list = head_.exchange(nullptr, std::memory_order_acquire);
+                    if (!list) {
+                        break;
+                    }
+                    write_list(list);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex_);
+                    writing_.store(false, std::memory_order_relaxed);
+                }
+                done_.notify_all();
+            }
+
+            void write_list(Frame *list) {
+                // The list is newest first; restore arrival order, then let higher classes go ahead
+                batch_.clear();
+                for (Frame *frame = list; frame; frame = frame->next) {
+                    batch_.push_back(frame);
+                }
+                std::reverse(batch_.begin(), batch_.end());
+                std::stable_sort(batch_.begin(), batch_.end(),
+                                 [](const Frame *a, const Frame *b) { return a->priority > b->priority; });
+
+                for (dp::usize begin = 0; begin < batch_.size(); begin += MAX_BATCH) {
+                    dp::usize end = std::min(batch_.size(), begin + MAX_BATCH);
+                    write_batch(begin, end);
+                }
+            }
+
+            void write_batch(dp::usize begin, dp::usize end) {
+                dp::usize count = end - begin;
+                parts_.resize(count * 3);
+                frames_.resize(count);
+                for (dp::usize i = 0; i < count; i++) {
+                    Frame &frame = *batch_[begin + i];
+                    iovec *parts = parts_.data() + i * 3;
+                    dp::usize n = 0;
+                    parts[n++] = {frame.header.data(), V2_HEADER_SIZE};
+                    if (frame.length > 0) {
+                        parts[n++] = {const_cast<dp::u8 *>(frame.data), frame.length};
+                    }
+                    if (frame.trailer_length > 0) {
+                        parts[n++] = {frame.trailer.data(), frame.trailer_length};
+                    }
+                    frames_[i] = std::span<const iovec>(parts, n);
+                    NETPIPE_TRACE(QueueWait, frame.request_id, frame.method_id, NETPIPE_TRACE_NOW() - frame.queued_ns);
+                    NETPIPE_TRACE(SendBegin, frame.request_id, frame.method_id, frame.length);
+                }
+
+                dp::Res<void> res = dp::result::ok();
+                {
+                    mutex_.lock(batch_[begin]->priority); // Sorted, so the first frame has the highest class
+                    res = count == 1 ? stream_.send_iov(frames_[0]) : stream_.send_batch(frames_);
+                    mutex_.unlock();
+                }
+                frames_written_.fetch_add(count, std::memory_order_relaxed);
+                batches_written_.fetch_add(1, std::memory_order_relaxed);
+
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex_);
+                    for (dp::usize i = begin; i < end; i++) {
+                        Frame &frame = *batch_[i];
+                        NETPIPE_TRACE(SendEnd, frame.request_id, frame.method_id, frame.length);
+                        frame.result = res;
+                        frame.done.store(true, std::memory_order_release);
+                    }
+                }
+                done_.notify_all();
+            }
+
+            Stream &stream_;
+            FairMutex &mutex_;
+
+            std::atomic<Frame *> head_{nullptr}; // Frames waiting for a writer, newest first
+            std::atomic<bool> writing_{false};   // Some sender is the writer
+
+            std::mutex done_mutex_;
+            std::condition_variable done_;
+
+            // Writer-only scratch, reused across batches
+            std::vector<Frame *> batch_;
+            std::vector<iovec> parts_;
+            std::vector<std::span<const iovec>> frames_;
+
+            std::atomic<dp::u64> frames_written_{0};
+            std::atomic<dp::u64> batches_written_{0};
+        };
+
+    } // namespace remote
+} // namespace netpipe
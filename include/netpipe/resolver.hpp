@@ -0,0 +1,206 @@
+#pragma once
+
+#include <netpipe/common.hpp>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unordered_map>
+
+namespace netpipe {
+
+    // One address a host name resolved to, ready for connect/sendto
+    struct ResolvedAddress {
+        struct sockaddr_storage addr = {};
+        socklen_t length = 0;
+
+        inline dp::i32 family() const { return addr.ss_family; }
+
+        inline const struct sockaddr *sockaddr_ptr() const { return reinterpret_cast<const struct sockaddr *>(&addr); }
+
+        inline dp::String to_string() const {
+            char ip[INET6_ADDRSTRLEN] = {};
+            dp::u16 port = 0;
+            if (addr.ss_family == AF_INET6) {
+                const auto *in6 = reinterpret_cast<const struct sockaddr_in6 *>(&addr);
+                ::inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+                port = ntohs(in6->sin6_port);
+                return dp::String("[") + ip + "]:" + dp::String(std::to_string(port).c_str());
+            }
+            const auto *in4 = reinterpret_cast<const struct sockaddr_in *>(&addr);
+            ::inet_ntop(AF_INET, &in4->sin_addr, ip, sizeof(ip));
+            port = ntohs(in4->sin_port);
+            return dp::String(ip) + ":" + dp::String(std::to_string(port).c_str());
+        }
+    };
+
+    // getaddrinfo behind a process-wide cache, so dialing hundreds of peers does not mean hundreds of lookups
+    // getaddrinfo does not report record TTLs, so answers live for a fixed ttl and failures for a shorter
+    // negative ttl (a dead name is not queried on every retry). Numeric addresses never reach getaddrinfo.
+    // Lookups for different names run concurrently; the lock is not held during getaddrinfo.
+    class Resolver {
+      public:
+        static constexpr dp::u32 DEFAULT_TTL_MS = 30000;
+        static constexpr dp::u32 DEFAULT_NEGATIVE_TTL_MS = 1000;
+        static constexpr dp::usize MAX_ENTRIES = 4096;
+
+        // Shared by TcpStream and UdpDatagram
+        static Resolver &instance() {
+            static Resolver resolver;
+            return resolver;
+        }
+
+        // Addresses of host, in getaddrinfo's preference order, with port filled in
+        // @param family AF_UNSPEC for IPv4 and IPv6, or AF_INET / AF_INET6 to restrict
+        dp::Res<dp::Vector<ResolvedAddress>> resolve(const dp::String &host, dp::u16 port, dp::i32 family = AF_UNSPEC,
+                                                     dp::i32 socktype = SOCK_STREAM) {
+            auto numeric = parse_numeric(host, port, family);
+            if (numeric.is_ok()) {
+                dp::Vector<ResolvedAddress> addresses;
+                addresses.push_back(numeric.value());
+                return dp::result::ok(std::move(addresses));
+            }
+
+            std::string key = std::string(host.c_str()) + '|' + std::to_string(family) + '|' + std::to_string(socktype);
+            auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = cache_.find(key);
+                if (it != cache_.end() && it->second.expires > now) {
+                    hits_++;
+                    if (it->second.failed) {
+                        return dp::result::err(dp::Error::io_error("getaddrinfo failed (cached)"));
+                    }
+                    return dp::result::ok(with_port(it->second.addresses, port));
+                }
+            }
+
+            struct addrinfo hints = {};
+            hints.ai_family = family;
+            hints.ai_socktype = socktype;
+            struct addrinfo *result = nullptr;
+            dp::i32 ret = ::getaddrinfo(host.c_str(), nullptr, &hints, &result);
+
+            Entry entry;
+            entry.failed = ret != 0;
+            if (ret == 0) {
+                for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+                    if (ai->ai_addrlen > sizeof(sockaddr_storage)) {
+                        continue;
+                    }
+                    ResolvedAddress address;
+                    std::memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+                    address.length = ai->ai_addrlen;
+                    entry.addresses.push_back(address);
+                }
+                ::freeaddrinfo(result);
+                entry.failed = entry.addresses.empty();
+            } else {
+                echo::error("getaddrinfo failed for ", host.c_str(), ": ", gai_strerror(ret));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                lookups_++;
+                entry.expires = now + std::chrono::milliseconds(entry.failed ? negative_ttl_ms_ : ttl_ms_);
+                if (cache_.size() >= MAX_ENTRIES) {
+                    evict_expired(now);
+                }
+                if (cache_.size() < MAX_ENTRIES) {
+                    cache_[key] = entry;
+                }
+            }
+
+            if (entry.failed) {
+                return dp::result::err(dp::Error::io_error("getaddrinfo failed"));
+            }
+            return dp::result::ok(with_port(std::move(entry.addresses), port));
+        }
+
+        // An IPv4 or IPv6 literal as an address, without a lookup; invalid_argument for anything else
+        static dp::Res<ResolvedAddress> parse_numeric(const dp::String &host, dp::u16 port,
+                                                      dp::i32 family = AF_UNSPEC) {
+            ResolvedAddress address;
+            if (family != AF_INET6) {
+                auto *in4 = reinterpret_cast<struct sockaddr_in *>(&address.addr);
+                if (::inet_pton(AF_INET, host.c_str(), &in4->sin_addr) == 1) {
+                    in4->sin_family = AF_INET;
+                    in4->sin_port = htons(port);
+                    address.length = sizeof(struct sockaddr_in);
+                    return dp::result::ok(address);
+                }
+            }
+            if (family != AF_INET) {
+                auto *in6 = reinterpret_cast<struct sockaddr_in6 *>(&address.addr);
+                if (::inet_pton(AF_INET6, host.c_str(), &in6->sin6_addr) == 1) {
+                    in6->sin6_family = AF_INET6;
+                    in6->sin6_port = htons(port);
+                    address.length = sizeof(struct sockaddr_in6);
+                    return dp::result::ok(address);
+                }
+            }
+            return dp::result::err(dp::Error::invalid_argument("not a numeric address"));
+        }
+
+        // How long answers (and failures) stay cached; entries already cached keep their expiry
+        void set_ttl(dp::u32 ttl_ms, dp::u32 negative_ttl_ms = DEFAULT_NEGATIVE_TTL_MS) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ttl_ms_ = ttl_ms;
+            negative_ttl_ms_ = negative_ttl_ms;
+        }
+
+        // Forget every cached answer, e.g. after a failover changed DNS
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cache_.clear();
+        }
+
+        // getaddrinfo calls made so far
+        dp::u64 lookups() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return lookups_;
+        }
+
+        // resolve() calls answered from the cache
+        dp::u64 hits() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return hits_;
+        }
+
+      private:
+        struct Entry {
+            dp::Vector<ResolvedAddress> addresses;
+            bool failed = false;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, Entry> cache_;
+        dp::u32 ttl_ms_ = DEFAULT_TTL_MS;
+        dp::u32 negative_ttl_ms_ = DEFAULT_NEGATIVE_TTL_MS;
+        dp::u64 lookups_ = 0;
+        dp::u64 hits_ = 0;
+
+        static dp::Vector<ResolvedAddress> with_port(dp::Vector<ResolvedAddress> addresses, dp::u16 port) {
+            for (auto &address : addresses) {
+                if (address.family() == AF_INET6) {
+                    reinterpret_cast<struct sockaddr_in6 *>(&address.addr)->sin6_port = htons(port);
+                } else {
+                    reinterpret_cast<struct sockaddr_in *>(&address.addr)->sin_port = htons(port);
+                }
+            }
+            return addresses;
+        }
+
+        void evict_expired(std::chrono::steady_clock::time_point now) {
+            for (auto it = cache_.begin(); it != cache_.end();) {
+                it = it->second.expires <= now ? cache_.erase(it) : std::next(it);
+            }
+        }
+    };
+
+} // namespace netpipe
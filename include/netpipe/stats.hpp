@@ -0,0 +1,207 @@
+#pragma once
+
+#include <datapod/datapod.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace netpipe {
+
+    // Counters of one transport, as returned by Stream::stats() / Datagram::stats() and StatsRegistry::snapshot()
+    struct TransportStats {
+        dp::u64 messages_sent = 0;
+        dp::u64 bytes_sent = 0; // Message bytes, without framing
+        dp::u64 messages_received = 0;
+        dp::u64 bytes_received = 0;
+        dp::u64 send_syscalls = 0;  // write/writev/sendmsg/sendto calls, failed ones included (SHM makes none)
+        dp::u64 recv_syscalls = 0;  // read/recvmsg/recvfrom calls
+        dp::u64 partial_writes = 0; // Writes the kernel took only part of, so another call had to follow
+        dp::u64 partial_reads = 0;  // Reads that returned before the message they were waiting for was complete
+        dp::u64 waits = 0;          // SHM: times a send or receive had to wait for ring space or data
+        dp::u64 wait_ns = 0;        // SHM: time spent in those waits (spinning, yielding and futex sleeps)
+
+        // TCP_INFO of the socket when the snapshot was taken; has_tcp_info is false for other transports
+        bool has_tcp_info = false;
+        dp::u32 rtt_us = 0;
+        dp::u32 rtt_var_us = 0;
+        dp::u32 snd_cwnd = 0;    // Segments
+        dp::u32 unacked = 0;     // Segments in flight
+        dp::u32 lost = 0;        // Segments currently considered lost
+        dp::u32 retransmits = 0; // Segments retransmitted over the connection's lifetime
+    };
+
+    // Live counters behind one stream or datagram socket
+    // Updated with relaxed atomics from whichever threads send and receive; a snapshot is not a consistent cut
+    // across fields, only each field on its own. Streams own theirs through a shared_ptr and StatsRegistry keeps
+    // a weak one, so a closed and destroyed stream drops out of the registry by itself.
+    class TransportCounters {
+      public:
+        TransportCounters(dp::u64 id, dp::String label) : id_(id), label_(std::move(label)) {}
+
+        void on_send(dp::u64 bytes) {
+            messages_sent_.fetch_add(1, std::memory_order_relaxed);
+            bytes_sent_.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void on_recv(dp::u64 bytes) {
+            messages_received_.fetch_add(1, std::memory_order_relaxed);
+            bytes_received_.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        // Several messages sent or received together (one batch)
+        void on_send_batch(dp::u64 messages, dp::u64 bytes) {
+            messages_sent_.fetch_add(messages, std::memory_order_relaxed);
+            bytes_sent_.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void on_recv_batch(dp::u64 messages, dp::u64 bytes) {
+            messages_received_.fetch_add(messages, std::memory_order_relaxed);
+            bytes_received_.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void on_send_call(bool partial = false) {
+            send_syscalls_.fetch_add(1, std::memory_order_relaxed);
+            if (partial) {
+                partial_writes_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void on_recv_call(bool partial = false) {
+            recv_syscalls_.fetch_add(1, std::memory_order_relaxed);
+            if (partial) {
+                partial_reads_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void on_wait(dp::u64 ns) {
+            waits_.fetch_add(1, std::memory_order_relaxed);
+            wait_ns_.fetch_add(ns, std::memory_order_relaxed);
+        }
+
+        // Socket whose TCP_INFO snapshot() reports; -1 once it is closed (set before the fd is closed)
+        void set_socket(dp::i32 fd) {
+            std::lock_guard<std::mutex> lock(socket_mutex_);
+            socket_fd_ = fd;
+        }
+
+        TransportStats snapshot() const {
+            TransportStats stats;
+            stats.messages_sent = messages_sent_.load(std::memory_order_relaxed);
+            stats.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+            stats.messages_received = messages_received_.load(std::memory_order_relaxed);
+            stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+            stats.send_syscalls = send_syscalls_.load(std::memory_order_relaxed);
+            stats.recv_syscalls = recv_syscalls_.load(std::memory_order_relaxed);
+            stats.partial_writes = partial_writes_.load(std::memory_order_relaxed);
+            stats.partial_reads = partial_reads_.load(std::memory_order_relaxed);
+            stats.waits = waits_.load(std::memory_order_relaxed);
+            stats.wait_ns = wait_ns_.load(std::memory_order_relaxed);
+
+            // Under the lock, so close() cannot hand the fd number to another socket in between
+            std::lock_guard<std::mutex> lock(socket_mutex_);
+            struct tcp_info info = {};
+            socklen_t length = sizeof(info);
+            if (socket_fd_ >= 0 && ::getsockopt(socket_fd_, IPPROTO_TCP, TCP_INFO, &info, &length) == 0) {
+                stats.has_tcp_info = true;
+                stats.rtt_us = info.tcpi_rtt;
+                stats.rtt_var_us = info.tcpi_rttvar;
+                stats.snd_cwnd = info.tcpi_snd_cwnd;
+                stats.unacked = info.tcpi_unacked;
+                stats.lost = info.tcpi_lost;
+                stats.retransmits = info.tcpi_total_retrans;
+            }
+            return stats;
+        }
+
+        dp::u64 id() const { return id_; }
+        const dp::String &label() const { return label_; }
+
+      private:
+        const dp::u64 id_;
+        const dp::String label_;
+
+        std::atomic<dp::u64> messages_sent_{0};
+        std::atomic<dp::u64> bytes_sent_{0};
+        std::atomic<dp::u64> messages_received_{0};
+        std::atomic<dp::u64> bytes_received_{0};
+        std::atomic<dp::u64> send_syscalls_{0};
+        std::atomic<dp::u64> recv_syscalls_{0};
+        std::atomic<dp::u64> partial_writes_{0};
+        std::atomic<dp::u64> partial_reads_{0};
+        std::atomic<dp::u64> waits_{0};
+        std::atomic<dp::u64> wait_ns_{0};
+
+        mutable std::mutex socket_mutex_;
+        dp::i32 socket_fd_ = -1;
+    };
+
+    // One live connection in a StatsRegistry snapshot
+    struct ConnectionStats {
+        dp::u64 id;       // Unique per registration, in creation order
+        dp::String label; // Given to enable_stats() (accepted streams: the listener's)
+        TransportStats stats;
+    };
+
+    // Every stream and datagram socket with stats enabled, for capacity planning below the RPC layer
+    // Registration takes a lock once per connection; counting never touches the registry.
+    class StatsRegistry {
+      public:
+        static StatsRegistry &global() {
+            static StatsRegistry registry;
+            return registry;
+        }
+
+        // Counters for a new connection, listed until the last owner lets go of them
+        std::shared_ptr<TransportCounters> open(const dp::String &label) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto counters = std::make_shared<TransportCounters>(next_id_++, label);
+            prune();
+            entries_.push_back(counters);
+            return counters;
+        }
+
+        // Live connections, oldest first
+        std::vector<ConnectionStats> snapshot() {
+            std::vector<std::shared_ptr<TransportCounters>> live;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                prune();
+                for (const auto &entry : entries_) {
+                    if (auto counters = entry.lock()) {
+                        live.push_back(std::move(counters));
+                    }
+                }
+            }
+            std::vector<ConnectionStats> result;
+            result.reserve(live.size());
+            for (const auto &counters : live) {
+                result.push_back({counters->id(), counters->label(), counters->snapshot()});
+            }
+            return result;
+        }
+
+        // Live connections right now
+        dp::usize size() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            prune();
+            return entries_.size();
+        }
+
+      private:
+        // Drop entries whose connection is gone (mutex_ held)
+        void prune() {
+            std::erase_if(entries_, [](const std::weak_ptr<TransportCounters> &entry) { return entry.expired(); });
+        }
+
+        std::mutex mutex_;
+        std::vector<std::weak_ptr<TransportCounters>> entries_;
+        dp::u64 next_id_ = 1;
+    };
+
+} // namespace netpipe
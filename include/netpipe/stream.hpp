@@ -1,10 +1,22 @@
 #pragma once
 
+#include <cstring>
 #include <memory>
+#include <netpipe/budget.hpp>
 #include <netpipe/endpoint.hpp>
+#include <netpipe/stats.hpp>
+#include <span>
+#include <sys/uio.h>
 
 namespace netpipe {
 
+    // Upper bound on buffers an fd-backed stream frames in a single writev
+    // Longer lists go through the gathering Stream::send_iov default
+    constexpr dp::usize MAX_IOV_PARTS = 16;
+
+    // Length prefix in front of every message on the framed byte-stream transports (TCP, IPC)
+    constexpr dp::usize STREAM_PREFIX_SIZE = 4;
+
     // Abstract base class for all stream-oriented (connection-based) transports
     // Streams are reliable, ordered, connection-oriented byte pipes
     class Stream {
@@ -30,11 +42,108 @@ namespace netpipe {
         // Message is framed with length prefix internally
         virtual dp::Res<void> send(const Message &msg) = 0;
 
+        // Send the concatenation of several buffers as one message
+        // Lets callers frame a header and payload without copying them together first
+        // Default gathers into a single Message; fd-backed streams override it with writev
+        virtual dp::Res<void> send_iov(std::span<const iovec> parts) {
+            dp::usize total = 0;
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
+
+            Message msg(total);
+            dp::usize offset = 0;
+            for (const auto &part : parts) {
+                if (part.iov_len > 0) {
+                    std::memcpy(msg.data() + offset, part.iov_base, part.iov_len);
+                    offset += part.iov_len;
+                }
+            }
+            return send(msg);
+        }
+
+        // Send the message at buffer + STREAM_PREFIX_SIZE, length - STREAM_PREFIX_SIZE bytes long
+        // The first STREAM_PREFIX_SIZE bytes are headroom the stream may overwrite with its own framing, so
+        // prefix and message leave in one contiguous write; default ignores it and sends the message
+        virtual dp::Res<void> send_prefixed(dp::u8 *buffer, dp::usize length) {
+            if (length < STREAM_PREFIX_SIZE) {
+                return dp::result::err(dp::Error::invalid_argument("buffer has no prefix headroom"));
+            }
+            iovec part{buffer + STREAM_PREFIX_SIZE, length - STREAM_PREFIX_SIZE};
+            return send_iov(std::span<const iovec>(&part, 1));
+        }
+
+        // Send several messages back to back, each one framed from its own part list
+        // Lets pipelined callers put a whole batch on the wire at once instead of one write per message
+        // Default sends them one by one; fd-backed streams override it with batched writev
+        virtual dp::Res<void> send_batch(std::span<const std::span<const iovec>> frames) {
+            for (const auto &parts : frames) {
+                auto res = send_iov(parts);
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            return dp::result::ok();
+        }
+
         // Receive a message from the connection
         // Blocks until a complete message arrives
         // Returns the message payload (without framing)
         virtual dp::Res<Message> recv() = 0;
 
+        // Receive a message into a caller-owned buffer, reusing its capacity
+        // Steady-state traffic through one buffer needs no allocation per message
+        // Default moves the result of recv(); transports override it to fill msg in place
+        virtual dp::Res<void> recv_into(Message &msg) {
+            auto res = recv();
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            msg = std::move(res.value());
+            return dp::result::ok();
+        }
+
+        // Receive a message split in two: its first prefix_len bytes into prefix, the remainder into rest
+        // Returns the number of bytes written to prefix - less than prefix_len only for a shorter message
+        // Lets a protocol header and its payload arrive in separate buffers so the payload is never moved
+        // Default receives into a temporary and copies; transports override it to split while reading
+        virtual dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+
+            dp::usize head = msg.size() < prefix_len ? msg.size() : prefix_len;
+            if (head > 0) {
+                std::memcpy(prefix, msg.data(), head);
+            }
+            rest.assign(msg.begin() + head, msg.end());
+            return dp::result::ok(head);
+        }
+
+        // Count received messages against budget (MemoryBudget::global() by default; nullptr = not counted)
+        // Accepted streams inherit the listener's budget. Streams that cannot account for receives refuse.
+        virtual dp::Res<void> set_memory_budget(MemoryBudget *budget) {
+            (void)budget;
+            return dp::result::err(dp::Error::invalid_argument("stream does not support a memory budget"));
+        }
+
+        // Budget reservation of the message received last, for callers that hold it past the next recv
+        // Empty when the stream does not count receives or the lease was taken already
+        virtual BudgetLease take_lease() { return {}; }
+
+        // Budget receives are counted against; nullptr when the stream does not count them
+        virtual MemoryBudget *memory_budget() const { return nullptr; }
+
+        // Let frames that exempt() picks out through without reserving budget (nullptr = count every frame)
+        // Streams that do not count receives ignore it.
+        virtual void set_budget_exemption(BudgetExemption exempt) { (void)exempt; }
+
+        // Whether a recv would make progress without waiting (bytes buffered or readable on the fd)
+        // A hint for read-ahead: false is always safe, it only means the caller should not count on more input
+        virtual bool has_pending_input() const { return false; }
+
         // Set receive timeout in milliseconds
         // 0 means no timeout (blocking forever)
         // Returns error if timeout cannot be set
@@ -45,6 +154,51 @@ namespace netpipe {
 
         // Check if the connection is active
         virtual bool is_connected() const = 0;
+
+        // Underlying file descriptor for readiness polling (see Reactor), or -1 if there is none
+        // An fd handed to a reactor must not also be read through this Stream
+        virtual dp::i32 native_handle() const { return -1; }
+
+        // Count this stream's traffic and list it in StatsRegistry::global() under label (see TransportStats)
+        // Off by default; when off the transports pay one null check per call. Enable before the stream is used
+        // from several threads. Streams accepted from a listener with stats enabled start with their own.
+        void enable_stats(const dp::String &label = "") {
+            if (!counters_) {
+                counters_ = StatsRegistry::global().open(label);
+                counters_->set_socket(native_handle());
+                stats_attached(counters_.get());
+            }
+        }
+
+        bool stats_enabled() const { return counters_ != nullptr; }
+
+        // Current counters (all zero while stats are off)
+        TransportStats stats() const { return counters_ ? counters_->snapshot() : TransportStats{}; }
+
+        // Counters for code that moves this stream's bytes itself (e.g. RemoteServer reading its fd); null while
+        // stats are off
+        TransportCounters *stats_counters() const { return counters_.get(); }
+
+      protected:
+        // Null while stats are off
+        std::shared_ptr<TransportCounters> counters_;
+
+        // Hand the counters to internals that count on their own (e.g. a FrameReader); called once by enable_stats()
+        virtual void stats_attached(TransportCounters *counters) { (void)counters; }
+
+        // Give an accepted stream stats when this listener has them
+        void inherit_stats(Stream &accepted) const {
+            if (counters_) {
+                accepted.enable_stats(counters_->label());
+            }
+        }
+
+        // The socket went away (or was replaced): stop reading TCP_INFO from the old fd number
+        void stats_socket(dp::i32 fd) {
+            if (counters_) {
+                counters_->set_socket(fd);
+            }
+        }
     };
 
 } // namespace netpipe
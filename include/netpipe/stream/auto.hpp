@@ -0,0 +1,680 @@
+#pragma once
+
+#include <netpipe/stream/ipc.hpp>
+#include <netpipe/stream/shm.hpp>
+#include <netpipe/stream/tcp.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace netpipe {
+
+    // Local transport a negotiated connection can be upgraded to, in order of preference
+    enum class AutoTransport : dp::u8 {
+        Tcp = 0,
+        Shm = 1,
+        Ipc = 2,
+    };
+
+    // Which transports an auto listener serves, or an auto client is willing to use, besides TCP
+    struct AutoOptions {
+        bool shm = true;
+        bool ipc = true;
+        dp::usize shm_size = 1024 * 1024;    // Ring size per direction of an upgraded SHM connection
+        dp::u32 handshake_timeout_ms = 2000; // Hello/offer exchange and the switch to the chosen transport
+    };
+
+    // Negotiation messages, exchanged as ordinary messages over the TCP connection
+    // HELLO  C->S [magic:4][1][caps:1][id_len:1][host_id]
+    // OFFER  S->C [magic:4][2][offers:1][token:8][id_len:1][host_id][ipc_len:1][ipc_path][shm_len:1][shm_name]
+    // CHOICE C->S [magic:4][3][transport:1]            - sent before each attempt, and Tcp to give up
+    // TOKEN  C->S [magic:4][4][token:8]                - first message on the upgraded stream
+    // caps and offers are bit sets of 1 << AutoTransport. The server only offers local transports to a client
+    // whose host id (the kernel boot id) matches its own.
+    namespace auto_wire {
+        inline constexpr dp::u32 MAGIC = 0x4E504155; // "NPAU"
+        inline constexpr dp::u8 HELLO = 1;
+        inline constexpr dp::u8 OFFER = 2;
+        inline constexpr dp::u8 CHOICE = 3;
+        inline constexpr dp::u8 TOKEN = 4;
+
+        inline constexpr dp::u8 bit(AutoTransport transport) {
+            return static_cast<dp::u8>(1u << static_cast<dp::u8>(transport));
+        }
+
+        inline Message begin(dp::u8 kind) {
+            Message msg;
+            append_u32_be(msg, MAGIC);
+            msg.push_back(kind);
+            return msg;
+        }
+
+        inline void append_u64(Message &msg, dp::u64 value) {
+            append_u32_be(msg, static_cast<dp::u32>(value >> 32));
+            append_u32_be(msg, static_cast<dp::u32>(value));
+        }
+
+        // Strings are at most 255 bytes; longer ones do not fit and are sent empty
+        inline void append_string(Message &msg, const dp::String &value) {
+            dp::usize len = value.size() <= 255 ? value.size() : 0;
+            msg.push_back(static_cast<dp::u8>(len));
+            msg.insert(msg.end(), value.c_str(), value.c_str() + len);
+        }
+
+        // Bounds-checked cursor over a received message
+        struct Reader {
+            const Message &msg;
+            dp::usize pos = 0;
+            bool ok = true;
+
+            dp::u8 u8() {
+                if (pos + 1 > msg.size()) {
+                    ok = false;
+                    return 0;
+                }
+                return msg[pos++];
+            }
+
+            dp::u64 u64() {
+                if (pos + 8 > msg.size()) {
+                    ok = false;
+                    return 0;
+                }
+                dp::u64 value = (static_cast<dp::u64>(decode_u32_be(msg.data() + pos)) << 32) |
+                                decode_u32_be(msg.data() + pos + 4);
+                pos += 8;
+                return value;
+            }
+
+            dp::String string() {
+                dp::usize len = u8();
+                if (!ok || pos + len > msg.size()) {
+                    ok = false;
+                    return dp::String();
+                }
+                std::string value(reinterpret_cast<const char *>(msg.data() + pos), len);
+                pos += len;
+                return dp::String(value.c_str());
+            }
+        };
+
+        // Reader positioned after the header, or !ok when msg is not a negotiation message of this kind
+        inline Reader open(const Message &msg, dp::u8 kind) {
+            Reader reader{msg};
+            if (msg.size() < 5 || decode_u32_be(msg.data()) != MAGIC || msg[4] != kind) {
+                reader.ok = false;
+                return reader;
+            }
+            reader.pos = 5;
+            return reader;
+        }
+
+        // Kernel boot id: equal on both ends exactly when they run on the same machine (and the same boot)
+        // Containers on one host share it without necessarily sharing /dev/shm or /tmp, which is why a
+        // client still falls back when the offered transport turns out to be unreachable.
+        inline dp::String host_id() {
+            static const dp::String id = [] {
+                char buffer[64] = {};
+                FILE *file = std::fopen("/proc/sys/kernel/random/boot_id", "r");
+                if (!file) {
+                    return dp::String();
+                }
+                dp::usize len = std::fread(buffer, 1, sizeof(buffer) - 1, file);
+                std::fclose(file);
+                while (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == ' ')) {
+                    len--;
+                }
+                buffer[len] = '\0';
+                return dp::String(buffer);
+            }();
+            return id;
+        }
+    } // namespace auto_wire
+
+    // Parse auto://host:port/service (the scheme and the service are optional)
+    inline dp::Res<AutoEndpoint> parse_auto_uri(const dp::String &uri) {
+        std::string text(uri.c_str());
+        for (const char *scheme : {"auto://", "tcp://"}) {
+            if (text.rfind(scheme, 0) == 0) {
+                text = text.substr(std::string(scheme).size());
+                break;
+            }
+        }
+
+        std::string service;
+        auto slash = text.find('/');
+        if (slash != std::string::npos) {
+            service = text.substr(slash + 1);
+            text = text.substr(0, slash);
+        }
+
+        auto colon = text.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == text.size()) {
+            return dp::result::err(dp::Error::invalid_argument("expected auto://host:port[/service]"));
+        }
+        std::string host = text.substr(0, colon);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        std::string port_text = text.substr(colon + 1);
+        if (port_text.find_first_not_of("0123456789") != std::string::npos || port_text.size() > 5 ||
+            std::stoul(port_text) > 65535) {
+            return dp::result::err(dp::Error::invalid_argument("invalid port"));
+        }
+        if (service.empty()) {
+            service = port_text;
+        }
+        if (service.find_first_of("/ ") != std::string::npos || service.size() > 64) {
+            return dp::result::err(dp::Error::invalid_argument("invalid service name"));
+        }
+
+        AutoEndpoint endpoint;
+        endpoint.tcp = TcpEndpoint{dp::String(host.c_str()), static_cast<dp::u16>(std::stoul(port_text))};
+        endpoint.service = dp::String(service.c_str());
+        return dp::result::ok(endpoint);
+    }
+
+    // Listens on TCP, a Unix socket and a shared memory channel at once (see AutoEndpoint for the names)
+    // Every connection starts on TCP with the negotiation in auto_wire; a client on the same machine is then
+    // moved to shared memory, or to the Unix socket when the shared memory channel is unreachable, and the
+    // TCP connection is closed. accept() hands out whichever stream won, so callers only see a Stream.
+    // Clients must use connect_auto - a plain TcpStream client is not answered.
+    // Background threads accept on each listener and every negotiation runs on a worker of its own, so a client
+    // that goes quiet mid-handshake only holds up itself; accept() returns connections in the order they finish.
+    class AutoListener {
+      private:
+        // Upgraded stream waiting for the negotiation that owns its token
+        struct Parked {
+            dp::u64 token;
+            AutoTransport transport;
+            std::unique_ptr<Stream> stream;
+            std::chrono::steady_clock::time_point since;
+        };
+
+        struct Worker {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+
+        static constexpr dp::u32 POLL_SLICE_MS = 50;
+        static constexpr dp::usize MAX_PENDING = 64; // Negotiations plus negotiated connections not yet accepted
+
+        AutoEndpoint endpoint_;
+        AutoOptions options_;
+        TcpStream tcp_;
+        IpcStream ipc_;
+        ShmStream shm_;
+        bool ipc_listening_ = false;
+        bool shm_listening_ = false;
+        bool listening_ = false;
+        std::atomic<bool> closing_{false};
+        std::thread tcp_thread_;
+        std::thread ipc_thread_;
+        std::thread shm_thread_;
+
+        std::mutex mutex_; // Guards everything below
+        std::condition_variable cv_; // parked_, ready_, negotiating_ or failure_ changed
+        dp::Vector<Parked> parked_;
+        std::deque<std::unique_ptr<Stream>> ready_; // Negotiated, waiting for accept()
+        std::optional<dp::Error> failure_;          // The TCP listener failed
+        dp::Vector<Worker> workers_;
+        dp::usize negotiating_ = 0;
+        std::mt19937_64 token_rng_{std::random_device{}()};
+
+        static bool readable(dp::i32 fd, dp::u32 timeout_ms) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            return ::poll(&pfd, 1, static_cast<int>(timeout_ms)) > 0;
+        }
+
+        // Run fn on a worker thread of its own; finished workers are joined here and in close()
+        template <typename Fn> void spawn(Fn fn) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (dp::usize i = workers_.size(); i-- > 0;) {
+                if (workers_[i].done->load(std::memory_order_acquire)) {
+                    workers_[i].thread.join();
+                    workers_.erase(workers_.begin() + static_cast<dp::isize>(i));
+                }
+            }
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            workers_.push_back(Worker{std::thread([fn = std::move(fn), done]() mutable {
+                                          fn();
+                                          done->store(true, std::memory_order_release);
+                                      }),
+                                      done});
+        }
+
+        // Next message within the deadline, waited for in POLL_SLICE_MS slices so close() is not held up
+        dp::Res<Message> recv_within(Stream &stream, std::chrono::steady_clock::time_point deadline) {
+            stream.set_recv_timeout(POLL_SLICE_MS);
+            while (true) {
+                auto msg = stream.recv();
+                if (msg.is_ok() || msg.error().code != dp::Error::TIMEOUT) {
+                    stream.set_recv_timeout(0);
+                    return msg;
+                }
+                if (closing_.load(std::memory_order_acquire) || std::chrono::steady_clock::now() >= deadline) {
+                    stream.set_recv_timeout(0);
+                    return msg;
+                }
+            }
+        }
+
+        // Read the token an upgraded connection opens with and park it for its negotiation
+        void park_upgrade(AutoTransport transport, std::unique_ptr<Stream> stream) {
+            auto now = std::chrono::steady_clock::now();
+            auto first = recv_within(*stream, now + std::chrono::milliseconds(options_.handshake_timeout_ms));
+            Message empty;
+            auto reader = auto_wire::open(first.is_ok() ? first.value() : empty, auto_wire::TOKEN);
+            dp::u64 token = reader.u64();
+            if (!reader.ok) {
+                echo::warn("AutoListener: upgraded connection sent no token");
+                stream->close();
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Whoever parked these gave up long ago
+            auto stale = std::chrono::milliseconds(options_.handshake_timeout_ms * 2);
+            for (dp::usize i = parked_.size(); i-- > 0;) {
+                if (now - parked_[i].since > stale) {
+                    parked_[i].stream->close();
+                    parked_.erase(parked_.begin() + static_cast<dp::isize>(i));
+                }
+            }
+            parked_.push_back(Parked{token, transport, std::move(stream), now});
+            cv_.notify_all();
+        }
+
+        // Upgraded stream carrying token, or nullptr when it has not arrived within POLL_SLICE_MS
+        std::unique_ptr<Stream> take_upgrade(AutoTransport transport, dp::u64 token) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            std::unique_ptr<Stream> stream;
+            cv_.wait_for(lock, std::chrono::milliseconds(POLL_SLICE_MS), [&] {
+                for (dp::usize i = 0; i < parked_.size(); i++) {
+                    if (parked_[i].token == token && parked_[i].transport == transport) {
+                        stream = std::move(parked_[i].stream);
+                        parked_.erase(parked_.begin() + static_cast<dp::isize>(i));
+                        return true;
+                    }
+                }
+                return closing_.load(std::memory_order_acquire);
+            });
+            return stream;
+        }
+
+        void tcp_loop() {
+            while (!closing_.load(std::memory_order_acquire)) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if (!cv_.wait_for(lock, std::chrono::milliseconds(POLL_SLICE_MS), [&] {
+                            return negotiating_ + ready_.size() < MAX_PENDING || closing_.load();
+                        })) {
+                        continue;
+                    }
+                }
+                if (!readable(tcp_.native_handle(), POLL_SLICE_MS) || closing_.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                auto accepted = tcp_.accept();
+                if (accepted.is_err()) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    failure_ = accepted.error();
+                    cv_.notify_all();
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    negotiating_++;
+                }
+                auto shared = std::make_shared<std::unique_ptr<Stream>>(std::move(accepted.value()));
+                spawn([this, shared]() {
+                    auto stream = negotiate(std::move(*shared));
+                    if (stream.is_err()) {
+                        echo::warn("AutoListener: dropped client: ", stream.error().message.c_str());
+                    }
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    negotiating_--;
+                    if (stream.is_ok()) {
+                        ready_.push_back(std::move(stream.value()));
+                    }
+                    cv_.notify_all();
+                });
+            }
+        }
+
+        void upgrade_loop(AutoTransport transport) {
+            shm_.set_recv_timeout(POLL_SLICE_MS);
+            while (!closing_.load(std::memory_order_acquire)) {
+                dp::Res<std::unique_ptr<Stream>> accepted = dp::result::err(dp::Error::timeout("no connection"));
+                if (transport == AutoTransport::Shm) {
+                    accepted = shm_.accept();
+                } else if (readable(ipc_.native_handle(), POLL_SLICE_MS)) {
+                    accepted = ipc_.accept();
+                }
+                if (accepted.is_err()) {
+                    continue;
+                }
+                auto shared = std::make_shared<std::unique_ptr<Stream>>(std::move(accepted.value()));
+                spawn([this, transport, shared]() { park_upgrade(transport, std::move(*shared)); });
+            }
+        }
+
+        // Run the server side of the negotiation on a fresh TCP connection
+        dp::Res<std::unique_ptr<Stream>> negotiate(std::unique_ptr<Stream> tcp) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.handshake_timeout_ms);
+            auto hello = recv_within(*tcp, deadline);
+            if (hello.is_err()) {
+                return dp::result::err(dp::Error::timeout("no hello from client"));
+            }
+            auto reader = auto_wire::open(hello.value(), auto_wire::HELLO);
+            dp::u8 caps = reader.u8();
+            dp::String client_host = reader.string();
+            if (!reader.ok) {
+                return dp::result::err(dp::Error::invalid_argument("not an auto client"));
+            }
+
+            dp::String host = auto_wire::host_id();
+            dp::u8 offers = 0;
+            if (!host.empty() && client_host == host) {
+                if (shm_listening_) {
+                    offers |= auto_wire::bit(AutoTransport::Shm);
+                }
+                if (ipc_listening_) {
+                    offers |= auto_wire::bit(AutoTransport::Ipc);
+                }
+                offers &= caps;
+            }
+            dp::u64 token = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                token = token_rng_();
+            }
+
+            auto offer = auto_wire::begin(auto_wire::OFFER);
+            offer.push_back(offers);
+            auto_wire::append_u64(offer, token);
+            auto_wire::append_string(offer, host);
+            auto_wire::append_string(offer, endpoint_.ipc_path());
+            auto_wire::append_string(offer, endpoint_.shm_name());
+            if (tcp->send(offer).is_err()) {
+                return dp::result::err(dp::Error::io_error("failed to send offer"));
+            }
+            if (offers == 0) {
+                return dp::result::ok(std::move(tcp));
+            }
+
+            // Follow the client's choices until one transport is connected
+            // The client closes TCP as soon as its upgrade succeeds, so a closed TCP only stops the polling
+            AutoTransport choice = AutoTransport::Tcp;
+            bool have_choice = false;
+            bool tcp_open = true;
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.handshake_timeout_ms);
+            while (std::chrono::steady_clock::now() < deadline && !closing_.load(std::memory_order_acquire)) {
+                dp::u32 wait_ms = have_choice ? 0 : POLL_SLICE_MS;
+                if (tcp_open && (tcp->has_pending_input() || readable(tcp->native_handle(), wait_ms))) {
+                    auto msg = recv_within(*tcp, deadline);
+                    if (msg.is_err()) {
+                        if (msg.error().code == dp::Error::TIMEOUT) {
+                            break;
+                        }
+                        tcp_open = false;
+                        if (!have_choice) {
+                            break;
+                        }
+                    } else {
+                        auto choice_reader = auto_wire::open(msg.value(), auto_wire::CHOICE);
+                        dp::u8 value = choice_reader.u8();
+                        if (!choice_reader.ok || value > static_cast<dp::u8>(AutoTransport::Ipc) ||
+                            (value != 0 && !(offers & (1u << value)))) {
+                            return dp::result::err(dp::Error::invalid_argument("invalid transport choice"));
+                        }
+                        choice = static_cast<AutoTransport>(value);
+                        have_choice = true;
+                    }
+                }
+                if (!have_choice) {
+                    continue;
+                }
+                if (choice == AutoTransport::Tcp) {
+                    echo::debug("AutoListener: client stays on TCP");
+                    return dp::result::ok(std::move(tcp));
+                }
+                auto upgraded = take_upgrade(choice, token);
+                if (upgraded) {
+                    tcp->close();
+                    echo::debug("AutoListener: client moved to ", choice == AutoTransport::Shm ? "shm" : "ipc");
+                    return dp::result::ok(std::move(upgraded));
+                }
+            }
+            tcp->close();
+            return dp::result::err(dp::Error::timeout("transport negotiation timed out"));
+        }
+
+      public:
+        AutoListener() = default;
+
+        ~AutoListener() { close(); }
+
+        AutoListener(const AutoListener &) = delete;
+        AutoListener &operator=(const AutoListener &) = delete;
+
+        // Start all listeners; only TCP is required - a local transport that fails to come up is not offered
+        dp::Res<void> listen(const AutoEndpoint &endpoint, const AutoOptions &options = {}) {
+            endpoint_ = endpoint;
+            options_ = options;
+            auto res = tcp_.listen(endpoint.tcp);
+            if (res.is_err()) {
+                return res;
+            }
+            if (options.ipc) {
+                ipc_listening_ = ipc_.listen_ipc(IpcEndpoint{endpoint.ipc_path()}).is_ok();
+                if (!ipc_listening_) {
+                    echo::warn("AutoListener: IPC unavailable at ", endpoint.ipc_path());
+                }
+            }
+            if (options.shm) {
+                shm_listening_ = shm_.listen_shm(ShmEndpoint{endpoint.shm_name(), options.shm_size}).is_ok();
+                if (!shm_listening_) {
+                    echo::warn("AutoListener: shared memory unavailable for ", endpoint.shm_name());
+                }
+            }
+            listening_ = true;
+            closing_ = false;
+            tcp_thread_ = std::thread([this]() { tcp_loop(); });
+            if (ipc_listening_) {
+                ipc_thread_ = std::thread([this]() { upgrade_loop(AutoTransport::Ipc); });
+            }
+            if (shm_listening_) {
+                shm_thread_ = std::thread([this]() { upgrade_loop(AutoTransport::Shm); });
+            }
+            echo::info("AutoListener listening on ", endpoint.to_string(), ipc_listening_ ? " +ipc" : "",
+                       shm_listening_ ? " +shm" : "");
+            return dp::result::ok();
+        }
+
+        dp::Res<void> listen(const dp::String &uri, const AutoOptions &options = {}) {
+            auto endpoint = parse_auto_uri(uri);
+            if (endpoint.is_err()) {
+                return dp::result::err(endpoint.error());
+            }
+            return listen(endpoint.value(), options);
+        }
+
+        // Next negotiated connection; clients whose negotiation fails are dropped and the wait goes on
+        // Errors only when the TCP listener itself fails, or after close()
+        dp::Res<std::unique_ptr<Stream>> accept() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return !ready_.empty() || failure_ || closing_.load() || !listening_; });
+            if (!ready_.empty()) {
+                auto stream = std::move(ready_.front());
+                ready_.pop_front();
+                cv_.notify_all(); // Room for the TCP thread to take another client
+                return dp::result::ok(std::move(stream));
+            }
+            if (failure_) {
+                return dp::result::err(*failure_);
+            }
+            return dp::result::err(dp::Error::invalid_argument("not listening"));
+        }
+
+        void close() {
+            if (!listening_) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closing_ = true;
+                cv_.notify_all();
+            }
+            for (auto *thread : {&tcp_thread_, &ipc_thread_, &shm_thread_}) {
+                if (thread->joinable()) {
+                    thread->join();
+                }
+            }
+            dp::Vector<Worker> workers;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                workers = std::move(workers_); // No new ones once the accepting threads are gone
+            }
+            for (auto &worker : workers) {
+                worker.thread.join();
+            }
+
+            listening_ = false;
+            tcp_.close();
+            if (ipc_listening_) {
+                ipc_.close();
+                ipc_listening_ = false;
+            }
+            if (shm_listening_) {
+                shm_.close();
+                shm_listening_ = false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &entry : parked_) {
+                entry.stream->close();
+            }
+            parked_.clear();
+            for (auto &stream : ready_) {
+                stream->close();
+            }
+            ready_.clear();
+            cv_.notify_all();
+        }
+
+        bool is_listening() const { return listening_; }
+        bool ipc_available() const { return ipc_listening_; }
+        bool shm_available() const { return shm_listening_; }
+        const AutoEndpoint &endpoint() const { return endpoint_; }
+    };
+
+    // Listen on every transport of uri (auto://host:port/service)
+    inline dp::Res<std::unique_ptr<AutoListener>> listen_auto(const dp::String &uri, const AutoOptions &options = {}) {
+        auto listener = std::make_unique<AutoListener>();
+        auto res = listener->listen(uri, options);
+        if (res.is_err()) {
+            return dp::result::err(res.error());
+        }
+        return dp::result::ok(std::move(listener));
+    }
+
+    // Connect to an AutoListener and return the fastest stream both ends can reach
+    // Same machine: shared memory, else the Unix socket, else TCP. Remote peers stay on the TCP connection.
+    inline dp::Res<std::unique_ptr<Stream>> connect_auto(const dp::String &uri, const AutoOptions &options = {}) {
+        auto endpoint = parse_auto_uri(uri);
+        if (endpoint.is_err()) {
+            return dp::result::err(endpoint.error());
+        }
+
+        auto tcp = std::make_unique<TcpStream>();
+        auto res = tcp->connect(endpoint.value().tcp);
+        if (res.is_err()) {
+            return dp::result::err(res.error());
+        }
+        tcp->set_recv_timeout(options.handshake_timeout_ms);
+
+        dp::u8 caps = 0;
+        if (options.shm) {
+            caps |= auto_wire::bit(AutoTransport::Shm);
+        }
+        if (options.ipc) {
+            caps |= auto_wire::bit(AutoTransport::Ipc);
+        }
+        auto hello = auto_wire::begin(auto_wire::HELLO);
+        hello.push_back(caps);
+        auto_wire::append_string(hello, auto_wire::host_id());
+        if (tcp->send(hello).is_err()) {
+            return dp::result::err(dp::Error::io_error("failed to send hello"));
+        }
+
+        auto offer_msg = tcp->recv();
+        if (offer_msg.is_err()) {
+            tcp->close();
+            return dp::result::err(offer_msg.error());
+        }
+        auto reader = auto_wire::open(offer_msg.value(), auto_wire::OFFER);
+        dp::u8 offers = reader.u8();
+        dp::u64 token = reader.u64();
+        dp::String server_host = reader.string();
+        dp::String ipc_path = reader.string();
+        dp::String shm_name = reader.string();
+        if (!reader.ok) {
+            tcp->close();
+            return dp::result::err(dp::Error::invalid_argument("not an auto listener"));
+        }
+
+        auto choose = [&](AutoTransport transport) {
+            auto msg = auto_wire::begin(auto_wire::CHOICE);
+            msg.push_back(static_cast<dp::u8>(transport));
+            return tcp->send(msg);
+        };
+        auto token_msg = auto_wire::begin(auto_wire::TOKEN);
+        auto_wire::append_u64(token_msg, token);
+
+        for (auto transport : {AutoTransport::Shm, AutoTransport::Ipc}) {
+            if (!(offers & auto_wire::bit(transport))) {
+                continue;
+            }
+            if (choose(transport).is_err()) {
+                return dp::result::err(dp::Error::io_error("failed to send transport choice"));
+            }
+            std::unique_ptr<Stream> upgraded;
+            if (transport == AutoTransport::Shm) {
+                auto shm = std::make_unique<ShmStream>();
+                if (shm->connect_shm(ShmEndpoint{shm_name, options.shm_size}).is_ok()) {
+                    upgraded = std::move(shm);
+                }
+            } else {
+                auto ipc = std::make_unique<IpcStream>();
+                if (ipc->connect_ipc(IpcEndpoint{ipc_path}).is_ok()) {
+                    upgraded = std::move(ipc);
+                }
+            }
+            if (upgraded && upgraded->send(token_msg).is_ok()) {
+                tcp->close();
+                echo::info("connect_auto: ", endpoint.value().to_string(), " over ",
+                           transport == AutoTransport::Shm ? "shm" : "ipc");
+                return dp::result::ok(std::move(upgraded));
+            }
+            echo::warn("connect_auto: offered ", transport == AutoTransport::Shm ? "shm" : "ipc",
+                       " transport is unreachable, trying the next one");
+        }
+
+        if (offers != 0 && choose(AutoTransport::Tcp).is_err()) {
+            return dp::result::err(dp::Error::io_error("failed to send transport choice"));
+        }
+        tcp->set_recv_timeout(0);
+        echo::info("connect_auto: ", endpoint.value().to_string(), " over tcp");
+        return dp::result::ok(std::unique_ptr<Stream>(std::move(tcp)));
+    }
+
+} // namespace netpipe
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <netpipe/datagram.hpp>
+#include <netpipe/stream.hpp>
+
+namespace netpipe {
+
+    // Stream view of a bound Datagram talking to one peer - one message per datagram
+    // Lets Remote run over LoraDatagram or UdpDatagram where the link is too constrained for a real stream: no
+    // handshake, no length prefix, no retransmission. Messages may still be lost, duplicated or reordered and
+    // must fit the transport (LoraDatagram: MAX_LORA_SIZE), so pair it with call timeouts and small payloads.
+    // Datagrams from any other source are dropped.
+    class DatagramStream : public Stream {
+      private:
+        Datagram &datagram_;
+        UdpEndpoint peer_;
+        bool connected_;
+
+      public:
+        // datagram must already be bound and outlive this stream
+        explicit DatagramStream(Datagram &datagram) : datagram_(datagram), peer_{"", 0}, connected_(false) {}
+
+        DatagramStream(Datagram &datagram, const UdpEndpoint &peer)
+            : datagram_(datagram), peer_(peer), connected_(true) {}
+
+        // Choose the peer; endpoint.host must be a numeric address, as it is compared with datagram sources
+        // LoRa peers use port 0
+        dp::Res<void> connect(const TcpEndpoint &endpoint) override {
+            peer_ = UdpEndpoint{endpoint.host, endpoint.port};
+            connected_ = true;
+            echo::debug("DatagramStream peer ", peer_.to_string());
+            return dp::result::ok();
+        }
+
+        // Datagrams have no connections to accept: bind the datagram and connect() both sides instead
+        dp::Res<void> listen(const TcpEndpoint &endpoint) override {
+            (void)endpoint;
+            return dp::result::err(dp::Error::invalid_argument("DatagramStream cannot listen"));
+        }
+
+        dp::Res<std::unique_ptr<Stream>> accept() override {
+            return dp::result::err(dp::Error::invalid_argument("DatagramStream cannot accept"));
+        }
+
+        dp::Res<void> send(const Message &msg) override {
+            if (!connected_) {
+                return dp::result::err(dp::Error::invalid_argument("not connected"));
+            }
+            return datagram_.send_to(msg, peer_);
+        }
+
+        dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        dp::Res<void> recv_into(Message &msg) override {
+            if (!connected_) {
+                return dp::result::err(dp::Error::invalid_argument("not connected"));
+            }
+            while (true) {
+                auto res = datagram_.recv_from_into(msg);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                if (res.value().host == peer_.host && res.value().port == peer_.port) {
+                    return dp::result::ok();
+                }
+                echo::trace("DatagramStream dropped datagram from ", res.value().to_string());
+            }
+        }
+
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override { return datagram_.set_recv_timeout(timeout_ms); }
+
+        // Stops the stream only; the datagram stays bound and is closed by its owner
+        void close() override { connected_ = false; }
+
+        bool is_connected() const override { return connected_; }
+
+        const UdpEndpoint &peer() const { return peer_; }
+    };
+
+} // namespace netpipe
@@ -3,6 +3,7 @@
 #include <netpipe/remote/protocol.hpp>
 #include <netpipe/stream.hpp>
 
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -19,30 +20,112 @@ namespace netpipe {
         IpcEndpoint local_endpoint_;
         IpcEndpoint remote_endpoint_;
         bool should_unlink_; // Track if we should unlink the socket file on close
+        FrameReader reader_; // Buffered length-prefix parser for recv()
+        dp::usize fd_threshold_; // Payloads this large go out as a memfd (0 = never)
+
+        // recv_view() state: a mapped memfd, or a frame read into view_buffer_
+        bool view_active_;
+        const dp::u8 *view_map_;
+        dp::u64 view_map_length_;
+        Message view_buffer_;
 
         // Private constructor for accepted connections
         IpcStream(dp::i32 fd, const IpcEndpoint &local, const IpcEndpoint &remote)
             : fd_(fd), connected_(true), listening_(false), local_endpoint_(local), remote_endpoint_(remote),
-              should_unlink_(false) {
+              should_unlink_(false), fd_threshold_(0), view_active_(false), view_map_(nullptr), view_map_length_(0) {
+            reader_.set_descriptors(true);
             echo::debug("IpcStream created from accepted connection fd=", fd);
         }
 
+        // Copy the payload into a fresh memfd and seal it; -1 if that fails (the caller sends inline instead)
+        static dp::i32 make_memfd(std::span<const iovec> parts) {
+            dp::i32 memfd = ::memfd_create("netpipe", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            if (memfd < 0) {
+                echo::warn("memfd_create failed: ", strerror(errno));
+                return -1;
+            }
+            iovec iov[MAX_IOV_PARTS];
+            for (dp::usize i = 0; i < parts.size(); i++) {
+                iov[i] = parts[i];
+            }
+            auto res = writev_exact(memfd, iov, static_cast<dp::i32>(parts.size()));
+            if (res.is_err() ||
+                ::fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+                echo::warn("filling memfd failed: ", strerror(errno));
+                ::close(memfd);
+                return -1;
+            }
+            return memfd;
+        }
+
+        // Send a descriptor frame for memfd; the fd rides on the first byte of the frame
+        dp::Res<void> send_descriptor(dp::i32 memfd, dp::u64 length) {
+            dp::u8 frame[FrameReader::DESCRIPTOR_FRAME_SIZE];
+            auto marker = encode_u32_be(FrameReader::DESCRIPTOR_FRAME);
+            auto high = encode_u32_be(static_cast<dp::u32>(length >> 32));
+            auto low = encode_u32_be(static_cast<dp::u32>(length));
+            std::memcpy(frame, marker.data(), 4);
+            std::memcpy(frame + 4, high.data(), 4);
+            std::memcpy(frame + 8, low.data(), 4);
+
+            iovec iov{frame, sizeof(frame)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(dp::i32))] = {};
+            msghdr hdr = {};
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = control;
+            hdr.msg_controllen = sizeof(control);
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(dp::i32));
+            std::memcpy(CMSG_DATA(cmsg), &memfd, sizeof(memfd));
+
+            dp::isize n;
+            do {
+                n = ::sendmsg(fd_, &hdr, MSG_NOSIGNAL);
+            } while (n < 0 && errno == EINTR);
+            ::close(memfd); // The receiver holds its own reference once sendmsg returns
+            if (n < 0) {
+                return dp::result::err(write_error_from_errno(fd_, sizeof(frame), 0));
+            }
+            if (static_cast<dp::usize>(n) < sizeof(frame)) {
+                return write_exact(fd_, frame + n, sizeof(frame) - static_cast<dp::usize>(n));
+            }
+            return dp::result::ok();
+        }
+
+        void release_view() {
+            if (view_map_) {
+                ::munmap(const_cast<dp::u8 *>(view_map_), view_map_length_);
+                view_map_ = nullptr;
+                view_map_length_ = 0;
+            }
+            view_active_ = false;
+        }
+
         // Helper to cleanup on fatal errors
         // Closes socket and resets state without unlinking (only close() unlinks)
         void cleanup_on_error() {
             if (fd_ >= 0) {
                 echo::trace("cleanup_on_error: closing fd=", fd_);
+                stats_socket(-1);
                 ::close(fd_);
                 fd_ = -1;
             }
             connected_ = false;
             listening_ = false;
+            reader_.reset();
+            release_view();
             // Note: We don't unlink here - only close() unlinks listening sockets
             // This prevents accidental removal of socket files on transient errors
         }
 
       public:
-        IpcStream() : fd_(-1), connected_(false), listening_(false), should_unlink_(false) {
+        IpcStream()
+            : fd_(-1), connected_(false), listening_(false), should_unlink_(false), fd_threshold_(0),
+              view_active_(false), view_map_(nullptr), view_map_length_(0) {
+            reader_.set_descriptors(true);
             echo::trace("IpcStream constructed");
         }
 
@@ -188,44 +271,116 @@ namespace netpipe {
 
             // Create new IpcStream for the client
             auto client_stream = std::unique_ptr<Stream>(new IpcStream(client_fd, local_endpoint_, client_endpoint));
+            (void)client_stream->set_memory_budget(reader_.budget());
+            inherit_stats(*client_stream);
 
             return dp::result::ok(std::move(client_stream));
         }
 
         // Send a message with length-prefix framing (same as TCP)
         dp::Res<void> send(const Message &msg) override {
+            iovec part{const_cast<dp::u8 *>(msg.data()), msg.size()};
+            return send_iov(std::span<const iovec>(&part, 1));
+        }
+
+        // Send several buffers as one length-prefixed message
+        // Length prefix and all parts go out in a single writev - no gathering copy
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
             if (!connected_ || fd_ < 0) {
                 echo::trace("send called but not connected");
                 return dp::result::err(dp::Error::not_found("not connected"));
             }
 
-            echo::trace("send ", msg.size(), " bytes");
+            if (parts.size() > MAX_IOV_PARTS) {
+                return Stream::send_iov(parts);
+            }
+
+            dp::usize total = 0;
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
+
+            echo::trace("send ", total, " bytes");
+
+            if (fd_threshold_ > 0 && total >= fd_threshold_) {
+                dp::i32 memfd = make_memfd(parts);
+                if (memfd >= 0) {
+                    auto res = send_descriptor(memfd, total);
+                    if (res.is_err()) {
+                        echo::trace("send failed: ", res.error().message.c_str());
+                        cleanup_on_error();
+                        return res;
+                    }
+                    if (counters_) {
+                        counters_->on_send(total);
+                    }
+                    echo::debug("sent ", total, " bytes as memfd");
+                    return dp::result::ok();
+                }
+            }
 
             // Encode length prefix (4 bytes big-endian)
-            auto length_bytes = encode_u32_be(static_cast<dp::u32>(msg.size()));
+            auto length_bytes = encode_u32_be(static_cast<dp::u32>(total));
 
-            // Send length prefix
-            auto res = write_exact(fd_, length_bytes.data(), 4);
+            iovec iov[MAX_IOV_PARTS + 1];
+            iov[0] = {length_bytes.data(), length_bytes.size()};
+            for (dp::usize i = 0; i < parts.size(); i++) {
+                iov[i + 1] = parts[i];
+            }
+
+            auto res = writev_exact(fd_, iov, static_cast<dp::i32>(parts.size() + 1), counters_.get());
             if (res.is_err()) {
-                echo::trace("send length failed: ", res.error().message.c_str());
+                echo::trace("send failed: ", res.error().message.c_str());
                 cleanup_on_error();
                 return res;
             }
+            if (counters_) {
+                counters_->on_send(total);
+            }
 
-            // Send payload
-            if (!msg.empty()) {
-                res = write_exact(fd_, msg.data(), msg.size());
-                if (res.is_err()) {
-                    echo::trace("send payload failed: ", res.error().message.c_str());
-                    cleanup_on_error();
-                    return res;
+            echo::debug("sent ", total, " bytes");
+            return dp::result::ok();
+        }
+
+        // Send several length-prefixed messages, packing as many as fit into each writev
+        dp::Res<void> send_batch(std::span<const std::span<const iovec>> frames) override {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("send_batch called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+            for (const auto &parts : frames) {
+                if (parts.size() > MAX_IOV_PARTS) {
+                    return Stream::send_batch(frames);
+                }
+                if (fd_threshold_ > 0) {
+                    dp::usize total = 0;
+                    for (const auto &part : parts) {
+                        total += part.iov_len;
+                    }
+                    if (total >= fd_threshold_) {
+                        return Stream::send_batch(frames); // Message by message, so big ones become memfds
+                    }
                 }
             }
 
-            echo::debug("sent ", msg.size(), " bytes");
+            auto res = writev_frames(fd_, frames, counters_.get());
+            if (res.is_err()) {
+                echo::trace("send_batch failed: ", res.error().message.c_str());
+                cleanup_on_error();
+                return res;
+            }
+            if (counters_) {
+                counters_->on_send_batch(frames.size(), frames_size(frames));
+            }
+            echo::debug("sent batch of ", frames.size(), " messages");
             return dp::result::ok();
         }
 
+        // Buffered frame bytes count as input - the fd alone would miss them
+        bool has_pending_input() const override {
+            return connected_ && fd_ >= 0 && (reader_.buffered() > 0 || fd_readable(fd_));
+        }
+
         // Receive a message with length-prefix framing (same as TCP)
         // TIMEOUT HANDLING:
         // - Timeouts are expected behavior (not errors) when using set_recv_timeout()
@@ -234,6 +389,16 @@ namespace netpipe {
         // - This allows RPC to implement request timeouts without breaking the connection
         // - Behavior matches TcpStream for consistency
         dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        // Receive into a caller-owned buffer, reusing its capacity
+        dp::Res<void> recv_into(Message &msg) override {
             if (!connected_ || fd_ < 0) {
                 echo::trace("recv called but not connected");
                 return dp::result::err(dp::Error::not_found("not connected"));
@@ -241,59 +406,123 @@ namespace netpipe {
 
             echo::trace("recv waiting for message");
 
-            // Read length prefix (4 bytes)
-            dp::Array<dp::u8, 4> length_bytes;
-            auto res = read_exact(fd_, length_bytes.data(), 4);
+            auto res = reader_.read_frame_into(fd_, remote::MAX_MESSAGE_SIZE, msg);
             if (res.is_err()) {
-                // Only cleanup for non-timeout errors
+                // Only mark as disconnected for non-timeout errors
                 // Timeout is expected behavior - connection stays alive
                 if (res.error().code != dp::Error::TIMEOUT) {
-                    echo::trace("recv length failed: ", res.error().message.c_str());
+                    echo::trace("recv failed: ", res.error().message.c_str());
                     cleanup_on_error();
                 }
-                return dp::result::err(res.error());
+                return res;
+            }
+            if (counters_) {
+                counters_->on_recv(msg.size());
             }
 
-            dp::u32 length = decode_u32_be(length_bytes.data());
-            echo::trace("recv expecting ", length, " bytes");
+            echo::debug("received ", msg.size(), " bytes");
+            return dp::result::ok();
+        }
 
-            // Validate message size before allocating
-            if (length > remote::MAX_MESSAGE_SIZE) {
-                echo::error("received message too large: ", length, " bytes (max: ", remote::MAX_MESSAGE_SIZE, ")");
-                cleanup_on_error();
-                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+        // Receive with the first prefix_len bytes split off into prefix (see Stream::recv_split)
+        dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) override {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("recv called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
             }
 
-            // Allocate message buffer with exception handling
-            Message msg;
-            try {
-                msg.resize(length);
-            } catch (const std::bad_alloc &e) {
-                echo::error("failed to allocate message buffer: ", length, " bytes - ", e.what());
-                cleanup_on_error();
-                return dp::result::err(dp::Error::io_error("memory allocation failed"));
-            } catch (const std::exception &e) {
-                echo::error("unexpected error allocating message buffer: ", e.what());
-                cleanup_on_error();
-                return dp::result::err(dp::Error::io_error("allocation error"));
-            }
-            if (length > 0) {
-                res = read_exact(fd_, msg.data(), length);
-                if (res.is_err()) {
-                    // Only cleanup for non-timeout errors
-                    // Timeout during payload read keeps connection alive
-                    if (res.error().code != dp::Error::TIMEOUT) {
-                        echo::trace("recv payload failed: ", res.error().message.c_str());
-                        cleanup_on_error();
-                    }
-                    return dp::result::err(res.error());
+            echo::trace("recv waiting for message");
+
+            auto res = reader_.read_frame_split(fd_, remote::MAX_MESSAGE_SIZE, prefix, prefix_len, rest);
+            if (res.is_err()) {
+                // Only mark as disconnected for non-timeout errors
+                if (res.error().code != dp::Error::TIMEOUT) {
+                    echo::trace("recv failed: ", res.error().message.c_str());
+                    cleanup_on_error();
                 }
+                return res;
+            }
+            if (counters_) {
+                counters_->on_recv(res.value() + rest.size());
             }
 
-            echo::debug("received ", length, " bytes");
-            return dp::result::ok(std::move(msg));
+            echo::debug("received ", res.value() + rest.size(), " bytes");
+            return res;
         }
 
+        // View of the next message without copying it
+        // A message sent as a memfd is mapped read-only in place; one that came through the socket is read
+        // into a buffer owned by the stream. The span stays valid until release().
+        dp::Res<std::span<const dp::u8>> recv_view() {
+            if (view_active_) {
+                echo::error("recv_view called while a view is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("view not released"));
+            }
+            if (!connected_ || fd_ < 0) {
+                echo::trace("recv called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+
+            dp::i32 memfd = -1;
+            dp::u64 length = 0;
+            auto res = reader_.read_frame_or_descriptor(fd_, remote::MAX_MESSAGE_SIZE, view_buffer_, memfd, length);
+            if (res.is_err()) {
+                if (res.error().code != dp::Error::TIMEOUT) {
+                    echo::trace("recv failed: ", res.error().message.c_str());
+                    cleanup_on_error();
+                }
+                return dp::result::err(res.error());
+            }
+
+            if (counters_) {
+                counters_->on_recv(memfd < 0 ? view_buffer_.size() : length);
+            }
+            if (memfd < 0) {
+                view_active_ = true;
+                return dp::result::ok(std::span<const dp::u8>(view_buffer_.data(), view_buffer_.size()));
+            }
+            const dp::u8 *map = map_descriptor(memfd, length);
+            ::close(memfd); // The mapping keeps the pages alive
+            if (!map) {
+                return dp::result::err(dp::Error::io_error("invalid descriptor frame"));
+            }
+            view_active_ = true;
+            view_map_ = map;
+            view_map_length_ = length;
+            echo::trace("ipc view of ", length, " mapped bytes");
+            return dp::result::ok(std::span<const dp::u8>(map, static_cast<dp::usize>(length)));
+        }
+
+        // Drop the message from recv_view() (unmaps a memfd payload)
+        void release() { release_view(); }
+
+        // Send messages of at least threshold bytes as a sealed memfd passed with SCM_RIGHTS; 0 turns it off
+        // The socket carries only a 12-byte descriptor frame and the receiver maps the payload instead of
+        // reading it through the socket buffer. Every IpcStream accepts these frames, so only senders opt in.
+        // Worth it from a few hundred KB: below that memfd_create and mmap cost more than the copy they save.
+        void set_fd_passing(dp::usize threshold) { fd_threshold_ = threshold; }
+
+        dp::usize fd_passing_threshold() const { return fd_threshold_; }
+
+        // Size of the per-connection receive buffer (FrameReader::DEFAULT_CAPACITY by default)
+        // Small frames are parsed out of one read(2); 0 disables buffering
+        // Fails while received bytes are still pending in the buffer
+        dp::Res<void> set_recv_buffer_size(dp::usize bytes) { return reader_.set_capacity(bytes); }
+
+        dp::usize recv_buffer_size() const { return reader_.capacity(); }
+
+        // Frame lengths are reserved in the budget before their buffer is allocated (see FrameReader)
+        dp::Res<void> set_memory_budget(MemoryBudget *budget) override {
+            reader_.set_budget(budget);
+            return dp::result::ok();
+        }
+
+        BudgetLease take_lease() override { return reader_.take_lease(); }
+
+        MemoryBudget *memory_budget() const override { return reader_.budget(); }
+
+        void set_budget_exemption(BudgetExemption exempt) override { reader_.set_exemption(exempt); }
+
         // Set receive timeout in milliseconds
         dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
             if (fd_ < 0) {
@@ -318,9 +547,12 @@ namespace netpipe {
         void close() override {
             if (fd_ >= 0) {
                 echo::trace("closing fd=", fd_);
+                stats_socket(-1);
                 ::close(fd_);
                 fd_ = -1;
                 connected_ = false;
+                reader_.reset();
+                release_view();
 
                 // Unlink socket file if we created it (listening socket)
                 if (listening_ && should_unlink_) {
@@ -339,6 +571,12 @@ namespace netpipe {
 
         // Check if connected
         bool is_connected() const override { return connected_; }
+
+        // Socket fd (listening or connected), -1 when closed
+        dp::i32 native_handle() const override { return fd_; }
+
+      protected:
+        void stats_attached(TransportCounters *counters) override { reader_.set_counters(counters); }
     };
 
 } // namespace netpipe
@@ -0,0 +1,904 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <netpipe/remote/protocol.hpp>
+#include <netpipe/stream.hpp>
+#include <netpipe/stream/tcp.hpp>
+#include <thread>
+
+#include <infiniband/verbs.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace netpipe {
+
+    // Per-connection resources of an RdmaStream; accepted streams take the listener's
+    struct RdmaOptions {
+        dp::String device;                      // ibverbs device name, empty = the first one found
+        dp::u8 port = 1;                        // Device port
+        dp::i32 gid_index = 0;                  // RoCE: GID table entry the peer is addressed with
+        dp::u32 slots = 64;                     // Receive buffers posted per connection
+        dp::u32 slot_size = 8 * 1024;           // Messages up to this size go as SEND into a receive buffer
+        dp::u32 region_size = 4 * 1024 * 1024;  // RDMA WRITE landing region, two halves; writes are half its size
+        dp::u32 spin_polls = 4096;              // Empty completion-queue polls before a waiter starts yielding
+    };
+
+    // Reliable-connected queue pair over InfiniBand or RoCE, set up through a TCP control connection
+    // connect()/listen()/accept() run on the TcpStream; the endpoints then swap queue pair numbers, addresses and
+    // the rkey of their landing regions over it and move every message through the queue pair:
+    //   - small messages (up to the peer's slot_size): SEND with immediate from a ring of SEND_RING registered
+    //     staging buffers into one of the peer's pre-posted receive buffers. Only every SIGNAL_INTERVAL-th work
+    //     request asks for a completion, and send() returns once the SEND is posted; a staging buffer is reused
+    //     when a later signaled completion shows the SEND that last used it is done
+    //   - larger ones: RDMA WRITE with immediate into the peer's registered landing region, which is split in
+    //     two halves used in turn; chunks of half its size go out while the receiver copies out the other half,
+    //     and each copied half comes back as a credit
+    // Completion queues are polled, never armed: the caller's thread spins spin_polls times and then yields, so
+    // latency is that of the fabric while a connection is busy. Ordering follows from the queue pair, so SEND and
+    // WRITE traffic can be mixed freely. The control connection stays open and tells either side when the peer
+    // is gone. Build with NETPIPE_RDMA and link libibverbs (NETPIPE_ENABLE_RDMA / the rdma option).
+    class RdmaStream : public Stream {
+      private:
+        // Immediate data: kind in the two top bits, chunk length below
+        static constexpr dp::u32 KIND_SHIFT = 30;
+        static constexpr dp::u32 LENGTH_MASK = (1u << KIND_SHIFT) - 1;
+        static constexpr dp::u32 KIND_MESSAGE = 0; // SEND carrying a whole message
+        static constexpr dp::u32 KIND_CHUNK = 1;   // WRITE chunk, more follow
+        static constexpr dp::u32 KIND_LAST = 2;    // WRITE chunk completing the message
+        static constexpr dp::u32 KIND_CREDIT = 3;  // Landing region copied out, the next chunk may follow
+
+        static constexpr dp::u64 CREDIT_WR = ~0ull; // Data work requests carry their sequence number instead
+        static constexpr dp::u32 SEND_DEPTH = 32;
+        static constexpr dp::u32 SEND_RING = 16;      // Data work requests in flight, and SEND staging buffers
+        static constexpr dp::u32 SIGNAL_INTERVAL = 8; // Every n-th SEND is signaled; WRITEs always are
+        static constexpr dp::u32 INLINE_SIZE = 128;
+        static constexpr dp::u32 HANDSHAKE_TIMEOUT_MS = 5000;
+        static constexpr dp::usize PEER_INFO_SIZE = 52;
+
+        // What each end tells the other over the control connection
+        struct PeerInfo {
+            dp::u32 qp_num;
+            dp::u32 psn;
+            dp::u32 lid;
+            dp::u32 mtu;
+            dp::u8 gid[16];
+            dp::u64 region_addr;
+            dp::u32 region_rkey;
+            dp::u32 region_size;
+            dp::u32 slot_size;
+        };
+
+        // A receive completion the receiving thread has not consumed yet
+        struct Arrival {
+            dp::u32 slot;
+            dp::u32 imm;
+            dp::u32 bytes;
+        };
+
+        RdmaOptions options_;
+        std::unique_ptr<TcpStream> control_;
+        std::atomic<bool> connected_;
+        std::atomic<dp::i32> timeout_ms_; // -1 = block forever
+
+        ibv_context *context_;
+        ibv_pd *pd_;
+        ibv_cq *send_cq_;
+        ibv_cq *recv_cq_;
+        ibv_qp *qp_;
+        ibv_port_attr port_attr_;
+        dp::u32 psn_;
+        dp::u32 max_inline_;
+
+        // Registered memory: receive slots, SEND staging ring, landing region (peer writes) and the staging copy
+        // chunks are written from, each region split in two halves
+        dp::u8 *slots_;
+        dp::u8 *staging_;
+        dp::u8 *region_;
+        dp::u8 *region_staging_;
+        ibv_mr *slots_mr_;
+        ibv_mr *staging_mr_;
+        ibv_mr *region_mr_;
+        ibv_mr *region_staging_mr_;
+
+        PeerInfo peer_;
+
+        // Send side: one message at a time (send_mutex_); completions are reaped under send_cq_mutex_
+        // Data work requests are numbered from 1; a signaled completion of n means every one up to n is done
+        std::mutex send_mutex_;
+        std::mutex send_cq_mutex_;
+        dp::u64 posted_;                      // Guarded by send_mutex_
+        dp::u64 completed_;                   // Guarded by send_cq_mutex_
+        dp::u64 half_wr_[2];                  // Last WRITE from each staging half; guarded by send_mutex_
+        dp::u32 next_half_;                   // Peer landing half the next chunk goes to; guarded by send_mutex_
+        std::atomic<dp::u32> region_credits_; // Peer landing halves free for a chunk
+
+        // Receive completions, reaped by whichever side polls (senders wait for credits there too)
+        std::mutex recv_cq_mutex_;
+        std::deque<Arrival> arrivals_;
+
+        // Receive side, one receiver at a time; a chunked message survives a timeout
+        std::mutex recv_mutex_;
+        Message partial_;
+        bool partial_active_;
+        dp::u32 recv_half_; // Landing half the next chunk arrives in
+
+        RdmaStream(RdmaOptions options, std::unique_ptr<TcpStream> control)
+            : options_(std::move(options)), control_(std::move(control)), connected_(false), timeout_ms_(-1),
+              context_(nullptr), pd_(nullptr), send_cq_(nullptr), recv_cq_(nullptr), qp_(nullptr), port_attr_{},
+              psn_(0), max_inline_(0), slots_(nullptr), staging_(nullptr), region_(nullptr),
+              region_staging_(nullptr), slots_mr_(nullptr), staging_mr_(nullptr), region_mr_(nullptr),
+              region_staging_mr_(nullptr), peer_{}, posted_(0), completed_(0), half_wr_{0, 0}, next_half_(0),
+              region_credits_(2), partial_active_(false), recv_half_(0) {}
+
+        static dp::Error verbs_error(const char *what) {
+            echo::error("RdmaStream ", what, " failed: ", strerror(errno));
+            return dp::Error::io_error(dp::String("rdma ") + what + " failed");
+        }
+
+        // Page-aligned buffer registered with the protection domain
+        dp::Res<void> register_buffer(dp::usize size, dp::i32 access, dp::u8 *&buffer, ibv_mr *&mr) {
+            void *memory = nullptr;
+            if (::posix_memalign(&memory, 4096, size) != 0) {
+                return dp::result::err(dp::Error::io_error("memory allocation failed"));
+            }
+            std::memset(memory, 0, size);
+            buffer = static_cast<dp::u8 *>(memory);
+            mr = ibv_reg_mr(pd_, buffer, size, access);
+            if (mr == nullptr) {
+                return dp::result::err(verbs_error("memory registration"));
+            }
+            return dp::result::ok();
+        }
+
+        static void release_buffer(dp::u8 *&buffer, ibv_mr *&mr) {
+            if (mr != nullptr) {
+                ibv_dereg_mr(mr);
+                mr = nullptr;
+            }
+            std::free(buffer);
+            buffer = nullptr;
+        }
+
+        // Device, protection domain, completion queues, queue pair in INIT and every receive posted
+        dp::Res<void> open_device() {
+            if (options_.slots == 0 || options_.slot_size == 0 || options_.region_size < 2 ||
+                options_.region_size > LENGTH_MASK) {
+                return dp::result::err(dp::Error::invalid_argument("invalid rdma options"));
+            }
+
+            dp::i32 count = 0;
+            ibv_device **devices = ibv_get_device_list(&count);
+            if (devices == nullptr || count == 0) {
+                if (devices != nullptr) {
+                    ibv_free_device_list(devices);
+                }
+                echo::error("RdmaStream found no RDMA device");
+                return dp::result::err(dp::Error::not_found("no rdma device"));
+            }
+            ibv_device *device = nullptr;
+            for (dp::i32 i = 0; i < count && device == nullptr; i++) {
+                if (options_.device.empty() || options_.device == ibv_get_device_name(devices[i])) {
+                    device = devices[i];
+                }
+            }
+            if (device == nullptr) {
+                ibv_free_device_list(devices);
+                echo::error("RdmaStream device not found: ", options_.device.c_str());
+                return dp::result::err(dp::Error::not_found("rdma device not found"));
+            }
+            context_ = ibv_open_device(device);
+            ibv_free_device_list(devices);
+            if (context_ == nullptr) {
+                return dp::result::err(verbs_error("device open"));
+            }
+            if (ibv_query_port(context_, options_.port, &port_attr_) != 0) {
+                return dp::result::err(verbs_error("port query"));
+            }
+
+            pd_ = ibv_alloc_pd(context_);
+            if (pd_ == nullptr) {
+                return dp::result::err(verbs_error("protection domain allocation"));
+            }
+            send_cq_ = ibv_create_cq(context_, SEND_DEPTH * 2, nullptr, nullptr, 0);
+            recv_cq_ = ibv_create_cq(context_, static_cast<dp::i32>(options_.slots) + 1, nullptr, nullptr, 0);
+            if (send_cq_ == nullptr || recv_cq_ == nullptr) {
+                return dp::result::err(verbs_error("completion queue creation"));
+            }
+
+            ibv_qp_init_attr init = {};
+            init.send_cq = send_cq_;
+            init.recv_cq = recv_cq_;
+            init.qp_type = IBV_QPT_RC;
+            init.cap.max_send_wr = SEND_DEPTH;
+            init.cap.max_recv_wr = options_.slots;
+            init.cap.max_send_sge = 1;
+            init.cap.max_recv_sge = 1;
+            init.cap.max_inline_data = INLINE_SIZE;
+            qp_ = ibv_create_qp(pd_, &init);
+            if (qp_ == nullptr) {
+                return dp::result::err(verbs_error("queue pair creation"));
+            }
+            max_inline_ = init.cap.max_inline_data;
+
+            auto res = register_buffer(static_cast<dp::usize>(options_.slots) * options_.slot_size,
+                                       IBV_ACCESS_LOCAL_WRITE, slots_, slots_mr_);
+            if (res.is_ok()) {
+                res = register_buffer(static_cast<dp::usize>(SEND_RING) * options_.slot_size, IBV_ACCESS_LOCAL_WRITE,
+                                      staging_, staging_mr_);
+            }
+            if (res.is_ok()) {
+                res = register_buffer(options_.region_size, IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE,
+                                      region_, region_mr_);
+            }
+            if (res.is_ok()) {
+                res = register_buffer(options_.region_size, IBV_ACCESS_LOCAL_WRITE, region_staging_,
+                                      region_staging_mr_);
+            }
+            if (res.is_err()) {
+                return res;
+            }
+
+            ibv_qp_attr attr = {};
+            attr.qp_state = IBV_QPS_INIT;
+            attr.pkey_index = 0;
+            attr.port_num = options_.port;
+            attr.qp_access_flags = IBV_ACCESS_REMOTE_WRITE;
+            if (ibv_modify_qp(qp_, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+                return dp::result::err(verbs_error("queue pair INIT"));
+            }
+            for (dp::u32 slot = 0; slot < options_.slots; slot++) {
+                auto post = post_recv(slot);
+                if (post.is_err()) {
+                    return post;
+                }
+            }
+            psn_ = static_cast<dp::u32>(qp_->qp_num * 2654435761u ^
+                                        std::chrono::steady_clock::now().time_since_epoch().count()) &
+                   0xffffff;
+            return dp::result::ok();
+        }
+
+        Message encode_info() const {
+            ibv_gid gid = {};
+            ibv_query_gid(context_, options_.port, options_.gid_index, &gid);
+            Message out;
+            out.reserve(PEER_INFO_SIZE);
+            append_u32_be(out, qp_->qp_num);
+            append_u32_be(out, psn_);
+            append_u32_be(out, port_attr_.lid);
+            append_u32_be(out, static_cast<dp::u32>(port_attr_.active_mtu));
+            out.insert(out.end(), gid.raw, gid.raw + sizeof(gid.raw));
+            dp::u64 addr = reinterpret_cast<dp::u64>(region_);
+            append_u32_be(out, static_cast<dp::u32>(addr >> 32));
+            append_u32_be(out, static_cast<dp::u32>(addr));
+            append_u32_be(out, region_mr_->rkey);
+            append_u32_be(out, options_.region_size);
+            append_u32_be(out, options_.slot_size);
+            return out;
+        }
+
+        static dp::Res<PeerInfo> decode_info(const Message &in) {
+            if (in.size() != PEER_INFO_SIZE) {
+                return dp::result::err(dp::Error::invalid_argument("malformed rdma handshake"));
+            }
+            PeerInfo info = {};
+            const dp::u8 *p = in.data();
+            info.qp_num = decode_u32_be(p);
+            info.psn = decode_u32_be(p + 4);
+            info.lid = decode_u32_be(p + 8);
+            info.mtu = decode_u32_be(p + 12);
+            std::memcpy(info.gid, p + 16, sizeof(info.gid));
+            info.region_addr = (static_cast<dp::u64>(decode_u32_be(p + 32)) << 32) | decode_u32_be(p + 36);
+            info.region_rkey = decode_u32_be(p + 40);
+            info.region_size = decode_u32_be(p + 44);
+            info.slot_size = decode_u32_be(p + 48);
+            return dp::result::ok(info);
+        }
+
+        // Queue pair to RTR and RTS against the peer
+        dp::Res<void> connect_qp() {
+            bool global = port_attr_.link_layer == IBV_LINK_LAYER_ETHERNET;
+            dp::u32 mtu = peer_.mtu < static_cast<dp::u32>(port_attr_.active_mtu)
+                              ? peer_.mtu
+                              : static_cast<dp::u32>(port_attr_.active_mtu);
+
+            ibv_qp_attr attr = {};
+            attr.qp_state = IBV_QPS_RTR;
+            attr.path_mtu = static_cast<ibv_mtu>(mtu);
+            attr.dest_qp_num = peer_.qp_num;
+            attr.rq_psn = peer_.psn;
+            attr.max_dest_rd_atomic = 1;
+            attr.min_rnr_timer = 12;
+            attr.ah_attr.dlid = static_cast<dp::u16>(peer_.lid);
+            attr.ah_attr.port_num = options_.port;
+            if (global) {
+                attr.ah_attr.is_global = 1;
+                std::memcpy(attr.ah_attr.grh.dgid.raw, peer_.gid, sizeof(peer_.gid));
+                attr.ah_attr.grh.sgid_index = static_cast<dp::u8>(options_.gid_index);
+                attr.ah_attr.grh.hop_limit = 64;
+            }
+            if (ibv_modify_qp(qp_, &attr,
+                              IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+                                  IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+                return dp::result::err(verbs_error("queue pair RTR"));
+            }
+
+            attr = {};
+            attr.qp_state = IBV_QPS_RTS;
+            attr.timeout = 14;
+            attr.retry_cnt = 7;
+            attr.rnr_retry = 7; // A receiver without a free buffer holds the sender back instead of failing it
+            attr.sq_psn = psn_;
+            attr.max_rd_atomic = 1;
+            if (ibv_modify_qp(qp_, &attr,
+                              IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+                                  IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+                return dp::result::err(verbs_error("queue pair RTS"));
+            }
+            return dp::result::ok();
+        }
+
+        // Everything after the control connection is up: both ends run the same exchange
+        dp::Res<void> handshake() {
+            auto res = open_device();
+            if (res.is_ok()) {
+                res = control_->set_recv_timeout(HANDSHAKE_TIMEOUT_MS);
+            }
+            if (res.is_ok()) {
+                res = control_->send(encode_info());
+            }
+            if (res.is_err()) {
+                release();
+                return res;
+            }
+            auto info = control_->recv();
+            if (info.is_err()) {
+                release();
+                return dp::result::err(info.error());
+            }
+            auto decoded = decode_info(info.value());
+            if (decoded.is_err()) {
+                release();
+                return dp::result::err(decoded.error());
+            }
+            peer_ = decoded.value();
+
+            // Neither side may send before the other's queue pair can receive
+            res = connect_qp();
+            if (res.is_ok()) {
+                res = control_->send(Message{1});
+            }
+            if (res.is_ok()) {
+                auto ready = control_->recv();
+                if (ready.is_err()) {
+                    res = dp::result::err(ready.error());
+                }
+            }
+            if (res.is_ok()) {
+                res = control_->set_recv_timeout(0);
+            }
+            if (res.is_err()) {
+                release();
+                return res;
+            }
+
+            connected_ = true;
+            echo::info("RdmaStream connected qp=", qp_->qp_num, " peer qp=", peer_.qp_num, " slots=", options_.slots,
+                       "x", options_.slot_size, " region=", peer_.region_size);
+            return dp::result::ok();
+        }
+
+        void release() {
+            connected_ = false;
+            if (qp_ != nullptr) {
+                ibv_destroy_qp(qp_);
+                qp_ = nullptr;
+            }
+            release_buffer(slots_, slots_mr_);
+            release_buffer(staging_, staging_mr_);
+            release_buffer(region_, region_mr_);
+            release_buffer(region_staging_, region_staging_mr_);
+            if (send_cq_ != nullptr) {
+                ibv_destroy_cq(send_cq_);
+                send_cq_ = nullptr;
+            }
+            if (recv_cq_ != nullptr) {
+                ibv_destroy_cq(recv_cq_);
+                recv_cq_ = nullptr;
+            }
+            if (pd_ != nullptr) {
+                ibv_dealloc_pd(pd_);
+                pd_ = nullptr;
+            }
+            if (context_ != nullptr) {
+                ibv_close_device(context_);
+                context_ = nullptr;
+            }
+            arrivals_.clear();
+            partial_active_ = false;
+        }
+
+        dp::Res<void> post_recv(dp::u32 slot) {
+            ibv_sge sge = {};
+            sge.addr = reinterpret_cast<dp::u64>(slots_ + static_cast<dp::usize>(slot) * options_.slot_size);
+            sge.length = options_.slot_size;
+            sge.lkey = slots_mr_->lkey;
+            ibv_recv_wr wr = {};
+            wr.wr_id = slot;
+            wr.sg_list = &sge;
+            wr.num_sge = 1;
+            ibv_recv_wr *bad = nullptr;
+            if (ibv_post_recv(qp_, &wr, &bad) != 0) {
+                return dp::result::err(verbs_error("receive post"));
+            }
+            return dp::result::ok();
+        }
+
+        // The peer's end of the control connection is gone (or broken)
+        bool peer_gone() {
+            dp::u8 byte;
+            dp::isize n = ::recv(control_->native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+            return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+        }
+
+        dp::Res<void> fail(dp::Error error) {
+            connected_ = false;
+            return dp::result::err(std::move(error));
+        }
+
+        // One pass over the receive CQ; caller holds recv_cq_mutex_. Credits are taken here, data is queued
+        dp::Res<void> poll_recv_locked() {
+            ibv_wc wc[16];
+            dp::i32 n = ibv_poll_cq(recv_cq_, 16, wc);
+            if (n < 0) {
+                return fail(dp::Error::io_error("rdma receive completion poll failed"));
+            }
+            for (dp::i32 i = 0; i < n; i++) {
+                if (wc[i].status != IBV_WC_SUCCESS) {
+                    echo::trace("RdmaStream receive completion failed: ", ibv_wc_status_str(wc[i].status));
+                    return fail(dp::Error::not_found("rdma connection lost"));
+                }
+                if (!(wc[i].wc_flags & IBV_WC_WITH_IMM)) {
+                    return fail(dp::Error::invalid_argument("rdma completion without immediate data"));
+                }
+                dp::u32 slot = static_cast<dp::u32>(wc[i].wr_id);
+                dp::u32 imm = ntohl(wc[i].imm_data);
+                if ((imm >> KIND_SHIFT) == KIND_CREDIT) {
+                    region_credits_.fetch_add(1, std::memory_order_release);
+                    auto post = post_recv(slot);
+                    if (post.is_err()) {
+                        return fail(post.error());
+                    }
+                    continue;
+                }
+                arrivals_.push_back({slot, imm, wc[i].byte_len});
+            }
+            return dp::result::ok();
+        }
+
+        // Reap send completions; caller holds send_cq_mutex_
+        dp::Res<void> poll_send_locked() {
+            ibv_wc wc[8];
+            dp::i32 n = ibv_poll_cq(send_cq_, 8, wc);
+            if (n < 0) {
+                return fail(dp::Error::io_error("rdma send completion poll failed"));
+            }
+            for (dp::i32 i = 0; i < n; i++) {
+                if (wc[i].status != IBV_WC_SUCCESS) {
+                    echo::trace("RdmaStream send completion failed: ", ibv_wc_status_str(wc[i].status));
+                    return fail(dp::Error::not_found("rdma connection lost"));
+                }
+                if (wc[i].wr_id != CREDIT_WR && wc[i].wr_id > completed_) {
+                    completed_ = wc[i].wr_id; // The queue pair completes in order
+                }
+            }
+            return dp::result::ok();
+        }
+
+        // Spin, then yield; false once timeout_ms passed. Every so often the control connection is checked
+        bool keep_waiting(dp::u32 &polls, std::chrono::steady_clock::time_point start, dp::i32 timeout_ms) {
+            if (++polls < options_.spin_polls) {
+                cpu_relax();
+                return true;
+            }
+            if ((polls & 1023) == 0 && peer_gone()) {
+                echo::trace("RdmaStream peer closed its control connection");
+                connected_ = false;
+                return true; // The caller sees connected_ and reports it
+            }
+            if (timeout_ms >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeout_ms)) {
+                return false;
+            }
+            std::this_thread::yield();
+            return true;
+        }
+
+        dp::Res<Arrival> next_arrival() {
+            auto start = std::chrono::steady_clock::now();
+            dp::u32 polls = 0;
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(recv_cq_mutex_);
+                    if (arrivals_.empty()) {
+                        auto res = poll_recv_locked();
+                        if (res.is_err()) {
+                            return dp::result::err(res.error());
+                        }
+                    }
+                    if (!arrivals_.empty()) {
+                        Arrival arrival = arrivals_.front();
+                        arrivals_.pop_front();
+                        return dp::result::ok(arrival);
+                    }
+                }
+                if (!connected_) {
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+                if (!keep_waiting(polls, start, timeout_ms_.load(std::memory_order_relaxed))) {
+                    return dp::result::err(dp::Error::timeout("recv timeout"));
+                }
+            }
+        }
+
+        // Wait until data work request n has completed
+        dp::Res<void> wait_completed(dp::u64 n) {
+            auto start = std::chrono::steady_clock::now();
+            dp::u32 polls = 0;
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(send_cq_mutex_);
+                    if (completed_ >= n) {
+                        return dp::result::ok();
+                    }
+                    auto res = poll_send_locked();
+                    if (res.is_err()) {
+                        return res;
+                    }
+                    if (completed_ >= n) {
+                        return dp::result::ok();
+                    }
+                }
+                if (!connected_) {
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+                keep_waiting(polls, start, -1);
+            }
+        }
+
+        // Post the next data work request without waiting for it; caller holds send_mutex_
+        // Returns its number. At most SEND_RING are in flight, and signaled ones (every SIGNAL_INTERVAL-th and
+        // those the caller asks for) release everything before them, so that bound is always reached again.
+        dp::Res<dp::u64> post_data(ibv_send_wr &wr, bool signaled) {
+            dp::u64 n = posted_ + 1;
+            if (n > SEND_RING) {
+                auto room = wait_completed(n - SEND_RING);
+                if (room.is_err()) {
+                    return dp::result::err(room.error());
+                }
+            }
+            wr.wr_id = n;
+            if (signaled || n % SIGNAL_INTERVAL == 0) {
+                wr.send_flags |= IBV_SEND_SIGNALED;
+            }
+            ibv_send_wr *bad = nullptr;
+            if (ibv_post_send(qp_, &wr, &bad) != 0) {
+                return dp::result::err(fail(verbs_error("send post")).error());
+            }
+            posted_ = n;
+            return dp::result::ok(n);
+        }
+
+        // Tell the peer its next chunk may come; posted without waiting so a receiver never blocks on sends
+        dp::Res<void> post_credit() {
+            ibv_send_wr wr = {};
+            wr.wr_id = CREDIT_WR;
+            wr.opcode = IBV_WR_SEND_WITH_IMM;
+            wr.send_flags = IBV_SEND_SIGNALED;
+            wr.imm_data = htonl(KIND_CREDIT << KIND_SHIFT);
+            ibv_send_wr *bad = nullptr;
+            if (ibv_post_send(qp_, &wr, &bad) != 0) {
+                return fail(verbs_error("credit post"));
+            }
+            std::lock_guard<std::mutex> lock(send_cq_mutex_);
+            return poll_send_locked();
+        }
+
+        // Wait until one of the peer's landing halves is free and take it, reaping receive completions meanwhile
+        dp::Res<void> wait_region() {
+            auto start = std::chrono::steady_clock::now();
+            dp::u32 polls = 0;
+            while (region_credits_.load(std::memory_order_acquire) == 0) {
+                {
+                    std::lock_guard<std::mutex> lock(recv_cq_mutex_);
+                    auto res = poll_recv_locked();
+                    if (res.is_err()) {
+                        return res;
+                    }
+                }
+                if (!connected_) {
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+                keep_waiting(polls, start, -1);
+            }
+            region_credits_.fetch_sub(1, std::memory_order_acq_rel);
+            return dp::result::ok();
+        }
+
+        // Copy length bytes of parts, starting at part / offset, to dst and advance the position
+        static void gather(std::span<const iovec> parts, dp::usize &part, dp::usize &offset, dp::u8 *dst,
+                           dp::usize length) {
+            while (length > 0) {
+                const iovec &current = parts[part];
+                dp::usize take = current.iov_len - offset < length ? current.iov_len - offset : length;
+                std::memcpy(dst, static_cast<const dp::u8 *>(current.iov_base) + offset, take);
+                dst += take;
+                length -= take;
+                offset += take;
+                if (offset == current.iov_len) {
+                    part++;
+                    offset = 0;
+                }
+            }
+        }
+
+      public:
+        explicit RdmaStream(RdmaOptions options = {}) : RdmaStream(std::move(options), std::make_unique<TcpStream>()) {
+            echo::trace("RdmaStream constructed");
+        }
+
+        ~RdmaStream() override { close(); }
+
+        RdmaStream(const RdmaStream &) = delete;
+        RdmaStream &operator=(const RdmaStream &) = delete;
+
+        // Whether an RDMA device is present (the build may have verbs without any hardware)
+        static bool is_supported() {
+            dp::i32 count = 0;
+            ibv_device **devices = ibv_get_device_list(&count);
+            if (devices == nullptr) {
+                return false;
+            }
+            ibv_free_device_list(devices);
+            return count > 0;
+        }
+
+        // Control connection first, then the queue pair is brought up against the peer's
+        dp::Res<void> connect(const TcpEndpoint &endpoint) override {
+            auto res = control_->connect(endpoint);
+            if (res.is_err()) {
+                return res;
+            }
+            res = handshake();
+            if (res.is_err()) {
+                control_->close();
+            }
+            return res;
+        }
+
+        dp::Res<void> listen(const TcpEndpoint &endpoint) override { return control_->listen(endpoint); }
+
+        // Accept a control connection and give the new stream its own queue pair and registered memory
+        dp::Res<std::unique_ptr<Stream>> accept() override {
+            dp::i32 timeout_ms = timeout_ms_.load(std::memory_order_relaxed);
+            if (timeout_ms >= 0 && control_->native_handle() >= 0) {
+                pollfd pending = {control_->native_handle(), POLLIN, 0};
+                if (::poll(&pending, 1, timeout_ms) == 0) {
+                    return dp::result::err(dp::Error::timeout("accept timeout"));
+                }
+            }
+            auto accepted = control_->accept();
+            if (accepted.is_err()) {
+                return dp::result::err(accepted.error());
+            }
+            std::unique_ptr<TcpStream> control(static_cast<TcpStream *>(accepted.value().release()));
+            std::unique_ptr<RdmaStream> stream(new RdmaStream(options_, std::move(control)));
+            auto res = stream->handshake();
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            inherit_stats(*stream);
+            return dp::result::ok(std::unique_ptr<Stream>(std::move(stream)));
+        }
+
+        dp::Res<void> send(const Message &msg) override {
+            iovec part{const_cast<dp::u8 *>(msg.data()), msg.size()};
+            return send_iov(std::span<const iovec>(&part, 1));
+        }
+
+        // Parts are gathered straight into registered memory: one SEND, or one WRITE per landing-half chunk
+        // Returns once the last work request is posted; the data is out of the caller's buffers by then
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            if (!connected_) {
+                echo::trace("send called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+
+            dp::usize total = 0;
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
+            if (total > remote::MAX_MESSAGE_SIZE) {
+                echo::error("message too large: ", total, " > ", remote::MAX_MESSAGE_SIZE);
+                return dp::result::err(dp::Error::invalid_argument("message too large"));
+            }
+
+            dp::usize part = 0;
+            dp::usize offset = 0;
+            if (total <= peer_.slot_size && total <= options_.slot_size) {
+                // The buffer was last used SEND_RING work requests ago; that one has to be done before refilling
+                dp::u8 *buffer = staging_ + static_cast<dp::usize>(posted_ % SEND_RING) * options_.slot_size;
+                if (posted_ >= SEND_RING) {
+                    auto room = wait_completed(posted_ + 1 - SEND_RING);
+                    if (room.is_err()) {
+                        return room;
+                    }
+                }
+                gather(parts, part, offset, buffer, total);
+                ibv_sge sge = {reinterpret_cast<dp::u64>(buffer), static_cast<dp::u32>(total), staging_mr_->lkey};
+                ibv_send_wr wr = {};
+                wr.opcode = IBV_WR_SEND_WITH_IMM;
+                wr.sg_list = &sge;
+                wr.num_sge = total > 0 ? 1 : 0;
+                wr.send_flags = total <= max_inline_ ? IBV_SEND_INLINE : 0;
+                wr.imm_data = htonl(KIND_MESSAGE << KIND_SHIFT);
+                auto res = post_data(wr, false);
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+            } else {
+                // Each chunk has a staging half of ours and a landing half of the peer's, both used in turn, so
+                // one chunk is gathered while the one before it is written and copied out at the other end
+                dp::usize chunk_size = (peer_.region_size < options_.region_size ? peer_.region_size
+                                                                                 : options_.region_size) /
+                                       2;
+                dp::usize remaining = total;
+                while (remaining > 0) {
+                    dp::usize chunk = remaining < chunk_size ? remaining : chunk_size;
+                    dp::u32 half = next_half_;
+                    auto free = wait_completed(half_wr_[half]);
+                    if (free.is_err()) {
+                        return free;
+                    }
+                    dp::u8 *staging = region_staging_ + static_cast<dp::usize>(half) * (options_.region_size / 2);
+                    gather(parts, part, offset, staging, chunk);
+                    auto wait = wait_region();
+                    if (wait.is_err()) {
+                        return wait;
+                    }
+
+                    remaining -= chunk;
+                    dp::u32 kind = remaining > 0 ? KIND_CHUNK : KIND_LAST;
+                    ibv_sge sge = {reinterpret_cast<dp::u64>(staging), static_cast<dp::u32>(chunk),
+                                   region_staging_mr_->lkey};
+                    ibv_send_wr wr = {};
+                    wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+                    wr.sg_list = &sge;
+                    wr.num_sge = 1;
+                    wr.imm_data = htonl((kind << KIND_SHIFT) | static_cast<dp::u32>(chunk));
+                    wr.wr.rdma.remote_addr = peer_.region_addr + static_cast<dp::u64>(half) * (peer_.region_size / 2);
+                    wr.wr.rdma.rkey = peer_.region_rkey;
+                    auto res = post_data(wr, true);
+                    if (res.is_err()) {
+                        return dp::result::err(res.error());
+                    }
+                    half_wr_[half] = res.value();
+                    next_half_ = half ^ 1;
+                }
+            }
+            if (counters_) {
+                counters_->on_send(total);
+            }
+            echo::debug("sent ", total, " bytes");
+            return dp::result::ok();
+        }
+
+        dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        dp::Res<void> recv_into(Message &msg) override {
+            std::lock_guard<std::mutex> lock(recv_mutex_);
+            if (!connected_) {
+                echo::trace("recv called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+
+            while (true) {
+                auto next = next_arrival();
+                if (next.is_err()) {
+                    return dp::result::err(next.error());
+                }
+                Arrival arrival = next.value();
+                dp::u32 kind = arrival.imm >> KIND_SHIFT;
+
+                if (kind == KIND_MESSAGE) {
+                    if (partial_active_) {
+                        return fail(dp::Error::invalid_argument("rdma message inside a chunked one"));
+                    }
+                    const dp::u8 *data = slots_ + static_cast<dp::usize>(arrival.slot) * options_.slot_size;
+                    msg.assign(data, data + arrival.bytes);
+                    auto post = post_recv(arrival.slot);
+                    if (post.is_err()) {
+                        return fail(post.error());
+                    }
+                    break;
+                }
+
+                // A chunk landed in one half of the region: copy it out, then hand that half back
+                dp::usize length = arrival.imm & LENGTH_MASK;
+                if (length > options_.region_size / 2 || partial_.size() + length > remote::MAX_MESSAGE_SIZE) {
+                    return fail(dp::Error::invalid_argument("rdma chunk out of bounds"));
+                }
+                if (!partial_active_) {
+                    partial_.clear();
+                    partial_active_ = true;
+                }
+                const dp::u8 *landed = region_ + static_cast<dp::usize>(recv_half_) * (options_.region_size / 2);
+                recv_half_ ^= 1;
+                partial_.insert(partial_.end(), landed, landed + length);
+                auto post = post_recv(arrival.slot);
+                if (post.is_ok()) {
+                    post = post_credit();
+                }
+                if (post.is_err()) {
+                    return fail(post.error());
+                }
+                if (kind == KIND_LAST) {
+                    std::swap(msg, partial_); // partial_ keeps msg's old storage for the next chunked message
+                    partial_.clear();
+                    partial_active_ = false;
+                    break;
+                }
+            }
+            if (counters_) {
+                counters_->on_recv(msg.size());
+            }
+            echo::debug("received ", msg.size(), " bytes");
+            return dp::result::ok();
+        }
+
+        // Bounds the completion polling of recv(), and accept() on a listener
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
+            timeout_ms_.store(timeout_ms == 0 ? -1 : static_cast<dp::i32>(timeout_ms), std::memory_order_relaxed);
+            echo::debug("recv timeout set to ", timeout_ms, "ms");
+            return dp::result::ok();
+        }
+
+        void close() override {
+            if (qp_ != nullptr) {
+                echo::trace("closing RdmaStream qp=", qp_->qp_num);
+            }
+            release();
+            if (control_) {
+                control_->close();
+            }
+        }
+
+        bool is_connected() const override { return connected_; }
+
+        // Completions are polled on the caller's thread; there is no fd a Reactor could wait on
+        dp::i32 native_handle() const override { return -1; }
+
+        const RdmaOptions &options() const { return options_; }
+
+        // Largest message that goes as a single SEND (agreed with the peer once connected)
+        dp::u32 send_limit() const {
+            if (!connected_) {
+                return 0;
+            }
+            return peer_.slot_size < options_.slot_size ? peer_.slot_size : options_.slot_size;
+        }
+    };
+
+} // namespace netpipe
@@ -0,0 +1,906 @@
+#pragma once
+
+#include <netpipe/datagram/udp.hpp>
+#include <netpipe/stream.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+
+#include <poll.h>
+
+namespace netpipe {
+
+    // How ReliableUdpStream delivers one message
+    enum class Delivery : dp::u8 {
+        Reliable = 0,  // Resent until acked; delivered once and in order within its channel
+        Sequenced = 1, // Sent once; the receiver drops it if a newer message on the channel got there first
+    };
+
+    struct ReliableUdpConfig {
+        dp::u32 initial_rto_ms = 100; // Retransmit timer until the first RTT sample
+        dp::u32 min_rto_ms = 20;
+        dp::u32 max_rto_ms = 2000;
+        dp::u32 max_retransmits = 15; // A packet still unacked after this many resends drops the connection
+        dp::usize window = 1024;      // Reliable packets in flight before send() blocks
+        dp::u32 keepalive_ms = 1000;  // Ping a quiet peer this often
+        dp::u32 idle_timeout_ms = 10000; // Nothing heard from the peer for this long: disconnected
+        dp::u32 connect_timeout_ms = 5000;
+        dp::u32 linger_ms = 1000; // close() waits this long for unacked data to be acked
+        dp::usize max_message_size = 64 * 1024 * 1024; // Larger messages are refused, or dropped on arrival
+        dp::usize recv_buffer = 16 * 1024 * 1024; // Unread message bytes held for recv() before the sender waits
+    };
+
+    // Reliable, ordered message stream over UDP, for links where TCP's single byte stream hurts: one lost
+    // segment there stalls everything queued behind it, and its retransmit timers are not ours to tune.
+    // Messages travel on one of MAX_CHANNELS channels, each with its own sequence space, so a loss only holds
+    // back later messages on the same channel. Receivers ack with the next sequence they expect plus a bitmap
+    // of the 64 packets after it; unacked packets are resent on an RTT-derived timer with exponential backoff,
+    // and a gap below a selectively acked packet is resent without waiting for the timer.
+    // Acks also carry the room left in the receiver's recv_buffer. Once unread messages fill it, the receiver
+    // stops taking new in-order packets and the sender holds further sends until an ack reopens the window;
+    // packets resent meanwhile double as window probes and do not count against max_retransmits.
+    // Sequenced messages skip all of that: sent once, stale ones dropped - for state where only the latest
+    // value matters. Messages larger than MAX_PAYLOAD are fragmented and reassembled (reliable only).
+    //
+    // Packets: [type:1][channel:1][flags:1][0:1][connection:4][seq:4][payload], integers big-endian
+    // ACK payload: [sack bitmap:8][receive window:4]; peers that send only the bitmap are never held off
+    // listen() binds the well-known port and every accepted connection answers from it, so a client behind NAT
+    // only ever talks to the address it dialled. A demultiplexing thread on the listening socket routes packets
+    // to their connection by source address and connection id; new HELLOs queue for accept(). Each connection
+    // has a background thread for its timers, which on the dialling side also receives and acks.
+    // IPv4 only, like UdpDatagram.
+    class ReliableUdpStream : public Stream {
+      public:
+        static constexpr dp::usize MAX_CHANNELS = 16;
+        static constexpr dp::usize HEADER_SIZE = 12;
+        static constexpr dp::usize MAX_PAYLOAD = 1200; // Keeps header + payload inside the IPv6 minimum MTU
+        static constexpr dp::usize MAX_MESSAGE_SIZE = 64 * 1024 * 1024; // Default max_message_size
+
+      private:
+        enum PacketType : dp::u8 { HELLO = 1, HELLO_ACK = 2, DATA = 3, ACK = 4, PING = 5, FIN = 6 };
+        static constexpr dp::u8 FLAG_FIRST = 1;
+        static constexpr dp::u8 FLAG_LAST = 2;
+        static constexpr dp::u8 FLAG_SEQUENCED = 4;
+        static constexpr dp::usize SACK_BITS = 64;
+        static constexpr dp::usize RECV_BATCH = 32;
+        static constexpr dp::usize RECENT_HANDSHAKES = 256;
+        using Clock = std::chrono::steady_clock;
+
+        struct Outgoing {
+            Message packet; // Whole datagram, resent as is
+            dp::u32 seq;
+            Clock::time_point sent_at;
+            dp::u32 transmissions;
+            bool acked;
+        };
+
+        struct SendChannel {
+            dp::u32 next_seq = 0;
+            dp::u32 next_sequenced = 0;
+            std::deque<Outgoing> unacked; // Seq order; selectively acked entries wait for the ones before them
+        };
+
+        struct RecvChannel {
+            dp::u32 next_expected = 0;
+            std::map<dp::u32, Message> early; // Reliable packets that arrived past a gap
+            Message partial;                  // Fragments of the message being reassembled
+            bool dropping = false;            // Skipping the rest of an oversized message
+            bool ack_due = false;
+            bool sequenced_seen = false;
+            dp::u32 last_sequenced = 0;
+        };
+
+        // The listening socket, shared by the listener and the connections it accepted; closed with the last
+        struct Demux {
+            UdpDatagram socket;
+            std::mutex mutex; // Taken before a connection's mutex_
+            std::map<std::pair<dp::u64, dp::u32>, ReliableUdpStream *> routes; // (address, connection)
+            std::deque<std::pair<UdpAddress, dp::u32>> hellos; // New HELLOs waiting for accept()
+            std::deque<dp::u32> recent_handshakes;             // Connections already queued or handed out
+            std::condition_variable hello_cv;
+            bool accepting = true;
+            std::atomic<bool> stopping{false};
+            std::thread thread;
+
+            ~Demux() {
+                stopping = true;
+                if (thread.joinable()) {
+                    thread.join();
+                }
+                socket.close();
+            }
+
+            static std::pair<dp::u64, dp::u32> key(const UdpAddress &address, dp::u32 connection) {
+                return {(static_cast<dp::u64>(address.addr.sin_addr.s_addr) << 16) | address.addr.sin_port,
+                        connection};
+            }
+
+            void run() {
+                dp::Vector<Message> packets(RECV_BATCH);
+                dp::Vector<UdpAddress> sources(RECV_BATCH);
+                dp::Vector<ReliableUdpStream *> touched;
+                while (!stopping.load(std::memory_order_acquire)) {
+                    struct pollfd pfd = {socket.native_handle(), POLLIN, 0};
+                    if (::poll(&pfd, 1, 50) <= 0 || !(pfd.revents & POLLIN)) {
+                        continue;
+                    }
+                    auto res = socket.recv_batch(std::span<Message>(packets.data(), packets.size()),
+                                                 std::span<UdpAddress>(sources.data(), sources.size()));
+                    if (res.is_err()) {
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto now = Clock::now();
+                    touched.clear();
+                    for (dp::usize i = 0; i < res.value(); i++) {
+                        if (packets[i].size() < HEADER_SIZE) {
+                            continue;
+                        }
+                        dp::u32 id = decode_u32_be(packets[i].data() + 4);
+                        auto route = routes.find(key(sources[i], id));
+                        if (route != routes.end()) {
+                            std::lock_guard<std::mutex> conn_lock(route->second->mutex_);
+                            route->second->handle_packet(packets[i], sources[i], now);
+                            if (std::find(touched.begin(), touched.end(), route->second) == touched.end()) {
+                                touched.push_back(route->second);
+                            }
+                        } else if (packets[i][0] == HELLO && accepting && hellos.size() < RECENT_HANDSHAKES &&
+                                   std::find(recent_handshakes.begin(), recent_handshakes.end(), id) ==
+                                       recent_handshakes.end()) {
+                            recent_handshakes.push_back(id);
+                            if (recent_handshakes.size() > RECENT_HANDSHAKES) {
+                                recent_handshakes.pop_front();
+                            }
+                            hellos.emplace_back(sources[i], id);
+                            hello_cv.notify_one();
+                        }
+                    }
+                    for (auto *conn : touched) {
+                        std::lock_guard<std::mutex> conn_lock(conn->mutex_);
+                        conn->send_acks();
+                    }
+                }
+            }
+        };
+
+        ReliableUdpConfig config_;
+        UdpDatagram socket_; // Dialling side; accepted connections and the listener use demux_->socket
+        std::shared_ptr<Demux> demux_;
+        UdpAddress peer_;
+        dp::u32 connection_;
+        std::atomic<bool> listening_;
+        std::atomic<bool> connected_;
+        std::atomic<bool> stopping_;
+        std::thread io_thread_;
+        std::condition_variable timer_cv_; // Wakes an accepted connection's timer thread on close
+
+        mutable std::mutex mutex_; // Guards the connection state below
+        std::condition_variable recv_cv_;
+        std::condition_variable send_cv_;
+        std::array<SendChannel, MAX_CHANNELS> send_;
+        std::array<RecvChannel, MAX_CHANNELS> recv_;
+        std::deque<std::pair<dp::u8, Message>> delivered_;
+        dp::usize delivered_bytes_; // Message bytes in delivered_, against config_.recv_buffer
+        bool window_closed_;        // An ack said the window is shut; a PING is answered with an update
+        dp::u32 peer_window_;       // Room the peer last advertised; 0 holds reliable sends back
+        dp::usize in_flight_;
+        dp::u32 recv_timeout_ms_;
+        bool handshaking_; // Accepted side: HELLO_ACK is resent until the client's first packet arrives
+        double srtt_ms_;   // 0 until the first sample
+        double rttvar_ms_;
+        dp::u32 rto_ms_;
+        Clock::time_point last_heard_;
+        Clock::time_point last_sent_;
+        Clock::time_point last_hello_;
+        dp::u64 retransmits_;
+        dp::u64 stale_dropped_;
+        std::array<std::mutex, MAX_CHANNELS> channel_mutex_; // Fragments of one message get consecutive seqs
+
+        // Accepted side of a handshake: the listener's socket, peer and connection id already known
+        ReliableUdpStream(const ReliableUdpConfig &config, std::shared_ptr<Demux> demux, const UdpAddress &peer,
+                          dp::u32 connection)
+            : ReliableUdpStream(config) {
+            demux_ = std::move(demux);
+            peer_ = peer;
+            connection_ = connection;
+        }
+
+        static bool seq_before(dp::u32 a, dp::u32 b) { return static_cast<dp::i32>(a - b) < 0; }
+
+        static dp::u32 random_connection_id() {
+            std::random_device device;
+            dp::u32 id = device();
+            return id == 0 ? 1 : id;
+        }
+
+        static bool same_address(const UdpAddress &a, const UdpAddress &b) {
+            return a.addr.sin_addr.s_addr == b.addr.sin_addr.s_addr && a.addr.sin_port == b.addr.sin_port;
+        }
+
+        Message make_packet(dp::u8 type, dp::u8 channel, dp::u8 flags, dp::u32 seq, const dp::u8 *payload,
+                            dp::usize length) const {
+            Message packet(HEADER_SIZE + length);
+            packet[0] = type;
+            packet[1] = channel;
+            packet[2] = flags;
+            packet[3] = 0;
+            auto connection = encode_u32_be(connection_);
+            auto seq_bytes = encode_u32_be(seq);
+            std::memcpy(packet.data() + 4, connection.data(), 4);
+            std::memcpy(packet.data() + 8, seq_bytes.data(), 4);
+            if (length > 0) {
+                std::memcpy(packet.data() + HEADER_SIZE, payload, length);
+            }
+            return packet;
+        }
+
+        // Send errors are not reported: a dropped datagram is what the retransmit timer is for
+        void transmit(const Message &packet, const UdpAddress &dest) {
+            (void)(demux_ ? demux_->socket : socket_).send_to(packet, dest);
+            last_sent_ = Clock::now();
+        }
+
+        void transmit_control(dp::u8 type) { transmit(make_packet(type, 0, 0, 0, nullptr, 0), peer_); }
+
+        dp::u32 packet_rto(const Outgoing &out) const {
+            dp::u64 rto = static_cast<dp::u64>(rto_ms_) << (out.transmissions > 16 ? 16 : out.transmissions - 1);
+            return rto > config_.max_rto_ms ? config_.max_rto_ms : static_cast<dp::u32>(rto);
+        }
+
+        void rtt_sample(double sample_ms) {
+            if (srtt_ms_ == 0.0) {
+                srtt_ms_ = sample_ms;
+                rttvar_ms_ = sample_ms / 2;
+            } else {
+                double delta = srtt_ms_ > sample_ms ? srtt_ms_ - sample_ms : sample_ms - srtt_ms_;
+                rttvar_ms_ = 0.75 * rttvar_ms_ + 0.25 * delta;
+                srtt_ms_ = 0.875 * srtt_ms_ + 0.125 * sample_ms;
+            }
+            double rto = srtt_ms_ + 4 * rttvar_ms_;
+            rto = rto < config_.min_rto_ms ? config_.min_rto_ms : rto;
+            rto = rto > config_.max_rto_ms ? config_.max_rto_ms : rto;
+            rto_ms_ = static_cast<dp::u32>(rto);
+        }
+
+        void disconnect_locked(const char *reason) {
+            if (connected_.exchange(false)) {
+                echo::debug("reliable udp connection ", connection_, " lost: ", reason);
+            }
+            recv_cv_.notify_all();
+            send_cv_.notify_all();
+        }
+
+        // Caller holds mutex_
+        void deliver(dp::u8 channel, Message &&msg) {
+            delivered_bytes_ += msg.size();
+            delivered_.emplace_back(channel, std::move(msg));
+            recv_cv_.notify_one();
+        }
+
+        bool recv_window_full() const { return delivered_bytes_ >= config_.recv_buffer; }
+
+        dp::u32 recv_window() const {
+            dp::usize room = recv_window_full() ? 0 : config_.recv_buffer - delivered_bytes_;
+            return room > 0xFFFFFFFFu ? 0xFFFFFFFFu : static_cast<dp::u32>(room);
+        }
+
+        // Caller holds mutex_; packet is a whole DATA datagram
+        void deliver_fragment(dp::u8 channel, RecvChannel &rc, const Message &packet) {
+            dp::u8 flags = packet[2];
+            if (flags & FLAG_FIRST) {
+                rc.partial.clear();
+                rc.dropping = false;
+            }
+            if ((flags & FLAG_FIRST) && (flags & FLAG_LAST)) {
+                if (packet.size() - HEADER_SIZE <= config_.max_message_size) {
+                    deliver(channel, Message(packet.begin() + HEADER_SIZE, packet.end()));
+                }
+                return;
+            }
+            if (rc.dropping) {
+                rc.dropping = !(flags & FLAG_LAST);
+                return;
+            }
+            if (rc.partial.size() + packet.size() - HEADER_SIZE > config_.max_message_size) {
+                echo::warn("reliable udp message over ", config_.max_message_size, " bytes dropped");
+                rc.partial = Message();
+                rc.dropping = !(flags & FLAG_LAST); // Its remaining fragments are not a message of their own
+                return;
+            }
+            rc.partial.insert(rc.partial.end(), packet.begin() + HEADER_SIZE, packet.end());
+            if (flags & FLAG_LAST) {
+                deliver(channel, std::move(rc.partial));
+                rc.partial = Message();
+            }
+        }
+
+        void on_data(dp::u8 channel, dp::u32 seq, Message &packet) {
+            RecvChannel &rc = recv_[channel];
+            if (packet[2] & FLAG_SEQUENCED) {
+                if (rc.sequenced_seen && !seq_before(rc.last_sequenced, seq)) {
+                    stale_dropped_++;
+                    return;
+                }
+                if (recv_window_full()) {
+                    return; // Never resent, so the newer value that follows replaces it anyway
+                }
+                rc.sequenced_seen = true;
+                rc.last_sequenced = seq;
+                deliver(channel, Message(packet.begin() + HEADER_SIZE, packet.end()));
+                return;
+            }
+
+            rc.ack_due = true;
+            if (seq_before(seq, rc.next_expected)) {
+                return; // Duplicate - the ack still goes out, ours may have been lost
+            }
+            if (seq != rc.next_expected) {
+                if (seq - rc.next_expected < config_.window && rc.early.find(seq) == rc.early.end()) {
+                    rc.early.emplace(seq, std::move(packet));
+                }
+                return;
+            }
+            if (recv_window_full()) {
+                return; // Left unacked: the sender resends it once recv() has made room
+            }
+            window_closed_ = false; // The sender heard the window open again
+
+            deliver_fragment(channel, rc, packet);
+            rc.next_expected++;
+            for (auto it = rc.early.find(rc.next_expected); it != rc.early.end();
+                 it = rc.early.find(rc.next_expected)) {
+                deliver_fragment(channel, rc, it->second);
+                rc.early.erase(it);
+                rc.next_expected++;
+            }
+        }
+
+        void on_ack(dp::u8 channel, dp::u32 cumulative, const Message &packet, Clock::time_point now) {
+            if (packet.size() < HEADER_SIZE + 8) {
+                return;
+            }
+            dp::u64 bitmap = (static_cast<dp::u64>(decode_u32_be(packet.data() + HEADER_SIZE)) << 32) |
+                             decode_u32_be(packet.data() + HEADER_SIZE + 4);
+            bool reopened = false;
+            if (packet.size() >= HEADER_SIZE + 12) {
+                dp::u32 window = decode_u32_be(packet.data() + HEADER_SIZE + 8);
+                reopened = peer_window_ == 0 && window > 0;
+                peer_window_ = window;
+            }
+
+            SendChannel &sc = send_[channel];
+            bool highest_set = false;
+            dp::u32 highest = 0; // Past the newest packet the peer has
+            for (auto &out : sc.unacked) {
+                bool acked = seq_before(out.seq, cumulative);
+                if (!acked && out.seq != cumulative) {
+                    dp::u32 bit = out.seq - cumulative - 1;
+                    acked = bit < SACK_BITS && ((bitmap >> bit) & 1);
+                }
+                if (!acked) {
+                    continue;
+                }
+                if (!out.acked) {
+                    out.acked = true;
+                    in_flight_--;
+                    if (out.transmissions == 1) { // Karn: a resent packet's ack says nothing about the RTT
+                        rtt_sample(std::chrono::duration<double, std::milli>(now - out.sent_at).count());
+                    }
+                }
+                highest = out.seq + 1;
+                highest_set = true;
+            }
+            while (!sc.unacked.empty() && sc.unacked.front().acked) {
+                sc.unacked.pop_front();
+            }
+
+            // Holes below a selectively acked packet were lost, or are about to be - resend them once per RTT
+            if (highest_set) {
+                auto min_age = std::chrono::duration<double, std::milli>(srtt_ms_ > 0 ? srtt_ms_ : rto_ms_);
+                for (auto &out : sc.unacked) {
+                    if (!seq_before(out.seq, highest)) {
+                        break;
+                    }
+                    if (!out.acked && now - out.sent_at >= min_age) {
+                        transmit(out.packet, peer_);
+                        out.sent_at = now;
+                        out.transmissions++;
+                        retransmits_++;
+                    }
+                }
+            }
+            // Packets the peer turned away while it was full would otherwise wait out their backed-off timers
+            if (reopened) {
+                for (auto &other : send_) {
+                    for (auto &out : other.unacked) {
+                        if (!out.acked) {
+                            transmit(out.packet, peer_);
+                            out.sent_at = now;
+                            out.transmissions++;
+                            retransmits_++;
+                        }
+                    }
+                }
+            }
+            send_cv_.notify_all();
+        }
+
+        void handle_packet(Message &packet, const UdpAddress &source, Clock::time_point now) {
+            if (packet.size() < HEADER_SIZE || decode_u32_be(packet.data() + 4) != connection_ ||
+                !same_address(source, peer_)) {
+                return;
+            }
+            dp::u8 type = packet[0];
+            dp::u8 channel = packet[1];
+            dp::u32 seq = decode_u32_be(packet.data() + 8);
+            last_heard_ = now;
+            if (type != HELLO_ACK && type != HELLO) {
+                handshaking_ = false;
+            }
+
+            switch (type) {
+            case HELLO:
+                if (handshaking_) {
+                    transmit_control(HELLO_ACK); // Resent by a client that has not heard us yet
+                    last_hello_ = now;
+                }
+                break;
+            case DATA:
+                if (channel < MAX_CHANNELS) {
+                    on_data(channel, seq, packet);
+                }
+                break;
+            case ACK:
+                if (channel < MAX_CHANNELS) {
+                    on_ack(channel, seq, packet, now);
+                }
+                break;
+            case HELLO_ACK:
+                transmit_control(PING); // Our confirmation was lost; the accepted side is still waiting for it
+                break;
+            case PING:
+                if (window_closed_ && !recv_window_full()) {
+                    recv_[0].ack_due = true; // The update that reopened the window may have been lost
+                }
+                break;
+            case FIN:
+                disconnect_locked("closed by peer");
+                break;
+            default:
+                break;
+            }
+        }
+
+        void send_acks() {
+            for (dp::usize channel = 0; channel < MAX_CHANNELS; channel++) {
+                RecvChannel &rc = recv_[channel];
+                if (!rc.ack_due) {
+                    continue;
+                }
+                rc.ack_due = false;
+                dp::u64 bitmap = 0;
+                if (!rc.early.empty()) {
+                    for (dp::usize bit = 0; bit < SACK_BITS; bit++) {
+                        if (rc.early.count(rc.next_expected + 1 + static_cast<dp::u32>(bit))) {
+                            bitmap |= dp::u64(1) << bit;
+                        }
+                    }
+                }
+                dp::u8 body[12];
+                auto high = encode_u32_be(static_cast<dp::u32>(bitmap >> 32));
+                auto low = encode_u32_be(static_cast<dp::u32>(bitmap));
+                auto window = encode_u32_be(recv_window());
+                std::memcpy(body, high.data(), 4);
+                std::memcpy(body + 4, low.data(), 4);
+                std::memcpy(body + 8, window.data(), 4);
+                if (recv_window_full()) {
+                    window_closed_ = true;
+                }
+                transmit(make_packet(ACK, static_cast<dp::u8>(channel), 0, rc.next_expected, body, sizeof(body)),
+                         peer_);
+            }
+        }
+
+        // Resends, keepalive and idle detection; returns how long the I/O thread may sleep
+        dp::u32 run_timers(Clock::time_point now) {
+            using std::chrono::milliseconds;
+            dp::u32 wait_ms = config_.keepalive_ms;
+            auto until = [&](Clock::time_point deadline) {
+                auto ms = std::chrono::duration_cast<milliseconds>(deadline - now).count();
+                if (ms < static_cast<dp::i64>(wait_ms)) {
+                    wait_ms = ms < 1 ? 1 : static_cast<dp::u32>(ms);
+                }
+            };
+
+            for (auto &sc : send_) {
+                for (auto &out : sc.unacked) {
+                    if (out.acked) {
+                        continue;
+                    }
+                    auto deadline = out.sent_at + milliseconds(packet_rto(out));
+                    if (now >= deadline) {
+                        // A full peer still acks every resend; only idle_timeout_ms gives up on it
+                        if (out.transmissions > config_.max_retransmits && peer_window_ > 0) {
+                            disconnect_locked("retransmit limit reached");
+                            return wait_ms;
+                        }
+                        transmit(out.packet, peer_);
+                        out.sent_at = now;
+                        out.transmissions++;
+                        retransmits_++;
+                        deadline = now + milliseconds(packet_rto(out));
+                    }
+                    until(deadline);
+                }
+            }
+
+            if (handshaking_) {
+                if (now - last_hello_ >= milliseconds(config_.initial_rto_ms)) {
+                    transmit_control(HELLO_ACK);
+                    last_hello_ = now;
+                }
+                until(last_hello_ + milliseconds(config_.initial_rto_ms));
+            }
+            if (now - last_sent_ >= milliseconds(config_.keepalive_ms)) {
+                transmit_control(PING);
+            }
+            until(last_sent_ + milliseconds(config_.keepalive_ms));
+            if (now - last_heard_ >= milliseconds(config_.idle_timeout_ms)) {
+                disconnect_locked("peer idle");
+            }
+            until(last_heard_ + milliseconds(config_.idle_timeout_ms));
+            return wait_ms;
+        }
+
+        void io_loop() {
+            dp::Vector<Message> packets(RECV_BATCH);
+            dp::Vector<UdpAddress> sources(RECV_BATCH);
+            dp::u32 wait_ms = 1;
+            while (!stopping_.load(std::memory_order_acquire)) {
+                if (demux_) { // Packets arrive through Demux::run(); only the timers run here
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    timer_cv_.wait_for(lock, std::chrono::milliseconds(wait_ms < 50 ? wait_ms : 50),
+                                       [&] { return stopping_.load(std::memory_order_acquire); });
+                    if (connected_) {
+                        wait_ms = run_timers(Clock::now());
+                    }
+                    continue;
+                }
+                struct pollfd pfd = {socket_.native_handle(), POLLIN, 0};
+                dp::i32 ready = ::poll(&pfd, 1, static_cast<dp::i32>(wait_ms < 50 ? wait_ms : 50));
+                dp::usize count = 0;
+                if (ready > 0 && (pfd.revents & POLLIN)) {
+                    auto res = socket_.recv_batch(std::span<Message>(packets.data(), packets.size()),
+                                                  std::span<UdpAddress>(sources.data(), sources.size()));
+                    if (res.is_ok()) {
+                        count = res.value();
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto now = Clock::now();
+                for (dp::usize i = 0; i < count; i++) {
+                    handle_packet(packets[i], sources[i], now);
+                }
+                send_acks();
+                if (connected_) {
+                    wait_ms = run_timers(now);
+                }
+            }
+        }
+
+        void start_io() {
+            auto now = Clock::now();
+            last_heard_ = now;
+            last_sent_ = now;
+            connected_ = true;
+            stopping_ = false;
+            io_thread_ = std::thread([this]() { io_loop(); });
+        }
+
+        void stop_io() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            timer_cv_.notify_all();
+            if (io_thread_.joinable()) {
+                io_thread_.join();
+            }
+        }
+
+      public:
+        ReliableUdpStream() : ReliableUdpStream(ReliableUdpConfig{}) {}
+
+        explicit ReliableUdpStream(const ReliableUdpConfig &config)
+            : config_(config), connection_(0), listening_(false), connected_(false), stopping_(false),
+              delivered_bytes_(0), window_closed_(false), peer_window_(0xFFFFFFFFu), in_flight_(0),
+              recv_timeout_ms_(0), handshaking_(false), srtt_ms_(0.0), rttvar_ms_(0.0), rto_ms_(config.initial_rto_ms),
+              retransmits_(0), stale_dropped_(0) {
+            echo::trace("ReliableUdpStream constructed");
+        }
+
+        ~ReliableUdpStream() override { close(); }
+
+        ReliableUdpStream(const ReliableUdpStream &) = delete;
+        ReliableUdpStream &operator=(const ReliableUdpStream &) = delete;
+
+        // Handshake with a listening ReliableUdpStream; HELLO is resent every initial_rto_ms until answered
+        // Fails with a timeout after connect_timeout_ms
+        dp::Res<void> connect(const TcpEndpoint &endpoint) override {
+            echo::trace("reliable udp connecting to ", endpoint.to_string());
+            if (connected_ || listening_) {
+                return dp::result::err(dp::Error::invalid_argument("already in use"));
+            }
+            auto target = UdpDatagram::resolve(UdpEndpoint{endpoint.host, endpoint.port});
+            if (target.is_err()) {
+                return dp::result::err(target.error());
+            }
+            auto bind_res = socket_.bind(UdpEndpoint{"0.0.0.0", 0});
+            if (bind_res.is_err()) {
+                return bind_res;
+            }
+            connection_ = random_connection_id();
+
+            Message hello = make_packet(HELLO, 0, 0, 0, nullptr, 0);
+            dp::Vector<Message> packets(RECV_BATCH);
+            dp::Vector<UdpAddress> sources(RECV_BATCH);
+            auto deadline = Clock::now() + std::chrono::milliseconds(config_.connect_timeout_ms);
+            while (Clock::now() < deadline) {
+                transmit(hello, target.value());
+                struct pollfd pfd = {socket_.native_handle(), POLLIN, 0};
+                if (::poll(&pfd, 1, static_cast<dp::i32>(config_.initial_rto_ms)) <= 0) {
+                    continue;
+                }
+                auto res = socket_.recv_batch(std::span<Message>(packets.data(), packets.size()),
+                                              std::span<UdpAddress>(sources.data(), sources.size()));
+                if (res.is_err()) {
+                    continue;
+                }
+                for (dp::usize i = 0; i < res.value(); i++) {
+                    const Message &packet = packets[i];
+                    if (packet.size() >= HEADER_SIZE && packet[0] == HELLO_ACK &&
+                        decode_u32_be(packet.data() + 4) == connection_) {
+                        peer_ = sources[i]; // The accepted side's own port, not the listener's
+                        start_io();
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        transmit_control(PING);
+                        echo::debug("reliable udp connected to ", peer_.to_endpoint().to_string(), " id=",
+                                    connection_);
+                        return dp::result::ok();
+                    }
+                }
+            }
+            socket_.close();
+            echo::error("reliable udp connect to ", endpoint.to_string(), " timed out");
+            return dp::result::err(dp::Error::timeout("connect timeout"));
+        }
+
+        dp::Res<void> listen(const TcpEndpoint &endpoint) override {
+            echo::trace("reliable udp listening on ", endpoint.to_string());
+            if (connected_ || listening_) {
+                return dp::result::err(dp::Error::invalid_argument("already in use"));
+            }
+            auto demux = std::make_shared<Demux>();
+            auto res = demux->socket.bind(UdpEndpoint{endpoint.host, endpoint.port});
+            if (res.is_err()) {
+                return res;
+            }
+            Demux *raw = demux.get();
+            demux->thread = std::thread([raw]() { raw->run(); });
+            demux_ = std::move(demux);
+            listening_ = true;
+            return dp::result::ok();
+        }
+
+        // Wait for a HELLO from a client not handed out yet and open its connection on the listening socket
+        dp::Res<std::unique_ptr<Stream>> accept() override {
+            auto demux = listening_ ? demux_ : nullptr;
+            if (!demux) {
+                return dp::result::err(dp::Error::invalid_argument("not listening"));
+            }
+            std::unique_lock<std::mutex> lock(demux->mutex);
+            while (listening_) {
+                // Short waits so close() from another thread ends the loop
+                if (!demux->hello_cv.wait_for(lock, std::chrono::milliseconds(100),
+                                              [&] { return !demux->hellos.empty() || !listening_; }) ||
+                    demux->hellos.empty()) {
+                    continue;
+                }
+                auto [source, id] = demux->hellos.front();
+                demux->hellos.pop_front();
+
+                std::unique_ptr<ReliableUdpStream> stream(new ReliableUdpStream(config_, demux, source, id));
+                stream->handshaking_ = true;
+                stream->start_io(); // First timer run sends the HELLO_ACK
+                demux->routes[Demux::key(source, id)] = stream.get();
+                echo::debug("reliable udp accepted ", source.to_endpoint().to_string(), " id=", id);
+                return dp::result::ok(std::unique_ptr<Stream>(std::move(stream)));
+            }
+            return dp::result::err(dp::Error::not_found("listener closed"));
+        }
+
+        // Reliable message on channel 0
+        dp::Res<void> send(const Message &msg) override { return send_on(0, msg, Delivery::Reliable); }
+
+        // Send msg on channel; reliable sends block while window packets are unacked or the peer's receive
+        // buffer is full
+        // Sequenced messages must fit in one packet (MAX_PAYLOAD)
+        dp::Res<void> send_on(dp::u8 channel, const Message &msg, Delivery delivery = Delivery::Reliable) {
+            if (channel >= MAX_CHANNELS) {
+                return dp::result::err(dp::Error::invalid_argument("channel out of range"));
+            }
+            if (msg.size() > config_.max_message_size ||
+                (delivery == Delivery::Sequenced && msg.size() > MAX_PAYLOAD)) {
+                echo::error("reliable udp message too large: ", msg.size(), " bytes");
+                return dp::result::err(dp::Error::invalid_argument("message too large"));
+            }
+
+            if (delivery == Delivery::Sequenced) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!connected_) {
+                    return dp::result::err(dp::Error::not_found("not connected"));
+                }
+                dp::u32 seq = send_[channel].next_sequenced++;
+                transmit(make_packet(DATA, channel, FLAG_FIRST | FLAG_LAST | FLAG_SEQUENCED, seq, msg.data(),
+                                     msg.size()),
+                         peer_);
+                return dp::result::ok();
+            }
+
+            std::lock_guard<std::mutex> channel_lock(channel_mutex_[channel]);
+            dp::usize pieces = msg.empty() ? 1 : (msg.size() + MAX_PAYLOAD - 1) / MAX_PAYLOAD;
+            for (dp::usize piece = 0; piece < pieces; piece++) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                send_cv_.wait(lock,
+                              [&] { return !connected_ || (in_flight_ < config_.window && peer_window_ > 0); });
+                if (!connected_) {
+                    return dp::result::err(dp::Error::not_found("not connected"));
+                }
+                dp::usize offset = piece * MAX_PAYLOAD;
+                dp::usize length = msg.size() - offset < MAX_PAYLOAD ? msg.size() - offset : MAX_PAYLOAD;
+                dp::u8 flags = (piece == 0 ? FLAG_FIRST : 0) | (piece + 1 == pieces ? FLAG_LAST : 0);
+                SendChannel &sc = send_[channel];
+                dp::u32 seq = sc.next_seq++;
+                Outgoing out{make_packet(DATA, channel, flags, seq, msg.data() + offset, length), seq, Clock::now(),
+                             1, false};
+                transmit(out.packet, peer_);
+                sc.unacked.push_back(std::move(out));
+                if (in_flight_++ == 0) {
+                    timer_cv_.notify_one(); // An idle accepted connection's timers may be asleep for 50 ms
+                }
+            }
+            return dp::result::ok();
+        }
+
+        dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        dp::Res<void> recv_into(Message &msg) override {
+            auto res = recv_channel(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok();
+        }
+
+        // Next message from any channel, in arrival order across channels; returns the channel it came on
+        // Messages that arrived before the connection dropped are still returned
+        dp::Res<dp::u8> recv_channel(Message &msg) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready = [&] { return !delivered_.empty() || !connected_; };
+            if (recv_timeout_ms_ == 0) {
+                recv_cv_.wait(lock, ready);
+            } else if (!recv_cv_.wait_for(lock, std::chrono::milliseconds(recv_timeout_ms_), ready)) {
+                return dp::result::err(dp::Error::timeout("recv timeout"));
+            }
+            if (delivered_.empty()) {
+                return dp::result::err(dp::Error::not_found("connection closed"));
+            }
+            dp::u8 channel = delivered_.front().first;
+            msg = std::move(delivered_.front().second);
+            delivered_.pop_front();
+            delivered_bytes_ -= msg.size();
+            if (window_closed_ && !recv_window_full()) {
+                recv_[0].ack_due = true; // Tell the sender there is room again
+                send_acks();
+            }
+            return dp::result::ok(channel);
+        }
+
+        bool has_pending_input() const override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return !delivered_.empty();
+        }
+
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            recv_timeout_ms_ = timeout_ms;
+            return dp::result::ok();
+        }
+
+        // Wait until every reliable packet sent so far is acked
+        dp::Res<void> flush(dp::u32 timeout_ms) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool done = send_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                          [&] { return !connected_ || in_flight_ == 0; });
+            if (in_flight_ == 0) {
+                return dp::result::ok();
+            }
+            if (!done) {
+                return dp::result::err(dp::Error::timeout("flush timeout"));
+            }
+            return dp::result::err(dp::Error::not_found("not connected"));
+        }
+
+        // Waits up to linger_ms for unacked data, then tells the peer with FIN
+        void close() override {
+            if (listening_.exchange(false)) {
+                std::lock_guard<std::mutex> lock(demux_->mutex);
+                demux_->accepting = false;
+                demux_->hellos.clear();
+                demux_->hello_cv.notify_all();
+            }
+            if (io_thread_.joinable()) {
+                if (connected_) {
+                    (void)flush(config_.linger_ms);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    transmit_control(FIN);
+                    transmit_control(FIN); // No ack for FIN; a second copy covers a single loss
+                    disconnect_locked("closed");
+                }
+                stop_io();
+            }
+            if (demux_) {
+                std::lock_guard<std::mutex> lock(demux_->mutex);
+                demux_->routes.erase(Demux::key(peer_, connection_));
+            }
+            demux_.reset(); // The last owner closes the listening socket
+            connected_ = false;
+            socket_.close();
+        }
+
+        bool is_connected() const override { return connected_; }
+
+        // Packets resent after a timeout or a selective-ack gap
+        dp::u64 retransmit_count() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return retransmits_;
+        }
+
+        // Sequenced messages dropped because a newer one had already arrived
+        dp::u64 stale_dropped_count() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stale_dropped_;
+        }
+
+        // Smoothed round-trip time, 0 before the first ack
+        double srtt_ms() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return srtt_ms_;
+        }
+
+        // Reliable packets sent and not yet acked
+        dp::usize in_flight() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return in_flight_;
+        }
+    };
+
+} // namespace netpipe
@@ -1,17 +1,26 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <cstring>
-#include <datapod/pods/lockfree/ring_buffer.hpp>
 #include <fcntl.h>
 #include <mutex>
 #include <netpipe/remote/protocol.hpp>
 #include <netpipe/stream.hpp>
+#include <span>
+#include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <thread>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 namespace netpipe {
 
     /// Connection request structure for SHM handshake
@@ -29,20 +38,84 @@ namespace netpipe {
         dp::u32 reserved;
     };
 
-    /// Fast shared memory message buffer header
-    /// Uses bulk memcpy instead of byte-by-byte operations
-    struct alignas(64) ShmMsgHeader {
-        std::atomic<dp::u64> msg_size;  // Size of current message (0 = no message)
-        std::atomic<dp::u32> msg_ready; // 1 = message ready to read, 0 = buffer free
-        dp::u32 capacity;               // Max message size
-        dp::u8 padding[48];             // Pad to cache line
+    /// One connect in progress: the client fills request, the listener answers in response
+    /// state walks FREE -> CLAIMED -> REQUEST -> SERVING -> RESPONSE -> FREE; the client owns the slot
+    /// except while it is SERVING. A client that gives up on a SERVING slot marks it ABANDONED and the
+    /// listener frees it (and the rings it made) instead of answering.
+    struct alignas(64) ShmHandshakeSlot {
+        static constexpr dp::u32 FREE = 0;
+        static constexpr dp::u32 CLAIMED = 1;
+        static constexpr dp::u32 REQUEST = 2;
+        static constexpr dp::u32 SERVING = 3;
+        static constexpr dp::u32 RESPONSE = 4;
+        static constexpr dp::u32 ABANDONED = 5;
+
+        std::atomic<dp::u32> state;
+        std::atomic<dp::u32> response_seq; // Futex the client parks on until RESPONSE
+        std::atomic<dp::u32> response_waiters;
+        dp::u32 reserved;
+        ShmConnRequest request;
+        ShmConnResponse response;
+    };
+
+    /// Shared region "/<name>_hs" a listener creates; all-zero is a valid empty state
+    struct ShmHandshakeRegion {
+        static constexpr dp::usize SLOTS = 64; // Connects that can be in flight at once
+
+        alignas(64) std::atomic<dp::u32> pending; // Slots in REQUEST state
+        std::atomic<dp::u32> request_seq;         // Futex the listener parks on in accept()
+        std::atomic<dp::u32> request_waiters;
+        ShmHandshakeSlot slots[SLOTS];
+    };
+
+    /// Shared memory SPSC ring header
+    /// head/tail are monotonically increasing byte cursors on separate cache lines so the
+    /// producer and consumer never write to the same line
+    /// The *_seq words are futexes bumped after progress when the other side has parked
+    /// closed is raised by whichever side closes first; the producer also holds flock() on the ring
+    /// file from connect/accept on, so a consumer can tell a crashed producer from a quiet one
+    struct ShmRingHeader {
+        alignas(64) std::atomic<dp::u64> head; // Producer cursor (bytes written)
+        alignas(64) std::atomic<dp::u64> tail; // Consumer cursor (bytes consumed)
+        alignas(64) std::atomic<dp::u32> data_seq;
+        std::atomic<dp::u32> data_waiters; // Consumers parked waiting for data
+        alignas(64) std::atomic<dp::u32> space_seq;
+        std::atomic<dp::u32> space_waiters; // Producers parked waiting for space
+        alignas(64) dp::u64 ring_size;      // Size of the data region in bytes
+        dp::u32 capacity;                      // Max message size
+        std::atomic<dp::u32> closed;           // Either side hung up
+        std::atomic<dp::u32> producer_attached; // Producer holds its flock() from here on
     };
 
+    static_assert(sizeof(std::atomic<dp::u32>) == sizeof(dp::u32) && std::atomic<dp::u32>::is_always_lock_free,
+                  "futex words must be plain lock-free 32-bit integers");
+
+    /// Length prefix of every record in the ring
+    /// Records are [ShmRecordHeader][payload], padded to 8 bytes
+    /// A message larger than the ring travels as a LARGE_BEGIN record holding its u64 total length, then
+    /// LARGE_CHUNK records with the bytes in order; the receiver consumes each chunk as it copies it out
+    struct ShmRecordHeader {
+        static constexpr dp::u32 LARGE_BEGIN = 1;
+        static constexpr dp::u32 LARGE_CHUNK = 2;
+
+        dp::u32 length;
+        dp::u32 flags;
+    };
+
+    class ShmPublisher;
+    class ShmSubscriber;
+
     /// Bidirectional shared memory stream with TCP-like connection semantics
-    /// Now uses bulk memcpy for high-performance data transfer
+    /// Each direction is a variable-length SPSC byte ring, so many messages can be in flight
+    /// The data region is mapped twice back-to-back, so a record that wraps past the end of
+    /// the ring is still contiguous in virtual memory and is copied with a single memcpy
     class ShmStream : public Stream {
+        // Topics reuse the mirrored ring mapping and the futex helpers
+        friend class ShmPublisher;
+        friend class ShmSubscriber;
+
       private:
-        // Fast message buffers (raw shared memory with bulk memcpy)
+        // Ring buffers (raw shared memory, header page + mirrored data region)
         void *send_shm_ptr_;
         void *recv_shm_ptr_;
         dp::usize send_shm_size_;
@@ -50,9 +123,10 @@ namespace netpipe {
         int send_shm_fd_;
         int recv_shm_fd_;
 
-        // Connection queue (still uses ring buffer for small handshake messages)
-        dp::RingBuffer<dp::MPMC, dp::u8> conn_queue_;
-        dp::RingBuffer<dp::MPMC, dp::u8> resp_queue_;
+        // Listener: the handshake region clients post connection requests to
+        ShmHandshakeRegion *handshake_;
+        int handshake_fd_;
+        dp::usize next_slot_; // Where accept() starts scanning, so no slot is starved
         std::atomic<dp::u64> next_conn_id_{0};
 
         bool connected_;
@@ -63,22 +137,150 @@ namespace netpipe {
         dp::u64 conn_id_;
         dp::usize buffer_size_;
         dp::u32 recv_timeout_ms_;
+        ShmWaitStrategy wait_strategy_;
+        ShmRegionOptions region_{}; // Listener: for the rings it creates; client: for the rings it attaches
+        dp::u32 send_spin_budget_;
+        dp::u32 recv_spin_budget_;
+
+        // Zero-copy state: at most one outstanding loan (send side) and one view (recv side)
+        bool loan_active_;
+        dp::usize loan_size_;
+        std::atomic<std::thread::id> loan_owner_; // Lets the loaning thread fail fast instead of self-deadlocking
+        bool view_active_;
+        dp::usize view_length_;
+
+        // Received messages are reserved here before their Message is sized (see MemoryBudget)
+        MemoryBudget *budget_ = &MemoryBudget::global();
+        BudgetLease lease_; // Reservation for the message received last
+        BudgetExemption exempt_ = nullptr;
 
         static constexpr dp::u32 POLL_INTERVAL_US = 1;       // Start with 1us
         static constexpr dp::u32 MAX_POLL_INTERVAL_US = 100; // Max 100us backoff
-        static constexpr dp::usize CONN_QUEUE_SIZE = 4096;
+        static constexpr dp::u32 MIN_SPIN_BUDGET = 64;       // Spin iterations before parking (adaptive)
+        static constexpr dp::u32 MAX_SPIN_BUDGET = 16384;
+        static constexpr dp::u32 CONNECT_TIMEOUT_MS = 10000;
+        static constexpr dp::u32 LARGE_CHUNK_WAIT_MS = 30000; // Matches how long a sender waits for ring space
+        static constexpr dp::u32 PEER_PROBE_MS = 1000;        // Longest wait before checking the peer is alive
+        static constexpr dp::usize HUGE_PAGE_SIZE = 2 * 1024 * 1024;
 
         mutable std::mutex send_mutex_;
 
+        static dp::usize page_size() {
+            static const dp::usize size = static_cast<dp::usize>(::sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+        static dp::usize align_up(dp::usize value, dp::usize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        /// Bytes a message of the given length occupies in the ring
+        static dp::usize record_size(dp::usize length) { return sizeof(ShmRecordHeader) + align_up(length, 8); }
+
         /// Get header and data pointers from shm region
-        static ShmMsgHeader *get_header(void *shm_ptr) { return static_cast<ShmMsgHeader *>(shm_ptr); }
+        static ShmRingHeader *get_header(void *shm_ptr) { return static_cast<ShmRingHeader *>(shm_ptr); }
+
+        static dp::u8 *get_data(void *shm_ptr) { return static_cast<dp::u8 *>(shm_ptr) + page_size(); }
+
+        /// Map [header page][data][data again] so records never need to be split at the wrap point
+        /// With huge pages the reservation is 2MB aligned, so file offsets and addresses stay congruent and
+        /// the kernel can back the ring with huge pages
+        /// Returns MAP_FAILED on error
+        static void *map_ring(int fd, dp::usize ring_size, const ShmRegionOptions &region = {}) {
+            dp::usize header_size = page_size();
+            dp::usize total = header_size + 2 * ring_size;
+            dp::usize slack = region.huge_pages ? HUGE_PAGE_SIZE : 0;
+
+            // Reserve contiguous address space, then overlay both views of the file on it
+            void *reserved = ::mmap(nullptr, total + slack, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (reserved == MAP_FAILED) {
+                echo::error("mmap reserve failed: ", strerror(errno));
+                return MAP_FAILED;
+            }
+            auto *bytes = static_cast<dp::u8 *>(reserved);
+            if (slack > 0) {
+                auto *aligned = reinterpret_cast<dp::u8 *>(align_up(reinterpret_cast<dp::usize>(bytes), slack));
+                if (aligned > bytes) {
+                    ::munmap(bytes, static_cast<dp::usize>(aligned - bytes));
+                }
+                dp::usize tail_slack = slack - static_cast<dp::usize>(aligned - bytes);
+                if (tail_slack > 0) {
+                    ::munmap(aligned + total, tail_slack);
+                }
+                bytes = aligned;
+            }
 
-        static dp::u8 *get_data(void *shm_ptr) { return static_cast<dp::u8 *>(shm_ptr) + sizeof(ShmMsgHeader); }
+            if (::mmap(bytes, header_size + ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+                MAP_FAILED) {
+                echo::error("mmap ring failed: ", strerror(errno));
+                ::munmap(bytes, total);
+                return MAP_FAILED;
+            }
+            if (::mmap(bytes + header_size + ring_size, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+                       static_cast<off_t>(header_size)) == MAP_FAILED) {
+                echo::error("mmap ring mirror failed: ", strerror(errno));
+                ::munmap(bytes, total);
+                return MAP_FAILED;
+            }
 
-        /// Create a shared memory message buffer
-        static bool create_msg_buffer(const char *name, dp::usize capacity, void *&ptr, dp::usize &size, int &fd) {
-            // Total size = header + data
-            size = sizeof(ShmMsgHeader) + capacity;
+            apply_region(bytes, header_size + ring_size, total, region);
+            return bytes;
+        }
+
+        /// Placement and paging hints for a freshly mapped ring; object_size is the first view (the whole file)
+        /// Order matters: the NUMA policy and THP advice must be in place before prefaulting allocates pages
+        static void apply_region(dp::u8 *base, dp::usize object_size, dp::usize total, const ShmRegionOptions &region) {
+#ifdef __linux__
+            if (region.numa_node >= 0) {
+                // mbind(2) directly - a shared policy on the shmem object, no libnuma needed
+                constexpr int MPOL_BIND_MODE = 2;
+                constexpr dp::usize MASK_BITS = 8 * sizeof(unsigned long);
+                unsigned long mask[16] = {};
+                auto node = static_cast<dp::usize>(region.numa_node);
+                if (node >= MASK_BITS * 16) {
+                    echo::warn("shm numa node out of range: ", region.numa_node);
+                } else {
+                    mask[node / MASK_BITS] = 1UL << (node % MASK_BITS);
+                    if (::syscall(SYS_mbind, base, object_size, MPOL_BIND_MODE, mask, MASK_BITS * 16, 0) != 0) {
+                        echo::warn("shm mbind to node ", region.numa_node, " failed: ", strerror(errno));
+                    }
+                }
+            }
+#ifdef MADV_HUGEPAGE
+            if (region.huge_pages && ::madvise(base, total, MADV_HUGEPAGE) != 0) {
+                echo::warn("shm madvise(MADV_HUGEPAGE) failed: ", strerror(errno));
+            }
+#endif
+#endif
+            if (region.prefault) {
+                prefault(base, total);
+            }
+            if (region.lock && ::mlock(base, total) != 0) {
+                echo::warn("shm mlock failed: ", strerror(errno));
+            }
+        }
+
+        /// Fault every page of [base, base + length) in for writing without changing its contents
+        static void prefault(dp::u8 *base, dp::usize length) {
+#if defined(__linux__)
+            constexpr int POPULATE_WRITE = 23; // MADV_POPULATE_WRITE, Linux 5.14+
+            if (::madvise(base, length, POPULATE_WRITE) == 0) {
+                return;
+            }
+#endif
+            // Older kernels: an atomic add of zero write-faults the page and is safe while the peer is live
+            for (dp::usize offset = 0; offset < length; offset += page_size()) {
+                __atomic_fetch_add(base + offset, 0, __ATOMIC_RELAXED);
+            }
+        }
+
+        /// Create a shared memory ring buffer
+        static bool create_msg_buffer(const char *name, dp::usize capacity, void *&ptr, dp::usize &size, int &fd,
+                                      const ShmRegionOptions &region = {}) {
+            // Ring must hold at least one max-size record; mirrored mapping needs page granularity
+            dp::usize ring_size =
+                align_up(record_size(capacity), region.huge_pages ? HUGE_PAGE_SIZE : page_size());
+            dp::usize file_size = page_size() + ring_size;
 
             fd = ::shm_open(name, O_CREAT | O_RDWR | O_EXCL, 0666);
             if (fd < 0) {
@@ -91,32 +293,40 @@ namespace netpipe {
                 }
             }
 
-            if (::ftruncate(fd, static_cast<off_t>(size)) < 0) {
+            if (::ftruncate(fd, static_cast<off_t>(file_size)) < 0) {
                 echo::error("ftruncate failed: ", strerror(errno));
                 ::close(fd);
                 ::shm_unlink(name);
                 return false;
             }
 
-            ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ptr = map_ring(fd, ring_size, region);
             if (ptr == MAP_FAILED) {
-                echo::error("mmap failed: ", strerror(errno));
                 ::close(fd);
                 ::shm_unlink(name);
                 return false;
             }
+            size = page_size() + 2 * ring_size;
 
             // Initialize header
             auto *header = get_header(ptr);
-            new (&header->msg_size) std::atomic<dp::u64>(0);
-            new (&header->msg_ready) std::atomic<dp::u32>(0);
+            new (&header->head) std::atomic<dp::u64>(0);
+            new (&header->tail) std::atomic<dp::u64>(0);
+            new (&header->data_seq) std::atomic<dp::u32>(0);
+            new (&header->data_waiters) std::atomic<dp::u32>(0);
+            new (&header->space_seq) std::atomic<dp::u32>(0);
+            new (&header->space_waiters) std::atomic<dp::u32>(0);
+            new (&header->closed) std::atomic<dp::u32>(0);
+            new (&header->producer_attached) std::atomic<dp::u32>(0);
+            header->ring_size = ring_size;
             header->capacity = static_cast<dp::u32>(capacity);
 
             return true;
         }
 
-        /// Attach to existing shared memory message buffer
-        static bool attach_msg_buffer(const char *name, void *&ptr, dp::usize &size, int &fd) {
+        /// Attach to existing shared memory ring buffer
+        static bool attach_msg_buffer(const char *name, void *&ptr, dp::usize &size, int &fd,
+                                      const ShmRegionOptions &region = {}) {
             fd = ::shm_open(name, O_RDWR, 0666);
             if (fd < 0) {
                 echo::error("shm_open attach failed: ", name, " - ", strerror(errno));
@@ -130,14 +340,20 @@ namespace netpipe {
                 ::close(fd);
                 return false;
             }
-            size = static_cast<dp::usize>(st.st_size);
+            dp::usize file_size = static_cast<dp::usize>(st.st_size);
+            if (file_size <= page_size() || (file_size - page_size()) % page_size() != 0) {
+                echo::error("shm attach: unexpected region size ", file_size);
+                ::close(fd);
+                return false;
+            }
+            dp::usize ring_size = file_size - page_size();
 
-            ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ptr = map_ring(fd, ring_size, region);
             if (ptr == MAP_FAILED) {
-                echo::error("mmap attach failed: ", strerror(errno));
                 ::close(fd);
                 return false;
             }
+            size = page_size() + 2 * ring_size;
 
             return true;
         }
@@ -157,71 +373,310 @@ namespace netpipe {
 
         /// Private constructor for accepted connections
         ShmStream(void *send_ptr, dp::usize send_size, int send_fd, void *recv_ptr, dp::usize recv_size, int recv_fd,
-                  const dp::String &channel_name, dp::u64 conn_id, dp::usize buffer_size)
+                  const dp::String &channel_name, dp::u64 conn_id, dp::usize buffer_size, ShmWaitStrategy wait)
             : send_shm_ptr_(send_ptr), recv_shm_ptr_(recv_ptr), send_shm_size_(send_size), recv_shm_size_(recv_size),
-              send_shm_fd_(send_fd), recv_shm_fd_(recv_fd), connected_(true), listening_(false), is_server_(true),
+              send_shm_fd_(send_fd), recv_shm_fd_(recv_fd), handshake_(nullptr), handshake_fd_(-1), next_slot_(0),
+              connected_(true), listening_(false), is_server_(true),
               owns_shm_(true), channel_name_(channel_name), conn_id_(conn_id), buffer_size_(buffer_size),
-              recv_timeout_ms_(0) {
+              recv_timeout_ms_(0), wait_strategy_(wait), send_spin_budget_(MIN_SPIN_BUDGET),
+              recv_spin_budget_(MIN_SPIN_BUDGET), loan_active_(false), loan_size_(0), view_active_(false),
+              view_length_(0) {
+            claim_send_ring();
             echo::debug("ShmStream created for connection ", conn_id);
         }
 
-        static dp::u64 generate_client_id() {
-            auto now = std::chrono::steady_clock::now().time_since_epoch();
-            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
-            return static_cast<dp::u64>(::getpid()) ^ static_cast<dp::u64>(ns);
+        /// Hold flock() on the send ring for the life of the connection (released when its fd closes)
+        void claim_send_ring() {
+            if (send_shm_fd_ >= 0 && ::flock(send_shm_fd_, LOCK_EX | LOCK_NB) == 0) {
+                get_header(send_shm_ptr_)->producer_attached.store(1, std::memory_order_release);
+            }
+        }
+
+        /// The peer closed the connection, or its process died while holding the recv ring's flock()
+        bool peer_gone() const {
+            auto *header = get_header(recv_shm_ptr_);
+            if (header->closed.load(std::memory_order_acquire) != 0) {
+                return true;
+            }
+            if (header->producer_attached.load(std::memory_order_acquire) == 0 ||
+                ::flock(recv_shm_fd_, LOCK_EX | LOCK_NB) != 0) {
+                return false;
+            }
+            ::flock(recv_shm_fd_, LOCK_UN);
+            return true;
+        }
+
+        /// wait_until() in slices of at most PEER_PROBE_MS, giving up once peer_gone()
+        /// ready() must also hold when the ring is closed so a hang-up wakes the wait
+        /// @param timeout_ms 0 waits forever
+        template <typename Ready>
+        dp::Res<void> wait_for_peer(Ready ready, std::atomic<dp::u32> &seq, std::atomic<dp::u32> &waiters,
+                                    dp::u32 &spin_budget, dp::u32 timeout_ms, const char *timeout_message) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while (true) {
+                dp::u32 slice = PEER_PROBE_MS;
+                if (timeout_ms > 0) {
+                    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    deadline - std::chrono::steady_clock::now())
+                                    .count();
+                    slice = static_cast<dp::u32>(std::clamp<dp::i64>(left, 1, PEER_PROBE_MS));
+                }
+                if (wait_until(ready, seq, waiters, spin_budget, slice)) {
+                    return dp::result::ok();
+                }
+                if (peer_gone()) {
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+                if (timeout_ms > 0 && std::chrono::steady_clock::now() >= deadline) {
+                    return dp::result::err(dp::Error::timeout(timeout_message));
+                }
+            }
         }
 
-        /// Write a struct to ring buffer (for handshake only)
-        template <typename T>
-        bool write_struct(dp::RingBuffer<dp::MPMC, dp::u8> &buf, const T &data, dp::u32 timeout_ms) {
-            const auto *bytes = reinterpret_cast<const dp::u8 *>(&data);
+        /// Park on a futex word until it no longer equals expected, or timeout_ns elapses (0 = forever)
+        static void futex_wait(std::atomic<dp::u32> &word, dp::u32 expected, dp::i64 timeout_ns) {
+#ifdef __linux__
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(timeout_ns / 1000000000);
+            ts.tv_nsec = static_cast<long>(timeout_ns % 1000000000);
+            ::syscall(SYS_futex, reinterpret_cast<dp::u32 *>(&word), FUTEX_WAIT, expected,
+                      timeout_ns > 0 ? &ts : nullptr, nullptr, 0);
+#else
+            std::this_thread::sleep_for(std::chrono::microseconds(MAX_POLL_INTERVAL_US));
+#endif
+        }
+
+        /// Wake the other side if it parked on this futex word
+        /// Called after every cursor update regardless of our own strategy, since the peer may use another
+        static void notify(std::atomic<dp::u32> &seq, std::atomic<dp::u32> &waiters) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            seq.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+            ::syscall(SYS_futex, reinterpret_cast<dp::u32 *>(&seq), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+        }
+
+        /// Wait until ready() holds using the configured wait strategy
+        /// With stats enabled, waits that could not return at once are timed into the counters
+        template <typename Ready>
+        bool wait_until(Ready ready, std::atomic<dp::u32> &seq, std::atomic<dp::u32> &waiters, dp::u32 &spin_budget,
+                        dp::u32 timeout_ms) {
+            if (!counters_ || ready()) {
+                return wait_with(wait_strategy_, ready, seq, waiters, spin_budget, timeout_ms);
+            }
             auto start = std::chrono::steady_clock::now();
+            bool ok = wait_with(wait_strategy_, ready, seq, waiters, spin_budget, timeout_ms);
+            counters_->on_wait(static_cast<dp::u64>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                    .count()));
+            return ok;
+        }
+
+        /// Wait until ready() holds using the given wait strategy
+        /// @param seq/waiters Futex word pair the other side bumps after making progress
+        /// @param spin_budget Adaptive spin count, grown when spinning pays off and shrunk when we park
+        /// @param timeout_ms 0 waits forever
+        /// @return false on timeout
+        template <typename Ready>
+        static bool wait_with(ShmWaitStrategy strategy, Ready ready, std::atomic<dp::u32> &seq,
+                              std::atomic<dp::u32> &waiters, dp::u32 &spin_budget, dp::u32 timeout_ms) {
+            if (ready()) {
+                return true;
+            }
 
-            for (dp::usize i = 0; i < sizeof(T); i++) {
-                while (buf.push(bytes[i]).is_err()) {
+            auto start_time = std::chrono::steady_clock::now();
+            auto deadline = start_time + std::chrono::milliseconds(timeout_ms);
+
+            if (strategy == ShmWaitStrategy::BusySpin) {
+                for (dp::u32 i = 1;; i++) {
+                    if (ready()) {
+                        return true;
+                    }
+                    cpu_relax();
+                    if (timeout_ms > 0 && (i & 1023) == 0 && std::chrono::steady_clock::now() >= deadline) {
+                        return false;
+                    }
+                }
+            }
+
+#ifdef __linux__
+            if (strategy == ShmWaitStrategy::SpinThenFutex) {
+                for (dp::u32 i = 0; i < spin_budget; i++) {
+                    if (ready()) {
+                        spin_budget = std::min(spin_budget * 2, MAX_SPIN_BUDGET);
+                        return true;
+                    }
+                    cpu_relax();
+                }
+                spin_budget = std::max(spin_budget / 2, MIN_SPIN_BUDGET);
+
+                while (true) {
+                    dp::i64 remaining_ns = 0;
                     if (timeout_ms > 0) {
-                        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                           std::chrono::steady_clock::now() - start)
+                        remaining_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           deadline - std::chrono::steady_clock::now())
                                            .count();
-                        if (elapsed >= timeout_ms)
-                            return false;
+                        if (remaining_ns <= 0) {
+                            return ready();
+                        }
+                    }
+
+                    // Announce ourselves before the final check so a concurrent notify() cannot be lost
+                    dp::u32 observed = seq.load(std::memory_order_acquire);
+                    waiters.fetch_add(1, std::memory_order_seq_cst);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (ready()) {
+                        waiters.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    futex_wait(seq, observed, remaining_ns);
+                    waiters.fetch_sub(1, std::memory_order_relaxed);
+                    if (ready()) {
+                        return true;
                     }
-                    std::this_thread::sleep_for(std::chrono::microseconds(POLL_INTERVAL_US));
+                }
+            }
+#endif
+
+            // Sleep strategy (and futex fallback on non-Linux platforms)
+            dp::u32 poll_us = POLL_INTERVAL_US;
+            while (!ready()) {
+                if (timeout_ms > 0 && std::chrono::steady_clock::now() >= deadline) {
+                    return false;
+                }
+
+                if (poll_us < MAX_POLL_INTERVAL_US) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(poll_us));
+                    poll_us = std::min(poll_us * 2, MAX_POLL_INTERVAL_US);
+                } else {
+                    std::this_thread::yield();
                 }
             }
             return true;
         }
 
-        /// Read a struct from ring buffer (for handshake only)
-        template <typename T> bool read_struct(dp::RingBuffer<dp::MPMC, dp::u8> &buf, T &data, dp::u32 timeout_ms) {
-            auto *bytes = reinterpret_cast<dp::u8 *>(&data);
-            auto start = std::chrono::steady_clock::now();
+        static dp::u64 generate_client_id() {
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+            return static_cast<dp::u64>(::getpid()) ^ static_cast<dp::u64>(ns);
+        }
 
-            for (dp::usize i = 0; i < sizeof(T); i++) {
-                while (true) {
-                    auto res = buf.pop();
-                    if (res.is_ok()) {
-                        bytes[i] = res.value();
+        /// Map the handshake region; create makes a fresh one (listener), otherwise it must exist (client)
+        static ShmHandshakeRegion *map_handshake(const char *name, bool create, int &fd) {
+            if (create) {
+                ::shm_unlink(name);
+                fd = ::shm_open(name, O_CREAT | O_RDWR | O_EXCL, 0666);
+            } else {
+                fd = ::shm_open(name, O_RDWR, 0666);
+            }
+            if (fd < 0) {
+                echo::trace("handshake shm_open failed: ", name, " - ", strerror(errno));
+                return nullptr;
+            }
+            struct stat st;
+            if (create ? ::ftruncate(fd, sizeof(ShmHandshakeRegion)) < 0
+                       : ::fstat(fd, &st) < 0 || static_cast<dp::usize>(st.st_size) < sizeof(ShmHandshakeRegion)) {
+                echo::error("handshake region setup failed: ", name);
+                ::close(fd);
+                fd = -1;
+                return nullptr;
+            }
+            void *ptr = ::mmap(nullptr, sizeof(ShmHandshakeRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED) {
+                echo::error("handshake mmap failed: ", strerror(errno));
+                ::close(fd);
+                fd = -1;
+                return nullptr;
+            }
+            return static_cast<ShmHandshakeRegion *>(ptr);
+        }
+
+        static void unmap_handshake(ShmHandshakeRegion *region, int fd) {
+            if (region) {
+                ::munmap(region, sizeof(ShmHandshakeRegion));
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        /// Post a connection request and wait for the listener's answer in the same slot
+        dp::Res<ShmConnResponse> handshake(ShmHandshakeRegion &region, const ShmConnRequest &request) {
+            auto start = std::chrono::steady_clock::now();
+            auto elapsed_ms = [&] {
+                return static_cast<dp::u32>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                std::chrono::steady_clock::now() - start)
+                                                .count());
+            };
+
+            // Claim a free slot; all of them busy means a burst larger than SLOTS - wait for one to free up
+            ShmHandshakeSlot *slot = nullptr;
+            while (!slot) {
+                for (auto &candidate : region.slots) {
+                    dp::u32 expected = ShmHandshakeSlot::FREE;
+                    if (candidate.state.compare_exchange_strong(expected, ShmHandshakeSlot::CLAIMED,
+                                                                std::memory_order_acquire)) {
+                        slot = &candidate;
                         break;
                     }
-                    if (timeout_ms > 0) {
-                        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                           std::chrono::steady_clock::now() - start)
-                                           .count();
-                        if (elapsed >= timeout_ms)
-                            return false;
+                }
+                if (!slot) {
+                    if (elapsed_ms() >= CONNECT_TIMEOUT_MS) {
+                        echo::error("no free shm handshake slot");
+                        return dp::result::err(dp::Error::timeout("connection timeout"));
                     }
-                    std::this_thread::sleep_for(std::chrono::microseconds(POLL_INTERVAL_US));
+                    std::this_thread::sleep_for(std::chrono::microseconds(MAX_POLL_INTERVAL_US));
                 }
             }
-            return true;
+
+            // Claiming may have used up the whole timeout; give the slot back before the listener sees it
+            if (elapsed_ms() >= CONNECT_TIMEOUT_MS) {
+                slot->state.store(ShmHandshakeSlot::FREE, std::memory_order_release);
+                echo::error("connection timeout claiming a shm handshake slot");
+                return dp::result::err(dp::Error::timeout("connection timeout"));
+            }
+            slot->request = request;
+            slot->state.store(ShmHandshakeSlot::REQUEST, std::memory_order_release);
+            region.pending.fetch_add(1, std::memory_order_release);
+            notify(region.request_seq, region.request_waiters);
+
+            auto answered = [&] { return slot->state.load(std::memory_order_acquire) == ShmHandshakeSlot::RESPONSE; };
+            dp::u32 spin_budget = MIN_SPIN_BUDGET;
+            // Checked before subtracting: the clock may have passed the timeout since the check above
+            dp::u32 elapsed = elapsed_ms();
+            dp::u32 left = elapsed < CONNECT_TIMEOUT_MS ? CONNECT_TIMEOUT_MS - elapsed : 1;
+            if (!wait_with(wait_strategy_, answered, slot->response_seq, slot->response_waiters, spin_budget, left)) {
+                // Withdraw the request if the listener has not picked it up, otherwise leave it to clean up
+                dp::u32 expected = ShmHandshakeSlot::REQUEST;
+                if (slot->state.compare_exchange_strong(expected, ShmHandshakeSlot::FREE)) {
+                    region.pending.fetch_sub(1, std::memory_order_relaxed);
+                    echo::error("connection timeout waiting for server response");
+                    return dp::result::err(dp::Error::timeout("connection timeout"));
+                }
+                if (expected == ShmHandshakeSlot::SERVING &&
+                    slot->state.compare_exchange_strong(expected, ShmHandshakeSlot::ABANDONED)) {
+                    echo::error("connection timeout waiting for server response");
+                    return dp::result::err(dp::Error::timeout("connection timeout"));
+                }
+                // The answer arrived while we were giving up - take it
+            }
+
+            ShmConnResponse response = slot->response;
+            slot->state.store(ShmHandshakeSlot::FREE, std::memory_order_release);
+            return dp::result::ok(response);
         }
 
       public:
         ShmStream()
             : send_shm_ptr_(nullptr), recv_shm_ptr_(nullptr), send_shm_size_(0), recv_shm_size_(0), send_shm_fd_(-1),
-              recv_shm_fd_(-1), connected_(false), listening_(false), is_server_(false), owns_shm_(false), conn_id_(0),
-              buffer_size_(0), recv_timeout_ms_(0) {
+              recv_shm_fd_(-1), handshake_(nullptr), handshake_fd_(-1), next_slot_(0), connected_(false),
+              listening_(false), is_server_(false), owns_shm_(false), conn_id_(0),
+              buffer_size_(0), recv_timeout_ms_(0), wait_strategy_(ShmWaitStrategy::SpinThenFutex),
+              send_spin_budget_(MIN_SPIN_BUDGET), recv_spin_budget_(MIN_SPIN_BUDGET), loan_active_(false),
+              loan_size_(0), view_active_(false), view_length_(0) {
             echo::trace("ShmStream constructed");
         }
 
@@ -238,18 +693,26 @@ namespace netpipe {
             : send_shm_ptr_(other.send_shm_ptr_), recv_shm_ptr_(other.recv_shm_ptr_),
               send_shm_size_(other.send_shm_size_), recv_shm_size_(other.recv_shm_size_),
               send_shm_fd_(other.send_shm_fd_), recv_shm_fd_(other.recv_shm_fd_),
-              conn_queue_(std::move(other.conn_queue_)), resp_queue_(std::move(other.resp_queue_)),
+              handshake_(other.handshake_), handshake_fd_(other.handshake_fd_), next_slot_(other.next_slot_),
               connected_(other.connected_), listening_(other.listening_), is_server_(other.is_server_),
               owns_shm_(other.owns_shm_), channel_name_(std::move(other.channel_name_)), conn_id_(other.conn_id_),
-              buffer_size_(other.buffer_size_), recv_timeout_ms_(other.recv_timeout_ms_) {
+              buffer_size_(other.buffer_size_), recv_timeout_ms_(other.recv_timeout_ms_),
+              wait_strategy_(other.wait_strategy_), region_(other.region_), send_spin_budget_(other.send_spin_budget_),
+              recv_spin_budget_(other.recv_spin_budget_), loan_active_(false), loan_size_(0),
+              view_active_(other.view_active_), view_length_(other.view_length_), budget_(other.budget_),
+              lease_(std::move(other.lease_)), exempt_(other.exempt_) {
             next_conn_id_.store(other.next_conn_id_.load());
+            counters_ = std::move(other.counters_);
             other.send_shm_ptr_ = nullptr;
             other.recv_shm_ptr_ = nullptr;
             other.send_shm_fd_ = -1;
             other.recv_shm_fd_ = -1;
+            other.handshake_ = nullptr;
+            other.handshake_fd_ = -1;
             other.connected_ = false;
             other.listening_ = false;
             other.owns_shm_ = false;
+            other.view_active_ = false;
         }
 
         ShmStream &operator=(ShmStream &&other) noexcept {
@@ -263,8 +726,9 @@ namespace netpipe {
                 recv_shm_size_ = other.recv_shm_size_;
                 send_shm_fd_ = other.send_shm_fd_;
                 recv_shm_fd_ = other.recv_shm_fd_;
-                conn_queue_ = std::move(other.conn_queue_);
-                resp_queue_ = std::move(other.resp_queue_);
+                handshake_ = other.handshake_;
+                handshake_fd_ = other.handshake_fd_;
+                next_slot_ = other.next_slot_;
                 next_conn_id_.store(other.next_conn_id_.load());
                 connected_ = other.connected_;
                 listening_ = other.listening_;
@@ -274,14 +738,29 @@ namespace netpipe {
                 conn_id_ = other.conn_id_;
                 buffer_size_ = other.buffer_size_;
                 recv_timeout_ms_ = other.recv_timeout_ms_;
+                wait_strategy_ = other.wait_strategy_;
+                region_ = other.region_;
+                send_spin_budget_ = other.send_spin_budget_;
+                recv_spin_budget_ = other.recv_spin_budget_;
+                loan_active_ = false;
+                loan_size_ = 0;
+                view_active_ = other.view_active_;
+                view_length_ = other.view_length_;
+                budget_ = other.budget_;
+                lease_ = std::move(other.lease_);
+                exempt_ = other.exempt_;
+                counters_ = std::move(other.counters_);
 
                 other.send_shm_ptr_ = nullptr;
                 other.recv_shm_ptr_ = nullptr;
                 other.send_shm_fd_ = -1;
                 other.recv_shm_fd_ = -1;
+                other.handshake_ = nullptr;
+                other.handshake_fd_ = -1;
                 other.connected_ = false;
                 other.listening_ = false;
                 other.owns_shm_ = false;
+                other.view_active_ = false;
             }
             return *this;
         }
@@ -303,28 +782,17 @@ namespace netpipe {
             owns_shm_ = true;
             channel_name_ = endpoint.name;
             buffer_size_ = endpoint.size;
-
-            char connq_name[256];
-            char respq_name[256];
-            snprintf(connq_name, sizeof(connq_name), "/%s_connq", endpoint.name.c_str());
-            snprintf(respq_name, sizeof(respq_name), "/%s_respq", endpoint.name.c_str());
-
-            ::shm_unlink(connq_name);
-            ::shm_unlink(respq_name);
-
-            auto connq_res = dp::RingBuffer<dp::MPMC, dp::u8>::create_shm(dp::String(connq_name), CONN_QUEUE_SIZE);
-            if (connq_res.is_err()) {
-                echo::error("failed to create connection queue");
-                return dp::result::err(dp::Error::io_error("failed to create connection queue"));
-            }
-            conn_queue_ = std::move(connq_res.value());
-
-            auto respq_res = dp::RingBuffer<dp::MPMC, dp::u8>::create_shm(dp::String(respq_name), CONN_QUEUE_SIZE);
-            if (respq_res.is_err()) {
-                echo::error("failed to create response queue");
-                return dp::result::err(dp::Error::io_error("failed to create response queue"));
+            wait_strategy_ = endpoint.wait;
+            region_ = endpoint.region;
+
+            char hs_name[256];
+            snprintf(hs_name, sizeof(hs_name), "/%s_hs", endpoint.name.c_str());
+            handshake_ = map_handshake(hs_name, true, handshake_fd_);
+            if (!handshake_) {
+                echo::error("failed to create handshake region");
+                return dp::result::err(dp::Error::io_error("failed to create handshake region"));
             }
-            resp_queue_ = std::move(respq_res.value());
+            next_slot_ = 0;
 
             listening_ = true;
             echo::info("ShmStream listening on channel: ", endpoint.name.c_str());
@@ -340,10 +808,30 @@ namespace netpipe {
 
             echo::trace("ShmStream waiting for connection");
 
-            ShmConnRequest req;
-            if (!read_struct(conn_queue_, req, recv_timeout_ms_)) {
-                return dp::result::err(dp::Error::timeout("accept timeout"));
+            // Wait for a posted request and take its slot; a client may withdraw one before we get to it
+            ShmHandshakeSlot *slot = nullptr;
+            while (!slot) {
+                auto posted = [&] { return handshake_->pending.load(std::memory_order_acquire) > 0; };
+                if (!wait_until(posted, handshake_->request_seq, handshake_->request_waiters, recv_spin_budget_,
+                                recv_timeout_ms_)) {
+                    return dp::result::err(dp::Error::timeout("accept timeout"));
+                }
+                for (dp::usize i = 0; i < ShmHandshakeRegion::SLOTS && !slot; i++) {
+                    auto &candidate = handshake_->slots[(next_slot_ + i) % ShmHandshakeRegion::SLOTS];
+                    dp::u32 expected = ShmHandshakeSlot::REQUEST;
+                    if (candidate.state.compare_exchange_strong(expected, ShmHandshakeSlot::SERVING,
+                                                                std::memory_order_acquire)) {
+                        slot = &candidate;
+                        next_slot_ = (next_slot_ + i + 1) % ShmHandshakeRegion::SLOTS;
+                    }
+                }
+                if (slot) {
+                    handshake_->pending.fetch_sub(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield(); // pending is raised just after the slot turns REQUEST
+                }
             }
+            ShmConnRequest req = slot->request;
 
             echo::debug("received connection request from client ", req.client_id);
 
@@ -367,34 +855,47 @@ namespace netpipe {
             dp::usize s2c_size = 0, c2s_size = 0;
             int s2c_fd = -1, c2s_fd = -1;
 
-            if (!create_msg_buffer(s2c_name, buf_size, s2c_ptr, s2c_size, s2c_fd)) {
+            // Answer in the slot; false when the client gave up meanwhile and the slot was freed instead
+            auto answer = [&](dp::u32 status) {
+                slot->response = ShmConnResponse{req.client_id, conn_id, status, 0};
+                dp::u32 expected = ShmHandshakeSlot::SERVING;
+                if (!slot->state.compare_exchange_strong(expected, ShmHandshakeSlot::RESPONSE,
+                                                         std::memory_order_release)) {
+                    slot->state.store(ShmHandshakeSlot::FREE, std::memory_order_release);
+                    return false;
+                }
+                notify(slot->response_seq, slot->response_waiters);
+                return true;
+            };
+
+            if (!create_msg_buffer(s2c_name, buf_size, s2c_ptr, s2c_size, s2c_fd, region_)) {
                 echo::error("failed to create s2c buffer for conn ", conn_id);
-                ShmConnResponse resp{req.client_id, conn_id, 1, 0};
-                write_struct(resp_queue_, resp, 1000);
+                answer(1);
                 return dp::result::err(dp::Error::io_error("failed to create connection buffers"));
             }
 
-            if (!create_msg_buffer(c2s_name, buf_size, c2s_ptr, c2s_size, c2s_fd)) {
+            if (!create_msg_buffer(c2s_name, buf_size, c2s_ptr, c2s_size, c2s_fd, region_)) {
                 echo::error("failed to create c2s buffer for conn ", conn_id);
                 close_msg_buffer(s2c_ptr, s2c_size, s2c_fd, s2c_name, true);
-                ShmConnResponse resp{req.client_id, conn_id, 2, 0};
-                write_struct(resp_queue_, resp, 1000);
+                answer(2);
                 return dp::result::err(dp::Error::io_error("failed to create connection buffers"));
             }
 
-            ShmConnResponse resp{req.client_id, conn_id, 0, 0};
-            if (!write_struct(resp_queue_, resp, 5000)) {
-                echo::error("failed to send connection response");
+            if (!answer(0)) {
+                echo::error("client ", req.client_id, " abandoned connection ", conn_id);
                 close_msg_buffer(s2c_ptr, s2c_size, s2c_fd, s2c_name, true);
                 close_msg_buffer(c2s_ptr, c2s_size, c2s_fd, c2s_name, true);
-                return dp::result::err(dp::Error::io_error("failed to send connection response"));
+                return dp::result::err(dp::Error::timeout("client abandoned connection"));
             }
 
             echo::info("ShmStream accepted connection ", conn_id, " from client ", req.client_id);
 
             // Server sends on s2c, receives on c2s
             auto client_stream = std::unique_ptr<Stream>(
-                new ShmStream(s2c_ptr, s2c_size, s2c_fd, c2s_ptr, c2s_size, c2s_fd, channel_name_, conn_id, buf_size));
+                new ShmStream(s2c_ptr, s2c_size, s2c_fd, c2s_ptr, c2s_size, c2s_fd, channel_name_, conn_id, buf_size,
+                              wait_strategy_));
+            (void)client_stream->set_memory_budget(budget_);
+            inherit_stats(*client_stream);
 
             return dp::result::ok(std::move(client_stream));
         }
@@ -416,202 +917,663 @@ namespace netpipe {
             owns_shm_ = false;
             channel_name_ = endpoint.name;
             buffer_size_ = endpoint.size;
-
-            char connq_name[256];
-            char respq_name[256];
-            snprintf(connq_name, sizeof(connq_name), "/%s_connq", endpoint.name.c_str());
-            snprintf(respq_name, sizeof(respq_name), "/%s_respq", endpoint.name.c_str());
-
-            auto connq_res = dp::RingBuffer<dp::MPMC, dp::u8>::attach_shm(dp::String(connq_name));
-            if (connq_res.is_err()) {
-                echo::error("failed to attach to connection queue (server not listening?)");
+            wait_strategy_ = endpoint.wait;
+            region_ = endpoint.region;
+
+            char hs_name[256];
+            snprintf(hs_name, sizeof(hs_name), "/%s_hs", endpoint.name.c_str());
+            int hs_fd = -1;
+            ShmHandshakeRegion *region = map_handshake(hs_name, false, hs_fd);
+            if (!region) {
+                echo::error("failed to attach to handshake region (server not listening?)");
                 return dp::result::err(dp::Error::io_error("server not listening"));
             }
-            conn_queue_ = std::move(connq_res.value());
-
-            auto respq_res = dp::RingBuffer<dp::MPMC, dp::u8>::attach_shm(dp::String(respq_name));
-            if (respq_res.is_err()) {
-                echo::error("failed to attach to response queue");
-                return dp::result::err(dp::Error::io_error("failed to attach to response queue"));
-            }
-            resp_queue_ = std::move(respq_res.value());
 
             dp::u64 client_id = generate_client_id();
             ShmConnRequest req{client_id, static_cast<dp::u32>(endpoint.size), 0};
-
             echo::debug("sending connection request, client_id=", client_id);
 
-            if (!write_struct(conn_queue_, req, 5000)) {
-                echo::error("timeout sending connection request");
-                return dp::result::err(dp::Error::timeout("connection timeout"));
+            auto resp_res = handshake(*region, req);
+            unmap_handshake(region, hs_fd);
+            if (resp_res.is_err()) {
+                return dp::result::err(resp_res.error());
+            }
+            const ShmConnResponse &resp = resp_res.value();
+            if (resp.status != 0) {
+                echo::error("server rejected connection, status=", resp.status);
+                return dp::result::err(dp::Error::io_error("connection rejected"));
             }
 
-            auto start = std::chrono::steady_clock::now();
-            constexpr dp::u32 CONNECT_TIMEOUT_MS = 10000;
+            conn_id_ = resp.conn_id;
+            echo::debug("received connection response, conn_id=", conn_id_);
 
-            while (true) {
-                ShmConnResponse resp;
-                if (read_struct(resp_queue_, resp, 100)) {
-                    if (resp.client_id == client_id) {
-                        if (resp.status != 0) {
-                            echo::error("server rejected connection, status=", resp.status);
-                            return dp::result::err(dp::Error::io_error("connection rejected"));
-                        }
+            char s2c_name[256];
+            char c2s_name[256];
+            snprintf(s2c_name, sizeof(s2c_name), "/%s_%llu_s2c", channel_name_.c_str(),
+                     static_cast<unsigned long long>(conn_id_));
+            snprintf(c2s_name, sizeof(c2s_name), "/%s_%llu_c2s", channel_name_.c_str(),
+                     static_cast<unsigned long long>(conn_id_));
 
-                        conn_id_ = resp.conn_id;
-                        echo::debug("received connection response, conn_id=", conn_id_);
+            // Client sends on c2s, receives on s2c
+            if (!attach_msg_buffer(c2s_name, send_shm_ptr_, send_shm_size_, send_shm_fd_, region_)) {
+                echo::error("failed to attach to c2s buffer");
+                return dp::result::err(dp::Error::io_error("failed to attach to buffers"));
+            }
 
-                        char s2c_name[256];
-                        char c2s_name[256];
-                        snprintf(s2c_name, sizeof(s2c_name), "/%s_%llu_s2c", channel_name_.c_str(),
-                                 static_cast<unsigned long long>(conn_id_));
-                        snprintf(c2s_name, sizeof(c2s_name), "/%s_%llu_c2s", channel_name_.c_str(),
-                                 static_cast<unsigned long long>(conn_id_));
+            if (!attach_msg_buffer(s2c_name, recv_shm_ptr_, recv_shm_size_, recv_shm_fd_, region_)) {
+                echo::error("failed to attach to s2c buffer");
+                close_msg_buffer(send_shm_ptr_, send_shm_size_, send_shm_fd_, nullptr, false);
+                return dp::result::err(dp::Error::io_error("failed to attach to buffers"));
+            }
+            claim_send_ring();
 
-                        // Client sends on c2s, receives on s2c
-                        if (!attach_msg_buffer(c2s_name, send_shm_ptr_, send_shm_size_, send_shm_fd_)) {
-                            echo::error("failed to attach to c2s buffer");
-                            return dp::result::err(dp::Error::io_error("failed to attach to buffers"));
-                        }
+            connected_ = true;
+            echo::info("ShmStream connected, conn_id=", conn_id_);
+            return dp::result::ok();
+        }
 
-                        if (!attach_msg_buffer(s2c_name, recv_shm_ptr_, recv_shm_size_, recv_shm_fd_)) {
-                            echo::error("failed to attach to s2c buffer");
-                            close_msg_buffer(send_shm_ptr_, send_shm_size_, send_shm_fd_, nullptr, false);
-                            return dp::result::err(dp::Error::io_error("failed to attach to buffers"));
-                        }
+      private:
+        /// Wait until the send ring has room for a record of the given length
+        /// Caller must hold send_mutex_; returns a pointer to the record slot
+        dp::Res<dp::u8 *> reserve_record(dp::usize length) {
+            if (!connected_ || !send_shm_ptr_) {
+                echo::trace("send called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
 
-                        connected_ = true;
-                        echo::info("ShmStream connected, conn_id=", conn_id_);
-                        return dp::result::ok();
-                    }
-                    echo::trace("got response for different client, continuing");
-                }
+            auto *header = get_header(send_shm_ptr_);
 
-                auto elapsed =
-                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
-                        .count();
-                if (elapsed >= CONNECT_TIMEOUT_MS) {
-                    echo::error("connection timeout waiting for server response");
-                    return dp::result::err(dp::Error::timeout("connection timeout"));
-                }
+            if (length > header->capacity) {
+                echo::error("message too large: ", length, " bytes (max ", header->capacity, ")");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+
+            dp::usize needed = record_size(length);
+            dp::u64 head = header->head.load(std::memory_order_relaxed);
+
+            // Wait for enough free space in the ring, or for the consumer to hang up
+            constexpr dp::u32 MAX_WAIT_MS = 30000;
+            auto has_space = [&] {
+                return header->closed.load(std::memory_order_acquire) != 0 ||
+                       header->ring_size - (head - header->tail.load(std::memory_order_acquire)) >= needed;
+            };
+            auto waited =
+                wait_for_peer(has_space, header->space_seq, header->space_waiters, send_spin_budget_, MAX_WAIT_MS,
+                              "send buffer full");
+            if (waited.is_ok() && header->closed.load(std::memory_order_acquire) != 0) {
+                waited = dp::result::err(dp::Error::not_found("connection closed by peer"));
             }
+            if (waited.is_err()) {
+                echo::debug("send gave up waiting for buffer: ", waited.error().message.c_str());
+                return dp::result::err(waited.error());
+            }
+
+            // Record is contiguous thanks to the mirrored mapping
+            return dp::result::ok(get_data(send_shm_ptr_) + (head % header->ring_size));
         }
 
-        /// Send message using bulk memcpy - FAST!
-        dp::Res<void> send(const Message &msg) override {
-            std::lock_guard<std::mutex> lock(send_mutex_);
+        /// Write the length prefix and publish a reserved record to the consumer
+        void publish_record(dp::u8 *slot, dp::usize length, dp::u32 flags = 0) {
+            auto *header = get_header(send_shm_ptr_);
+            ShmRecordHeader record{static_cast<dp::u32>(length), flags};
+            std::memcpy(slot, &record, sizeof(record));
+
+            dp::u64 head = header->head.load(std::memory_order_relaxed);
+            header->head.store(head + record_size(length), std::memory_order_release);
+            notify(header->data_seq, header->data_waiters);
+            if (counters_ && flags == 0) {
+                counters_->on_send(length); // Large messages are counted once, by send_large()
+            }
+        }
 
-            if (!connected_ || !send_shm_ptr_) {
-                echo::trace("send called but not connected");
+        /// Wait for the next record in the recv ring and validate its length
+        /// Returns the payload length; payload points into shared memory
+        dp::Res<dp::usize> next_record(const dp::u8 *&payload, dp::u32 &flags, dp::u32 timeout_ms) {
+            if (!connected_ || !recv_shm_ptr_) {
+                echo::trace("recv called but not connected");
                 return dp::result::err(dp::Error::not_found("not connected"));
             }
 
-            auto *header = get_header(send_shm_ptr_);
-            dp::u8 *data = get_data(send_shm_ptr_);
+            echo::trace("shm recv waiting");
 
-            if (msg.size() > header->capacity) {
-                echo::error("message too large: ", msg.size(), " bytes (max ", header->capacity, ")");
+            auto *header = get_header(recv_shm_ptr_);
+
+            // Wait for a record to be published (head ahead of tail); records sent before a hang-up still drain
+            dp::u64 tail = header->tail.load(std::memory_order_relaxed);
+            auto published = [&] { return header->head.load(std::memory_order_acquire) != tail; };
+            auto has_data = [&] { return published() || header->closed.load(std::memory_order_acquire) != 0; };
+            auto waited =
+                wait_for_peer(has_data, header->data_seq, header->data_waiters, recv_spin_budget_, timeout_ms,
+                              "recv timeout");
+            if (waited.is_err()) {
+                return dp::result::err(waited.error());
+            }
+            if (!published()) {
+                return dp::result::err(dp::Error::not_found("connection closed by peer"));
+            }
+
+            // Read record length
+            const dp::u8 *slot = get_data(recv_shm_ptr_) + (tail % header->ring_size);
+            ShmRecordHeader record;
+            std::memcpy(&record, slot, sizeof(record));
+            dp::u64 length = record.length;
+            echo::trace("recv expecting ", length, " bytes");
+
+            if (length > remote::MAX_MESSAGE_SIZE || record_size(length) > header->ring_size) {
+                echo::error("message too large: ", length, " bytes");
+                connected_ = false;
                 return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
             }
 
-            echo::trace("shm send ", msg.size(), " bytes");
+            payload = slot + sizeof(record);
+            flags = record.flags;
+            return dp::result::ok(static_cast<dp::usize>(length));
+        }
 
-            // Wait for buffer to be free (msg_ready == 0)
-            auto start_time = std::chrono::steady_clock::now();
-            constexpr dp::u32 MAX_WAIT_MS = 30000;
-            dp::u32 poll_us = POLL_INTERVAL_US;
+        /// Validate a LARGE_BEGIN record and return the message's total length (the record stays unconsumed)
+        dp::Res<dp::u64> large_total(const dp::u8 *payload, dp::usize length) {
+            dp::u64 total = 0;
+            if (length == sizeof(total)) {
+                std::memcpy(&total, payload, sizeof(total));
+            }
+            if (length != sizeof(total) || total > remote::MAX_MESSAGE_SIZE) {
+                echo::error("malformed large message header");
+                connected_ = false;
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+            return dp::result::ok(total);
+        }
 
-            while (header->msg_ready.load(std::memory_order_acquire) != 0) {
-                auto elapsed =
-                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time)
-                        .count();
-                if (elapsed >= MAX_WAIT_MS) {
-                    echo::error("send timeout waiting for buffer");
-                    return dp::result::err(dp::Error::timeout("send buffer full"));
+        /// Consume the LARGE_CHUNK records of a message whose LARGE_BEGIN was just consumed
+        /// sink(offset, data, length) copies each chunk out before its space goes back to the producer.
+        /// A message cut short leaves the stream unusable, so failures disconnect it.
+        template <typename Sink> dp::Res<void> read_large(dp::u64 total, Sink &&sink) {
+            dp::u64 received = 0;
+            while (received < total) {
+                const dp::u8 *payload = nullptr;
+                dp::u32 flags = 0;
+                auto length_res = next_record(payload, flags, LARGE_CHUNK_WAIT_MS);
+                if (length_res.is_err()) {
+                    echo::error("large message interrupted after ", received, " of ", total, " bytes");
+                    connected_ = false;
+                    return dp::result::err(dp::Error::io_error("large message interrupted"));
+                }
+                dp::usize length = length_res.value();
+                if (flags != ShmRecordHeader::LARGE_CHUNK || received + length > total) {
+                    echo::error("malformed large message chunk");
+                    connected_ = false;
+                    return dp::result::err(dp::Error::invalid_argument("malformed large message"));
                 }
+                sink(received, payload, length);
+                consume_record(length);
+                received += length;
+            }
+            echo::debug("received large message of ", total, " bytes");
+            return dp::result::ok();
+        }
 
-                if (poll_us < MAX_POLL_INTERVAL_US) {
-                    std::this_thread::sleep_for(std::chrono::microseconds(poll_us));
-                    poll_us = std::min(poll_us * 2, MAX_POLL_INTERVAL_US);
-                } else {
-                    std::this_thread::yield();
+        /// Stream a message larger than the ring as chunks; caller holds send_mutex_
+        /// Chunks are a quarter of the ring so the receiver drains one while the next is written
+        dp::Res<void> send_large(std::span<const iovec> parts, dp::usize total) {
+            auto *header = get_header(send_shm_ptr_);
+            dp::usize chunk = header->capacity >= 64 ? align_up(header->capacity / 4, 8) : header->capacity;
+            if (chunk < sizeof(dp::u64) || total > remote::MAX_MESSAGE_SIZE) {
+                echo::error("message too large: ", total, " bytes");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+
+            auto begin_res = reserve_record(sizeof(dp::u64));
+            if (begin_res.is_err()) {
+                return dp::result::err(begin_res.error());
+            }
+            dp::u64 total_length = total;
+            std::memcpy(begin_res.value() + sizeof(ShmRecordHeader), &total_length, sizeof(total_length));
+            publish_record(begin_res.value(), sizeof(total_length), ShmRecordHeader::LARGE_BEGIN);
+
+            dp::usize part_index = 0;
+            dp::usize part_offset = 0;
+            for (dp::usize sent = 0; sent < total;) {
+                dp::usize length = total - sent < chunk ? total - sent : chunk;
+                auto slot_res = reserve_record(length);
+                if (slot_res.is_err()) {
+                    // The peer holds a partial message it can never complete
+                    echo::error("large send interrupted after ", sent, " of ", total, " bytes");
+                    connected_ = false;
+                    return dp::result::err(slot_res.error());
                 }
+                dp::u8 *dst = slot_res.value() + sizeof(ShmRecordHeader);
+                for (dp::usize filled = 0; filled < length;) {
+                    const iovec &part = parts[part_index];
+                    dp::usize take = part.iov_len - part_offset;
+                    take = take < length - filled ? take : length - filled;
+                    std::memcpy(dst + filled, static_cast<const dp::u8 *>(part.iov_base) + part_offset, take);
+                    filled += take;
+                    part_offset += take;
+                    if (part_offset == part.iov_len) {
+                        part_index++;
+                        part_offset = 0;
+                    }
+                }
+                publish_record(slot_res.value(), length, ShmRecordHeader::LARGE_CHUNK);
+                sent += length;
+            }
+
+            if (counters_) {
+                counters_->on_send(total);
+            }
+            echo::debug("sent large message of ", total, " bytes");
+            return dp::result::ok();
+        }
+
+        /// Reserve total bytes for the record at the tail, giving back the last message's reservation first
+        /// The record is still unconsumed, so a timeout leaves it in the ring for the next receive
+        /// payload is the record's data for an ordinary record (checked against exempt_), nullptr for a large one
+        dp::Res<void> admit(dp::u64 total, const dp::u8 *payload) {
+            lease_.release();
+            if (!budget_ || !budget_->enabled()) {
+                return dp::result::ok();
+            }
+            if (exempt_ && payload && exempt_(payload, total < BUDGET_PEEK_SIZE ? total : BUDGET_PEEK_SIZE)) {
+                return dp::result::ok();
             }
+            auto res = budget_->reserve(total, budget_->wait_ms());
+            if (res.is_ok()) {
+                lease_ = BudgetLease(budget_, total);
+            }
+            return res;
+        }
 
-            // Bulk copy message data
-            std::memcpy(data, msg.data(), msg.size());
+        /// Release the record at the tail back to the producer
+        void consume_record(dp::usize length) {
+            auto *header = get_header(recv_shm_ptr_);
+            dp::u64 tail = header->tail.load(std::memory_order_relaxed);
+            header->tail.store(tail + record_size(length), std::memory_order_release);
+            notify(header->space_seq, header->space_waiters);
+        }
 
-            // Set size and signal ready (with memory barriers)
-            header->msg_size.store(msg.size(), std::memory_order_release);
-            header->msg_ready.store(1, std::memory_order_release);
+      public:
+        /// Send message by appending a record to the ring
+        /// Only blocks when the ring does not have room for the record
+        dp::Res<void> send(const Message &msg) override {
+            if (loan_owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+                echo::error("send called while a loan is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("loan outstanding"));
+            }
+
+            std::lock_guard<std::mutex> lock(send_mutex_);
+
+            echo::trace("shm send ", msg.size(), " bytes");
+
+            if (send_shm_ptr_ && msg.size() > get_header(send_shm_ptr_)->capacity) {
+                iovec whole{const_cast<dp::u8 *>(msg.data()), msg.size()};
+                return send_large(std::span<const iovec>(&whole, 1), msg.size());
+            }
+
+            auto slot_res = reserve_record(msg.size());
+            if (slot_res.is_err()) {
+                return dp::result::err(slot_res.error());
+            }
+            dp::u8 *slot = slot_res.value();
+
+            if (!msg.empty()) {
+                std::memcpy(slot + sizeof(ShmRecordHeader), msg.data(), msg.size());
+            }
+            publish_record(slot, msg.size());
 
             echo::debug("sent ", msg.size(), " bytes");
             return dp::result::ok();
         }
 
-        /// Receive message using bulk memcpy - FAST!
-        dp::Res<Message> recv() override {
-            if (!connected_ || !recv_shm_ptr_) {
-                echo::trace("recv called but not connected");
-                return dp::result::err(dp::Error::not_found("not connected"));
+        /// Send several buffers as one record, copied straight into the ring slot
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
+            if (loan_owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+                echo::error("send called while a loan is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("loan outstanding"));
             }
 
-            echo::trace("shm recv waiting");
+            std::lock_guard<std::mutex> lock(send_mutex_);
 
-            auto *header = get_header(recv_shm_ptr_);
-            dp::u8 *data = get_data(recv_shm_ptr_);
+            dp::usize total = 0;
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
 
-            auto start_time = std::chrono::steady_clock::now();
-            dp::u32 poll_us = POLL_INTERVAL_US;
+            echo::trace("shm send ", total, " bytes in ", parts.size(), " parts");
 
-            // Wait for message to be ready (msg_ready == 1)
-            while (header->msg_ready.load(std::memory_order_acquire) == 0) {
-                if (recv_timeout_ms_ > 0) {
-                    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                       std::chrono::steady_clock::now() - start_time)
-                                       .count();
-                    if (elapsed >= recv_timeout_ms_) {
-                        return dp::result::err(dp::Error::timeout("recv timeout"));
-                    }
-                }
+            if (send_shm_ptr_ && total > get_header(send_shm_ptr_)->capacity) {
+                return send_large(parts, total);
+            }
 
-                if (poll_us < MAX_POLL_INTERVAL_US) {
-                    std::this_thread::sleep_for(std::chrono::microseconds(poll_us));
-                    poll_us = std::min(poll_us * 2, MAX_POLL_INTERVAL_US);
-                } else {
-                    std::this_thread::yield();
+            auto slot_res = reserve_record(total);
+            if (slot_res.is_err()) {
+                return dp::result::err(slot_res.error());
+            }
+            dp::u8 *slot = slot_res.value();
+
+            dp::u8 *dst = slot + sizeof(ShmRecordHeader);
+            for (const auto &part : parts) {
+                if (part.iov_len > 0) {
+                    std::memcpy(dst, part.iov_base, part.iov_len);
+                    dst += part.iov_len;
                 }
             }
+            publish_record(slot, total);
 
-            // Read size
-            dp::u64 length = header->msg_size.load(std::memory_order_acquire);
-            echo::trace("recv expecting ", length, " bytes");
+            echo::debug("sent ", total, " bytes");
+            return dp::result::ok();
+        }
 
-            if (length > remote::MAX_MESSAGE_SIZE) {
-                echo::error("message too large: ", length, " bytes");
+        /// Receive the next record from the ring
+        dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        /// Receive the next record into a caller-owned buffer, reusing its capacity
+        dp::Res<void> recv_into(Message &msg) override {
+            if (view_active_) {
+                echo::error("recv called while a view is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("view not released"));
+            }
+
+            const dp::u8 *payload = nullptr;
+            dp::u32 flags = 0;
+            auto length_res = next_record(payload, flags, recv_timeout_ms_);
+            if (length_res.is_err()) {
+                return dp::result::err(length_res.error());
+            }
+            dp::usize length = length_res.value();
+            dp::u64 total = length;
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                auto total_res = large_total(payload, length);
+                if (total_res.is_err()) {
+                    return dp::result::err(total_res.error());
+                }
+                total = total_res.value();
+            }
+            auto admit_res = admit(total, flags == ShmRecordHeader::LARGE_BEGIN ? nullptr : payload);
+            if (admit_res.is_err()) {
+                return admit_res;
+            }
+
+            // Resize (no allocation when capacity suffices) and bulk copy
+            try {
+                msg.resize(total);
+            } catch (const std::bad_alloc &) {
+                echo::error("allocation failed: ", total, " bytes");
                 connected_ = false;
-                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+                return dp::result::err(dp::Error::io_error("memory allocation failed"));
             }
 
-            // Allocate and bulk copy
-            Message msg;
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                consume_record(length);
+                auto res = read_large(total, [&](dp::u64 offset, const dp::u8 *data, dp::usize chunk) {
+                    std::memcpy(msg.data() + offset, data, chunk);
+                });
+                if (res.is_ok() && counters_) {
+                    counters_->on_recv(total);
+                }
+                return res;
+            }
+
+            if (length > 0) {
+                std::memcpy(msg.data(), payload, length);
+            }
+            consume_record(length);
+            if (counters_) {
+                counters_->on_recv(length);
+            }
+
+            echo::debug("received ", length, " bytes");
+            return dp::result::ok();
+        }
+
+        /// Receive the next record with its first prefix_len bytes split off into prefix
+        dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) override {
+            if (view_active_) {
+                echo::error("recv called while a view is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("view not released"));
+            }
+
+            const dp::u8 *payload = nullptr;
+            dp::u32 flags = 0;
+            auto length_res = next_record(payload, flags, recv_timeout_ms_);
+            if (length_res.is_err()) {
+                return dp::result::err(length_res.error());
+            }
+            dp::usize length = length_res.value();
+            dp::u64 total = length;
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                auto total_res = large_total(payload, length);
+                if (total_res.is_err()) {
+                    return dp::result::err(total_res.error());
+                }
+                total = total_res.value();
+            }
+            auto admit_res = admit(total, flags == ShmRecordHeader::LARGE_BEGIN ? nullptr : payload);
+            if (admit_res.is_err()) {
+                return dp::result::err(admit_res.error());
+            }
+            dp::usize head = total < prefix_len ? static_cast<dp::usize>(total) : prefix_len;
+
             try {
-                msg.resize(static_cast<dp::usize>(length));
+                rest.resize(total - head);
             } catch (const std::bad_alloc &) {
-                echo::error("allocation failed: ", length, " bytes");
+                echo::error("allocation failed: ", total - head, " bytes");
                 connected_ = false;
                 return dp::result::err(dp::Error::io_error("memory allocation failed"));
             }
 
-            std::memcpy(msg.data(), data, static_cast<dp::usize>(length));
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                consume_record(length);
+                auto res = read_large(total, [&](dp::u64 offset, const dp::u8 *data, dp::usize chunk) {
+                    // The prefix may end inside this chunk
+                    dp::usize split = offset < head ? static_cast<dp::usize>(head - offset) : 0;
+                    split = split < chunk ? split : chunk;
+                    if (split > 0) {
+                        std::memcpy(prefix + offset, data, split);
+                    }
+                    if (chunk > split) {
+                        std::memcpy(rest.data() + (offset + split - head), data + split, chunk - split);
+                    }
+                });
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                if (counters_) {
+                    counters_->on_recv(total);
+                }
+                return dp::result::ok(head);
+            }
 
-            // Signal buffer is free
-            header->msg_ready.store(0, std::memory_order_release);
+            if (head > 0) {
+                std::memcpy(prefix, payload, head);
+            }
+            if (length > head) {
+                std::memcpy(rest.data(), payload + head, length - head);
+            }
+            consume_record(length);
+            if (counters_) {
+                counters_->on_recv(length);
+            }
 
             echo::debug("received ", length, " bytes");
-            return dp::result::ok(std::move(msg));
+            return dp::result::ok(head);
         }
 
+        /// Receive the next message straight into caller memory - a large message is never staged in a Message
+        /// @return Message length; a message that does not fit stays queued and is an invalid_argument error
+        dp::Res<dp::usize> recv_to(std::span<dp::u8> buffer) {
+            if (view_active_) {
+                echo::error("recv called while a view is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("view not released"));
+            }
+
+            const dp::u8 *payload = nullptr;
+            dp::u32 flags = 0;
+            auto length_res = next_record(payload, flags, recv_timeout_ms_);
+            if (length_res.is_err()) {
+                return dp::result::err(length_res.error());
+            }
+            dp::usize length = length_res.value();
+            dp::u64 total = length;
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                auto total_res = large_total(payload, length);
+                if (total_res.is_err()) {
+                    return dp::result::err(total_res.error());
+                }
+                total = total_res.value();
+            }
+            if (total > buffer.size()) {
+                echo::error("recv_to buffer of ", buffer.size(), " bytes too small for ", total);
+                return dp::result::err(dp::Error::invalid_argument("buffer too small for message"));
+            }
+
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                consume_record(length);
+                auto res = read_large(total, [&](dp::u64 offset, const dp::u8 *data, dp::usize chunk) {
+                    std::memcpy(buffer.data() + offset, data, chunk);
+                });
+                if (res.is_err()) {
+                    return dp::result::err(res.error());
+                }
+                if (counters_) {
+                    counters_->on_recv(total);
+                }
+                return dp::result::ok(static_cast<dp::usize>(total));
+            }
+
+            if (length > 0) {
+                std::memcpy(buffer.data(), payload, length);
+            }
+            consume_record(length);
+            if (counters_) {
+                counters_->on_recv(length);
+            }
+            return dp::result::ok(length);
+        }
+
+        /// Zero-copy send: borrow a writable span of the send ring
+        /// Fill it, then commit() to publish or cancel_loan() to drop it
+        /// Other senders on this stream block until the loan is committed or cancelled
+        dp::Res<std::span<dp::u8>> loan(dp::usize size) {
+            if (loan_owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+                echo::error("loan called while a loan is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("loan outstanding"));
+            }
+
+            send_mutex_.lock();
+
+            auto slot_res = reserve_record(size);
+            if (slot_res.is_err()) {
+                send_mutex_.unlock();
+                return dp::result::err(slot_res.error());
+            }
+
+            loan_active_ = true;
+            loan_size_ = size;
+            loan_owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            echo::trace("shm loan ", size, " bytes");
+            return dp::result::ok(std::span<dp::u8>(slot_res.value() + sizeof(ShmRecordHeader), size));
+        }
+
+        /// Publish the first length bytes of the outstanding loan as one message
+        dp::Res<void> commit(dp::usize length) {
+            if (!loan_active_) {
+                echo::error("commit called without a loan");
+                return dp::result::err(dp::Error::invalid_argument("no loan outstanding"));
+            }
+            if (length > loan_size_) {
+                echo::error("commit length ", length, " exceeds loan of ", loan_size_, " bytes");
+                return dp::result::err(dp::Error::invalid_argument("commit exceeds loan size"));
+            }
+
+            auto *header = get_header(send_shm_ptr_);
+            dp::u64 head = header->head.load(std::memory_order_relaxed);
+            publish_record(get_data(send_shm_ptr_) + (head % header->ring_size), length);
+
+            loan_active_ = false;
+            loan_size_ = 0;
+            loan_owner_.store(std::thread::id(), std::memory_order_relaxed);
+            send_mutex_.unlock();
+
+            echo::debug("committed ", length, " bytes");
+            return dp::result::ok();
+        }
+
+        /// Publish the whole outstanding loan
+        dp::Res<void> commit() { return commit(loan_size_); }
+
+        /// Drop the outstanding loan without sending anything
+        void cancel_loan() {
+            if (!loan_active_) {
+                return;
+            }
+            loan_active_ = false;
+            loan_size_ = 0;
+            loan_owner_.store(std::thread::id(), std::memory_order_relaxed);
+            send_mutex_.unlock();
+            echo::trace("shm loan cancelled");
+        }
+
+        /// Zero-copy recv: read-only span of the next message, directly in shared memory
+        /// The span stays valid until release(); the producer cannot reuse the space before then
+        dp::Res<std::span<const dp::u8>> recv_view() {
+            if (view_active_) {
+                echo::error("recv_view called while a view is outstanding");
+                return dp::result::err(dp::Error::invalid_argument("view not released"));
+            }
+
+            const dp::u8 *payload = nullptr;
+            dp::u32 flags = 0;
+            auto length_res = next_record(payload, flags, recv_timeout_ms_);
+            if (length_res.is_err()) {
+                return dp::result::err(length_res.error());
+            }
+            if (flags == ShmRecordHeader::LARGE_BEGIN) {
+                // Never whole in the ring; left in place for recv_into()/recv_to()
+                echo::error("recv_view on a message larger than the ring");
+                return dp::result::err(dp::Error::invalid_argument("message larger than ring, use recv_into"));
+            }
+
+            view_active_ = true;
+            view_length_ = length_res.value();
+            if (counters_) {
+                counters_->on_recv(view_length_);
+            }
+            echo::trace("shm view ", view_length_, " bytes");
+            return dp::result::ok(std::span<const dp::u8>(payload, view_length_));
+        }
+
+        /// Return the message from recv_view() to the producer
+        void release() {
+            if (!view_active_ || !recv_shm_ptr_) {
+                return;
+            }
+            consume_record(view_length_);
+            view_active_ = false;
+            view_length_ = 0;
+        }
+
+        /// Messages copied out by recv(), recv_into() and recv_split() count against budget; views and
+        /// recv_to() use memory that is already there and do not
+        dp::Res<void> set_memory_budget(MemoryBudget *budget) override {
+            lease_.release();
+            budget_ = budget;
+            return dp::result::ok();
+        }
+
+        BudgetLease take_lease() override { return std::move(lease_); }
+
+        MemoryBudget *memory_budget() const override { return budget_; }
+
+        /// Only single-record messages are exempted; a large message's data follows its header record
+        void set_budget_exemption(BudgetExemption exempt) override { exempt_ = exempt; }
+
         dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
             recv_timeout_ms_ = timeout_ms;
             echo::trace("set recv timeout to ", timeout_ms, "ms");
@@ -619,10 +1581,22 @@ namespace netpipe {
         }
 
         void close() override {
+            // Owner closed with an outstanding loan - drop it so the send mutex is not left held
+            cancel_loan();
+            view_active_ = false;
+
             if (connected_) {
                 echo::trace("closing shm connection ", conn_id_);
                 connected_ = false;
 
+                // Hang up both rings so the peer's recv and send stop waiting on us
+                for (void *ring : {send_shm_ptr_, recv_shm_ptr_}) {
+                    auto *header = get_header(ring);
+                    header->closed.store(1, std::memory_order_release);
+                    notify(header->data_seq, header->data_waiters);
+                    notify(header->space_seq, header->space_waiters);
+                }
+
                 char s2c_name[256];
                 char c2s_name[256];
                 snprintf(s2c_name, sizeof(s2c_name), "/%s_%llu_s2c", channel_name_.c_str(),
@@ -651,19 +1625,33 @@ namespace netpipe {
                 echo::trace("closing shm listener");
                 listening_ = false;
 
+                unmap_handshake(handshake_, handshake_fd_);
+                handshake_ = nullptr;
+                handshake_fd_ = -1;
                 if (owns_shm_) {
-                    char connq_name[256];
-                    char respq_name[256];
-                    snprintf(connq_name, sizeof(connq_name), "/%s_connq", channel_name_.c_str());
-                    snprintf(respq_name, sizeof(respq_name), "/%s_respq", channel_name_.c_str());
-                    ::shm_unlink(connq_name);
-                    ::shm_unlink(respq_name);
+                    char hs_name[256];
+                    snprintf(hs_name, sizeof(hs_name), "/%s_hs", channel_name_.c_str());
+                    ::shm_unlink(hs_name);
                 }
             }
 
             echo::debug("ShmStream closed");
         }
 
+        /// Change how send/recv wait on this connection (also inherited by connections a listener accepts)
+        void set_wait_strategy(ShmWaitStrategy strategy) { wait_strategy_ = strategy; }
+        ShmWaitStrategy wait_strategy() const { return wait_strategy_; }
+
+        /// A record is published that recv has not consumed yet
+        bool has_pending_input() const override {
+            if (!connected_ || !recv_shm_ptr_) {
+                return false;
+            }
+            const auto *header = get_header(recv_shm_ptr_);
+            return header->head.load(std::memory_order_acquire) != header->tail.load(std::memory_order_relaxed) ||
+                   header->closed.load(std::memory_order_acquire) != 0; // recv reports the hang-up
+        }
+
         bool is_connected() const override { return connected_; }
         bool is_listening() const { return listening_; }
         const dp::String &channel_name() const { return channel_name_; }
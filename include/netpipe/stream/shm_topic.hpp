@@ -0,0 +1,272 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <netpipe/stream/shm.hpp>
+
+namespace netpipe {
+
+    /// Prefix of every record in a topic ring
+    /// Records are [ShmTopicRecord][payload], padded to 8 bytes; sequence counts messages from 0
+    struct ShmTopicRecord {
+        dp::u64 sequence;
+        dp::u32 length;
+        dp::u32 reserved;
+    };
+
+    /// Topic state kept in the header page right after the ShmRingHeader
+    struct ShmTopicHeader {
+        alignas(64) std::atomic<dp::u64> latest; // Start of the newest complete record
+    };
+
+    static_assert(sizeof(ShmRingHeader) + sizeof(ShmTopicHeader) <= 4096, "topic header must fit the header page");
+
+    /// Broadcast topic in shared memory: one publisher, any number of subscribers
+    /// The ring is the same mirrored mapping ShmStream uses, but nobody gives space back - the publisher
+    /// overwrites the oldest records, so a publish costs one copy however many processes read the topic.
+    /// Header cursors: head = bytes published, tail = bytes that may already be overwritten. The publisher
+    /// raises tail before it touches a slot; a subscriber copies a record out and then checks that its start
+    /// is still at or above tail. If it is not, the reader was lapped and skips to the newest message.
+    class ShmPublisher {
+      private:
+        void *shm_ptr_;
+        dp::usize shm_size_;
+        int shm_fd_;
+        char shm_name_[256];
+        dp::u64 sequence_;
+        std::mutex publish_mutex_; // Publishing threads of this process take turns
+
+        static ShmTopicHeader *topic_header(void *shm_ptr) {
+            return reinterpret_cast<ShmTopicHeader *>(ShmStream::get_header(shm_ptr) + 1);
+        }
+
+        friend class ShmSubscriber;
+
+      public:
+        ShmPublisher() : shm_ptr_(nullptr), shm_size_(0), shm_fd_(-1), shm_name_{}, sequence_(0) {}
+        ~ShmPublisher() { close(); }
+
+        ShmPublisher(const ShmPublisher &) = delete;
+        ShmPublisher &operator=(const ShmPublisher &) = delete;
+
+        /// Create the topic; endpoint.size is the ring size (rounded up to whole pages)
+        /// The largest message is the whole ring minus one record header
+        dp::Res<void> create(const ShmEndpoint &endpoint) {
+            if (endpoint.name.size() > 240) {
+                echo::error("shm topic name too long (max 240 chars): ", endpoint.name.size());
+                return dp::result::err(dp::Error::invalid_argument("shm name exceeds limit"));
+            }
+            if (shm_ptr_) {
+                return dp::result::err(dp::Error::invalid_argument("topic already created"));
+            }
+
+            snprintf(shm_name_, sizeof(shm_name_), "/%s_topic", endpoint.name.c_str());
+            if (!ShmStream::create_msg_buffer(shm_name_, endpoint.size, shm_ptr_, shm_size_, shm_fd_,
+                                              endpoint.region)) {
+                shm_ptr_ = nullptr;
+                return dp::result::err(dp::Error::io_error("failed to create shm topic"));
+            }
+            auto *header = ShmStream::get_header(shm_ptr_);
+            header->capacity = static_cast<dp::u32>(header->ring_size - sizeof(ShmTopicRecord));
+            new (&topic_header(shm_ptr_)->latest) std::atomic<dp::u64>(0);
+            sequence_ = 0;
+
+            echo::info("ShmPublisher created topic ", endpoint.name.c_str(), " ring=", header->ring_size);
+            return dp::result::ok();
+        }
+
+        /// Write one message into the ring and wake parked subscribers; never waits for readers
+        dp::Res<void> publish(const dp::u8 *data, dp::usize length) {
+            std::lock_guard<std::mutex> lock(publish_mutex_);
+            if (!shm_ptr_) {
+                return dp::result::err(dp::Error::not_found("topic not created"));
+            }
+            auto *header = ShmStream::get_header(shm_ptr_);
+            if (length > header->capacity) {
+                echo::error("shm topic message too large: ", length, " bytes");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds topic ring size"));
+            }
+
+            dp::u64 record = sizeof(ShmTopicRecord) + ShmStream::align_up(length, 8);
+            dp::u64 head = header->head.load(std::memory_order_relaxed);
+            if (head + record > header->ring_size) {
+                // Claim the bytes about to be overwritten before writing any of them
+                header->tail.store(head + record - header->ring_size, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+
+            dp::u8 *slot = ShmStream::get_data(shm_ptr_) + (head % header->ring_size);
+            ShmTopicRecord prefix{sequence_, static_cast<dp::u32>(length), 0};
+            std::memcpy(slot, &prefix, sizeof(prefix));
+            if (length > 0) {
+                std::memcpy(slot + sizeof(prefix), data, length);
+            }
+            header->head.store(head + record, std::memory_order_release);
+            topic_header(shm_ptr_)->latest.store(head, std::memory_order_release);
+            sequence_++;
+
+            ShmStream::notify(header->data_seq, header->data_waiters);
+            return dp::result::ok();
+        }
+
+        dp::Res<void> publish(const Message &msg) { return publish(msg.data(), msg.size()); }
+
+        /// Largest message publish() accepts; 0 before create()
+        dp::usize max_message_size() const {
+            return shm_ptr_ ? ShmStream::get_header(shm_ptr_)->capacity : 0;
+        }
+
+        dp::u64 published_count() const { return sequence_; }
+
+        bool is_open() const { return shm_ptr_ != nullptr; }
+
+        /// Unlink the topic; subscribers that are attached keep their mapping
+        void close() {
+            if (!shm_ptr_) {
+                return;
+            }
+            ShmStream::close_msg_buffer(shm_ptr_, shm_size_, shm_fd_, shm_name_, true);
+            shm_ptr_ = nullptr;
+            shm_fd_ = -1;
+            echo::debug("ShmPublisher closed");
+        }
+    };
+
+    /// Reader of a ShmPublisher topic with a private cursor; subscribers never write to the ring, so any
+    /// number of them can follow one topic without contending with each other or slowing the publisher
+    class ShmSubscriber {
+      private:
+        void *shm_ptr_;
+        dp::usize shm_size_;
+        int shm_fd_;
+        dp::u64 cursor_;   // Byte position of the next record to read
+        dp::u64 expected_; // Sequence number the next record should carry
+        bool synced_;      // expected_ is known (false until the first message)
+        dp::u64 lapped_;
+        dp::u64 missed_;
+        dp::u32 recv_timeout_ms_;
+        dp::u32 spin_budget_;
+        ShmWaitStrategy wait_strategy_;
+
+        /// Lapped: continue at the newest message (or at the head if that is not ahead of us)
+        void skip_ahead(ShmRingHeader *header) {
+            dp::u64 latest = ShmPublisher::topic_header(shm_ptr_)->latest.load(std::memory_order_acquire);
+            cursor_ = latest > cursor_ ? latest : header->head.load(std::memory_order_acquire);
+            lapped_++;
+            echo::debug("shm subscriber lapped, skipping to ", cursor_);
+        }
+
+      public:
+        ShmSubscriber()
+            : shm_ptr_(nullptr), shm_size_(0), shm_fd_(-1), cursor_(0), expected_(0), synced_(false), lapped_(0),
+              missed_(0), recv_timeout_ms_(0), spin_budget_(ShmStream::MIN_SPIN_BUDGET),
+              wait_strategy_(ShmWaitStrategy::SpinThenFutex) {}
+        ~ShmSubscriber() { close(); }
+
+        ShmSubscriber(const ShmSubscriber &) = delete;
+        ShmSubscriber &operator=(const ShmSubscriber &) = delete;
+
+        /// Attach to a topic by endpoint.name; the subscriber sees messages published from now on
+        /// endpoint.size is ignored, endpoint.wait picks how recv() waits
+        dp::Res<void> attach(const ShmEndpoint &endpoint) {
+            if (endpoint.name.size() > 240) {
+                echo::error("shm topic name too long (max 240 chars): ", endpoint.name.size());
+                return dp::result::err(dp::Error::invalid_argument("shm name exceeds limit"));
+            }
+            close();
+
+            char name[256];
+            snprintf(name, sizeof(name), "/%s_topic", endpoint.name.c_str());
+            if (!ShmStream::attach_msg_buffer(name, shm_ptr_, shm_size_, shm_fd_, endpoint.region)) {
+                shm_ptr_ = nullptr;
+                return dp::result::err(dp::Error::not_found("shm topic not found"));
+            }
+            cursor_ = ShmStream::get_header(shm_ptr_)->head.load(std::memory_order_acquire);
+            synced_ = false;
+            wait_strategy_ = endpoint.wait;
+            echo::debug("ShmSubscriber attached to ", endpoint.name.c_str(), " at ", cursor_);
+            return dp::result::ok();
+        }
+
+        /// Copy the next message into msg, reusing its capacity
+        /// Records overwritten before they were read are skipped and counted in missed_count()
+        dp::Res<void> recv_into(Message &msg) {
+            if (!shm_ptr_) {
+                return dp::result::err(dp::Error::not_found("not attached"));
+            }
+            auto *header = ShmStream::get_header(shm_ptr_);
+            const dp::u8 *data = ShmStream::get_data(shm_ptr_);
+
+            while (true) {
+                auto has_data = [&] { return header->head.load(std::memory_order_acquire) != cursor_; };
+                if (!ShmStream::wait_with(wait_strategy_, has_data, header->data_seq, header->data_waiters,
+                                          spin_budget_, recv_timeout_ms_)) {
+                    return dp::result::err(dp::Error::timeout("recv timeout"));
+                }
+
+                dp::u64 head = header->head.load(std::memory_order_acquire);
+                if (head - cursor_ > header->ring_size ||
+                    cursor_ < header->tail.load(std::memory_order_acquire)) {
+                    skip_ahead(header);
+                    continue;
+                }
+
+                // Optimistic copy, validated below: the publisher may be overwriting this slot right now
+                const dp::u8 *slot = data + (cursor_ % header->ring_size);
+                ShmTopicRecord record;
+                std::memcpy(&record, slot, sizeof(record));
+                bool torn = record.length > header->capacity;
+                if (!torn) {
+                    msg.resize(record.length);
+                    if (record.length > 0) {
+                        std::memcpy(msg.data(), slot + sizeof(record), record.length);
+                    }
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (torn || cursor_ < header->tail.load(std::memory_order_relaxed)) {
+                    skip_ahead(header);
+                    continue;
+                }
+
+                if (synced_ && record.sequence > expected_) {
+                    missed_ += record.sequence - expected_;
+                }
+                expected_ = record.sequence + 1;
+                synced_ = true;
+                cursor_ += sizeof(ShmTopicRecord) + ShmStream::align_up(record.length, 8);
+                return dp::result::ok();
+            }
+        }
+
+        dp::Res<Message> recv() {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        /// 0 waits forever
+        void set_recv_timeout(dp::u32 timeout_ms) { recv_timeout_ms_ = timeout_ms; }
+
+        /// Times this subscriber fell a full ring behind and skipped ahead
+        dp::u64 lapped_count() const { return lapped_; }
+
+        /// Messages skipped because they were overwritten before this subscriber read them
+        dp::u64 missed_count() const { return missed_; }
+
+        bool is_attached() const { return shm_ptr_ != nullptr; }
+
+        void close() {
+            if (!shm_ptr_) {
+                return;
+            }
+            ShmStream::close_msg_buffer(shm_ptr_, shm_size_, shm_fd_, nullptr, false);
+            shm_ptr_ = nullptr;
+            shm_fd_ = -1;
+        }
+    };
+
+} // namespace netpipe
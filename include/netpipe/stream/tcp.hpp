@@ -1,12 +1,20 @@
 #pragma once
 
 #include <netpipe/remote/protocol.hpp>
+#include <netpipe/resolver.hpp>
 #include <netpipe/stream.hpp>
 
 #include <arpa/inet.h>
+#include <chrono>
+#include <deque>
+#include <linux/errqueue.h>
+#include <memory>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -21,13 +29,98 @@ namespace netpipe {
         bool listening_;
         TcpEndpoint local_endpoint_;
         TcpEndpoint remote_endpoint_;
+        FrameReader reader_; // Buffered length-prefix parser for recv()
+        dp::u32 connect_timeout_ms_;
+
+        // A send_zerocopy() message the kernel may still read from
+        // The prefix lives here too: MSG_ZEROCOPY pins every iovec, so it cannot sit on the stack
+        struct ZerocopyBuffer {
+            std::shared_ptr<const Message> message;
+            dp::Array<dp::u8, 4> prefix;
+            dp::u32 last_id; // Notification id of the last sendmsg that used this buffer
+        };
+
+        dp::usize zerocopy_threshold_; // 0 = send_zerocopy() copies like send()
+        dp::u32 zerocopy_next_id_;     // Kernel numbers MSG_ZEROCOPY sendmsg calls from 0 per socket
+        dp::u64 zerocopy_copied_;
+        std::deque<ZerocopyBuffer> zerocopy_pending_; // In send order; deque keeps prefix addresses stable
 
         // Private constructor for accepted connections
         TcpStream(dp::i32 fd, const TcpEndpoint &local, const TcpEndpoint &remote)
-            : fd_(fd), connected_(true), listening_(false), local_endpoint_(local), remote_endpoint_(remote) {
+            : fd_(fd), connected_(true), listening_(false), local_endpoint_(local), remote_endpoint_(remote),
+              connect_timeout_ms_(DEFAULT_CONNECT_TIMEOUT_MS), zerocopy_threshold_(0), zerocopy_next_id_(0),
+              zerocopy_copied_(0) {
             echo::debug("TcpStream created from accepted connection fd=", fd);
         }
 
+        // sendmsg with MSG_ZEROCOPY until iov is consumed; falls back to writev copies on ENOBUFS
+        // Returns whether any zerocopy call succeeded (the buffer then waits for its notification)
+        dp::Res<bool> sendmsg_zerocopy(iovec *iov, dp::i32 iovcnt, dp::usize total, ZerocopyBuffer &buffer) {
+            bool pinned = false;
+            dp::usize sent = 0;
+            while (iovcnt > 0) {
+                msghdr hdr = {};
+                hdr.msg_iov = iov;
+                hdr.msg_iovlen = static_cast<dp::usize>(iovcnt);
+                dp::isize n = ::sendmsg(fd_, &hdr, MSG_ZEROCOPY | MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno == ENOBUFS) {
+                        // Too many notifications outstanding (optmem_max) - copy the rest instead
+                        echo::trace("zerocopy send hit ENOBUFS, copying remaining ", total - sent, " bytes");
+                        auto res = writev_exact(fd_, iov, iovcnt);
+                        if (res.is_err()) {
+                            return dp::result::err(res.error());
+                        }
+                        return dp::result::ok(pinned);
+                    }
+                    return dp::result::err(write_error_from_errno(fd_, total, sent));
+                }
+
+                pinned = true;
+                buffer.last_id = zerocopy_next_id_++;
+                sent += static_cast<dp::usize>(n);
+                dp::usize remaining = static_cast<dp::usize>(n);
+                while (iovcnt > 0 && remaining >= iov->iov_len) {
+                    remaining -= iov->iov_len;
+                    iov++;
+                    iovcnt--;
+                }
+                if (iovcnt > 0) {
+                    iov->iov_base = static_cast<dp::u8 *>(iov->iov_base) + remaining;
+                    iov->iov_len -= remaining;
+                }
+            }
+            return dp::result::ok(pinned);
+        }
+
+        // Socket buffer sizes for large message RPC: 16MB for both send and receive buffers
+        // This improves performance for 100MB+ messages; set before connect/listen so the window scale fits
+        static void configure_buffers(dp::i32 socket_fd) {
+            constexpr dp::i32 BUFFER_SIZE = 16 * 1024 * 1024; // 16MB
+
+            dp::i32 sndbuf = BUFFER_SIZE;
+            if (::setsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
+                echo::warn("setsockopt SO_SNDBUF failed: ", strerror(errno));
+            } else {
+                // Get actual buffer size (kernel may adjust)
+                socklen_t optlen = sizeof(sndbuf);
+                ::getsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &optlen);
+                echo::trace("SO_SNDBUF set to ", sndbuf, " bytes (requested ", BUFFER_SIZE, ")");
+            }
+
+            dp::i32 rcvbuf = BUFFER_SIZE;
+            if (::setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+                echo::warn("setsockopt SO_RCVBUF failed: ", strerror(errno));
+            } else {
+                socklen_t optlen = sizeof(rcvbuf);
+                ::getsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen);
+                echo::trace("SO_RCVBUF set to ", rcvbuf, " bytes (requested ", BUFFER_SIZE, ")");
+            }
+        }
+
         // Helper to configure TCP keepalive for connection health monitoring
         // Detects dead connections automatically after ~90 seconds (60 + 3*10)
         void configure_keepalive(dp::i32 socket_fd) {
@@ -68,7 +161,16 @@ namespace netpipe {
         }
 
       public:
-        TcpStream() : fd_(-1), connected_(false), listening_(false) { echo::trace("TcpStream constructed"); }
+        static constexpr dp::u32 DEFAULT_CONNECT_TIMEOUT_MS = 10000;
+        static constexpr dp::usize MAX_CONNECT_ATTEMPTS = 8;      // Resolved addresses tried per connect
+        static constexpr dp::u32 CONNECT_ATTEMPT_DELAY_MS = 250; // Head start of each attempt (RFC 8305)
+        static constexpr dp::u32 ZEROCOPY_CLOSE_WAIT_MS = 1000;  // close() waits this long for zerocopy releases
+
+        TcpStream()
+            : fd_(-1), connected_(false), listening_(false), connect_timeout_ms_(DEFAULT_CONNECT_TIMEOUT_MS),
+              zerocopy_threshold_(0), zerocopy_next_id_(0), zerocopy_copied_(0) {
+            echo::trace("TcpStream constructed");
+        }
 
         ~TcpStream() override {
             if (fd_ >= 0) {
@@ -76,69 +178,154 @@ namespace netpipe {
             }
         }
 
-        // Client side: connect to remote endpoint
-        dp::Res<void> connect(const TcpEndpoint &endpoint) override {
-            echo::trace("connecting to ", endpoint.to_string());
+        // Client side: connect to remote endpoint, waiting at most connect_timeout()
+        dp::Res<void> connect(const TcpEndpoint &endpoint) override { return connect(endpoint, connect_timeout_ms_); }
 
-            // Create socket
-            fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
-            if (fd_ < 0) {
-                echo::error("socket creation failed: ", strerror(errno));
-                return dp::result::err(dp::Error::io_error(dp::String("socket creation failed: ") + strerror(errno)));
+        // Connect with an explicit timeout in milliseconds (0 leaves it to the kernel's SYN retries)
+        // The host goes through Resolver (cached) and up to MAX_CONNECT_ATTEMPTS of its addresses are dialed
+        // Happy Eyeballs style: families interleaved, each attempt CONNECT_ATTEMPT_DELAY_MS after the last unless
+        // that one fails first, earlier attempts left running; the first to complete wins and the rest are closed
+        dp::Res<void> connect(const TcpEndpoint &endpoint, dp::u32 timeout_ms) {
+            echo::trace("connecting to ", endpoint.to_string());
+            if (fd_ >= 0) {
+                echo::error("connect called on an open socket fd=", fd_);
+                return dp::result::err(dp::Error::invalid_argument("socket already open"));
             }
-            echo::trace("socket created fd=", fd_);
 
-            // Configure socket buffer sizes for large message RPC
-            // Default to 16MB for both send and receive buffers
-            // This improves performance for 100MB+ messages
-            constexpr dp::i32 BUFFER_SIZE = 16 * 1024 * 1024; // 16MB
-
-            dp::i32 sndbuf = BUFFER_SIZE;
-            if (::setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
-                echo::warn("setsockopt SO_SNDBUF failed: ", strerror(errno));
-            } else {
-                // Get actual buffer size (kernel may adjust)
-                socklen_t optlen = sizeof(sndbuf);
-                ::getsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, &optlen);
-                echo::trace("SO_SNDBUF set to ", sndbuf, " bytes (requested ", BUFFER_SIZE, ")");
+            auto resolved = Resolver::instance().resolve(endpoint.host, endpoint.port, AF_UNSPEC, SOCK_STREAM);
+            if (resolved.is_err()) {
+                echo::error("resolving ", endpoint.to_string(), " failed");
+                return dp::result::err(dp::Error::io_error("getaddrinfo failed"));
             }
+            const auto &addresses = resolved.value();
 
-            dp::i32 rcvbuf = BUFFER_SIZE;
-            if (::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
-                echo::warn("setsockopt SO_RCVBUF failed: ", strerror(errno));
-            } else {
-                // Get actual buffer size (kernel may adjust)
-                socklen_t optlen = sizeof(rcvbuf);
-                ::getsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen);
-                echo::trace("SO_RCVBUF set to ", rcvbuf, " bytes (requested ", BUFFER_SIZE, ")");
+            // RFC 8305 order: alternate address families, starting with the one the resolver put first
+            dp::Vector<const ResolvedAddress *> first;
+            dp::Vector<const ResolvedAddress *> second;
+            for (const auto &address : addresses) {
+                (address.family() == addresses[0].family() ? first : second).push_back(&address);
+            }
+            dp::Vector<const ResolvedAddress *> order;
+            for (dp::usize i = 0; i < first.size() || i < second.size(); i++) {
+                if (i < first.size()) {
+                    order.push_back(first[i]);
+                }
+                if (i < second.size()) {
+                    order.push_back(second[i]);
+                }
             }
 
-            // Resolve hostname
-            struct addrinfo hints = {};
-            hints.ai_family = AF_INET;
-            hints.ai_socktype = SOCK_STREAM;
+            pollfd attempts[MAX_CONNECT_ATTEMPTS];
+            dp::usize count = 0;
+            dp::usize next = 0;
+            dp::usize open = 0;
+            dp::i32 winner = -1;
+            dp::i32 last_errno = 0;
+
+            // Start a non-blocking connect to the next address; false once there is none left to try
+            auto start_attempt = [&]() {
+                while (next < order.size() && count < MAX_CONNECT_ATTEMPTS) {
+                    const ResolvedAddress &address = *order[next++];
+                    dp::i32 fd = ::socket(address.family(), SOCK_STREAM | SOCK_NONBLOCK, 0);
+                    if (fd < 0) {
+                        last_errno = errno;
+                        continue;
+                    }
+                    configure_buffers(fd);
+                    if (::connect(fd, address.sockaddr_ptr(), address.length) == 0) {
+                        winner = fd; // Loopback can complete at once
+                        return true;
+                    }
+                    if (errno == EINPROGRESS) {
+                        attempts[count++] = {fd, POLLOUT, 0};
+                        open++;
+                        echo::trace("connect attempt to ", address.to_string().c_str(), " fd=", fd);
+                        return true;
+                    }
+                    last_errno = errno;
+                    ::close(fd);
+                }
+                return false;
+            };
+
+            // The next address is dialed when the last attempt fails or has had CONNECT_ATTEMPT_DELAY_MS
+            // without completing, so a reachable first address is the only connection the server sees
+            auto now = std::chrono::steady_clock::now();
+            auto deadline = now + std::chrono::milliseconds(timeout_ms);
+            auto next_attempt = now;
+            bool timed_out = false;
+            while (winner < 0) {
+                now = std::chrono::steady_clock::now();
+                if (now >= next_attempt && start_attempt()) {
+                    next_attempt = now + std::chrono::milliseconds(CONNECT_ATTEMPT_DELAY_MS);
+                    if (winner >= 0) {
+                        break;
+                    }
+                }
+                bool more = next < order.size() && count < MAX_CONNECT_ATTEMPTS;
+                if (open == 0 && !more) {
+                    break;
+                }
+                if (timeout_ms > 0 && now >= deadline) {
+                    timed_out = true;
+                    last_errno = ETIMEDOUT;
+                    break;
+                }
 
-            struct addrinfo *result = nullptr;
-            dp::String port_str(std::to_string(endpoint.port).c_str());
-            dp::i32 ret = ::getaddrinfo(endpoint.host.c_str(), port_str.c_str(), &hints, &result);
-            if (ret != 0) {
-                ::close(fd_);
-                fd_ = -1;
-                echo::error("getaddrinfo failed for ", endpoint.to_string(), ": ", gai_strerror(ret));
-                return dp::result::err(dp::Error::io_error("getaddrinfo failed"));
+                dp::i32 wait_ms = -1;
+                if (timeout_ms > 0) {
+                    wait_ms = static_cast<dp::i32>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+                }
+                if (more) {
+                    auto until_next = std::chrono::duration_cast<std::chrono::milliseconds>(next_attempt - now);
+                    dp::i32 next_ms = until_next.count() > 0 ? static_cast<dp::i32>(until_next.count()) : 0;
+                    wait_ms = wait_ms < 0 || next_ms < wait_ms ? next_ms : wait_ms;
+                }
+                dp::i32 ready = ::poll(attempts, count, wait_ms);
+                if (ready < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (ready < 0) {
+                    last_errno = errno;
+                    break;
+                }
+                for (dp::usize i = 0; i < count && winner < 0 && ready > 0; i++) {
+                    if (attempts[i].fd < 0 || attempts[i].revents == 0) {
+                        continue;
+                    }
+                    dp::i32 error = 0;
+                    socklen_t len = sizeof(error);
+                    ::getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &error, &len);
+                    if (error == 0) {
+                        winner = attempts[i].fd;
+                    } else {
+                        last_errno = error;
+                        ::close(attempts[i].fd);
+                        open--;
+                        next_attempt = now; // A failed attempt hands over to the next address at once
+                    }
+                    attempts[i].fd = -1; // poll ignores negative fds
+                }
+            }
+            for (dp::usize i = 0; i < count; i++) {
+                if (attempts[i].fd >= 0) {
+                    ::close(attempts[i].fd);
+                }
             }
 
-            // Try to connect
-            ret = ::connect(fd_, result->ai_addr, result->ai_addrlen);
-            ::freeaddrinfo(result);
-
-            if (ret < 0) {
-                ::close(fd_);
-                fd_ = -1;
-                echo::error("connect failed to ", endpoint.to_string(), ": ", strerror(errno));
+            if (winner < 0) {
+                echo::error("connect failed to ", endpoint.to_string(), ": ", strerror(last_errno));
+                if (timed_out) {
+                    return dp::result::err(dp::Error::timeout("connect timed out"));
+                }
                 return dp::result::err(dp::Error::io_error("connect failed"));
             }
 
+            // Back to blocking mode - send/recv rely on it
+            ::fcntl(winner, F_SETFL, ::fcntl(winner, F_GETFL) & ~O_NONBLOCK);
+            fd_ = winner;
+
             // Enable TCP_NODELAY to disable Nagle's algorithm for low-latency RPC
             dp::i32 flag = 1;
             if (::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) < 0) {
@@ -153,18 +340,44 @@ namespace netpipe {
 
             connected_ = true;
             remote_endpoint_ = endpoint;
+            stats_socket(fd_);
             echo::debug("connected to ", endpoint.to_string());
             echo::info("TcpStream connected to ", endpoint.to_string());
 
             return dp::result::ok();
         }
 
+        // Timeout connect(endpoint) uses; DEFAULT_CONNECT_TIMEOUT_MS unless changed, 0 means no timeout
+        void set_connect_timeout(dp::u32 timeout_ms) { connect_timeout_ms_ = timeout_ms; }
+
+        dp::u32 connect_timeout() const { return connect_timeout_ms_; }
+
         // Server side: bind and listen
         dp::Res<void> listen(const TcpEndpoint &endpoint) override {
             echo::trace("listening on ", endpoint.to_string());
 
+            // Parse the bind address first - it decides the socket family
+            // "0.0.0.0" or "" binds every IPv4 address, "::" every IPv6 (and IPv4-mapped) address
+            struct sockaddr_storage addr = {};
+            socklen_t addr_len = sizeof(struct sockaddr_in);
+            if (endpoint.host == "0.0.0.0" || endpoint.host.empty()) {
+                auto *in4 = reinterpret_cast<struct sockaddr_in *>(&addr);
+                in4->sin_family = AF_INET;
+                in4->sin_port = htons(endpoint.port);
+                in4->sin_addr.s_addr = INADDR_ANY;
+            } else {
+                auto numeric = Resolver::parse_numeric(endpoint.host, endpoint.port);
+                if (numeric.is_err()) {
+                    echo::error("invalid address: ", endpoint.host.c_str());
+                    return dp::result::err(
+                        dp::Error::invalid_argument(dp::String("invalid IP address: ") + endpoint.host));
+                }
+                addr = numeric.value().addr;
+                addr_len = numeric.value().length;
+            }
+
             // Create socket
-            fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+            fd_ = ::socket(addr.ss_family, SOCK_STREAM, 0);
             if (fd_ < 0) {
                 echo::error("socket creation failed: ", strerror(errno));
                 return dp::result::err(dp::Error::io_error(dp::String("socket creation failed: ") + strerror(errno)));
@@ -172,26 +385,7 @@ namespace netpipe {
             echo::trace("socket created fd=", fd_);
 
             // Configure socket buffer sizes for large message RPC
-            // Default to 16MB for both send and receive buffers
-            constexpr dp::i32 BUFFER_SIZE = 16 * 1024 * 1024; // 16MB
-
-            dp::i32 sndbuf = BUFFER_SIZE;
-            if (::setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
-                echo::warn("setsockopt SO_SNDBUF failed: ", strerror(errno));
-            } else {
-                socklen_t optlen = sizeof(sndbuf);
-                ::getsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, &optlen);
-                echo::trace("SO_SNDBUF set to ", sndbuf, " bytes (requested ", BUFFER_SIZE, ")");
-            }
-
-            dp::i32 rcvbuf = BUFFER_SIZE;
-            if (::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
-                echo::warn("setsockopt SO_RCVBUF failed: ", strerror(errno));
-            } else {
-                socklen_t optlen = sizeof(rcvbuf);
-                ::getsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen);
-                echo::trace("SO_RCVBUF set to ", rcvbuf, " bytes (requested ", BUFFER_SIZE, ")");
-            }
+            configure_buffers(fd_);
 
             // Set SO_REUSEADDR to avoid "address already in use" errors
             dp::i32 opt = 1;
@@ -205,23 +399,7 @@ namespace netpipe {
             configure_keepalive(fd_);
 
             // Bind to address
-            struct sockaddr_in addr = {};
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(endpoint.port);
-
-            if (endpoint.host == "0.0.0.0" || endpoint.host.empty()) {
-                addr.sin_addr.s_addr = INADDR_ANY;
-            } else {
-                if (::inet_pton(AF_INET, endpoint.host.c_str(), &addr.sin_addr) <= 0) {
-                    ::close(fd_);
-                    fd_ = -1;
-                    echo::error("invalid address: ", endpoint.host.c_str());
-                    return dp::result::err(
-                        dp::Error::invalid_argument(dp::String("invalid IP address: ") + endpoint.host));
-                }
-            }
-
-            if (::bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            if (::bind(fd_, (struct sockaddr *)&addr, addr_len) < 0) {
                 ::close(fd_);
                 fd_ = -1;
                 echo::error("bind failed on ", endpoint.to_string(), ": ", strerror(errno));
@@ -253,7 +431,7 @@ namespace netpipe {
 
             echo::trace("waiting for connection on fd=", fd_);
 
-            struct sockaddr_in client_addr = {};
+            struct sockaddr_storage client_addr = {};
             socklen_t client_len = sizeof(client_addr);
 
             dp::i32 client_fd = ::accept(fd_, (struct sockaddr *)&client_addr, &client_len);
@@ -275,9 +453,17 @@ namespace netpipe {
             configure_keepalive(client_fd);
 
             // Get client address
-            char client_ip[INET_ADDRSTRLEN];
-            ::inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
-            dp::u16 client_port = ntohs(client_addr.sin_port);
+            char client_ip[INET6_ADDRSTRLEN];
+            dp::u16 client_port = 0;
+            if (client_addr.ss_family == AF_INET6) {
+                const auto *in6 = reinterpret_cast<const struct sockaddr_in6 *>(&client_addr);
+                ::inet_ntop(AF_INET6, &in6->sin6_addr, client_ip, sizeof(client_ip));
+                client_port = ntohs(in6->sin6_port);
+            } else {
+                const auto *in4 = reinterpret_cast<const struct sockaddr_in *>(&client_addr);
+                ::inet_ntop(AF_INET, &in4->sin_addr, client_ip, sizeof(client_ip));
+                client_port = ntohs(in4->sin_port);
+            }
 
             TcpEndpoint client_endpoint{dp::String(client_ip), client_port};
 
@@ -286,44 +472,323 @@ namespace netpipe {
 
             // Create new TcpStream for the client
             auto client_stream = std::unique_ptr<Stream>(new TcpStream(client_fd, local_endpoint_, client_endpoint));
+            (void)client_stream->set_memory_budget(reader_.budget());
+            inherit_stats(*client_stream);
 
             return dp::result::ok(std::move(client_stream));
         }
 
         // Send a message with length-prefix framing
         dp::Res<void> send(const Message &msg) override {
+            iovec part{const_cast<dp::u8 *>(msg.data()), msg.size()};
+            return send_iov(std::span<const iovec>(&part, 1));
+        }
+
+        // Send several buffers as one length-prefixed message
+        // Length prefix and all parts go out in a single writev - no gathering copy
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
             if (!connected_ || fd_ < 0) {
                 echo::trace("send called but not connected");
                 return dp::result::err(dp::Error::not_found("not connected"));
             }
 
-            echo::trace("send ", msg.size(), " bytes");
+            if (parts.size() > MAX_IOV_PARTS) {
+                return Stream::send_iov(parts);
+            }
+
+            dp::usize total = 0;
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
+
+            echo::trace("send ", total, " bytes");
 
             // Encode length prefix (4 bytes big-endian)
-            auto length_bytes = encode_u32_be(static_cast<dp::u32>(msg.size()));
+            auto length_bytes = encode_u32_be(static_cast<dp::u32>(total));
 
-            // Send length prefix
-            auto res = write_exact(fd_, length_bytes.data(), 4);
+            iovec iov[MAX_IOV_PARTS + 1];
+            iov[0] = {length_bytes.data(), length_bytes.size()};
+            for (dp::usize i = 0; i < parts.size(); i++) {
+                iov[i + 1] = parts[i];
+            }
+
+            auto res = writev_exact(fd_, iov, static_cast<dp::i32>(parts.size() + 1), counters_.get());
             if (res.is_err()) {
                 connected_ = false;
-                echo::trace("send length failed: ", res.error().message.c_str());
+                echo::trace("send failed: ", res.error().message.c_str());
                 return res;
             }
+            if (counters_) {
+                counters_->on_send(total);
+            }
 
-            // Send payload
-            if (!msg.empty()) {
-                res = write_exact(fd_, msg.data(), msg.size());
-                if (res.is_err()) {
-                    connected_ = false;
-                    echo::trace("send payload failed: ", res.error().message.c_str());
-                    return res;
+            echo::debug("sent ", total, " bytes");
+            return dp::result::ok();
+        }
+
+        // The length prefix goes into the caller's headroom: one write(2) for prefix and message
+        dp::Res<void> send_prefixed(dp::u8 *buffer, dp::usize length) override {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("send called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+            if (length < STREAM_PREFIX_SIZE) {
+                return dp::result::err(dp::Error::invalid_argument("buffer has no prefix headroom"));
+            }
+
+            auto length_bytes = encode_u32_be(static_cast<dp::u32>(length - STREAM_PREFIX_SIZE));
+            std::memcpy(buffer, length_bytes.data(), STREAM_PREFIX_SIZE);
+            auto res = write_exact(fd_, buffer, length, counters_.get());
+            if (res.is_err()) {
+                connected_ = false;
+                echo::trace("send failed: ", res.error().message.c_str());
+                return res;
+            }
+            if (counters_) {
+                counters_->on_send(length - STREAM_PREFIX_SIZE);
+            }
+
+            echo::debug("sent ", length - STREAM_PREFIX_SIZE, " bytes");
+            return dp::result::ok();
+        }
+
+        // Send length bytes of file_fd starting at offset as one length-prefixed message
+        // The body moves with sendfile(2) (splice(2) when file_fd is a pipe, whose offset must be 0), so it is
+        // never copied into userspace and no Message is allocated. The file position of file_fd is not changed.
+        dp::Res<void> send_file(dp::i32 file_fd, dp::u64 offset, dp::usize length) {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("send called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+            if (length > remote::MAX_MESSAGE_SIZE) {
+                echo::error("send_file length too large: ", length, " bytes");
+                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+            }
+            struct stat st = {};
+            if (::fstat(file_fd, &st) < 0) {
+                echo::error("send_file on bad descriptor: ", strerror(errno));
+                return dp::result::err(dp::Error::invalid_argument("bad file descriptor"));
+            }
+            bool pipe = S_ISFIFO(st.st_mode);
+            if (pipe && offset != 0) {
+                return dp::result::err(dp::Error::invalid_argument("pipes have no offset"));
+            }
+            if (!pipe && offset + length > static_cast<dp::u64>(st.st_size)) {
+                echo::error("send_file range past end of file: ", offset + length, " > ", st.st_size);
+                return dp::result::err(dp::Error::invalid_argument("range past end of file"));
+            }
+
+            // MSG_MORE holds the prefix back so it shares a segment with the start of the body
+            auto length_bytes = encode_u32_be(static_cast<dp::u32>(length));
+            dp::isize n;
+            do {
+                n = ::send(fd_, length_bytes.data(), length_bytes.size(), MSG_MORE | MSG_NOSIGNAL);
+            } while (n < 0 && errno == EINTR);
+            dp::Res<void> res = dp::result::ok();
+            if (n < 0) {
+                res = dp::result::err(write_error_from_errno(fd_, 4, 0));
+            } else if (n < 4) {
+                res = write_exact(fd_, length_bytes.data() + n, 4 - static_cast<dp::usize>(n));
+            }
+
+            if (res.is_ok() && pipe) {
+                res = splice_exact(file_fd, fd_, length);
+            } else if (res.is_ok()) {
+                off_t position = static_cast<off_t>(offset);
+                dp::usize sent = 0;
+                while (sent < length) {
+                    dp::isize m = ::sendfile(fd_, file_fd, &position, length - sent);
+                    if (m < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (m < 0) {
+                        res = dp::result::err(write_error_from_errno(fd_, length, sent));
+                        break;
+                    }
+                    if (m == 0) {
+                        // Truncated while we were sending; the peer is left mid-frame
+                        res = dp::result::err(dp::Error::io_error("file ended before length bytes"));
+                        break;
+                    }
+                    sent += static_cast<dp::usize>(m);
+                }
+            }
+
+            if (res.is_err()) {
+                connected_ = false;
+                echo::trace("send_file failed: ", res.error().message.c_str());
+                return res;
+            }
+            if (counters_) {
+                counters_->on_send(length);
+            }
+            echo::debug("sent ", length, " bytes from fd=", file_fd);
+            return dp::result::ok();
+        }
+
+        // Send several length-prefixed messages, packing as many as fit into each writev
+        dp::Res<void> send_batch(std::span<const std::span<const iovec>> frames) override {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("send_batch called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+            for (const auto &parts : frames) {
+                if (parts.size() > MAX_IOV_PARTS) {
+                    return Stream::send_batch(frames);
                 }
             }
 
-            echo::debug("sent ", msg.size(), " bytes");
+            auto res = writev_frames(fd_, frames, counters_.get());
+            if (res.is_err()) {
+                connected_ = false;
+                echo::trace("send_batch failed: ", res.error().message.c_str());
+                return res;
+            }
+            if (counters_) {
+                counters_->on_send_batch(frames.size(), frames_size(frames));
+            }
+            echo::debug("sent batch of ", frames.size(), " messages");
             return dp::result::ok();
         }
 
+        // Let messages of at least threshold bytes sent with send_zerocopy() go out with MSG_ZEROCOPY
+        // The kernel pins their pages instead of copying them into the socket buffer, and reports completion
+        // through the error queue. Enables SO_ZEROCOPY on the connected socket; 0 turns the zerocopy path off.
+        // Pinning and notifications have a fixed cost, so this pays off for messages of tens of KB and up.
+        dp::Res<void> set_zerocopy(dp::usize threshold) {
+            if (fd_ < 0) {
+                echo::error("set_zerocopy called but socket not created");
+                return dp::result::err(dp::Error::invalid_argument("socket not created"));
+            }
+            if (threshold > 0) {
+                dp::i32 one = 1;
+                if (::setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+                    echo::warn("setsockopt SO_ZEROCOPY failed: ", strerror(errno));
+                    return dp::result::err(
+                        dp::Error::io_error(dp::String("SO_ZEROCOPY not supported: ") + strerror(errno)));
+                }
+            }
+            zerocopy_threshold_ = threshold;
+            echo::debug("zerocopy threshold set to ", threshold, " bytes on fd=", fd_);
+            return dp::result::ok();
+        }
+
+        dp::usize zerocopy_threshold() const { return zerocopy_threshold_; }
+
+        // Send a message whose buffer the stream keeps alive until the kernel is done with it
+        // Returns once the bytes are queued, not sent: the message must not be modified until it is released,
+        // which reap_zerocopy()/flush_zerocopy() do as notifications arrive. Below the threshold this is send().
+        dp::Res<void> send_zerocopy(std::shared_ptr<const Message> msg) {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("send called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+            if (zerocopy_threshold_ == 0 || msg->size() < zerocopy_threshold_) {
+                return send(*msg);
+            }
+            reap_zerocopy();
+
+            zerocopy_pending_.push_back({std::move(msg), {}, 0});
+            ZerocopyBuffer &buffer = zerocopy_pending_.back();
+            dp::usize total = buffer.message->size();
+            buffer.prefix = encode_u32_be(static_cast<dp::u32>(total));
+
+            iovec iov[2] = {{buffer.prefix.data(), buffer.prefix.size()},
+                            {const_cast<dp::u8 *>(buffer.message->data()), total}};
+            auto res = sendmsg_zerocopy(iov, 2, total + 4, buffer);
+            if (res.is_err()) {
+                zerocopy_pending_.pop_back();
+                connected_ = false;
+                echo::trace("send failed: ", res.error().message.c_str());
+                return dp::result::err(res.error());
+            }
+            if (!res.value()) {
+                zerocopy_pending_.pop_back(); // Everything was copied, nothing to wait for
+            }
+            if (counters_) {
+                counters_->on_send(total);
+            }
+
+            echo::debug("sent ", total, " bytes with MSG_ZEROCOPY");
+            return dp::result::ok();
+        }
+
+        // Drain completion notifications and release the buffers the kernel no longer needs; never blocks
+        // Returns the number of buffers released
+        dp::usize reap_zerocopy() {
+            dp::usize released = 0;
+            while (!zerocopy_pending_.empty() && fd_ >= 0) {
+                alignas(cmsghdr) char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+                msghdr hdr = {};
+                hdr.msg_control = control;
+                hdr.msg_controllen = sizeof(control);
+                if (::recvmsg(fd_, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                    break; // EAGAIN: no notification queued
+                }
+
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+                    bool recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                                   (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+                    if (!recverr) {
+                        continue;
+                    }
+                    sock_extended_err err;
+                    std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                    if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) {
+                        continue;
+                    }
+
+                    // [ee_info, ee_data] is a range of completed sendmsg calls
+                    if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                        zerocopy_copied_ += err.ee_data - err.ee_info + 1;
+                    }
+                    while (!zerocopy_pending_.empty() &&
+                           static_cast<dp::i32>(zerocopy_pending_.front().last_id - err.ee_data) <= 0) {
+                        zerocopy_pending_.pop_front();
+                        released++;
+                    }
+                }
+            }
+            return released;
+        }
+
+        // Wait until every send_zerocopy() buffer is released (timeout_ms 0 waits forever)
+        dp::Res<void> flush_zerocopy(dp::u32 timeout_ms = 0) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while (true) {
+                reap_zerocopy();
+                if (zerocopy_pending_.empty()) {
+                    return dp::result::ok();
+                }
+                if (fd_ < 0) {
+                    return dp::result::err(dp::Error::not_found("not connected"));
+                }
+
+                dp::i32 wait_ms = -1;
+                if (timeout_ms > 0) {
+                    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now());
+                    if (left.count() <= 0) {
+                        return dp::result::err(dp::Error::timeout("zerocopy completions pending"));
+                    }
+                    wait_ms = static_cast<dp::i32>(left.count());
+                }
+                pollfd pfd{fd_, 0, 0}; // POLLERR is always reported: a notification is queued
+                ::poll(&pfd, 1, wait_ms);
+            }
+        }
+
+        // Buffers sent with send_zerocopy() that the kernel has not released yet
+        dp::usize zerocopy_pending() const { return zerocopy_pending_.size(); }
+
+        // Zerocopy sends the kernel copied after all (loopback, or a device without scatter-gather)
+        dp::u64 zerocopy_copied() const { return zerocopy_copied_; }
+
+        // Buffered frame bytes count as input - the fd alone would miss them
+        bool has_pending_input() const override {
+            return connected_ && fd_ >= 0 && (reader_.buffered() > 0 || fd_readable(fd_));
+        }
+
         // Receive a message with length-prefix framing
         // TIMEOUT HANDLING:
         // - Timeouts are expected behavior (not errors) when using set_recv_timeout()
@@ -331,6 +796,16 @@ namespace netpipe {
         // - Only fatal errors (connection closed, I/O errors) mark connection as disconnected
         // - This allows RPC to implement request timeouts without breaking the connection
         dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        // Receive into a caller-owned buffer, reusing its capacity
+        dp::Res<void> recv_into(Message &msg) override {
             if (!connected_ || fd_ < 0) {
                 echo::trace("recv called but not connected");
                 return dp::result::err(dp::Error::not_found("not connected"));
@@ -338,59 +813,95 @@ namespace netpipe {
 
             echo::trace("recv waiting for message");
 
-            // Read length prefix (4 bytes)
-            dp::Array<dp::u8, 4> length_bytes;
-            auto res = read_exact(fd_, length_bytes.data(), 4);
+            auto res = reader_.read_frame_into(fd_, remote::MAX_MESSAGE_SIZE, msg);
             if (res.is_err()) {
                 // Only mark as disconnected for non-timeout errors
                 // Timeout is expected behavior - connection stays alive
                 if (res.error().code != dp::Error::TIMEOUT) {
+                    echo::trace("recv failed: ", res.error().message.c_str());
                     connected_ = false;
-                    echo::trace("recv length failed: ", res.error().message.c_str());
                 }
-                return dp::result::err(res.error());
+                return res;
+            }
+            if (counters_) {
+                counters_->on_recv(msg.size());
             }
 
-            dp::u32 length = decode_u32_be(length_bytes.data());
-            echo::trace("recv expecting ", length, " bytes");
+            echo::debug("received ", msg.size(), " bytes");
+            return dp::result::ok();
+        }
 
-            // Validate message size before allocating
-            if (length > remote::MAX_MESSAGE_SIZE) {
-                echo::error("received message too large: ", length, " bytes (max: ", remote::MAX_MESSAGE_SIZE, ")");
-                connected_ = false;
-                return dp::result::err(dp::Error::invalid_argument("message exceeds maximum size"));
+        // Receive with the first prefix_len bytes split off into prefix (see Stream::recv_split)
+        dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) override {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("recv called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
             }
 
-            // Allocate message buffer with exception handling
-            Message msg;
-            try {
-                msg.resize(length);
-            } catch (const std::bad_alloc &e) {
-                echo::error("failed to allocate message buffer: ", length, " bytes - ", e.what());
-                connected_ = false;
-                return dp::result::err(dp::Error::io_error("memory allocation failed"));
-            } catch (const std::exception &e) {
-                echo::error("unexpected error allocating message buffer: ", e.what());
-                connected_ = false;
-                return dp::result::err(dp::Error::io_error("allocation error"));
-            }
-            if (length > 0) {
-                res = read_exact(fd_, msg.data(), length);
-                if (res.is_err()) {
-                    // Only mark as disconnected for non-timeout errors
-                    // Timeout during payload read keeps connection alive
-                    if (res.error().code != dp::Error::TIMEOUT) {
-                        connected_ = false;
-                        echo::trace("recv payload failed: ", res.error().message.c_str());
-                    }
-                    return dp::result::err(res.error());
+            echo::trace("recv waiting for message");
+
+            auto res = reader_.read_frame_split(fd_, remote::MAX_MESSAGE_SIZE, prefix, prefix_len, rest);
+            if (res.is_err()) {
+                // Only mark as disconnected for non-timeout errors
+                if (res.error().code != dp::Error::TIMEOUT) {
+                    echo::trace("recv failed: ", res.error().message.c_str());
+                    connected_ = false;
                 }
+                return res;
+            }
+            if (counters_) {
+                counters_->on_recv(res.value() + rest.size());
             }
 
-            echo::debug("received ", length, " bytes");
-            return dp::result::ok(std::move(msg));
+            echo::debug("received ", res.value() + rest.size(), " bytes");
+            return res;
         }
 
+        // Receive one message straight into out_fd (a file, pipe or socket) at its current position
+        // The counterpart of send_file(): the payload is spliced out of the socket without a Message
+        // After a timeout mid-message, call again with the same out_fd: it carries on where the last call stopped
+        // @return The number of bytes written
+        dp::Res<dp::u64> recv_to_fd(dp::i32 out_fd) {
+            if (!connected_ || fd_ < 0) {
+                echo::trace("recv called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+
+            auto res = reader_.read_frame_to_fd(fd_, remote::MAX_MESSAGE_SIZE, out_fd);
+            if (res.is_err()) {
+                if (res.error().code != dp::Error::TIMEOUT) {
+                    echo::trace("recv failed: ", res.error().message.c_str());
+                    connected_ = false;
+                }
+                return res;
+            }
+            if (counters_) {
+                counters_->on_recv(res.value());
+            }
+
+            echo::debug("received ", res.value(), " bytes into fd=", out_fd);
+            return res;
+        }
+
+        // Size of the per-connection receive buffer (FrameReader::DEFAULT_CAPACITY by default)
+        // Small frames are parsed out of one read(2); 0 disables buffering
+        // Fails while received bytes are still pending in the buffer
+        dp::Res<void> set_recv_buffer_size(dp::usize bytes) { return reader_.set_capacity(bytes); }
+
+        dp::usize recv_buffer_size() const { return reader_.capacity(); }
+
+        // Frame lengths are reserved in the budget before their buffer is allocated (see FrameReader)
+        dp::Res<void> set_memory_budget(MemoryBudget *budget) override {
+            reader_.set_budget(budget);
+            return dp::result::ok();
+        }
+
+        BudgetLease take_lease() override { return reader_.take_lease(); }
+
+        MemoryBudget *memory_budget() const override { return reader_.budget(); }
+
+        void set_budget_exemption(BudgetExemption exempt) override { reader_.set_exemption(exempt); }
+
         // Set receive timeout in milliseconds
         dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
             if (fd_ < 0) {
@@ -412,20 +923,45 @@ namespace netpipe {
             return dp::result::ok();
         }
 
+        // Let a blocking recv busy-poll the device queue for up to usec before sleeping (SO_BUSY_POLL)
+        // Values above net.core.busy_poll need CAP_NET_ADMIN; loopback has no queue to poll, so it gains nothing
+        dp::Res<void> set_busy_poll(dp::u32 usec) {
+            if (fd_ < 0) {
+                return dp::result::err(dp::Error::invalid_argument("socket not created"));
+            }
+            return netpipe::set_busy_poll(fd_, usec);
+        }
+
         // Close the connection
         void close() override {
             if (fd_ >= 0) {
                 echo::trace("closing fd=", fd_);
+                if (!zerocopy_pending_.empty() && flush_zerocopy(ZEROCOPY_CLOSE_WAIT_MS).is_err()) {
+                    // The kernel would go on sending from buffers we are about to release: reset the
+                    // connection instead, which drops whatever it has not sent yet
+                    linger reset{1, 0};
+                    ::setsockopt(fd_, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+                    echo::warn("closing with ", zerocopy_pending_.size(), " zerocopy sends pending, resetting");
+                }
+                stats_socket(-1);
                 ::close(fd_);
                 fd_ = -1;
                 connected_ = false;
                 listening_ = false;
+                reader_.reset();
+                zerocopy_pending_.clear();
                 echo::debug("TcpStream closed");
             }
         }
 
         // Check if connected
         bool is_connected() const override { return connected_; }
+
+        // Socket fd (listening or connected), -1 when closed
+        dp::i32 native_handle() const override { return fd_; }
+
+      protected:
+        void stats_attached(TransportCounters *counters) override { reader_.set_counters(counters); }
     };
 
 } // namespace netpipe
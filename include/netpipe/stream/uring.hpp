@@ -0,0 +1,488 @@
+#pragma once
+
+#include <mutex>
+#include <netpipe/remote/protocol.hpp>
+#include <netpipe/stream.hpp>
+#include <netpipe/stream/tcp.hpp>
+#include <netpipe/uring.hpp>
+
+#include <sys/socket.h>
+
+namespace netpipe {
+
+    // io_uring data path over a TcpStream or IpcStream
+    // The wrapped stream sets up the connection; bytes then move through two rings:
+    //   - receive: one multishot recv into a ring of provided buffers, re-armed only when the kernel ends it
+    //   - send: IORING_OP_SENDMSG straight from the caller's buffers (length prefix + parts, no gathering copy)
+    // Same length-prefixed framing as TcpStream/IpcStream, so either end can use the plain stream
+    class UringStream : public Stream {
+      private:
+        std::unique_ptr<Stream> inner_;
+        dp::i32 fd_;
+        bool connected_;
+        dp::i32 timeout_ms_; // -1 = block forever
+
+        dp::u32 buffer_count_;
+        dp::u32 buffer_size_;
+
+        // Receive side - used only by the receiving thread
+        IoUring recv_ring_;
+        ProvidedBuffers buffers_;
+        bool recv_armed_; // A multishot recv is outstanding
+
+        bool chunk_active_; // A completed buffer still holds unconsumed bytes
+        dp::u16 chunk_id_;
+        dp::usize chunk_offset_;
+        dp::usize chunk_length_;
+
+        // Frame being assembled; survives a timeout so the next recv resumes it
+        dp::u8 length_bytes_[4];
+        dp::usize length_have_;
+        bool in_frame_;
+        dp::u32 frame_length_;
+        dp::usize frame_have_;
+        dp::usize split_;       // Bytes of the frame routed to head_ (prefix of recv_split)
+        dp::Vector<dp::u8> head_;
+        Message body_;
+
+        // Send side - serialized by send_mutex_
+        IoUring send_ring_;
+        std::mutex send_mutex_;
+
+        static constexpr dp::u64 RECV_TAG = 1;
+        static constexpr dp::u64 SEND_TAG = 2;
+        static constexpr dp::u16 BUFFER_GROUP = 0;
+
+        // Create both rings for the connected inner stream
+        dp::Res<void> attach() {
+            fd_ = inner_->native_handle();
+            if (fd_ < 0) {
+                return dp::result::err(dp::Error::invalid_argument("stream has no file descriptor"));
+            }
+
+            auto res = recv_ring_.init(8);
+            if (res.is_ok()) {
+                res = buffers_.init(recv_ring_, buffer_count_, buffer_size_, BUFFER_GROUP);
+            }
+            if (res.is_ok()) {
+                res = send_ring_.init(8);
+            }
+            if (res.is_err()) {
+                detach();
+                return res;
+            }
+
+            connected_ = true;
+            echo::debug("UringStream attached fd=", fd_, " buffers=", buffer_count_, "x", buffer_size_);
+            return dp::result::ok();
+        }
+
+        void detach() {
+            connected_ = false;
+            recv_armed_ = false;
+            chunk_active_ = false;
+            length_have_ = 0;
+            in_frame_ = false;
+            send_ring_.close();
+            recv_ring_.close();
+            buffers_.release();
+            fd_ = -1;
+        }
+
+        dp::Res<void> arm_recv() {
+            io_uring_sqe *sqe = recv_ring_.get_sqe();
+            if (sqe == nullptr) {
+                return dp::result::err(dp::Error::io_error("io_uring submission queue full"));
+            }
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = fd_;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = BUFFER_GROUP;
+            sqe->user_data = RECV_TAG;
+            recv_armed_ = true;
+            return dp::result::ok();
+        }
+
+        // Make chunk_* describe a filled receive buffer, waiting for one if needed
+        dp::Res<void> next_chunk() {
+            while (true) {
+                if (!recv_armed_) {
+                    auto arm = arm_recv();
+                    if (arm.is_err()) {
+                        return arm;
+                    }
+                }
+
+                io_uring_cqe *cqe = recv_ring_.peek_cqe();
+                if (cqe == nullptr) {
+                    auto wait = recv_ring_.enter(1, timeout_ms_);
+                    if (wait.is_err()) {
+                        return wait;
+                    }
+                    continue;
+                }
+
+                dp::i32 res = cqe->res;
+                dp::u32 flags = cqe->flags;
+                recv_ring_.cqe_seen();
+
+                if (!(flags & IORING_CQE_F_MORE)) {
+                    recv_armed_ = false; // Multishot ended - re-armed on the next pass
+                }
+                if (res == -ENOBUFS) {
+                    // Every buffer is queued in completions we have not consumed yet
+                    echo::trace("uring recv out of buffers, re-arming");
+                    continue;
+                }
+                if (res == 0) {
+                    echo::trace("connection closed by peer (fd=", fd_, ")");
+                    return dp::result::err(dp::Error::not_found("connection closed by peer"));
+                }
+                if (res < 0) {
+                    errno = -res;
+                    return dp::result::err(read_error_from_errno(fd_, 0, 0));
+                }
+                if (!(flags & IORING_CQE_F_BUFFER)) {
+                    return dp::result::err(dp::Error::io_error("recv completion without buffer"));
+                }
+
+                chunk_id_ = static_cast<dp::u16>(flags >> IORING_CQE_BUFFER_SHIFT);
+                chunk_offset_ = 0;
+                chunk_length_ = static_cast<dp::usize>(res);
+                chunk_active_ = true;
+                return dp::result::ok();
+            }
+        }
+
+        // Route bytes of the current chunk into the frame; returns true when the frame is complete
+        dp::Res<bool> absorb(dp::usize prefix_len) {
+            const dp::u8 *data = buffers_.data(chunk_id_) + chunk_offset_;
+            dp::usize available = chunk_length_ - chunk_offset_;
+            dp::usize used = 0;
+
+            if (!in_frame_) {
+                dp::usize take = 4 - length_have_ < available ? 4 - length_have_ : available;
+                std::memcpy(length_bytes_ + length_have_, data, take);
+                length_have_ += take;
+                used += take;
+
+                if (length_have_ == 4) {
+                    frame_length_ = decode_u32_be(length_bytes_);
+                    if (frame_length_ > remote::MAX_MESSAGE_SIZE) {
+                        echo::error("frame too large: ", frame_length_, " > ", remote::MAX_MESSAGE_SIZE);
+                        return dp::result::err(dp::Error::invalid_argument("message too large"));
+                    }
+                    split_ = frame_length_ < prefix_len ? frame_length_ : prefix_len;
+                    try {
+                        head_.resize(split_);
+                        body_.resize(frame_length_ - split_);
+                    } catch (const std::bad_alloc &) {
+                        echo::error("allocation failed: ", frame_length_, " bytes");
+                        return dp::result::err(dp::Error::io_error("memory allocation failed"));
+                    }
+                    frame_have_ = 0;
+                    in_frame_ = true;
+                }
+            }
+
+            if (in_frame_) {
+                dp::usize want = frame_length_ - frame_have_;
+                dp::usize take = want < available - used ? want : available - used;
+                dp::usize copied = 0;
+                if (frame_have_ < split_ && take > 0) {
+                    dp::usize to_head = split_ - frame_have_ < take ? split_ - frame_have_ : take;
+                    std::memcpy(head_.data() + frame_have_, data + used, to_head);
+                    copied = to_head;
+                }
+                if (take > copied) {
+                    std::memcpy(body_.data() + (frame_have_ + copied - split_), data + used + copied,
+                                take - copied);
+                }
+                frame_have_ += take;
+                used += take;
+            }
+
+            chunk_offset_ += used;
+            if (chunk_offset_ == chunk_length_) {
+                buffers_.recycle(chunk_id_);
+                chunk_active_ = false;
+            }
+            return dp::result::ok(in_frame_ && frame_have_ == frame_length_);
+        }
+
+        dp::Res<dp::usize> receive_frame(dp::u8 *prefix, dp::usize prefix_len, Message &rest) {
+            if (!connected_) {
+                echo::trace("recv called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+
+            while (true) {
+                if (!chunk_active_) {
+                    auto chunk = next_chunk();
+                    if (chunk.is_err()) {
+                        if (chunk.error().code != dp::Error::TIMEOUT) {
+                            echo::trace("recv failed: ", chunk.error().message.c_str());
+                            connected_ = false;
+                        }
+                        return dp::result::err(chunk.error());
+                    }
+                }
+
+                auto done = absorb(prefix_len);
+                if (done.is_err()) {
+                    connected_ = false;
+                    return dp::result::err(done.error());
+                }
+                if (done.value()) {
+                    break;
+                }
+            }
+
+            // Frame complete: hand the body over by swap (rest's old storage becomes the next body buffer)
+            in_frame_ = false;
+            length_have_ = 0;
+            dp::usize head = split_;
+            if (split_ != (frame_length_ < prefix_len ? frame_length_ : prefix_len)) {
+                // Resumed after a timeout with a different prefix_len - re-split the joined frame
+                Message joined(head_.begin(), head_.end());
+                joined.insert(joined.end(), body_.begin(), body_.end());
+                head = joined.size() < prefix_len ? joined.size() : prefix_len;
+                if (head > 0) {
+                    std::memcpy(prefix, joined.data(), head);
+                }
+                rest.assign(joined.begin() + head, joined.end());
+            } else {
+                if (head > 0) {
+                    std::memcpy(prefix, head_.data(), head);
+                }
+                std::swap(rest, body_);
+            }
+
+            echo::debug("received ", frame_length_, " bytes");
+            return dp::result::ok(head);
+        }
+
+      public:
+        // Receive buffer pool defaults: 64 buffers of 16 KB per connection
+        static constexpr dp::u32 DEFAULT_BUFFER_COUNT = 64;
+        static constexpr dp::u32 DEFAULT_BUFFER_SIZE = 16 * 1024;
+
+        // Wrap a not-yet-connected transport (TcpStream by default, or IpcStream)
+        // buffer_count must be a power of two
+        explicit UringStream(std::unique_ptr<Stream> inner = std::make_unique<TcpStream>(),
+                             dp::u32 buffer_count = DEFAULT_BUFFER_COUNT, dp::u32 buffer_size = DEFAULT_BUFFER_SIZE)
+            : inner_(std::move(inner)), fd_(-1), connected_(false), timeout_ms_(-1), buffer_count_(buffer_count),
+              buffer_size_(buffer_size), recv_armed_(false), chunk_active_(false), chunk_id_(0), chunk_offset_(0),
+              chunk_length_(0), length_have_(0), in_frame_(false), frame_length_(0), frame_have_(0), split_(0) {
+            echo::trace("UringStream constructed");
+        }
+
+        // Take over an already connected TcpStream/IpcStream that has not been read from
+        static dp::Res<std::unique_ptr<UringStream>> adopt(std::unique_ptr<Stream> connected,
+                                                           dp::u32 buffer_count = DEFAULT_BUFFER_COUNT,
+                                                           dp::u32 buffer_size = DEFAULT_BUFFER_SIZE) {
+            if (!connected || !connected->is_connected()) {
+                return dp::result::err(dp::Error::invalid_argument("stream not connected"));
+            }
+            auto stream = std::make_unique<UringStream>(std::move(connected), buffer_count, buffer_size);
+            auto res = stream->attach();
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(stream));
+        }
+
+        ~UringStream() override { close(); }
+
+        UringStream(const UringStream &) = delete;
+        UringStream &operator=(const UringStream &) = delete;
+
+        // Whether io_uring with provided buffer rings and multishot recv is usable (kernel 6.0+)
+        static bool is_supported() {
+            IoUring ring;
+            if (ring.init(2).is_err()) {
+                return false;
+            }
+            ProvidedBuffers probe;
+            return probe.init(ring, 1, 4096, BUFFER_GROUP).is_ok();
+        }
+
+        dp::Res<void> connect(const TcpEndpoint &endpoint) override {
+            auto res = inner_->connect(endpoint);
+            if (res.is_err()) {
+                return res;
+            }
+            return attach();
+        }
+
+        dp::Res<void> listen(const TcpEndpoint &endpoint) override { return inner_->listen(endpoint); }
+
+        // Accept on the inner listener and give the new connection its own rings
+        dp::Res<std::unique_ptr<Stream>> accept() override {
+            auto accepted = inner_->accept();
+            if (accepted.is_err()) {
+                return dp::result::err(accepted.error());
+            }
+            auto stream = adopt(std::move(accepted.value()), buffer_count_, buffer_size_);
+            if (stream.is_err()) {
+                return dp::result::err(stream.error());
+            }
+            return dp::result::ok(std::unique_ptr<Stream>(std::move(stream.value())));
+        }
+
+        dp::Res<void> send(const Message &msg) override {
+            iovec part{const_cast<dp::u8 *>(msg.data()), msg.size()};
+            return send_iov(std::span<const iovec>(&part, 1));
+        }
+
+        // Length prefix and parts go out as one SENDMSG; short sends are resubmitted from where they stopped
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
+            if (parts.size() > MAX_IOV_PARTS) {
+                return Stream::send_iov(parts);
+            }
+
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            if (!connected_) {
+                echo::trace("send called but not connected");
+                return dp::result::err(dp::Error::not_found("not connected"));
+            }
+
+            dp::usize total = 0;
+            for (const auto &part : parts) {
+                total += part.iov_len;
+            }
+            if (total > remote::MAX_MESSAGE_SIZE) {
+                echo::error("message too large: ", total, " > ", remote::MAX_MESSAGE_SIZE);
+                return dp::result::err(dp::Error::invalid_argument("message too large"));
+            }
+
+            auto length_bytes = encode_u32_be(static_cast<dp::u32>(total));
+            iovec iov[MAX_IOV_PARTS + 1];
+            iov[0] = {length_bytes.data(), length_bytes.size()};
+            for (dp::usize i = 0; i < parts.size(); ++i) {
+                iov[i + 1] = parts[i];
+            }
+
+            struct msghdr hdr = {};
+            hdr.msg_iov = iov;
+            hdr.msg_iovlen = parts.size() + 1;
+            dp::usize remaining = total + length_bytes.size();
+
+            while (remaining > 0) {
+                io_uring_sqe *sqe = send_ring_.get_sqe();
+                if (sqe == nullptr) {
+                    return dp::result::err(dp::Error::io_error("io_uring submission queue full"));
+                }
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = fd_;
+                sqe->addr = reinterpret_cast<dp::u64>(&hdr);
+                sqe->msg_flags = MSG_NOSIGNAL;
+                sqe->user_data = SEND_TAG;
+
+                io_uring_cqe *cqe = nullptr;
+                while ((cqe = send_ring_.peek_cqe()) == nullptr) {
+                    auto wait = send_ring_.enter(1, -1);
+                    if (wait.is_err()) {
+                        connected_ = false;
+                        return wait;
+                    }
+                }
+                dp::i32 res = cqe->res;
+                send_ring_.cqe_seen();
+
+                if (res == -EINTR || res == -EAGAIN) {
+                    continue;
+                }
+                if (res < 0) {
+                    errno = -res;
+                    connected_ = false;
+                    return dp::result::err(write_error_from_errno(fd_, remaining, 0));
+                }
+
+                // Skip fully sent iovecs and trim the partially sent one
+                dp::usize sent = static_cast<dp::usize>(res);
+                remaining -= sent;
+                while (sent > 0 && hdr.msg_iovlen > 0) {
+                    if (sent >= hdr.msg_iov->iov_len) {
+                        sent -= hdr.msg_iov->iov_len;
+                        hdr.msg_iov++;
+                        hdr.msg_iovlen--;
+                    } else {
+                        hdr.msg_iov->iov_base = static_cast<dp::u8 *>(hdr.msg_iov->iov_base) + sent;
+                        hdr.msg_iov->iov_len -= sent;
+                        sent = 0;
+                    }
+                }
+            }
+
+            echo::debug("sent ", total, " bytes");
+            return dp::result::ok();
+        }
+
+        dp::Res<Message> recv() override {
+            Message msg;
+            auto res = recv_into(msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok(std::move(msg));
+        }
+
+        dp::Res<void> recv_into(Message &msg) override {
+            auto res = receive_frame(nullptr, 0, msg);
+            if (res.is_err()) {
+                return dp::result::err(res.error());
+            }
+            return dp::result::ok();
+        }
+
+        dp::Res<dp::usize> recv_split(dp::u8 *prefix, dp::usize prefix_len, Message &rest) override {
+            return receive_frame(prefix, prefix_len, rest);
+        }
+
+        // Timeout applies to the io_uring wait; a partially received frame is kept for the next call
+        dp::Res<void> set_recv_timeout(dp::u32 timeout_ms) override {
+            timeout_ms_ = timeout_ms == 0 ? -1 : static_cast<dp::i32>(timeout_ms);
+            echo::debug("recv timeout set to ", timeout_ms, "ms");
+            return dp::result::ok();
+        }
+
+        void close() override {
+            if (fd_ >= 0) {
+                echo::trace("closing UringStream fd=", fd_);
+
+                // The ring holds its own reference to the socket, so closing the fd would not end the
+                // multishot recv - shut the socket down and reap it before its buffers are unmapped
+                ::shutdown(fd_, SHUT_RDWR);
+                while (recv_armed_ && recv_ring_.is_open()) {
+                    io_uring_cqe *cqe = recv_ring_.peek_cqe();
+                    if (cqe == nullptr) {
+                        if (recv_ring_.enter(1, 100).is_err()) {
+                            break;
+                        }
+                        continue;
+                    }
+                    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                        recv_armed_ = false;
+                    }
+                    recv_ring_.cqe_seen();
+                }
+            }
+            if (inner_) {
+                inner_->close();
+            }
+            detach();
+        }
+
+        bool is_connected() const override { return connected_; }
+
+        // The fd is driven by io_uring and must not be handed to a Reactor
+        dp::i32 native_handle() const override { return -1; }
+
+        // Buffers in the provided-buffer ring
+        dp::u32 buffer_count() const { return buffer_count_; }
+        dp::u32 buffer_size() const { return buffer_size_; }
+    };
+
+} // namespace netpipe
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <netpipe/common.hpp>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace netpipe {
+
+    // Identifies a scheduled timer; 0 is never a valid id
+    using TimerId = dp::u64;
+
+    // Hierarchical timer wheel with 1 ms ticks: 4 levels of 256 slots cover 2^32 ms (~49 days)
+    // schedule, cancel and each tick are O(1); a timer is re-slotted at most once per level on its way down.
+    // Nodes live in one pool indexed by the low half of the TimerId, the high half is a generation so a stale
+    // id can never cancel a recycled node. Not thread-safe - TimerService adds the lock and the thread.
+    class TimerWheel {
+      public:
+        static constexpr dp::u32 LEVELS = 4;
+        static constexpr dp::u32 SLOT_BITS = 8;
+        static constexpr dp::u32 SLOTS = 1u << SLOT_BITS;
+
+        // A timer that came due, handed out by advance()
+        struct Expired {
+            TimerId id;
+            dp::u32 interval_ms; // Non-zero for periodic timers - the caller re-arms with rearm()
+            std::function<void()> callback;
+        };
+
+        explicit TimerWheel(dp::u64 now_ms = 0) : current_(now_ms), count_(0), free_head_(NIL) {
+            for (auto &head : heads_) {
+                head = NIL;
+            }
+            for (auto &word : occupied_) {
+                word = 0;
+            }
+        }
+
+        // Run callback once, delay_ms after now (the wheel's current tick)
+        TimerId schedule(dp::u32 delay_ms, std::function<void()> callback) {
+            return insert_new(current_ + (delay_ms == 0 ? 1 : delay_ms), 0, std::move(callback));
+        }
+
+        // Run callback every interval_ms until cancelled
+        TimerId schedule_every(dp::u32 interval_ms, std::function<void()> callback) {
+            dp::u32 interval = interval_ms == 0 ? 1 : interval_ms;
+            return insert_new(current_ + interval, interval, std::move(callback));
+        }
+
+        // Remove a pending timer; false when it already fired or the id is stale
+        bool cancel(TimerId id) {
+            dp::u32 index = index_of(id);
+            if (index >= nodes_.size() || nodes_[index].generation != generation_of(id) || !nodes_[index].linked) {
+                return false;
+            }
+            unlink(index);
+            release_node(index);
+            return true;
+        }
+
+        // Put a periodic timer handed out by advance() back on the wheel, keeping its id
+        void rearm(Expired &&expired) {
+            dp::u32 index = index_of(expired.id);
+            Node &node = nodes_[index];
+            node.callback = std::move(expired.callback);
+            node.deadline = current_ + node.interval;
+            link(index);
+        }
+
+        // Move the wheel to now_ms, appending every timer that came due to out (in deadline order)
+        // Periodic timers stay reserved until rearm() or drop(); one-shot timers are freed here
+        template <typename Container> void advance(dp::u64 now_ms, Container &out) {
+            if (count_ == 0) {
+                current_ = now_ms > current_ ? now_ms : current_; // Nothing to cascade - jump straight there
+                return;
+            }
+            while (current_ < now_ms) {
+                current_++;
+                cascade();
+                dp::u32 slot = current_ & (SLOTS - 1);
+                while (heads_[slot] != NIL) {
+                    dp::u32 index = heads_[slot];
+                    unlink(index);
+                    Node &node = nodes_[index];
+                    out.push_back(Expired{make_id(index, node.generation), node.interval, std::move(node.callback)});
+                    if (node.interval == 0) {
+                        release_node(index);
+                    }
+                }
+                if (count_ == 0) {
+                    current_ = now_ms;
+                }
+            }
+        }
+
+        // Free a periodic timer handed out by advance() without re-arming it
+        void drop(TimerId id) { release_node(index_of(id)); }
+
+        // Tick at which advance() next has work: the next occupied level-0 slot or the next cascade,
+        // whichever comes first; 0 when the wheel is empty
+        dp::u64 next_deadline() const {
+            if (count_ == 0) {
+                return 0;
+            }
+            dp::u32 slot = current_ & (SLOTS - 1);
+            dp::u64 until_wrap = SLOTS - slot;
+            for (dp::u32 distance = 1; distance < until_wrap;) {
+                dp::u32 probe = slot + distance;
+                dp::u64 bits = occupied_[probe / 64] >> (probe % 64);
+                if (bits != 0) {
+                    distance += static_cast<dp::u32>(__builtin_ctzll(bits));
+                    return current_ + (distance < until_wrap ? distance : until_wrap);
+                }
+                distance += 64 - (probe % 64);
+            }
+            return current_ + until_wrap;
+        }
+
+        dp::u64 now() const { return current_; }
+        dp::usize size() const { return count_; }
+
+      private:
+        static constexpr dp::u32 NIL = 0xFFFFFFFFu;
+
+        struct Node {
+            dp::u64 deadline = 0;
+            dp::u32 prev = NIL;
+            dp::u32 next = NIL; // Next in slot list, or next free node
+            dp::u32 slot = 0;   // level * SLOTS + index
+            dp::u32 generation = 1;
+            dp::u32 interval = 0;
+            bool linked = false;
+            std::function<void()> callback;
+        };
+
+        static TimerId make_id(dp::u32 index, dp::u32 generation) {
+            return (static_cast<dp::u64>(generation) << 32) | index;
+        }
+        static dp::u32 index_of(TimerId id) { return static_cast<dp::u32>(id); }
+        static dp::u32 generation_of(TimerId id) { return static_cast<dp::u32>(id >> 32); }
+
+        std::vector<Node> nodes_;
+        dp::u32 heads_[LEVELS * SLOTS];
+        dp::u64 occupied_[SLOTS / 64]; // Level-0 slots with timers, for next_deadline()
+        dp::u64 current_;
+        dp::usize count_; // Timers on the wheel or handed out awaiting rearm/drop
+        dp::u32 free_head_;
+
+        TimerId insert_new(dp::u64 deadline, dp::u32 interval, std::function<void()> &&callback) {
+            dp::u32 index;
+            if (free_head_ != NIL) {
+                index = free_head_;
+                free_head_ = nodes_[index].next;
+            } else {
+                index = static_cast<dp::u32>(nodes_.size());
+                nodes_.emplace_back();
+            }
+            Node &node = nodes_[index];
+            node.deadline = deadline;
+            node.interval = interval;
+            node.callback = std::move(callback);
+            count_++;
+            link(index);
+            return make_id(index, node.generation);
+        }
+
+        void release_node(dp::u32 index) {
+            Node &node = nodes_[index];
+            node.callback = nullptr;
+            node.generation = node.generation == 0xFFFFFFFFu ? 1 : node.generation + 1;
+            node.next = free_head_;
+            free_head_ = index;
+            count_--;
+        }
+
+        // Slot by the highest tick bits that differ from now; deadlines past the top level are clamped
+        void link(dp::u32 index) {
+            Node &node = nodes_[index];
+            dp::u64 deadline = node.deadline > current_ ? node.deadline : current_; // Due now lands in this tick
+            dp::u64 delta = deadline - current_;
+            dp::u32 level = 0;
+            while (level + 1 < LEVELS && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+                level++;
+            }
+            if (level == LEVELS - 1 && delta >> (SLOT_BITS * LEVELS)) {
+                deadline = current_ + (1ull << (SLOT_BITS * LEVELS)) - 1;
+            }
+            dp::u32 slot = level * SLOTS + ((deadline >> (SLOT_BITS * level)) & (SLOTS - 1));
+            node.slot = slot;
+            node.prev = NIL;
+            node.next = heads_[slot];
+            if (node.next != NIL) {
+                nodes_[node.next].prev = index;
+            }
+            heads_[slot] = index;
+            node.linked = true;
+            if (slot < SLOTS) {
+                occupied_[slot / 64] |= 1ull << (slot % 64);
+            }
+        }
+
+        void unlink(dp::u32 index) {
+            Node &node = nodes_[index];
+            if (node.prev != NIL) {
+                nodes_[node.prev].next = node.next;
+            } else {
+                heads_[node.slot] = node.next;
+            }
+            if (node.next != NIL) {
+                nodes_[node.next].prev = node.prev;
+            }
+            if (node.slot < SLOTS && heads_[node.slot] == NIL) {
+                occupied_[node.slot / 64] &= ~(1ull << (node.slot % 64));
+            }
+            node.linked = false;
+        }
+
+        // On a level boundary, spread the due slot of each higher level onto the levels below
+        void cascade() {
+            dp::u32 top = 0;
+            while (top + 1 < LEVELS && (current_ & ((1ull << (SLOT_BITS * (top + 1))) - 1)) == 0) {
+                top++;
+            }
+            for (dp::u32 level = top; level >= 1; level--) {
+                dp::u32 slot = level * SLOTS + ((current_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+                dp::u32 index = heads_[slot];
+                heads_[slot] = NIL;
+                while (index != NIL) {
+                    dp::u32 next = nodes_[index].next;
+                    link(index);
+                    index = next;
+                }
+            }
+        }
+    };
+
+    // TimerWheel driven by its own thread - one instance can serve every Remote in the process
+    // Callbacks run on the timer thread and must stay short (complete a call, send one frame, post work).
+    // cancel() waits for a callback that is already running, so once it returns the callback's captures
+    // may be destroyed; cancelling from inside a callback never waits.
+    class TimerService {
+      public:
+        TimerService() : wheel_(now_ms()), running_(true), firing_(0) {
+            thread_ = std::thread(&TimerService::run, this);
+        }
+
+        ~TimerService() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+            }
+            wake_.notify_all();
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        TimerService(const TimerService &) = delete;
+        TimerService &operator=(const TimerService &) = delete;
+
+        // Process-wide instance used by Remote<Bidirect>, RemoteAsync and PendingTable
+        static TimerService &shared() {
+            static TimerService service;
+            return service;
+        }
+
+        TimerId schedule(dp::u32 delay_ms, std::function<void()> callback) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            catch_up();
+            TimerId id = wheel_.schedule(delay_ms, std::move(callback));
+            wake_.notify_one();
+            return id;
+        }
+
+        TimerId schedule_every(dp::u32 interval_ms, std::function<void()> callback) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            catch_up();
+            TimerId id = wheel_.schedule_every(interval_ms, std::move(callback));
+            wake_.notify_one();
+            return id;
+        }
+
+        // Stop a timer; true when it was removed before its callback ran
+        // A periodic timer whose callback is running is not re-armed
+        bool cancel(TimerId id) {
+            if (id == 0) {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (wheel_.cancel(id)) {
+                return true;
+            }
+            for (auto it = due_.begin(); it != due_.end(); ++it) {
+                if (it->id == id) { // Came due but not started yet
+                    if (it->interval_ms != 0) {
+                        wheel_.drop(id);
+                    }
+                    due_.erase(it);
+                    return true;
+                }
+            }
+            if (firing_ == id) {
+                cancelled_firing_ = true;
+                if (std::this_thread::get_id() != thread_.get_id()) {
+                    fired_.wait(lock, [&] { return firing_ != id; });
+                }
+            }
+            return false;
+        }
+
+        dp::usize size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return wheel_.size();
+        }
+
+      private:
+        TimerWheel wheel_;
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;  // Timer thread sleeps here until the next deadline
+        std::condition_variable fired_; // cancel() waits here for a running callback
+        bool running_;
+        TimerId firing_; // Callback currently running on the timer thread
+        bool cancelled_firing_ = false;
+        std::deque<TimerWheel::Expired> due_; // Came due, waiting for the timer thread
+        std::thread thread_;
+
+        static dp::u64 now_ms() {
+            return static_cast<dp::u64>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            std::chrono::steady_clock::now().time_since_epoch())
+                                            .count());
+        }
+
+        // New timers count their delay from the wall clock, not from where the sleeping thread left the wheel
+        void catch_up() { wheel_.advance(now_ms(), due_); }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_) {
+                catch_up();
+                while (!due_.empty() && running_) {
+                    TimerWheel::Expired expired = std::move(due_.front());
+                    due_.pop_front();
+                    firing_ = expired.id;
+                    cancelled_firing_ = false;
+                    lock.unlock();
+                    expired.callback();
+                    lock.lock();
+                    if (expired.interval_ms != 0) {
+                        if (cancelled_firing_ || !running_) {
+                            wheel_.drop(expired.id);
+                        } else {
+                            wheel_.rearm(std::move(expired));
+                        }
+                    }
+                    firing_ = 0;
+                    fired_.notify_all();
+                }
+                if (!running_) {
+                    break;
+                }
+
+                dp::u64 next = wheel_.next_deadline();
+                if (next == 0) {
+                    wake_.wait(lock);
+                } else if (next > wheel_.now()) {
+                    wake_.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::milliseconds(next)));
+                }
+            }
+        }
+    };
+
+    // Cancels its timer when the scope ends - for deadlines that must not outlive the work they guard
+    class ScopedTimer {
+      public:
+        ScopedTimer(TimerService &service, TimerId id) : service_(service), id_(id) {}
+        ~ScopedTimer() { service_.cancel(id_); }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+        TimerId id() const { return id_; }
+
+      private:
+        TimerService &service_;
+        TimerId id_;
+    };
+
+} // namespace netpipe
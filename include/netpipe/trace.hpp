@@ -0,0 +1,359 @@
+#pragma once
+
+#include <datapod/datapod.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+// Binary hot-path tracing, compiled in with -DNETPIPE_TRACING (CMake: NETPIPE_ENABLE_TRACING, xmake: --tracing=y)
+// Without the define NETPIPE_TRACE expands to nothing and none of the calls below are made. With it, an event
+// is a clock read plus a 32-byte store into the calling thread's ring - no lock, no formatting, no allocation
+// after the thread's first event. trace::to_chrome_json() turns the rings into a Chrome/Perfetto trace.
+#ifdef NETPIPE_TRACING
+#define NETPIPE_TRACE(kind, request_id, method_id, value)                                                              \
+    ::netpipe::trace::record(::netpipe::trace::EventKind::kind, (request_id), (method_id), (value))
+#define NETPIPE_TRACE_NOW() ::netpipe::trace::now_ns()
+#else
+#define NETPIPE_TRACE(kind, request_id, method_id, value)                                                              \
+    ((void)sizeof(::netpipe::trace::unused_args((request_id), (method_id), (value))))
+#define NETPIPE_TRACE_NOW() dp::u64(0)
+#endif
+
+// Events kept per thread; older ones are overwritten. Must be a power of two.
+#ifndef NETPIPE_TRACE_RING_EVENTS
+#define NETPIPE_TRACE_RING_EVENTS 4096
+#endif
+
+namespace netpipe::trace {
+
+    // Lets a disabled NETPIPE_TRACE name its arguments without evaluating them (never defined)
+    template <typename... Args> int unused_args(const Args &...);
+
+    enum class EventKind : dp::u8 {
+        SendBegin = 1,    // value: bytes
+        SendEnd = 2,      // value: bytes
+        Recv = 3,         // A complete message was received; value: bytes
+        Reserved = 4,     //
+        CallBegin = 5,    // Client side of a Remote call; value: request bytes
+        CallEnd = 6,      // value: response bytes, or 0 on failure
+        HandlerBegin = 7, // value: request bytes
+        HandlerEnd = 8,   // value: response bytes
+        QueueWait = 9,    // Ends now; value: nanoseconds spent waiting (send lock, executor queue)
+        IoRead = 10,      // One read syscall; request_id: fd, value: bytes
+        IoWrite = 11,     // One write syscall; request_id: fd, value: bytes
+        Mark = 12,        // Application-defined instant
+    };
+
+    struct Event {
+        dp::u64 timestamp_ns; // CLOCK_MONOTONIC, comparable across processes on one host
+        dp::u64 value;
+        dp::u32 request_id;
+        dp::u32 method_id;
+        EventKind kind;
+        dp::u8 reserved[7];
+    };
+
+    static_assert(sizeof(Event) == 32, "trace events are two to a cache line");
+    static_assert((NETPIPE_TRACE_RING_EVENTS & (NETPIPE_TRACE_RING_EVENTS - 1)) == 0,
+                  "NETPIPE_TRACE_RING_EVENTS must be a power of two");
+
+    inline dp::u64 now_ns() {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<dp::u64>(ts.tv_sec) * 1000000000ull + static_cast<dp::u64>(ts.tv_nsec);
+    }
+
+    // Events of one thread: written only by that thread, read by the exporter
+    // The writer publishes each slot by bumping head with release order. A reader copies the window it saw
+    // and then drops whatever the writer may have lapped meanwhile, so it never reports a torn event.
+    class Ring {
+      public:
+        static constexpr dp::usize CAPACITY = NETPIPE_TRACE_RING_EVENTS;
+
+      private:
+        Event events_[CAPACITY];
+        std::atomic<dp::u64> head_{0};
+        std::atomic<dp::u64> floor_{0}; // Events below this were cleared
+        std::atomic<dp::u32> thread_id_;
+        char name_[32] = {};
+
+      public:
+        explicit Ring(dp::u32 thread_id) : thread_id_(thread_id) {
+            std::snprintf(name_, sizeof(name_), "thread %u", thread_id);
+        }
+
+        // Hand the ring of an exited thread to a new one; what the old thread recorded is dropped
+        void reuse(dp::u32 thread_id) {
+            thread_id_.store(thread_id, std::memory_order_relaxed);
+            std::snprintf(name_, sizeof(name_), "thread %u", thread_id);
+            clear();
+        }
+
+        void push(EventKind kind, dp::u32 request_id, dp::u32 method_id, dp::u64 value) {
+            dp::u64 head = head_.load(std::memory_order_relaxed);
+            Event &event = events_[head & (CAPACITY - 1)];
+            event.timestamp_ns = now_ns();
+            event.value = value;
+            event.request_id = request_id;
+            event.method_id = method_id;
+            event.kind = kind;
+            head_.store(head + 1, std::memory_order_release);
+        }
+
+        // Append the surviving events, oldest first
+        void snapshot(dp::Vector<Event> &out) const {
+            dp::u64 end = head_.load(std::memory_order_acquire);
+            dp::u64 begin = end > CAPACITY ? end - CAPACITY : 0;
+            dp::u64 floor = floor_.load(std::memory_order_relaxed);
+            begin = begin < floor ? floor : begin;
+            dp::usize first = out.size();
+            for (dp::u64 i = begin; i < end; i++) {
+                out.push_back(events_[i & (CAPACITY - 1)]);
+            }
+            // Slots the writer reused while we copied, including the one it may be filling right now
+            dp::u64 now = head_.load(std::memory_order_acquire) + 1;
+            dp::u64 valid_from = now > CAPACITY ? now - CAPACITY : 0;
+            if (valid_from > begin) {
+                dp::usize torn = static_cast<dp::usize>(valid_from - begin);
+                torn = torn > end - begin ? static_cast<dp::usize>(end - begin) : torn;
+                out.erase(out.begin() + static_cast<dp::isize>(first),
+                          out.begin() + static_cast<dp::isize>(first + torn));
+            }
+        }
+
+        void clear() { floor_.store(head_.load(std::memory_order_acquire), std::memory_order_relaxed); }
+
+        dp::u64 recorded() const { return head_.load(std::memory_order_relaxed); }
+
+        void set_name(const char *name) { std::snprintf(name_, sizeof(name_), "%s", name); }
+
+        const char *name() const { return name_; }
+
+        dp::u32 thread_id() const { return thread_id_.load(std::memory_order_relaxed); }
+    };
+
+    // Every ring in use or retired, so the exporter still sees threads that already exited
+    // A new thread takes over the oldest retired ring, so rings never outnumber the threads alive at once
+    class Registry {
+      private:
+        std::mutex mutex_;
+        dp::Vector<std::shared_ptr<Ring>> rings_;
+        dp::Vector<std::shared_ptr<Ring>> retired_; // Rings of exited threads, oldest first
+        std::atomic<bool> enabled_{true};
+        dp::u32 next_thread_id_ = 1;
+
+      public:
+        static Registry &instance() {
+            static Registry registry;
+            return registry;
+        }
+
+        std::shared_ptr<Ring> create() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            dp::u32 thread_id = next_thread_id_++;
+            if (!retired_.empty()) {
+                auto ring = std::move(retired_.front());
+                retired_.erase(retired_.begin());
+                ring->reuse(thread_id);
+                return ring;
+            }
+            auto ring = std::make_shared<Ring>(thread_id);
+            rings_.push_back(ring);
+            return ring;
+        }
+
+        // The owning thread exited; its events stay exportable until another thread takes the ring
+        void retire(std::shared_ptr<Ring> ring) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired_.push_back(std::move(ring));
+        }
+
+        dp::Vector<std::shared_ptr<Ring>> rings() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return rings_;
+        }
+
+        bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    };
+
+    // The calling thread's ring, retired when the thread exits
+    struct LocalRing {
+        std::shared_ptr<Ring> ring = Registry::instance().create();
+
+        ~LocalRing() { Registry::instance().retire(std::move(ring)); }
+    };
+
+    inline Ring &local_ring() {
+        thread_local LocalRing local;
+        return *local.ring;
+    }
+
+    inline void record(EventKind kind, dp::u32 request_id, dp::u32 method_id, dp::u64 value) {
+        if (Registry::instance().enabled()) {
+            local_ring().push(kind, request_id, method_id, value);
+        }
+    }
+
+    // Runtime switch on top of the compile-time one; recording starts enabled
+    inline void set_enabled(bool enabled) { Registry::instance().set_enabled(enabled); }
+
+    // Name the calling thread in exported traces
+    inline void set_thread_name(const char *name) { local_ring().set_name(name); }
+
+    // Forget everything recorded so far, on every thread
+    inline void clear() {
+        for (auto &ring : Registry::instance().rings()) {
+            ring->clear();
+        }
+    }
+
+    struct ThreadEvents {
+        dp::u32 thread_id;
+        dp::String name;
+        dp::Vector<Event> events;
+    };
+
+    // Copy out the events of every thread
+    inline dp::Vector<ThreadEvents> collect() {
+        dp::Vector<ThreadEvents> out;
+        for (auto &ring : Registry::instance().rings()) {
+            ThreadEvents thread{ring->thread_id(), dp::String(ring->name()), {}};
+            ring->snapshot(thread.events);
+            if (!thread.events.empty()) {
+                out.push_back(std::move(thread));
+            }
+        }
+        return out;
+    }
+
+    // Quote text for a JSON string: backslash, double quote and control characters are escaped
+    inline std::string json_escape(const char *text) {
+        std::string out;
+        for (const char *c = text; *c; c++) {
+            auto byte = static_cast<unsigned char>(*c);
+            if (byte == '"' || byte == '\\') {
+                out += '\\';
+                out += *c;
+            } else if (byte < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", byte);
+                out += escaped;
+            } else {
+                out += *c;
+            }
+        }
+        return out;
+    }
+
+    // Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+    // Send/recv/handler spans become per-thread B/E slices and Remote calls async b/e slices keyed by request
+    // id, so one request reads as a timeline from the caller over the transport into the handler. Traces
+    // from several processes on one host share the clock and can be loaded side by side.
+    inline std::string to_chrome_json() {
+        std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        char line[320];
+        auto emit = [&](const char *text) {
+            if (!first) {
+                json += ",\n";
+            }
+            first = false;
+            json += text;
+        };
+        int pid = static_cast<int>(::getpid());
+
+        for (const auto &thread : collect()) {
+            std::snprintf(line, sizeof(line),
+                          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                          "\"args\":{\"name\":\"%s\"}}",
+                          pid, thread.thread_id, json_escape(thread.name.c_str()).c_str());
+            emit(line);
+            for (const auto &event : thread.events) {
+                double ts = static_cast<double>(event.timestamp_ns) / 1000.0;
+                const char *name = nullptr;
+                const char *phase = nullptr;
+                switch (event.kind) {
+                case EventKind::SendBegin:
+                    name = "send", phase = "B";
+                    break;
+                case EventKind::SendEnd:
+                    name = "send", phase = "E";
+                    break;
+                case EventKind::Recv:
+                    name = "recv", phase = "i";
+                    break;
+                case EventKind::HandlerBegin:
+                    name = "handler", phase = "B";
+                    break;
+                case EventKind::HandlerEnd:
+                    name = "handler", phase = "E";
+                    break;
+                case EventKind::CallBegin:
+                    name = "call", phase = "b";
+                    break;
+                case EventKind::CallEnd:
+                    name = "call", phase = "e";
+                    break;
+                case EventKind::QueueWait:
+                    std::snprintf(line, sizeof(line),
+                                  "{\"name\":\"queue wait\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                                  "\"dur\":%.3f,\"args\":{\"request_id\":%u,\"method_id\":%u}}",
+                                  pid, thread.thread_id, ts - static_cast<double>(event.value) / 1000.0,
+                                  static_cast<double>(event.value) / 1000.0, event.request_id, event.method_id);
+                    emit(line);
+                    continue;
+                case EventKind::IoRead:
+                    name = "read", phase = "i";
+                    break;
+                case EventKind::IoWrite:
+                    name = "write", phase = "i";
+                    break;
+                case EventKind::Mark:
+                    name = "mark", phase = "i";
+                    break;
+                default:
+                    continue;
+                }
+                if (phase[0] == 'b' || phase[0] == 'e') {
+                    std::snprintf(line, sizeof(line),
+                                  "{\"name\":\"%s\",\"cat\":\"remote\",\"ph\":\"%s\",\"id\":%u,\"pid\":%d,\"tid\":%u,"
+                                  "\"ts\":%.3f,\"args\":{\"method_id\":%u,\"bytes\":%llu}}",
+                                  name, phase, event.request_id, pid, thread.thread_id, ts, event.method_id,
+                                  static_cast<unsigned long long>(event.value));
+                } else {
+                    std::snprintf(line, sizeof(line),
+                                  "{\"name\":\"%s\",\"ph\":\"%s\",%s\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                                  "\"args\":{\"request_id\":%u,\"method_id\":%u,\"bytes\":%llu}}",
+                                  name, phase, phase[0] == 'i' ? "\"s\":\"t\"," : "", pid, thread.thread_id, ts,
+                                  event.request_id, event.method_id, static_cast<unsigned long long>(event.value));
+                }
+                emit(line);
+            }
+        }
+        json += "]}\n";
+        return json;
+    }
+
+    // Write to_chrome_json() to path
+    inline dp::Res<void> export_chrome_json(const dp::String &path) {
+        FILE *file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            return dp::result::err(dp::Error::io_error("cannot open trace file"));
+        }
+        std::string json = to_chrome_json();
+        bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok) {
+            return dp::result::err(dp::Error::io_error("failed to write trace file"));
+        }
+        return dp::result::ok();
+    }
+
+} // namespace netpipe::trace
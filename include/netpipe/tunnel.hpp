@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <memory>
+#include <net/if.h>
+#include <netpipe/stream.hpp>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace netpipe {
+
+    // Every Stream message of a tunnel is a batch of Ethernet frames: [count:2] then count x [length:2][frame]
+    // Big-endian, like the rest of the framing. One message, one length prefix and one send for up to
+    // max_batch_frames frames instead of one of each per frame.
+    constexpr dp::usize TUNNEL_BATCH_HEADER_SIZE = 2;
+    constexpr dp::usize TUNNEL_FRAME_HEADER_SIZE = 2;
+
+    struct TunnelOptions {
+        dp::usize max_frame_size = 1518;       // Largest frame accepted from the device (raise it for jumbo frames)
+        dp::usize max_batch_bytes = 64 * 1024; // Batch message size bound, headers included
+        dp::usize max_batch_frames = 64;       // Frames per batch message
+        dp::u32 poll_ms = 100;                 // Bounded waits so stop() is noticed
+    };
+
+    // Counters summed over every queue; elapsed_ns runs from start()
+    struct TunnelStats {
+        dp::u64 frames_sent = 0;       // Device -> stream
+        dp::u64 bytes_sent = 0;        // Frame bytes, no tunnel headers
+        dp::u64 batches_sent = 0;      // Stream messages; frames_sent / batches_sent is the batching factor
+        dp::u64 frames_received = 0;   // Stream -> device
+        dp::u64 bytes_received = 0;    // Frame bytes written to the device
+        dp::u64 batches_received = 0;  // Stream messages
+        dp::u64 dropped_oversize = 0;  // Device frames above max_frame_size
+        dp::u64 dropped_send = 0;      // Frames of batches the stream failed to send
+        dp::u64 dropped_device = 0;    // Frames the device would not take (its queue was full)
+        dp::u64 dropped_malformed = 0; // Received batches that did not parse; their remaining frames are lost
+        dp::u64 elapsed_ns = 0;
+
+        double send_bps() const { return elapsed_ns ? bytes_sent * 8.0 * 1e9 / elapsed_ns : 0.0; }
+        double recv_bps() const { return elapsed_ns ? bytes_received * 8.0 * 1e9 / elapsed_ns : 0.0; }
+    };
+
+    // A Linux TAP interface (/dev/net/tun, IFF_TAP | IFF_NO_PI): one fd per queue, all closed on destruction
+    // With queues > 1 the interface is created IFF_MULTI_QUEUE and the kernel spreads flows over the fds, so
+    // each queue can be served by its own thread. Needs CAP_NET_ADMIN unless the interface already exists and
+    // belongs to the caller.
+    class TapDevice {
+      private:
+        dp::String name_;
+        std::vector<dp::i32> fds_;
+
+        TapDevice() = default;
+
+      public:
+        TapDevice(TapDevice &&other) noexcept : name_(std::move(other.name_)), fds_(std::move(other.fds_)) {
+            other.fds_.clear();
+        }
+        TapDevice &operator=(TapDevice &&other) noexcept {
+            if (this != &other) {
+                close();
+                name_ = std::move(other.name_);
+                fds_ = std::move(other.fds_);
+                other.fds_.clear();
+            }
+            return *this;
+        }
+        TapDevice(const TapDevice &) = delete;
+        TapDevice &operator=(const TapDevice &) = delete;
+        ~TapDevice() { close(); }
+
+        // Create (or attach to) the interface name with queues queues; the kernel picks a name when it is empty
+        // Bring it up and address it as usual (ip link set <name> up); frames flow once it is up
+        static dp::Res<TapDevice> open(const dp::String &name, dp::usize queues = 1) {
+            if (queues == 0 || name.size() >= IFNAMSIZ) {
+                return dp::result::err(dp::Error::invalid_argument("bad TAP name or queue count"));
+            }
+            TapDevice device;
+            for (dp::usize i = 0; i < queues; i++) {
+                dp::i32 fd = ::open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+                if (fd < 0) {
+                    echo::error("open /dev/net/tun failed: ", strerror(errno));
+                    return dp::result::err(dp::Error::io_error(dp::String("open /dev/net/tun: ") + strerror(errno)));
+                }
+                struct ifreq ifr;
+                std::memset(&ifr, 0, sizeof(ifr));
+                ifr.ifr_flags = IFF_TAP | IFF_NO_PI | (queues > 1 ? IFF_MULTI_QUEUE : 0);
+                // Later queues attach to whatever name the first one got
+                const dp::String &want = i == 0 ? name : device.name_;
+                std::memcpy(ifr.ifr_name, want.c_str(), want.size());
+                if (::ioctl(fd, TUNSETIFF, &ifr) < 0) {
+                    echo::error("TUNSETIFF failed: ", strerror(errno));
+                    ::close(fd);
+                    return dp::result::err(dp::Error::io_error(dp::String("TUNSETIFF: ") + strerror(errno)));
+                }
+                if (i == 0) {
+                    device.name_ = dp::String(ifr.ifr_name);
+                }
+                device.fds_.push_back(fd);
+            }
+            echo::info("TAP device ", device.name_.c_str(), " open with ", queues, " queue(s)");
+            return dp::result::ok(std::move(device));
+        }
+
+        const dp::String &name() const { return name_; }
+        dp::usize queue_count() const { return fds_.size(); }
+        dp::i32 fd(dp::usize queue) const { return queue < fds_.size() ? fds_[queue] : -1; }
+
+        void close() {
+            for (dp::i32 fd : fds_) {
+                ::close(fd);
+            }
+            fds_.clear();
+        }
+    };
+
+    // L2 tunnel: forwards Ethernet frames between device queues (TAP fds) and Streams, in batches
+    // A queue pairs one device fd with one Stream - TCP, reliable UDP, SHM or anything else - and is served by
+    // two threads. The device side reads every frame the device has ready, up to a batch, and sends them as
+    // one Stream message from a buffer that is reused for every batch; the stream side splits received batches
+    // and writes each frame back to the device. Give each queue its own connection so queues never contend on
+    // one: with a multi-queue TAP device that is one worker pair per queue, each on its own core. Both peers
+    // add their queues in the same order.
+    // Frames are dropped, never queued, when the device or the stream cannot keep up - the same thing a
+    // switch does - and the drops are counted in stats().
+    class Tunnel {
+      private:
+        struct Queue {
+            dp::i32 fd;
+            Stream *stream;
+            std::thread device_thread;
+            std::thread stream_thread;
+
+            std::atomic<dp::u64> frames_sent{0};
+            std::atomic<dp::u64> bytes_sent{0};
+            std::atomic<dp::u64> batches_sent{0};
+            std::atomic<dp::u64> frames_received{0};
+            std::atomic<dp::u64> bytes_received{0};
+            std::atomic<dp::u64> batches_received{0};
+            std::atomic<dp::u64> dropped_oversize{0};
+            std::atomic<dp::u64> dropped_send{0};
+            std::atomic<dp::u64> dropped_device{0};
+            std::atomic<dp::u64> dropped_malformed{0};
+        };
+
+        TunnelOptions options_;
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::atomic<bool> running_{false};
+        std::chrono::steady_clock::time_point started_;
+        std::chrono::steady_clock::time_point stopped_;
+
+        // Device -> stream: drain the device into one batch, send it, repeat
+        void device_loop(Queue &queue) {
+            const dp::usize frame_room = TUNNEL_FRAME_HEADER_SIZE + options_.max_frame_size + 1; // +1 spots oversize
+            Message batch(std::max(options_.max_batch_bytes, TUNNEL_BATCH_HEADER_SIZE + frame_room));
+
+            while (running_) {
+                struct pollfd pfd = {queue.fd, POLLIN, 0};
+                if (::poll(&pfd, 1, static_cast<int>(options_.poll_ms)) <= 0) {
+                    continue;
+                }
+                if (pfd.revents & (POLLERR | POLLNVAL)) {
+                    echo::warn("tunnel device fd=", queue.fd, " failed");
+                    break;
+                }
+
+                dp::usize used = TUNNEL_BATCH_HEADER_SIZE;
+                dp::usize count = 0;
+                dp::usize frame_bytes = 0;
+                bool device_gone = false;
+                while (count < options_.max_batch_frames && batch.size() - used >= frame_room) {
+                    dp::u8 *frame = batch.data() + used + TUNNEL_FRAME_HEADER_SIZE;
+                    ssize_t n = ::read(queue.fd, frame, options_.max_frame_size + 1);
+                    if (n < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        device_gone = errno != EAGAIN && errno != EWOULDBLOCK;
+                        break;
+                    }
+                    if (n == 0) {
+                        device_gone = true;
+                        break;
+                    }
+                    if (static_cast<dp::usize>(n) > options_.max_frame_size) {
+                        queue.dropped_oversize.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    batch[used] = static_cast<dp::u8>(n >> 8);
+                    batch[used + 1] = static_cast<dp::u8>(n);
+                    used += TUNNEL_FRAME_HEADER_SIZE + static_cast<dp::usize>(n);
+                    frame_bytes += static_cast<dp::usize>(n);
+                    count++;
+                }
+
+                if (count > 0) {
+                    batch[0] = static_cast<dp::u8>(count >> 8);
+                    batch[1] = static_cast<dp::u8>(count);
+                    iovec part = {batch.data(), used};
+                    if (queue.stream->send_iov({&part, 1}).is_err()) {
+                        queue.dropped_send.fetch_add(count, std::memory_order_relaxed);
+                        if (!queue.stream->is_connected()) {
+                            echo::warn("tunnel stream closed, device fd=", queue.fd);
+                            break;
+                        }
+                    } else {
+                        queue.frames_sent.fetch_add(count, std::memory_order_relaxed);
+                        queue.bytes_sent.fetch_add(frame_bytes, std::memory_order_relaxed);
+                        queue.batches_sent.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                if (device_gone) {
+                    echo::warn("tunnel device fd=", queue.fd, " closed");
+                    break;
+                }
+            }
+        }
+
+        // Stream -> device: one write per frame, as the TAP interface wants it
+        void stream_loop(Queue &queue) {
+            Message batch;
+            while (running_) {
+                auto res = queue.stream->recv_into(batch);
+                if (res.is_err()) {
+                    if (res.error().code == dp::Error::TIMEOUT) {
+                        continue;
+                    }
+                    if (running_) {
+                        echo::debug("tunnel stream recv failed: ", res.error().message.c_str());
+                    }
+                    break;
+                }
+                queue.batches_received.fetch_add(1, std::memory_order_relaxed);
+
+                if (batch.size() < TUNNEL_BATCH_HEADER_SIZE) {
+                    queue.dropped_malformed.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                dp::usize count = (dp::usize(batch[0]) << 8) | batch[1];
+                dp::usize offset = TUNNEL_BATCH_HEADER_SIZE;
+                for (dp::usize i = 0; i < count; i++) {
+                    if (batch.size() - offset < TUNNEL_FRAME_HEADER_SIZE) {
+                        queue.dropped_malformed.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    dp::usize length = (dp::usize(batch[offset]) << 8) | batch[offset + 1];
+                    offset += TUNNEL_FRAME_HEADER_SIZE;
+                    if (batch.size() - offset < length) {
+                        queue.dropped_malformed.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    ssize_t n;
+                    do {
+                        n = ::write(queue.fd, batch.data() + offset, length);
+                    } while (n < 0 && errno == EINTR);
+                    if (n < 0) {
+                        queue.dropped_device.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        queue.frames_received.fetch_add(1, std::memory_order_relaxed);
+                        queue.bytes_received.fetch_add(length, std::memory_order_relaxed);
+                    }
+                    offset += length;
+                }
+            }
+        }
+
+      public:
+        explicit Tunnel(TunnelOptions options = {}) : options_(options) {}
+        ~Tunnel() { stop(); }
+
+        Tunnel(const Tunnel &) = delete;
+        Tunnel &operator=(const Tunnel &) = delete;
+
+        // Bridge a device queue with a connected stream (before start()); neither is owned by the tunnel
+        // device_fd is any fd where a read returns one frame and a write sends one: a TapDevice queue, or a
+        // SOCK_SEQPACKET socket. It is switched to O_NONBLOCK so a batch ends when the device runs dry.
+        dp::Res<void> add_queue(dp::i32 device_fd, Stream &stream) {
+            if (running_) {
+                return dp::result::err(dp::Error::invalid_argument("tunnel already running"));
+            }
+            if (device_fd < 0 || !stream.is_connected()) {
+                return dp::result::err(dp::Error::invalid_argument("device fd or stream not usable"));
+            }
+            if (options_.max_frame_size == 0 || options_.max_frame_size > 0xFFFF || options_.max_batch_frames == 0 ||
+                options_.max_batch_frames > 0xFFFF) {
+                return dp::result::err(dp::Error::invalid_argument("frame size and batch count must fit 16 bits"));
+            }
+            dp::i32 flags = ::fcntl(device_fd, F_GETFL, 0);
+            if (flags < 0 || ::fcntl(device_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+                return dp::result::err(dp::Error::io_error(dp::String("fcntl O_NONBLOCK: ") + strerror(errno)));
+            }
+            auto queue = std::make_unique<Queue>();
+            queue->fd = device_fd;
+            queue->stream = &stream;
+            queues_.push_back(std::move(queue));
+            return dp::result::ok();
+        }
+
+        // Every queue of a TapDevice, paired with streams[i]
+        dp::Res<void> add_queues(const TapDevice &device, const std::vector<Stream *> &streams) {
+            if (streams.size() != device.queue_count()) {
+                return dp::result::err(dp::Error::invalid_argument("one stream per TAP queue"));
+            }
+            for (dp::usize i = 0; i < streams.size(); i++) {
+                auto res = add_queue(device.fd(i), *streams[i]);
+                if (res.is_err()) {
+                    return res;
+                }
+            }
+            return dp::result::ok();
+        }
+
+        dp::Res<void> start() {
+            if (running_) {
+                return dp::result::err(dp::Error::invalid_argument("tunnel already running"));
+            }
+            if (queues_.empty()) {
+                return dp::result::err(dp::Error::invalid_argument("tunnel has no queues"));
+            }
+            for (auto &queue : queues_) {
+                queue->stream->set_recv_timeout(options_.poll_ms);
+            }
+            running_ = true;
+            started_ = std::chrono::steady_clock::now();
+            for (auto &queue : queues_) {
+                Queue &q = *queue;
+                q.device_thread = std::thread([this, &q]() { device_loop(q); });
+                q.stream_thread = std::thread([this, &q]() { stream_loop(q); });
+            }
+            echo::info("tunnel started with ", queues_.size(), " queue(s)");
+            return dp::result::ok();
+        }
+
+        // Join the workers; the devices and streams stay open
+        void stop() {
+            if (!running_.exchange(false)) {
+                return;
+            }
+            for (auto &queue : queues_) {
+                if (queue->device_thread.joinable()) {
+                    queue->device_thread.join();
+                }
+                if (queue->stream_thread.joinable()) {
+                    queue->stream_thread.join();
+                }
+            }
+            stopped_ = std::chrono::steady_clock::now();
+            echo::info("tunnel stopped");
+        }
+
+        bool running() const { return running_; }
+        dp::usize queue_count() const { return queues_.size(); }
+
+        TunnelStats stats() const {
+            TunnelStats stats;
+            for (const auto &queue : queues_) {
+                stats.frames_sent += queue->frames_sent.load(std::memory_order_relaxed);
+                stats.bytes_sent += queue->bytes_sent.load(std::memory_order_relaxed);
+                stats.batches_sent += queue->batches_sent.load(std::memory_order_relaxed);
+                stats.frames_received += queue->frames_received.load(std::memory_order_relaxed);
+                stats.bytes_received += queue->bytes_received.load(std::memory_order_relaxed);
+                stats.batches_received += queue->batches_received.load(std::memory_order_relaxed);
+                stats.dropped_oversize += queue->dropped_oversize.load(std::memory_order_relaxed);
+                stats.dropped_send += queue->dropped_send.load(std::memory_order_relaxed);
+                stats.dropped_device += queue->dropped_device.load(std::memory_order_relaxed);
+                stats.dropped_malformed += queue->dropped_malformed.load(std::memory_order_relaxed);
+            }
+            if (started_ != std::chrono::steady_clock::time_point{}) {
+                auto end = running_ ? std::chrono::steady_clock::now() : stopped_;
+                stats.elapsed_ns = static_cast<dp::u64>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - started_).count());
+            }
+            return stats;
+        }
+    };
+
+} // namespace netpipe
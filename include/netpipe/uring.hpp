@@ -0,0 +1,318 @@
+#pragma once
+
+#include <atomic>
+#include <netpipe/common.hpp>
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace netpipe {
+
+    // Minimal io_uring instance driven through the raw syscalls (no liburing dependency)
+    // One submitter/reaper thread at a time - callers serialize access
+    class IoUring {
+      private:
+        dp::i32 ring_fd_;
+        dp::u32 features_;
+
+        void *sq_ptr_;
+        dp::usize sq_map_size_;
+        void *cq_ptr_;
+        dp::usize cq_map_size_;
+        io_uring_sqe *sqes_;
+        dp::usize sqes_map_size_;
+
+        dp::u32 *sq_head_;
+        dp::u32 *sq_tail_;
+        dp::u32 sq_mask_;
+        dp::u32 sq_entries_;
+        dp::u32 *sq_array_;
+
+        dp::u32 *cq_head_;
+        dp::u32 *cq_tail_;
+        dp::u32 cq_mask_;
+        io_uring_cqe *cqes_;
+
+        dp::u32 to_submit_; // SQEs queued since the last io_uring_enter
+
+        static dp::u32 load_acquire(dp::u32 *p) {
+            return std::atomic_ref<dp::u32>(*p).load(std::memory_order_acquire);
+        }
+        static void store_release(dp::u32 *p, dp::u32 v) {
+            std::atomic_ref<dp::u32>(*p).store(v, std::memory_order_release);
+        }
+
+      public:
+        IoUring()
+            : ring_fd_(-1), features_(0), sq_ptr_(nullptr), sq_map_size_(0), cq_ptr_(nullptr), cq_map_size_(0),
+              sqes_(nullptr), sqes_map_size_(0), sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(0), sq_entries_(0),
+              sq_array_(nullptr), cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(0), cqes_(nullptr), to_submit_(0) {}
+
+        ~IoUring() { close(); }
+
+        IoUring(const IoUring &) = delete;
+        IoUring &operator=(const IoUring &) = delete;
+
+        // Create the ring and map its queues
+        dp::Res<void> init(dp::u32 entries) {
+            io_uring_params params = {};
+            ring_fd_ = static_cast<dp::i32>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (ring_fd_ < 0) {
+                echo::error("io_uring_setup failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io_uring unavailable"));
+            }
+            features_ = params.features;
+
+            // Single mmap (5.4) and timeout-aware enter (5.11) are assumed
+            if (!(features_ & IORING_FEAT_SINGLE_MMAP) || !(features_ & IORING_FEAT_EXT_ARG)) {
+                echo::error("io_uring kernel too old, features=", features_);
+                close();
+                return dp::result::err(dp::Error::io_error("io_uring kernel too old"));
+            }
+
+            sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(dp::u32);
+            cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (cq_map_size_ > sq_map_size_) {
+                sq_map_size_ = cq_map_size_;
+            }
+            cq_map_size_ = 0; // Shares the SQ mapping
+
+            sq_ptr_ = ::mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                             IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED) {
+                sq_ptr_ = nullptr;
+                echo::error("io_uring ring mmap failed: ", strerror(errno));
+                close();
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            cq_ptr_ = sq_ptr_;
+
+            sqes_map_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            void *sqes = ::mmap(nullptr, sqes_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                ring_fd_, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                echo::error("io_uring sqe mmap failed: ", strerror(errno));
+                close();
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+            dp::u8 *sq = static_cast<dp::u8 *>(sq_ptr_);
+            sq_head_ = reinterpret_cast<dp::u32 *>(sq + params.sq_off.head);
+            sq_tail_ = reinterpret_cast<dp::u32 *>(sq + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<dp::u32 *>(sq + params.sq_off.ring_mask);
+            sq_entries_ = params.sq_entries;
+            sq_array_ = reinterpret_cast<dp::u32 *>(sq + params.sq_off.array);
+
+            dp::u8 *cq = static_cast<dp::u8 *>(cq_ptr_);
+            cq_head_ = reinterpret_cast<dp::u32 *>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<dp::u32 *>(cq + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<dp::u32 *>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+            echo::trace("io_uring created fd=", ring_fd_, " entries=", params.sq_entries);
+            return dp::result::ok();
+        }
+
+        void close() {
+            if (sqes_ != nullptr) {
+                ::munmap(sqes_, sqes_map_size_);
+                sqes_ = nullptr;
+            }
+            if (sq_ptr_ != nullptr) {
+                ::munmap(sq_ptr_, sq_map_size_);
+                sq_ptr_ = nullptr;
+                cq_ptr_ = nullptr;
+            }
+            if (ring_fd_ >= 0) {
+                ::close(ring_fd_);
+                ring_fd_ = -1;
+            }
+            to_submit_ = 0;
+        }
+
+        bool is_open() const { return ring_fd_ >= 0; }
+        dp::i32 fd() const { return ring_fd_; }
+
+        // Next free submission entry (zeroed), or nullptr when the queue is full
+        // It is handed to the kernel by the next enter()
+        io_uring_sqe *get_sqe() {
+            dp::u32 head = load_acquire(sq_head_);
+            dp::u32 tail = *sq_tail_;
+            if (tail - head >= sq_entries_) {
+                return nullptr;
+            }
+            dp::u32 index = tail & sq_mask_;
+            io_uring_sqe *sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sq_array_[index] = index;
+            store_release(sq_tail_, tail + 1);
+            to_submit_++;
+            return sqe;
+        }
+
+        // Submit queued SQEs and wait until at least wait_nr completions are available
+        // timeout_ms < 0 waits forever; returns a timeout error if it expires first
+        dp::Res<void> enter(dp::u32 wait_nr, dp::i32 timeout_ms) {
+            dp::u32 flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+            __kernel_timespec ts = {};
+            io_uring_getevents_arg arg = {};
+            void *argp = nullptr;
+            dp::usize argsz = 0;
+            if (wait_nr > 0 && timeout_ms >= 0) {
+                ts.tv_sec = timeout_ms / 1000;
+                ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+                arg.ts = reinterpret_cast<dp::u64>(&ts);
+                flags |= IORING_ENTER_EXT_ARG;
+                argp = &arg;
+                argsz = sizeof(arg);
+            }
+
+            while (true) {
+                dp::i32 ret = static_cast<dp::i32>(
+                    ::syscall(__NR_io_uring_enter, ring_fd_, to_submit_, wait_nr, flags, argp, argsz));
+                if (ret >= 0) {
+                    to_submit_ -= static_cast<dp::u32>(ret) < to_submit_ ? static_cast<dp::u32>(ret) : to_submit_;
+                    return dp::result::ok();
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == ETIME) {
+                    // Only reported when nothing was submitted by this call, so to_submit_ stands
+                    return dp::result::err(dp::Error::timeout("io_uring wait timeout"));
+                }
+                echo::error("io_uring_enter failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+        }
+
+        // Oldest unreaped completion, or nullptr
+        io_uring_cqe *peek_cqe() {
+            dp::u32 head = *cq_head_;
+            if (head == load_acquire(cq_tail_)) {
+                return nullptr;
+            }
+            return &cqes_[head & cq_mask_];
+        }
+
+        // Release the completion returned by peek_cqe()
+        void cqe_seen() { store_release(cq_head_, *cq_head_ + 1); }
+
+        // Register a provided-buffer ring (kernel 5.19+) shared with the kernel at ring_addr
+        dp::Res<void> register_buf_ring(void *ring_addr, dp::u32 entries, dp::u16 group) {
+            io_uring_buf_reg reg = {};
+            reg.ring_addr = reinterpret_cast<dp::u64>(ring_addr);
+            reg.ring_entries = entries;
+            reg.bgid = group;
+            if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+                echo::error("io_uring buffer ring registration failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io_uring buffer ring unavailable"));
+            }
+            return dp::result::ok();
+        }
+
+        // Whether this kernel can create a ring at all
+        static bool is_supported() {
+            IoUring probe;
+            return probe.init(2).is_ok();
+        }
+    };
+
+    // Ring of fixed-size receive buffers the kernel picks from (IOSQE_BUFFER_SELECT)
+    // Buffers come back in completions by id and are handed back with recycle()
+    class ProvidedBuffers {
+      private:
+        io_uring_buf_ring *ring_;
+        dp::usize ring_size_;
+        dp::u8 *storage_;
+        dp::usize storage_size_;
+        dp::u32 count_;
+        dp::u32 buffer_size_;
+        dp::u16 mask_;
+
+        static dp::usize page_round(dp::usize n) {
+            dp::usize page = static_cast<dp::usize>(::sysconf(_SC_PAGESIZE));
+            return (n + page - 1) / page * page;
+        }
+
+      public:
+        ProvidedBuffers()
+            : ring_(nullptr), ring_size_(0), storage_(nullptr), storage_size_(0), count_(0), buffer_size_(0),
+              mask_(0) {}
+
+        ~ProvidedBuffers() { release(); }
+
+        ProvidedBuffers(const ProvidedBuffers &) = delete;
+        ProvidedBuffers &operator=(const ProvidedBuffers &) = delete;
+
+        // Allocate count (power of two) buffers of buffer_size bytes and register them as group
+        dp::Res<void> init(IoUring &uring, dp::u32 count, dp::u32 buffer_size, dp::u16 group) {
+            if (count == 0 || (count & (count - 1)) != 0 || count > 32768) {
+                return dp::result::err(dp::Error::invalid_argument("buffer count must be a power of two"));
+            }
+
+            ring_size_ = page_round(count * sizeof(io_uring_buf));
+            void *ring = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ring == MAP_FAILED) {
+                echo::error("buffer ring mmap failed: ", strerror(errno));
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            ring_ = static_cast<io_uring_buf_ring *>(ring);
+
+            storage_size_ = page_round(static_cast<dp::usize>(count) * buffer_size);
+            void *storage = ::mmap(nullptr, storage_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (storage == MAP_FAILED) {
+                echo::error("receive buffer mmap failed: ", strerror(errno));
+                release();
+                return dp::result::err(dp::Error::io_error("io error"));
+            }
+            storage_ = static_cast<dp::u8 *>(storage);
+            count_ = count;
+            buffer_size_ = buffer_size;
+            mask_ = static_cast<dp::u16>(count - 1);
+
+            auto reg = uring.register_buf_ring(ring_, count, group);
+            if (reg.is_err()) {
+                release();
+                return reg;
+            }
+
+            for (dp::u32 i = 0; i < count; ++i) {
+                recycle(static_cast<dp::u16>(i));
+            }
+            return dp::result::ok();
+        }
+
+        void release() {
+            if (storage_ != nullptr) {
+                ::munmap(storage_, storage_size_);
+                storage_ = nullptr;
+            }
+            if (ring_ != nullptr) {
+                ::munmap(ring_, ring_size_);
+                ring_ = nullptr;
+            }
+        }
+
+        dp::u8 *data(dp::u16 id) const { return storage_ + static_cast<dp::usize>(id) * buffer_size_; }
+        dp::u32 buffer_size() const { return buffer_size_; }
+        dp::u32 count() const { return count_; }
+
+        // Give buffer id back to the kernel
+        void recycle(dp::u16 id) {
+            std::atomic_ref<dp::u16> tail(ring_->tail);
+            dp::u16 t = tail.load(std::memory_order_relaxed);
+            // Index the ring as a plain array: in C++ the header's flex-array member sits 8 bytes in
+            io_uring_buf *buf = reinterpret_cast<io_uring_buf *>(ring_) + (t & mask_);
+            buf->addr = reinterpret_cast<dp::u64>(data(id));
+            buf->len = buffer_size_;
+            buf->bid = id;
+            tail.store(static_cast<dp::u16>(t + 1), std::memory_order_release);
+        }
+    };
+
+} // namespace netpipe
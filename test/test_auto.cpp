@@ -0,0 +1,211 @@
+#include <doctest/doctest.h>
+#include <chrono>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <sys/mman.h>
+#include <thread>
+
+namespace {
+    // Accept one connection on a background thread while the caller connects
+    struct AcceptOne {
+        std::unique_ptr<netpipe::Stream> stream;
+        std::thread thread;
+
+        explicit AcceptOne(netpipe::AutoListener &listener) {
+            thread = std::thread([this, &listener]() {
+                auto res = listener.accept();
+                if (res.is_ok()) {
+                    stream = std::move(res.value());
+                }
+            });
+        }
+
+        std::unique_ptr<netpipe::Stream> join() {
+            thread.join();
+            return std::move(stream);
+        }
+    };
+
+    void check_roundtrip(netpipe::Stream &client, netpipe::Stream &server) {
+        REQUIRE(client.send(netpipe::Message{1, 2, 3}).is_ok());
+        auto at_server = server.recv();
+        REQUIRE(at_server.is_ok());
+        CHECK(at_server.value() == netpipe::Message{1, 2, 3});
+
+        REQUIRE(server.send(netpipe::Message{4, 5}).is_ok());
+        auto at_client = client.recv();
+        REQUIRE(at_client.is_ok());
+        CHECK(at_client.value() == netpipe::Message{4, 5});
+    }
+} // namespace
+
+TEST_CASE("Auto - URI parsing") {
+    auto full = netpipe::parse_auto_uri("auto://127.0.0.1:7000/telemetry");
+    REQUIRE(full.is_ok());
+    CHECK(full.value().tcp.host == "127.0.0.1");
+    CHECK(full.value().tcp.port == 7000);
+    CHECK(full.value().service == "telemetry");
+    CHECK(full.value().shm_name() == "netpipe_telemetry");
+    CHECK(full.value().ipc_path() == "/tmp/netpipe_telemetry.sock");
+
+    auto bare = netpipe::parse_auto_uri("[::1]:7001");
+    REQUIRE(bare.is_ok());
+    CHECK(bare.value().tcp.host == "::1");
+    CHECK(bare.value().service == "7001");
+
+    CHECK(netpipe::parse_auto_uri("auto://localhost").is_err());
+    CHECK(netpipe::parse_auto_uri("auto://localhost:99999").is_err());
+    CHECK(netpipe::parse_auto_uri("auto://localhost:7000/a b").is_err());
+}
+
+TEST_CASE("Auto - Same host picks the fastest transport the client allows") {
+    auto listener = netpipe::listen_auto("auto://127.0.0.1:20048/np_auto_local");
+    REQUIRE(listener.is_ok());
+    CHECK(listener.value()->shm_available());
+    CHECK(listener.value()->ipc_available());
+
+    SUBCASE("Shared memory") {
+        AcceptOne accept(*listener.value());
+        auto client = netpipe::connect_auto("auto://127.0.0.1:20048/np_auto_local");
+        auto server = accept.join();
+        REQUIRE(client.is_ok());
+        REQUIRE(server);
+        CHECK(dynamic_cast<netpipe::ShmStream *>(client.value().get()) != nullptr);
+        CHECK(dynamic_cast<netpipe::ShmStream *>(server.get()) != nullptr);
+        check_roundtrip(*client.value(), *server);
+
+        // Remote runs on top unchanged
+        netpipe::Remote<netpipe::Bidirect> remote_server(*server);
+        netpipe::Remote<netpipe::Bidirect> remote_client(*client.value());
+        remote_server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(netpipe::Message(req.rbegin(), req.rend()));
+        });
+        auto reply = remote_client.call(1, netpipe::Message{1, 2, 3}, 2000);
+        REQUIRE(reply.is_ok());
+        CHECK(reply.value() == netpipe::Message{3, 2, 1});
+    }
+
+    SUBCASE("Unix socket when the client opts out of shared memory") {
+        netpipe::AutoOptions options;
+        options.shm = false;
+        AcceptOne accept(*listener.value());
+        auto client = netpipe::connect_auto("auto://127.0.0.1:20048/np_auto_local", options);
+        auto server = accept.join();
+        REQUIRE(client.is_ok());
+        REQUIRE(server);
+        CHECK(dynamic_cast<netpipe::IpcStream *>(client.value().get()) != nullptr);
+        check_roundtrip(*client.value(), *server);
+    }
+
+    SUBCASE("TCP when the client opts out of both") {
+        netpipe::AutoOptions options;
+        options.shm = false;
+        options.ipc = false;
+        AcceptOne accept(*listener.value());
+        auto client = netpipe::connect_auto("auto://127.0.0.1:20048/np_auto_local", options);
+        auto server = accept.join();
+        REQUIRE(client.is_ok());
+        REQUIRE(server);
+        CHECK(dynamic_cast<netpipe::TcpStream *>(client.value().get()) != nullptr);
+        CHECK(dynamic_cast<netpipe::TcpStream *>(server.get()) != nullptr);
+        check_roundtrip(*client.value(), *server);
+    }
+}
+
+TEST_CASE("Auto - Falls back when the offered transport is unreachable") {
+    auto listener = netpipe::listen_auto("auto://127.0.0.1:20049/np_auto_fallback");
+    REQUIRE(listener.is_ok());
+
+    // As if the client ran in a container with its own /dev/shm: the offer is made but the channel is missing
+    ::shm_unlink("/netpipe_np_auto_fallback_hs");
+    AcceptOne accept(*listener.value());
+    auto client = netpipe::connect_auto("auto://127.0.0.1:20049/np_auto_fallback");
+    auto server = accept.join();
+    REQUIRE(client.is_ok());
+    REQUIRE(server);
+    CHECK(dynamic_cast<netpipe::IpcStream *>(client.value().get()) != nullptr);
+    check_roundtrip(*client.value(), *server);
+
+    // And on to TCP once the socket is gone too
+    ::unlink("/tmp/netpipe_np_auto_fallback.sock");
+    AcceptOne accept_tcp(*listener.value());
+    auto tcp_client = netpipe::connect_auto("auto://127.0.0.1:20049/np_auto_fallback");
+    auto tcp_server = accept_tcp.join();
+    REQUIRE(tcp_client.is_ok());
+    REQUIRE(tcp_server);
+    CHECK(dynamic_cast<netpipe::TcpStream *>(tcp_client.value().get()) != nullptr);
+    check_roundtrip(*tcp_client.value(), *tcp_server);
+}
+
+TEST_CASE("Auto - Concurrent clients are matched to their own upgrades") {
+    auto listener = netpipe::listen_auto("auto://127.0.0.1:20050/np_auto_many");
+    REQUIRE(listener.is_ok());
+    constexpr int CLIENTS = 6;
+
+    // Each server stream echoes what it receives; the client checks it gets its own id back
+    std::vector<std::unique_ptr<netpipe::Stream>> accepted;
+    std::thread server_thread([&]() {
+        for (int i = 0; i < CLIENTS; i++) {
+            auto res = listener.value()->accept();
+            REQUIRE(res.is_ok());
+            accepted.push_back(std::move(res.value()));
+        }
+        for (auto &stream : accepted) {
+            auto msg = stream->recv();
+            REQUIRE(msg.is_ok());
+            REQUIRE(stream->send(msg.value()).is_ok());
+        }
+    });
+
+    std::vector<std::unique_ptr<netpipe::Stream>> clients(CLIENTS);
+    std::vector<std::thread> client_threads;
+    for (int i = 0; i < CLIENTS; i++) {
+        client_threads.emplace_back([&, i]() {
+            netpipe::AutoOptions options;
+            options.shm = (i % 2) == 0; // Half of them on each local transport
+            auto res = netpipe::connect_auto("auto://127.0.0.1:20050/np_auto_many", options);
+            if (res.is_ok()) {
+                clients[i] = std::move(res.value());
+            }
+        });
+    }
+    for (auto &thread : client_threads) {
+        thread.join();
+    }
+    for (int i = 0; i < CLIENTS; i++) {
+        REQUIRE(clients[i]);
+        REQUIRE(clients[i]->send(netpipe::Message{static_cast<dp::u8>(i)}).is_ok());
+    }
+    server_thread.join();
+    for (int i = 0; i < CLIENTS; i++) {
+        auto echo = clients[i]->recv();
+        REQUIRE(echo.is_ok());
+        CHECK(echo.value() == netpipe::Message{static_cast<dp::u8>(i)});
+    }
+}
+
+TEST_CASE("Auto - A silent client does not hold up the others") {
+    netpipe::AutoOptions listen_options;
+    listen_options.handshake_timeout_ms = 10000;
+    auto listener = netpipe::listen_auto("auto://127.0.0.1:20078/np_auto_silent", listen_options);
+    REQUIRE(listener.is_ok());
+
+    // Connects over plain TCP and never says hello
+    netpipe::TcpStream silent;
+    REQUIRE(silent.connect(netpipe::TcpEndpoint{"127.0.0.1", 20078}).is_ok());
+
+    auto start = std::chrono::steady_clock::now();
+    AcceptOne accept(*listener.value());
+    auto client = netpipe::connect_auto("auto://127.0.0.1:20078/np_auto_silent");
+    auto server = accept.join();
+    REQUIRE(client.is_ok());
+    REQUIRE(server);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    check_roundtrip(*client.value(), *server);
+
+    // close() does not wait out the silent client's handshake either
+    start = std::chrono::steady_clock::now();
+    listener.value()->close();
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    silent.close();
+}
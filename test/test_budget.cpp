@@ -0,0 +1,367 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+
+TEST_CASE("MemoryBudget - Reserve, wait and release") {
+    netpipe::MemoryBudget budget(100);
+    CHECK(budget.enabled());
+    CHECK(budget.try_reserve(60));
+    CHECK_FALSE(budget.try_reserve(60));
+    CHECK(budget.in_use() == 60);
+
+    // Times out while the bytes are held, then succeeds once another thread gives them back
+    auto start = std::chrono::steady_clock::now();
+    auto timed_out = budget.reserve(60, 20);
+    REQUIRE(timed_out.is_err());
+    CHECK(timed_out.error().code == dp::Error::TIMEOUT);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(15));
+
+    std::thread releaser([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        budget.release(60);
+    });
+    CHECK(budget.reserve(60, 2000).is_ok());
+    releaser.join();
+    CHECK(budget.waits() == 2);
+    CHECK(budget.in_use() == 60);
+
+    {
+        REQUIRE(budget.try_reserve(40));
+        netpipe::BudgetLease lease(&budget, 40);
+        netpipe::BudgetLease moved(std::move(lease));
+        CHECK(lease.bytes() == 0);
+        CHECK(moved.bytes() == 40);
+        CHECK(budget.in_use() == 100);
+    }
+    budget.release(60);
+    CHECK(budget.in_use() == 0);
+    CHECK(budget.peak() == 100);
+
+    // Larger than the whole limit: admitted alone, never while anything else is held
+    CHECK(budget.try_reserve(500));
+    CHECK_FALSE(budget.try_reserve(1));
+    budget.release(500);
+    CHECK(budget.peak() == 500);
+
+    // Reject watermark
+    budget.set_limit(1000, 200);
+    CHECK_FALSE(budget.rejecting());
+    CHECK(budget.try_reserve(200));
+    CHECK(budget.rejecting());
+    budget.release(200);
+    CHECK_FALSE(budget.rejecting());
+
+    netpipe::MemoryBudget unlimited;
+    CHECK_FALSE(unlimited.enabled());
+    CHECK(unlimited.try_reserve(1ull << 40));
+}
+
+TEST_CASE("MemoryBudget - TCP receive waits for budget") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20063};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    netpipe::MemoryBudget budget(100);
+    budget.set_wait_ms(20);
+    REQUIRE(accepted->set_memory_budget(&budget).is_ok());
+
+    netpipe::Message first(80, 1);
+    netpipe::Message second(80, 2);
+    REQUIRE(client.send(first).is_ok());
+    REQUIRE(client.send(second).is_ok());
+
+    auto res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == first);
+    auto lease = accepted->take_lease();
+    CHECK(lease.bytes() == 80);
+    CHECK(budget.in_use() == 80);
+
+    // The first message is still held, so the second stays unread
+    auto blocked = accepted->recv();
+    REQUIRE(blocked.is_err());
+    CHECK(blocked.error().code == dp::Error::TIMEOUT);
+    CHECK(budget.waits() >= 1);
+
+    lease.release();
+    res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == second);
+    CHECK(budget.in_use() == 80); // The reader's own lease, given back by the next receive or close
+    accepted->close();
+    CHECK(budget.in_use() == 0);
+
+    client.close();
+    listener.close();
+}
+
+TEST_CASE("MemoryBudget - Unbuffered receive times out and resumes") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20071};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    auto *tcp = dynamic_cast<netpipe::TcpStream *>(accepted.get());
+    REQUIRE(tcp != nullptr);
+    REQUIRE(tcp->set_recv_buffer_size(0).is_ok());
+    netpipe::MemoryBudget budget(100);
+    budget.set_wait_ms(20);
+    REQUIRE(accepted->set_memory_budget(&budget).is_ok());
+    REQUIRE(budget.try_reserve(100));
+
+    netpipe::Message message(80, 7);
+    REQUIRE(client.send(message).is_ok());
+
+    // The length prefix is consumed before the budget refuses; the reader keeps it
+    auto blocked = accepted->recv();
+    REQUIRE(blocked.is_err());
+    CHECK(blocked.error().code == dp::Error::TIMEOUT);
+    CHECK(tcp->set_recv_buffer_size(0).is_err());
+
+    budget.release(100);
+    auto res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == message);
+
+    accepted->close();
+    client.close();
+    listener.close();
+}
+
+TEST_CASE("MemoryBudget - Remote rejects requests past the watermark") {
+    const dp::u32 METHOD_ECHO = 1;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20064};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    netpipe::MemoryBudget budget(1 << 20);
+    budget.set_limit(1 << 20, 4096);
+    REQUIRE(accepted->set_memory_budget(&budget).is_ok());
+
+    std::atomic<int> handled{0};
+    netpipe::Remote<netpipe::Bidirect> server(*accepted);
+    server.register_method(METHOD_ECHO, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+        handled++;
+        return dp::result::ok(req);
+    });
+    netpipe::Remote<netpipe::Bidirect> remote(client);
+
+    netpipe::Message request(64, 7);
+    auto res = remote.call(METHOD_ECHO, request, 2000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == request);
+
+    // Something else holds the process past the watermark: requests are answered with an error, unhandled
+    REQUIRE(budget.try_reserve(8192));
+    res = remote.call(METHOD_ECHO, request, 2000);
+    REQUIRE(res.is_err());
+    CHECK(std::string(res.error().message.c_str()) == "memory budget exhausted");
+    CHECK(budget.rejections() == 1);
+    CHECK(handled == 1);
+
+    budget.release(8192);
+    res = remote.call(METHOD_ECHO, request, 2000);
+    REQUIRE(res.is_ok());
+    CHECK(handled == 2);
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("MemoryBudget - RemoteServer rejects requests that do not fit") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20065};
+    REQUIRE(listener->listen(endpoint).is_ok());
+
+    netpipe::MemoryBudget budget(1024);
+    netpipe::remote::RemoteServer server(1);
+    server.set_memory_budget(budget);
+    REQUIRE(server
+                .register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                    return dp::result::ok(req);
+                })
+                .is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    netpipe::TcpStream stream;
+    REQUIRE(stream.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> remote(stream);
+    netpipe::Message request(512, 3);
+    auto res = remote.call(1, request, 2000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == request);
+
+    REQUIRE(budget.try_reserve(768));
+    res = remote.call(1, request, 2000);
+    REQUIRE(res.is_err());
+    CHECK(budget.rejections() == 1);
+    budget.release(768);
+
+    res = remote.call(1, request, 2000);
+    REQUIRE(res.is_ok());
+    for (int i = 0; i < 100 && budget.in_use() != 0; i++) { // Given back once the handler task is done
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(budget.in_use() == 0);
+
+    stream.close();
+    server.stop();
+}
+
+TEST_CASE("MemoryBudget - Replies are read while handlers hold the budget") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20072};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    REQUIRE(client.set_memory_budget(nullptr).is_ok());
+
+    netpipe::MemoryBudget budget(1000);
+    budget.set_wait_ms(20);
+    REQUIRE(accepted->set_memory_budget(&budget).is_ok());
+
+    // The handler holds its 600-byte request while waiting on a 600-byte reply from the caller
+    netpipe::Remote<netpipe::Bidirect> server(*accepted);
+    netpipe::Remote<netpipe::Bidirect> remote(client);
+    remote.register_method(2, [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+        return dp::result::ok(netpipe::Message(600, 2));
+    });
+    server.register_method(1, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+        CHECK(budget.in_use() >= req.size());
+        auto nested = server.call(2, netpipe::Message{1}, 2000);
+        if (nested.is_err()) {
+            return dp::result::err(nested.error());
+        }
+        return dp::result::ok(netpipe::Message{static_cast<dp::u8>(nested.value().size() / 100)});
+    });
+
+    auto res = remote.call(1, netpipe::Message(600, 1), 3000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == netpipe::Message{6});
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("MemoryBudget - Fragments stay counted until the message is handled") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20073};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    netpipe::MemoryBudget budget(1 << 20);
+    REQUIRE(accepted->set_memory_budget(&budget).is_ok());
+
+    std::atomic<dp::u64> held{0};
+    netpipe::Remote<netpipe::Bidirect> server(*accepted);
+    server.register_method(1, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+        held = budget.in_use();
+        return dp::result::ok(netpipe::Message{static_cast<dp::u8>(req.size() / 1024)});
+    });
+    netpipe::Remote<netpipe::Bidirect> remote(client);
+    remote.set_fragmentation(4096);
+
+    auto res = remote.call(1, netpipe::Message(64 * 1024, 3), 3000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == netpipe::Message{64});
+    CHECK(held >= 64 * 1024);
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("MemoryBudget - RemoteServer turns away a frame too big to buffer") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20074};
+    REQUIRE(listener->listen(endpoint).is_ok());
+
+    netpipe::MemoryBudget budget(128 * 1024);
+    netpipe::remote::RemoteServer server(1);
+    server.set_memory_budget(budget);
+    REQUIRE(server
+                .register_method(1,
+                                 [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                                     return dp::result::ok(req);
+                                 })
+                .is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    netpipe::TcpStream stream;
+    REQUIRE(stream.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> remote(stream);
+
+    // Most of the budget is taken, so the 200 KB request is refused before the inbox grows for it
+    REQUIRE(budget.try_reserve(100 * 1024));
+    auto res = remote.call(1, netpipe::Message(200 * 1024, 1), 3000);
+    REQUIRE(res.is_err());
+    CHECK(std::string(res.error().message.c_str()) == "memory budget exhausted");
+    CHECK(budget.rejections() == 1);
+
+    // Its payload was dropped unread and the connection carries on
+    netpipe::Message small(100, 2);
+    res = remote.call(1, small, 3000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == small);
+
+    budget.release(100 * 1024);
+    for (int i = 0; i < 100 && budget.in_use() > 0; i++) { // The small request's handler lets go after replying
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    netpipe::Message large(200 * 1024, 3);
+    res = remote.call(1, large, 3000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == large);
+
+    stream.close();
+    server.stop();
+}
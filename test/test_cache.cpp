@@ -0,0 +1,165 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+using netpipe::remote::ResponseCache;
+
+TEST_CASE("ResponseCache - Lookup, LRU, TTL and invalidation") {
+    ResponseCache cache(4 * (ResponseCache::ENTRY_OVERHEAD + 110));
+    netpipe::Message request{1, 2, 3};
+    netpipe::Message response(100, 0x5a);
+
+    // Methods that are not cached are neither stored nor found
+    cache.store(7, request, response, netpipe::remote::MessageFlags::None, cache.generation());
+    CHECK(cache.lookup(7, request) == nullptr);
+    CHECK(cache.size() == 0);
+
+    cache.enable(7);
+    CHECK(cache.enabled(7));
+    CHECK_FALSE(cache.enabled(8));
+    CHECK(cache.lookup(7, request) == nullptr);
+    cache.store(7, request, response, netpipe::remote::MessageFlags::Compressed, cache.generation());
+    auto hit = cache.lookup(7, request);
+    REQUIRE(hit != nullptr);
+    CHECK(hit->payload == response);
+    CHECK(hit->flags == netpipe::remote::MessageFlags::Compressed);
+    CHECK(cache.lookup(7, netpipe::Message{1, 2, 4}) == nullptr);
+    CHECK(cache.hits() == 1);
+    CHECK(cache.misses() == 2);
+
+    // A response computed before an invalidation is not stored
+    dp::u64 generation = cache.generation();
+    CHECK(cache.invalidate(7) == 1);
+    cache.store(7, request, response, netpipe::remote::MessageFlags::None, generation);
+    CHECK(cache.lookup(7, request) == nullptr);
+
+    // The least recently used entry goes first once the byte bound is reached
+    for (dp::u8 i = 0; i < 4; i++) {
+        cache.store(7, netpipe::Message{i}, response, netpipe::remote::MessageFlags::None, cache.generation());
+    }
+    CHECK(cache.size() == 4);
+    CHECK(cache.lookup(7, netpipe::Message{0}) != nullptr); // 1 is now the oldest
+    cache.store(7, netpipe::Message{4}, response, netpipe::remote::MessageFlags::None, cache.generation());
+    CHECK(cache.evictions() == 1);
+    CHECK(cache.lookup(7, netpipe::Message{1}) == nullptr);
+    CHECK(cache.lookup(7, netpipe::Message{0}) != nullptr);
+    CHECK(cache.bytes() <= cache.capacity());
+
+    CHECK(cache.invalidate(7, netpipe::Message{0}));
+    CHECK_FALSE(cache.invalidate(7, netpipe::Message{0}));
+    cache.set_capacity(ResponseCache::ENTRY_OVERHEAD + 110);
+    CHECK(cache.size() == 1);
+
+    // Entries larger than the whole cache are not kept
+    cache.store(7, request, netpipe::Message(4096, 1), netpipe::remote::MessageFlags::None, cache.generation());
+    CHECK(cache.lookup(7, request) == nullptr);
+
+    cache.enable(9, 20);
+    cache.store(9, request, response, netpipe::remote::MessageFlags::None, cache.generation());
+    CHECK(cache.lookup(9, request) != nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    CHECK(cache.lookup(9, request) == nullptr);
+
+    cache.disable(7);
+    CHECK_FALSE(cache.enabled(7));
+    CHECK(cache.size() == 0);
+}
+
+TEST_CASE("ResponseCache - Remote<Bidirect> answers repeated requests without the handler") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20058};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client_stream;
+    REQUIRE(client_stream.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        netpipe::Remote<netpipe::Bidirect> client(client_stream);
+        std::atomic<int> runs{0};
+        std::atomic<dp::u8> version{1};
+        server.register_method(1, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            runs++;
+            if (req.empty()) {
+                return dp::result::err(dp::Error::invalid_argument("empty tile id"));
+            }
+            return dp::result::ok(netpipe::Message(4096, static_cast<dp::u8>(req[0] + version)));
+        });
+        server.set_method_cached(1);
+        server.set_compression(std::make_shared<netpipe::remote::Lz4Codec>(), 256);
+
+        for (int i = 0; i < 5; i++) {
+            auto res = client.call(1, netpipe::Message{10}, 2000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == netpipe::Message(4096, 11));
+        }
+        CHECK(runs == 1);
+        CHECK(server.response_cache().hits() == 4);
+
+        auto other = client.call(1, netpipe::Message{20}, 2000);
+        REQUIRE(other.is_ok());
+        CHECK(other.value() == netpipe::Message(4096, 21));
+        CHECK(runs == 2);
+
+        // Errors are answered every time
+        CHECK(client.call(1, netpipe::Message{}, 2000).is_err());
+        CHECK(client.call(1, netpipe::Message{}, 2000).is_err());
+        CHECK(runs == 4);
+
+        // After the data changed
+        version = 2;
+        CHECK(server.invalidate_cached(1) == 2);
+        auto fresh = client.call(1, netpipe::Message{10}, 2000);
+        REQUIRE(fresh.is_ok());
+        CHECK(fresh.value() == netpipe::Message(4096, 12));
+        CHECK(runs == 5);
+    }
+
+    client_stream.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("ResponseCache - RemoteServer serves hits from the event loop") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20058};
+    REQUIRE(listener->listen(endpoint).is_ok());
+
+    netpipe::remote::RemoteServer server(2);
+    std::atomic<int> runs{0};
+    REQUIRE(server
+                .register_method(3,
+                                 [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                                     runs++;
+                                     return dp::result::ok(req);
+                                 })
+                .is_ok());
+    server.set_method_cached(3, 60000);
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    netpipe::TcpStream stream;
+    REQUIRE(stream.connect(endpoint).is_ok());
+    {
+        netpipe::Remote<netpipe::Unidirect> remote(stream);
+        for (int i = 0; i < 3; i++) {
+            auto res = remote.call(3, netpipe::Message{7, 7}, 2000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == netpipe::Message{7, 7});
+        }
+    }
+    CHECK(runs == 1);
+    CHECK(server.response_cache().hits() == 2);
+
+    stream.close();
+    server.stop();
+}
@@ -0,0 +1,132 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    // Two calls back to back from inside a coroutine; the second starts on the receiver thread
+    netpipe::remote::Task<dp::usize> call_twice(netpipe::Remote<netpipe::Bidirect> &remote) {
+        netpipe::Message a{1, 2, 3};
+        netpipe::Message b{4, 5};
+        auto first = co_await remote.call_async(1, a);
+        auto second = co_await remote.call_async(1, b);
+        if (first.is_err() || second.is_err()) {
+            co_return 0;
+        }
+        co_return first.value().size() + second.value().size();
+    }
+
+} // namespace
+
+TEST_CASE("Remote<Bidirect> - call_async") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20015};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted, 256);
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+        server.register_method(2, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            std::this_thread::sleep_for(std::chrono::milliseconds(600));
+            return dp::result::ok(req);
+        });
+
+        netpipe::Remote<netpipe::Bidirect> remote(client, 256, true);
+
+        SUBCASE("Many calls in flight from one thread") {
+            std::vector<netpipe::remote::Task<dp::Res<netpipe::Message>>> tasks;
+            for (int i = 0; i < 200; i++) {
+                tasks.push_back(remote.call_async(1, netpipe::Message{static_cast<dp::u8>(i), 7}));
+            }
+            for (int i = 0; i < 200; i++) {
+                auto res = tasks[i].get();
+                REQUIRE(res.is_ok());
+                CHECK(res.value() == netpipe::Message{static_cast<dp::u8>(i), 7});
+            }
+            CHECK(remote.pending_count() == 0);
+            CHECK(remote.get_client_metrics().successful_requests == 200);
+        }
+
+        SUBCASE("co_await from another coroutine") {
+            auto task = call_twice(remote);
+            CHECK(task.get() == 5);
+        }
+
+        SUBCASE("Timeout resumes the caller") {
+            auto start = std::chrono::steady_clock::now();
+            auto res = remote.call_async(2, netpipe::Message{1}, 50).get();
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            REQUIRE(res.is_err());
+            CHECK(res.error().code == dp::Error::TIMEOUT);
+            CHECK(elapsed < std::chrono::milliseconds(400));
+            CHECK(remote.pending_count() == 0);
+        }
+
+        SUBCASE("Dropped task still completes and frees its slot") {
+            {
+                auto task = remote.call_async(1, netpipe::Message{9});
+            }
+            for (int i = 0; i < 200 && remote.pending_count() > 0; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            CHECK(remote.pending_count() == 0);
+        }
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("RemoteAsync - call_async") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20016};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+
+        netpipe::RemoteAsync remote(client, 32);
+        std::vector<netpipe::remote::Task<dp::Res<netpipe::Message>>> tasks;
+        for (int i = 0; i < 32; i++) {
+            tasks.push_back(remote.call_async(1, netpipe::Message{static_cast<dp::u8>(i)}));
+        }
+        for (int i = 0; i < 32; i++) {
+            auto res = tasks[i].get();
+            REQUIRE(res.is_ok());
+            CHECK(res.value()[0] == i);
+        }
+        CHECK(remote.pending_count() == 0);
+    }
+
+    accepted->close();
+    listener.close();
+}
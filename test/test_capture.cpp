@@ -0,0 +1,194 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    void remove_capture(const char *path) {
+        for (dp::u32 segment = 0; segment < 64; segment++) {
+            ::unlink(netpipe::capture_segment_path(path, segment).c_str());
+        }
+    }
+
+    // Connected TCP pair on port
+    struct TcpPair {
+        netpipe::TcpStream listener;
+        netpipe::TcpStream client;
+        std::unique_ptr<netpipe::Stream> server;
+
+        explicit TcpPair(dp::u16 port) {
+            REQUIRE(listener.listen({"127.0.0.1", port}).is_ok());
+            std::thread accept_thread([&]() {
+                auto res = listener.accept();
+                REQUIRE(res.is_ok());
+                server = std::move(res.value());
+            });
+            REQUIRE(client.connect({"127.0.0.1", port}).is_ok());
+            accept_thread.join();
+        }
+    };
+
+    void register_echo(netpipe::Remote<netpipe::Bidirect> &remote, std::atomic<int> &calls) {
+        remote.register_method(3, [&calls](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            calls++;
+            return dp::result::ok(req);
+        });
+    }
+} // namespace
+
+TEST_CASE("Capture - Segment round trip, index and seeking") {
+    const char *path = "/tmp/np_capture_roundtrip.npcap";
+    remove_capture(path);
+    netpipe::CaptureOptions options;
+    options.grow_size = 8192; // Forces several remaps
+    options.index_interval = 16;
+
+    netpipe::CaptureWriter writer;
+    REQUIRE(writer.open(path, options).is_ok());
+    std::vector<dp::u64> stamps;
+    for (dp::u32 i = 0; i < 500; i++) {
+        netpipe::Message payload(i % 97, static_cast<dp::u8>(i));
+        auto direction = i % 2 ? netpipe::CaptureDirection::Rx : netpipe::CaptureDirection::Tx;
+        REQUIRE(writer.append(direction, static_cast<dp::u16>(i % 3), payload).is_ok());
+    }
+    CHECK(writer.record_count() == 500);
+
+    SUBCASE("A live segment is readable by scanning") {
+        netpipe::CaptureReader live;
+        REQUIRE(live.open(path).is_ok());
+        CHECK_FALSE(live.indexed());
+        CHECK(live.record_count() == 500);
+    }
+
+    writer.close();
+    netpipe::CaptureReader reader;
+    REQUIRE(reader.open(path).is_ok());
+    CHECK(reader.indexed());
+    CHECK(reader.record_count() == 500);
+    for (dp::u32 i = 0; i < 500; i++) {
+        auto rec = reader.next();
+        REQUIRE(rec.is_ok());
+        CHECK(rec.value().payload.size() == i % 97);
+        CHECK(rec.value().channel == i % 3);
+        CHECK(rec.value().direction == (i % 2 ? netpipe::CaptureDirection::Rx : netpipe::CaptureDirection::Tx));
+        if (!rec.value().payload.empty()) {
+            CHECK(rec.value().payload.front() == static_cast<dp::u8>(i));
+        }
+        stamps.push_back(rec.value().timestamp_ns);
+    }
+    CHECK(reader.next().is_err());
+
+    // Seeking lands on the first record at or after the time
+    reader.seek(stamps[321]);
+    auto found = reader.next();
+    REQUIRE(found.is_ok());
+    CHECK(found.value().timestamp_ns == stamps[321]);
+    CHECK(found.value().timestamp_ns >= stamps[320]);
+    reader.rewind();
+    REQUIRE(reader.next().is_ok());
+
+    CHECK(reader.open("/tmp/np_capture_missing.npcap").is_err());
+    remove_capture(path);
+}
+
+TEST_CASE("Capture - Segments roll over") {
+    const char *path = "/tmp/np_capture_roll.npcap";
+    remove_capture(path);
+    netpipe::CaptureOptions options;
+    options.segment_size = 16 * 1024;
+    options.grow_size = 4096;
+
+    netpipe::CaptureWriter writer;
+    REQUIRE(writer.open(path, options).is_ok());
+    netpipe::Message payload(1000, 0x5A);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(writer.append(netpipe::CaptureDirection::Tx, 0, payload).is_ok());
+    }
+    writer.close();
+    CHECK(writer.segment_count() > 4);
+
+    dp::u64 total = 0;
+    for (dp::u32 segment = 0; segment < writer.segment_count(); segment++) {
+        netpipe::CaptureReader reader;
+        REQUIRE(reader.open(netpipe::capture_segment_path(path, segment)).is_ok());
+        CHECK(reader.indexed());
+        CHECK(reader.segment() == segment);
+        total += reader.record_count();
+    }
+    CHECK(total == 100);
+
+    // Replaying the whole capture walks every segment
+    netpipe::UdpDatagram sender;
+    netpipe::UdpDatagram receiver;
+    REQUIRE(sender.bind({"127.0.0.1", 0}).is_ok());
+    REQUIRE(receiver.bind({"127.0.0.1", 20051}).is_ok());
+    netpipe::ReplayOptions replay_options;
+    replay_options.speed = 0;
+    netpipe::CaptureReplayer replayer(path);
+    auto stats = replayer.replay(sender, {"127.0.0.1", 20051}, replay_options);
+    REQUIRE(stats.is_ok());
+    CHECK(stats.value().messages == 100);
+    CHECK(stats.value().bytes == 100 * 1000);
+    remove_capture(path);
+}
+
+TEST_CASE("Capture - Record a Remote client and replay it against a server") {
+    const char *path = "/tmp/np_capture_remote.npcap";
+    remove_capture(path);
+    netpipe::CaptureWriter writer;
+    REQUIRE(writer.open(path).is_ok());
+
+    std::atomic<int> calls{0};
+    {
+        TcpPair pair(20052);
+        netpipe::RecordingStream recorded(pair.client, writer);
+        netpipe::Remote<netpipe::Bidirect> server(*pair.server);
+        register_echo(server, calls);
+        netpipe::Remote<netpipe::Bidirect> client(recorded);
+        for (dp::u8 i = 0; i < 5; i++) {
+            auto res = client.call(3, netpipe::Message{i, i}, 2000);
+            REQUIRE(res.is_ok());
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    writer.close();
+    CHECK(calls == 5);
+
+    // Requests went out, responses came in, all on the client's channel
+    netpipe::CaptureReader reader;
+    REQUIRE(reader.open(path).is_ok());
+    int tx = 0;
+    int rx = 0;
+    for (auto rec = reader.next(); rec.is_ok(); rec = reader.next()) {
+        (rec.value().direction == netpipe::CaptureDirection::Tx ? tx : rx)++;
+    }
+    CHECK(tx == 5);
+    CHECK(rx == 5);
+
+    TcpPair target(20053);
+    netpipe::Remote<netpipe::Bidirect> server(*target.server);
+    register_echo(server, calls);
+    netpipe::CaptureReplayer replayer(path);
+
+    SUBCASE("At the recorded pace") {
+        auto stats = replayer.replay(target.client);
+        REQUIRE(stats.is_ok());
+        CHECK(stats.value().messages == 5);
+        CHECK(stats.value().responses == 5);
+        CHECK(stats.value().elapsed_ns >= 4 * 15'000'000ull);
+    }
+
+    SUBCASE("At max rate") {
+        netpipe::ReplayOptions options;
+        options.speed = 0;
+        auto stats = replayer.replay(target.client, options);
+        REQUIRE(stats.is_ok());
+        CHECK(stats.value().messages == 5);
+        CHECK(stats.value().responses == 5);
+        CHECK(stats.value().elapsed_ns < 4 * 15'000'000ull);
+    }
+    CHECK(calls == 10);
+    remove_capture(path);
+}
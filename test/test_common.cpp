@@ -1,6 +1,11 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
+#include <cstring>
 #include <netpipe/common.hpp>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
 
 TEST_CASE("encode_u32_be") {
     auto bytes = netpipe::encode_u32_be(0x12345678);
@@ -29,3 +34,182 @@ TEST_CASE("Message type") {
     CHECK(msg[0] == 0x01);
     CHECK(msg[3] == 0x04);
 }
+
+// Write a length-prefixed frame to an fd
+static void write_frame(int fd, const netpipe::Message &payload) {
+    netpipe::Message frame;
+    netpipe::append_u32_be(frame, static_cast<dp::u32>(payload.size()));
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    REQUIRE(netpipe::write_exact(fd, frame.data(), frame.size()).is_ok());
+}
+
+TEST_CASE("FrameReader") {
+    int fds[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    // Short receive timeout so incomplete frames surface as timeouts
+    struct timeval tv = {0, 50 * 1000};
+    REQUIRE(::setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0);
+
+    SUBCASE("Several frames parsed from one buffer fill") {
+        netpipe::FrameReader reader;
+        for (int i = 0; i < 50; i++) {
+            write_frame(fds[1], netpipe::Message(static_cast<dp::usize>(i), static_cast<dp::u8>(i)));
+        }
+
+        for (int i = 0; i < 50; i++) {
+            auto res = reader.read_frame(fds[0], 1024);
+            REQUIRE(res.is_ok());
+            CHECK(res.value().size() == static_cast<dp::usize>(i));
+            CHECK(res.value() == netpipe::Message(static_cast<dp::usize>(i), static_cast<dp::u8>(i)));
+        }
+        CHECK(reader.buffered() == 0);
+    }
+
+    SUBCASE("Frames larger than the buffer are read directly") {
+        netpipe::FrameReader reader(64);
+        netpipe::Message large(1000);
+        for (dp::usize i = 0; i < large.size(); i++) {
+            large[i] = static_cast<dp::u8>(i * 3);
+        }
+        write_frame(fds[1], {1, 2, 3});
+        write_frame(fds[1], large);
+        write_frame(fds[1], {4, 5});
+
+        auto first = reader.read_frame(fds[0], 4096);
+        REQUIRE(first.is_ok());
+        CHECK(first.value() == netpipe::Message{1, 2, 3});
+
+        auto second = reader.read_frame(fds[0], 4096);
+        REQUIRE(second.is_ok());
+        CHECK(second.value() == large);
+
+        auto third = reader.read_frame(fds[0], 4096);
+        REQUIRE(third.is_ok());
+        CHECK(third.value() == netpipe::Message{4, 5});
+    }
+
+    SUBCASE("Partial frame survives a timeout") {
+        netpipe::FrameReader reader;
+        dp::u8 part1[] = {0, 0, 0, 3, 'a'};
+        dp::u8 part2[] = {'b', 'c'};
+
+        REQUIRE(netpipe::write_exact(fds[1], part1, sizeof(part1)).is_ok());
+        auto res = reader.read_frame(fds[0], 1024);
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::TIMEOUT);
+        CHECK(reader.buffered() == sizeof(part1));
+        CHECK(reader.set_capacity(128).is_err());
+
+        REQUIRE(netpipe::write_exact(fds[1], part2, sizeof(part2)).is_ok());
+        res = reader.read_frame(fds[0], 1024);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{'a', 'b', 'c'});
+    }
+
+    SUBCASE("Unbuffered mode") {
+        netpipe::FrameReader reader(0);
+        write_frame(fds[1], {7, 8, 9});
+        write_frame(fds[1], {});
+
+        auto res = reader.read_frame(fds[0], 1024);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{7, 8, 9});
+        CHECK(reader.buffered() == 0);
+
+        res = reader.read_frame(fds[0], 1024);
+        REQUIRE(res.is_ok());
+        CHECK(res.value().empty());
+    }
+
+    SUBCASE("Split read puts the prefix and the rest in separate buffers") {
+        netpipe::Message large(5000);
+        for (dp::usize i = 0; i < large.size(); ++i) {
+            large[i] = static_cast<dp::u8>(i * 7);
+        }
+
+        for (dp::usize capacity : {netpipe::FrameReader::DEFAULT_CAPACITY, dp::usize(64), dp::usize(0)}) {
+            netpipe::FrameReader reader(capacity);
+            write_frame(fds[1], {1, 2, 3, 4, 5, 6});
+            write_frame(fds[1], large);
+            write_frame(fds[1], {9, 9});
+
+            dp::u8 prefix[4] = {};
+            netpipe::Message rest;
+            auto res = reader.read_frame_split(fds[0], 1 << 20, prefix, 4, rest);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == 4);
+            CHECK(prefix[0] == 1);
+            CHECK(prefix[3] == 4);
+            CHECK(rest == netpipe::Message{5, 6});
+
+            res = reader.read_frame_split(fds[0], 1 << 20, prefix, 4, rest);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == 4);
+            CHECK(std::memcmp(prefix, large.data(), 4) == 0);
+            CHECK(rest == netpipe::Message(large.begin() + 4, large.end()));
+
+            // Shorter than the prefix: everything lands in prefix, rest is empty
+            res = reader.read_frame_split(fds[0], 1 << 20, prefix, 4, rest);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == 2);
+            CHECK(prefix[1] == 9);
+            CHECK(rest.empty());
+            CHECK(reader.buffered() == 0);
+        }
+    }
+
+    SUBCASE("Oversized frame and EOF are errors") {
+        netpipe::FrameReader reader;
+        write_frame(fds[1], netpipe::Message(100));
+        auto res = reader.read_frame(fds[0], 10);
+        REQUIRE(res.is_err());
+
+        netpipe::FrameReader fresh;
+        ::close(fds[1]);
+        fds[1] = -1;
+        res = fresh.read_frame(fds[0], 1024);
+        REQUIRE(res.is_err());
+    }
+
+    ::close(fds[0]);
+    if (fds[1] >= 0) {
+        ::close(fds[1]);
+    }
+}
+
+TEST_CASE("writev_frames and fd_readable") {
+    int fds[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    CHECK_FALSE(netpipe::fd_readable(fds[0]));
+
+    // 300 two-part frames need more than one writev round
+    std::vector<netpipe::Message> heads, bodies;
+    for (int i = 0; i < 300; i++) {
+        heads.push_back(netpipe::Message{static_cast<dp::u8>(i)});
+        bodies.push_back(netpipe::Message(static_cast<dp::usize>(i % 7), 0xEE));
+    }
+    std::vector<iovec> iov(600);
+    std::vector<std::span<const iovec>> frames;
+    for (int i = 0; i < 300; i++) {
+        iov[2 * i] = {heads[i].data(), heads[i].size()};
+        iov[2 * i + 1] = {bodies[i].data(), bodies[i].size()};
+        frames.emplace_back(&iov[2 * i], 2);
+    }
+
+    std::thread writer([&]() { CHECK(netpipe::writev_frames(fds[1], frames).is_ok()); });
+
+    netpipe::FrameReader reader;
+    for (int i = 0; i < 300; i++) {
+        auto res = reader.read_frame(fds[0], 1024);
+        REQUIRE(res.is_ok());
+        REQUIRE(res.value().size() == 1 + static_cast<dp::usize>(i % 7));
+        CHECK(res.value()[0] == static_cast<dp::u8>(i));
+    }
+    writer.join();
+    CHECK_FALSE(netpipe::fd_readable(fds[0]));
+
+    ::close(fds[1]);
+    CHECK(netpipe::fd_readable(fds[0])); // EOF is reported as readable
+    ::close(fds[0]);
+}
@@ -0,0 +1,199 @@
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+using namespace netpipe::remote;
+
+namespace {
+    void register_echo(netpipe::Remote<netpipe::Bidirect> &remote) {
+        remote.register_method(7, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            netpipe::Message out(req);
+            out.push_back(0xEE);
+            return dp::result::ok(out);
+        });
+    }
+
+    void check_echo(netpipe::Remote<netpipe::Bidirect> &remote, dp::usize calls) {
+        for (dp::usize i = 0; i < calls; i++) {
+            netpipe::Message request{static_cast<dp::u8>(i), 1, 2};
+            auto res = remote.call(7, request, 2000);
+            REQUIRE(res.is_ok());
+            request.push_back(0xEE);
+            CHECK(res.value() == request);
+        }
+    }
+} // namespace
+
+TEST_CASE("Compact header encoding") {
+    dp::u8 buffer[COMPACT_HEADER_MAX];
+
+    SUBCASE("Small ids fit in three bytes and round-trip") {
+        CompactHeader header{MessageType::Request, MessageFlags::None, 5, 7};
+        auto size = encode_compact_header(header, buffer, nullptr);
+        CHECK(size == 3);
+        CHECK(buffer[0] == (CompactBits::Marker | static_cast<dp::u8>(MessageType::Request)));
+
+        CompactHeader decoded{};
+        CompactDelta rx;
+        auto res = decode_compact_header(buffer, size, decoded, rx);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == size);
+        CHECK(decoded.type == MessageType::Request);
+        CHECK(decoded.flags == MessageFlags::None);
+        CHECK(decoded.request_id == 5);
+        CHECK(decoded.method_id == 7);
+    }
+
+    SUBCASE("Large fields and flags use the full varint range") {
+        CompactHeader header{MessageType::StreamCredit, 0xFFFF, 0xFFFFFFFF, 0x12345678};
+        auto size = encode_compact_header(header, buffer, nullptr);
+        CHECK(size == COMPACT_HEADER_MAX);
+        CompactHeader decoded{};
+        CompactDelta rx;
+        REQUIRE(decode_compact_header(buffer, size, decoded, rx).is_ok());
+        CHECK(decoded.type == MessageType::StreamCredit);
+        CHECK(decoded.flags == 0xFFFF);
+        CHECK(decoded.request_id == 0xFFFFFFFF);
+        CHECK(decoded.method_id == 0x12345678);
+
+        CHECK(decode_compact_header(buffer, size - 1, decoded, rx).is_err());
+    }
+
+    SUBCASE("Delta compression follows a sequence of headers") {
+        CompactDelta tx;
+        CompactDelta rx;
+        dp::u32 ids[] = {100000, 100001, 100002, 99990, 5, 5};
+        dp::u32 methods[] = {300, 300, 301, 301, 301, 300};
+        dp::usize sizes[6];
+        for (int i = 0; i < 6; i++) {
+            CompactHeader header{MessageType::Response, MessageFlags::None, ids[i], methods[i]};
+            sizes[i] = encode_compact_header(header, buffer, &tx);
+            CompactHeader decoded{};
+            REQUIRE(decode_compact_header(buffer, sizes[i], decoded, rx).is_ok());
+            CHECK(decoded.request_id == ids[i]);
+            CHECK(decoded.method_id == methods[i]);
+        }
+        CHECK(sizes[0] == 1 + 3 + 2); // No base yet
+        CHECK(sizes[1] == 2);         // +1 and the same method
+        CHECK(sizes[2] == 1 + 1 + 2); // New method
+        CHECK(sizes[3] == 2);         // -12
+        CHECK(sizes[4] == 2);         // The id itself is shorter than its delta
+
+        // A receiver that missed the base cannot decode a delta
+        CompactHeader header{MessageType::Response, MessageFlags::None, 6, 300};
+        auto size = encode_compact_header(header, buffer, &tx);
+        CompactDelta fresh;
+        CompactHeader decoded{};
+        CHECK(decode_compact_header(buffer, size, decoded, fresh).is_err());
+    }
+}
+
+TEST_CASE("CompactStream - Remote over negotiated compact headers") {
+    netpipe::TcpStream listener;
+    REQUIRE(listener.listen({"127.0.0.1", 20042}).is_ok());
+    CompactOptions options;
+    options.delta = true;
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client_tcp;
+    REQUIRE(client_tcp.connect({"127.0.0.1", 20042}).is_ok());
+    accept_thread.join();
+
+    CompactStream client(client_tcp, options);
+    CompactStream server(std::move(accepted), options);
+    dp::Res<bool> server_res = dp::result::ok(false);
+    std::thread server_thread([&]() { server_res = server.negotiate(2000); });
+    auto client_res = client.negotiate(2000);
+    server_thread.join();
+    REQUIRE(client_res.is_ok());
+    REQUIRE(server_res.is_ok());
+    CHECK(client_res.value());
+    CHECK(server_res.value());
+    CHECK(client.compact_active());
+
+    {
+        netpipe::Remote<netpipe::Bidirect> remote_server(server);
+        netpipe::Remote<netpipe::Bidirect> remote_client(client);
+        register_echo(remote_server);
+        remote_server.set_deadline_propagation(true); // Flags and trailer survive the re-encoding
+        remote_client.set_deadline_propagation(true);
+        check_echo(remote_client, 20);
+    }
+    CHECK(client.header_bytes_saved() >= 20 * 10);
+    CHECK(server.header_bytes_saved() >= 20 * 10);
+
+    client.close();
+    server.close();
+    listener.close();
+}
+
+TEST_CASE("CompactStream - Falls back to V2 with a plain peer") {
+    netpipe::TcpStream listener;
+    REQUIRE(listener.listen({"127.0.0.1", 20043}).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client_tcp;
+    REQUIRE(client_tcp.connect({"127.0.0.1", 20043}).is_ok());
+    accept_thread.join();
+
+    // The server is a plain Remote: it drops the hello and never answers
+    netpipe::Remote<netpipe::Bidirect> remote_server(*accepted);
+    register_echo(remote_server);
+
+    CompactStream client(client_tcp);
+    auto res = client.negotiate(300);
+    REQUIRE(res.is_ok());
+    CHECK_FALSE(res.value());
+    CHECK_FALSE(client.compact_active());
+    {
+        netpipe::Remote<netpipe::Bidirect> remote_client(client);
+        check_echo(remote_client, 5);
+    }
+    CHECK(client.header_bytes_saved() == 0);
+
+    client_tcp.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("CompactStream - Remote over a datagram link") {
+    // UdpDatagram stands in for LoraDatagram: one datagram per message, no stream framing
+    netpipe::UdpDatagram a;
+    netpipe::UdpDatagram b;
+    REQUIRE(a.bind({"127.0.0.1", 20044}).is_ok());
+    REQUIRE(b.bind({"127.0.0.1", 20045}).is_ok());
+    netpipe::DatagramStream link_a(a, {"127.0.0.1", 20045});
+    netpipe::DatagramStream link_b(b, {"127.0.0.1", 20044});
+    CHECK(link_a.listen({"127.0.0.1", 0}).is_err());
+
+    CompactStream side_a(link_a);
+    CompactStream side_b(link_b);
+    dp::Res<bool> b_res = dp::result::ok(false);
+    std::thread b_thread([&]() { b_res = side_b.negotiate(2000); });
+    auto a_res = side_a.negotiate(2000);
+    b_thread.join();
+    REQUIRE(a_res.is_ok());
+    REQUIRE(b_res.is_ok());
+    CHECK(a_res.value());
+
+    {
+        netpipe::Remote<netpipe::Bidirect> remote_b(side_b);
+        netpipe::Remote<netpipe::Bidirect> remote_a(side_a);
+        register_echo(remote_b);
+        check_echo(remote_a, 10);
+    }
+    CHECK(side_a.header_bytes_saved() > 0);
+
+    a.close();
+    b.close();
+}
@@ -0,0 +1,231 @@
+#include <cstring>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace {
+    netpipe::Message text_payload(dp::usize size) {
+        const std::string words = "the quick brown fox jumps over the lazy dog while netpipe moves bytes ";
+        netpipe::Message out(size);
+        for (dp::usize i = 0; i < size; i++) {
+            out[i] = static_cast<dp::u8>(words[(i * 7 / 5) % words.size()]);
+        }
+        return out;
+    }
+
+    netpipe::Message random_payload(dp::usize size, dp::u32 seed) {
+        std::mt19937 rng(seed);
+        netpipe::Message out(size);
+        for (auto &b : out) {
+            b = static_cast<dp::u8>(rng());
+        }
+        return out;
+    }
+
+    netpipe::Message round_trip(const netpipe::remote::Codec &codec, const netpipe::Message &input) {
+        netpipe::Message packed(codec.max_compressed_size(input.size()));
+        auto res = codec.compress(input.data(), input.size(), packed.data(), packed.size());
+        REQUIRE(res.is_ok());
+        netpipe::Message out(input.size());
+        REQUIRE(codec.decompress(packed.data(), res.value(), out.data(), out.size()).is_ok());
+        return out;
+    }
+} // namespace
+
+TEST_CASE("Lz4Codec - Round trip") {
+    netpipe::remote::Lz4Codec codec;
+
+    SUBCASE("Edge sizes and content") {
+        for (dp::usize size : {0u, 1u, 12u, 13u, 15u, 16u, 300u, 4096u, 100000u}) {
+            auto text = text_payload(size);
+            CHECK(round_trip(codec, text) == text);
+            auto noise = random_payload(size, static_cast<dp::u32>(size));
+            CHECK(round_trip(codec, noise) == noise);
+            netpipe::Message zeros(size, 0);
+            CHECK(round_trip(codec, zeros) == zeros);
+        }
+    }
+
+    SUBCASE("Repetitive data shrinks") {
+        auto text = text_payload(64 * 1024);
+        netpipe::Message packed(codec.max_compressed_size(text.size()));
+        auto res = codec.compress(text.data(), text.size(), packed.data(), packed.size());
+        REQUIRE(res.is_ok());
+        CHECK(res.value() < text.size() / 4);
+    }
+
+    SUBCASE("Matches farther apart than the 64 KB window") {
+        auto block = random_payload(70000, 7);
+        netpipe::Message input(block);
+        input.insert(input.end(), block.begin(), block.end());
+        CHECK(round_trip(codec, input) == input);
+    }
+
+    SUBCASE("Corrupt blocks are rejected") {
+        auto text = text_payload(2000);
+        netpipe::Message packed(codec.max_compressed_size(text.size()));
+        auto res = codec.compress(text.data(), text.size(), packed.data(), packed.size());
+        REQUIRE(res.is_ok());
+        netpipe::Message out(text.size());
+        CHECK(codec.decompress(packed.data(), res.value() / 2, out.data(), out.size()).is_err());
+        CHECK(codec.decompress(packed.data(), res.value(), out.data(), out.size() - 1).is_err());
+    }
+}
+
+TEST_CASE("PayloadCompressor - Threshold and fallback") {
+    netpipe::remote::PayloadCompressor compressor(std::make_shared<netpipe::remote::Lz4Codec>(), 1024);
+    netpipe::Message scratch;
+
+    SUBCASE("Small payloads go out as they are") {
+        auto small = text_payload(512);
+        dp::u16 flags = 0;
+        CHECK(&compressor.apply(small, flags, scratch) == &small);
+        CHECK(flags == 0);
+    }
+
+    SUBCASE("Incompressible payloads go out as they are") {
+        auto noise = random_payload(8192, 3);
+        dp::u16 flags = 0;
+        CHECK(&compressor.apply(noise, flags, scratch) == &noise);
+        CHECK(flags == 0);
+    }
+
+    SUBCASE("Compressed payload inflates back") {
+        auto text = text_payload(8192);
+        dp::u16 flags = netpipe::remote::MessageFlags::Deadline;
+        netpipe::Message wire = compressor.apply(text, flags, scratch);
+        CHECK(flags == (netpipe::remote::MessageFlags::Deadline | netpipe::remote::MessageFlags::Compressed));
+        CHECK(wire.size() < text.size());
+        CHECK(wire[0] == netpipe::remote::CodecId::LZ4);
+
+        REQUIRE(netpipe::remote::decompress_payload(flags, wire).is_ok());
+        CHECK(flags == netpipe::remote::MessageFlags::Deadline);
+        CHECK(wire == text);
+    }
+
+    SUBCASE("Unknown codec id is an error") {
+        auto text = text_payload(8192);
+        dp::u16 flags = 0;
+        netpipe::Message wire = compressor.apply(text, flags, scratch);
+        wire[0] = 200;
+        CHECK(netpipe::remote::decompress_payload(flags, wire).is_err());
+    }
+
+    SUBCASE("Forged original length is refused before allocating") {
+        // 16 bytes of data claiming to inflate to 64 MB
+        netpipe::Message wire(netpipe::remote::COMPRESSED_PREFIX_SIZE + 16, 0);
+        wire[0] = netpipe::remote::CodecId::LZ4;
+        auto claimed = netpipe::encode_u32_be(64u << 20);
+        std::memcpy(wire.data() + 1, claimed.data(), claimed.size());
+        dp::u16 flags = netpipe::remote::MessageFlags::Compressed;
+        auto res = netpipe::remote::decompress_payload(flags, wire);
+        REQUIRE(res.is_err());
+        CHECK(std::string(res.error().message.c_str()) == "compression ratio out of range");
+        CHECK(wire.size() == netpipe::remote::COMPRESSED_PREFIX_SIZE + 16);
+    }
+
+    SUBCASE("Inflated bytes are charged to the budget") {
+        auto text = text_payload(8192);
+        dp::u16 flags = 0;
+        netpipe::Message wire = compressor.apply(text, flags, scratch);
+        netpipe::MemoryBudget budget(10000);
+        budget.set_wait_ms(10);
+        netpipe::Message spare;
+        netpipe::BudgetLease lease;
+
+        REQUIRE(budget.try_reserve(5000));
+        dp::u16 held_flags = flags;
+        netpipe::Message held_wire = wire;
+        auto refused = netpipe::remote::decompress_payload(held_flags, held_wire, spare, &budget, lease);
+        REQUIRE(refused.is_err());
+        CHECK(refused.error().code == dp::Error::TIMEOUT);
+        CHECK(lease.bytes() == 0);
+        budget.release(5000);
+
+        REQUIRE(netpipe::remote::decompress_payload(flags, wire, spare, &budget, lease).is_ok());
+        CHECK(wire == text);
+        CHECK(lease.bytes() == 8192);
+        CHECK(budget.in_use() == 8192);
+        lease.release();
+        CHECK(budget.in_use() == 0);
+    }
+}
+
+TEST_CASE("Remote - Compressed payloads on the wire") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20019};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    auto text = text_payload(32 * 1024);
+
+    SUBCASE("Unidirect client compresses and inflates") {
+        netpipe::Remote<netpipe::Unidirect> remote(client);
+        remote.set_compression(std::make_shared<netpipe::remote::Lz4Codec>());
+
+        // Raw peer: checks what arrived, answers with a compressed response
+        std::thread peer([&]() {
+            auto recv_res = accepted->recv();
+            REQUIRE(recv_res.is_ok());
+            auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+            REQUIRE(decoded.is_ok());
+            auto request = std::move(decoded.value());
+            CHECK((request.flags & netpipe::remote::MessageFlags::Compressed) != 0);
+            CHECK(request.payload.size() < text.size() / 4);
+            REQUIRE(netpipe::remote::decompress_payload(request.flags, request.payload).is_ok());
+            CHECK(request.payload == text);
+
+            netpipe::remote::PayloadCompressor compressor(std::make_shared<netpipe::remote::Lz4Codec>(), 1);
+            dp::u16 flags = 0;
+            netpipe::Message scratch;
+            const auto &wire = compressor.apply(request.payload, flags, scratch);
+            REQUIRE(netpipe::remote::send_remote_message_v2(*accepted, request.request_id, request.method_id, wire,
+                                                            netpipe::remote::MessageType::Response, flags)
+                        .is_ok());
+        });
+
+        auto res = remote.call(1, text, 2000);
+        peer.join();
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == text);
+    }
+
+    SUBCASE("Bidirect peers both compressing") {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        server.set_compression(std::make_shared<netpipe::remote::Lz4Codec>());
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            netpipe::Message doubled(req);
+            doubled.insert(doubled.end(), req.begin(), req.end());
+            return dp::result::ok(doubled);
+        });
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        remote.set_compression(std::make_shared<netpipe::remote::Lz4Codec>(), 256);
+
+        for (dp::usize size : {100u, 4096u, 32u * 1024}) {
+            auto request = text_payload(size);
+            auto res = remote.call(1, request, 2000);
+            REQUIRE(res.is_ok());
+            REQUIRE(res.value().size() == 2 * size);
+            CHECK(netpipe::Message(res.value().begin(), res.value().begin() + size) == request);
+        }
+        auto noise = random_payload(16 * 1024, 9);
+        auto res = remote.call(1, noise, 2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value().size() == 2 * noise.size());
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
@@ -0,0 +1,92 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+TEST_CASE("DeadlineScope - Nested timeouts") {
+    using netpipe::remote::DeadlineScope;
+    CHECK(DeadlineScope::clamp(5000) == 5000);
+
+    {
+        DeadlineScope outer(DeadlineScope::Clock::now() + std::chrono::milliseconds(200));
+        CHECK(DeadlineScope::clamp(5000) <= 200);
+        CHECK(DeadlineScope::clamp(50) == 50);
+        {
+            DeadlineScope passed(DeadlineScope::Clock::now() - std::chrono::milliseconds(1));
+            CHECK(DeadlineScope::clamp(5000) == 0);
+        }
+        CHECK(DeadlineScope::clamp(5000) > 0);
+    }
+    CHECK(DeadlineScope::current() == DeadlineScope::Clock::time_point::max());
+}
+
+TEST_CASE("Remote<Bidirect> - Deadline propagation") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20018};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        // One handler thread, so a second request queues behind a slow first one
+        netpipe::Remote<netpipe::Bidirect> server(*accepted, 100, false, 100, 1, 100, 0);
+        std::atomic<int> slow_runs{0};
+        server.register_method(1, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            slow_runs++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            return dp::result::ok(req);
+        });
+        // Reports the timeout a nested call from this handler would get
+        server.register_method(2, [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+            auto inherited = netpipe::encode_u32_be(netpipe::remote::DeadlineScope::clamp(5000));
+            return dp::result::ok(netpipe::Message(inherited.begin(), inherited.end()));
+        });
+
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        remote.set_deadline_propagation(true);
+
+        SUBCASE("Request that expired in the queue never runs") {
+            std::thread first([&]() { CHECK(remote.call(1, netpipe::Message{1}, 2000).is_ok()); });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            auto res = remote.call(1, netpipe::Message{2}, 100);
+            REQUIRE(res.is_err());
+            CHECK(res.error().code == dp::Error::TIMEOUT);
+            first.join();
+
+            for (int i = 0; i < 100 && server.expired_request_count() == 0; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            CHECK(server.expired_request_count() == 1);
+            CHECK(slow_runs == 1);
+        }
+
+        SUBCASE("Handlers inherit the caller's timeout") {
+            auto res = remote.call(2, netpipe::Message{}, 150);
+            REQUIRE(res.is_ok());
+            REQUIRE(res.value().size() == 4);
+            dp::u32 inherited = netpipe::decode_u32_be(res.value().data());
+            CHECK(inherited > 0);
+            CHECK(inherited <= 150);
+        }
+
+        SUBCASE("Without propagation the peer sees no deadline") {
+            remote.set_deadline_propagation(false);
+            auto res = remote.call(2, netpipe::Message{}, 150);
+            REQUIRE(res.is_ok());
+            CHECK(netpipe::decode_u32_be(res.value().data()) == 5000);
+        }
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
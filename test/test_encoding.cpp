@@ -1,5 +1,6 @@
 #include <doctest/doctest.h>
 #include <netpipe/common.hpp>
+#include <netpipe/remote/protocol.hpp>
 
 TEST_CASE("encode_u32_be - Big-endian encoding") {
     SUBCASE("Zero value") {
@@ -185,3 +186,114 @@ TEST_CASE("Message type") {
         CHECK(msg[2] == 0x30);
     }
 }
+
+TEST_CASE("decode_remote_message_v2_into") {
+    using namespace netpipe::remote;
+
+    SUBCASE("Fields match the allocating decoder") {
+        netpipe::Message payload = {9, 8, 7};
+        auto encoded = encode_remote_message_v2(11, 22, payload, MessageType::Error, MessageFlags::Final);
+
+        DecodedMessageV2 decoded{};
+        REQUIRE(decode_remote_message_v2_into(encoded, decoded).is_ok());
+        CHECK(decoded.version == PROTOCOL_VERSION_2);
+        CHECK(decoded.type == MessageType::Error);
+        CHECK(decoded.flags == MessageFlags::Final);
+        CHECK(decoded.request_id == 11);
+        CHECK(decoded.method_id == 22);
+        CHECK(decoded.payload == payload);
+    }
+
+    SUBCASE("Payload capacity is reused") {
+        DecodedMessageV2 decoded{};
+        auto big = encode_remote_message_v2(1, 1, netpipe::Message(1024, 0xAB));
+        REQUIRE(decode_remote_message_v2_into(big, decoded).is_ok());
+        const dp::u8 *storage = decoded.payload.data();
+
+        auto small = encode_remote_message_v2(2, 1, netpipe::Message(16, 0xCD));
+        REQUIRE(decode_remote_message_v2_into(small, decoded).is_ok());
+        CHECK(decoded.request_id == 2);
+        CHECK(decoded.payload == netpipe::Message(16, 0xCD));
+        CHECK(decoded.payload.data() == storage);
+    }
+
+    SUBCASE("Malformed input is rejected") {
+        DecodedMessageV2 decoded{};
+        CHECK(decode_remote_message_v2_into(netpipe::Message{PROTOCOL_VERSION_2, 0}, decoded).is_err());
+    }
+}
+
+TEST_CASE("decode_remote_message_v2_view") {
+    using namespace netpipe::remote;
+
+    SUBCASE("Payload points into the encoded buffer") {
+        netpipe::Message payload = {1, 2, 3, 4, 5};
+        auto encoded = encode_remote_message_v2(7, 99, payload, MessageType::StreamData, MessageFlags::Streaming);
+
+        auto res = decode_remote_message_v2_view(encoded);
+        REQUIRE(res.is_ok());
+        auto view = res.value();
+        CHECK(view.type == MessageType::StreamData);
+        CHECK(view.flags == MessageFlags::Streaming);
+        CHECK(view.request_id == 7);
+        CHECK(view.method_id == 99);
+        CHECK(view.payload.size() == payload.size());
+        CHECK(view.payload.data() == encoded.data() + V2_HEADER_SIZE);
+    }
+
+    SUBCASE("Separate header and payload") {
+        netpipe::Message payload(300, 0x5A);
+        auto header = encode_remote_header_v2(3, 4, static_cast<dp::u32>(payload.size()), MessageType::Response);
+        const dp::u8 *storage = payload.data();
+
+        auto res = decode_remote_message_v2(header.data(), header.size(), std::move(payload));
+        REQUIRE(res.is_ok());
+        CHECK(res.value().request_id == 3);
+        CHECK(res.value().payload.size() == 300);
+        CHECK(res.value().payload.data() == storage);
+
+        // Header announcing a different length than the payload received
+        CHECK(decode_remote_message_v2(header.data(), header.size(), netpipe::Message(10)).is_err());
+        CHECK(decode_remote_message_v2(header.data(), 8, netpipe::Message(300)).is_err());
+    }
+}
+
+TEST_CASE("V2 deadline trailer") {
+    using namespace netpipe::remote;
+    netpipe::Message payload = {1, 2, 3};
+
+    SUBCASE("Every decoder strips the trailer and reports the budget") {
+        auto encoded = encode_remote_message_v2(5, 6, payload, MessageType::Request, MessageFlags::None, 250);
+        CHECK(encoded.size() == V2_HEADER_SIZE + payload.size() + DEADLINE_TRAILER_SIZE);
+
+        auto copied = decode_remote_message_v2(encoded);
+        REQUIRE(copied.is_ok());
+        CHECK((copied.value().flags & MessageFlags::Deadline) != 0);
+        CHECK(copied.value().deadline_ms == 250);
+        CHECK(copied.value().payload == payload);
+
+        auto view = decode_remote_message_v2_view(encoded);
+        REQUIRE(view.is_ok());
+        CHECK(view.value().deadline_ms == 250);
+        CHECK(view.value().payload.size() == payload.size());
+
+        netpipe::Message body(encoded.begin() + V2_HEADER_SIZE, encoded.end());
+        auto split = decode_remote_message_v2(encoded.data(), V2_HEADER_SIZE, std::move(body));
+        REQUIRE(split.is_ok());
+        CHECK(split.value().deadline_ms == 250);
+        CHECK(split.value().payload == payload);
+    }
+
+    SUBCASE("No budget means no trailer") {
+        auto encoded = encode_remote_message_v2(5, 6, payload);
+        CHECK(encoded.size() == V2_HEADER_SIZE + payload.size());
+        auto decoded = decode_remote_message_v2(encoded);
+        REQUIRE(decoded.is_ok());
+        CHECK(decoded.value().deadline_ms == 0);
+    }
+
+    SUBCASE("Flag without room for the trailer is rejected") {
+        auto header = encode_remote_header_v2(1, 1, 2, MessageType::Request, MessageFlags::Deadline);
+        CHECK(decode_remote_message_v2(header.data(), header.size(), netpipe::Message(2)).is_err());
+    }
+}
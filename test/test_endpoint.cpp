@@ -83,3 +83,16 @@ TEST_CASE("LoraEndpoint") {
         CHECK(ep2.to_string() == "::1");
     }
 }
+
+TEST_CASE("TopicEndpoint") {
+    SUBCASE("Lists the enabled paths") {
+        netpipe::TopicEndpoint endpoint;
+        endpoint.name = "pose";
+        CHECK(endpoint.to_string() == "pose shm");
+
+        endpoint.shm = false;
+        endpoint.multicast = netpipe::MulticastEndpoint{"239.1.2.3", 7400};
+        endpoint.tcp = netpipe::TcpEndpoint{"10.0.0.1", 7401};
+        CHECK(endpoint.to_string() == "pose udp://239.1.2.3:7400 tcp://10.0.0.1:7401");
+    }
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("WorkStealingExecutor - Task execution") {
+    SUBCASE("Every submitted task runs before shutdown returns") {
+        netpipe::WorkStealingExecutor executor(4, 10000);
+        std::atomic<int> ran{0};
+        for (int i = 0; i < 5000; i++) {
+            REQUIRE(executor.submit([&]() { ran++; }));
+        }
+        executor.shutdown();
+        CHECK(ran == 5000);
+        CHECK(executor.queued_count() == 0);
+        CHECK_FALSE(executor.submit([]() {}));
+    }
+
+    SUBCASE("Tasks spawned by a busy worker are stolen by idle ones") {
+        netpipe::WorkStealingExecutor executor(4, 1000);
+        std::atomic<int> ran{0};
+        std::mutex ids_mutex;
+        std::vector<std::thread::id> ids;
+
+        // One task fans out 64 children onto its own deque, then stays busy
+        REQUIRE(executor.submit([&]() {
+            for (int i = 0; i < 64; i++) {
+                executor.submit([&]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    std::lock_guard<std::mutex> lock(ids_mutex);
+                    ids.push_back(std::this_thread::get_id());
+                    ran++;
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }));
+
+        for (int i = 0; i < 500 && ran < 64; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK(ran == 64);
+
+        std::sort(ids.begin(), ids.end());
+        CHECK(std::unique(ids.begin(), ids.end()) - ids.begin() > 1);
+    }
+
+    SUBCASE("Full queue rejects") {
+        netpipe::WorkStealingExecutor executor(1, 2);
+        std::atomic<bool> release{false};
+        REQUIRE(executor.submit([&]() {
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }));
+        // Wait for the worker to take the blocker so it no longer counts as queued
+        for (int i = 0; i < 200 && executor.active_count() == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        CHECK(executor.submit([]() {}));
+        CHECK(executor.submit([]() {}));
+        CHECK_FALSE(executor.submit([]() {}));
+        release = true;
+    }
+
+    SUBCASE("Pinned workers still run tasks") {
+        netpipe::remote::ExecutorOptions options;
+        options.threads = 2;
+        options.pin_threads = true;
+        options.numa_node = 0;
+        CHECK_FALSE(netpipe::remote::usable_cpus().empty());
+
+        netpipe::WorkStealingExecutor executor(options);
+        std::atomic<int> ran{0};
+        for (int i = 0; i < 100; i++) {
+            REQUIRE(executor.submit([&]() { ran++; }));
+        }
+        executor.shutdown();
+        CHECK(ran == 100);
+    }
+}
+
+TEST_CASE("WorkStealingExecutor - Shared by several Remote<Bidirect>") {
+    auto executor = std::make_shared<netpipe::WorkStealingExecutor>(2, 1000);
+
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20014};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    const int connections = 3;
+    std::vector<std::unique_ptr<netpipe::Stream>> accepted;
+    std::thread accept_thread([&]() {
+        for (int i = 0; i < connections; i++) {
+            auto res = listener.accept();
+            REQUIRE(res.is_ok());
+            accepted.push_back(std::move(res.value()));
+        }
+    });
+
+    std::vector<std::unique_ptr<netpipe::TcpStream>> clients;
+    for (int i = 0; i < connections; i++) {
+        clients.push_back(std::make_unique<netpipe::TcpStream>());
+        REQUIRE(clients.back()->connect(endpoint).is_ok());
+    }
+    accept_thread.join();
+
+    {
+        // Every server-side Remote runs its handlers on the one executor
+        std::vector<std::unique_ptr<netpipe::Remote<netpipe::Bidirect>>> servers;
+        for (auto &stream : accepted) {
+            servers.push_back(std::make_unique<netpipe::Remote<netpipe::Bidirect>>(*stream, executor));
+            servers.back()->register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                return dp::result::ok(req);
+            });
+        }
+
+        std::vector<std::thread> callers;
+        std::atomic<int> ok{0};
+        for (auto &client : clients) {
+            callers.emplace_back([&, stream = client.get()]() {
+                netpipe::Remote<netpipe::Bidirect> remote(*stream);
+                for (int i = 0; i < 50; i++) {
+                    netpipe::Message request{static_cast<dp::u8>(i), 1, 2};
+                    auto res = remote.call(1, request, 5000);
+                    REQUIRE(res.is_ok());
+                    CHECK(res.value() == request);
+                    ok++;
+                }
+            });
+        }
+        for (auto &t : callers) {
+            t.join();
+        }
+        CHECK(ok == connections * 50);
+
+        // Destroying one Remote leaves the executor running for the others
+        servers.pop_back();
+        std::atomic<bool> ran{false};
+        CHECK(executor->submit([&]() { ran = true; }));
+        for (int i = 0; i < 200 && !ran; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        CHECK(ran);
+    }
+
+    for (auto &client : clients) {
+        client->close();
+    }
+    listener.close();
+}
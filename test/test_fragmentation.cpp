@@ -0,0 +1,155 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+namespace {
+    netpipe::Message pattern(dp::usize size, dp::u8 seed) {
+        netpipe::Message out(size);
+        for (dp::usize i = 0; i < size; i++) {
+            out[i] = static_cast<dp::u8>(i * 31 + seed);
+        }
+        return out;
+    }
+} // namespace
+
+TEST_CASE("Remote<Bidirect> - Fragmented messages") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20026};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    SUBCASE("Pieces on the wire reassemble into the original payload") {
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        remote.set_fragmentation(1000);
+        CHECK(remote.fragment_size() == 1000);
+        remote.set_deadline_propagation(true);
+
+        // Raw peer: read pieces, check their flags, answer with the reassembled payload in one frame
+        auto request = pattern(2500, 3);
+        std::thread peer([&]() {
+            netpipe::Message assembled;
+            dp::usize pieces = 0;
+            while (true) {
+                auto recv_res = accepted->recv();
+                REQUIRE(recv_res.is_ok());
+                auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+                REQUIRE(decoded.is_ok());
+                auto &frame = decoded.value();
+                CHECK((frame.flags & netpipe::remote::MessageFlags::Fragment) != 0);
+                assembled.insert(assembled.end(), frame.payload.begin(), frame.payload.end());
+                pieces++;
+                if (frame.flags & netpipe::remote::MessageFlags::Final) {
+                    CHECK(frame.payload.size() == 500);
+                    CHECK(frame.deadline_ms > 0); // The trailer rides on the last piece
+                    REQUIRE(netpipe::remote::send_remote_message_v2(*accepted, frame.request_id, frame.method_id,
+                                                                    assembled,
+                                                                    netpipe::remote::MessageType::Response)
+                                .is_ok());
+                    break;
+                }
+                CHECK(frame.payload.size() == 1000);
+                CHECK(frame.deadline_ms == 0);
+            }
+            CHECK(pieces == 3);
+        });
+
+        auto res = remote.call(1, request, 2000);
+        peer.join();
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == request);
+    }
+
+    SUBCASE("Both directions fragmented, small calls interleave with large ones") {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        server.set_fragmentation(64 * 1024);
+        server.set_compression(std::make_shared<netpipe::remote::Lz4Codec>());
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        remote.set_fragmentation(64 * 1024);
+
+        std::atomic<bool> bulk_done{false};
+        std::thread bulk([&]() {
+            for (dp::u8 i = 0; i < 3; i++) {
+                auto payload = pattern(24u << 20, i);
+                auto res = remote.call(1, payload, 20000);
+                REQUIRE(res.is_ok());
+                CHECK(res.value() == payload);
+            }
+            bulk_done = true;
+        });
+
+        int small_calls = 0;
+        while (!bulk_done) {
+            auto res = remote.call(1, netpipe::Message{static_cast<dp::u8>(small_calls)}, 5000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == netpipe::Message{static_cast<dp::u8>(small_calls)});
+            small_calls++;
+        }
+        bulk.join();
+        CHECK(small_calls > 3);
+    }
+
+    SUBCASE("Reassembly limits drop a message and skip its remaining pieces") {
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        remote.set_reassembly_limits(1, 4000);
+        std::atomic<int> handled{0};
+        remote.register_method(5, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            handled++;
+            return dp::result::ok(req);
+        });
+
+        namespace MessageFlags = netpipe::remote::MessageFlags;
+        using netpipe::remote::MessageType;
+        auto piece = [&](dp::u32 id, dp::usize size, dp::u16 flags) {
+            auto payload = pattern(size, static_cast<dp::u8>(id));
+            REQUIRE(netpipe::remote::send_remote_message_v2(*accepted, id, 5, payload, MessageType::Request,
+                                                            static_cast<dp::u16>(MessageFlags::Fragment | flags))
+                        .is_ok());
+        };
+        auto answer = [&]() {
+            auto recv_res = accepted->recv();
+            REQUIRE(recv_res.is_ok());
+            auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+            REQUIRE(decoded.is_ok());
+            return std::move(decoded.value());
+        };
+
+        // Over the byte limit: answered with an error, the Final piece is skipped rather than collected
+        piece(10, 3000, 0);
+        piece(10, 3000, 0);
+        auto reply = answer();
+        CHECK(reply.request_id == 10);
+        CHECK(reply.type == MessageType::Error);
+        piece(10, 3000, MessageFlags::Final);
+
+        // Over the count limit while another message is open
+        piece(12, 1000, 0);
+        piece(13, 1000, 0);
+        reply = answer();
+        CHECK(reply.request_id == 13);
+        CHECK(reply.type == MessageType::Error);
+        piece(13, 1000, MessageFlags::Final);
+        piece(12, 1000, MessageFlags::Final);
+        reply = answer();
+        CHECK(reply.request_id == 12);
+        CHECK(reply.type == MessageType::Response);
+        CHECK(reply.payload.size() == 2000);
+        CHECK(handled == 1);
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
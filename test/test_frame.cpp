@@ -0,0 +1,132 @@
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+namespace {
+    struct Reading {
+        dp::u32 sensor;
+        dp::String label;
+        dp::Vector<double> samples;
+        auto members() { return std::tie(sensor, label, samples); }
+        auto members() const { return std::tie(sensor, label, samples); }
+    };
+} // namespace
+
+TEST_CASE("Protocol - V1 and V2 encoders") {
+    netpipe::Message payload{1, 2, 3, 4, 5};
+    auto v1 = netpipe::remote::encode_remote_message(0x01020304, payload, true);
+    CHECK(v1 == netpipe::Message{1, 2, 3, 4, 1, 0, 0, 0, 5, 1, 2, 3, 4, 5});
+    auto decoded_v1 = netpipe::remote::decode_remote_message(v1);
+    REQUIRE(decoded_v1.is_ok());
+    CHECK(decoded_v1.value().is_error);
+    CHECK(decoded_v1.value().payload == payload);
+
+    auto v2 = netpipe::remote::encode_remote_message_v2(7, 9, payload, netpipe::remote::MessageType::Response,
+                                                        netpipe::remote::MessageFlags::Final, 250);
+    REQUIRE(v2.size() == netpipe::remote::V2_HEADER_SIZE + payload.size() + 4);
+    auto header = netpipe::remote::encode_remote_header_v2(
+        7, 9, 9, netpipe::remote::MessageType::Response,
+        netpipe::remote::MessageFlags::Final | netpipe::remote::MessageFlags::Deadline);
+    CHECK(std::equal(header.begin(), header.end(), v2.begin()));
+    auto decoded_v2 = netpipe::remote::decode_remote_message_v2(v2);
+    REQUIRE(decoded_v2.is_ok());
+    CHECK(decoded_v2.value().payload == payload);
+    CHECK(decoded_v2.value().deadline_ms == 250);
+}
+
+TEST_CASE("FrameBuilder - Same bytes as the encoder, in one reused buffer") {
+    using netpipe::remote::MessageType;
+    netpipe::FrameBuilder builder(64);
+    Reading reading{3, "imu", {1.5, -2.0}};
+    builder.append_value(reading).append(netpipe::Message{0xaa});
+    auto frame = builder.finish(11, 4, MessageType::Request, netpipe::remote::MessageFlags::None, 100);
+
+    netpipe::Message payload = netpipe::Serializer<Reading>::serialize(reading);
+    payload.push_back(0xaa);
+    CHECK(builder.payload_size() == payload.size());
+    auto expected = netpipe::remote::encode_remote_message_v2(11, 4, payload, MessageType::Request,
+                                                              netpipe::remote::MessageFlags::None, 100);
+    CHECK(netpipe::Message(frame.begin(), frame.end()) == expected);
+
+    // Appending after finish() moves the trailer behind the new bytes
+    builder.append(netpipe::Message{0xbb});
+    frame = builder.finish(11, 4);
+    auto decoded = netpipe::remote::decode_remote_message_v2(netpipe::Message(frame.begin(), frame.end()));
+    REQUIRE(decoded.is_ok());
+    CHECK(decoded.value().deadline_ms == 0);
+    CHECK(decoded.value().payload.size() == payload.size() + 1);
+    CHECK(decoded.value().payload.back() == 0xbb);
+
+    // reset() keeps the allocation
+    const dp::u8 *storage = builder.buffer().data();
+    builder.reset();
+    builder.append(netpipe::Message(32, 1));
+    builder.finish(12, 4);
+    CHECK(builder.buffer().data() == storage);
+    CHECK(builder.payload_size() == 32);
+}
+
+TEST_CASE("FrameBuilder - Sent as one message over TCP and SHM") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20062};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    netpipe::FrameBuilder builder;
+    for (dp::u32 i = 0; i < 3; i++) {
+        builder.reset();
+        builder.append_value(Reading{i, "temp", {double(i)}});
+        REQUIRE(builder.send(client, i, 2).is_ok());
+    }
+    // The remote end reads plain length-prefixed V2 frames
+    for (dp::u32 i = 0; i < 3; i++) {
+        auto msg = accepted->recv();
+        REQUIRE(msg.is_ok());
+        auto decoded = netpipe::remote::decode_remote_message_v2(msg.value());
+        REQUIRE(decoded.is_ok());
+        CHECK(decoded.value().request_id == i);
+        auto reading = netpipe::Serializer<Reading>::deserialize(decoded.value().payload);
+        REQUIRE(reading.is_ok());
+        CHECK(reading.value().sensor == i);
+    }
+
+    // A stream without its own prefix falls back to send_iov
+    netpipe::ShmStream shm_listener;
+    netpipe::ShmEndpoint shm_endpoint{"netpipe_test_frame", 64 * 1024};
+    REQUIRE(shm_listener.listen_shm(shm_endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> shm_accepted;
+    std::thread shm_accept([&]() {
+        auto res = shm_listener.accept();
+        REQUIRE(res.is_ok());
+        shm_accepted = std::move(res.value());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    netpipe::ShmStream shm_client;
+    REQUIRE(shm_client.connect_shm(shm_endpoint).is_ok());
+    shm_accept.join();
+    builder.reset();
+    builder.append(netpipe::Message{4, 5, 6});
+    REQUIRE(builder.send(shm_client, 99, 1).is_ok());
+    auto shm_msg = shm_accepted->recv();
+    REQUIRE(shm_msg.is_ok());
+    auto frame = builder.frame();
+    CHECK(shm_msg.value() == netpipe::Message(frame.begin(), frame.end()));
+
+    CHECK(client.send_prefixed(nullptr, 2).is_err());
+
+    shm_client.close();
+    shm_accepted->close();
+    shm_listener.close();
+    client.close();
+    accepted->close();
+    listener.close();
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+namespace {
+    netpipe::Message pattern(dp::usize size, dp::u8 seed) {
+        netpipe::Message msg(size);
+        for (dp::usize i = 0; i < size; i++) {
+            msg[i] = static_cast<dp::u8>((i * 7 + seed) & 0xFF);
+        }
+        return msg;
+    }
+
+    // Connected pair: client dials, server is the accepted side
+    struct Pair {
+        netpipe::IpcStream listener;
+        netpipe::IpcStream client;
+        std::unique_ptr<netpipe::Stream> server;
+
+        explicit Pair(const char *path) {
+            netpipe::IpcEndpoint endpoint{path};
+            REQUIRE(listener.listen_ipc(endpoint).is_ok());
+            std::thread accept_thread([&]() {
+                auto res = listener.accept();
+                REQUIRE(res.is_ok());
+                server = std::move(res.value());
+            });
+            REQUIRE(client.connect_ipc(endpoint).is_ok());
+            accept_thread.join();
+        }
+
+        ~Pair() {
+            client.close();
+            server->close();
+            listener.close();
+        }
+    };
+} // namespace
+
+TEST_CASE("IpcStream - Large payloads pass as memfd") {
+    Pair pair("/tmp/netpipe_test_ipc_fd.sock");
+    auto &server = static_cast<netpipe::IpcStream &>(*pair.server);
+    pair.client.set_fd_passing(64 * 1024);
+    CHECK(pair.client.fd_passing_threshold() == 64 * 1024);
+
+    // Inline and memfd frames interleave without losing their order
+    auto big = pattern(8 * 1024 * 1024, 1);
+    auto small = pattern(100, 2);
+    std::thread sender([&]() {
+        REQUIRE(pair.client.send(big).is_ok());
+        REQUIRE(pair.client.send(small).is_ok());
+        REQUIRE(pair.client.send(big).is_ok());
+        REQUIRE(pair.client.send(small).is_ok());
+        REQUIRE(pair.client.send(big).is_ok());
+    });
+
+    REQUIRE(server.set_recv_timeout(5000).is_ok());
+    SUBCASE("Buffered receiver") {}
+    SUBCASE("Unbuffered receiver") { REQUIRE(server.set_recv_buffer_size(0).is_ok()); }
+
+    auto first = server.recv();
+    REQUIRE(first.is_ok());
+    CHECK(first.value() == big);
+    netpipe::Message msg;
+    REQUIRE(server.recv_into(msg).is_ok());
+    CHECK(msg == small);
+
+    // The memfd is mapped in place; the inline frame lands in the stream's buffer
+    auto view = server.recv_view();
+    REQUIRE(view.is_ok());
+    REQUIRE(view.value().size() == big.size());
+    CHECK(std::equal(view.value().begin(), view.value().end(), big.begin()));
+    CHECK(server.recv_view().is_err());
+    server.release();
+
+    auto inline_view = server.recv_view();
+    REQUIRE(inline_view.is_ok());
+    CHECK(std::equal(inline_view.value().begin(), inline_view.value().end(), small.begin(), small.end()));
+    server.release();
+
+    auto last = server.recv();
+    REQUIRE(last.is_ok());
+    CHECK(last.value() == big);
+    sender.join();
+}
+
+TEST_CASE("IpcStream - Remote<Bidirect> calls over memfd frames") {
+    Pair pair("/tmp/netpipe_test_ipc_fd_remote.sock");
+    auto &server_stream = static_cast<netpipe::IpcStream &>(*pair.server);
+    pair.client.set_fd_passing(256 * 1024);
+    server_stream.set_fd_passing(256 * 1024);
+
+    netpipe::Remote<netpipe::Bidirect> server(server_stream);
+    netpipe::Remote<netpipe::Bidirect> client(pair.client);
+    server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+        netpipe::Message out(req);
+        out[0] ^= 0xFF;
+        return dp::result::ok(out);
+    });
+
+    for (dp::usize size : {dp::usize(16), dp::usize(4 * 1024 * 1024), dp::usize(300 * 1024)}) {
+        auto request = pattern(size, 3);
+        auto res = client.call(1, request, 10000);
+        REQUIRE(res.is_ok());
+        request[0] ^= 0xFF;
+        CHECK(res.value() == request);
+    }
+}
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+TEST_CASE("RemoteLanes - Control calls are not stuck behind bulk transfers") {
+    constexpr dp::usize LANES = 3;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20025};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    // Connect one at a time so lane i is the i-th connection on both sides
+    dp::Vector<std::unique_ptr<netpipe::TcpStream>> clients;
+    dp::Vector<std::unique_ptr<netpipe::Stream>> accepted;
+    for (dp::usize i = 0; i < LANES; i++) {
+        std::thread accept_thread([&]() {
+            auto res = listener.accept();
+            REQUIRE(res.is_ok());
+            accepted.push_back(std::move(res.value()));
+        });
+        clients.push_back(std::make_unique<netpipe::TcpStream>());
+        REQUIRE(clients.back()->connect(endpoint).is_ok());
+        accept_thread.join();
+    }
+    dp::Vector<netpipe::Stream *> client_streams;
+    dp::Vector<netpipe::Stream *> server_streams;
+    for (dp::usize i = 0; i < LANES; i++) {
+        client_streams.push_back(clients[i].get());
+        server_streams.push_back(accepted[i].get());
+    }
+
+    {
+        netpipe::RemoteLanes server(server_streams);
+        REQUIRE(server
+                    .register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                        return dp::result::ok(req);
+                    })
+                    .is_ok());
+        REQUIRE(server
+                    .register_method(2, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                        return dp::result::ok(netpipe::Message{static_cast<dp::u8>(req.size() >> 20)});
+                    })
+                    .is_ok());
+        CHECK(server.register_method(1, nullptr).is_err());
+
+        netpipe::LaneConfig config;
+        config.bulk_threshold = 1024;
+        config.enable_metrics = true;
+        netpipe::RemoteLanes remote(client_streams, config);
+        REQUIRE(remote.lane_count() == LANES);
+
+        SUBCASE("Routing by size and class") {
+            CHECK(remote.route(10) == 0);
+            CHECK(remote.route(4096) == 1);
+            CHECK(remote.route(4096) == 2);
+            CHECK(remote.route(4096) == 1);
+            CHECK(remote.route(10, netpipe::LaneClass::Bulk) == 2);
+            CHECK(remote.route(1 << 20, netpipe::LaneClass::Control) == 0);
+        }
+
+        SUBCASE("Small calls complete while bulk calls are in flight") {
+            netpipe::Message bulk(32u << 20, 0x42);
+            std::atomic<bool> bulk_done{false};
+            std::thread bulk_thread([&]() {
+                for (int i = 0; i < 2; i++) {
+                    auto res = remote.call(2, bulk, 10000);
+                    REQUIRE(res.is_ok());
+                    CHECK(res.value() == netpipe::Message{32});
+                }
+                bulk_done = true;
+            });
+
+            // Wait until the first bulk call is on the wire
+            while (remote.lane(1).pending_count() == 0 && remote.lane(2).pending_count() == 0 && !bulk_done) {
+                std::this_thread::yield();
+            }
+            int during_bulk = 0;
+            while (!bulk_done) {
+                auto start = std::chrono::steady_clock::now();
+                auto res = remote.call(1, netpipe::Message{7}, 2000);
+                auto took = std::chrono::steady_clock::now() - start;
+                REQUIRE(res.is_ok());
+                CHECK(took < std::chrono::milliseconds(100));
+                during_bulk++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            bulk_thread.join();
+            CHECK(during_bulk > 10);
+            CHECK(remote.lane(0).get_client_metrics().successful_requests == static_cast<dp::u64>(during_bulk));
+            CHECK(remote.lane(0).get_client_metrics().total_request_bytes == static_cast<dp::u64>(during_bulk));
+        }
+    }
+
+    for (dp::usize i = 0; i < LANES; i++) {
+        clients[i]->close();
+        accepted[i]->close();
+    }
+    listener.close();
+}
+
+TEST_CASE("RemoteLanes - Rejected input leaves no partial state") {
+    SUBCASE("No streams") {
+        CHECK(netpipe::RemoteLanes::create({}).is_err());
+        CHECK(netpipe::RemoteLanes::create({nullptr}).is_err());
+
+        netpipe::RemoteLanes empty({});
+        CHECK(empty.lane_count() == 0);
+        CHECK(empty.route(1 << 20) == 0);
+        auto res = empty.call(1, netpipe::Message{1});
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::INVALID_ARGUMENT);
+    }
+
+    SUBCASE("A method one lane refuses is registered on none") {
+        netpipe::TcpStream listener;
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", 20080};
+        REQUIRE(listener.listen(endpoint).is_ok());
+        dp::Vector<std::unique_ptr<netpipe::TcpStream>> clients;
+        dp::Vector<std::unique_ptr<netpipe::Stream>> accepted;
+        dp::Vector<netpipe::Stream *> streams;
+        for (int i = 0; i < 3; i++) {
+            std::thread accept_thread([&]() {
+                auto res = listener.accept();
+                REQUIRE(res.is_ok());
+                accepted.push_back(std::move(res.value()));
+            });
+            clients.push_back(std::make_unique<netpipe::TcpStream>());
+            REQUIRE(clients.back()->connect(endpoint).is_ok());
+            accept_thread.join();
+            streams.push_back(clients.back().get());
+        }
+
+        {
+            auto lanes = netpipe::RemoteLanes::create(streams);
+            REQUIRE(lanes.is_ok());
+            auto echo = [](const netpipe::Message &req) -> dp::Res<netpipe::Message> { return dp::result::ok(req); };
+            REQUIRE(lanes.value()->lane(2).register_method(5, echo).is_ok());
+            CHECK(lanes.value()->register_method(5, echo).is_err());
+            // Lanes 0 and 1 were rolled back, so they take the method on their own again
+            CHECK(lanes.value()->lane(0).register_method(5, echo).is_ok());
+            CHECK(lanes.value()->lane(1).register_method(5, echo).is_ok());
+        }
+
+        for (dp::usize i = 0; i < clients.size(); i++) {
+            clients[i]->close();
+            accepted[i]->close();
+        }
+        listener.close();
+    }
+}
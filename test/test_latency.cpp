@@ -0,0 +1,200 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <sched.h>
+#include <thread>
+
+namespace {
+    struct Connection {
+        netpipe::TcpStream listener;
+        netpipe::TcpStream client;
+        std::unique_ptr<netpipe::Stream> accepted;
+
+        Connection() {
+            netpipe::TcpEndpoint endpoint{"127.0.0.1", 20057};
+            REQUIRE(listener.listen(endpoint).is_ok());
+            std::thread accept_thread([&]() {
+                auto res = listener.accept();
+                REQUIRE(res.is_ok());
+                accepted = std::move(res.value());
+            });
+            REQUIRE(client.connect(endpoint).is_ok());
+            accept_thread.join();
+        }
+
+        ~Connection() {
+            client.close();
+            accepted->close();
+            listener.close();
+        }
+    };
+
+    // Method 1 waits for method 2 to run; returns 1 when it did, 0 when it gave up
+    void register_rendezvous(netpipe::Remote<netpipe::Bidirect> &server, std::atomic<bool> &second_ran) {
+        server.register_method(1, [&](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+            auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+            while (!second_ran && std::chrono::steady_clock::now() < until) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return dp::result::ok(netpipe::Message{static_cast<dp::u8>(second_ran ? 1 : 0)});
+        });
+        server.register_method(2, [&](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+            second_ran = true;
+            return dp::result::ok(netpipe::Message{});
+        });
+    }
+} // namespace
+
+TEST_CASE("Low latency - Spinning receivers keep round trips working") {
+    Connection conn;
+    netpipe::Remote<netpipe::Bidirect> server(*conn.accepted);
+    netpipe::Remote<netpipe::Bidirect> client(conn.client);
+    server.register_method(5, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+        return dp::result::ok(req);
+    });
+
+    netpipe::LowLatencyOptions options;
+    options.spin_us = 2000;
+    options.busy_poll_us = 0;
+    REQUIRE(server.set_low_latency(options).is_ok());
+    REQUIRE(client.set_low_latency(options).is_ok());
+
+    for (dp::u8 i = 0; i < 200; i++) {
+        auto res = client.call(5, netpipe::Message{i, i}, 2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{i, i});
+    }
+
+    // Spinning forever on a quiet connection must not keep the destructors waiting
+    options.spin_us = 1000000;
+    REQUIRE(server.set_low_latency(options).is_ok());
+}
+
+TEST_CASE("Low latency - Inline handlers run on the receiver, one at a time") {
+    Connection conn;
+    netpipe::Remote<netpipe::Bidirect> server(*conn.accepted);
+    netpipe::Remote<netpipe::Bidirect> client(conn.client);
+    std::atomic<bool> second_ran{false};
+    register_rendezvous(server, second_ran);
+
+    auto run = [&]() {
+        second_ran = false;
+        dp::u8 saw_second = 0xff;
+        std::thread first([&]() {
+            auto res = client.call(1, netpipe::Message{}, 2000);
+            if (res.is_ok() && res.value().size() == 1) {
+                saw_second = res.value()[0];
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(client.call(2, netpipe::Message{}, 2000).is_ok());
+        first.join();
+        return saw_second;
+    };
+
+    // Pool handlers overlap; an inline handler holds the receiver, so method 2 only runs after method 1
+    CHECK(run() == 1);
+    netpipe::LowLatencyOptions options;
+    options.spin_us = 0;
+    options.busy_poll_us = 0;
+    options.inline_handlers = true;
+    REQUIRE(server.set_low_latency(options).is_ok());
+    CHECK(run() == 0);
+}
+
+TEST_CASE("Low latency - Receiver and handler threads can be pinned") {
+    auto cpus = netpipe::remote::usable_cpus();
+    REQUIRE_FALSE(cpus.empty());
+    dp::i32 cpu = cpus.back();
+
+    CHECK(netpipe::remote::pin_thread(pthread_self(), -1).is_err());
+    CHECK(netpipe::remote::pin_thread(pthread_self(), CPU_SETSIZE).is_err());
+
+    Connection conn;
+    netpipe::Remote<netpipe::Bidirect> server(*conn.accepted);
+    netpipe::Remote<netpipe::Bidirect> client(conn.client);
+    server.register_method(3, [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+        return dp::result::ok(netpipe::Message{static_cast<dp::u8>(sched_getcpu())});
+    });
+
+    netpipe::LowLatencyOptions options;
+    options.spin_us = 0;
+    options.busy_poll_us = 0;
+    options.handler_cpus = {cpu};
+    REQUIRE(server.set_low_latency(options).is_ok());
+    auto res = client.call(3, netpipe::Message{}, 2000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value()[0] == cpu);
+
+    options.handler_cpus.clear();
+    options.receiver_cpu = cpu;
+    options.inline_handlers = true;
+    REQUIRE(server.set_low_latency(options).is_ok());
+    res = client.call(3, netpipe::Message{}, 2000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value()[0] == cpu);
+
+    // A shared executor belongs to other Remotes as well
+    auto shared = std::make_shared<netpipe::WorkStealingExecutor>(2, 100);
+    netpipe::TcpStream unconnected;
+    netpipe::Remote<netpipe::Bidirect> on_shared(unconnected, shared);
+    options.receiver_cpu = -1;
+    options.inline_handlers = false;
+    options.handler_cpus = {cpu};
+    CHECK(on_shared.set_low_latency(options).is_err());
+    CHECK(shared->set_affinity({cpu}).is_ok());
+    CHECK(shared->set_affinity({}).is_err());
+}
+
+TEST_CASE("Low latency - SO_BUSY_POLL and pending input") {
+    netpipe::TcpStream closed;
+    CHECK(closed.set_busy_poll(50).is_err());
+
+    {
+        Connection conn;
+        // Raising busy poll above net.core.busy_poll needs CAP_NET_ADMIN; anything else must succeed
+        auto res = conn.client.set_busy_poll(50);
+        if (res.is_err()) {
+            CHECK(res.error().code == dp::Error::IO_ERROR);
+        }
+
+        CHECK_FALSE(conn.accepted->has_pending_input());
+        REQUIRE(conn.client.send(netpipe::Message{1, 2, 3}).is_ok());
+        CHECK(netpipe::remote::spin_for_input(*conn.accepted, 500000, std::atomic<bool>{true}));
+    }
+
+    netpipe::UdpDatagram udp;
+    REQUIRE(udp.bind({"127.0.0.1", 0}).is_ok());
+    auto udp_res = udp.set_busy_poll(50);
+    if (udp_res.is_err()) {
+        CHECK(udp_res.error().code == dp::Error::IO_ERROR);
+    }
+
+    netpipe::ShmStream listener;
+    netpipe::ShmEndpoint endpoint{"netpipe_test_shm_latency", 8192};
+    REQUIRE(listener.listen_shm(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> server;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        server = std::move(res.value());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    netpipe::ShmStream client;
+    REQUIRE(client.connect_shm(endpoint).is_ok());
+    accept_thread.join();
+
+    CHECK_FALSE(server->has_pending_input());
+    CHECK_FALSE(netpipe::remote::spin_for_input(*server, 1000, std::atomic<bool>{true}));
+    REQUIRE(client.send(netpipe::Message{4, 5}).is_ok());
+    CHECK(server->has_pending_input());
+    auto msg = server->recv();
+    REQUIRE(msg.is_ok());
+    CHECK_FALSE(server->has_pending_input());
+
+    client.close();
+    server->close();
+    listener.close();
+}
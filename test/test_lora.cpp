@@ -0,0 +1,272 @@
+#include <atomic>
+#include <doctest/doctest.h>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <poll.h>
+#include <thread>
+
+namespace {
+    // Stands in for the melodi firmware on the far side of a pseudo-terminal
+    // Parses commands, replies to each one and can inject received messages between replies
+    struct FakeFirmware {
+        dp::i32 master = -1;
+        dp::String slave_path;
+        std::atomic<bool> running{true};
+        std::atomic<bool> hold{false};         // Swallow SEND_MESSAGE replies until released
+        std::atomic<dp::usize> max_pending{0}; // Most SEND_MESSAGE commands seen while replies were held
+        std::atomic<dp::u64> nack_next{0};     // NACK this many SEND_MESSAGE commands
+        std::atomic<dp::u64> drop_next{0};     // Lose the replies to this many commands of any kind
+        std::mutex mutex;
+        dp::Vector<netpipe::Message> payloads; // Frame payloads of every SEND_MESSAGE, in order
+        dp::usize held = 0;
+        std::thread thread;
+
+        FakeFirmware() {
+            master = ::posix_openpt(O_RDWR | O_NOCTTY);
+            REQUIRE(master >= 0);
+            REQUIRE(::grantpt(master) == 0);
+            REQUIRE(::unlockpt(master) == 0);
+            slave_path = dp::String(::ptsname(master));
+            thread = std::thread([this]() { run(); });
+        }
+
+        ~FakeFirmware() {
+            running = false;
+            thread.join();
+            ::close(master);
+        }
+
+        void reply(dp::u8 type) {
+            dp::u8 frame[5] = {0xAA, 0xBB, 0xCC, 0xDD, type};
+            REQUIRE(netpipe::write_exact(master, frame, sizeof(frame)).is_ok());
+        }
+
+        void inject(const netpipe::Message &payload, dp::u8 src_last) {
+            netpipe::Message frame = {0xAA, 0xBB, 0xCC, 0xDD, 0x83, 0x00};
+            dp::u8 src[16] = {0x20, 0x01, 0x0d, 0xb8};
+            src[15] = src_last;
+            frame.insert(frame.end(), src, src + 16);
+            frame.push_back(static_cast<dp::u8>(payload.size() >> 8));
+            frame.push_back(static_cast<dp::u8>(payload.size() & 0xFF));
+            frame.insert(frame.end(), payload.begin(), payload.end());
+            REQUIRE(netpipe::write_exact(master, frame.data(), frame.size()).is_ok());
+        }
+
+        void release() {
+            std::lock_guard<std::mutex> lock(mutex);
+            hold = false;
+            for (; held > 0; held--) {
+                reply(0x80);
+            }
+        }
+
+        dp::Vector<netpipe::Message> sent() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return payloads;
+        }
+
+        void run() {
+            netpipe::Message buffer;
+            dp::u8 chunk[512];
+            while (running) {
+                pollfd pfd = {master, POLLIN, 0};
+                if (::poll(&pfd, 1, 20) <= 0) {
+                    continue;
+                }
+                auto n = ::read(master, chunk, sizeof(chunk));
+                if (n <= 0) {
+                    continue;
+                }
+                buffer.insert(buffer.end(), chunk, chunk + n);
+                while (!buffer.empty()) {
+                    dp::usize size = 0;
+                    if (buffer[0] == 0x01) { // [cmd][len:2][repeat][dest:16][payload]
+                        if (buffer.size() < 20) {
+                            break;
+                        }
+                        size = 20 + ((static_cast<dp::usize>(buffer[1]) << 8) | buffer[2]);
+                    } else if (buffer[0] == 0x04) { // [cmd][config type][value]
+                        if (buffer.size() < 2) {
+                            break;
+                        }
+                        dp::usize value[] = {0, 1, 4, 1, 16};
+                        size = 2 + value[buffer[1]];
+                    } else {
+                        size = 1;
+                    }
+                    if (buffer.size() < size) {
+                        break;
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (buffer[0] == 0x01) {
+                        payloads.push_back(netpipe::Message(buffer.begin() + 20, buffer.begin() + size));
+                    }
+                    if (drop_next > 0) {
+                        drop_next--;
+                    } else if (buffer[0] == 0x01) {
+                        if (nack_next > 0) {
+                            nack_next--;
+                            reply(0x81);
+                        } else if (hold) {
+                            held++;
+                            if (held > max_pending) {
+                                max_pending = held;
+                            }
+                        } else {
+                            reply(0x80);
+                        }
+                    } else {
+                        reply(0x80);
+                    }
+                    buffer.erase(buffer.begin(), buffer.begin() + static_cast<dp::isize>(size));
+                }
+            }
+        }
+    };
+} // namespace
+
+TEST_CASE("LoraDatagram - Pipelined sends") {
+    FakeFirmware firmware;
+    netpipe::LoraDatagram lora(firmware.slave_path);
+    REQUIRE(lora.bind_lora({"2001:db8::1"}).is_ok());
+    lora.set_recv_timeout(2000);
+
+    SUBCASE("Sends return before the ACK and keep send_window frames outstanding") {
+        lora.set_send_window(3);
+        firmware.hold = true;
+        for (dp::u8 i = 0; i < 5; i++) {
+            REQUIRE(lora.send_to(netpipe::Message{i, i}, {"2001:db8::2", 0}).is_ok());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(firmware.max_pending == 3);
+        CHECK(lora.flush(50).is_err()); // Still waiting for replies
+
+        firmware.release();
+        while (firmware.sent().size() < 5) {
+            firmware.release();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        REQUIRE(lora.flush(2000).is_ok());
+        auto sent = firmware.sent();
+        REQUIRE(sent.size() == 5);
+        for (dp::u8 i = 0; i < 5; i++) {
+            CHECK(sent[i] == netpipe::Message{i, i});
+        }
+    }
+
+    SUBCASE("Messages received between ACKs go to recv_from") {
+        REQUIRE(lora.send_to(netpipe::Message{1}, {"2001:db8::2", 0}).is_ok());
+        firmware.inject(netpipe::Message{7, 8, 9}, 0x42);
+        REQUIRE(lora.broadcast(netpipe::Message{2}).is_ok());
+        REQUIRE(lora.flush().is_ok());
+
+        auto res = lora.recv_from();
+        REQUIRE(res.is_ok());
+        CHECK(res.value().first == netpipe::Message{7, 8, 9});
+        CHECK(res.value().second.host == "2001:db8::42");
+        lora.set_recv_timeout(50);
+        CHECK(lora.recv_from().is_err());
+    }
+
+    SUBCASE("A NACK is reported by flush") {
+        firmware.nack_next = 1;
+        REQUIRE(lora.send_to(netpipe::Message{1}, {"2001:db8::2", 0}).is_ok());
+        REQUIRE(lora.send_to(netpipe::Message{2}, {"2001:db8::2", 0}).is_ok());
+        auto res = lora.flush();
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::IO_ERROR);
+        CHECK(lora.nack_count() == 1);
+        CHECK(lora.flush().is_ok()); // Reported once
+    }
+
+    SUBCASE("A lost reply times out and frees its window slot") {
+        lora.set_send_window(1);
+        lora.set_reply_timeout(100);
+        firmware.drop_next = 1;
+        REQUIRE(lora.send_to(netpipe::Message{1}, {"2001:db8::2", 0}).is_ok());
+        REQUIRE(lora.send_to(netpipe::Message{2}, {"2001:db8::2", 0}).is_ok());
+        auto res = lora.flush(2000);
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::IO_ERROR);
+        CHECK(lora.nack_count() == 1);
+        CHECK(firmware.sent().size() == 2);
+
+        // Later frames and commands are answered in step again
+        REQUIRE(lora.send_to(netpipe::Message{3}, {"2001:db8::2", 0}).is_ok());
+        CHECK(lora.flush(2000).is_ok());
+        CHECK(lora.set_tx_power(14).is_ok());
+
+        firmware.drop_next = 1;
+        auto power = lora.set_tx_power(14);
+        REQUIRE(power.is_err());
+        CHECK(power.error().code == dp::Error::TIMEOUT);
+    }
+
+    SUBCASE("Invalid destinations and oversized messages are rejected") {
+        CHECK(lora.send_to(netpipe::Message{1}, {"not-an-address", 0}).is_err());
+        CHECK(lora.broadcast(netpipe::Message(netpipe::LoraDatagram::MAX_LORA_SIZE + 1)).is_err());
+        CHECK(lora.set_tx_power(14).is_ok());
+    }
+
+    lora.close();
+}
+
+TEST_CASE("LoraDatagram - Frame aggregation") {
+    FakeFirmware firmware;
+    netpipe::LoraDatagram lora(firmware.slave_path);
+    REQUIRE(lora.bind_lora({"2001:db8::1"}).is_ok());
+    lora.set_recv_timeout(2000);
+    lora.set_aggregation(true, 1000);
+
+    // 40 small messages to one node share frames of up to MAX_LORA_SIZE bytes
+    for (dp::u8 i = 0; i < 40; i++) {
+        REQUIRE(lora.send_to(netpipe::Message(10, i), {"2001:db8::2", 0}).is_ok());
+    }
+    REQUIRE(lora.send_to(netpipe::Message{0x55}, {"2001:db8::3", 0}).is_ok());
+    REQUIRE(lora.flush().is_ok());
+    CHECK(lora.messages_sent() == 41);
+    CHECK(lora.frames_sent() == 5); // 4 frames of up to 11 messages, 1 bare frame to the other node
+
+    auto sent = firmware.sent();
+    REQUIRE(sent.size() == 5);
+    dp::usize unpacked = 0;
+    for (const auto &frame : sent) {
+        CHECK(frame.size() <= netpipe::LoraDatagram::MAX_LORA_SIZE);
+        if (frame == netpipe::Message{0x55}) {
+            continue;
+        }
+        REQUIRE(frame[0] == netpipe::LoraDatagram::AGGREGATE_MAGIC);
+        for (dp::usize pos = 1; pos < frame.size(); pos += 1 + frame[pos]) {
+            CHECK(frame[pos] == 10);
+            CHECK(frame[pos + 1] == unpacked);
+            unpacked++;
+        }
+    }
+    CHECK(unpacked == 40);
+
+    // A received envelope is split back into its messages
+    firmware.inject(sent[0], 0x02);
+    for (dp::u8 i = 0; i < 11; i++) {
+        auto res = lora.recv_from();
+        REQUIRE(res.is_ok());
+        CHECK(res.value().first == netpipe::Message(10, i));
+        CHECK(res.value().second.host == "2001:db8::2");
+    }
+
+    // An empty message alone in its batch still goes out in an envelope
+    REQUIRE(lora.send_to(netpipe::Message{}, {"2001:db8::2", 0}).is_ok());
+    REQUIRE(lora.flush().is_ok());
+    sent = firmware.sent();
+    REQUIRE(sent.size() == 6);
+    CHECK(sent[5] == netpipe::Message{netpipe::LoraDatagram::AGGREGATE_MAGIC, 0});
+
+    // The linger timer sends a lone message without flush()
+    lora.set_aggregation(true, 20);
+    REQUIRE(lora.send_to(netpipe::Message{1, 2}, {"2001:db8::2", 0}).is_ok());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    sent = firmware.sent();
+    REQUIRE(sent.size() == 7);
+    CHECK(sent[6] == netpipe::Message{1, 2});
+
+    lora.close();
+}
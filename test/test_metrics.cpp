@@ -0,0 +1,180 @@
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("LatencyHistogram - Buckets and percentiles") {
+    using Layout = netpipe::remote::HistogramLayout;
+
+    SUBCASE("Bucket bounds stay within 1/16 of the value") {
+        for (dp::u64 value : {0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456ull, 1ull << 39}) {
+            dp::usize index = Layout::index_of(value);
+            REQUIRE(index < Layout::BUCKETS);
+            dp::u64 upper = Layout::upper_bound(index);
+            CHECK(upper >= value);
+            CHECK(upper - value <= value / 16);
+            if (index > 0) {
+                CHECK(Layout::upper_bound(index - 1) < value);
+            }
+        }
+        CHECK(Layout::index_of(UINT64_MAX) == Layout::BUCKETS - 1);
+    }
+
+    SUBCASE("Percentiles of a known distribution") {
+        netpipe::LatencyHistogram histogram;
+        CHECK(histogram.percentile(0.99) == 0);
+        for (dp::u64 v = 1; v <= 1000; v++) {
+            histogram.record(v);
+        }
+        histogram.record(50000); // One outlier
+        CHECK(histogram.count() == 1001);
+
+        dp::u64 p50 = histogram.percentile(0.5);
+        CHECK(p50 >= 500);
+        CHECK(p50 <= 532);
+        dp::u64 p99 = histogram.percentile(0.99);
+        CHECK(p99 >= 990);
+        CHECK(p99 <= 1055);
+        CHECK(histogram.percentile(1.0) == 50000);
+        CHECK(histogram.percentile(0.0) == 1);
+    }
+
+    SUBCASE("Snapshot and merge") {
+        netpipe::LatencyHistogram fast;
+        netpipe::LatencyHistogram slow;
+        for (int i = 0; i < 90; i++) {
+            fast.record(10);
+        }
+        for (int i = 0; i < 10; i++) {
+            slow.record(5000);
+        }
+        netpipe::HistogramSnapshot combined = fast.snapshot();
+        combined.merge(slow.snapshot());
+        CHECK(combined.count == 100);
+        CHECK(combined.percentile(0.9) == 10);
+        CHECK(combined.percentile(0.95) >= 5000);
+        CHECK(combined.max == 5000);
+
+        fast.merge(slow.snapshot());
+        CHECK(fast.count() == 100);
+        CHECK(fast.percentile(0.95) == combined.percentile(0.95));
+        fast.reset();
+        CHECK(fast.count() == 0);
+    }
+
+    SUBCASE("Concurrent recording loses nothing") {
+        netpipe::LatencyHistogram histogram;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&histogram, t]() {
+                for (dp::u64 i = 0; i < 10000; i++) {
+                    histogram.record(i % 100 + static_cast<dp::u64>(t));
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        CHECK(histogram.count() == 40000);
+        CHECK(histogram.snapshot().count == 40000);
+    }
+}
+
+TEST_CASE("ShardedCounter - Sums across threads") {
+    netpipe::ShardedCounter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&counter]() {
+            for (int i = 0; i < 20000; i++) {
+                counter.fetch_add(3);
+                counter.fetch_sub(1);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    CHECK(counter.load() == 8 * 20000 * 2);
+
+    counter = 5;
+    CHECK(counter == 5);
+    counter.fetch_sub(6); // The shard this thread uses may wrap; the total does not care
+    counter.fetch_add(2);
+    CHECK(counter.load() == 1);
+}
+
+TEST_CASE("RemoteMetrics - Per-method histograms") {
+    netpipe::RemoteMetrics metrics;
+    metrics.per_method.record_latency(1, 100);
+    metrics.per_method.record_latency(1, 120);
+    metrics.per_method.record_latency(900000, 7000);
+    metrics.per_method.record_handler_time(1, 40);
+
+    const auto *one = metrics.per_method.find(1);
+    REQUIRE(one != nullptr);
+    CHECK(one->latency.count() == 2);
+    CHECK(one->handler_time.count() == 1);
+    CHECK(metrics.method_latency_percentile_us(900000, 0.5) == 7000);
+    CHECK(metrics.per_method.find(2) == nullptr);
+    CHECK(metrics.method_latency_percentile_us(2, 0.5) == 0);
+
+    dp::usize methods = 0;
+    metrics.per_method.for_each([&methods](const netpipe::remote::MethodLatency &) { methods++; });
+    CHECK(methods == 2);
+
+    // More methods than slots: the extras are dropped, not crashed on
+    for (dp::u32 id = 0; id < 300; id++) {
+        metrics.per_method.record_latency(id * 7 + 3, 1);
+    }
+    CHECK(metrics.per_method.find(1) != nullptr);
+
+    SUBCASE("Remote<Bidirect> records both sides") {
+        netpipe::TcpStream listener;
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", 20024};
+        REQUIRE(listener.listen(endpoint).is_ok());
+        std::unique_ptr<netpipe::Stream> accepted;
+        std::thread accept_thread([&]() {
+            auto res = listener.accept();
+            REQUIRE(res.is_ok());
+            accepted = std::move(res.value());
+        });
+        netpipe::TcpStream client;
+        REQUIRE(client.connect(endpoint).is_ok());
+        accept_thread.join();
+
+        {
+            netpipe::Remote<netpipe::Bidirect> server(*accepted, 100, true);
+            server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                return dp::result::ok(req);
+            });
+            server.register_method(2, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                return dp::result::ok(req);
+            });
+            netpipe::Remote<netpipe::Bidirect> remote(client, 100, true);
+
+            for (int i = 0; i < 20; i++) {
+                REQUIRE(remote.call(1, netpipe::Message{1}, 2000).is_ok());
+            }
+            for (int i = 0; i < 3; i++) {
+                REQUIRE(remote.call(2, netpipe::Message{2}, 2000).is_ok());
+            }
+
+            const auto &client_metrics = remote.get_client_metrics();
+            CHECK(client_metrics.latency_histogram.count() == 23);
+            CHECK(client_metrics.latency_percentile_us(1.0) >= 20000);
+            CHECK(client_metrics.method_latency_percentile_us(2, 0.5) >= 20000);
+            CHECK(client_metrics.method_latency_percentile_us(1, 0.5) < 20000);
+
+            const auto &server_metrics = server.get_server_metrics();
+            CHECK(server_metrics.handler_invocations == 23);
+            CHECK(server_metrics.handler_histogram.count() == 23);
+            REQUIRE(server_metrics.per_method.find(2) != nullptr);
+            CHECK(server_metrics.per_method.find(2)->handler_time.percentile(0.5) >= 20000);
+        }
+
+        client.close();
+        accepted->close();
+        listener.close();
+    }
+}
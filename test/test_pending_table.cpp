@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cstring>
+#include <doctest/doctest.h>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("PendingTable - Slot lifecycle") {
+    netpipe::remote::PendingTable table(3);
+    CHECK(table.capacity() == 4);
+    CHECK(table.limit() == 3);
+
+    SUBCASE("First id is zero and completion reaches the waiter") {
+        auto id = table.acquire();
+        REQUIRE(id.is_ok());
+        CHECK(id.value() == 0);
+        CHECK(table.in_flight() == 1);
+
+        CHECK(table.complete(id.value(), dp::result::ok(netpipe::Message{1, 2, 3})));
+        CHECK_FALSE(table.complete(id.value(), dp::result::ok(netpipe::Message{4})));
+
+        auto res = table.wait(id.value(), 1000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{1, 2, 3});
+        CHECK(table.in_flight() == 0);
+    }
+
+    SUBCASE("Limit is enforced and freed slots are reused") {
+        dp::u32 ids[3];
+        for (auto &id : ids) {
+            auto res = table.acquire();
+            REQUIRE(res.is_ok());
+            id = res.value();
+        }
+        CHECK(table.acquire().is_err());
+
+        table.release(ids[1]);
+        CHECK(table.in_flight() == 2);
+        CHECK(table.acquire().is_ok());
+    }
+
+    SUBCASE("Timed-out call ignores its late response") {
+        auto id = table.acquire();
+        REQUIRE(id.is_ok());
+        auto res = table.wait(id.value(), 10);
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::TIMEOUT);
+        CHECK_FALSE(table.complete(id.value(), dp::result::ok(netpipe::Message{9})));
+
+        // Every slot gets a new generation, so no live call carries the stale id
+        for (int i = 0; i < 8; i++) {
+            auto next = table.acquire();
+            REQUIRE(next.is_ok());
+            CHECK(next.value() != id.value());
+            table.release(next.value());
+        }
+    }
+
+    SUBCASE("fail_all wakes every waiter") {
+        auto a = table.acquire();
+        auto b = table.acquire();
+        REQUIRE(a.is_ok());
+        REQUIRE(b.is_ok());
+        table.fail_all("shutdown");
+        CHECK(table.wait(a.value(), 1000).is_err());
+        CHECK(table.wait(b.value(), 1000).is_err());
+        CHECK(table.in_flight() == 0);
+    }
+}
+
+TEST_CASE("PendingTable - Concurrent callers and completer") {
+    netpipe::remote::PendingTable table(64);
+    const int callers = 8;
+    const int calls = 2000;
+    std::atomic<int> ok{0};
+    std::atomic<bool> done{false};
+
+    // Completer echoes each id back as the payload, like a receiver thread matching responses
+    std::vector<dp::u32> inbox;
+    std::mutex inbox_mutex;
+    std::thread completer([&]() {
+        while (!done) {
+            std::vector<dp::u32> batch;
+            {
+                std::lock_guard<std::mutex> lock(inbox_mutex);
+                batch.swap(inbox);
+            }
+            for (dp::u32 id : batch) {
+                netpipe::Message payload(4);
+                std::memcpy(payload.data(), &id, 4);
+                table.complete(id, dp::result::ok(std::move(payload)));
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < callers; c++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < calls; i++) {
+                auto id = table.acquire();
+                REQUIRE(id.is_ok());
+                {
+                    std::lock_guard<std::mutex> lock(inbox_mutex);
+                    inbox.push_back(id.value());
+                }
+                auto res = table.wait(id.value(), 5000);
+                REQUIRE(res.is_ok());
+                dp::u32 echoed;
+                std::memcpy(&echoed, res.value().data(), 4);
+                CHECK(echoed == id.value());
+                ok++;
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    done = true;
+    completer.join();
+
+    CHECK(ok == callers * calls);
+    CHECK(table.in_flight() == 0);
+}
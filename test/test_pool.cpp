@@ -0,0 +1,135 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+    std::unique_ptr<netpipe::remote::RemoteServer> serve(std::unique_ptr<netpipe::Stream> listener, dp::u8 tag,
+                                                         std::atomic<int> &served) {
+        auto server = std::make_unique<netpipe::remote::RemoteServer>(2);
+        REQUIRE(server
+                    ->register_method(1,
+                                      [tag, &served](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                                          served++;
+                                          std::this_thread::sleep_for(std::chrono::microseconds(200));
+                                          netpipe::Message out(req);
+                                          out.push_back(tag);
+                                          return dp::result::ok(out);
+                                      })
+                    .is_ok());
+        REQUIRE(server->add_listener(std::move(listener)).is_ok());
+        REQUIRE(server->start().is_ok());
+        return server;
+    }
+
+    std::unique_ptr<netpipe::Stream> tcp_listener(const netpipe::TcpEndpoint &endpoint) {
+        auto listener = std::make_unique<netpipe::TcpStream>();
+        REQUIRE(listener->listen(endpoint).is_ok());
+        return listener;
+    }
+
+    bool wait_for(const std::function<bool()> &done) {
+        for (int i = 0; i < 300 && !done(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return done();
+    }
+} // namespace
+
+TEST_CASE("RemotePool - Balancing over TCP and IPC servers") {
+    netpipe::TcpEndpoint tcp_endpoint{"127.0.0.1", 20027};
+    netpipe::IpcEndpoint ipc_endpoint{"/tmp/netpipe_test_pool.sock"};
+    std::atomic<int> tcp_served{0};
+    std::atomic<int> ipc_served{0};
+    auto tcp_server = serve(tcp_listener(tcp_endpoint), 'T', tcp_served);
+    auto ipc = std::make_unique<netpipe::IpcStream>();
+    REQUIRE(ipc->listen_ipc(ipc_endpoint).is_ok());
+    auto ipc_server = serve(std::move(ipc), 'I', ipc_served);
+
+    for (auto policy : {netpipe::BalancePolicy::LeastOutstanding, netpipe::BalancePolicy::PowerOfTwo}) {
+        tcp_served = 0;
+        ipc_served = 0;
+        netpipe::PoolConfig config;
+        config.policy = policy;
+        netpipe::RemotePool pool({tcp_endpoint, ipc_endpoint}, config);
+        CHECK(pool.endpoint_count() == 2);
+        CHECK(pool.connected_count() == 2);
+
+        std::vector<std::thread> callers;
+        std::atomic<int> ok{0};
+        for (int t = 0; t < 4; t++) {
+            callers.emplace_back([&, t]() {
+                for (int i = 0; i < 50; i++) {
+                    netpipe::Message request{static_cast<dp::u8>(t), static_cast<dp::u8>(i)};
+                    auto res = pool.call(1, request, 2000);
+                    REQUIRE(res.is_ok());
+                    REQUIRE(res.value().size() == 3);
+                    CHECK(res.value()[1] == static_cast<dp::u8>(i));
+                    ok++;
+                }
+            });
+        }
+        for (auto &caller : callers) {
+            caller.join();
+        }
+        CHECK(ok == 200);
+        CHECK(pool.call_count(0) + pool.call_count(1) == 200);
+        CHECK(pool.outstanding(0) == 0);
+        // Both servers took a real share of the load
+        CHECK(tcp_served > 20);
+        CHECK(ipc_served > 20);
+    }
+
+    ipc_server->stop();
+    tcp_server->stop();
+}
+
+TEST_CASE("RemotePool - Servers leaving and coming back") {
+    netpipe::TcpEndpoint first{"127.0.0.1", 20028};
+    netpipe::TcpEndpoint second{"127.0.0.1", 20029};
+    std::atomic<int> first_served{0};
+    std::atomic<int> second_served{0};
+    auto first_server = serve(tcp_listener(first), 'A', first_served);
+
+    netpipe::PoolConfig config;
+    config.reconnect_interval_ms = 20;
+    netpipe::RemotePool pool({first, second}, config);
+    CHECK(pool.connected_count() == 1);
+    CHECK_FALSE(pool.is_connected(1));
+    for (int i = 0; i < 10; i++) {
+        auto res = pool.call(1, {1}, 2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value().back() == 'A');
+    }
+
+    // The second server starts late and is picked up in the background
+    auto second_server = serve(tcp_listener(second), 'B', second_served);
+    REQUIRE(wait_for([&]() { return pool.connected_count() == 2; }));
+
+    // The first one goes away: calls move over to the survivor
+    first_server->stop();
+    first_server.reset();
+    REQUIRE(wait_for([&]() { return !pool.is_connected(0); }));
+    for (int i = 0; i < 10; i++) {
+        auto res = pool.call(1, {2}, 2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value().back() == 'B');
+    }
+
+    second_server->stop();
+    second_server.reset();
+    REQUIRE(wait_for([&]() { return pool.connected_count() == 0; }));
+    CHECK(pool.call(1, {3}, 500).is_err());
+
+    // And comes back on the same port
+    first_served = 0;
+    first_server = serve(tcp_listener(first), 'A', first_served);
+    pool.reconnect_now();
+    REQUIRE(wait_for([&]() { return pool.is_connected(0); }));
+    auto res = pool.call(1, {4}, 2000);
+    REQUIRE(res.is_ok());
+    CHECK(res.value().back() == 'A');
+    first_server->stop();
+}
@@ -0,0 +1,239 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using netpipe::Priority;
+
+namespace {
+    // Hold the executor's only worker until release is set
+    template <typename ExecutorT> void block_worker(ExecutorT &executor, std::atomic<bool> &release) {
+        REQUIRE(executor.submit([&]() {
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }));
+        for (int i = 0; i < 200 && executor.active_count() == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        REQUIRE(executor.active_count() == 1);
+    }
+
+    template <typename ExecutorT> std::vector<Priority> run_order(ExecutorT &executor) {
+        std::atomic<bool> release{false};
+        block_worker(executor, release);
+        std::mutex order_mutex;
+        std::vector<Priority> order;
+        for (Priority priority : {Priority::Low, Priority::Normal, Priority::High, Priority::Critical}) {
+            REQUIRE(executor.submit(
+                [&, priority]() {
+                    std::lock_guard<std::mutex> lock(order_mutex);
+                    order.push_back(priority);
+                },
+                priority));
+        }
+        release = true;
+        executor.shutdown();
+        return order;
+    }
+} // namespace
+
+TEST_CASE("Priority - Header flags") {
+    using netpipe::remote::flags_priority;
+    using netpipe::remote::priority_flags;
+    CHECK(priority_flags(Priority::Normal) == netpipe::remote::MessageFlags::None);
+    for (Priority priority : {Priority::Low, Priority::High, Priority::Critical}) {
+        dp::u16 flags = priority_flags(priority) | netpipe::remote::MessageFlags::Compressed;
+        CHECK((flags & netpipe::remote::MessageFlags::PriorityMask) != 0);
+        CHECK(flags_priority(flags, Priority::Normal) == priority);
+    }
+    CHECK(flags_priority(netpipe::remote::MessageFlags::Final, Priority::High) == Priority::High);
+
+    netpipe::remote::MethodRegistry registry;
+    CHECK(registry.priority(1) == Priority::Normal);
+    registry.set_priority(1, Priority::Critical);
+    registry.set_priority(70000, Priority::Low);
+    CHECK(registry.priority(1) == Priority::Critical);
+    CHECK(registry.priority(2) == Priority::Normal);
+    CHECK(registry.priority(70000) == Priority::Low);
+    registry.clear();
+    CHECK(registry.priority(1) == Priority::Normal);
+}
+
+TEST_CASE("Priority - FairMutex serves higher classes first") {
+    netpipe::remote::FairMutex mutex;
+    mutex.lock();
+    std::mutex order_mutex;
+    std::vector<Priority> order;
+    std::vector<std::thread> waiters;
+    for (Priority priority : {Priority::Low, Priority::Normal, Priority::Normal, Priority::Critical}) {
+        waiters.emplace_back([&, priority]() {
+            mutex.lock(priority);
+            {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(priority);
+            }
+            mutex.unlock();
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20)); // Queue in this order
+    }
+    mutex.unlock();
+    for (auto &waiter : waiters) {
+        waiter.join();
+    }
+    REQUIRE(order.size() == 4);
+    CHECK(order[0] == Priority::Critical);
+    CHECK(order[1] == Priority::Normal);
+    CHECK(order[2] == Priority::Normal);
+    CHECK(order[3] == Priority::Low);
+}
+
+TEST_CASE("Priority - Executors run higher classes first and shed lower ones first") {
+    SUBCASE("ThreadPool") {
+        netpipe::remote::ThreadPool pool(1, 100);
+        auto order = run_order(pool);
+        REQUIRE(order.size() == 4);
+        CHECK(order[0] == Priority::Critical);
+        CHECK(order[1] == Priority::High);
+        CHECK(order[2] == Priority::Normal);
+        CHECK(order[3] == Priority::Low);
+    }
+
+    SUBCASE("WorkStealingExecutor") {
+        netpipe::WorkStealingExecutor executor(1, 100);
+        auto order = run_order(executor);
+        REQUIRE(order.size() == 4);
+        CHECK(order[0] == Priority::Critical);
+        CHECK(order[1] == Priority::High);
+        CHECK(order[2] == Priority::Normal);
+        CHECK(order[3] == Priority::Low);
+    }
+
+    SUBCASE("Admission") {
+        netpipe::remote::ThreadPool pool(1, 8);
+        std::atomic<bool> release{false};
+        block_worker(pool, release);
+        for (int i = 0; i < 4; i++) {
+            CHECK(pool.submit([]() {}, Priority::Low));
+        }
+        CHECK_FALSE(pool.submit([]() {}, Priority::Low)); // Half the queue
+        for (int i = 0; i < 4; i++) {
+            CHECK(pool.submit([]() {}));
+        }
+        CHECK_FALSE(pool.submit([]() {})); // Normal stops at max_queue
+        CHECK(pool.submit([]() {}, Priority::High));
+        CHECK_FALSE(pool.submit([]() {}, Priority::High));
+        CHECK(pool.submit([]() {}, Priority::Critical));
+        CHECK_FALSE(pool.submit([]() {}, Priority::Critical));
+        release = true;
+    }
+}
+
+TEST_CASE("Priority - Remote<Bidirect> keeps control calls ahead of bulk work") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20055};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client_stream;
+    REQUIRE(client_stream.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        // One handler thread and room for 8 queued Normal requests
+        netpipe::Remote<netpipe::Bidirect> server(*accepted, 100, false, 100, 1, 8, 0);
+        std::atomic<bool> release{false};
+        std::mutex order_mutex;
+        std::vector<dp::u32> order;
+        auto record = [&](dp::u32 method_id) {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(method_id);
+        };
+        server.register_method(1, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return dp::result::ok(req);
+        });
+        server.register_method(
+            2,
+            [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                record(2);
+                return dp::result::ok(req);
+            },
+            Priority::Low);
+        server.register_method(
+            3,
+            [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                record(3);
+                return dp::result::ok(req);
+            },
+            Priority::Critical);
+        server.register_method(4, [&](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            record(4);
+            return dp::result::ok(req);
+        });
+        CHECK(server.method_priority(2) == Priority::Low);
+
+        netpipe::Remote<netpipe::Bidirect> client(client_stream, 100);
+        std::thread blocker([&]() { CHECK(client.call(1, netpipe::Message{1}, 5000).is_ok()); });
+        for (int i = 0; i < 200 && server.active_pool_tasks() == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        // Bulk uploads fill the Low share of the queue; the rest are shed
+        std::atomic<int> bulk_ok{0};
+        std::atomic<int> bulk_shed{0};
+        std::vector<std::thread> bulk;
+        for (int i = 0; i < 8; i++) {
+            bulk.emplace_back([&]() {
+                auto res = client.call(2, netpipe::Message(64, 0x42), 5000);
+                if (res.is_ok()) {
+                    bulk_ok++;
+                } else if (std::string(res.error().message.c_str()) == "Handler pool overloaded") {
+                    bulk_shed++;
+                }
+            });
+        }
+        for (int i = 0; i < 400 && server.shed_request_count() < 4; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        CHECK(server.shed_request_count() == 4);
+
+        // Queued behind the bulk work, yet they run first: one by registration, one by per-call override
+        std::thread estop([&]() { CHECK(client.call(3, netpipe::Message{3}, 5000).is_ok()); });
+        std::thread heartbeat([&]() { CHECK(client.call(4, netpipe::Message{4}, 5000, Priority::High).is_ok()); });
+        for (int i = 0; i < 400 && server.queued_pool_tasks() < 6; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        release = true;
+        blocker.join();
+        estop.join();
+        heartbeat.join();
+        for (auto &thread : bulk) {
+            thread.join();
+        }
+
+        CHECK(bulk_ok == 4);
+        CHECK(bulk_shed == 4);
+        REQUIRE(order.size() == 6);
+        CHECK(order[0] == 3);
+        CHECK(order[1] == 4);
+        for (dp::usize i = 2; i < order.size(); i++) {
+            CHECK(order[i] == 2);
+        }
+    }
+
+    client_stream.close();
+    accepted->close();
+    listener.close();
+}
@@ -0,0 +1,151 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+
+namespace {
+    struct Sample {
+        dp::u32 id;
+        double value;
+
+        auto members() { return std::tie(id, value); }
+    };
+
+    netpipe::TopicEndpoint topic(const char *name) {
+        netpipe::TopicEndpoint endpoint;
+        endpoint.name = name;
+        endpoint.shm_size = 64 * 1024;
+        return endpoint;
+    }
+
+    void wait_for_subscribers(netpipe::TopicPublisher &publisher, dp::usize count) {
+        for (int i = 0; i < 200 && publisher.subscriber_count() < count; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        REQUIRE(publisher.subscriber_count() == count);
+    }
+} // namespace
+
+TEST_CASE("Pub/Sub - Same host uses the shared memory ring") {
+    auto endpoint = topic("np_pubsub_shm");
+    netpipe::Publisher<Sample> publisher;
+    REQUIRE(publisher.open(endpoint).is_ok());
+
+    netpipe::Subscriber<Sample> first;
+    netpipe::Subscriber<Sample> second;
+    REQUIRE(first.open(endpoint).is_ok());
+    REQUIRE(second.open(endpoint).is_ok());
+    CHECK(first.transport() == netpipe::TopicTransport::Shm);
+
+    for (dp::u32 i = 0; i < 10; i++) {
+        REQUIRE(publisher.publish(Sample{i, i * 0.5}).is_ok());
+    }
+    for (auto *subscriber : {&first, &second}) {
+        for (dp::u32 i = 0; i < 10; i++) {
+            auto res = subscriber->recv(2000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value().id == i);
+            CHECK(res.value().value == i * 0.5);
+        }
+        CHECK(subscriber->raw().missed_count() == 0);
+    }
+    CHECK(publisher.raw().published_count() == 10);
+}
+
+TEST_CASE("Pub/Sub - Multicast group across the LAN") {
+    auto endpoint = topic("np_pubsub_mcast");
+    endpoint.shm = false;
+    endpoint.multicast = netpipe::MulticastEndpoint{"239.255.42.7", 20046, "127.0.0.1"};
+
+    netpipe::Publisher<netpipe::Message> publisher;
+    REQUIRE(publisher.open(endpoint).is_ok());
+    netpipe::Subscriber<netpipe::Message> subscriber;
+    REQUIRE(subscriber.open(endpoint).is_ok());
+    CHECK(subscriber.transport() == netpipe::TopicTransport::Multicast);
+
+    // Another topic on the same group is filtered out by its topic id
+    auto other = endpoint;
+    other.name = "np_pubsub_other";
+    netpipe::Publisher<netpipe::Message> noise;
+    REQUIRE(noise.open(other).is_ok());
+    REQUIRE(noise.publish(netpipe::Message{0xFF}).is_ok());
+
+    for (dp::u8 i = 0; i < 5; i++) {
+        REQUIRE(publisher.publish(netpipe::Message{i, 1, 2}).is_ok());
+    }
+    for (dp::u8 i = 0; i < 5; i++) {
+        auto res = subscriber.recv(2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{i, 1, 2});
+    }
+    CHECK(subscriber.recv(100).is_err());
+
+    netpipe::Message too_big(netpipe::UdpDatagram::MAX_UDP_SIZE);
+    CHECK(publisher.publish(too_big).is_err());
+}
+
+TEST_CASE("Pub/Sub - TCP fallback and slow subscribers") {
+    auto endpoint = topic("np_pubsub_tcp");
+    endpoint.shm = false;
+    endpoint.tcp = netpipe::TcpEndpoint{"127.0.0.1", 20047};
+    netpipe::TopicQos qos;
+    qos.depth = 4;
+    netpipe::Publisher<dp::u64> publisher;
+    REQUIRE(publisher.open(endpoint, qos).is_ok());
+
+    // Subscribers offered an SHM ring that does not exist on this host fall back to TCP
+    auto offered = endpoint;
+    offered.shm = true;
+    netpipe::Subscriber<dp::u64> fast;
+    netpipe::Subscriber<dp::u64> slow;
+    netpipe::Subscriber<dp::u64> latest;
+    netpipe::TopicQos latest_qos;
+    latest_qos.policy = netpipe::TopicPolicy::LatestValue;
+    REQUIRE(fast.open(offered).is_ok());
+    REQUIRE(slow.open(offered, qos).is_ok());
+    REQUIRE(latest.open(offered, latest_qos).is_ok());
+    CHECK(fast.transport() == netpipe::TopicTransport::Tcp);
+    wait_for_subscribers(publisher.raw(), 3);
+
+    // The fast subscriber keeps up; the others do not read at all, and publishing never waits for them
+    constexpr dp::u64 COUNT = 200;
+    for (dp::u64 i = 0; i < COUNT; i++) {
+        REQUIRE(publisher.publish(i).is_ok());
+        auto res = fast.recv(2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Keep-last: the newest four survive
+    for (dp::u64 i = COUNT - 4; i < COUNT; i++) {
+        auto res = slow.recv(2000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == i);
+    }
+    CHECK(slow.recv(50).is_err());
+    CHECK(slow.raw().dropped_count() + slow.raw().missed_count() == COUNT - 4);
+
+    // Latest value: only the newest one
+    auto newest = latest.recv(2000);
+    REQUIRE(newest.is_ok());
+    CHECK(newest.value() == COUNT - 1);
+    CHECK(latest.recv(50).is_err());
+
+    // Closing the publisher ends the subscriptions
+    publisher.close();
+    auto after = fast.recv(2000);
+    REQUIRE(after.is_err());
+    CHECK(after.error().code != dp::Error::TIMEOUT);
+}
+
+TEST_CASE("Pub/Sub - Unreachable topics") {
+    auto endpoint = topic("np_pubsub_missing");
+    netpipe::TopicSubscriber subscriber;
+    CHECK(subscriber.open(endpoint).is_err()); // No ring and no other path
+    CHECK(subscriber.transport() == netpipe::TopicTransport::None);
+
+    endpoint.shm = false;
+    netpipe::TopicPublisher publisher;
+    CHECK(publisher.open(endpoint).is_err());
+}
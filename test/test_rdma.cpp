@@ -0,0 +1,102 @@
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+
+#ifdef NETPIPE_RDMA
+
+#include <memory>
+#include <thread>
+
+TEST_CASE("RdmaStream - Fails cleanly without a device") {
+    if (netpipe::RdmaStream::is_supported()) {
+        return;
+    }
+    netpipe::RdmaStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20069};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::thread accept_thread([&]() { CHECK(listener.accept().is_err()); });
+
+    netpipe::RdmaStream client;
+    auto res = client.connect(endpoint);
+    REQUIRE(res.is_err());
+    CHECK(res.error().code == dp::Error::NOT_FOUND);
+    CHECK_FALSE(client.is_connected());
+    CHECK(client.send(netpipe::Message{1}).is_err());
+    accept_thread.join();
+    listener.close();
+}
+
+TEST_CASE("RdmaStream - SEND, chunked WRITE and Remote<Bidirect>") {
+    if (!netpipe::RdmaStream::is_supported()) {
+        MESSAGE("no RDMA device, skipped");
+        return;
+    }
+    netpipe::RdmaOptions options;
+    options.slot_size = 1024;
+    options.region_size = 64 * 1024;
+    netpipe::RdmaStream listener(options);
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20070};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::RdmaStream client(options);
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    CHECK(client.send_limit() == 1024);
+
+    // One SEND, one WRITE, several WRITE chunks, in order
+    netpipe::Message small(100, 1);
+    netpipe::Message medium(2000, 2);
+    netpipe::Message large(300 * 1024, 3);
+    for (dp::usize i = 0; i < large.size(); i++) {
+        large[i] = static_cast<dp::u8>(i * 7);
+    }
+    std::thread sender([&]() {
+        REQUIRE(client.send(small).is_ok());
+        REQUIRE(client.send(medium).is_ok());
+        REQUIRE(client.send(large).is_ok());
+        REQUIRE(client.send(netpipe::Message{}).is_ok());
+    });
+    auto res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == small);
+    res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == medium);
+    res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == large);
+    res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value().empty());
+    sender.join();
+
+    REQUIRE(accepted->set_recv_timeout(20).is_ok());
+    res = accepted->recv();
+    REQUIRE(res.is_err());
+    CHECK(res.error().code == dp::Error::TIMEOUT);
+    REQUIRE(accepted->set_recv_timeout(0).is_ok());
+
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        for (int i = 0; i < 50; i++) {
+            netpipe::Message request(i % 5 == 0 ? 100 * 1024 : 16, static_cast<dp::u8>(i));
+            auto reply = remote.call(1, request, 5000);
+            REQUIRE(reply.is_ok());
+            CHECK(reply.value() == request);
+        }
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+#endif
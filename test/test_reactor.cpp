@@ -0,0 +1,311 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <unistd.h>
+
+TEST_CASE("Reactor - Basic dispatch") {
+    netpipe::Reactor reactor;
+    REQUIRE(reactor.is_valid());
+
+    SUBCASE("Readable fd runs its handler") {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+
+        int calls = 0;
+        REQUIRE(reactor
+                    .add(fds[0], EPOLLIN,
+                         [&](dp::u32 events) {
+                             CHECK((events & EPOLLIN) != 0);
+                             char c;
+                             CHECK(::read(fds[0], &c, 1) == 1);
+                             calls++;
+                         })
+                    .is_ok());
+        CHECK(reactor.add(fds[0], EPOLLIN, [](dp::u32) {}).is_err());
+
+        auto idle = reactor.run_once(0);
+        REQUIRE(idle.is_ok());
+        CHECK(idle.value() == 0);
+
+        CHECK(::write(fds[1], "x", 1) == 1);
+        auto res = reactor.run_once(1000);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == 1);
+        CHECK(calls == 1);
+
+        reactor.remove(fds[0]);
+        CHECK(reactor.watch_count() == 0);
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    SUBCASE("Handler may remove its own fd") {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        REQUIRE(reactor.add(fds[0], EPOLLIN, [&](dp::u32) { reactor.remove(fds[0]); }).is_ok());
+
+        CHECK(::write(fds[1], "x", 1) == 1);
+        REQUIRE(reactor.run_once(1000).is_ok());
+        CHECK(reactor.watch_count() == 0);
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    SUBCASE("post and stop from another thread") {
+        std::atomic<int> posted{0};
+        std::thread loop([&]() { CHECK(reactor.run().is_ok()); });
+
+        for (int i = 0; i < 10; i++) {
+            reactor.post([&]() { posted++; });
+        }
+        reactor.post([&]() { reactor.stop(); });
+        loop.join();
+        CHECK(posted == 10);
+        CHECK_FALSE(reactor.is_running());
+    }
+
+    SUBCASE("stop before run returns immediately") {
+        reactor.stop();
+        CHECK(reactor.run().is_ok());
+    }
+}
+
+static netpipe::remote::Handler echo_handler() {
+    return [](const netpipe::Message &req) -> dp::Res<netpipe::Message> { return dp::result::ok(req); };
+}
+
+TEST_CASE("RemoteServer - Many TCP clients on one loop") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20011};
+    REQUIRE(listener->listen(endpoint).is_ok());
+
+    netpipe::remote::RemoteServer server(2);
+    REQUIRE(server.register_method(1, echo_handler()).is_ok());
+    REQUIRE(server
+                .register_method(2,
+                                 [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+                                     return dp::result::err(dp::Error::io_error("handler failed"));
+                                 })
+                .is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    const int clients = 16;
+    const int calls = 50;
+    std::atomic<int> ok{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([&, c]() {
+            netpipe::TcpStream stream;
+            REQUIRE(stream.connect(endpoint).is_ok());
+            netpipe::Remote<netpipe::Unidirect> remote(stream);
+
+            for (int i = 0; i < calls; i++) {
+                // Mix of small and multi-read payloads
+                dp::usize size = (i % 10 == 0) ? 200 * 1024 : static_cast<dp::usize>(1 + i);
+                netpipe::Message request(size, static_cast<dp::u8>(c + i));
+                auto res = remote.call(1, request, 5000);
+                REQUIRE(res.is_ok());
+                CHECK(res.value() == request);
+                ok++;
+            }
+
+            auto err = remote.call(2, {1}, 5000);
+            CHECK(err.is_err());
+            auto missing = remote.call(99, {1}, 5000);
+            CHECK(missing.is_err());
+            stream.close();
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    CHECK(ok == clients * calls);
+
+    // Closed clients are dropped by the loop
+    for (int i = 0; i < 100 && server.connection_count() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(server.connection_count() == 0);
+
+    server.stop();
+}
+
+TEST_CASE("RemoteServer - IPC connection handed over") {
+    netpipe::IpcStream listener;
+    netpipe::IpcEndpoint endpoint{"/tmp/netpipe_test_reactor.sock"};
+    REQUIRE(listener.listen_ipc(endpoint).is_ok());
+
+    netpipe::remote::RemoteServer server(1);
+    REQUIRE(server.register_method(7, echo_handler()).is_ok());
+    REQUIRE(server.add_connection(nullptr).is_err());
+    REQUIRE(server.start().is_ok());
+
+    std::thread client_thread([&]() {
+        netpipe::IpcStream client;
+        REQUIRE(client.connect_ipc(endpoint).is_ok());
+        netpipe::Remote<netpipe::Unidirect> remote(client);
+        for (int i = 0; i < 20; i++) {
+            auto res = remote.call(7, {static_cast<dp::u8>(i), 2, 3}, 5000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value()[0] == static_cast<dp::u8>(i));
+        }
+        client.close();
+    });
+
+    auto accept_res = listener.accept();
+    REQUIRE(accept_res.is_ok());
+    REQUIRE(server.add_connection(std::move(accept_res.value())).is_ok());
+
+    client_thread.join();
+    server.stop();
+    listener.close();
+}
+
+TEST_CASE("RemoteServer - SHM clients on accept and receive threads") {
+    auto listener = std::make_unique<netpipe::ShmStream>();
+    netpipe::ShmEndpoint endpoint{"netpipe_test_reactor_shm", 64 * 1024};
+    REQUIRE(listener->listen_shm(endpoint).is_ok());
+
+    const int clients = 3;
+    netpipe::remote::RemoteServer server(2);
+    server.set_max_connections(clients);
+    REQUIRE(server.register_method(1, echo_handler()).is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    std::atomic<int> ok{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([&, c]() {
+            netpipe::ShmStream stream;
+            REQUIRE(stream.connect_shm(endpoint).is_ok());
+            netpipe::Remote<netpipe::Unidirect> remote(stream);
+            for (int i = 0; i < 20; i++) {
+                netpipe::Message request(static_cast<dp::usize>(1 + i * 100), static_cast<dp::u8>(c + i));
+                auto res = remote.call(1, request, 5000);
+                REQUIRE(res.is_ok());
+                CHECK(res.value() == request);
+                ok++;
+            }
+            auto missing = remote.call(99, {1}, 5000);
+            CHECK(missing.is_err());
+            stream.close();
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    CHECK(ok == clients * 20);
+
+    // Closed clients give their slots back, so the limit admits the next ones
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (server.connection_count() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(server.connection_count() == 0);
+    for (int c = 0; c < clients; c++) {
+        netpipe::ShmStream stream;
+        REQUIRE(stream.connect_shm(endpoint).is_ok());
+        netpipe::Remote<netpipe::Unidirect> remote(stream);
+        auto res = remote.call(1, {7}, 5000);
+        REQUIRE(res.is_ok());
+        stream.close();
+    }
+    CHECK(server.refused_connection_count() == 0);
+
+    server.stop();
+    CHECK(server.connection_count() == 0);
+}
+
+TEST_CASE("RemoteServer - Connection limit") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20068};
+    REQUIRE(listener->listen(endpoint).is_ok());
+
+    netpipe::remote::RemoteServer server(1);
+    server.set_max_connections(2);
+    REQUIRE(server.register_method(1, echo_handler()).is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    auto first = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpStream second;
+    REQUIRE(first->connect(endpoint).is_ok());
+    REQUIRE(second.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> first_remote(*first);
+    netpipe::Remote<netpipe::Unidirect> second_remote(second);
+    REQUIRE(first_remote.call(1, {1}, 2000).is_ok());
+    REQUIRE(second_remote.call(1, {2}, 2000).is_ok());
+    CHECK(server.connection_count() == 2);
+
+    // Accepted and closed straight away
+    {
+        netpipe::TcpStream third;
+        REQUIRE(third.connect(endpoint).is_ok());
+        netpipe::Remote<netpipe::Unidirect> third_remote(third);
+        CHECK(third_remote.call(1, {3}, 2000).is_err());
+        CHECK(server.refused_connection_count() == 1);
+        third.close();
+    }
+
+    // A slot frees up once a client leaves
+    first->close();
+    for (int i = 0; i < 100 && server.connection_count() > 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(server.connection_count() == 1);
+    netpipe::TcpStream fourth;
+    REQUIRE(fourth.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> fourth_remote(fourth);
+    CHECK(fourth_remote.call(1, {4}, 2000).is_ok());
+    CHECK(server.refused_connection_count() == 1);
+
+    fourth.close();
+    second.close();
+    server.stop();
+}
+
+TEST_CASE("RemoteServer - Oversized frame closes the connection") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20075};
+    REQUIRE(listener->listen(endpoint).is_ok());
+
+    netpipe::remote::RemoteServer server(1);
+    server.set_max_frame_size(1024);
+    REQUIRE(server.register_method(1, echo_handler()).is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    netpipe::TcpStream good;
+    REQUIRE(good.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> good_remote(good);
+    REQUIRE(good_remote.call(1, netpipe::Message(512, 1), 2000).is_ok());
+
+    // A bare length prefix claiming 1 GB is refused before anything is allocated for it
+    netpipe::TcpStream hostile;
+    REQUIRE(hostile.connect(endpoint).is_ok());
+    for (int i = 0; i < 100 && server.connection_count() < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    dp::u8 prefix[4] = {0x40, 0, 0, 0};
+    REQUIRE(::write(hostile.native_handle(), prefix, sizeof(prefix)) == 4);
+    for (int i = 0; i < 100 && server.connection_count() > 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(server.connection_count() == 1);
+
+    // Over the per-server cap, even though the protocol would allow it
+    netpipe::TcpStream large;
+    REQUIRE(large.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> large_remote(large);
+    CHECK(large_remote.call(1, netpipe::Message(4096, 2), 2000).is_err());
+
+    CHECK(good_remote.call(1, netpipe::Message(512, 3), 2000).is_ok());
+    large.close();
+    hostile.close();
+    good.close();
+    server.stop();
+}
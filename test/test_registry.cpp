@@ -0,0 +1,130 @@
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+
+namespace {
+    dp::Res<netpipe::Message> add_one(const netpipe::Message &req) {
+        netpipe::Message out(req);
+        for (auto &b : out) {
+            b++;
+        }
+        return dp::result::ok(out);
+    }
+
+    using Static = netpipe::remote::StaticRegistry<
+        netpipe::remote::Method<1, add_one>,
+        netpipe::remote::Method<70000, [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+            return dp::result::err(dp::Error::invalid_argument("static failure"));
+        }>>;
+} // namespace
+
+TEST_CASE("MethodRegistry - Dense and sparse ids") {
+    netpipe::remote::MethodRegistry registry;
+    auto tag = [](dp::u8 value) {
+        return [value](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(netpipe::Message{value});
+        };
+    };
+
+    REQUIRE(registry.register_method(0, tag(10)).is_ok());
+    REQUIRE(registry.register_method(255, tag(11)).is_ok());
+    REQUIRE(registry.register_method(256, tag(12)).is_ok());
+    REQUIRE(registry.register_method(0xFFFFFFFF, tag(13)).is_ok());
+    CHECK(registry.register_method(255, tag(99)).is_err());
+    CHECK(registry.method_count() == 4);
+
+    CHECK(registry.dispatch(0, {})->value() == netpipe::Message{10});
+    CHECK(registry.dispatch(255, {})->value() == netpipe::Message{11});
+    CHECK(registry.dispatch(256, {})->value() == netpipe::Message{12});
+    CHECK(registry.dispatch(0xFFFFFFFF, {})->value() == netpipe::Message{13});
+    CHECK_FALSE(registry.dispatch(1, {}).has_value());
+    CHECK_FALSE(registry.dispatch(1000, {}).has_value());
+
+    // Handler pointers stay valid while more methods arrive
+    const netpipe::remote::Handler *handler = registry.find(255);
+    REQUIRE(handler != nullptr);
+    for (dp::u32 id = 1; id < 200; id++) {
+        REQUIRE(registry.register_method(id * 1000 + 7, tag(1)).is_ok());
+    }
+    CHECK(registry.find(255) == handler);
+
+    CHECK(registry.unregister_method(255).is_ok());
+    CHECK(registry.unregister_method(255).is_err());
+    CHECK_FALSE(registry.has_method(255));
+    CHECK(registry.find(255) == nullptr);
+
+    registry.set_default_handler(tag(42));
+    CHECK(registry.dispatch(255, {})->value() == netpipe::Message{42});
+    CHECK(registry.get_handler(256).is_ok());
+    registry.clear_default_handler();
+    CHECK(registry.get_handler(255).is_err());
+}
+
+TEST_CASE("StaticRegistry - Compile-time dispatch") {
+    static_assert(Static::size == 2);
+    static_assert(Static::contains(70000));
+    static_assert(!Static::contains(2));
+
+    auto ok = Static::dispatch(1, netpipe::Message{1, 2});
+    REQUIRE(ok.has_value());
+    CHECK(ok->value() == netpipe::Message{2, 3});
+    auto failed = Static::dispatch(70000, {});
+    REQUIRE(failed.has_value());
+    CHECK(failed->is_err());
+    CHECK_FALSE(Static::dispatch(2, {}).has_value());
+
+    SUBCASE("Mounted table takes precedence and falls through to registered methods") {
+        netpipe::remote::MethodRegistry registry;
+        REQUIRE(registry.register_method(2, [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+                            return dp::result::ok(netpipe::Message{2});
+                        }).is_ok());
+        registry.mount<Static>();
+        CHECK(registry.method_count() == 3);
+        CHECK(registry.has_method(1));
+        CHECK(registry.register_method(1, add_one).is_err());
+        CHECK(registry.dispatch(1, netpipe::Message{5})->value() == netpipe::Message{6});
+        CHECK(registry.dispatch(2, {})->value() == netpipe::Message{2});
+        CHECK_FALSE(registry.dispatch(3, {}).has_value());
+
+        // clear() unmounts the table along with the registered methods
+        registry.clear();
+        CHECK(registry.method_count() == 0);
+        CHECK_FALSE(registry.has_method(1));
+        CHECK_FALSE(registry.dispatch(1, netpipe::Message{5}).has_value());
+        CHECK(registry.register_method(1, add_one).is_ok());
+    }
+
+    SUBCASE("Remote<Bidirect> serves a static table") {
+        netpipe::TcpStream listener;
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", 20022};
+        REQUIRE(listener.listen(endpoint).is_ok());
+        std::unique_ptr<netpipe::Stream> accepted;
+        std::thread accept_thread([&]() {
+            auto res = listener.accept();
+            REQUIRE(res.is_ok());
+            accepted = std::move(res.value());
+        });
+        netpipe::TcpStream client;
+        REQUIRE(client.connect(endpoint).is_ok());
+        accept_thread.join();
+
+        {
+            netpipe::Remote<netpipe::Bidirect> server(*accepted);
+            server.register_static_methods<Static>();
+            netpipe::Remote<netpipe::Bidirect> remote(client);
+
+            auto res = remote.call(1, netpipe::Message{9}, 2000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == netpipe::Message{10});
+            auto failed_call = remote.call(70000, {}, 2000);
+            REQUIRE(failed_call.is_err());
+            CHECK(std::string(failed_call.error().message.c_str()).find("static failure") != std::string::npos);
+            CHECK(remote.call(5, {}, 2000).is_err());
+        }
+
+        client.close();
+        accepted->close();
+        listener.close();
+    }
+}
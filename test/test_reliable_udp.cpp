@@ -0,0 +1,325 @@
+#include <atomic>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+namespace {
+    netpipe::Message pattern(dp::usize size, dp::u8 seed) {
+        netpipe::Message msg(size);
+        for (dp::usize i = 0; i < size; i++) {
+            msg[i] = static_cast<dp::u8>((i * 13 + seed) & 0xFF);
+        }
+        return msg;
+    }
+
+    // Connected pair: client dials, server is the accepted side
+    struct Pair {
+        netpipe::ReliableUdpStream listener;
+        netpipe::ReliableUdpStream client;
+        std::unique_ptr<netpipe::Stream> accepted;
+
+        Pair(dp::u16 listen_port, dp::u16 dial_port, netpipe::ReliableUdpConfig config = {})
+            : listener(config), client(config) {
+            REQUIRE(listener.listen({"127.0.0.1", listen_port}).is_ok());
+            std::thread accept_thread([&]() {
+                auto res = listener.accept();
+                REQUIRE(res.is_ok());
+                accepted = std::move(res.value());
+            });
+            REQUIRE(client.connect({"127.0.0.1", dial_port}).is_ok());
+            accept_thread.join();
+        }
+
+        netpipe::ReliableUdpStream &server() { return static_cast<netpipe::ReliableUdpStream &>(*accepted); }
+
+        ~Pair() {
+            client.close();
+            accepted->close();
+            listener.close();
+        }
+    };
+
+    // Forwards datagrams between a client and a server, dropping every drop_every-th one in each direction
+    // Counts replies from any other port than the server's, which a NAT in its place would drop
+    struct LossyProxy {
+        dp::i32 front = -1; // Faces the client
+        dp::i32 back = -1;  // Faces the server
+        sockaddr_in server = {};
+        sockaddr_in client = {};
+        bool have_client = false;
+        dp::u32 drop_every;
+        std::atomic<bool> running{true};
+        std::atomic<dp::u64> dropped{0};
+        std::atomic<dp::u64> foreign{0};
+        std::thread thread;
+
+        LossyProxy(dp::u16 front_port, dp::u16 server_port, dp::u32 drop) : drop_every(drop) {
+            front = ::socket(AF_INET, SOCK_DGRAM, 0);
+            back = ::socket(AF_INET, SOCK_DGRAM, 0);
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(front_port);
+            REQUIRE(::bind(front, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+            server = addr;
+            server.sin_port = htons(server_port);
+            thread = std::thread([this]() { run(); });
+        }
+
+        ~LossyProxy() {
+            running = false;
+            thread.join();
+            ::close(front);
+            ::close(back);
+        }
+
+        void run() {
+            dp::u8 buffer[2048];
+            dp::u64 count[2] = {0, 0};
+            while (running) {
+                pollfd fds[2] = {{front, POLLIN, 0}, {back, POLLIN, 0}};
+                if (::poll(fds, 2, 20) <= 0) {
+                    continue;
+                }
+                for (int side = 0; side < 2; side++) {
+                    if (!(fds[side].revents & POLLIN)) {
+                        continue;
+                    }
+                    sockaddr_in source = {};
+                    socklen_t length = sizeof(source);
+                    auto n = ::recvfrom(fds[side].fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&source),
+                                        &length);
+                    if (n < 0) {
+                        continue;
+                    }
+                    if (side == 0) {
+                        client = source;
+                        have_client = true;
+                    } else if (source.sin_port != server.sin_port) {
+                        foreign++;
+                        continue;
+                    }
+                    if (++count[side] % drop_every == 0) {
+                        dropped++;
+                        continue;
+                    }
+                    if (side == 0) {
+                        ::sendto(back, buffer, n, 0, reinterpret_cast<sockaddr *>(&server), sizeof(server));
+                    } else if (have_client) {
+                        ::sendto(front, buffer, n, 0, reinterpret_cast<sockaddr *>(&client), sizeof(client));
+                    }
+                }
+            }
+        }
+    };
+} // namespace
+
+TEST_CASE("ReliableUdpStream - Channels and delivery modes") {
+    Pair pair(20034, 20034);
+    auto &server = pair.server();
+    REQUIRE(server.set_recv_timeout(5000).is_ok());
+    CHECK(pair.client.is_connected());
+    CHECK(server.is_connected());
+
+    SUBCASE("Reliable messages are fragmented and come back whole, with their channel") {
+        auto big = pattern(100 * 1024, 1);
+        REQUIRE(pair.client.send(netpipe::Message{1, 2, 3}).is_ok());
+        REQUIRE(pair.client.send_on(3, big).is_ok());
+        REQUIRE(pair.client.send_on(3, netpipe::Message{}).is_ok());
+
+        auto first = server.recv();
+        REQUIRE(first.is_ok());
+        CHECK(first.value() == netpipe::Message{1, 2, 3});
+        netpipe::Message msg;
+        auto channel = server.recv_channel(msg);
+        REQUIRE(channel.is_ok());
+        CHECK(channel.value() == 3);
+        CHECK(msg == big);
+        REQUIRE(server.recv_channel(msg).is_ok());
+        CHECK(msg.empty());
+
+        REQUIRE(pair.client.flush(2000).is_ok());
+        CHECK(pair.client.in_flight() == 0);
+        CHECK(pair.client.srtt_ms() > 0.0);
+    }
+
+    SUBCASE("Sequenced messages are limited to one packet") {
+        netpipe::Message state(netpipe::ReliableUdpStream::MAX_PAYLOAD, 7);
+        REQUIRE(pair.client.send_on(1, state, netpipe::Delivery::Sequenced).is_ok());
+        netpipe::Message msg;
+        auto channel = server.recv_channel(msg);
+        REQUIRE(channel.is_ok());
+        CHECK(channel.value() == 1);
+        CHECK(msg == state);
+
+        state.push_back(0);
+        CHECK(pair.client.send_on(1, state, netpipe::Delivery::Sequenced).is_err());
+        CHECK(pair.client.send_on(netpipe::ReliableUdpStream::MAX_CHANNELS, msg).is_err());
+    }
+
+    SUBCASE("Close reaches the peer after queued messages") {
+        REQUIRE(pair.client.send(netpipe::Message{9}).is_ok());
+        pair.client.close();
+        auto msg = server.recv();
+        REQUIRE(msg.is_ok());
+        CHECK(msg.value() == netpipe::Message{9});
+        auto after = server.recv();
+        REQUIRE(after.is_err());
+        CHECK(after.error().code != dp::Error::TIMEOUT);
+        CHECK_FALSE(server.is_connected());
+    }
+}
+
+TEST_CASE("ReliableUdpStream - Recovers from packet loss") {
+    netpipe::ReliableUdpConfig config;
+    config.initial_rto_ms = 30;
+    config.min_rto_ms = 10;
+    LossyProxy proxy(20035, 20036, 4); // A quarter of all packets, handshake and acks included
+    Pair pair(20036, 20035, config);
+    auto &server = pair.server();
+    REQUIRE(server.set_recv_timeout(5000).is_ok());
+
+    // Every channel stays in order on its own
+    constexpr int COUNT = 200;
+    std::thread sender([&]() {
+        for (int i = 0; i < COUNT; i++) {
+            netpipe::Message msg = pattern(i % 5 == 0 ? 3000 : 40, static_cast<dp::u8>(i));
+            msg[0] = static_cast<dp::u8>(i);
+            REQUIRE(pair.client.send_on(static_cast<dp::u8>(i % 2), msg).is_ok());
+        }
+    });
+
+    int next[2] = {0, 1};
+    netpipe::Message msg;
+    for (int i = 0; i < COUNT; i++) {
+        auto channel = server.recv_channel(msg);
+        REQUIRE(channel.is_ok());
+        int expected = next[channel.value()];
+        next[channel.value()] += 2;
+        netpipe::Message want = pattern(expected % 5 == 0 ? 3000 : 40, static_cast<dp::u8>(expected));
+        want[0] = static_cast<dp::u8>(expected);
+        CHECK(msg == want);
+    }
+    sender.join();
+    CHECK(next[0] == COUNT);
+    CHECK(next[1] == COUNT + 1);
+    CHECK(proxy.dropped > 0);
+    CHECK(proxy.foreign == 0);
+    CHECK(pair.client.retransmit_count() > 0);
+
+    // Remote<Bidirect> runs unchanged on top of it
+    netpipe::Remote<netpipe::Bidirect> remote_server(server);
+    netpipe::Remote<netpipe::Bidirect> remote_client(pair.client);
+    remote_server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+        netpipe::Message out(req);
+        out.push_back(0xAB);
+        return dp::result::ok(out);
+    });
+    for (dp::usize size : {dp::usize(8), dp::usize(20000)}) {
+        auto request = pattern(size, 5);
+        auto res = remote_client.call(1, request, 10000);
+        REQUIRE(res.is_ok());
+        request.push_back(0xAB);
+        CHECK(res.value() == request);
+    }
+}
+
+TEST_CASE("ReliableUdpStream - A reader that falls behind holds the sender back") {
+    netpipe::ReliableUdpConfig config;
+    config.initial_rto_ms = 30;
+    config.min_rto_ms = 10;
+    config.max_retransmits = 3; // Probes of a full receiver must not use these up
+    config.window = 8;
+    config.recv_buffer = 20000;
+    Pair pair(20082, 20082, config);
+    auto &server = pair.server();
+
+    const int count = 100;
+    std::atomic<int> sent{0};
+    std::thread sender([&]() {
+        for (int i = 0; i < count; i++) {
+            REQUIRE(pair.client.send(pattern(1000, static_cast<dp::u8>(i))).is_ok());
+            sent++;
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    CHECK(sent < count);
+    CHECK(sent <= 20 + 8 + 1); // The receive buffer, the send window and the send in progress
+    CHECK(pair.client.is_connected());
+
+    REQUIRE(server.set_recv_timeout(5000).is_ok());
+    for (int i = 0; i < count; i++) {
+        auto msg = server.recv();
+        REQUIRE(msg.is_ok());
+        CHECK(msg.value() == pattern(1000, static_cast<dp::u8>(i)));
+    }
+    sender.join();
+    CHECK(pair.client.flush(2000).is_ok());
+}
+
+TEST_CASE("ReliableUdpStream - Connect without a listener times out") {
+    netpipe::ReliableUdpConfig config;
+    config.connect_timeout_ms = 300;
+    netpipe::ReliableUdpStream client(config);
+    auto res = client.connect({"127.0.0.1", 20037});
+    REQUIRE(res.is_err());
+    CHECK(res.error().code == dp::Error::TIMEOUT);
+    CHECK_FALSE(client.is_connected());
+}
+
+TEST_CASE("ReliableUdpStream - Accepted connections share the listening port") {
+    netpipe::ReliableUdpConfig config;
+    config.max_message_size = 2000;
+    netpipe::ReliableUdpStream listener(config);
+    REQUIRE(listener.listen({"127.0.0.1", 20077}).is_ok());
+    std::vector<std::unique_ptr<netpipe::Stream>> accepted;
+    std::thread accept_thread([&]() {
+        for (int i = 0; i < 2; i++) {
+            auto res = listener.accept();
+            REQUIRE(res.is_ok());
+            accepted.push_back(std::move(res.value()));
+        }
+    });
+    netpipe::ReliableUdpStream first;
+    netpipe::ReliableUdpStream second;
+    REQUIRE(first.connect({"127.0.0.1", 20077}).is_ok());
+    REQUIRE(second.connect({"127.0.0.1", 20077}).is_ok());
+    accept_thread.join();
+    listener.close(); // Accepted connections keep the socket open
+
+    // Each client reaches its own connection
+    REQUIRE(first.send(netpipe::Message{1}).is_ok());
+    REQUIRE(second.send(netpipe::Message{2}).is_ok());
+    for (auto &conn : accepted) {
+        REQUIRE(conn->set_recv_timeout(2000).is_ok());
+        auto msg = conn->recv();
+        REQUIRE(msg.is_ok());
+        REQUIRE(msg.value().size() == 1);
+        REQUIRE(conn->send(netpipe::Message{static_cast<dp::u8>(msg.value()[0] + 10)}).is_ok());
+    }
+    REQUIRE(first.set_recv_timeout(2000).is_ok());
+    REQUIRE(second.set_recv_timeout(2000).is_ok());
+    auto reply = first.recv();
+    REQUIRE(reply.is_ok());
+    CHECK(reply.value() == netpipe::Message{11});
+    reply = second.recv();
+    REQUIRE(reply.is_ok());
+    CHECK(reply.value() == netpipe::Message{12});
+
+    // An oversized message is dropped whole: none of its fragments turn up as a message of their own
+    auto &conn = *accepted[0]; // first's, accepted before second dialled
+    REQUIRE(first.send(pattern(3000, 3)).is_ok());
+    REQUIRE(first.send(netpipe::Message{4}).is_ok());
+    auto after = conn.recv();
+    REQUIRE(after.is_ok());
+    CHECK(after.value() == netpipe::Message{4});
+
+    first.close();
+    second.close();
+    for (auto &c : accepted) {
+        c->close();
+    }
+}
@@ -0,0 +1,131 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+
+TEST_CASE("Resolver - Cached lookups") {
+    auto &resolver = netpipe::Resolver::instance();
+    resolver.clear();
+
+    SUBCASE("Numeric addresses skip getaddrinfo") {
+        dp::u64 lookups = resolver.lookups();
+        auto v4 = resolver.resolve("127.0.0.1", 80);
+        REQUIRE(v4.is_ok());
+        REQUIRE(v4.value().size() == 1);
+        CHECK(v4.value()[0].family() == AF_INET);
+        CHECK(v4.value()[0].to_string() == "127.0.0.1:80");
+
+        auto v6 = resolver.resolve("::1", 443);
+        REQUIRE(v6.is_ok());
+        CHECK(v6.value()[0].family() == AF_INET6);
+        CHECK(v6.value()[0].to_string() == "[::1]:443");
+        CHECK(resolver.lookups() == lookups);
+        CHECK(netpipe::Resolver::parse_numeric("localhost", 1).is_err());
+    }
+
+    SUBCASE("Names are looked up once per ttl") {
+        auto first = resolver.resolve("localhost", 1000);
+        REQUIRE(first.is_ok());
+        dp::u64 lookups = resolver.lookups();
+        auto second = resolver.resolve("localhost", 2000);
+        REQUIRE(second.is_ok());
+        CHECK(resolver.lookups() == lookups);
+        CHECK(resolver.hits() >= 1);
+        CHECK(second.value().size() == first.value().size());
+        CHECK(std::string(second.value()[0].to_string().c_str()).ends_with(":2000")); // Port applied per call
+
+        // Failures are cached too, for the negative ttl
+        CHECK(resolver.resolve("nonexistent.invalid", 1).is_err());
+        lookups = resolver.lookups();
+        CHECK(resolver.resolve("nonexistent.invalid", 1).is_err());
+        CHECK(resolver.lookups() == lookups);
+
+        resolver.clear();
+        REQUIRE(resolver.resolve("localhost", 1000).is_ok());
+        CHECK(resolver.lookups() == lookups + 1);
+    }
+}
+
+TEST_CASE("TcpStream - Connect timeout and IPv6") {
+    SUBCASE("Unanswered SYN times out") {
+        // A listener with a full accept queue drops further SYNs, like an unreachable host
+        dp::i32 listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(listener >= 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(20032);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        dp::i32 one = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        REQUIRE(::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+        REQUIRE(::listen(listener, 0) == 0);
+
+        dp::Vector<std::unique_ptr<netpipe::TcpStream>> fillers;
+        bool timed_out = false;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 8 && !timed_out; i++) {
+            auto stream = std::make_unique<netpipe::TcpStream>();
+            stream->set_connect_timeout(300);
+            auto res = stream->connect({"127.0.0.1", 20032});
+            if (res.is_err()) {
+                CHECK(res.error().code == dp::Error::TIMEOUT);
+                timed_out = true;
+            }
+            fillers.push_back(std::move(stream));
+        }
+        CHECK(timed_out);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        ::close(listener);
+    }
+
+    SUBCASE("Several answering addresses make one connection") {
+        auto addresses = netpipe::Resolver::instance().resolve("localhost", 20079);
+        REQUIRE(addresses.is_ok());
+        netpipe::TcpStream v4;
+        netpipe::TcpStream v6;
+        if (addresses.value().size() < 2 || v4.listen({"127.0.0.1", 20079}).is_err() ||
+            v6.listen({"::1", 20079}).is_err()) {
+            MESSAGE("localhost has a single loopback address, skipping");
+            return;
+        }
+
+        // The first address answers within the attempt delay, so the second is never dialed
+        netpipe::TcpStream client;
+        REQUIRE(client.connect({"localhost", 20079}).is_ok());
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * netpipe::TcpStream::CONNECT_ATTEMPT_DELAY_MS));
+        int pending = 0;
+        for (auto *listener : {&v4, &v6}) {
+            pollfd pfd{listener->native_handle(), POLLIN, 0};
+            pending += ::poll(&pfd, 1, 0) > 0 ? 1 : 0;
+        }
+        CHECK(pending == 1);
+    }
+
+    SUBCASE("Listen and connect over IPv6 loopback") {
+        netpipe::TcpStream server;
+        if (server.listen({"::1", 20033}).is_err()) {
+            MESSAGE("IPv6 loopback unavailable, skipping");
+            return;
+        }
+        std::unique_ptr<netpipe::Stream> accepted;
+        std::thread accept_thread([&]() {
+            auto res = server.accept();
+            REQUIRE(res.is_ok());
+            accepted = std::move(res.value());
+        });
+
+        netpipe::TcpStream client;
+        REQUIRE(client.connect({"::1", 20033}).is_ok());
+        accept_thread.join();
+        REQUIRE(client.send(netpipe::Message{6, 6}).is_ok());
+        auto msg = accepted->recv();
+        REQUIRE(msg.is_ok());
+        CHECK(msg.value() == netpipe::Message{6, 6});
+
+        client.close();
+        accepted->close();
+        server.close();
+    }
+}
@@ -0,0 +1,164 @@
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+
+namespace {
+    struct Pose {
+        double x = 0;
+        double y = 0;
+        float heading = 0;
+
+        auto members() { return std::tie(x, y, heading); }
+    };
+
+    struct Waypoint {
+        dp::String name;
+        Pose pose;
+        std::optional<dp::u32> dwell_ms;
+
+        auto members() { return std::tie(name, pose, dwell_ms); }
+    };
+
+    struct Route {
+        dp::u64 id = 0;
+        bool closed = false;
+        dp::Vector<Waypoint> waypoints;
+        dp::Vector<dp::i32> costs;
+        std::variant<dp::u32, dp::String> owner;
+
+        auto members() { return std::tie(id, closed, waypoints, costs, owner); }
+    };
+
+    struct Blob {
+        dp::u32 tag = 0;
+        std::string_view text;
+        std::span<const dp::u8> bytes;
+
+        auto members() { return std::tie(tag, text, bytes); }
+    };
+
+    Route sample_route() {
+        Route route;
+        route.id = 0x1122334455667788ull;
+        route.closed = true;
+        route.waypoints.push_back(Waypoint{dp::String("dock"), Pose{1.5, -2.0, 0.25f}, std::nullopt});
+        route.waypoints.push_back(Waypoint{dp::String("charger"), Pose{10.0, 4.0, 3.0f}, 1500u});
+        route.costs = {3, -1, 42};
+        route.owner = dp::String("fleet-a");
+        return route;
+    }
+} // namespace
+
+TEST_CASE("Serializer - Reflected structs") {
+    SUBCASE("Flat struct is its fields back to back") {
+        Pose pose{1.0, 2.0, 3.0f};
+        auto msg = netpipe::remote::Serializer<Pose>::serialize(pose);
+        CHECK(msg.size() == 2 * sizeof(double) + sizeof(float));
+        auto res = netpipe::remote::Serializer<Pose>::deserialize(msg);
+        REQUIRE(res.is_ok());
+        CHECK(res.value().x == 1.0);
+        CHECK(res.value().y == 2.0);
+        CHECK(res.value().heading == 3.0f);
+    }
+
+    SUBCASE("Nested containers, optionals and variants") {
+        Route route = sample_route();
+        auto msg = netpipe::remote::Serializer<Route>::serialize(route);
+        CHECK(msg.size() == netpipe::remote::wire::size_of(route));
+
+        auto res = netpipe::remote::Serializer<Route>::deserialize(msg);
+        REQUIRE(res.is_ok());
+        const Route &out = res.value();
+        CHECK(out.id == route.id);
+        CHECK(out.closed);
+        REQUIRE(out.waypoints.size() == 2);
+        CHECK(std::string(out.waypoints[0].name.c_str()) == "dock");
+        CHECK(out.waypoints[0].pose.y == -2.0);
+        CHECK_FALSE(out.waypoints[0].dwell_ms.has_value());
+        CHECK(std::string(out.waypoints[1].name.c_str()) == "charger");
+        REQUIRE(out.waypoints[1].dwell_ms.has_value());
+        CHECK(*out.waypoints[1].dwell_ms == 1500);
+        CHECK(out.costs == route.costs);
+        REQUIRE(std::holds_alternative<dp::String>(out.owner));
+        CHECK(std::string(std::get<dp::String>(out.owner).c_str()) == "fleet-a");
+    }
+
+    SUBCASE("Views point into the received buffer") {
+        const dp::u8 raw[] = {9, 8, 7};
+        Blob blob{5, "telemetry", std::span<const dp::u8>(raw, 3)};
+        auto msg = netpipe::remote::Serializer<Blob>::serialize(blob);
+        auto res = netpipe::remote::Serializer<Blob>::deserialize(msg);
+        REQUIRE(res.is_ok());
+        CHECK(res.value().tag == 5);
+        CHECK(res.value().text == "telemetry");
+        CHECK(reinterpret_cast<const dp::u8 *>(res.value().text.data()) == msg.data() + 8);
+        REQUIRE(res.value().bytes.size() == 3);
+        CHECK(res.value().bytes[2] == 7);
+        CHECK(res.value().bytes.data() == msg.data() + 8 + 9 + 4);
+    }
+
+    SUBCASE("Truncated, padded and malformed input is rejected") {
+        auto msg = netpipe::remote::Serializer<Route>::serialize(sample_route());
+        for (dp::usize cut : {dp::usize{0}, dp::usize{5}, msg.size() / 2, msg.size() - 1}) {
+            netpipe::Message truncated(msg.begin(), msg.begin() + cut);
+            CHECK(netpipe::remote::Serializer<Route>::deserialize(truncated).is_err());
+        }
+        netpipe::Message padded(msg);
+        padded.push_back(0);
+        CHECK(netpipe::remote::Serializer<Route>::deserialize(padded).is_err());
+
+        // Element count far larger than the bytes that follow
+        netpipe::Message huge_count{0xFF, 0xFF, 0xFF, 0x7F, 1, 2, 3};
+        CHECK(netpipe::remote::Serializer<dp::Vector<Waypoint>>::deserialize(huge_count).is_err());
+
+        netpipe::Message bad_variant = netpipe::remote::Serializer<std::variant<dp::u8, bool>>::serialize(true);
+        bad_variant[0] = 5;
+        CHECK(netpipe::remote::Serializer<std::variant<dp::u8, bool>>::deserialize(bad_variant).is_err());
+    }
+}
+
+TEST_CASE("TypedRemote - Struct request and response") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20023};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        auto typed_server = netpipe::remote::make_typed(server);
+        REQUIRE(typed_server
+                    .register_method<Route, dp::Vector<Pose>>(
+                        1, [](const Route &route) -> dp::Res<dp::Vector<Pose>> {
+                            dp::Vector<Pose> poses;
+                            for (const auto &wp : route.waypoints) {
+                                poses.push_back(wp.pose);
+                            }
+                            return dp::result::ok(poses);
+                        })
+                    .is_ok());
+
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        auto typed = netpipe::remote::make_typed(remote);
+        auto res = typed.call<dp::Vector<Pose>>(1, sample_route(), 2000);
+        REQUIRE(res.is_ok());
+        REQUIRE(res.value().size() == 2);
+        CHECK(res.value()[1].x == 10.0);
+        CHECK(res.value()[1].heading == 3.0f);
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <chrono>
 #include <doctest/doctest.h>
 #include <netpipe/stream/shm.hpp>
+#include <sys/wait.h>
 #include <thread>
+#include <unistd.h>
+#include <vector>
 
 TEST_CASE("ShmStream - Basic connection") {
     SUBCASE("Listen and accept pattern") {
@@ -131,7 +135,7 @@ TEST_CASE("ShmStream - Message exchange") {
         listener.close();
     }
 
-    SUBCASE("Send message larger than buffer fails") {
+    SUBCASE("Message larger than buffer streams in chunks") {
         netpipe::ShmStream listener;
         netpipe::ShmEndpoint endpoint{"netpipe_test_shm_4", 1024}; // Small buffer
 
@@ -145,10 +149,10 @@ TEST_CASE("ShmStream - Message exchange") {
             REQUIRE(accept_res.is_ok());
             server_conn = std::move(accept_res.value());
 
-            // Try to send message larger than buffer
-            netpipe::Message msg(2000);
+            // Larger than the buffer: goes out as chunks the receiver reassembles
+            netpipe::Message msg(2000, 0x5A);
             auto send_res = server_conn->send(msg);
-            CHECK(send_res.is_err());
+            CHECK(send_res.is_ok());
         });
 
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -156,6 +160,11 @@ TEST_CASE("ShmStream - Message exchange") {
         netpipe::ShmStream client;
         auto connect_res = client.connect_shm(endpoint);
         REQUIRE(connect_res.is_ok());
+        client.set_recv_timeout(2000);
+
+        auto recv_res = client.recv();
+        REQUIRE(recv_res.is_ok());
+        CHECK(recv_res.value() == netpipe::Message(2000, 0x5A));
 
         server_thread.join();
 
@@ -182,7 +191,6 @@ TEST_CASE("ShmStream - Multiple messages") {
             server_conn = std::move(accept_res.value());
 
             // Send multiple messages - wait for client to receive each one
-            // SHM only holds one message at a time
             for (int i = 0; i < 3; i++) {
                 netpipe::Message msg = {static_cast<dp::u8>(i), static_cast<dp::u8>(i + 1)};
                 auto send_res = server_conn->send(msg);
@@ -219,6 +227,317 @@ TEST_CASE("ShmStream - Multiple messages") {
     }
 }
 
+TEST_CASE("ShmStream - Queued messages") {
+    SUBCASE("Producer runs ahead of consumer") {
+        netpipe::ShmStream listener;
+        netpipe::ShmEndpoint endpoint{"netpipe_test_shm_queue", 16384};
+
+        auto listen_res = listener.listen_shm(endpoint);
+        REQUIRE(listen_res.is_ok());
+
+        std::unique_ptr<netpipe::Stream> server_conn;
+
+        std::thread server_thread([&]() {
+            auto accept_res = listener.accept();
+            REQUIRE(accept_res.is_ok());
+            server_conn = std::move(accept_res.value());
+
+            // Ring holds many small records - none of these sends should wait for the reader
+            for (int i = 0; i < 100; i++) {
+                netpipe::Message msg = {static_cast<dp::u8>(i), static_cast<dp::u8>(i * 2)};
+                auto send_res = server_conn->send(msg);
+                CHECK(send_res.is_ok());
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        netpipe::ShmStream client;
+        auto connect_res = client.connect_shm(endpoint);
+        REQUIRE(connect_res.is_ok());
+
+        server_thread.join();
+
+        for (int i = 0; i < 100; i++) {
+            auto recv_res = client.recv();
+            REQUIRE(recv_res.is_ok());
+            auto received = std::move(recv_res.value());
+            REQUIRE(received.size() == 2);
+            CHECK(received[0] == static_cast<dp::u8>(i));
+            CHECK(received[1] == static_cast<dp::u8>(i * 2));
+        }
+
+        client.close();
+        server_conn->close();
+        listener.close();
+    }
+
+    SUBCASE("Records wrap around the ring") {
+        netpipe::ShmStream listener;
+        netpipe::ShmEndpoint endpoint{"netpipe_test_shm_wrap", 4096};
+
+        auto listen_res = listener.listen_shm(endpoint);
+        REQUIRE(listen_res.is_ok());
+
+        std::unique_ptr<netpipe::Stream> server_conn;
+        constexpr int COUNT = 2000;
+
+        std::thread accept_thread([&]() {
+            auto accept_res = listener.accept();
+            REQUIRE(accept_res.is_ok());
+            server_conn = std::move(accept_res.value());
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        netpipe::ShmStream client;
+        auto connect_res = client.connect_shm(endpoint);
+        REQUIRE(connect_res.is_ok());
+        accept_thread.join();
+
+        // Odd sizes up to the full capacity force records to straddle the end of the ring
+        std::thread producer([&]() {
+            for (int i = 0; i < COUNT; i++) {
+                dp::usize size = (static_cast<dp::usize>(i) * 397) % 4097;
+                netpipe::Message msg(size);
+                for (dp::usize j = 0; j < size; j++) {
+                    msg[j] = static_cast<dp::u8>((i + j) & 0xFF);
+                }
+                auto send_res = server_conn->send(msg);
+                CHECK(send_res.is_ok());
+            }
+        });
+
+        bool all_ok = true;
+        for (int i = 0; i < COUNT; i++) {
+            auto recv_res = client.recv();
+            REQUIRE(recv_res.is_ok());
+            auto received = std::move(recv_res.value());
+            dp::usize size = (static_cast<dp::usize>(i) * 397) % 4097;
+            if (received.size() != size) {
+                all_ok = false;
+                break;
+            }
+            for (dp::usize j = 0; j < size; j++) {
+                if (received[j] != static_cast<dp::u8>((i + j) & 0xFF)) {
+                    all_ok = false;
+                    break;
+                }
+            }
+        }
+        CHECK(all_ok);
+
+        producer.join();
+
+        client.close();
+        server_conn->close();
+        listener.close();
+    }
+}
+
+static void exercise_wait_strategy(const char *name, netpipe::ShmWaitStrategy strategy) {
+    netpipe::ShmStream listener;
+    netpipe::ShmEndpoint endpoint{name, 8192, strategy};
+
+    auto listen_res = listener.listen_shm(endpoint);
+    REQUIRE(listen_res.is_ok());
+
+    std::unique_ptr<netpipe::Stream> server_conn;
+
+    std::thread server_thread([&]() {
+        auto accept_res = listener.accept();
+        REQUIRE(accept_res.is_ok());
+        server_conn = std::move(accept_res.value());
+
+        // Echo back everything - each round trip exercises the wait/wake path on both sides
+        for (int i = 0; i < 200; i++) {
+            auto recv_res = server_conn->recv();
+            REQUIRE(recv_res.is_ok());
+            CHECK(server_conn->send(recv_res.value()).is_ok());
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    netpipe::ShmStream client;
+    auto connect_res = client.connect_shm(endpoint);
+    REQUIRE(connect_res.is_ok());
+    CHECK(client.wait_strategy() == strategy);
+    REQUIRE(client.set_recv_timeout(2000).is_ok());
+
+    for (int i = 0; i < 200; i++) {
+        netpipe::Message msg = {static_cast<dp::u8>(i), 0x42};
+        REQUIRE(client.send(msg).is_ok());
+        auto recv_res = client.recv();
+        REQUIRE(recv_res.is_ok());
+        auto received = std::move(recv_res.value());
+        REQUIRE(received.size() == 2);
+        CHECK(received[0] == static_cast<dp::u8>(i));
+    }
+
+    server_thread.join();
+
+    // Timeouts must still be honoured while parked
+    REQUIRE(client.set_recv_timeout(100).is_ok());
+    auto start = std::chrono::steady_clock::now();
+    auto recv_res = client.recv();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    CHECK(recv_res.is_err());
+    CHECK(elapsed.count() >= 90);
+    CHECK(elapsed.count() < 1000);
+
+    client.close();
+    server_conn->close();
+    listener.close();
+}
+
+TEST_CASE("ShmStream - Wait strategies") {
+    SUBCASE("Busy spin") { exercise_wait_strategy("netpipe_test_shm_wait_spin", netpipe::ShmWaitStrategy::BusySpin); }
+
+    SUBCASE("Spin then futex") {
+        exercise_wait_strategy("netpipe_test_shm_wait_futex", netpipe::ShmWaitStrategy::SpinThenFutex);
+    }
+
+    SUBCASE("Sleep backoff") {
+        exercise_wait_strategy("netpipe_test_shm_wait_sleep", netpipe::ShmWaitStrategy::Sleep);
+    }
+}
+
+TEST_CASE("ShmStream - Zero-copy loan and view") {
+    netpipe::ShmStream listener;
+    netpipe::ShmEndpoint endpoint{"netpipe_test_shm_loan", 4096};
+
+    auto listen_res = listener.listen_shm(endpoint);
+    REQUIRE(listen_res.is_ok());
+
+    std::unique_ptr<netpipe::Stream> server_conn;
+
+    std::thread accept_thread([&]() {
+        auto accept_res = listener.accept();
+        REQUIRE(accept_res.is_ok());
+        server_conn = std::move(accept_res.value());
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    netpipe::ShmStream client;
+    auto connect_res = client.connect_shm(endpoint);
+    REQUIRE(connect_res.is_ok());
+    accept_thread.join();
+
+    auto *server = dynamic_cast<netpipe::ShmStream *>(server_conn.get());
+    REQUIRE(server != nullptr);
+
+    SUBCASE("Loaned span is delivered on commit") {
+        auto loan_res = client.loan(64);
+        REQUIRE(loan_res.is_ok());
+        auto span = loan_res.value();
+        REQUIRE(span.size() == 64);
+        for (dp::usize i = 0; i < 10; i++) {
+            span[i] = static_cast<dp::u8>(i + 1);
+        }
+
+        // Commit fewer bytes than loaned
+        auto commit_res = client.commit(10);
+        REQUIRE(commit_res.is_ok());
+
+        auto recv_res = server->recv();
+        REQUIRE(recv_res.is_ok());
+        auto received = std::move(recv_res.value());
+        REQUIRE(received.size() == 10);
+        for (dp::usize i = 0; i < 10; i++) {
+            CHECK(received[i] == static_cast<dp::u8>(i + 1));
+        }
+    }
+
+    SUBCASE("Loan misuse is rejected") {
+        CHECK(client.commit().is_err());
+        CHECK(client.loan(8192).is_err());
+
+        auto loan_res = client.loan(16);
+        REQUIRE(loan_res.is_ok());
+        CHECK(client.commit(17).is_err());
+        CHECK(client.send(netpipe::Message{1, 2, 3}).is_err());
+        client.cancel_loan();
+
+        // Stream is usable again once the loan is dropped
+        CHECK(client.send(netpipe::Message{1, 2, 3}).is_ok());
+        auto recv_res = server->recv();
+        REQUIRE(recv_res.is_ok());
+        CHECK(recv_res.value().size() == 3);
+    }
+
+    SUBCASE("View stays valid until release") {
+        netpipe::Message first = {10, 20, 30};
+        netpipe::Message second = {40, 50};
+        REQUIRE(server->send(first).is_ok());
+        REQUIRE(server->send(second).is_ok());
+
+        auto view_res = client.recv_view();
+        REQUIRE(view_res.is_ok());
+        auto view = view_res.value();
+        REQUIRE(view.size() == 3);
+        CHECK(view[0] == 10);
+        CHECK(view[2] == 30);
+
+        // Only one view may be outstanding
+        CHECK(client.recv_view().is_err());
+        CHECK(client.recv().is_err());
+
+        client.release();
+
+        auto recv_res = client.recv();
+        REQUIRE(recv_res.is_ok());
+        auto received = std::move(recv_res.value());
+        REQUIRE(received.size() == 2);
+        CHECK(received[0] == 40);
+        CHECK(received[1] == 50);
+    }
+
+    SUBCASE("Scatter/gather send lands as one record") {
+        dp::u8 header[] = {0xAA, 0xBB};
+        netpipe::Message body = {1, 2, 3, 4};
+        iovec parts[2] = {{header, sizeof(header)}, {body.data(), body.size()}};
+        REQUIRE(client.send_iov(std::span<const iovec>(parts, 2)).is_ok());
+
+        auto recv_res = server->recv();
+        REQUIRE(recv_res.is_ok());
+        auto received = std::move(recv_res.value());
+        REQUIRE(received.size() == 6);
+        CHECK(received[0] == 0xAA);
+        CHECK(received[1] == 0xBB);
+        CHECK(received[5] == 4);
+    }
+
+    SUBCASE("Loan and view round trip through the ring") {
+        for (int i = 0; i < 500; i++) {
+            dp::usize size = (static_cast<dp::usize>(i) * 131) % 2048;
+            auto loan_res = server->loan(size);
+            REQUIRE(loan_res.is_ok());
+            auto span = loan_res.value();
+            for (dp::usize j = 0; j < size; j++) {
+                span[j] = static_cast<dp::u8>((i + j) & 0xFF);
+            }
+            REQUIRE(server->commit().is_ok());
+
+            auto view_res = client.recv_view();
+            REQUIRE(view_res.is_ok());
+            auto view = view_res.value();
+            REQUIRE(view.size() == size);
+            bool match = true;
+            for (dp::usize j = 0; j < size; j++) {
+                match = match && view[j] == static_cast<dp::u8>((i + j) & 0xFF);
+            }
+            CHECK(match);
+            client.release();
+        }
+    }
+
+    client.close();
+    server_conn->close();
+    listener.close();
+}
+
 TEST_CASE("ShmStream - Error conditions") {
     SUBCASE("Send without connection fails") {
         netpipe::ShmStream stream;
@@ -450,3 +769,180 @@ TEST_CASE("ShmStream - Multiple connections") {
         listener.close();
     }
 }
+
+TEST_CASE("ShmStream - Region options") {
+    SUBCASE("Huge pages, prefault, mlock and NUMA binding") {
+        netpipe::ShmStream listener;
+        netpipe::ShmEndpoint endpoint{"netpipe_test_shm_region", 3 * 1024 * 1024};
+        endpoint.region.huge_pages = true;
+        endpoint.region.prefault = true;
+        endpoint.region.lock = true;
+        endpoint.region.numa_node = 0;
+        REQUIRE(listener.listen_shm(endpoint).is_ok());
+
+        std::unique_ptr<netpipe::Stream> server_conn;
+        std::thread accept_thread([&]() {
+            auto accept_res = listener.accept();
+            REQUIRE(accept_res.is_ok());
+            server_conn = std::move(accept_res.value());
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        netpipe::ShmStream client;
+        REQUIRE(client.connect_shm(endpoint).is_ok());
+        accept_thread.join();
+
+        // Rings are rounded up to whole 2MB pages: a 3MB record needs two
+        struct stat st;
+        REQUIRE(::stat("/dev/shm/netpipe_test_shm_region_0_s2c", &st) == 0);
+        CHECK(static_cast<dp::usize>(st.st_size) == static_cast<dp::usize>(::sysconf(_SC_PAGESIZE)) + 4 * 1024 * 1024);
+
+        netpipe::Message big(endpoint.size);
+        for (dp::usize i = 0; i < big.size(); i++) {
+            big[i] = static_cast<dp::u8>(i * 13);
+        }
+        for (int round = 0; round < 3; round++) {
+            REQUIRE(client.send(big).is_ok());
+            auto res = server_conn->recv();
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == big);
+            REQUIRE(server_conn->send(netpipe::Message{static_cast<dp::u8>(round)}).is_ok());
+            auto reply = client.recv();
+            REQUIRE(reply.is_ok());
+            CHECK(reply.value()[0] == static_cast<dp::u8>(round));
+        }
+
+        client.close();
+        server_conn->close();
+        listener.close();
+    }
+}
+
+TEST_CASE("ShmStream - Connect burst") {
+    SUBCASE("Many clients connecting at once are all answered") {
+        netpipe::ShmStream listener;
+        netpipe::ShmEndpoint endpoint{"netpipe_test_shm_burst", 4096};
+        REQUIRE(listener.listen_shm(endpoint).is_ok());
+        REQUIRE(listener.set_recv_timeout(5000).is_ok());
+
+        const int clients = 48;
+        std::vector<std::unique_ptr<netpipe::Stream>> server_conns;
+        std::thread accept_thread([&]() {
+            for (int i = 0; i < clients; i++) {
+                auto accept_res = listener.accept();
+                REQUIRE(accept_res.is_ok());
+                server_conns.push_back(std::move(accept_res.value()));
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<netpipe::ShmStream> streams(clients);
+        std::vector<std::thread> threads;
+        std::atomic<int> connected{0};
+        for (int i = 0; i < clients; i++) {
+            threads.emplace_back([&, i]() {
+                REQUIRE(streams[i].connect_shm(endpoint).is_ok());
+                connected++;
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        accept_thread.join();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        CHECK(connected == clients);
+        CHECK(elapsed < std::chrono::seconds(2));
+
+        // Every client got its own connection
+        std::vector<dp::u64> ids;
+        for (auto &stream : streams) {
+            ids.push_back(stream.connection_id());
+        }
+        std::sort(ids.begin(), ids.end());
+        CHECK(std::unique(ids.begin(), ids.end()) == ids.end());
+
+        REQUIRE(streams[7].send(netpipe::Message{7}).is_ok());
+        bool delivered = false;
+        for (auto &conn : server_conns) {
+            auto *shm = static_cast<netpipe::ShmStream *>(conn.get());
+            if (shm->connection_id() == streams[7].connection_id()) {
+                auto res = conn->recv();
+                REQUIRE(res.is_ok());
+                delivered = res.value() == netpipe::Message{7};
+            }
+        }
+        CHECK(delivered);
+
+        for (auto &stream : streams) {
+            stream.close();
+        }
+        for (auto &conn : server_conns) {
+            conn->close();
+        }
+        listener.close();
+    }
+}
+
+TEST_CASE("ShmStream - Hang-up") {
+    SUBCASE("Close drains queued records, then reports the peer gone") {
+        netpipe::ShmStream listener;
+        netpipe::ShmEndpoint endpoint{"netpipe_test_shm_hangup", 8192};
+        REQUIRE(listener.listen_shm(endpoint).is_ok());
+        std::unique_ptr<netpipe::Stream> server_conn;
+        std::thread accept_thread([&]() {
+            auto accept_res = listener.accept();
+            REQUIRE(accept_res.is_ok());
+            server_conn = std::move(accept_res.value());
+        });
+        netpipe::ShmStream client;
+        REQUIRE(client.connect_shm(endpoint).is_ok());
+        accept_thread.join();
+
+        REQUIRE(client.send(netpipe::Message{1, 2, 3}).is_ok());
+        client.close();
+
+        auto res = server_conn->recv();
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{1, 2, 3});
+        res = server_conn->recv();
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::NOT_FOUND);
+        auto sent = server_conn->send(netpipe::Message{4});
+        REQUIRE(sent.is_err());
+        CHECK(sent.error().code == dp::Error::NOT_FOUND);
+        server_conn->close();
+        listener.close();
+    }
+
+    SUBCASE("A peer process that dies without closing is noticed") {
+        netpipe::ShmStream listener;
+        netpipe::ShmEndpoint endpoint{"netpipe_test_shm_crash", 8192};
+        REQUIRE(listener.listen_shm(endpoint).is_ok());
+        pid_t child = ::fork();
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            netpipe::ShmStream client;
+            if (client.connect_shm(endpoint).is_err() || client.send(netpipe::Message{9}).is_err()) {
+                ::_exit(1);
+            }
+            ::_exit(0); // No close(): only the kernel dropping the flock() tells the server
+        }
+        auto accept_res = listener.accept();
+        REQUIRE(accept_res.is_ok());
+        auto &server_conn = accept_res.value();
+        int status = 0;
+        REQUIRE(::waitpid(child, &status, 0) == child);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+
+        auto start = std::chrono::steady_clock::now();
+        auto res = server_conn->recv();
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == netpipe::Message{9});
+        res = server_conn->recv(); // Waits forever, but probes the peer every PEER_PROBE_MS
+        REQUIRE(res.is_err());
+        CHECK(res.error().code == dp::Error::NOT_FOUND);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(3));
+        server_conn->close();
+        listener.close();
+    }
+}
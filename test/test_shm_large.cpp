@@ -0,0 +1,102 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/stream/shm.hpp>
+#include <thread>
+
+namespace {
+    netpipe::Message pattern(dp::usize size, dp::u8 seed) {
+        netpipe::Message out(size);
+        for (dp::usize i = 0; i < size; i++) {
+            out[i] = static_cast<dp::u8>((i >> 3) * 7 + seed);
+        }
+        return out;
+    }
+} // namespace
+
+TEST_CASE("ShmStream - Messages larger than the ring") {
+    netpipe::ShmStream listener;
+    netpipe::ShmEndpoint endpoint{"netpipe_test_shm_large", 64 * 1024};
+    REQUIRE(listener.listen_shm(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto accept_res = listener.accept();
+        REQUIRE(accept_res.is_ok());
+        accepted = std::move(accept_res.value());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    netpipe::ShmStream client;
+    REQUIRE(client.connect_shm(endpoint).is_ok());
+    accept_thread.join();
+    auto &server = *static_cast<netpipe::ShmStream *>(accepted.get());
+    REQUIRE(server.set_recv_timeout(5000).is_ok());
+
+    SUBCASE("send and recv_into reassemble, small messages still pass") {
+        auto big = pattern(5 * 1024 * 1024 + 3, 1);
+        std::thread sender([&]() {
+            REQUIRE(client.send(netpipe::Message{1, 2, 3}).is_ok());
+            REQUIRE(client.send(big).is_ok());
+            REQUIRE(client.send(netpipe::Message{4}).is_ok());
+        });
+        auto small = server.recv();
+        REQUIRE(small.is_ok());
+        CHECK(small.value() == netpipe::Message{1, 2, 3});
+        netpipe::Message received;
+        REQUIRE(server.recv_into(received).is_ok());
+        CHECK(received == big);
+        auto last = server.recv();
+        REQUIRE(last.is_ok());
+        CHECK(last.value() == netpipe::Message{4});
+        sender.join();
+    }
+
+    SUBCASE("send_iov parts split across chunks, recv_split prefix") {
+        auto a = pattern(100 * 1024, 2);
+        auto b = pattern(7, 3);
+        auto c = pattern(300 * 1024, 4);
+        std::thread sender([&]() {
+            iovec parts[3] = {{a.data(), a.size()}, {b.data(), b.size()}, {c.data(), c.size()}};
+            REQUIRE(client.send_iov(std::span<const iovec>(parts, 3)).is_ok());
+        });
+        dp::u8 prefix[16];
+        netpipe::Message rest;
+        auto res = server.recv_split(prefix, sizeof(prefix), rest);
+        sender.join();
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == sizeof(prefix));
+        netpipe::Message whole(prefix, prefix + sizeof(prefix));
+        whole.insert(whole.end(), rest.begin(), rest.end());
+        netpipe::Message expected(a);
+        expected.insert(expected.end(), b.begin(), b.end());
+        expected.insert(expected.end(), c.begin(), c.end());
+        CHECK(whole == expected);
+    }
+
+    SUBCASE("recv_to writes into caller memory; views refuse large messages") {
+        auto big = pattern(1024 * 1024, 5);
+        std::thread sender([&]() {
+            REQUIRE(client.send(big).is_ok());
+            REQUIRE(client.send(big).is_ok());
+        });
+
+        // Too small: the message stays queued
+        netpipe::Message tiny(10);
+        CHECK(server.recv_to(std::span<dp::u8>(tiny.data(), tiny.size())).is_err());
+        CHECK(server.recv_view().is_err());
+
+        netpipe::Message target(2 * 1024 * 1024);
+        auto res = server.recv_to(std::span<dp::u8>(target.data(), target.size()));
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == big.size());
+        CHECK(netpipe::Message(target.begin(), target.begin() + big.size()) == big);
+
+        netpipe::Message again;
+        REQUIRE(server.recv_into(again).is_ok());
+        CHECK(again == big);
+        sender.join();
+    }
+
+    client.close();
+    server.close();
+    listener.close();
+}
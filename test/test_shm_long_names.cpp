@@ -28,7 +28,7 @@ TEST_CASE("ShmStream - Long name handling") {
     }
 
     SUBCASE("Name with 240 characters (at limit)") {
-        // With "/_connq" suffix (7 chars), max base name is 240 chars
+        // Longest base name listen_shm accepts; every derived object name still fits NAME_MAX
         std::string name_240(240, 'c');
         netpipe::ShmEndpoint endpoint{name_240.c_str(), 8192};
         netpipe::ShmStream stream;
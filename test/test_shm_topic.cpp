@@ -0,0 +1,123 @@
+#include <atomic>
+#include <doctest/doctest.h>
+#include <netpipe/stream/shm_topic.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+    // [index:4][filler derived from index]
+    netpipe::Message frame(dp::u32 index, dp::usize size) {
+        netpipe::Message out(size < 4 ? 4 : size);
+        std::memcpy(out.data(), &index, 4);
+        for (dp::usize i = 4; i < out.size(); i++) {
+            out[i] = static_cast<dp::u8>(index + i);
+        }
+        return out;
+    }
+
+    bool intact(const netpipe::Message &msg, dp::u32 &index) {
+        if (msg.size() < 4) {
+            return false;
+        }
+        std::memcpy(&index, msg.data(), 4);
+        for (dp::usize i = 4; i < msg.size(); i++) {
+            if (msg[i] != static_cast<dp::u8>(index + i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+TEST_CASE("ShmPublisher - Fan-out to many subscribers") {
+    netpipe::ShmEndpoint endpoint{"netpipe_test_topic_1", 4 * 1024 * 1024};
+    netpipe::ShmPublisher publisher;
+    REQUIRE(publisher.create(endpoint).is_ok());
+    CHECK(publisher.max_message_size() >= endpoint.size - sizeof(netpipe::ShmTopicRecord));
+
+    const int readers = 8;
+    const dp::u32 messages = 1000;
+    std::vector<std::unique_ptr<netpipe::ShmSubscriber>> subscribers;
+    for (int r = 0; r < readers; r++) {
+        subscribers.push_back(std::make_unique<netpipe::ShmSubscriber>());
+        REQUIRE(subscribers.back()->attach(endpoint).is_ok());
+        subscribers.back()->set_recv_timeout(5000);
+    }
+
+    std::atomic<int> complete{0};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r]() {
+            netpipe::Message msg;
+            for (dp::u32 i = 0; i < messages; i++) {
+                REQUIRE(subscribers[r]->recv_into(msg).is_ok());
+                dp::u32 index = 0;
+                REQUIRE(intact(msg, index));
+                REQUIRE(index == i);
+                CHECK(msg.size() == static_cast<dp::usize>(i % 1500 + 4));
+            }
+            CHECK(subscribers[r]->missed_count() == 0);
+            CHECK(subscribers[r]->lapped_count() == 0);
+            complete++;
+        });
+    }
+
+    for (dp::u32 i = 0; i < messages; i++) {
+        REQUIRE(publisher.publish(frame(i, i % 1500 + 4)).is_ok());
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    CHECK(complete == readers);
+    CHECK(publisher.published_count() == messages);
+
+    // A subscriber that joins late only sees what is published after it attached
+    netpipe::ShmSubscriber late;
+    REQUIRE(late.attach(endpoint).is_ok());
+    late.set_recv_timeout(50);
+    CHECK(late.recv().error().code == dp::Error::TIMEOUT);
+    REQUIRE(publisher.publish(frame(7, 16)).is_ok());
+    auto res = late.recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == frame(7, 16));
+}
+
+TEST_CASE("ShmSubscriber - Lapped reader skips ahead") {
+    netpipe::ShmEndpoint endpoint{"netpipe_test_topic_2", 8192};
+    netpipe::ShmPublisher publisher;
+    REQUIRE(publisher.create(endpoint).is_ok());
+    CHECK(publisher.publish(netpipe::Message(publisher.max_message_size() + 1)).is_err());
+
+    netpipe::ShmSubscriber subscriber;
+    REQUIRE(subscriber.attach(endpoint).is_ok());
+    subscriber.set_recv_timeout(100);
+
+    REQUIRE(publisher.publish(frame(0, 500)).is_ok());
+    auto first = subscriber.recv();
+    REQUIRE(first.is_ok());
+    CHECK(first.value() == frame(0, 500));
+
+    // Far more than the ring holds while the subscriber is not reading
+    for (dp::u32 i = 1; i <= 100; i++) {
+        REQUIRE(publisher.publish(frame(i, 500)).is_ok());
+    }
+    REQUIRE(publisher.publish(frame(101, 500)).is_ok());
+    auto next = subscriber.recv();
+    REQUIRE(next.is_ok());
+    dp::u32 index = 0;
+    CHECK(intact(next.value(), index));
+    CHECK(index == 101);
+    CHECK(subscriber.lapped_count() == 1);
+    CHECK(subscriber.missed_count() == 100);
+
+    // Back in step afterwards
+    REQUIRE(publisher.publish(frame(102, 64)).is_ok());
+    auto after = subscriber.recv();
+    REQUIRE(after.is_ok());
+    CHECK(after.value() == frame(102, 64));
+    CHECK(subscriber.missed_count() == 100);
+
+    netpipe::ShmSubscriber missing;
+    CHECK(missing.attach({"netpipe_test_topic_missing", 8192}).is_err());
+    CHECK(missing.recv().is_err());
+}
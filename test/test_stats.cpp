@@ -0,0 +1,237 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Registry entries whose label is label
+    std::vector<netpipe::ConnectionStats> listed(const char *label) {
+        std::vector<netpipe::ConnectionStats> found;
+        for (auto &entry : netpipe::StatsRegistry::global().snapshot()) {
+            if (entry.label == label) {
+                found.push_back(entry);
+            }
+        }
+        return found;
+    }
+} // namespace
+
+TEST_CASE("Stats - TCP counters, TCP_INFO and the registry") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20066};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    listener.enable_stats("stats-tcp-server");
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    auto client = std::make_unique<netpipe::TcpStream>();
+    CHECK_FALSE(client->stats_enabled());
+    client->enable_stats("stats-tcp-client");
+    REQUIRE(client->connect(endpoint).is_ok());
+    accept_thread.join();
+    REQUIRE(accepted->stats_enabled()); // Inherited from the listener
+
+    netpipe::Message small(100, 1);
+    netpipe::Message large(1024 * 1024, 2);
+    for (int i = 0; i < 10; i++) {
+        REQUIRE(client->send(small).is_ok());
+    }
+    std::thread sender([&]() { REQUIRE(client->send(large).is_ok()); });
+    for (int i = 0; i < 10; i++) {
+        auto res = accepted->recv();
+        REQUIRE(res.is_ok());
+    }
+    auto res = accepted->recv();
+    REQUIRE(res.is_ok());
+    CHECK(res.value() == large);
+    sender.join();
+
+    auto sent = client->stats();
+    CHECK(sent.messages_sent == 11);
+    CHECK(sent.bytes_sent == 10 * 100 + large.size());
+    CHECK(sent.send_syscalls >= 11);
+    CHECK(sent.messages_received == 0);
+    CHECK(sent.has_tcp_info);
+    CHECK(sent.snd_cwnd > 0);
+
+    auto received = accepted->stats();
+    CHECK(received.messages_received == 11);
+    CHECK(received.bytes_received == sent.bytes_sent);
+    CHECK(received.recv_syscalls >= 2);
+    CHECK(received.partial_reads < received.recv_syscalls); // Depends on how the megabyte arrives
+    CHECK(received.has_tcp_info);
+
+    // Listener and accepted stream share the label; each connection is its own entry
+    CHECK(listed("stats-tcp-server").size() == 2);
+    auto clients = listed("stats-tcp-client");
+    REQUIRE(clients.size() == 1);
+    CHECK(clients[0].stats.messages_sent == 11);
+
+    // Closed streams stop reporting TCP_INFO; destroyed ones leave the registry
+    client->close();
+    CHECK_FALSE(client->stats().has_tcp_info);
+    CHECK(client->stats().messages_sent == 11);
+    client.reset();
+    CHECK(listed("stats-tcp-client").empty());
+
+    netpipe::TcpStream plain;
+    CHECK(plain.stats().messages_sent == 0);
+
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("Stats - IPC batches and SHM waits") {
+    netpipe::IpcStream ipc_listener;
+    netpipe::IpcEndpoint ipc_endpoint{"/tmp/netpipe_test_stats.sock"};
+    REQUIRE(ipc_listener.listen_ipc(ipc_endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> ipc_accepted;
+    std::thread ipc_accept([&]() {
+        auto res = ipc_listener.accept();
+        REQUIRE(res.is_ok());
+        ipc_accepted = std::move(res.value());
+    });
+    netpipe::IpcStream ipc_client;
+    REQUIRE(ipc_client.connect_ipc(ipc_endpoint).is_ok());
+    ipc_accept.join();
+    ipc_client.enable_stats("stats-ipc");
+    ipc_accepted->enable_stats("stats-ipc");
+
+    netpipe::Message a(10, 1);
+    netpipe::Message b(20, 2);
+    iovec parts[2] = {{a.data(), a.size()}, {b.data(), b.size()}};
+    std::span<const iovec> frames[2] = {std::span<const iovec>(&parts[0], 1), std::span<const iovec>(&parts[1], 1)};
+    REQUIRE(ipc_client.send_batch(frames).is_ok());
+    REQUIRE(ipc_accepted->recv().is_ok());
+    REQUIRE(ipc_accepted->recv().is_ok());
+    CHECK(ipc_client.stats().messages_sent == 2);
+    CHECK(ipc_client.stats().bytes_sent == 30);
+    CHECK(ipc_client.stats().send_syscalls == 1);
+    CHECK_FALSE(ipc_client.stats().has_tcp_info);
+    CHECK(ipc_accepted->stats().messages_received == 2);
+    CHECK(ipc_accepted->stats().recv_syscalls == 1); // Both frames came with one read
+    ipc_client.close();
+    ipc_accepted->close();
+    ipc_listener.close();
+
+    netpipe::ShmStream shm_listener;
+    netpipe::ShmEndpoint shm_endpoint{"netpipe_test_stats", 8192};
+    REQUIRE(shm_listener.listen_shm(shm_endpoint).is_ok());
+    shm_listener.enable_stats("stats-shm");
+    std::unique_ptr<netpipe::Stream> shm_accepted;
+    std::thread shm_accept([&]() {
+        auto res = shm_listener.accept();
+        REQUIRE(res.is_ok());
+        shm_accepted = std::move(res.value());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    netpipe::ShmStream shm_client;
+    REQUIRE(shm_client.connect_shm(shm_endpoint).is_ok());
+    shm_accept.join();
+
+    // The receiver gets there first and has to wait for the message
+    std::thread late_sender([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE(shm_client.send(netpipe::Message(64, 5)).is_ok());
+    });
+    auto res = shm_accepted->recv();
+    late_sender.join();
+    REQUIRE(res.is_ok());
+    auto shm = shm_accepted->stats();
+    CHECK(shm.messages_received == 1);
+    CHECK(shm.bytes_received == 64);
+    CHECK(shm.waits == 1);
+    CHECK(shm.wait_ns >= 10 * 1000 * 1000);
+    CHECK(shm.recv_syscalls == 0);
+    CHECK_FALSE(shm_client.stats_enabled());
+
+    shm_client.close();
+    shm_accepted->close();
+    shm_listener.close();
+}
+
+TEST_CASE("Stats - UDP datagrams") {
+    netpipe::UdpDatagram receiver;
+    netpipe::UdpEndpoint endpoint{"127.0.0.1", 20067};
+    REQUIRE(receiver.bind(endpoint).is_ok());
+    receiver.enable_stats("stats-udp");
+    netpipe::UdpDatagram sender;
+    sender.enable_stats("stats-udp");
+
+    std::vector<netpipe::Message> batch(3, netpipe::Message(50, 9));
+    REQUIRE(sender.send_to(netpipe::Message(10, 1), endpoint).is_ok());
+    auto address = netpipe::UdpDatagram::resolve(endpoint);
+    REQUIRE(address.is_ok());
+    auto sent = sender.send_batch(batch, address.value());
+    REQUIRE(sent.is_ok());
+    CHECK(sent.value() == 3);
+
+    dp::usize received = 0;
+    std::vector<netpipe::Message> msgs(4);
+    for (int i = 0; i < 10 && received < 4; i++) {
+        auto res = receiver.recv_batch(std::span<netpipe::Message>(msgs.data() + received, msgs.size() - received));
+        REQUIRE(res.is_ok());
+        received += res.value();
+    }
+    CHECK(received == 4);
+
+    CHECK(sender.stats().messages_sent == 4);
+    CHECK(sender.stats().bytes_sent == 160);
+    CHECK(sender.stats().send_syscalls == 2);
+    CHECK(receiver.stats().messages_received == 4);
+    CHECK(receiver.stats().bytes_received == 160);
+    CHECK(receiver.stats().recv_syscalls >= 1);
+    CHECK(listed("stats-udp").size() == 2);
+
+    sender.close();
+    receiver.close();
+}
+
+TEST_CASE("Stats - RemoteServer counts the connections it reads itself") {
+    auto listener = std::make_unique<netpipe::TcpStream>();
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20081};
+    REQUIRE(listener->listen(endpoint).is_ok());
+    listener->enable_stats("stats-remote-server");
+
+    netpipe::remote::RemoteServer server(1);
+    REQUIRE(server
+                .register_method(1,
+                                 [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                                     return dp::result::ok(req);
+                                 })
+                .is_ok());
+    REQUIRE(server.add_listener(std::move(listener)).is_ok());
+    REQUIRE(server.start().is_ok());
+
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    {
+        netpipe::Remote<netpipe::Unidirect> remote(client);
+        for (int i = 0; i < 10; i++) {
+            auto res = remote.call(1, netpipe::Message(100, static_cast<dp::u8>(i)), 5000);
+            REQUIRE(res.is_ok());
+        }
+    }
+
+    // The listener's entry and the accepted connection's, which the event loop reads and writes with the fd
+    auto entries = listed("stats-remote-server");
+    REQUIRE(entries.size() == 2);
+    auto &served = entries[1].stats;
+    dp::u64 wire = netpipe::remote::V2_HEADER_SIZE + 100;
+    CHECK(served.messages_received == 10);
+    CHECK(served.bytes_received == 10 * wire);
+    CHECK(served.recv_syscalls >= 10);
+    CHECK(served.messages_sent == 10);
+    CHECK(served.bytes_sent == 10 * wire);
+    CHECK(served.send_syscalls >= 10);
+    CHECK(served.has_tcp_info);
+
+    client.close();
+    server.stop();
+}
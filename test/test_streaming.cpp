@@ -2,6 +2,7 @@
 #include <chrono>
 #include <doctest/doctest.h>
 #include <netpipe/netpipe.hpp>
+#include <string>
 #include <thread>
 
 TEST_CASE("Streaming RPC") {
@@ -85,11 +86,13 @@ TEST_CASE("Streaming RPC") {
         // Check protocol support
         CHECK(netpipe::remote::is_protocol_supported(1) == true);
         CHECK(netpipe::remote::is_protocol_supported(2) == true);
+        CHECK(netpipe::remote::is_protocol_supported(3) == true);
         CHECK(netpipe::remote::is_protocol_supported(99) == false);
 
         // Check protocol names
         CHECK(dp::String(netpipe::remote::get_protocol_name(1)) == "V1 (Basic)");
         CHECK(dp::String(netpipe::remote::get_protocol_name(2)) == "V2 (Streaming)");
+        CHECK(dp::String(netpipe::remote::get_protocol_name(3)) == "V3 (Compact)");
         CHECK(dp::String(netpipe::remote::get_protocol_name(99)) == "Unknown");
     }
 
@@ -101,3 +104,544 @@ TEST_CASE("Streaming RPC") {
         CHECK(state.chunks.empty());
     }
 }
+
+TEST_CASE("StreamingRemote - Credit flow control") {
+    using netpipe::remote::MessageType;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20020};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> peer;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        peer = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    peer->set_recv_timeout(2000);
+
+    // The peer side speaks the wire protocol directly
+    auto peer_recv = [&]() {
+        auto recv_res = peer->recv();
+        REQUIRE(recv_res.is_ok());
+        auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+        REQUIRE(decoded.is_ok());
+        return std::move(decoded.value());
+    };
+    auto peer_send = [&](dp::u32 stream_id, MessageType type, const netpipe::Message &payload) {
+        REQUIRE(netpipe::remote::send_remote_message_v2(*peer, stream_id, 0, payload, type,
+                                                        netpipe::remote::MessageFlags::Streaming)
+                    .is_ok());
+    };
+    auto credit = [](dp::u32 chunks, dp::u32 bytes) {
+        auto c = netpipe::encode_u32_be(chunks);
+        auto b = netpipe::encode_u32_be(bytes);
+        netpipe::Message payload(c.begin(), c.end());
+        payload.insert(payload.end(), b.begin(), b.end());
+        return payload;
+    };
+
+    {
+        netpipe::StreamingRemote streaming(client, netpipe::StreamWindow{4, 0});
+        auto open = streaming.bidirectional_stream(1);
+        REQUIRE(open.is_ok());
+        dp::u32 id = open.value();
+        CHECK(peer_recv().type == MessageType::Request);
+
+        SUBCASE("send_chunk stops at the window until credit arrives") {
+            for (dp::u8 i = 0; i < 4; i++) {
+                CHECK(streaming.send_chunk(id, netpipe::Message{i}, false, 0).is_ok());
+            }
+            auto blocked = streaming.send_chunk(id, netpipe::Message{4}, false, 0);
+            REQUIRE(blocked.is_err());
+            CHECK(blocked.error().code == dp::Error::TIMEOUT);
+            for (int i = 0; i < 4; i++) {
+                CHECK(peer_recv().payload == netpipe::Message{static_cast<dp::u8>(i)});
+            }
+
+            // A waiting sender resumes as soon as the grant lands
+            std::thread granter([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                peer_send(id, MessageType::StreamCredit, credit(2, 0));
+            });
+            CHECK(streaming.send_chunk(id, netpipe::Message{4}, false, 2000).is_ok());
+            granter.join();
+            CHECK(streaming.send_chunk(id, netpipe::Message{5}, false, 0).is_ok());
+            CHECK(streaming.send_chunk(id, netpipe::Message{6}, false, 0).is_err());
+        }
+
+        SUBCASE("recv_chunk hands credit back in half-window batches") {
+            for (dp::u8 i = 0; i < 4; i++) {
+                peer_send(id, MessageType::StreamData, netpipe::Message{i});
+            }
+            for (dp::u8 i = 0; i < 2; i++) {
+                auto chunk = streaming.recv_chunk(id, 2000);
+                REQUIRE(chunk.is_ok());
+                CHECK(chunk.value() == netpipe::Message{i});
+            }
+            auto grant = peer_recv();
+            CHECK(grant.type == MessageType::StreamCredit);
+            REQUIRE(grant.payload.size() == 8);
+            CHECK(netpipe::decode_u32_be(grant.payload.data()) == 2);
+
+            peer_send(id, MessageType::StreamEnd, netpipe::Message{});
+            CHECK(streaming.recv_chunk(id, 2000).is_ok());
+            CHECK(streaming.recv_chunk(id, 2000).is_ok());
+            auto end = streaming.recv_chunk(id, 2000);
+            REQUIRE(end.is_err());
+            CHECK(std::string(end.error().message.c_str()).find("end of stream") != std::string::npos);
+        }
+
+        SUBCASE("Peer overrunning its window fails the stream") {
+            for (dp::u8 i = 0; i < 5; i++) {
+                peer_send(id, MessageType::StreamData, netpipe::Message{i});
+            }
+            // Let the receiver see all five before any recv_chunk() grants credit back
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            for (int i = 0; i < 4; i++) {
+                CHECK(streaming.recv_chunk(id, 2000).is_ok());
+            }
+            auto violated = streaming.recv_chunk(id, 2000);
+            REQUIRE(violated.is_err());
+            CHECK(std::string(violated.error().message.c_str()).find("flow control") != std::string::npos);
+        }
+    }
+
+    peer->close();
+    listener.close();
+}
+
+TEST_CASE("Session - RPC and streams on one connection") {
+    using netpipe::remote::MessageType;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20021};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        // Peer: ordinary RPC methods plus a hand-written stream service on the same Remote
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+        dp::u64 client_sum = 0;
+        server.set_stream_sink([&](netpipe::remote::DecodedMessageV2 &frame) {
+            if (frame.type == MessageType::Request) {
+                // Server stream: 32 chunks of 4 KB, then the end marker
+                for (dp::u32 i = 0; i < 32; i++) {
+                    netpipe::Message chunk(4096, static_cast<dp::u8>(i));
+                    server.send_frame(frame.request_id, 0, chunk, MessageType::StreamData);
+                }
+                server.send_frame(frame.request_id, 0, netpipe::Message{}, MessageType::StreamEnd);
+            } else if (frame.type == MessageType::StreamData) {
+                // Client stream: answer the final chunk with the sum of every byte seen
+                for (auto b : frame.payload) {
+                    client_sum += b;
+                }
+                if (frame.flags & netpipe::remote::MessageFlags::Final) {
+                    auto sum = netpipe::encode_u32_be(static_cast<dp::u32>(client_sum));
+                    server.send_frame(frame.request_id, 0, netpipe::Message(sum.begin(), sum.end()),
+                                      MessageType::StreamData);
+                    server.send_frame(frame.request_id, 0, netpipe::Message{}, MessageType::StreamEnd);
+                }
+            }
+        });
+
+        netpipe::Session session(client);
+
+        // RPCs keep flowing while a stream is being received on the same socket
+        std::atomic<bool> streaming_done{false};
+        int calls_during_stream = 0;
+        std::thread rpc_thread([&]() {
+            do {
+                auto res = session.rpc().call(1, netpipe::Message{7}, 2000);
+                REQUIRE(res.is_ok());
+                CHECK(res.value() == netpipe::Message{7});
+                calls_during_stream++;
+            } while (!streaming_done);
+        });
+
+        int chunks = 0;
+        bool in_order = true;
+        auto stream_res = session.streams().server_stream(
+            2, netpipe::Message{},
+            [&](const netpipe::Message &chunk) {
+                in_order = in_order && chunk.size() == 4096 && chunk[0] == static_cast<dp::u8>(chunks);
+                chunks++;
+            },
+            5000);
+        streaming_done = true;
+        rpc_thread.join();
+        REQUIRE(stream_res.is_ok());
+        CHECK(chunks == 32);
+        CHECK(in_order);
+        CHECK(calls_during_stream > 0);
+
+        dp::Vector<netpipe::Message> upload = {{1, 2, 3}, {4, 5}, {6}};
+        auto sum = session.streams().client_stream(3, upload, 2000);
+        REQUIRE(sum.is_ok());
+        REQUIRE(sum.value().size() == 4);
+        CHECK(netpipe::decode_u32_be(sum.value().data()) == 21);
+
+        // Plain RPC still works and nothing was mistaken for a response
+        CHECK(session.rpc().call(1, netpipe::Message{9}, 2000).is_ok());
+        CHECK(session.streams().active_stream_count() == 0);
+        server.set_stream_sink(nullptr);
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("StreamingRemote - Client stream from a producer") {
+    namespace MessageFlags = netpipe::remote::MessageFlags;
+    using netpipe::remote::MessageType;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20060};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> peer;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        peer = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    peer->set_recv_timeout(2000);
+
+    auto peer_recv = [&]() {
+        auto recv_res = peer->recv();
+        REQUIRE(recv_res.is_ok());
+        auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+        REQUIRE(decoded.is_ok());
+        return std::move(decoded.value());
+    };
+    auto peer_send = [&](dp::u32 stream_id, MessageType type, const netpipe::Message &payload) {
+        REQUIRE(netpipe::remote::send_remote_message_v2(*peer, stream_id, 0, payload, type, MessageFlags::Streaming)
+                    .is_ok());
+    };
+    auto credit = [](dp::u32 chunks) {
+        auto c = netpipe::encode_u32_be(chunks);
+        auto b = netpipe::encode_u32_be(0);
+        netpipe::Message payload(c.begin(), c.end());
+        payload.insert(payload.end(), b.begin(), b.end());
+        return payload;
+    };
+
+    {
+        netpipe::StreamingRemote streaming(client, netpipe::StreamWindow{4, 0});
+
+        SUBCASE("Chunks are pulled only as the window allows") {
+            const dp::u8 total = 20;
+            std::atomic<int> produced{0};
+            netpipe::ChunkProducer producer = [&](netpipe::Message &chunk) -> dp::Res<bool> {
+                CHECK(chunk.empty());
+                chunk.assign(100, static_cast<dp::u8>(produced++));
+                return dp::result::ok(produced < total); // The last chunk comes with false
+            };
+            dp::Res<netpipe::Message> result = dp::result::ok(netpipe::Message());
+            std::thread uploader([&]() { result = streaming.client_stream(5, producer, 2000); });
+
+            // Four chunks sent and the fifth waiting for credit; nothing is produced ahead of it
+            for (dp::u8 i = 0; i < 4; i++) {
+                auto chunk = peer_recv();
+                CHECK(chunk.type == MessageType::StreamData);
+                CHECK(chunk.payload == netpipe::Message(100, i));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            CHECK(produced == 5);
+
+            dp::u32 id = 0;
+            for (dp::u8 i = 4; i < total; i++) {
+                peer_send(id, MessageType::StreamCredit, credit(1));
+                auto chunk = peer_recv();
+                id = chunk.request_id;
+                CHECK(chunk.payload == netpipe::Message(100, i));
+                CHECK(((chunk.flags & MessageFlags::Final) != 0) == (i == total - 1));
+            }
+            peer_send(id, MessageType::StreamData, netpipe::Message{42});
+            peer_send(id, MessageType::StreamEnd, netpipe::Message{});
+            uploader.join();
+            REQUIRE(result.is_ok());
+            CHECK(result.value() == netpipe::Message{42});
+        }
+
+        SUBCASE("A chunk leaves before the next one is produced") {
+            std::atomic<bool> first_arrived{false};
+            bool waited_for_first = false;
+            int calls = 0;
+            netpipe::ChunkProducer producer = [&](netpipe::Message &chunk) -> dp::Res<bool> {
+                if (calls++ == 0) {
+                    chunk.assign(10, 7);
+                    return dp::result::ok(true);
+                }
+                auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                while (!first_arrived && std::chrono::steady_clock::now() < until) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                waited_for_first = first_arrived;
+                return dp::result::ok(false); // Only now is the end known: an empty Final chunk closes the upload
+            };
+            dp::Res<netpipe::Message> result = dp::result::ok(netpipe::Message());
+            std::thread uploader([&]() { result = streaming.client_stream(5, producer, 2000); });
+
+            auto first = peer_recv();
+            first_arrived = true;
+            CHECK(first.payload == netpipe::Message(10, 7));
+            CHECK((first.flags & MessageFlags::Final) == 0);
+            auto end = peer_recv();
+            CHECK(end.type == MessageType::StreamData);
+            CHECK(end.payload.empty());
+            CHECK((end.flags & MessageFlags::Final) != 0);
+            peer_send(end.request_id, MessageType::StreamEnd, netpipe::Message{});
+            uploader.join();
+            REQUIRE(result.is_ok());
+            CHECK(waited_for_first);
+        }
+
+        SUBCASE("An empty upload is a single empty final chunk") {
+            dp::Res<netpipe::Message> result = dp::result::ok(netpipe::Message());
+            std::thread uploader([&]() {
+                result = streaming.client_stream(
+                    5, [](netpipe::Message &) -> dp::Res<bool> { return dp::result::ok(false); }, 2000);
+            });
+            auto chunk = peer_recv();
+            CHECK(chunk.type == MessageType::StreamData);
+            CHECK(chunk.payload.empty());
+            CHECK((chunk.flags & MessageFlags::Final) != 0);
+            peer_send(chunk.request_id, MessageType::StreamEnd, netpipe::Message{});
+            uploader.join();
+            REQUIRE(result.is_ok());
+            CHECK(result.value().empty());
+        }
+
+        SUBCASE("A producer error aborts the stream on both sides") {
+            int calls = 0;
+            auto result = streaming.client_stream(5, [&](netpipe::Message &chunk) -> dp::Res<bool> {
+                if (++calls == 3) {
+                    return dp::result::err(dp::Error::io_error("log file truncated"));
+                }
+                chunk.assign(10, 1);
+                return dp::result::ok(true);
+            });
+            REQUIRE(result.is_err());
+            CHECK(std::string(result.error().message.c_str()) == "log file truncated");
+            CHECK(peer_recv().type == MessageType::StreamData); // Both good chunks went out before the error
+            CHECK(peer_recv().type == MessageType::StreamData);
+            auto abort = peer_recv();
+            CHECK(abort.type == MessageType::StreamError);
+            CHECK(std::string(abort.payload.begin(), abort.payload.end()) == "log file truncated");
+            CHECK(streaming.active_stream_count() == 0);
+        }
+    }
+
+    peer->close();
+    listener.close();
+}
+
+TEST_CASE("StreamingRemote - Chunk batching") {
+    namespace MessageFlags = netpipe::remote::MessageFlags;
+    using netpipe::remote::MessageType;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20061};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> peer;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        peer = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    peer->set_recv_timeout(2000);
+
+    auto peer_recv = [&]() {
+        auto recv_res = peer->recv();
+        REQUIRE(recv_res.is_ok());
+        auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+        REQUIRE(decoded.is_ok());
+        return std::move(decoded.value());
+    };
+    // Chunks of a StreamData frame, batched or not
+    auto unpack = [](const netpipe::remote::DecodedMessageV2 &frame) {
+        std::vector<netpipe::Message> chunks;
+        if (!(frame.flags & MessageFlags::Batch)) {
+            chunks.push_back(frame.payload);
+            return chunks;
+        }
+        dp::usize offset = 0;
+        while (offset + 4 <= frame.payload.size()) {
+            dp::usize length = netpipe::decode_u32_be(frame.payload.data() + offset);
+            chunks.emplace_back(frame.payload.begin() + offset + 4, frame.payload.begin() + offset + 4 + length);
+            offset += 4 + length;
+        }
+        CHECK(offset == frame.payload.size());
+        return chunks;
+    };
+    auto batch_of = [](const std::vector<netpipe::Message> &chunks) {
+        netpipe::Message payload;
+        for (const auto &chunk : chunks) {
+            auto length = netpipe::encode_u32_be(static_cast<dp::u32>(chunk.size()));
+            payload.insert(payload.end(), length.begin(), length.end());
+            payload.insert(payload.end(), chunk.begin(), chunk.end());
+        }
+        return payload;
+    };
+
+    {
+        netpipe::StreamingRemote streaming(client, netpipe::StreamWindow{256, 0});
+        REQUIRE(streaming.set_chunk_batching(netpipe::ChunkBatching{1024, 2000}).is_ok());
+        CHECK(streaming.set_chunk_batching(netpipe::ChunkBatching{}).is_err());
+        auto open = streaming.bidirectional_stream(1);
+        REQUIRE(open.is_ok());
+        dp::u32 id = open.value();
+        CHECK(peer_recv().type == MessageType::Request);
+
+        SUBCASE("Small chunks share frames; Final flushes") {
+            const int total = 100;
+            for (int i = 0; i < total; i++) {
+                netpipe::Message chunk(20, static_cast<dp::u8>(i));
+                CHECK(streaming.send_chunk(id, chunk, i == total - 1, 0).is_ok());
+            }
+            int frames = 0;
+            std::vector<netpipe::Message> received;
+            while (received.size() < static_cast<dp::usize>(total)) {
+                auto frame = peer_recv();
+                REQUIRE(frame.type == MessageType::StreamData);
+                frames++;
+                for (auto &chunk : unpack(frame)) {
+                    received.push_back(std::move(chunk));
+                }
+                CHECK(((frame.flags & MessageFlags::Final) != 0) == (received.size() == total));
+            }
+            CHECK(frames <= 3); // 24 bytes per packed chunk, about 42 to a frame
+            for (int i = 0; i < total; i++) {
+                CHECK(received[i] == netpipe::Message(20, static_cast<dp::u8>(i)));
+            }
+        }
+
+        SUBCASE("A partial batch goes out after the linger time") {
+            for (dp::u8 i = 0; i < 3; i++) {
+                CHECK(streaming.send_chunk(id, netpipe::Message{i}, false, 0).is_ok());
+            }
+            auto frame = peer_recv();
+            CHECK((frame.flags & MessageFlags::Batch) != 0);
+            CHECK(unpack(frame) == std::vector<netpipe::Message>{{0}, {1}, {2}});
+
+            // Chunks too big to pack still go out whole, after what was batched before them
+            CHECK(streaming.send_chunk(id, netpipe::Message{9}, false, 0).is_ok());
+            CHECK(streaming.send_chunk(id, netpipe::Message(4096, 7), false, 0).is_ok());
+            CHECK(peer_recv().payload == netpipe::Message{9});
+            CHECK(peer_recv().payload == netpipe::Message(4096, 7));
+
+            CHECK(streaming.send_chunk(id, netpipe::Message{5}, false, 0).is_ok());
+            REQUIRE(streaming.end_stream(id).is_ok());
+            CHECK(peer_recv().payload == netpipe::Message{5});
+            CHECK(peer_recv().type == MessageType::StreamEnd);
+        }
+
+        SUBCASE("Batched frames from the peer are unpacked") {
+            REQUIRE(netpipe::remote::send_remote_message_v2(*peer, id, 0, batch_of({{1}, {}, {3, 3}}),
+                                                            MessageType::StreamData,
+                                                            MessageFlags::Streaming | MessageFlags::Batch)
+                        .is_ok());
+            for (const auto &expected : std::vector<netpipe::Message>{{1}, {}, {3, 3}}) {
+                auto chunk = streaming.recv_chunk(id, 2000);
+                REQUIRE(chunk.is_ok());
+                CHECK(chunk.value() == expected);
+            }
+
+            netpipe::Message truncated = batch_of({{1, 2, 3}});
+            truncated.pop_back();
+            REQUIRE(netpipe::remote::send_remote_message_v2(*peer, id, 0, truncated, MessageType::StreamData,
+                                                            MessageFlags::Streaming | MessageFlags::Batch)
+                        .is_ok());
+            auto broken = streaming.recv_chunk(id, 2000);
+            REQUIRE(broken.is_err());
+            CHECK(std::string(broken.error().message.c_str()).find("malformed") != std::string::npos);
+        }
+    }
+
+    peer->close();
+    listener.close();
+}
+
+TEST_CASE("StreamingRemote - Batched chunks do not hold back their own credit") {
+    namespace MessageFlags = netpipe::remote::MessageFlags;
+    using netpipe::remote::MessageType;
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20076};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> peer;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        peer = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    peer->set_recv_timeout(2000);
+    auto peer_recv = [&]() {
+        auto recv_res = peer->recv();
+        REQUIRE(recv_res.is_ok());
+        auto decoded = netpipe::remote::decode_remote_message_v2(recv_res.value());
+        REQUIRE(decoded.is_ok());
+        return std::move(decoded.value());
+    };
+
+    {
+        // Four chunks of credit and no linger: only a full window's worth of waiting flushes the batch
+        netpipe::StreamingRemote streaming(client, netpipe::StreamWindow{4, 0});
+        REQUIRE(streaming.set_chunk_batching(netpipe::ChunkBatching{1024, 0}).is_ok());
+        auto open = streaming.bidirectional_stream(1);
+        REQUIRE(open.is_ok());
+        dp::u32 id = open.value();
+        CHECK(peer_recv().type == MessageType::Request);
+
+        std::atomic<int> sent{0};
+        std::thread sender([&]() {
+            for (dp::u8 i = 0; i < 6; i++) {
+                CHECK(streaming.send_chunk(id, netpipe::Message{i}, i == 5, 2000).is_ok());
+                sent++;
+            }
+        });
+        auto frame = peer_recv();
+        CHECK(frame.type == MessageType::StreamData);
+        CHECK((frame.flags & MessageFlags::Batch) != 0);
+        CHECK(frame.payload.size() == 4 * 5);
+        CHECK(sent == 4);
+
+        auto chunks = netpipe::encode_u32_be(4);
+        netpipe::Message credit(chunks.begin(), chunks.end());
+        credit.resize(8, 0);
+        REQUIRE(netpipe::remote::send_remote_message_v2(*peer, id, 0, credit, MessageType::StreamCredit,
+                                                        MessageFlags::Streaming)
+                    .is_ok());
+        frame = peer_recv();
+        CHECK((frame.flags & MessageFlags::Final) != 0);
+        CHECK(frame.payload.size() == 2 * 5);
+        sender.join();
+        CHECK(sent == 6);
+    }
+
+    peer->close();
+    listener.close();
+}
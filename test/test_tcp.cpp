@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <chrono>
 #include <doctest/doctest.h>
+#include <memory>
 #include <netpipe/stream/tcp.hpp>
 #include <thread>
 
@@ -221,6 +223,180 @@ TEST_CASE("TcpStream - Multiple messages") {
         client_thread.join();
         server.close();
     }
+
+    SUBCASE("Burst of small messages through the receive buffer") {
+        for (dp::usize buffer_size : {netpipe::FrameReader::DEFAULT_CAPACITY, dp::usize(0)}) {
+            netpipe::TcpStream server;
+            netpipe::TcpEndpoint endpoint{"127.0.0.1", 19012};
+
+            auto listen_res = server.listen(endpoint);
+            REQUIRE(listen_res.is_ok());
+
+            std::thread client_thread([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                netpipe::TcpStream client;
+                auto connect_res = client.connect(endpoint);
+                REQUIRE(connect_res.is_ok());
+
+                for (int i = 0; i < 1000; i++) {
+                    netpipe::Message msg(64 + (i % 192), static_cast<dp::u8>(i));
+                    CHECK(client.send(msg).is_ok());
+                }
+
+                client.close();
+            });
+
+            auto accept_res = server.accept();
+            REQUIRE(accept_res.is_ok());
+            auto client_stream = std::move(accept_res.value());
+            auto *tcp_stream = dynamic_cast<netpipe::TcpStream *>(client_stream.get());
+            REQUIRE(tcp_stream != nullptr);
+            REQUIRE(tcp_stream->set_recv_buffer_size(buffer_size).is_ok());
+            CHECK(tcp_stream->recv_buffer_size() == buffer_size);
+
+            bool all_match = true;
+            for (int i = 0; i < 1000; i++) {
+                auto recv_res = client_stream->recv();
+                REQUIRE(recv_res.is_ok());
+                all_match = all_match && recv_res.value() == netpipe::Message(64 + (i % 192), static_cast<dp::u8>(i));
+            }
+            CHECK(all_match);
+
+            client_thread.join();
+            server.close();
+        }
+    }
+
+    SUBCASE("Receive into a reused buffer") {
+        netpipe::TcpStream server;
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", 19013};
+
+        auto listen_res = server.listen(endpoint);
+        REQUIRE(listen_res.is_ok());
+
+        std::thread client_thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            netpipe::TcpStream client;
+            auto connect_res = client.connect(endpoint);
+            REQUIRE(connect_res.is_ok());
+
+            // Largest first so the buffer never has to grow afterwards
+            for (int i = 0; i < 20; i++) {
+                netpipe::Message msg(static_cast<dp::usize>(4096 - i * 100), static_cast<dp::u8>(i));
+                CHECK(client.send(msg).is_ok());
+            }
+
+            client.close();
+        });
+
+        auto accept_res = server.accept();
+        REQUIRE(accept_res.is_ok());
+        auto client_stream = std::move(accept_res.value());
+
+        netpipe::Message buffer;
+        REQUIRE(client_stream->recv_into(buffer).is_ok());
+        CHECK(buffer.size() == 4096);
+        const dp::u8 *storage = buffer.data();
+
+        for (int i = 1; i < 20; i++) {
+            REQUIRE(client_stream->recv_into(buffer).is_ok());
+            CHECK(buffer.size() == static_cast<dp::usize>(4096 - i * 100));
+            CHECK(buffer[0] == static_cast<dp::u8>(i));
+            CHECK(buffer.data() == storage);
+        }
+
+        client_thread.join();
+        server.close();
+    }
+}
+
+TEST_CASE("TcpStream - Scatter/gather send") {
+    SUBCASE("Parts arrive as one message") {
+        netpipe::TcpStream server;
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", 19010};
+
+        auto listen_res = server.listen(endpoint);
+        REQUIRE(listen_res.is_ok());
+
+        std::thread client_thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            netpipe::TcpStream client;
+            auto connect_res = client.connect(endpoint);
+            REQUIRE(connect_res.is_ok());
+
+            dp::u8 a[] = {1, 2, 3};
+            dp::u8 b[] = {4, 5};
+            iovec parts[3] = {{a, sizeof(a)}, {nullptr, 0}, {b, sizeof(b)}};
+            auto send_res = client.send_iov(std::span<const iovec>(parts, 3));
+            CHECK(send_res.is_ok());
+
+            client.close();
+        });
+
+        auto accept_res = server.accept();
+        REQUIRE(accept_res.is_ok());
+        auto client_stream = std::move(accept_res.value());
+
+        auto recv_res = client_stream->recv();
+        REQUIRE(recv_res.is_ok());
+        auto msg = std::move(recv_res.value());
+        REQUIRE(msg.size() == 5);
+        for (dp::usize i = 0; i < 5; i++) {
+            CHECK(msg[i] == static_cast<dp::u8>(i + 1));
+        }
+
+        client_thread.join();
+        server.close();
+    }
+
+    SUBCASE("Remote V2 message sent as header and payload") {
+        netpipe::TcpStream server;
+        netpipe::TcpEndpoint endpoint{"127.0.0.1", 19011};
+
+        auto listen_res = server.listen(endpoint);
+        REQUIRE(listen_res.is_ok());
+
+        // Large enough that the kernel accepts it in several short writevs
+        netpipe::Message payload(8 * 1024 * 1024);
+        for (dp::usize i = 0; i < payload.size(); i++) {
+            payload[i] = static_cast<dp::u8>(i * 7);
+        }
+
+        std::thread client_thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            netpipe::TcpStream client;
+            auto connect_res = client.connect(endpoint);
+            REQUIRE(connect_res.is_ok());
+
+            auto send_res = netpipe::remote::send_remote_message_v2(client, 42, 7, payload,
+                                                                    netpipe::remote::MessageType::Response);
+            CHECK(send_res.is_ok());
+
+            client.close();
+        });
+
+        auto accept_res = server.accept();
+        REQUIRE(accept_res.is_ok());
+        auto client_stream = std::move(accept_res.value());
+
+        auto recv_res = client_stream->recv();
+        REQUIRE(recv_res.is_ok());
+        auto msg = std::move(recv_res.value());
+
+        // Wire bytes match the single-buffer encoder
+        auto expected =
+            netpipe::remote::encode_remote_message_v2(42, 7, payload, netpipe::remote::MessageType::Response);
+        CHECK(msg == expected);
+
+        auto decode_res = netpipe::remote::decode_remote_message_v2(msg);
+        REQUIRE(decode_res.is_ok());
+        CHECK(decode_res.value().request_id == 42);
+        CHECK(decode_res.value().method_id == 7);
+        CHECK(decode_res.value().payload.size() == payload.size());
+
+        client_thread.join();
+        server.close();
+    }
 }
 
 TEST_CASE("TcpStream - Error conditions") {
@@ -284,3 +460,177 @@ TEST_CASE("TcpStream - Bind to different addresses") {
         server.close();
     }
 }
+
+TEST_CASE("TcpStream - Zerocopy send") {
+    netpipe::TcpStream server;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20030};
+    REQUIRE(server.listen(endpoint).is_ok());
+
+    netpipe::TcpStream client;
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = server.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    auto zerocopy = client.set_zerocopy(64 * 1024);
+    if (zerocopy.is_err()) {
+        MESSAGE("SO_ZEROCOPY unavailable, skipping");
+        return;
+    }
+
+    constexpr int COUNT = 8;
+    std::thread receiver([&]() {
+        for (int i = 0; i < COUNT; i++) {
+            auto res = accepted->recv();
+            REQUIRE(res.is_ok());
+            dp::usize expected = i % 2 == 0 ? 1024 * 1024 : 100;
+            REQUIRE(res.value().size() == expected);
+            CHECK(res.value()[0] == static_cast<dp::u8>(i));
+            CHECK(res.value()[expected - 1] == static_cast<dp::u8>(i));
+        }
+    });
+
+    std::weak_ptr<const netpipe::Message> first;
+    for (int i = 0; i < COUNT; i++) {
+        // Large messages take the zerocopy path, small ones are copied like send()
+        auto msg = std::make_shared<netpipe::Message>(i % 2 == 0 ? 1024 * 1024 : 100, static_cast<dp::u8>(i));
+        if (i == 0) {
+            first = msg;
+        }
+        REQUIRE(client.send_zerocopy(std::move(msg)).is_ok());
+    }
+    receiver.join();
+    CHECK_FALSE(client.has_pending_input()); // Queued notifications are not input
+
+    REQUIRE(client.flush_zerocopy(5000).is_ok());
+    CHECK(client.zerocopy_pending() == 0);
+    CHECK(first.expired());
+
+    client.close();
+    accepted->close();
+    server.close();
+}
+
+TEST_CASE("TcpStream - File transfer without userspace copies") {
+    netpipe::TcpStream server;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20031};
+    REQUIRE(server.listen(endpoint).is_ok());
+
+    netpipe::TcpStream client;
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = server.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+    auto &receiver = static_cast<netpipe::TcpStream &>(*accepted);
+
+    constexpr dp::usize FILE_SIZE = 3 * 1024 * 1024;
+    netpipe::Message contents(FILE_SIZE);
+    for (dp::usize i = 0; i < FILE_SIZE; i++) {
+        contents[i] = static_cast<dp::u8>((i * 13) & 0xFF);
+    }
+
+    SUBCASE("File to file") {
+        char in_path[] = "/tmp/netpipe_test_sendfile_in_XXXXXX";
+        char out_path[] = "/tmp/netpipe_test_sendfile_out_XXXXXX";
+        dp::i32 in_fd = ::mkstemp(in_path);
+        dp::i32 out_fd = ::mkstemp(out_path);
+        REQUIRE(in_fd >= 0);
+        REQUIRE(out_fd >= 0);
+        REQUIRE(netpipe::write_exact(in_fd, contents.data(), contents.size()).is_ok());
+
+        // A slice of the file, then an ordinary message behind it
+        constexpr dp::usize OFFSET = 1000;
+        constexpr dp::usize LENGTH = 2 * 1024 * 1024 + 7;
+        REQUIRE(client.send_file(in_fd, OFFSET, LENGTH).is_ok());
+        REQUIRE(client.send(netpipe::Message{1, 2, 3}).is_ok());
+        CHECK(client.send_file(in_fd, FILE_SIZE - 10, 11).is_err());
+        CHECK(client.is_connected());
+
+        auto written = receiver.recv_to_fd(out_fd);
+        REQUIRE(written.is_ok());
+        CHECK(written.value() == LENGTH);
+        auto tail = receiver.recv();
+        REQUIRE(tail.is_ok());
+        CHECK(tail.value() == netpipe::Message{1, 2, 3});
+
+        netpipe::Message copy(LENGTH);
+        REQUIRE(::pread(out_fd, copy.data(), LENGTH, 0) == static_cast<dp::isize>(LENGTH));
+        CHECK(std::equal(copy.begin(), copy.end(), contents.begin() + OFFSET));
+
+        ::close(in_fd);
+        ::close(out_fd);
+        ::unlink(in_path);
+        ::unlink(out_path);
+    }
+
+    SUBCASE("A timeout part way through resumes") {
+        char out_path[] = "/tmp/netpipe_test_recvfd_out_XXXXXX";
+        dp::i32 out_fd = ::mkstemp(out_path);
+        REQUIRE(out_fd >= 0);
+
+        // The prefix and a third of the payload, then nothing until the receiver has timed out
+        constexpr dp::usize LENGTH = 1024 * 1024;
+        constexpr dp::usize FIRST = LENGTH / 3;
+        auto prefix = netpipe::encode_u32_be(static_cast<dp::u32>(LENGTH));
+        REQUIRE(netpipe::write_exact(client.native_handle(), prefix.data(), 4).is_ok());
+        REQUIRE(netpipe::write_exact(client.native_handle(), contents.data(), FIRST).is_ok());
+
+        REQUIRE(receiver.set_recv_timeout(100).is_ok());
+        auto written = receiver.recv_to_fd(out_fd);
+        REQUIRE(written.is_err());
+        CHECK(written.error().code == dp::Error::TIMEOUT);
+        CHECK(receiver.is_connected());
+
+        REQUIRE(netpipe::write_exact(client.native_handle(), contents.data() + FIRST, LENGTH - FIRST).is_ok());
+        REQUIRE(client.send(netpipe::Message{1, 2, 3}).is_ok());
+        written = receiver.recv_to_fd(out_fd);
+        REQUIRE(written.is_ok());
+        CHECK(written.value() == LENGTH);
+        auto tail = receiver.recv();
+        REQUIRE(tail.is_ok());
+        CHECK(tail.value() == netpipe::Message{1, 2, 3});
+
+        netpipe::Message copy(LENGTH);
+        REQUIRE(::pread(out_fd, copy.data(), LENGTH, 0) == static_cast<dp::isize>(LENGTH));
+        CHECK(std::equal(copy.begin(), copy.end(), contents.begin()));
+
+        ::close(out_fd);
+        ::unlink(out_path);
+    }
+
+    SUBCASE("Pipe to pipe") {
+        dp::i32 source[2];
+        dp::i32 sink[2];
+        REQUIRE(::pipe(source) == 0);
+        REQUIRE(::pipe(sink) == 0);
+
+        std::thread producer([&]() { CHECK(netpipe::write_exact(source[1], contents.data(), FILE_SIZE).is_ok()); });
+        netpipe::Message copy(FILE_SIZE);
+        std::thread consumer([&]() { CHECK(netpipe::read_exact(sink[0], copy.data(), FILE_SIZE).is_ok()); });
+
+        std::thread sender([&]() { REQUIRE(client.send_file(source[0], 0, FILE_SIZE).is_ok()); });
+        auto written = receiver.recv_to_fd(sink[1]);
+        sender.join();
+        producer.join();
+        consumer.join();
+        REQUIRE(written.is_ok());
+        CHECK(written.value() == FILE_SIZE);
+        CHECK(copy == contents);
+
+        for (dp::i32 fd : {source[0], source[1], sink[0], sink[1]}) {
+            ::close(fd);
+        }
+    }
+
+    client.close();
+    accepted->close();
+    server.close();
+}
@@ -296,3 +296,78 @@ TEST_CASE("TCP Unidirect - 1GB payload") {
     server.close();
 }
 #endif // BIG_TRANSFER
+
+TEST_CASE("TCP Unidirect - Pipelined call_batch") {
+    netpipe::TcpStream server;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 18105};
+    REQUIRE(server.listen(endpoint).is_ok());
+
+    std::thread server_thread([&]() {
+        auto accept_res = server.accept();
+        REQUIRE(accept_res.is_ok());
+        auto client_stream = std::move(accept_res.value());
+
+        netpipe::Remote<netpipe::Unidirect> remote(*client_stream);
+        remote.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+        remote.register_method(2, [](const netpipe::Message &) -> dp::Res<netpipe::Message> {
+            return dp::result::err(dp::Error::io_error("rejected"));
+        });
+
+        // Returns once the client hangs up
+        CHECK(remote.serve().is_err());
+    });
+
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    netpipe::Remote<netpipe::Unidirect> remote(client);
+
+    // More calls than one window, one oversized request, every tenth call failing
+    std::vector<netpipe::remote::BatchRequest> requests;
+    for (int i = 0; i < 200; i++) {
+        dp::usize size = i == 77 ? 400 * 1024 : static_cast<dp::usize>(i);
+        requests.push_back({static_cast<dp::u32>(i % 10 == 0 ? 2 : 1), netpipe::Message(size, static_cast<dp::u8>(i))});
+    }
+
+    auto batch = remote.call_batch(requests, 5000);
+    REQUIRE(batch.is_ok());
+    REQUIRE(batch.value().size() == requests.size());
+    for (dp::usize i = 0; i < requests.size(); i++) {
+        if (requests[i].method_id == 2) {
+            CHECK(batch.value()[i].is_err());
+        } else {
+            REQUIRE(batch.value()[i].is_ok());
+            CHECK(batch.value()[i].value() == requests[i].payload);
+        }
+    }
+
+    // Plain calls keep working after a batch
+    auto single = remote.call(1, {7, 8, 9}, 5000);
+    REQUIRE(single.is_ok());
+    CHECK(single.value() == netpipe::Message{7, 8, 9});
+
+    auto empty = remote.call_batch({}, 5000);
+    REQUIRE(empty.is_ok());
+    CHECK(empty.value().empty());
+
+    // Inside a DeadlineScope the batch only gets what is left of the deadline
+    {
+        using netpipe::remote::DeadlineScope;
+        DeadlineScope passed(DeadlineScope::Clock::now() - std::chrono::milliseconds(1));
+        auto late = remote.call_batch(requests, 5000);
+        REQUIRE(late.is_err());
+        CHECK(late.error().code == dp::Error::TIMEOUT);
+    }
+    {
+        using netpipe::remote::DeadlineScope;
+        DeadlineScope ahead(DeadlineScope::Clock::now() + std::chrono::milliseconds(2000));
+        auto in_time = remote.call_batch(std::span(requests).subspan(0, 5), 5000);
+        REQUIRE(in_time.is_ok());
+        CHECK(in_time.value().size() == 5);
+    }
+
+    client.close();
+    server_thread.join();
+    server.close();
+}
@@ -0,0 +1,192 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("TimerWheel - Deterministic ticks") {
+    netpipe::TimerWheel wheel(1000);
+    std::vector<netpipe::TimerWheel::Expired> due;
+
+    SUBCASE("Timers fire on their exact tick across levels") {
+        std::vector<dp::u64> fired;
+        for (dp::u32 delay : {1u, 5u, 255u, 256u, 257u, 65535u, 65536u, 70000u, 16777300u}) {
+            wheel.schedule(delay, [&fired, &wheel]() { fired.push_back(wheel.now()); });
+        }
+        CHECK(wheel.size() == 9);
+        CHECK(wheel.next_deadline() == 1001);
+
+        // Walk the wheel tick by tick, firing as we go, and compare against the expected ticks
+        std::vector<dp::u64> expected = {1001, 1005, 1255, 1256, 1257, 66535, 66536, 71000, 16778300};
+        while (wheel.size() > 0) {
+            dp::u64 next = wheel.next_deadline();
+            REQUIRE(next > wheel.now());
+            wheel.advance(next, due);
+            for (auto &expired : due) {
+                expired.callback();
+            }
+            due.clear();
+        }
+        CHECK(fired == expected);
+    }
+
+    SUBCASE("Cancel removes a timer and stale ids do nothing") {
+        bool ran = false;
+        auto id = wheel.schedule(10, [&]() { ran = true; });
+        CHECK(wheel.cancel(id));
+        CHECK_FALSE(wheel.cancel(id));
+        wheel.advance(1100, due);
+        CHECK(due.empty());
+        CHECK_FALSE(ran);
+
+        // The recycled node gets a new id
+        auto next = wheel.schedule(10, []() {});
+        CHECK(next != id);
+        CHECK_FALSE(wheel.cancel(id));
+        CHECK(wheel.cancel(next));
+        CHECK(wheel.size() == 0);
+    }
+
+    SUBCASE("Periodic timers are re-armed by the caller") {
+        int runs = 0;
+        auto id = wheel.schedule_every(100, [&]() { runs++; });
+        for (int i = 0; i < 5; i++) {
+            wheel.advance(wheel.now() + 100, due);
+            REQUIRE(due.size() == 1);
+            CHECK(due[0].id == id);
+            due[0].callback();
+            wheel.rearm(std::move(due[0]));
+            due.clear();
+        }
+        CHECK(runs == 5);
+        CHECK(wheel.cancel(id));
+        CHECK(wheel.size() == 0);
+    }
+
+    SUBCASE("Random deadlines all fire on time") {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<dp::u32> delay(1, 200000);
+        std::vector<dp::u64> deadline_of(2000);
+        std::vector<dp::u64> fired_at(2000, 0);
+        for (int i = 0; i < 2000; i++) {
+            dp::u32 d = delay(rng);
+            deadline_of[i] = 1000 + d;
+            wheel.schedule(d, [&, i]() { fired_at[i] = wheel.now(); });
+        }
+
+        // Uneven jumps exercise multi-tick advances and cascades in the middle of a step
+        std::uniform_int_distribution<dp::u32> step(1, 3000);
+        while (wheel.size() > 0) {
+            wheel.advance(wheel.now() + step(rng), due);
+            for (auto &expired : due) {
+                expired.callback();
+            }
+            due.clear();
+        }
+        int early = 0;
+        for (int i = 0; i < 2000; i++) {
+            // Fired during the advance that covered the deadline - never before it
+            if (fired_at[i] < deadline_of[i]) {
+                early++;
+            }
+        }
+        CHECK(early == 0);
+    }
+}
+
+TEST_CASE("TimerService - Threaded delivery") {
+    netpipe::TimerService timers;
+
+    SUBCASE("One-shot fires close to its deadline") {
+        std::atomic<bool> fired{false};
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<dp::i64> elapsed_ms{0};
+        timers.schedule(20, [&]() {
+            elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+                             .count();
+            fired = true;
+        });
+        for (int i = 0; i < 200 && !fired; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(fired);
+        CHECK(elapsed_ms >= 19);
+        CHECK(elapsed_ms < 60);
+    }
+
+    SUBCASE("Cancelled timer never runs") {
+        std::atomic<bool> fired{false};
+        auto id = timers.schedule(30, [&]() { fired = true; });
+        CHECK(timers.cancel(id));
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        CHECK_FALSE(fired);
+        CHECK(timers.size() == 0);
+    }
+
+    SUBCASE("Periodic timer stops after cancel") {
+        std::atomic<int> runs{0};
+        auto id = timers.schedule_every(5, [&]() { runs++; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        timers.cancel(id);
+        int seen = runs;
+        CHECK(seen >= 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(runs == seen);
+    }
+
+    SUBCASE("cancel waits for a running callback") {
+        std::atomic<bool> entered{false};
+        std::atomic<bool> finished{false};
+        auto id = timers.schedule(1, [&]() {
+            entered = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            finished = true;
+        });
+        while (!entered) {
+            std::this_thread::yield();
+        }
+        CHECK_FALSE(timers.cancel(id));
+        CHECK(finished);
+    }
+}
+
+TEST_CASE("Remote<Bidirect> - Handler timeout from the timer wheel") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20017};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        // 100 ms handler timeout - the old watchdog could only notice it on its next 1 s scan
+        netpipe::Remote<netpipe::Bidirect> server(*accepted, 100, false, 100, 2, 100, 100);
+        server.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            std::this_thread::sleep_for(std::chrono::milliseconds(400));
+            return dp::result::ok(req);
+        });
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+
+        auto start = std::chrono::steady_clock::now();
+        auto res = remote.call(1, netpipe::Message{1}, 2000);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        REQUIRE(res.is_err());
+        CHECK(std::string(res.error().message.c_str()).find("timeout") != std::string::npos);
+        CHECK(elapsed >= std::chrono::milliseconds(90));
+        CHECK(elapsed < std::chrono::milliseconds(300));
+    }
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
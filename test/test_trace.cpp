@@ -0,0 +1,156 @@
+#ifndef NETPIPE_TRACING
+#define NETPIPE_TRACING // This test exercises the compiled-in path whatever the build option says
+#endif
+
+#include <cstdio>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <string>
+#include <thread>
+
+using netpipe::trace::EventKind;
+
+namespace {
+    // Events of every thread, in thread order
+    dp::Vector<netpipe::trace::Event> all_events() {
+        dp::Vector<netpipe::trace::Event> out;
+        for (auto &thread : netpipe::trace::collect()) {
+            out.insert(out.end(), thread.events.begin(), thread.events.end());
+        }
+        return out;
+    }
+
+    dp::usize count(const dp::Vector<netpipe::trace::Event> &events, EventKind kind, dp::u32 request_id) {
+        dp::usize n = 0;
+        for (const auto &event : events) {
+            n += event.kind == kind && event.request_id == request_id;
+        }
+        return n;
+    }
+} // namespace
+
+TEST_CASE("Trace - Per-thread rings keep the newest events") {
+    netpipe::trace::clear();
+    std::thread writer([]() {
+        netpipe::trace::set_thread_name("writer");
+        for (dp::u32 i = 0; i < 10; i++) {
+            NETPIPE_TRACE(Mark, i, 0, i * 10);
+        }
+    });
+    writer.join();
+
+    auto threads = netpipe::trace::collect();
+    REQUIRE(threads.size() == 1);
+    CHECK(threads[0].name == "writer");
+    REQUIRE(threads[0].events.size() == 10);
+    for (dp::u32 i = 0; i < 10; i++) {
+        CHECK(threads[0].events[i].request_id == i);
+        CHECK(threads[0].events[i].value == i * 10);
+        if (i > 0) {
+            CHECK(threads[0].events[i].timestamp_ns >= threads[0].events[i - 1].timestamp_ns);
+        }
+    }
+
+    // Overflow drops the oldest
+    constexpr dp::u32 total = netpipe::trace::Ring::CAPACITY + 100;
+    for (dp::u32 i = 0; i < total; i++) {
+        NETPIPE_TRACE(Mark, i, 1, 0);
+    }
+    dp::Vector<netpipe::trace::Event> mine;
+    netpipe::trace::local_ring().snapshot(mine);
+    REQUIRE(mine.size() >= netpipe::trace::Ring::CAPACITY - 1);
+    CHECK(mine.size() <= netpipe::trace::Ring::CAPACITY);
+    CHECK(mine.back().request_id == total - 1);
+
+    // The runtime switch and clear()
+    netpipe::trace::clear();
+    netpipe::trace::set_enabled(false);
+    NETPIPE_TRACE(Mark, 1, 1, 1);
+    netpipe::trace::set_enabled(true);
+    CHECK(all_events().empty());
+}
+
+TEST_CASE("Trace - Exited threads hand their rings on") {
+    netpipe::trace::clear();
+    std::thread([]() { NETPIPE_TRACE(Mark, 1, 0, 0); }).join();
+    auto rings = netpipe::trace::Registry::instance().rings().size();
+    for (int i = 0; i < 20; i++) {
+        std::thread([i]() {
+            netpipe::trace::set_thread_name(i == 19 ? "last \"one\"\\" : "short-lived");
+            NETPIPE_TRACE(Mark, 2, 0, 0);
+        }).join();
+    }
+    CHECK(netpipe::trace::Registry::instance().rings().size() == rings);
+
+    // Only the newest thread's events survive in the reused ring, and its name is escaped
+    auto threads = netpipe::trace::collect();
+    REQUIRE(threads.size() == 1);
+    CHECK(threads[0].events.size() == 1);
+    std::string json = netpipe::trace::to_chrome_json();
+    CHECK(json.find("\"last \\\"one\\\"\\\\\"") != std::string::npos);
+}
+
+TEST_CASE("Trace - A Remote call forms one timeline across client, transport and handler") {
+    netpipe::TcpStream listener;
+    REQUIRE(listener.listen({"127.0.0.1", 20054}).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client_stream;
+    REQUIRE(client_stream.connect({"127.0.0.1", 20054}).is_ok());
+    accept_thread.join();
+
+    netpipe::trace::clear();
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        netpipe::Remote<netpipe::Bidirect> client(client_stream);
+        server.register_method(9, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(netpipe::Message(req.size() * 2, 0x11));
+        });
+        auto res = client.call(9, netpipe::Message(100, 0x22), 2000);
+        REQUIRE(res.is_ok());
+    }
+
+    auto events = all_events();
+    dp::u32 request_id = 0;
+    for (const auto &event : events) {
+        if (event.kind == EventKind::CallBegin) {
+            request_id = event.request_id;
+            CHECK(event.method_id == 9);
+            CHECK(event.value == 100);
+        }
+    }
+    CHECK(count(events, EventKind::CallBegin, request_id) == 1);
+    CHECK(count(events, EventKind::CallEnd, request_id) == 1);
+    CHECK(count(events, EventKind::HandlerBegin, request_id) == 1);
+    CHECK(count(events, EventKind::HandlerEnd, request_id) == 1);
+    CHECK(count(events, EventKind::SendBegin, request_id) == 2); // Request and response
+    CHECK(count(events, EventKind::Recv, request_id) == 2);
+    CHECK(count(events, EventKind::QueueWait, request_id) >= 1);
+    for (const auto &event : events) {
+        if (event.kind == EventKind::CallEnd && event.request_id == request_id) {
+            CHECK(event.value == 200);
+        }
+    }
+
+    auto json = netpipe::trace::to_chrome_json();
+    CHECK(json.find("\"traceEvents\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"handler\",\"ph\":\"B\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"call\",\"cat\":\"remote\",\"ph\":\"b\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"queue wait\",\"ph\":\"X\"") != std::string::npos);
+
+    const char *path = "/tmp/np_trace_test.json";
+    REQUIRE(netpipe::trace::export_chrome_json(path).is_ok());
+    FILE *file = std::fopen(path, "r");
+    REQUIRE(file != nullptr);
+    std::fclose(file);
+    std::remove(path);
+
+    client_stream.close();
+    accepted->close();
+    listener.close();
+}
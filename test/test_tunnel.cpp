@@ -0,0 +1,176 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <netpipe/netpipe.hpp>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    // A SOCK_SEQPACKET pair stands in for a TAP queue: the tunnel gets one end, the test plays the "kernel"
+    struct FakeTap {
+        int tunnel_fd = -1;
+        int host_fd = -1;
+
+        FakeTap() {
+            int fds[2];
+            REQUIRE(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0);
+            tunnel_fd = fds[0];
+            host_fd = fds[1];
+        }
+        ~FakeTap() {
+            ::close(tunnel_fd);
+            ::close(host_fd);
+        }
+
+        void inject(const netpipe::Message &frame) const {
+            REQUIRE(::write(host_fd, frame.data(), frame.size()) == static_cast<ssize_t>(frame.size()));
+        }
+
+        // Next frame the tunnel wrote to the device, or an empty message after timeout_ms
+        netpipe::Message take(int timeout_ms = 2000) const {
+            struct pollfd pfd = {host_fd, POLLIN, 0};
+            if (::poll(&pfd, 1, timeout_ms) <= 0) {
+                return {};
+            }
+            netpipe::Message frame(65536);
+            ssize_t n = ::read(host_fd, frame.data(), frame.size());
+            frame.resize(n > 0 ? static_cast<dp::usize>(n) : 0);
+            return frame;
+        }
+    };
+
+    netpipe::Message frame_of(dp::usize size, dp::u32 seq) {
+        netpipe::Message frame(size, static_cast<dp::u8>(seq));
+        frame[0] = static_cast<dp::u8>(seq >> 8);
+        frame[1] = static_cast<dp::u8>(seq);
+        return frame;
+    }
+
+    // Frames injected on one side come out of the other, in order, both ways
+    void bridge(netpipe::Stream &left_stream, netpipe::Stream &right_stream) {
+        FakeTap left_tap;
+        FakeTap right_tap;
+        netpipe::Tunnel left;
+        netpipe::Tunnel right;
+        REQUIRE(left.add_queue(left_tap.tunnel_fd, left_stream).is_ok());
+        REQUIRE(right.add_queue(right_tap.tunnel_fd, right_stream).is_ok());
+
+        // Part of it queued before the workers start, so the first reads find a backlog to batch
+        const dp::u32 frames = 200;
+        const dp::u32 backlog = 40; // Well inside the socket buffer
+        for (dp::u32 i = 0; i < backlog; i++) {
+            left_tap.inject(frame_of(60 + (i * 37) % 1400, i));
+        }
+        left_tap.inject(netpipe::Message(2000, 0xee)); // Above max_frame_size
+
+        REQUIRE(right.start().is_ok());
+        REQUIRE(left.start().is_ok());
+        // The rest paced, while the far side drains its device; a full device drops frames, as a real one does
+        std::thread injector([&]() {
+            for (dp::u32 i = backlog; i < frames; i++) {
+                left_tap.inject(frame_of(60 + (i * 37) % 1400, i));
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+        for (dp::u32 i = 0; i < frames; i++) {
+            auto frame = right_tap.take();
+            REQUIRE(frame == frame_of(60 + (i * 37) % 1400, i));
+        }
+        injector.join();
+        right_tap.inject(frame_of(64, 7));
+        CHECK(left_tap.take() == frame_of(64, 7));
+        CHECK(right_tap.take(50).empty());
+
+        left.stop();
+        right.stop();
+        auto sent = left.stats();
+        auto received = right.stats();
+        CHECK(sent.frames_sent == frames);
+        CHECK(sent.batches_sent < frames);
+        CHECK(sent.dropped_oversize == 1);
+        CHECK(sent.frames_received == 1);
+        CHECK(sent.elapsed_ns > 0);
+        CHECK(sent.send_bps() > 0.0);
+        CHECK(received.frames_received == frames);
+        CHECK(received.batches_received == sent.batches_sent);
+        CHECK(received.bytes_received == sent.bytes_sent);
+        CHECK(received.dropped_malformed == 0);
+    }
+} // namespace
+
+TEST_CASE("Tunnel - Batched frames over TCP") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20059};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    netpipe::TcpStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    bridge(client, *accepted);
+
+    // Batches that do not parse are counted, not written to the device
+    FakeTap tap;
+    netpipe::Tunnel tunnel;
+    REQUIRE(tunnel.add_queue(tap.tunnel_fd, *accepted).is_ok());
+    REQUIRE(tunnel.start().is_ok());
+    REQUIRE(client.send(netpipe::Message{0}).is_ok());
+    REQUIRE(client.send(netpipe::Message{0, 2, 0, 3, 1, 2, 3, 0, 9}).is_ok()); // Second frame runs past the end
+    CHECK(tap.take() == netpipe::Message{1, 2, 3});
+    for (int i = 0; i < 100 && tunnel.stats().dropped_malformed < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    tunnel.stop();
+    CHECK(tunnel.stats().dropped_malformed == 2);
+    CHECK(tunnel.stats().frames_received == 1);
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("Tunnel - Batched frames over SHM") {
+    netpipe::ShmStream listener;
+    netpipe::ShmEndpoint endpoint{"netpipe_test_tunnel", 1024 * 1024};
+    REQUIRE(listener.listen_shm(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    netpipe::ShmStream client;
+    REQUIRE(client.connect_shm(endpoint).is_ok());
+    accept_thread.join();
+
+    bridge(client, *accepted);
+
+    client.close();
+    accepted->close();
+    listener.close();
+}
+
+TEST_CASE("Tunnel - Configuration errors") {
+    FakeTap tap;
+    netpipe::TcpStream unconnected;
+    netpipe::Tunnel tunnel;
+    CHECK(tunnel.start().is_err()); // No queues
+    CHECK(tunnel.add_queue(tap.tunnel_fd, unconnected).is_err());
+    CHECK(tunnel.add_queue(-1, unconnected).is_err());
+
+    netpipe::TunnelOptions options;
+    options.max_frame_size = 70000;
+    netpipe::Tunnel jumbo(options);
+    CHECK(jumbo.add_queue(tap.tunnel_fd, unconnected).is_err());
+
+    CHECK(netpipe::TapDevice::open("", 0).is_err());
+    CHECK(netpipe::TapDevice::open("this-name-is-too-long-for-ifnamsiz").is_err());
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <doctest/doctest.h>
 #include <netpipe/datagram/udp.hpp>
@@ -164,6 +165,188 @@ TEST_CASE("UdpDatagram - Multiple messages") {
         sender_thread.join();
         receiver.close();
     }
+
+    SUBCASE("Receive into a reused buffer") {
+        netpipe::UdpDatagram receiver;
+        netpipe::UdpEndpoint recv_endpoint{"127.0.0.1", 19113};
+
+        auto bind_res = receiver.bind(recv_endpoint);
+        REQUIRE(bind_res.is_ok());
+
+        std::thread sender_thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            netpipe::UdpDatagram sender;
+
+            for (int i = 0; i < 5; i++) {
+                netpipe::Message msg(static_cast<dp::usize>(10 + i * 100), static_cast<dp::u8>(i));
+                auto send_res = sender.send_to(msg, recv_endpoint);
+                CHECK(send_res.is_ok());
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+
+            sender.close();
+        });
+
+        netpipe::Message buffer;
+        const dp::u8 *storage = nullptr;
+        for (int i = 0; i < 5; i++) {
+            auto recv_res = receiver.recv_from_into(buffer);
+            REQUIRE(recv_res.is_ok());
+            CHECK(recv_res.value().host == "127.0.0.1");
+            CHECK(buffer.size() == static_cast<dp::usize>(10 + i * 100));
+            CHECK(buffer[0] == static_cast<dp::u8>(i));
+
+            // Capacity from the first receive is reused for the rest
+            if (storage == nullptr) {
+                storage = buffer.data();
+            }
+            CHECK(buffer.data() == storage);
+        }
+
+        sender_thread.join();
+        receiver.close();
+    }
+}
+
+TEST_CASE("UdpDatagram - Batch send and receive") {
+    SUBCASE("send_batch to a resolved address and recv_batch") {
+        netpipe::UdpDatagram receiver;
+        netpipe::UdpEndpoint recv_endpoint{"127.0.0.1", 19114};
+        REQUIRE(receiver.bind(recv_endpoint).is_ok());
+
+        auto dest = netpipe::UdpDatagram::resolve(recv_endpoint);
+        REQUIRE(dest.is_ok());
+        CHECK(dest.value().to_endpoint().host == "127.0.0.1");
+        CHECK(dest.value().to_endpoint().port == 19114);
+
+        // More than one sendmmsg call's worth
+        const dp::usize total = netpipe::UdpDatagram::MAX_BATCH + 36;
+        dp::Vector<netpipe::Message> outgoing;
+        for (dp::usize i = 0; i < total; i++) {
+            outgoing.push_back(netpipe::Message(1 + i % 50, static_cast<dp::u8>(i)));
+        }
+
+        netpipe::UdpDatagram sender;
+        auto send_res = sender.send_batch(std::span<const netpipe::Message>(outgoing.data(), outgoing.size()),
+                                          dest.value());
+        REQUIRE(send_res.is_ok());
+        CHECK(send_res.value() == total);
+
+        dp::Vector<netpipe::Message> incoming(16);
+        dp::Vector<netpipe::UdpAddress> sources(16);
+        dp::usize received = 0;
+        while (received < total) {
+            auto recv_res = receiver.recv_batch(std::span<netpipe::Message>(incoming.data(), incoming.size()),
+                                                std::span<netpipe::UdpAddress>(sources.data(), sources.size()));
+            REQUIRE(recv_res.is_ok());
+            REQUIRE(recv_res.value() > 0);
+            for (dp::usize i = 0; i < recv_res.value(); i++, received++) {
+                CHECK(incoming[i] == outgoing[received]);
+                CHECK(sources[i].to_endpoint().host == "127.0.0.1");
+            }
+        }
+        CHECK(received == total);
+
+        sender.close();
+        receiver.close();
+    }
+
+    SUBCASE("Oversized message rejects the batch") {
+        netpipe::UdpDatagram sender;
+        auto dest = netpipe::UdpDatagram::resolve({"127.0.0.1", 19115});
+        REQUIRE(dest.is_ok());
+
+        dp::Vector<netpipe::Message> outgoing;
+        outgoing.push_back(netpipe::Message(10));
+        outgoing.push_back(netpipe::Message(2000));
+        auto send_res = sender.send_batch(std::span<const netpipe::Message>(outgoing.data(), outgoing.size()),
+                                          dest.value());
+        CHECK(send_res.is_err());
+        sender.close();
+    }
+
+    SUBCASE("recv_batch without bind fails") {
+        netpipe::UdpDatagram udp;
+        netpipe::Message msgs[2];
+        CHECK(udp.recv_batch(msgs).is_err());
+    }
+}
+
+TEST_CASE("UdpDatagram - Segmentation offload") {
+    // 20 full segments and a short tail
+    const dp::u16 segment = 1000;
+    netpipe::Message buffer(20 * segment + 300);
+    for (dp::usize i = 0; i < buffer.size(); i++) {
+        buffer[i] = static_cast<dp::u8>(i / segment + i);
+    }
+
+    SUBCASE("Segmented send arrives as ordinary datagrams") {
+        netpipe::UdpDatagram receiver;
+        netpipe::UdpEndpoint recv_endpoint{"127.0.0.1", 19116};
+        REQUIRE(receiver.bind(recv_endpoint).is_ok());
+        auto dest = netpipe::UdpDatagram::resolve(recv_endpoint);
+        REQUIRE(dest.is_ok());
+
+        netpipe::UdpDatagram sender;
+        REQUIRE(sender.send_segmented(buffer, segment, dest.value()).is_ok());
+
+        dp::Vector<netpipe::Message> incoming(32);
+        dp::usize offset = 0;
+        while (offset < buffer.size()) {
+            auto recv_res = receiver.recv_batch(std::span<netpipe::Message>(incoming.data(), incoming.size()));
+            REQUIRE(recv_res.is_ok());
+            for (dp::usize i = 0; i < recv_res.value(); i++) {
+                const auto &dgram = incoming[i];
+                CHECK(dgram.size() == (buffer.size() - offset < segment ? buffer.size() - offset : segment));
+                CHECK(std::equal(dgram.begin(), dgram.end(), buffer.begin() + offset));
+                offset += dgram.size();
+            }
+        }
+        CHECK(offset == buffer.size());
+
+        sender.close();
+        receiver.close();
+    }
+
+    SUBCASE("GRO receiver reassembles the same bytes") {
+        netpipe::UdpDatagram receiver;
+        netpipe::UdpEndpoint recv_endpoint{"127.0.0.1", 19117};
+        REQUIRE(receiver.bind(recv_endpoint).is_ok());
+        REQUIRE(receiver.set_gro(true).is_ok());
+        auto dest = netpipe::UdpDatagram::resolve(recv_endpoint);
+        REQUIRE(dest.is_ok());
+
+        netpipe::UdpDatagram sender;
+        REQUIRE(sender.send_segmented(buffer, segment, dest.value()).is_ok());
+
+        netpipe::Message coalesced;
+        netpipe::UdpAddress source;
+        dp::usize offset = 0;
+        while (offset < buffer.size()) {
+            auto recv_res = receiver.recv_coalesced(coalesced, &source);
+            REQUIRE(recv_res.is_ok());
+            CHECK(source.to_endpoint().host == "127.0.0.1");
+            // Whatever the kernel coalesced, it is cut at segment boundaries
+            CHECK((recv_res.value() == segment || coalesced.size() < segment));
+            REQUIRE(offset + coalesced.size() <= buffer.size());
+            CHECK(std::equal(coalesced.begin(), coalesced.end(), buffer.begin() + offset));
+            offset += coalesced.size();
+        }
+        CHECK(offset == buffer.size());
+
+        sender.close();
+        receiver.close();
+    }
+
+    SUBCASE("Invalid segmentation is rejected") {
+        netpipe::UdpDatagram sender;
+        auto dest = netpipe::UdpDatagram::resolve({"127.0.0.1", 19118});
+        REQUIRE(dest.is_ok());
+        CHECK(sender.send_segmented(buffer, 0, dest.value()).is_err());
+        CHECK(sender.send_segmented(buffer, 2000, dest.value()).is_err());
+        CHECK(sender.send_segmented(netpipe::Message(100 * 100), 100, dest.value()).is_err());
+        sender.close();
+    }
 }
 
 TEST_CASE("UdpDatagram - Broadcast") {
@@ -302,3 +485,64 @@ TEST_CASE("UdpDatagram - Empty message") {
         receiver.close();
     }
 }
+
+TEST_CASE("UdpDatagram - Multicast groups") {
+    SUBCASE("Every member receives one send; a member that left does not") {
+        netpipe::MulticastEndpoint group{"239.255.42.1", 20038, "127.0.0.1"};
+        netpipe::UdpDatagram first;
+        netpipe::UdpDatagram second;
+        REQUIRE(first.bind_group(group).is_ok());
+        REQUIRE(second.bind_group(group).is_ok()); // Same group and port on one host
+        REQUIRE(first.set_recv_timeout(2000).is_ok());
+        REQUIRE(second.set_recv_timeout(300).is_ok());
+
+        netpipe::UdpDatagram sender;
+        REQUIRE(sender.send_to_group(netpipe::Message{1, 2, 3}, group).is_ok());
+        for (auto *member : {&first, &second}) {
+            auto res = member->recv_from();
+            REQUIRE(res.is_ok());
+            CHECK(res.value().first == netpipe::Message{1, 2, 3});
+        }
+
+        REQUIRE(second.leave_group(group).is_ok());
+        REQUIRE(sender.send_to_group(netpipe::Message{4}, group).is_ok());
+        auto kept = first.recv_from();
+        REQUIRE(kept.is_ok());
+        CHECK(kept.value().first == netpipe::Message{4});
+        auto left = second.recv_from();
+        REQUIRE(left.is_err());
+        CHECK(left.error().code == dp::Error::TIMEOUT);
+
+        // Changed options are applied on the next send (on lo the datagram loops back regardless)
+        group.loopback = false;
+        group.ttl = 4;
+        REQUIRE(sender.send_to_group(netpipe::Message{5}, group).is_ok());
+    }
+
+    SUBCASE("Only numeric multicast groups are accepted") {
+        netpipe::UdpDatagram udp;
+        CHECK(udp.bind_group({"127.0.0.1", 20039}).is_err());
+        CHECK(udp.bind_group({"localhost", 20039}).is_err());
+        CHECK(udp.bind_group({"239.255.42.2", 20039, "no-such-if0"}).is_err());
+        CHECK(udp.send_to_group(netpipe::Message{1}, {"10.1.2.3", 20039}).is_err());
+    }
+
+    SUBCASE("IPv6 group on loopback") {
+        netpipe::MulticastEndpoint group{"ff12::4e50", 20040, "lo"};
+        netpipe::UdpDatagram member;
+        netpipe::UdpDatagram sender;
+        REQUIRE(member.bind_group(group).is_ok());
+        REQUIRE(member.set_recv_timeout(2000).is_ok());
+        if (sender.send_to_group(netpipe::Message{6}, group).is_err()) {
+            MESSAGE("no IPv6 multicast route on lo, skipping");
+            return;
+        }
+        auto res = member.recv_from();
+        REQUIRE(res.is_ok());
+        CHECK(res.value().first == netpipe::Message{6});
+        CHECK(res.value().second.host.find(':') != dp::String::npos);
+
+        // An IPv6 socket rejects an IPv4 group rather than failing inside the kernel
+        CHECK(sender.send_to_group(netpipe::Message{7}, {"239.255.42.1", 20040}).is_err());
+    }
+}
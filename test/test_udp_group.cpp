@@ -0,0 +1,102 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <sched.h>
+#include <set>
+#include <thread>
+
+namespace {
+    // Send count datagrams tagged with sender from their own sockets, paced so loopback queues never overflow
+    void blast(dp::u16 port, dp::usize senders, dp::usize count) {
+        auto dest = netpipe::UdpDatagram::resolve({"127.0.0.1", port});
+        REQUIRE(dest.is_ok());
+        dp::Vector<std::unique_ptr<netpipe::UdpDatagram>> sockets;
+        for (dp::usize s = 0; s < senders; s++) {
+            sockets.push_back(std::make_unique<netpipe::UdpDatagram>());
+        }
+        for (dp::usize i = 0; i < count; i++) {
+            for (dp::usize s = 0; s < senders; s++) {
+                REQUIRE(sockets[s]->send_to(netpipe::Message{static_cast<dp::u8>(s), 0, 0, 0}, dest.value()).is_ok());
+            }
+            if (i % 16 == 15) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    bool wait_for(const netpipe::UdpReceiverGroup &group, dp::u64 total) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (group.total_packets() < total && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return group.total_packets() == total;
+    }
+} // namespace
+
+TEST_CASE("UdpReceiverGroup - Sharded receive on one port") {
+    SUBCASE("Flow hash keeps each sender on one shard") {
+        constexpr dp::usize SHARDS = 4;
+        constexpr dp::usize SENDERS = 8;
+        std::mutex mutex;
+        std::set<dp::usize> shards_of[SENDERS];
+        dp::u64 per_shard[SHARDS] = {};
+
+        netpipe::UdpReceiverGroup group;
+        netpipe::UdpReceiverOptions options;
+        options.shards = SHARDS;
+        options.pin_threads = false;
+        auto handler = [&](dp::usize shard, const netpipe::Message &msg, const netpipe::UdpAddress &) {
+            per_shard[shard]++; // Only this shard's thread touches its slot
+            std::lock_guard<std::mutex> lock(mutex);
+            shards_of[msg[0]].insert(shard);
+        };
+        REQUIRE(group.start({"127.0.0.1", 20041}, handler, options).is_ok());
+        CHECK(group.shard_count() == SHARDS);
+        CHECK(group.port() == 20041);
+        CHECK(group.start({"127.0.0.1", 20041}, handler, options).is_err());
+
+        blast(20041, SENDERS, 200);
+        CHECK(wait_for(group, SENDERS * 200));
+        group.stop();
+        CHECK_FALSE(group.is_running());
+
+        dp::u64 counted = 0;
+        for (dp::usize shard = 0; shard < SHARDS; shard++) {
+            CHECK(group.packets(shard) == per_shard[shard]);
+            counted += per_shard[shard];
+        }
+        CHECK(counted == SENDERS * 200);
+        for (const auto &shards : shards_of) {
+            CHECK(shards.size() == 1);
+        }
+    }
+
+    SUBCASE("CPU steering and an ephemeral port") {
+        netpipe::UdpReceiverGroup group;
+        netpipe::UdpReceiverOptions options;
+        options.shards = 2;
+        options.steering = netpipe::UdpSteering::Cpu;
+        std::atomic<dp::u64> seen{0};
+        std::atomic<dp::u64> elsewhere{0}; // Datagrams handled off the shard's own CPU
+        auto cpus = netpipe::remote::usable_cpus();
+        REQUIRE_FALSE(cpus.empty());
+        auto res = group.start(
+            {"127.0.0.1", 0},
+            [&](dp::usize shard, const netpipe::Message &, const netpipe::UdpAddress &) {
+                if (::sched_getcpu() != cpus[shard % cpus.size()]) {
+                    elsewhere++;
+                }
+                seen++;
+            },
+            options);
+        REQUIRE(res.is_ok());
+        REQUIRE(group.port() != 0);
+
+        blast(group.port(), 2, 100);
+        CHECK(wait_for(group, 200));
+        CHECK(seen == 200);
+        CHECK(elsewhere == 0); // Pinned before the first receive
+    }
+}
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <doctest/doctest.h>
+#include <netpipe/netpipe.hpp>
+#include <netpipe/stream/uring.hpp>
+#include <thread>
+
+TEST_CASE("UringStream - Framing against a plain TcpStream") {
+    if (!netpipe::UringStream::is_supported()) {
+        MESSAGE("io_uring provided buffer rings not supported - skipping");
+        return;
+    }
+
+    netpipe::TcpStream server;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20012};
+    REQUIRE(server.listen(endpoint).is_ok());
+
+    // Small buffers so frames straddle and exceed them
+    netpipe::UringStream client(std::make_unique<netpipe::TcpStream>(), 8, 4096);
+
+    std::thread server_thread([&]() {
+        auto accept_res = server.accept();
+        REQUIRE(accept_res.is_ok());
+        auto peer = std::move(accept_res.value());
+
+        // Echo until the client hangs up
+        netpipe::Message msg;
+        while (peer->recv_into(msg).is_ok()) {
+            REQUIRE(peer->send(msg).is_ok());
+        }
+    });
+
+    REQUIRE(client.connect(endpoint).is_ok());
+    CHECK(client.is_connected());
+    CHECK(client.native_handle() == -1);
+
+    SUBCASE("Mixed sizes round trip") {
+        for (int i = 0; i < 200; i++) {
+            dp::usize size = (i % 25 == 0) ? 300 * 1024 : static_cast<dp::usize>(i * 37 % 5000);
+            netpipe::Message msg(size);
+            for (dp::usize j = 0; j < size; j++) {
+                msg[j] = static_cast<dp::u8>(i + j);
+            }
+            REQUIRE(client.send(msg).is_ok());
+            auto res = client.recv();
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == msg);
+        }
+    }
+
+    SUBCASE("Split receive and timeout") {
+        REQUIRE(client.set_recv_timeout(50).is_ok());
+        auto idle = client.recv();
+        REQUIRE(idle.is_err());
+        CHECK(idle.error().code == dp::Error::TIMEOUT);
+        CHECK(client.is_connected());
+
+        auto message = netpipe::remote::encode_remote_message_v2(5, 6, netpipe::Message(10000, 0x42));
+        REQUIRE(client.send(message).is_ok());
+
+        dp::u8 header[netpipe::remote::V2_HEADER_SIZE];
+        netpipe::Message payload;
+        auto res = client.recv_split(header, sizeof(header), payload);
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == sizeof(header));
+        CHECK(std::memcmp(header, message.data(), sizeof(header)) == 0);
+        CHECK(payload == netpipe::Message(10000, 0x42));
+    }
+
+    client.close();
+    CHECK_FALSE(client.is_connected());
+    server_thread.join();
+    server.close();
+}
+
+TEST_CASE("UringStream - Remote on both ends") {
+    if (!netpipe::UringStream::is_supported()) {
+        MESSAGE("io_uring provided buffer rings not supported - skipping");
+        return;
+    }
+
+    netpipe::UringStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20013};
+    REQUIRE(listener.listen(endpoint).is_ok());
+
+    std::thread server_thread([&]() {
+        auto accept_res = listener.accept();
+        REQUIRE(accept_res.is_ok());
+        auto peer = std::move(accept_res.value());
+
+        netpipe::Remote<netpipe::Bidirect> remote(*peer);
+        remote.register_method(1, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+            return dp::result::ok(req);
+        });
+        while (peer->is_connected()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    });
+
+    netpipe::UringStream client;
+    REQUIRE(client.connect(endpoint).is_ok());
+    {
+        netpipe::Remote<netpipe::Bidirect> remote(client);
+        for (int i = 0; i < 50; i++) {
+            netpipe::Message request(static_cast<dp::usize>(1 + i * 1000), static_cast<dp::u8>(i));
+            auto res = remote.call(1, request, 5000);
+            REQUIRE(res.is_ok());
+            CHECK(res.value() == request);
+        }
+    }
+    client.close();
+
+    server_thread.join();
+    listener.close();
+}
+
+TEST_CASE("UringStream - IPC transport") {
+    if (!netpipe::UringStream::is_supported()) {
+        MESSAGE("io_uring provided buffer rings not supported - skipping");
+        return;
+    }
+
+    netpipe::IpcStream server;
+    netpipe::IpcEndpoint endpoint{"/tmp/netpipe_test_uring.sock"};
+    REQUIRE(server.listen_ipc(endpoint).is_ok());
+
+    std::thread server_thread([&]() {
+        auto accept_res = server.accept();
+        REQUIRE(accept_res.is_ok());
+        auto adopted = netpipe::UringStream::adopt(std::move(accept_res.value()));
+        REQUIRE(adopted.is_ok());
+        auto peer = std::move(adopted.value());
+        for (int i = 0; i < 20; i++) {
+            auto msg = peer->recv();
+            REQUIRE(msg.is_ok());
+            REQUIRE(peer->send(msg.value()).is_ok());
+        }
+        peer->close();
+    });
+
+    netpipe::IpcStream client;
+    REQUIRE(client.connect_ipc(endpoint).is_ok());
+    for (int i = 0; i < 20; i++) {
+        netpipe::Message msg(static_cast<dp::usize>(i * 3000), static_cast<dp::u8>(i));
+        REQUIRE(client.send(msg).is_ok());
+        auto res = client.recv();
+        REQUIRE(res.is_ok());
+        CHECK(res.value() == msg);
+    }
+
+    server_thread.join();
+    client.close();
+    server.close();
+}
@@ -0,0 +1,104 @@
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <mutex>
+#include <netpipe/netpipe.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+    // TCP stream whose writes wait at a gate, recording the method id of every frame in write order
+    class GatedStream : public netpipe::TcpStream {
+      public:
+        std::atomic<bool> open{true};
+        std::atomic<int> writes{0};
+        std::mutex methods_mutex;
+        std::vector<dp::u32> methods;
+
+        dp::Res<void> send_iov(std::span<const iovec> parts) override {
+            wait_and_record({&parts, 1});
+            return netpipe::TcpStream::send_iov(parts);
+        }
+
+        dp::Res<void> send_batch(std::span<const std::span<const iovec>> frames) override {
+            wait_and_record(frames);
+            return netpipe::TcpStream::send_batch(frames);
+        }
+
+      private:
+        void wait_and_record(std::span<const std::span<const iovec>> frames) {
+            writes++;
+            while (!open) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::lock_guard<std::mutex> lock(methods_mutex);
+            for (const auto &parts : frames) {
+                auto *header = static_cast<const dp::u8 *>(parts[0].iov_base);
+                methods.push_back(netpipe::decode_u32_be(header + 8));
+            }
+        }
+    };
+} // namespace
+
+TEST_CASE("FrameWriter - Concurrent Remote sends are coalesced into one write") {
+    netpipe::TcpStream listener;
+    netpipe::TcpEndpoint endpoint{"127.0.0.1", 20056};
+    REQUIRE(listener.listen(endpoint).is_ok());
+    std::unique_ptr<netpipe::Stream> accepted;
+    std::thread accept_thread([&]() {
+        auto res = listener.accept();
+        REQUIRE(res.is_ok());
+        accepted = std::move(res.value());
+    });
+    GatedStream client_stream;
+    REQUIRE(client_stream.connect(endpoint).is_ok());
+    accept_thread.join();
+
+    {
+        netpipe::Remote<netpipe::Bidirect> server(*accepted);
+        for (dp::u32 method : {1u, 2u}) {
+            server.register_method(method, [](const netpipe::Message &req) -> dp::Res<netpipe::Message> {
+                return dp::result::ok(req);
+            });
+        }
+        netpipe::Remote<netpipe::Bidirect> client(client_stream, 100);
+        client.set_method_priority(2, netpipe::Priority::Critical);
+
+        // The first sender becomes the writer and stalls at the gate; the rest queue up behind it
+        client_stream.open = false;
+        std::vector<std::thread> callers;
+        callers.emplace_back([&]() { CHECK(client.call(1, netpipe::Message{0}, 5000).is_ok()); });
+        for (int i = 0; i < 200 && client_stream.writes == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(client_stream.writes == 1);
+        for (int i = 0; i < 20; i++) {
+            callers.emplace_back([&, i]() {
+                dp::u32 method = i == 19 ? 2 : 1;
+                auto res = client.call(method, netpipe::Message(32, static_cast<dp::u8>(i)), 5000);
+                REQUIRE(res.is_ok());
+                CHECK(res.value().size() == 32);
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        client_stream.open = true;
+        for (auto &caller : callers) {
+            caller.join();
+        }
+
+        CHECK(client.frames_sent() == 21);
+        CHECK(client.frame_batches_sent() == 2);
+        REQUIRE(client_stream.methods.size() == 21);
+        CHECK(client_stream.methods[1] == 2); // The Critical call leads its batch
+
+        // A lone sender still writes straight away
+        REQUIRE(client.call(1, netpipe::Message{1}, 5000).is_ok());
+        CHECK(client.frame_batches_sent() == 3);
+        CHECK(server.frames_sent() == 22);
+    }
+
+    client_stream.close();
+    accepted->close();
+    listener.close();
+}
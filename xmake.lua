@@ -86,7 +86,10 @@ end
 -- Options
 option("examples", {default = false, showmenu = true, description = "Build examples"})
 option("tests",    {default = false, showmenu = true, description = "Enable tests"})
+option("bench",    {default = false, showmenu = true, description = "Build the netpipe_bench benchmark suite"})
 option("big_transfer", {default = false, showmenu = true, description = "Enable 100MB+ transfer tests (slow)"})
+option("tracing", {default = false, showmenu = true, description = "Compile in binary hot-path tracing (NETPIPE_TRACING)"})
+option("rdma", {default = false, showmenu = true, description = "Build RdmaStream against libibverbs (NETPIPE_RDMA)"})
 option("short_namespace", {default = false, showmenu = true, description = "Enable short namespace alias"})
 option("expose_all", {default = false, showmenu = true, description = "Expose all submodule functions in optinum:: namespace"})
 
@@ -183,6 +186,13 @@ target(PROJECT_NAME)
     if has_config("expose_all") then
         add_defines("OPTINUM_EXPOSE_ALL", {public = true})
     end
+    if has_config("tracing") then
+        add_defines("NETPIPE_TRACING", {public = true})
+    end
+    if has_config("rdma") then
+        add_defines("NETPIPE_RDMA", {public = true})
+        add_syslinks("ibverbs", {public = true})
+    end
 
     on_install(function (target)
         os.cp(target:targetfile(), path.join(target:installdir(), "lib", path.filename(target:targetfile())))
@@ -226,6 +236,13 @@ if os.projectdir() == os.curdir() then
         })
     end
 
+    if has_config("bench") then
+        add_binaries("bench/*.cpp", {
+            packages = LIB_DEP_NAMES,
+            syslinks = {"pthread"}
+        })
+    end
+
     if has_config("tests") then
         local test_defines = {"DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN"}
         if has_config("big_transfer") then